@@ -0,0 +1,187 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2021-2022 Hekk_Elek
+*
+* \file platform.h
+*
+* \brief Compiler-specific directives, shared by the STC8 (firmware/src) and the PY32 (fw_py32/Src) builds
+*
+* \author Hekk_Elek
+*
+* \note  Every compiler of both MCUs defines the same set of macros: a source using only these builds on
+*        either, with nothing left to the runtime. A storage class an MCU doesn't have is empty there.
+*
+**********************************************************************************************************/
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+/***************************************< Includes >**************************************/
+
+/***************************************< Definitions >**************************************/
+#if defined( __IAR_SYSTEMS_ICC__ ) && defined( __ICC8051__ )  // IAR 8051, STC8
+// Include intrinsic functions
+#include <intrinsics.h>
+
+// No operation intrinsic macro
+#define NOP()    __no_operation()
+
+// Storage classifiers
+#define DATA       //__data  //NOTE: it should have worked, but the compiler crashes at this keyword
+#define IDATA      __idata
+#define XDATA      __xdata
+#define CODE       __code
+#define REENTRANT
+#define NO_INIT
+#define RAMFUNC
+// Placement by user: the default memory of the tiny data model is DATA, as __data can't be used
+#define ISR_DATA   DATA
+#define MAIN_DATA  IDATA
+
+// Bit definition
+#define BIT        unsigned char
+
+// Interrupt definition
+#define IT_PRE     __interrupt
+#define ITVECTOR0
+#define ITVECTOR1
+#define ITVECTOR7
+#define ITVECTOR10
+
+//NOTE: In IAR 8051 everything is packed by default
+#define PACKED
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+#elif defined( __IAR_SYSTEMS_ICC__ )  // IAR ARM, PY32
+// Include intrinsic functions
+#include <intrinsics.h>
+
+// No operation intrinsic macro
+#define NOP()    __no_operation()
+
+// Storage classifiers:
+#define DATA
+#define IDATA
+#define XDATA
+#define CODE
+#define REENTRANT
+#define NO_INIT    __no_init  // left out of the zero initialization at startup
+#define RAMFUNC    __ramfunc  // copied to RAM at startup, runs without flash access
+#define ISR_DATA
+#define MAIN_DATA
+
+// Bit definition
+#define BIT        unsigned char
+
+// Interrupt definition
+#define IT_PRE
+#define ITVECTOR0
+#define ITVECTOR1
+#define ITVECTOR7
+#define ITVECTOR10
+
+//NOTE: In IAR 8051 everything is packed by default
+#define PACKED
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+#elif defined( SIM_HOST )  // Host build of the simulator, GCC or Clang
+// No operation intrinsic macro
+#define NOP()
+
+// Storage classifiers
+#define DATA
+#define IDATA
+#define XDATA
+#define CODE
+#define REENTRANT
+#define NO_INIT
+#define RAMFUNC
+#define ISR_DATA
+#define MAIN_DATA
+
+// Bit definition
+#define BIT        unsigned char
+
+// Interrupt definition
+#define IT_PRE
+#define ITVECTOR0
+#define ITVECTOR1
+#define ITVECTOR7
+#define ITVECTOR10
+
+#define PACKED     // the layout does not matter on the host
+/////////////////////////////////////////////////////////////////////////////////////////////
+#elif defined( __C51__ )  // Keil C51, STC8
+// Include intrinsic functions
+#include <intrins.h>
+
+// No operation intrinsic macro
+#define NOP()    _nop_()
+
+// Storage classifiers
+#define DATA       data
+#define IDATA      idata
+#define XDATA      xdata
+#define CODE       code
+#define REENTRANT  reentrant
+#define NO_INIT
+#define RAMFUNC
+// Placement by user, checked by tools/footprint.py --isr
+#define ISR_DATA   data   // touched by an interrupt: directly addressed, the ISR needs no pointer register
+#define MAIN_DATA  idata  // touched by the main loop only: leaves the direct space to the interrupts
+
+// Bit definition
+#define BIT        bit
+
+// Interrupt definition
+#define IT_PRE
+#define ITVECTOR0   interrupt 0
+#define ITVECTOR1   interrupt 1
+#define ITVECTOR7   interrupt 7
+#define ITVECTOR10  interrupt 10
+
+//NOTE: In Keil C51 everything is packed by default
+#define PACKED
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+#elif defined( __GNUC__ )  // arm-none-eabi-gcc, PY32, see fw_py32/GCC
+// No operation intrinsic macro
+#define NOP()    __asm volatile ( "nop" )
+
+// Storage classifiers, the sections are placed by py32f002ax5_flash.ld
+#define DATA
+#define IDATA
+#define XDATA
+#define CODE
+#define REENTRANT
+#define NO_INIT    __attribute__(( section( ".noinit" ) ))  // left out of the zero initialization at startup
+#define RAMFUNC    __attribute__(( section( ".ramfunc" ), noinline, long_call ))  // copied to RAM at startup, runs without flash access
+#define ISR_DATA
+#define MAIN_DATA
+
+// Bit definition
+#define BIT        unsigned char
+
+// Interrupt definition
+#define IT_PRE
+#define ITVECTOR0
+#define ITVECTOR1
+#define ITVECTOR7
+#define ITVECTOR10
+
+#define PACKED     // natural alignment, the same layout as the IAR build
+#else
+#error "platform.h: unknown compiler"
+#endif
+
+// Compile-time assertion, at file scope: a bit-field can't have a negative width, which every compiler
+// must report. The array of negative size used before didn't fail the IAR and Keil builds, and its fixed
+// name allowed a single assertion per translation unit.
+#define STATIC_ASSERT( expr )          STATIC_ASSERT_( expr, __LINE__ )
+#define STATIC_ASSERT_( expr, line )   STATIC_ASSERT__( expr, line )  // __LINE__ is expanded first
+#define STATIC_ASSERT__( expr, line )  typedef struct { unsigned int bitAssert : ( (expr) ? 1 : -1 ); } S_STATIC_ASSERT_##line
+
+#endif /* PLATFORM_H */
+
+/***************************************< End of file >**************************************/
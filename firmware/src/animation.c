@@ -17,23 +17,55 @@ the LED brightness state variables. Each animation program runs in a loop. Instr
 the following format:
   [ LED brightness array -- signed integer ] [ Opcode ] [ Opcode specific operand ]
 
+The brightness arrays are stored packed, two 4-bit values per byte (first value in the high
+nibble), to save code memory. LOAD values are unsigned (0..15), the values of every other
+opcode are signed (-8..7). The arrays are unpacked before the instruction is executed.
+
+A TRAIL instruction holds the parameters of a particle in place of the array, see PACK_TRAIL():
+its head moves around the ring, and the trail left behind fades by a right shift in every step.
+A repeated TRAIL draws a shooting star with a single instruction.
+
 ----------------------------------------------------------------------------------------*/
 
 /***************************************< Includes >**************************************/
-// Standard C libraries
-#include <string.h>
-
 // Own includes
 #include "types.h"
+#include "board.h"
 #include "led.h"
 #include "rgbled.h"
 #include "util.h"
 #include "animation.h"
 #include "persist.h"
 
+#if PERSIST_ANIMATIONS_IN_EEPROM
+// The constants of this module, the tables of the animations, go to the class CONST_EEPROM. Link them to
+// the EEPROM below the journal, through its mapping in the code space, with the BL51 directive
+//   CLASSES( CONST_EEPROM( C:0x2000-C:0x2BFF ) )
+// The hex file holds them above 0x2000: load that part into the EEPROM buffer of STC-ISP, at 0. MOVC reads
+// them as any code constant, the VM doesn't notice.
+#ifdef __C51__
+#pragma USERCLASS( CONST = EEPROM )
+#else
+#error "PERSIST_ANIMATIONS_IN_EEPROM: only the Keil C51 build places the animation tables"
+#endif
+#endif
+
 
 /***************************************< Definitions >**************************************/
 #define RIGHT_LEDS_START    (6u)  //!< Index of the first LED on the right side of the board
+#define PACKED_SIZE(n)      (((n) + 1u) / 2u)  //!< Number of bytes needed to store n packed brightness values
+#define LOOP_RGB            (0x01u)  //!< Option of an animation: the RGB program loops on its own instead of restarting with the normal one
+#define SLOW_CLOCK          (0x02u)  //!< Option of an animation: dark or static, it runs from the divided system clock (UTIL_CLOCK_SCALING)
+
+//! \brief Packs two brightness values into one byte
+#define PACK_NIBBLES(a,b)   ((U8)((((a) & 0x0F) << 4) | ((b) & 0x0F)))
+//! \brief Packs the brightness values of the normal LEDs
+#define PACK_LEDS(a0,a1,a2,a3,a4,a5,a6,a7,a8,a9,a10,a11)  { PACK_NIBBLES(a0,a1), PACK_NIBBLES(a2,a3), PACK_NIBBLES(a4,a5), PACK_NIBBLES(a6,a7), PACK_NIBBLES(a8,a9), PACK_NIBBLES(a10,a11) }
+//! \brief Packs the brightness values of the RGB LED
+#define PACK_RGB(r,g,b)     { PACK_NIBBLES(r,g), PACK_NIBBLES(b,0) }
+//! \brief Packs the parameters of a TRAIL in place of the brightness array: start and velocity of the head in 1/16 LEDs (clockwise if positive, at most +-127), decay shift of the trail (1..4), level of the head
+#define PACK_TRAIL(start,velocity,shift,level)  { (U8)(start), (U8)(velocity), (U8)(shift), (U8)(level), 0u, 0u }
+#define TRAIL_POSITIONS     ( LEDS_NUM * 16u )  //!< Positions of the head of a TRAIL around the ring, in 1/16 LEDs
 
 
 /***************************************< Types >**************************************/
@@ -44,6 +76,7 @@ typedef enum
   ADD       = 0x01u,  //!< Adds the LED brightness array elements to the current brightness level; if overflows, it sets to zero
   RSHIFT    = 0x02u,  //!< Shifts all the current LED brightness levels clockwise
   LSHIFT    = 0x04u,  //!< Shifts all the current LED brightness levels anticlockwise
+  TRAIL     = 0x08u,  //!< Normal LEDs only: decays the trail, moves its head by the velocity and draws both, see PACK_TRAIL(); the first run places the head at the start
 //  UMOVE     = 0x04u,  //!< Moves some of the values upwards. Uses saturation logic. Doesn't roll over.
 //  DMOVE     = 0x08u,  //!< Moves some of the values downwards. Uses saturation logic. Doesn't roll over.
   DIV       = 0x10u,  //!< Divides the the current LED brightness levels by the given number
@@ -55,8 +88,8 @@ typedef enum
 //! \brief Instruction used by the animation state machine -- for normal LEDs
 typedef struct
 {
-  U16 u16TimingMs;                               //!< How long the machine should stay in this state
-  U8  au8LEDBrightness[ LEDS_NUM ];              //!< Brightness of each LED
+  U8  u8Timing;                                  //!< How long the machine should stay in this state, in the time units of the program
+  U8  au8LEDBrightness[ PACKED_SIZE(LEDS_NUM) ];  //!< Brightness of each LED, packed
   U8  u8AnimationOpcode;                         //!< Opcode (E_ANIMATION_OPCODE)
   U8  u8AnimationOperand;                        //!< Opcode-specific operand
 } S_ANIMATION_INSTRUCTION_NORMAL;
@@ -64,8 +97,8 @@ typedef struct
 //! \brief Instruction used by the animation state machine -- for the RGB LED
 typedef struct
 {
-  U16 u16TimingMs;                               //!< How long the machine should stay in this state
-  U8  au8RGBLEDBrightness[ NUM_RGBLED_COLORS ];  //!< Brightness of each color
+  U8  u8Timing;                                  //!< How long the machine should stay in this state, in the time units of the program
+  U8  au8RGBLEDBrightness[ PACKED_SIZE(NUM_RGBLED_COLORS) ];  //!< Brightness of each color, packed
   U8  u8AnimationOpcode;                         //!< Opcode (E_ANIMATION_OPCODE)
   U8  u8AnimationOperand;                        //!< Opcode-specific operand
 } S_ANIMATION_INSTRUCTION_RGB;
@@ -75,545 +108,751 @@ typedef struct
 {
   U8                                         u8AnimationLengthNormal;  //!< How many instructions this animation has for the normal LEDs
   const S_ANIMATION_INSTRUCTION_NORMAL CODE* psInstructionsNormal;     //!< Pointer to the instructions themselves -- normal LEDs
+  U8                                         u8TimeUnitNormal;         //!< Time unit of the instructions in ms, 1..255 -- normal LEDs
+#if BOARD_RGBLED
   U8                                         u8AnimationLengthRGB;     //!< How many instructions this animation has for the RGB LED
   const S_ANIMATION_INSTRUCTION_RGB CODE*    psInstructionsRGB;        //!< Pointer to the instructions themselves -- RGB LED
+  U8                                         u8TimeUnitRGB;            //!< Time unit of the instructions in ms, 1..255 -- RGB LED
+#endif
+  U8                                         u8Options;                //!< Option bits (LOOP_RGB, SLOW_CLOCK), 0 if not given
 } S_ANIMATION;
 
 
 /***************************************< Constants >**************************************/
-//! \brief Retro animation -- normal LEDs
+#if BOARD == BOARD_KARIFA
+//! \brief Retro animation -- normal LEDs, in steps of 133 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasRetroVersion[ 8u ] = 
 {
-  {133u, {15,  0, 15,  0,  0, 15, 15,  0, 15,  0,  0, 15}, LOAD, 0u },
-  {133u, { 0, 15,  0, 15, 15,  0,  0, 15,  0, 15, 15,  0}, LOAD, 0u },
-  {133u, {15,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0}, LOAD, 0u },
-  {133u, { 0, 15,  0, 15, 15,  0,  0, 15,  0, 15, 15,  0}, LOAD, 0u },
-  {133u, {15,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0}, LOAD, 0u },
-  {133u, { 0,  0,  0, 15,  0,  0,  0,  0,  0, 15,  0,  0}, LOAD, 0u },
-  {133u, {15,  0, 15,  0,  0, 15, 15,  0,  0, 15,  0, 15}, LOAD, 0u },
-  {133u, { 0,  0,  0, 15,  0,  0,  0,  0,  0, 15,  0,  0}, LOAD, 0u },
+  {1u, PACK_LEDS(15,  0, 15,  0,  0, 15, 15,  0, 15,  0,  0, 15), LOAD, 0u },
+  {1u, PACK_LEDS( 0, 15,  0, 15, 15,  0,  0, 15,  0, 15, 15,  0), LOAD, 0u },
+  {1u, PACK_LEDS(15,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0), LOAD, 0u },
+  {1u, PACK_LEDS( 0, 15,  0, 15, 15,  0,  0, 15,  0, 15, 15,  0), LOAD, 0u },
+  {1u, PACK_LEDS(15,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0), LOAD, 0u },
+  {1u, PACK_LEDS( 0,  0,  0, 15,  0,  0,  0,  0,  0, 15,  0,  0), LOAD, 0u },
+  {1u, PACK_LEDS(15,  0, 15,  0,  0, 15, 15,  0,  0, 15,  0, 15), LOAD, 0u },
+  {1u, PACK_LEDS( 0,  0,  0, 15,  0,  0,  0,  0,  0, 15,  0,  0), LOAD, 0u },
 };
-//! \brief Retro animation -- RGB LED
+//! \brief Retro animation -- RGB LED, in steps of 133 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasRetroVersionRGB[ 4u ] = 
 {
-  {133u, {15,  0,  0}, LOAD, 0u },
-  {665u, { 0,  0,  0}, LOAD, 0u },
-  {133u, {15,  0,  0}, LOAD, 0u },
-  {133u, { 0,  0,  0}, LOAD, 0u },
+  {1u, PACK_RGB(15,  0,  0), LOAD, 0u },
+  {5u, PACK_RGB( 0,  0,  0), LOAD, 0u },
+  {1u, PACK_RGB(15,  0,  0), LOAD, 0u },
+  {1u, PACK_RGB( 0,  0,  0), LOAD, 0u },
 };
 
 //--------------------------------------------------------
-//! \brief "Sine" wave flasher animation -- normal LEDs
+//! \brief "Sine" wave flasher animation -- normal LEDs, in steps of 125 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasSoftFlashing[ 4u ] = 
 {
-  {125u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,          0u },
-  {125u, { 1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1}, ADD | REPEAT, 14u },
-  {125u, {15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15}, LOAD,          0u }, 
-  {125u, {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,          0u },
+  {1u, PACK_LEDS( 1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS(15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15), LOAD,          0u }, 
+  {1u, PACK_LEDS(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1), ADD | REPEAT, 14u },
 };
-//! \brief "Sine" wave flasher animation -- RGB LED
+//! \brief "Sine" wave flasher animation -- RGB LED, in steps of 125 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasSoftFlashingRGB[ 4u ] = 
 {
-  {125u, { 0,  0,  0}, LOAD,          0u },
-  {125u, { 1,  0,  0}, ADD | REPEAT, 14u },
-  {125u, {15,  0,  0}, LOAD,          0u }, 
-  {125u, {-1,  0,  0}, ADD | REPEAT, 14u },
+  {1u, PACK_RGB( 0,  0,  0), LOAD,          0u },
+  {1u, PACK_RGB( 1,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_RGB(15,  0,  0), LOAD,          0u }, 
+  {1u, PACK_RGB(-1,  0,  0), ADD | REPEAT, 14u },
 };
 
 //--------------------------------------------------------
-//! \brief "Fade ring" animation -- normal LEDs
+//! \brief "Fade ring" animation -- normal LEDs, in steps of 40 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasFadeRing[ 3u ] =
 {
-  { 40u, {15,  1, 15,  1, 15,  1,  1, 15,  1, 15,  1, 15}, LOAD,          0u },
-  { 40u, {-1,  1, -1,  1, -1,  1,  1, -1,  1, -1,  1, -1}, ADD | REPEAT, 13u },
-  { 40u, { 1, -1,  1, -1,  1, -1, -1,  1, -1,  1, -1,  1}, ADD | REPEAT, 13u },
+  {1u, PACK_LEDS(15,  1, 15,  1, 15,  1,  1, 15,  1, 15,  1, 15), LOAD,          0u },
+  {1u, PACK_LEDS(-1,  1, -1,  1, -1,  1,  1, -1,  1, -1,  1, -1), ADD | REPEAT, 13u },
+  {1u, PACK_LEDS( 1, -1,  1, -1,  1, -1, -1,  1, -1,  1, -1,  1), ADD | REPEAT, 13u },
 };
-//! \brief "Fade ring" animation -- RGB LED
+//! \brief "Fade ring" animation -- RGB LED, in steps of 40 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasFadeRingRGB[ 3u ] =
 {
-  { 40u, {15,  1,  0}, LOAD,          0u },
-  { 40u, {-1,  0,  0}, ADD | REPEAT, 13u },
-  { 40u, { 1,  0,  0}, ADD | REPEAT, 13u },
+  {1u, PACK_RGB(15,  1,  0), LOAD,          0u },
+  {1u, PACK_RGB(-1,  0,  0), ADD | REPEAT, 13u },
+  {1u, PACK_RGB( 1,  0,  0), ADD | REPEAT, 13u },
 };
 
 //--------------------------------------------------------
-//! \brief Shooting star anticlockwise animation -- normal LEDs
+//! \brief Shooting star anticlockwise animation -- normal LEDs, in steps of 100 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasShootingStar[ 7u ] = 
 { 
-  {100u, { 5, 10, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 2u },
-  {100u, { 0,  0,  0,  0,  5, 10,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  5, 15,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0, 10, 15,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  5, 10, 15,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 4u },
+  {1u, PACK_LEDS( 5, 10, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,            0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT, 2u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  5, 10,  0,  0,  0,  0,  0,  0), LOAD,            0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  5, 15,  0,  0,  0,  0,  0), LOAD,            0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0, 10, 15,  0,  0,  0,  0), LOAD,            0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  5, 10, 15,  0,  0,  0), LOAD,            0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT, 4u },
 };
-//! \brief Shooting star anticlockwise animation -- RGB LED
+//! \brief Shooting star anticlockwise animation -- RGB LED, in steps of 100 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasShootingStarRGB[ 4u ] = 
 { 
-  {400u, { 0,  0,  0}, LOAD,            0u },
-  {100u, {15,  0,  0}, LOAD,            0u },
-  {100u, {-5,  0,  0}, ADD | REPEAT,    1u },
-  {600u, { 0,  0,  0}, LOAD,            0u },
+  {4u, PACK_RGB( 0,  0,  0), LOAD,            0u },
+  {1u, PACK_RGB(15,  0,  0), LOAD,            0u },
+  {1u, PACK_RGB(-5,  0,  0), ADD | REPEAT,    1u },
+  {6u, PACK_RGB( 0,  0,  0), LOAD,            0u },
 };
 
 //--------------------------------------------------------
-//! \brief Star launch animation -- normal LEDs
+//! \brief Star launch animation -- normal LEDs, in steps of 200 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasStarLaunch[ 5u ] = 
 {
-  {400u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,              0u },
-  {200u, { 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,              0u },
-  {200u, { 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5}, USOURCE | REPEAT, 18u },
-  {200u, {15, 15, 15, 15, 15, 15, 10, 15, 15, 15, 15, 15}, LOAD,              0u },
-  {200u, { 0,  0,  0,  0,  0, -5, -5,  0,  0,  0,  0,  0}, DSOURCE | REPEAT, 16u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,              0u },
+  {1u, PACK_LEDS( 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,              0u },
+  {1u, PACK_LEDS( 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5), USOURCE | REPEAT, 18u },
+  {1u, PACK_LEDS(15, 15, 15, 15, 15, 15, 10, 15, 15, 15, 15, 15), LOAD,              0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0, -5, -5,  0,  0,  0,  0,  0), DSOURCE | REPEAT, 16u },
 };
-//! \brief Star launch animation -- RGB LED
+//! \brief Star launch animation -- RGB LED, in steps of 200 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasStarLaunchRGB[ 5u ] = 
 {
-  {4000u, { 0,  0,  0}, LOAD,         0u},
-  { 800u, {15, 15,  0}, LOAD,         0u},
-  { 200u, { 0, -1,  0}, ADD | REPEAT, 9u},
-  { 200u, {-3, -1,  0}, ADD | REPEAT, 4u},
-  { 200u, { 0,  0,  0}, LOAD,         0u},
+  {20u, PACK_RGB( 0,  0,  0), LOAD,         0u},
+  { 4u, PACK_RGB(15, 15,  0), LOAD,         0u},
+  { 1u, PACK_RGB( 0, -1,  0), ADD | REPEAT, 9u},
+  { 1u, PACK_RGB(-3, -1,  0), ADD | REPEAT, 4u},
+  { 1u, PACK_RGB( 0,  0,  0), LOAD,         0u},
 };
 
 //--------------------------------------------------------
-//! \brief Generic flasher animation -- normal LEDs
+//! \brief Generic flasher animation -- normal LEDs, in steps of 250 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasGenericFlasher[ 2u ] = 
 {
-  {500u, {15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15}, LOAD, 0u }, 
-  {500u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD, 0u },
+  {2u, PACK_LEDS(15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15), LOAD, 0u }, 
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD, 0u },
 };
-//! \brief Generic flasher animation -- RGB LED
+//! \brief Generic flasher animation -- RGB LED, in steps of 250 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasGenericFlasherRGB[ 2u ] = 
 {
-  {500u, { 7,  7,  7}, LOAD, 0u }, 
-  {500u, { 0,  0,  0}, LOAD, 0u },
+  {2u, PACK_RGB( 7,  7,  7), LOAD, 0u }, 
+  {2u, PACK_RGB( 0,  0,  0), LOAD, 0u },
 };
 
 //--------------------------------------------------------
-//! \brief KITT animation -- normal LEDs
+//! \brief KITT animation -- normal LEDs, in steps of 100 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasKITT[ 22u ] = 
 {
-  {200u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {100u, { 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5}, LOAD,  0u },
-  {100u, {10,  5,  0,  0,  0,  0,  0,  0,  0,  0,  5, 10}, LOAD,  0u },
-  {100u, {15, 10,  5,  0,  0,  0,  0,  0,  0,  5, 10, 15}, LOAD,  0u },
-  {100u, {10, 15, 10,  5,  0,  0,  0,  0,  5, 10, 15, 10}, LOAD,  0u },
-  {100u, { 5, 10, 15, 10,  5,  0,  0,  5, 10, 15, 10,  5}, LOAD,  0u },
-  {100u, { 0,  5, 10, 15, 10,  5,  5, 10, 15, 10,  5,  0}, LOAD,  0u },
-  {100u, { 0,  0,  5, 10, 15, 10, 10, 15, 10,  5,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  5, 10, 15, 15, 10,  5,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  0,  5, 10, 10,  5,  0,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  0,  0,  5,  5,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  0,  0,  5,  5,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  0,  5, 10, 10,  5,  0,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  5, 10, 15, 15, 10,  5,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  5, 10, 15, 10, 10, 15, 10,  5,  0,  0}, LOAD,  0u },
-  {100u, { 0,  5, 10, 15, 10,  5,  5, 10, 15, 10,  5,  0}, LOAD,  0u },
-  {100u, { 5, 10, 15, 10,  5,  0,  0,  5, 10, 15, 10,  5}, LOAD,  0u },
-  {100u, {10, 15, 10,  5,  0,  0,  0,  0,  5, 10, 15, 10}, LOAD,  0u },
-  {100u, {15, 10,  5,  0,  0,  0,  0,  0,  0,  5, 10, 15}, LOAD,  0u },
-  {100u, {10,  5,  0,  0,  0,  0,  0,  0,  0,  0,  5, 10}, LOAD,  0u },
-  {100u, { 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5}, LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5), LOAD,  0u },
+  {1u, PACK_LEDS(10,  5,  0,  0,  0,  0,  0,  0,  0,  0,  5, 10), LOAD,  0u },
+  {1u, PACK_LEDS(15, 10,  5,  0,  0,  0,  0,  0,  0,  5, 10, 15), LOAD,  0u },
+  {1u, PACK_LEDS(10, 15, 10,  5,  0,  0,  0,  0,  5, 10, 15, 10), LOAD,  0u },
+  {1u, PACK_LEDS( 5, 10, 15, 10,  5,  0,  0,  5, 10, 15, 10,  5), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  5, 10, 15, 10,  5,  5, 10, 15, 10,  5,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  5, 10, 15, 10, 10, 15, 10,  5,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  5, 10, 15, 15, 10,  5,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  5, 10, 10,  5,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  5,  5,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  5,  5,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  5, 10, 10,  5,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  5, 10, 15, 15, 10,  5,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  5, 10, 15, 10, 10, 15, 10,  5,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  5, 10, 15, 10,  5,  5, 10, 15, 10,  5,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 5, 10, 15, 10,  5,  0,  0,  5, 10, 15, 10,  5), LOAD,  0u },
+  {1u, PACK_LEDS(10, 15, 10,  5,  0,  0,  0,  0,  5, 10, 15, 10), LOAD,  0u },
+  {1u, PACK_LEDS(15, 10,  5,  0,  0,  0,  0,  0,  0,  5, 10, 15), LOAD,  0u },
+  {1u, PACK_LEDS(10,  5,  0,  0,  0,  0,  0,  0,  0,  0,  5, 10), LOAD,  0u },
+  {1u, PACK_LEDS( 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5), LOAD,  0u },
 };
-//! \brief KITT animation -- RGB LED
+//! \brief KITT animation -- RGB LED, in steps of 100 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasKITTRGB[ 4u ] = 
 {
-  { 800u, { 0,  0,  0}, LOAD,         0u },
-  { 100u, { 5,  0,  0}, ADD | REPEAT, 3u },
-  { 100u, {-5,  0,  0}, ADD | REPEAT, 3u },
-  {1300u, { 0,  0,  0}, LOAD,         0u },
+  { 8u, PACK_RGB( 0,  0,  0), LOAD,         0u },
+  { 1u, PACK_RGB( 5,  0,  0), ADD | REPEAT, 3u },
+  { 1u, PACK_RGB(-5,  0,  0), ADD | REPEAT, 3u },
+  {13u, PACK_RGB( 0,  0,  0), LOAD,         0u },
 };
 
 //--------------------------------------------------------
-//! \brief Disco animation -- normal LEDs
+//! \brief Disco animation -- normal LEDs, in steps of 20 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasDisco[ 6u ] = 
 {
-  {40u, {  0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15}, LOAD,         0u },
-  {40u, {  1,  2,  1,  2,  1,  2,  1,  2,  1,  2,  1,  2}, DIV | REPEAT, 3u },
-  {100u,{  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,         0u },
-  {40u, { 15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0}, LOAD,         0u },
-  {40u, {  2,  1,  2,  1,  2,  1,  2,  1,  2,  1,  2,  1}, DIV | REPEAT, 3u },
-  {100u,{  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,         0u },
+  {2u, PACK_LEDS(  0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15), LOAD,         0u },
+  {2u, PACK_LEDS(  1,  2,  1,  2,  1,  2,  1,  2,  1,  2,  1,  2), DIV | REPEAT, 3u },
+  {5u, PACK_LEDS(  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,         0u },
+  {2u, PACK_LEDS( 15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0), LOAD,         0u },
+  {2u, PACK_LEDS(  2,  1,  2,  1,  2,  1,  2,  1,  2,  1,  2,  1), DIV | REPEAT, 3u },
+  {5u, PACK_LEDS(  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,         0u },
 };
-//! \brief Disco animation -- RGB LED
+//! \brief Disco animation -- RGB LED, in steps of 20 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasDiscoRGB[ 6u ] = 
 {
-  { 40u, {15,  0, 15}, LOAD,         0u },
-  { 40u, { 2,  1,  2}, DIV | REPEAT, 3u },
-  {100u, { 0,  0,  0}, LOAD,         0u },
-  { 40u, { 0, 15,  0}, LOAD,         0u },
-  { 40u, { 2,  1,  2}, DIV | REPEAT, 3u },
-  {100u, { 0,  0,  0}, LOAD,         0u },
+  {2u, PACK_RGB(15,  0, 15), LOAD,         0u },
+  {2u, PACK_RGB( 2,  1,  2), DIV | REPEAT, 3u },
+  {5u, PACK_RGB( 0,  0,  0), LOAD,         0u },
+  {2u, PACK_RGB( 0, 15,  0), LOAD,         0u },
+  {2u, PACK_RGB( 2,  1,  2), DIV | REPEAT, 3u },
+  {5u, PACK_RGB( 0,  0,  0), LOAD,         0u },
 };
 
 //--------------------------------------------------------
-//! \brief Pseudo-random fade animation -- normal LEDs
+//! \brief Pseudo-random fade animation -- normal LEDs, in steps of 66 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasPseudoRandomFade[ 15u ] = 
 {
-  { 66u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  { 66u, { 0,  0,  0,  0,  0,  0,  0,  1,  0,  0,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  1,  0,  0,  0,  0, -1,  0,  0,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0, -1,  0,  0,  0,  0,  0,  0,  0,  1,  0}, ADD | REPEAT, 14u },
-  { 66u, { 1,  0,  0,  0,  0,  0,  0,  0,  0,  0, -1,  0}, ADD | REPEAT, 14u },
-  { 66u, {-1,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  0,  0,  0, -1,  0,  1,  0,  0,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  0,  0,  0,  0,  0, -1,  0,  0,  0,  1}, ADD | REPEAT, 14u },
-  { 66u, { 0,  1,  0,  0,  0,  0,  0,  0,  0,  0,  0, -1}, ADD | REPEAT, 14u },
-  { 66u, { 0, -1,  0,  1,  0,  0,  0,  0,  0,  0,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  0, -1,  0,  0,  1,  0,  0,  0,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  0,  0,  0,  0, -1,  0,  0,  0,  0,  0}, ADD | REPEAT, 14u },  //RGB lights up here
-  { 66u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  0,  0,  1,  0,  0,  0,  0, -1,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  0,  0, -1,  0,  0,  0,  0,  0,  0,  0}, ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  1,  0,  0,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  1,  0,  0,  0,  0, -1,  0,  0,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0, -1,  0,  0,  0,  0,  0,  0,  0,  1,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 1,  0,  0,  0,  0,  0,  0,  0,  0,  0, -1,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS(-1,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0, -1,  0,  1,  0,  0,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0, -1,  0,  0,  0,  1), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  1,  0,  0,  0,  0,  0,  0,  0,  0,  0, -1), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0, -1,  0,  1,  0,  0,  0,  0,  0,  0,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0, -1,  0,  0,  1,  0,  0,  0,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0, -1,  0,  0,  0,  0,  0), ADD | REPEAT, 14u },  //RGB lights up here
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  1,  0,  0,  0,  0, -1,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0,  0, -1,  0,  0,  0,  0,  0,  0,  0), ADD | REPEAT, 14u },
 };
-//! \brief Pseudo-random fade animation -- RGB LED
+//! \brief Pseudo-random fade animation -- RGB LED, in steps of 66 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasPseudoRandomFadeRGB[ 4u ] = 
 {
-  { 9966u, { 0,  0,  0}, LOAD,  0u },
-  {   66u, { 1,  0,  0}, ADD | REPEAT, 14u },
-  {   66u, {-1,  0,  0}, ADD | REPEAT, 14u },
-  { 1980u, { 0,  0,  0}, LOAD,  0u },
+  {151u, PACK_RGB( 0,  0,  0), LOAD,  0u },
+  {  1u, PACK_RGB( 1,  0,  0), ADD | REPEAT, 14u },
+  {  1u, PACK_RGB(-1,  0,  0), ADD | REPEAT, 14u },
+  { 30u, PACK_RGB( 0,  0,  0), LOAD,  0u },
 };
 
 //--------------------------------------------------------
-//! \brief CrissCross -- normal LEDs
+//! \brief CrissCross -- normal LEDs, in steps of 175 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasCrissCross[ 12u ] = 
 {
         //0    1   2   3   4   5   6   7   8   9  10  11
-  {350u, {15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15}, LOAD,  0u },
-  {350u, { 0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0, 15,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0}, LOAD,  0u },
+  {2u, PACK_LEDS(15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15), LOAD,  0u },
+  {2u, PACK_LEDS( 0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0, 15,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0), LOAD,  0u },
 };
-//! \brief CrissCross -- RGB LED
+//! \brief CrissCross -- RGB LED, in steps of 210 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasCrissCrossRGB[ 4u ] = 
 {
-  { 1050u, { 0, 15, 15}, LOAD,         0u },
-  { 1050u, {15,  0,  0}, LOAD,         0u },
-  { 1050u, { 2, 10, 10}, LOAD,         0u },
-  { 1050u, {15, 15,  0}, LOAD,         0u },
+  {5u, PACK_RGB( 0, 15, 15), LOAD,         0u },
+  {5u, PACK_RGB(15,  0,  0), LOAD,         0u },
+  {5u, PACK_RGB( 2, 10, 10), LOAD,         0u },
+  {5u, PACK_RGB(15, 15,  0), LOAD,         0u },
 };
 
 //--------------------------------------------------------
-//! \brief Fadeout -- normal LEDs
+//! \brief Fadeout -- normal LEDs, in steps of 175 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasFadeout[ 12u ] = 
 {
-  {350u, { 0,  0,  0,  0,  4,  0,  9,  0,  0, 15,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0, 15,  0,  0,  4,  0,  0,  9,  0,  0}, LOAD,  0u },
-  {350u, {15,  0,  0,  9,  0,  0,  0,  0,  0,  4,  0,  0}, LOAD,  0u },
-  {350u, { 9,  0,  0,  4,  0,  0,  0, 15,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 4,  0,  0,  0,  0,  0,  0,  9,  0,  0,  0, 15}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0,  0,  4, 15,  0,  0,  9}, LOAD,  0u },
-  {350u, { 0,  0, 15,  0,  0,  0,  0,  0,  9,  0,  0,  4}, LOAD,  0u },
-  {350u, { 0,  0,  9,  0,  0,  0,  0,  0,  4,  0, 15,  0}, LOAD,  0u },
-  {350u, { 0,  0,  4,  0,  0, 15,  0,  0,  0,  0,  9,  0}, LOAD,  0u },
-  {350u, { 0, 15,  0,  0,  0,  9,  0,  0,  0,  0,  4,  0}, LOAD,  0u },
-  {350u, { 0,  9,  0,  0, 15,  4,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  4,  0,  0,  9,  0, 15,  0,  0,  0,  0,  0}, LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  4,  0,  9,  0,  0, 15,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0, 15,  0,  0,  4,  0,  0,  9,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS(15,  0,  0,  9,  0,  0,  0,  0,  0,  4,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 9,  0,  0,  4,  0,  0,  0, 15,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 4,  0,  0,  0,  0,  0,  0,  9,  0,  0,  0, 15), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  4, 15,  0,  0,  9), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0, 15,  0,  0,  0,  0,  0,  9,  0,  0,  4), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  9,  0,  0,  0,  0,  0,  4,  0, 15,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  4,  0,  0, 15,  0,  0,  0,  0,  9,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0, 15,  0,  0,  0,  9,  0,  0,  0,  0,  4,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  9,  0,  0, 15,  4,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  4,  0,  0,  9,  0, 15,  0,  0,  0,  0,  0), LOAD,  0u },
 };
-//! \brief Fadeout -- RGB LED
+//! \brief Fadeout -- RGB LED, in steps of 175 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasFadeoutRGB[ 6u ] = 
 {
-  { 700u, {15, 10,  0}, LOAD,         0u },
-  { 700u, {11,  6,  0}, LOAD,         0u },
-  { 700u, { 4,  2,  0}, LOAD,         0u },
-  { 700u, { 0,  0,  0}, LOAD,         0u },
-  { 700u, { 4,  2,  0}, LOAD,         0u },
-  { 700u, {11,  6,  0}, LOAD,         0u },
+  {4u, PACK_RGB(15, 10,  0), LOAD,         0u },
+  {4u, PACK_RGB(11,  6,  0), LOAD,         0u },
+  {4u, PACK_RGB( 4,  2,  0), LOAD,         0u },
+  {4u, PACK_RGB( 0,  0,  0), LOAD,         0u },
+  {4u, PACK_RGB( 4,  2,  0), LOAD,         0u },
+  {4u, PACK_RGB(11,  6,  0), LOAD,         0u },
 };
 
 //--------------------------------------------------------
-//! \brief Flicker -- normal LEDs
+//! \brief Flicker -- normal LEDs, in steps of 200 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasFlicker[ 10u ] = 
 {
-  {200u, { 0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0}, LOAD,  0u },
-  {200u, { 0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {200u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0}, LOAD,  0u },
-  {200u, { 0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {200u, {15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {200u, { 0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {200u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15}, LOAD,  0u },
-  {200u, { 0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0}, LOAD,  0u },
-  {200u, { 0,  0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {200u, { 0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0}, LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS(15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0), LOAD,  0u },
 };
-//! \brief Flicker -- RGB LED
+//! \brief Flicker -- RGB LED, in steps of 100 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasFlickerRGB[ 6u ] = 
 {
-  { 400u, {15,  0,  0}, LOAD,         0u },
-  { 100u, {15, 15,  0}, LOAD,         0u },
-  { 800u, {15,  0,  0}, LOAD,         0u },
-  { 100u, {15, 15,  0}, LOAD,         0u },
-  { 500u, {15,  0,  0}, LOAD,         0u },
-  { 100u, {15, 15,  0}, LOAD,         0u },
+  {4u, PACK_RGB(15,  0,  0), LOAD,         0u },
+  {1u, PACK_RGB(15, 15,  0), LOAD,         0u },
+  {8u, PACK_RGB(15,  0,  0), LOAD,         0u },
+  {1u, PACK_RGB(15, 15,  0), LOAD,         0u },
+  {5u, PACK_RGB(15,  0,  0), LOAD,         0u },
+  {1u, PACK_RGB(15, 15,  0), LOAD,         0u },
 };
 
 //--------------------------------------------------------
-//! \brief Pingpong -- normal LEDs
+//! \brief Pingpong -- normal LEDs, in steps of 175 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasPingpong[ 12u ] = 
 {
-  {175u, {15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT,4u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT,4u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LSHIFT | REPEAT,4u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LSHIFT | REPEAT,4u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
+  {1u, PACK_LEDS(15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT,4u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT,4u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LSHIFT | REPEAT,4u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LSHIFT | REPEAT,4u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
 };
-//! \brief Pingpong -- RGB LED
+//! \brief Pingpong -- RGB LED, in steps of 175 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasPingpongRGB[ 3u ] = 
 {
-  {1050u, {15, 15,  0}, LOAD,         0u },
-  {2450u, { 0, 15, 15}, LOAD,         0u },
-  {1400u, {15, 15,  0}, LOAD,         0u },
+  { 6u, PACK_RGB(15, 15,  0), LOAD,         0u },
+  {14u, PACK_RGB( 0, 15, 15), LOAD,         0u },
+  { 8u, PACK_RGB(15, 15,  0), LOAD,         0u },
 };
 
 //--------------------------------------------------------
-//! \brief Sparkle -- normal LEDs
+//! \brief Sparkle -- normal LEDs, in steps of 200 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasSparkle[ 10u ] = 
 {
-  {200u, { 4,  4,  4,  4, 15,  4,  4,  4,  4,  4,  4,  4}, LOAD,  0u },
-  {200u, { 4, 15,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4}, LOAD,  0u },
-  {200u, { 4,  4,  4,  4,  4,  4, 15,  4,  4,  4,  4,  4}, LOAD,  0u },
-  {200u, { 4,  4,  4,  4,  4,  4,  4,  4,  4,  4, 15,  4}, LOAD,  0u },
-  {200u, { 4,  4, 15,  4,  4,  4,  4,  4,  4,  4,  4,  4}, LOAD,  0u },
-  {200u, {15,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4}, LOAD,  0u },
-  {200u, { 4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4, 15}, LOAD,  0u },
-  {200u, { 4,  4,  4, 15,  4,  4,  4,  4,  4,  4,  4,  4}, LOAD,  0u },
-  {200u, { 4,  4,  4,  4,  4,  4,  4,  4,  4, 15,  4,  4}, LOAD,  0u },
-  {200u, { 4,  4,  4,  4,  4, 15,  4,  4,  4,  4,  4,  4}, LOAD,  0u },
+  {1u, PACK_LEDS( 4,  4,  4,  4, 15,  4,  4,  4,  4,  4,  4,  4), LOAD,  0u },
+  {1u, PACK_LEDS( 4, 15,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4), LOAD,  0u },
+  {1u, PACK_LEDS( 4,  4,  4,  4,  4,  4, 15,  4,  4,  4,  4,  4), LOAD,  0u },
+  {1u, PACK_LEDS( 4,  4,  4,  4,  4,  4,  4,  4,  4,  4, 15,  4), LOAD,  0u },
+  {1u, PACK_LEDS( 4,  4, 15,  4,  4,  4,  4,  4,  4,  4,  4,  4), LOAD,  0u },
+  {1u, PACK_LEDS(15,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4), LOAD,  0u },
+  {1u, PACK_LEDS( 4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4, 15), LOAD,  0u },
+  {1u, PACK_LEDS( 4,  4,  4, 15,  4,  4,  4,  4,  4,  4,  4,  4), LOAD,  0u },
+  {1u, PACK_LEDS( 4,  4,  4,  4,  4,  4,  4,  4,  4, 15,  4,  4), LOAD,  0u },
+  {1u, PACK_LEDS( 4,  4,  4,  4,  4, 15,  4,  4,  4,  4,  4,  4), LOAD,  0u },
 };
-//! \brief Sparkle -- RGB LED
+//! \brief Sparkle -- RGB LED, in steps of 250 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasSparkleRGB[ 6u ] = 
 {
-  { 500u, {15,  0,  0}, LOAD,         0u },
-  { 250u, {15,  3,  1}, LOAD,         0u },
-  { 250u, {15,  6,  2}, LOAD,         0u },
-  { 500u, {15, 10,  3}, LOAD,         0u },
-  { 250u, {15,  6,  2}, LOAD,         0u },
-  { 250u, {15,  3,  1}, LOAD,         0u },
+  {2u, PACK_RGB(15,  0,  0), LOAD,         0u },
+  {1u, PACK_RGB(15,  3,  1), LOAD,         0u },
+  {1u, PACK_RGB(15,  6,  2), LOAD,         0u },
+  {2u, PACK_RGB(15, 10,  3), LOAD,         0u },
+  {1u, PACK_RGB(15,  6,  2), LOAD,         0u },
+  {1u, PACK_RGB(15,  3,  1), LOAD,         0u },
 };
 
 //--------------------------------------------------------
-//! \brief Split2 -- normal LEDs
+//! \brief Split2 -- normal LEDs, in steps of 250 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasSplit2[ 2u ] = 
 {
-  {500u, {15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0}, LOAD,  0u },
-  {500u, { 0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15}, LOAD,  0u },
+  {2u, PACK_LEDS(15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15), LOAD,  0u },
 };
-//! \brief Split2 -- RGB LED
+//! \brief Split2 -- RGB LED, in steps of 3 ms; the last color is held until the restart with the normal LEDs
 CODE const S_ANIMATION_INSTRUCTION_RGB gasSplit2RGB[ 3u ] = 
 {
-  { 333u, {15,  0, 15}, LOAD,         0u },
-  { 333u, { 0, 15, 15}, LOAD,         0u },
-  { 334u, {15, 15,  0}, LOAD,         0u },
+  {111u, PACK_RGB(15,  0, 15), LOAD,         0u },
+  {111u, PACK_RGB( 0, 15, 15), LOAD,         0u },
+  {111u, PACK_RGB(15, 15,  0), LOAD,         0u },
 };
 
 /*
 //--------------------------------------------------------
-//! \brief Split3fade -- normal LEDs
+//! \brief Split3fade -- normal LEDs, in steps of 250 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasSplit3fade[ 6u ] = 
 {
-  {500u, {15,  4,  0, 15,  4,  0, 15,  4,  0, 15,  4,  0}, LOAD,  0u },
-  {500u, { 0, 15,  4,  0, 15,  4,  0, 15,  4,  0, 15,  4}, LOAD,  0u },
-  {500u, { 0,  0, 15,  4,  0, 15,  4,  0, 15,  4,  0, 15}, LOAD,  0u },
-  {500u, {15,  4,  0, 15,  4,  0, 15,  4,  0, 15,  4,  0}, LOAD,  0u },
-  {500u, { 0, 15,  4,  0, 15,  4,  0, 15,  4,  0, 15,  4}, LOAD,  0u },
-  {500u, { 0,  0, 15,  4,  0, 15,  4,  0, 15,  4,  0, 15}, LOAD,  0u },
+  {2u, PACK_LEDS(15,  4,  0, 15,  4,  0, 15,  4,  0, 15,  4,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0, 15,  4,  0, 15,  4,  0, 15,  4,  0, 15,  4), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0, 15,  4,  0, 15,  4,  0, 15,  4,  0, 15), LOAD,  0u },
+  {2u, PACK_LEDS(15,  4,  0, 15,  4,  0, 15,  4,  0, 15,  4,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0, 15,  4,  0, 15,  4,  0, 15,  4,  0, 15,  4), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0, 15,  4,  0, 15,  4,  0, 15,  4,  0, 15), LOAD,  0u },
 };
-//! \brief Split3fade -- RGB LED
+//! \brief Split3fade -- RGB LED, in steps of 250 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasSplit3fadeRGB[ 6u ] = 
 {
-  { 500u, {15,  0, 15}, LOAD,         0u },
-  { 500u, { 7,  7, 15}, LOAD,         0u },
-  { 500u, { 0, 15, 15}, LOAD,         0u },
-  { 500u, { 7, 15,  7}, LOAD,         0u },
-  { 500u, {15, 15,  0}, LOAD,         0u },
-  { 500u, {15,  7,  7}, LOAD,         0u },
+  {2u, PACK_RGB(15,  0, 15), LOAD,         0u },
+  {2u, PACK_RGB( 7,  7, 15), LOAD,         0u },
+  {2u, PACK_RGB( 0, 15, 15), LOAD,         0u },
+  {2u, PACK_RGB( 7, 15,  7), LOAD,         0u },
+  {2u, PACK_RGB(15, 15,  0), LOAD,         0u },
+  {2u, PACK_RGB(15,  7,  7), LOAD,         0u },
 };
 */
 
 //--------------------------------------------------------
-//! \brief Stepping -- normal LEDs
+//! \brief Stepping -- normal LEDs, in steps of 175 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasStepping[ 2u ] = 
 {
-  {350u, {15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT,10u },
+  {2u, PACK_LEDS(15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT,10u },
 };
 
 
-//! \brief Stepping -- RGB LED
+//! \brief Stepping -- RGB LED, in steps of 175 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasSteppingRGB[ 11u ] = 
 {
-  { 350u, {15,  0,  0}, LOAD,         0u },
-  { 350u, {15,  6,  0}, LOAD,         0u },
-  { 350u, {15, 10,  0}, LOAD,         0u },
-  { 350u, {15, 15,  0}, LOAD,         0u },
-  { 350u, { 0, 15,  0}, LOAD,         0u },
-  { 350u, { 0, 10,  0}, LOAD,         0u },
-  { 350u, { 2, 10, 10}, LOAD,         0u },
-  { 350u, { 0, 15, 15}, LOAD,         0u },
-  { 350u, { 7,  5, 10}, LOAD,         0u },
-  { 350u, {15,  0, 15}, LOAD,         0u },
-  { 350u, {15, 12, 12}, LOAD,         0u },
+  {2u, PACK_RGB(15,  0,  0), LOAD,         0u },
+  {2u, PACK_RGB(15,  6,  0), LOAD,         0u },
+  {2u, PACK_RGB(15, 10,  0), LOAD,         0u },
+  {2u, PACK_RGB(15, 15,  0), LOAD,         0u },
+  {2u, PACK_RGB( 0, 15,  0), LOAD,         0u },
+  {2u, PACK_RGB( 0, 10,  0), LOAD,         0u },
+  {2u, PACK_RGB( 2, 10, 10), LOAD,         0u },
+  {2u, PACK_RGB( 0, 15, 15), LOAD,         0u },
+  {2u, PACK_RGB( 7,  5, 10), LOAD,         0u },
+  {2u, PACK_RGB(15,  0, 15), LOAD,         0u },
+  {2u, PACK_RGB(15, 12, 12), LOAD,         0u },
 };
 
 //--------------------------------------------------------
-//! \brief Race -- A trace is circulating and accelerating
+//! \brief Race -- A trace is circulating and accelerating, in steps of 10 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasRace[ 21u ] = 
 {
-  {100u, { 5, 10, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 2u },
-  {100u, { 0,  0,  0,  0,  5, 10,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  5, 15,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0, 10, 15,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  5, 10, 15,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 4u },
-  {70u, { 5, 10, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {70u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 2u },
-  {70u, { 0,  0,  0,  0,  5, 10,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {70u, { 0,  0,  0,  0,  0,  5, 15,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {70u, { 0,  0,  0,  0,  0,  0, 10, 15,  0,  0,  0,  0}, LOAD,            0u },
-  {70u, { 0,  0,  0,  0,  0,  0,  5, 10, 15,  0,  0,  0}, LOAD,            0u },
-  {70u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 4u },
-  {40u, { 5, 10, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {40u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 2u },
-  {40u, { 0,  0,  0,  0,  5, 10,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {40u, { 0,  0,  0,  0,  0,  5, 15,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {40u, { 0,  0,  0,  0,  0,  0, 10, 15,  0,  0,  0,  0}, LOAD,            0u },
-  {40u, { 0,  0,  0,  0,  0,  0,  5, 10, 15,  0,  0,  0}, LOAD,            0u },
-  {40u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 4u },
+  {10u, PACK_LEDS( 5, 10, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,            0u },
+  {10u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT, 2u },
+  {10u, PACK_LEDS( 0,  0,  0,  0,  5, 10,  0,  0,  0,  0,  0,  0), LOAD,            0u },
+  {10u, PACK_LEDS( 0,  0,  0,  0,  0,  5, 15,  0,  0,  0,  0,  0), LOAD,            0u },
+  {10u, PACK_LEDS( 0,  0,  0,  0,  0,  0, 10, 15,  0,  0,  0,  0), LOAD,            0u },
+  {10u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  5, 10, 15,  0,  0,  0), LOAD,            0u },
+  {10u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT, 4u },
+  { 7u, PACK_LEDS( 5, 10, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,            0u },
+  { 7u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT, 2u },
+  { 7u, PACK_LEDS( 0,  0,  0,  0,  5, 10,  0,  0,  0,  0,  0,  0), LOAD,            0u },
+  { 7u, PACK_LEDS( 0,  0,  0,  0,  0,  5, 15,  0,  0,  0,  0,  0), LOAD,            0u },
+  { 7u, PACK_LEDS( 0,  0,  0,  0,  0,  0, 10, 15,  0,  0,  0,  0), LOAD,            0u },
+  { 7u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  5, 10, 15,  0,  0,  0), LOAD,            0u },
+  { 7u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT, 4u },
+  { 4u, PACK_LEDS( 5, 10, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,            0u },
+  { 4u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT, 2u },
+  { 4u, PACK_LEDS( 0,  0,  0,  0,  5, 10,  0,  0,  0,  0,  0,  0), LOAD,            0u },
+  { 4u, PACK_LEDS( 0,  0,  0,  0,  0,  5, 15,  0,  0,  0,  0,  0), LOAD,            0u },
+  { 4u, PACK_LEDS( 0,  0,  0,  0,  0,  0, 10, 15,  0,  0,  0,  0), LOAD,            0u },
+  { 4u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  5, 10, 15,  0,  0,  0), LOAD,            0u },
+  { 4u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT, 4u },
 };
-//! \brief Race -- RGB
+//! \brief Race -- RGB, in steps of 10 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasRaceRGB[ 12u ] = 
 { 
-  {400u, { 0,  0,  0}, LOAD,            0u },
-  {100u, {15,  0,  0}, LOAD,            0u },
-  {100u, {-5,  0,  0}, ADD | REPEAT,    1u },
-  {600u, { 0,  0,  0}, LOAD,            0u },
+  {40u, PACK_RGB( 0,  0,  0), LOAD,            0u },
+  {10u, PACK_RGB(15,  0,  0), LOAD,            0u },
+  {10u, PACK_RGB(-5,  0,  0), ADD | REPEAT,    1u },
+  {60u, PACK_RGB( 0,  0,  0), LOAD,            0u },
   
-  {280u, { 0,  0,  0}, LOAD,            0u },
-  {70u, {15,  0,  0}, LOAD,            0u },
-  {70u, {-5,  0,  0}, ADD | REPEAT,    1u },
-  {420u, { 0,  0,  0}, LOAD,            0u },
-
-  {160u, { 0,  0,  0}, LOAD,            0u },
-  {40u, {15,  0,  0}, LOAD,            0u },
-  {40u, {-5,  0,  0}, ADD | REPEAT,    1u },
-  {240u, { 0,  0,  0}, LOAD,            0u },
+  {28u, PACK_RGB( 0,  0,  0), LOAD,            0u },
+  { 7u, PACK_RGB(15,  0,  0), LOAD,            0u },
+  { 7u, PACK_RGB(-5,  0,  0), ADD | REPEAT,    1u },
+  {42u, PACK_RGB( 0,  0,  0), LOAD,            0u },
+
+  {16u, PACK_RGB( 0,  0,  0), LOAD,            0u },
+  { 4u, PACK_RGB(15,  0,  0), LOAD,            0u },
+  { 4u, PACK_RGB(-5,  0,  0), ADD | REPEAT,    1u },
+  {24u, PACK_RGB( 0,  0,  0), LOAD,            0u },
 };
 
 //--------------------------------------------------------
-//! \brief Ying-yang
+//! \brief Ying-yang, in steps of 150 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasYingYang[ 2u ] = 
 {
-  {150u, { 0,  5, 10, 15,  0,  0,  0,  5, 10, 15,  0,  0}, LOAD,            0u },
-  {150u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 4u },
+  {1u, PACK_LEDS( 0,  5, 10, 15,  0,  0,  0,  5, 10, 15,  0,  0), LOAD,            0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT, 4u },
 };
-//! \brief Ying Yang RGB
+//! \brief Ying Yang RGB, in steps of 225 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasYingYangRGB[ 2u ] = 
 {
-  { 450u, {2, 6, 15}, LOAD,        0u },
-  { 450u, { 15,  8,  1}, LOAD,     0u },
+  {2u, PACK_RGB(2, 6, 15), LOAD,        0u },
+  {2u, PACK_RGB( 15,  8,  1), LOAD,     0u },
 };
 
 //--------------------------------------------------------
-//! \brief Ice
+//! \brief Ice, in steps of 150 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasIce[ 11u ] = 
 {
-  {300u, { 0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {300u, { 0,  0,  0,  0, 15, 10,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {300u, { 0,  0,  0, 15, 10,  5, 15,  0,  0,  0,  0,  0}, LOAD, 0u },
-  {300u, { 0,  0, 15, 10,  5,  0, 10, 15,  0,  0,  0,  0}, LOAD, 0u },
-  {300u, { 0, 15, 10,  5,  0,  0,  5, 10, 15,  0,  0,  0}, LOAD, 0u },
-  {300u, {15, 10,  5,  0,  0,  0,  0,  5, 10, 15,  0,  0}, LOAD, 0u },
-  {300u, {15,  5,  0,  0,  0,  0,  0,  0,  5, 10, 15,  0}, LOAD, 0u },
-  {300u, {15,  0,  0,  0,  0,  0,  0,  0,  0,  5, 10, 15}, LOAD, 0u },
-  {300u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5, 15}, LOAD, 0u },
-  {300u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15}, LOAD, 0u },
-  {300u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0, 15, 10,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0, 15, 10,  5, 15,  0,  0,  0,  0,  0), LOAD, 0u },
+  {2u, PACK_LEDS( 0,  0, 15, 10,  5,  0, 10, 15,  0,  0,  0,  0), LOAD, 0u },
+  {2u, PACK_LEDS( 0, 15, 10,  5,  0,  0,  5, 10, 15,  0,  0,  0), LOAD, 0u },
+  {2u, PACK_LEDS(15, 10,  5,  0,  0,  0,  0,  5, 10, 15,  0,  0), LOAD, 0u },
+  {2u, PACK_LEDS(15,  5,  0,  0,  0,  0,  0,  0,  5, 10, 15,  0), LOAD, 0u },
+  {2u, PACK_LEDS(15,  0,  0,  0,  0,  0,  0,  0,  0,  5, 10, 15), LOAD, 0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5, 15), LOAD, 0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15), LOAD, 0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
 };
-//! \brief Ice
+//! \brief Ice, in steps of 2 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasIceRGB[ 2u ] = 
 {
-  { 194u, {0, 15, 15}, LOAD,        0u },
-  { 194u, { 0,  -1,  0}, ADD | REPEAT,     15u },
-//  { 88u, {0, 0, 15}, LOAD,        0u },
-//  { 88u, { 0,  1,  0}, ADD | REPEAT,     15u },
+  {97u, PACK_RGB(0, 15, 15), LOAD,        0u },
+  {97u, PACK_RGB( 0,  -1,  0), ADD | REPEAT,     15u },
+//  {44u, PACK_RGB(0, 0, 15), LOAD,        0u },
+//  {44u, PACK_RGB( 0,  1,  0), ADD | REPEAT,     15u },
 };
 
 //--------------------------------------------------------
-//! \brief All blackness, reached right before going to power down mode -- normal LEDs
+//! \brief All blackness, reached right before going to power down mode -- normal LEDs, in steps of 255 ms
 CODE const S_ANIMATION_INSTRUCTION_NORMAL gasBlackness[ 1u ] =
 {
-  {0xFFFFu, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD, 0u },
+  {255u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD, 0u },
 };
-//! \brief All blackness, reached right before going to power down mode -- RGB LED
+//! \brief All blackness, reached right before going to power down mode -- RGB LED, in steps of 255 ms
 CODE const S_ANIMATION_INSTRUCTION_RGB gasBlacknessRGB[ 1u ] =
 {
-  {0xFFFFu, { 0,  0,  0}, LOAD, 0u },
+  {255u, PACK_RGB( 0,  0,  0), LOAD, 0u },
+};
+
+// *******************************************************
+//! \brief Table of animations
+CODE const S_ANIMATION gasAnimations[ NUM_ANIMATIONS ] = 
+{
+  {sizeof(gasRetroVersion)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasRetroVersion, 133u,     sizeof(gasRetroVersionRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasRetroVersionRGB, 133u },
+  {sizeof(gasSoftFlashing)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSoftFlashing, 125u,     sizeof(gasSoftFlashingRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSoftFlashingRGB, 125u },
+//  {sizeof(gasShootingStar)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasShootingStar, 100u,     sizeof(gasShootingStarRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasShootingStarRGB, 100u },
+  {sizeof(gasDisco)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),            gasDisco,  20u,            sizeof(gasDiscoRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),            gasDiscoRGB,  20u },
+  {sizeof(gasStarLaunch)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),       gasStarLaunch, 200u,       sizeof(gasStarLaunchRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),       gasStarLaunchRGB, 200u },
+  {sizeof(gasCrissCross)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),       gasCrissCross, 175u,       sizeof(gasCrissCrossRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),       gasCrissCrossRGB, 210u },
+  {sizeof(gasGenericFlasher)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),   gasGenericFlasher, 250u,   sizeof(gasGenericFlasherRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),   gasGenericFlasherRGB, 250u },
+  {sizeof(gasKITT)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),             gasKITT, 100u,             sizeof(gasKITTRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),             gasKITTRGB, 100u },
+  {sizeof(gasPingpong)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasPingpong, 175u,     sizeof(gasPingpongRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasPingpongRGB, 175u },
+  {sizeof(gasFadeRing)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),         gasFadeRing,  40u,         sizeof(gasFadeRingRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),         gasFadeRingRGB,  40u },
+  {sizeof(gasYingYang)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasYingYang, 150u,     sizeof(gasYingYangRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasYingYangRGB, 225u },
+  {sizeof(gasPseudoRandomFade)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL), gasPseudoRandomFade,  66u, sizeof(gasPseudoRandomFadeRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB), gasPseudoRandomFadeRGB,  66u },
+
+//  {sizeof(gasFadeout)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasFadeout, 175u,     sizeof(gasFadeoutRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasFadeoutRGB, 175u },
+  {sizeof(gasFlicker)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasFlicker, 200u,     sizeof(gasFlickerRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasFlickerRGB, 100u },
+  {sizeof(gasRace)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasRace,  10u,     sizeof(gasRaceRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasRaceRGB,  10u },
+  {sizeof(gasSparkle)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSparkle, 200u,     sizeof(gasSparkleRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSparkleRGB, 250u },
+  {sizeof(gasIce)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasIce, 150u,     sizeof(gasIceRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasIceRGB,   2u },
+  {sizeof(gasSplit2)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSplit2, 250u,     sizeof(gasSplit2RGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSplit2RGB,   3u },
+//  {sizeof(gasSplit3fade)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSplit3fade, 250u,     sizeof(gasSplit3fadeRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSplit3fadeRGB, 250u },
+  {sizeof(gasStepping)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasStepping, 175u,     sizeof(gasSteppingRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSteppingRGB, 175u },
+
+  // Last animation, don't change its location
+  {sizeof(gasBlackness)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),        gasBlackness, 255u,        sizeof(gasBlacknessRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),        gasBlacknessRGB, 255u,        SLOW_CLOCK }
+};
+
+#elif BOARD == BOARD_HULLOCSILLAG
+//--------------------------------------------------------
+//! \brief "Sine" wave flasher animation -- normal LEDs, in steps of 125 ms
+CODE const S_ANIMATION_INSTRUCTION_NORMAL gasSoftFlashing[ 4u ] = 
+{
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,          0u },
+  {1u, PACK_LEDS( 1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS(15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15), LOAD,          0u }, 
+  {1u, PACK_LEDS(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1), ADD | REPEAT, 14u },
+};
+
+//--------------------------------------------------------
+//! \brief "Fade ring" animation -- normal LEDs, in steps of 40 ms
+CODE const S_ANIMATION_INSTRUCTION_NORMAL gasFadeRing[ 3u ] =
+{
+  {1u, PACK_LEDS(15,  1, 15,  1, 15,  1, 15,  1, 15,  1, 15,  1), LOAD,          0u },
+  {1u, PACK_LEDS(-1,  1, -1,  1, -1,  1, -1,  1, -1,  1, -1,  1), ADD | REPEAT, 13u },
+  {1u, PACK_LEDS( 1, -1,  1, -1,  1, -1,  1, -1,  1, -1,  1, -1), ADD | REPEAT, 13u },
+};
+
+//--------------------------------------------------------
+//! \brief Shooting star clockwise animation -- normal LEDs, in steps of 50 ms: half a LED a step, the
+//!        trail keeps 3/4 of its level; its halves go on where the previous one has ended
+CODE const S_ANIMATION_INSTRUCTION_NORMAL gasShootingStar[ 2u ] = 
+{ 
+  {1u, PACK_TRAIL(  0, 8, 2, 15), TRAIL | REPEAT, 11u },
+  {1u, PACK_TRAIL( 96, 8, 2, 15), TRAIL | REPEAT, 11u },
+};
+
+//--------------------------------------------------------
+//! \brief Generic flasher animation -- normal LEDs, in steps of 250 ms
+CODE const S_ANIMATION_INSTRUCTION_NORMAL gasGenericFlasher[ 2u ] = 
+{
+  {2u, PACK_LEDS(15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15), LOAD, 0u }, 
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD, 0u },
+};
+
+//--------------------------------------------------------
+//! \brief KITT animation -- normal LEDs, in steps of 100 ms
+CODE const S_ANIMATION_INSTRUCTION_NORMAL gasKITT[ 11u ] = 
+{
+/*
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5), LOAD,  0u },
+  {1u, PACK_LEDS(10,  5,  0,  0,  0,  0,  0,  0,  0,  0,  5, 10), LOAD,  0u },
+  {1u, PACK_LEDS(15, 10,  5,  0,  0,  0,  0,  0,  0,  5, 10, 15), LOAD,  0u },
+  {1u, PACK_LEDS(10, 15, 10,  5,  0,  0,  0,  0,  5, 10, 15, 10), LOAD,  0u },
+  {1u, PACK_LEDS( 5, 10, 15, 10,  5,  0,  0,  5, 10, 15, 10,  5), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  5, 10, 15, 10,  5,  5, 10, 15, 10,  5,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  5, 10, 15, 10, 10, 15, 10,  5,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  5, 10, 15, 15, 10,  5,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  5, 10, 10,  5,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  5,  5,  0,  0,  0,  0,  0), LOAD,  0u },
+*/
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  5,  5,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  5, 10, 10,  5,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  5, 10, 15, 15, 10,  5,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  5, 10, 15, 10, 10, 15, 10,  5,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  5, 10, 15, 10,  5,  5, 10, 15, 10,  5,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 5, 10, 15, 10,  5,  0,  0,  5, 10, 15, 10,  5), LOAD,  0u },
+  {1u, PACK_LEDS(10, 15, 10,  5,  0,  0,  0,  0,  5, 10, 15, 10), LOAD,  0u },
+  {1u, PACK_LEDS(15, 10,  5,  0,  0,  0,  0,  0,  0,  5, 10, 15), LOAD,  0u },
+  {1u, PACK_LEDS(10,  5,  0,  0,  0,  0,  0,  0,  0,  0,  5, 10), LOAD,  0u },
+  {1u, PACK_LEDS( 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5), LOAD,  0u },
+};
+
+//--------------------------------------------------------
+//! \brief Disco animation -- normal LEDs, in steps of 20 ms
+CODE const S_ANIMATION_INSTRUCTION_NORMAL gasDisco[ 6u ] = 
+{
+  {2u, PACK_LEDS(  0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15), LOAD,         0u },
+  {2u, PACK_LEDS(  1,  2,  1,  2,  1,  2,  1,  2,  1,  2,  1,  2), DIV | REPEAT, 3u },
+  {5u,PACK_LEDS(  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,         0u },
+  {2u, PACK_LEDS( 15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0), LOAD,         0u },
+  {2u, PACK_LEDS(  2,  1,  2,  1,  2,  1,  2,  1,  2,  1,  2,  1), DIV | REPEAT, 3u },
+  {5u,PACK_LEDS(  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,         0u },
+};
+
+//--------------------------------------------------------
+//! \brief Pseudo-random fade animation -- normal LEDs, in steps of 66 ms
+CODE const S_ANIMATION_INSTRUCTION_NORMAL gasPseudoRandomFade[ 15u ] = 
+{
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  1,  0,  0,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  1,  0,  0,  0,  0, -1,  0,  0,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0, -1,  0,  0,  0,  0,  0,  0,  0,  1,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 1,  0,  0,  0,  0,  0,  0,  0,  0,  0, -1,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS(-1,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0, -1,  0,  1,  0,  0,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0, -1,  0,  0,  0,  1), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  1,  0,  0,  0,  0,  0,  0,  0,  0,  0, -1), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0, -1,  0,  1,  0,  0,  0,  0,  0,  0,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0, -1,  0,  0,  1,  0,  0,  0,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0, -1,  0,  0,  0,  0,  0), ADD | REPEAT, 14u },  //RGB lights up here
+  {1u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0,  0,  1,  0,  0,  0,  0, -1,  0,  0), ADD | REPEAT, 14u },
+  {1u, PACK_LEDS( 0,  0,  0,  0, -1,  0,  0,  0,  0,  0,  0,  0), ADD | REPEAT, 14u },
+};
+
+//--------------------------------------------------------
+//! \brief CrissCross -- normal LEDs, in steps of 175 ms
+CODE const S_ANIMATION_INSTRUCTION_NORMAL gasCrissCross[ 12u ] = 
+{
+        //0    1   2   3   4   5   6   7   8   9  10  11
+  {2u, PACK_LEDS(15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15), LOAD,  0u },
+};
+
+//--------------------------------------------------------
+//! \brief Pingpong -- normal LEDs, in steps of 175 ms
+CODE const S_ANIMATION_INSTRUCTION_NORMAL gasPingpong[ 4u ] = 
+{
+  {2u, PACK_LEDS(15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT, 10u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LSHIFT | REPEAT, 10u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15), LOAD,  0u },
+};
+
+//--------------------------------------------------------
+//! \brief Ice -- normal LEDs, in steps of 50 ms
+CODE const S_ANIMATION_INSTRUCTION_NORMAL gasIce[ 10u ] = 
+{
+        //0    1   2   3   4   5   6   7   8   9  10  11
+  {18u, PACK_LEDS( 0,  0,  0, 15,  15, 15, 15, 15,  0,  0,  0,  0), LOAD,  0u },
+  { 7u, PACK_LEDS( 0,  0,  0, 15,  15, 15, 15, 15, 15,  0,  0,  0), LOAD,  0u },
+  { 7u, PACK_LEDS( 0,  0,  0, 15,  15, 15, 15, 15,  9, 15,  0,  0), LOAD,  0u },
+  { 7u, PACK_LEDS( 0,  0,  0, 15,  15, 15, 15, 15,  1,  9, 15,  0), LOAD,  0u },
+  { 7u, PACK_LEDS( 0,  0,  0, 15,  15, 15, 15, 15,  0,  1,  9,  0), LOAD,  0u },
+  { 7u, PACK_LEDS( 0,  0, 15, 15,  15, 15, 15, 15,  0,  0,  1,  0), LOAD,  0u },
+  { 7u, PACK_LEDS( 0, 15,  9, 15,  15, 15, 15, 15,  0,  0,  0,  0), LOAD,  0u },
+  { 7u, PACK_LEDS(15,  9,  1, 15,  15, 15, 15, 15,  0,  0,  0,  0), LOAD,  0u },
+  { 7u, PACK_LEDS( 9,  1,  0, 15,  15, 15, 15, 15,  0,  0,  0,  0), LOAD,  0u },
+  { 7u, PACK_LEDS( 1,  0,  0, 15,  15, 15, 15, 15,  0,  0,  0,  0), LOAD,  0u },
+};
+
+//--------------------------------------------------------
+//! \brief YingYang -- the ying and the yang start on opposite sides and circle around, in steps of 175 ms
+CODE const S_ANIMATION_INSTRUCTION_NORMAL gasYingYang[ 2u ] = 
+{
+  {2u, PACK_LEDS(15,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0), LOAD,  0u },
+  {2u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), RSHIFT | REPEAT, 4u },
+};
+
+//--------------------------------------------------------
+//! \brief All blackness, reached right before going to power down mode -- normal LEDs, in steps of 255 ms
+CODE const S_ANIMATION_INSTRUCTION_NORMAL gasBlackness[ 1u ] =
+{
+  {255u, PACK_LEDS( 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0), LOAD, 0u },
 };
 
 // *******************************************************
 //! \brief Table of animations
 CODE const S_ANIMATION gasAnimations[ NUM_ANIMATIONS ] = 
 {
-  {sizeof(gasRetroVersion)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasRetroVersion,     sizeof(gasRetroVersionRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasRetroVersionRGB },
-  {sizeof(gasSoftFlashing)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSoftFlashing,     sizeof(gasSoftFlashingRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSoftFlashingRGB },
-//  {sizeof(gasShootingStar)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasShootingStar,     sizeof(gasShootingStarRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasShootingStarRGB },
-  {sizeof(gasDisco)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),            gasDisco,            sizeof(gasDiscoRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),            gasDiscoRGB },
-  {sizeof(gasStarLaunch)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),       gasStarLaunch,       sizeof(gasStarLaunchRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),       gasStarLaunchRGB },
-  {sizeof(gasCrissCross)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),       gasCrissCross,       sizeof(gasCrissCrossRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),       gasCrissCrossRGB },
-  {sizeof(gasGenericFlasher)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),   gasGenericFlasher,   sizeof(gasGenericFlasherRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),   gasGenericFlasherRGB },
-  {sizeof(gasKITT)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),             gasKITT,             sizeof(gasKITTRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),             gasKITTRGB },
-  {sizeof(gasPingpong)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasPingpong,     sizeof(gasPingpongRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasPingpongRGB },
-  {sizeof(gasFadeRing)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),         gasFadeRing,         sizeof(gasFadeRingRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),         gasFadeRingRGB },
-  {sizeof(gasYingYang)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasYingYang,     sizeof(gasYingYangRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasYingYangRGB },
-  {sizeof(gasPseudoRandomFade)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL), gasPseudoRandomFade, sizeof(gasPseudoRandomFadeRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB), gasPseudoRandomFadeRGB },
-
-//  {sizeof(gasFadeout)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasFadeout,     sizeof(gasFadeoutRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasFadeoutRGB },
-  {sizeof(gasFlicker)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasFlicker,     sizeof(gasFlickerRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasFlickerRGB },
-  {sizeof(gasRace)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasRace,     sizeof(gasRaceRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasRaceRGB },
-  {sizeof(gasSparkle)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSparkle,     sizeof(gasSparkleRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSparkleRGB },
-  {sizeof(gasIce)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasIce,     sizeof(gasIceRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasIceRGB },
-  {sizeof(gasSplit2)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSplit2,     sizeof(gasSplit2RGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSplit2RGB },
-//  {sizeof(gasSplit3fade)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSplit3fade,     sizeof(gasSplit3fadeRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSplit3fadeRGB },
-  {sizeof(gasStepping)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasStepping,     sizeof(gasSteppingRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSteppingRGB },
+  {sizeof(gasSoftFlashing)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSoftFlashing, 125u },
+  {sizeof(gasShootingStar)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasShootingStar,  50u },
+  {sizeof(gasGenericFlasher)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),   gasGenericFlasher, 250u },
+  {sizeof(gasKITT)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),             gasKITT, 100u },
+  {sizeof(gasDisco)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),            gasDisco,  20u },
+  {sizeof(gasFadeRing)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),         gasFadeRing,  40u },
+  {sizeof(gasPseudoRandomFade)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL), gasPseudoRandomFade,  66u },
 
+  {sizeof(gasCrissCross)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),       gasCrissCross, 175u },
+  {sizeof(gasPingpong)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),         gasPingpong, 175u },
+  {sizeof(gasIce)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),              gasIce,  50u },
+  {sizeof(gasYingYang)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),         gasYingYang, 175u },
+  
   // Last animation, don't change its location
-  {sizeof(gasBlackness)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),        gasBlackness,        sizeof(gasBlacknessRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),        gasBlackness }
+  {sizeof(gasBlackness)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),        gasBlackness, 255u,        SLOW_CLOCK }
 };
+#endif
 
 
 /***************************************< Global variables >**************************************/
-IDATA U16 gu16NormalTimer;                    //!< Ms resolution timer for normal LED animation
-IDATA U16 gu16RGBTimer;                       //!< Ms resolution timer for the RGB LED animation
-IDATA U16 gu16LastCall;                       //!< The last time the main cycle was called
+MAIN_DATA U16 gu16NormalTimer;                //!< Ms resolution timer for normal LED animation
+#if BOARD_RGBLED
+MAIN_DATA U16 gu16RGBTimer;                   //!< Ms resolution timer for the RGB LED animation
+#endif
+MAIN_DATA U16 gu16LastCall;                   //!< The last time the main cycle was called
 // Local variables
-static IDATA U8 u8LastState = 0xFFu;          //!< Previously executed instruction index for normal LEDs
-static IDATA U8 u8RepetitionCounter = 0u;     //!< Instruction repetition counter for normal LEDs
-static IDATA U8 u8LastStateRGB = 0xFFu;       //!< Previously executed instruction index for RGB LED
-static IDATA U8 u8RepetitionCounterRGB = 0u;  //!< Instruction repetition counter for RGB LED
+static MAIN_DATA U8 u8LastState = 0xFFu;          //!< Previously executed instruction index for normal LEDs
+static MAIN_DATA U8 u8RepetitionCounter = 0u;     //!< Instruction repetition counter for normal LEDs
+#if BOARD_RGBLED
+static MAIN_DATA U8 u8LastStateRGB = 0xFFu;       //!< Previously executed instruction index for RGB LED
+static MAIN_DATA U8 u8RepetitionCounterRGB = 0u;  //!< Instruction repetition counter for RGB LED
+static MAIN_DATA U16 gu16RGBDeadline = 0u;        //!< gu16RGBTimer of the next change of the RGB program; 0: busy, 0xFFFF: held
+#endif
+static MAIN_DATA U8 au8Operand[ LEDS_NUM ];       //!< Unpacked brightness array of the current instruction
+static MAIN_DATA S_ANIMATION_INSTRUCTION_NORMAL gsInstruction;  //!< Copy of the instruction u8CachedState of the normal LEDs
+static MAIN_DATA U8 u8CachedState = 0xFFu;        //!< Index of the instruction in gsInstruction; 0xFF: none
+#if BOARD_RGBLED
+static MAIN_DATA S_ANIMATION_INSTRUCTION_RGB gsInstructionRGB;  //!< Copy of the instruction u8CachedStateRGB of the RGB LED
+static MAIN_DATA U8 u8CachedStateRGB = 0xFFu;     //!< Index of the instruction in gsInstructionRGB; 0xFF: none
+#endif
+static MAIN_DATA U16 gu16IdleMs;                  //!< Time from gu16LastCall to the next instruction of either program; 0: busy
+static MAIN_DATA U8 gau8Trail[ LEDS_NUM ];        //!< Levels of the trail of TRAIL in 4.4 fixed point: the fraction lets the shift fade them out fully
+static MAIN_DATA U8 gu8TrailHead;                 //!< Position of the head of TRAIL, in 1/16 LEDs
 
 
 /***************************************< Static function definitions >**************************************/
 static I8 SaturateBrightness( U8* pu8BrightnessVariable );
+static void UnpackBrightness( const U8 MAIN_DATA* pu8Packed, U8* pu8Target, U8 u8Count, BOOL bSigned );
+static void Trail( BOOL bStart );
 
 
 /***************************************< Private functions >**************************************/
@@ -640,6 +879,98 @@ static I8 SaturateBrightness( U8* pu8BrightnessVariable )
   return i8Return;
 }
 
+//----------------------------------------------------------------------------
+//! \brief  Unpacks a brightness array of an instruction
+//! \param  *pu8Packed: packed brightness values, two per byte
+//! \param  *pu8Target: where to put the unpacked values
+//! \param  u8Count: number of values to unpack
+//! \param  bSigned: TRUE if the values should be sign extended
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+static void UnpackBrightness( const U8 MAIN_DATA* pu8Packed, U8* pu8Target, U8 u8Count, BOOL bSigned )
+{
+  U8 u8Index;
+  U8 u8Value;
+  for( u8Index = 0u; u8Index < u8Count; u8Index++ )
+  {
+    u8Value = pu8Packed[ u8Index >> 1u ];
+    if( 0u == ( u8Index & 1u ) )
+    {
+      u8Value >>= 4u;
+    }
+    u8Value &= 0x0Fu;
+    if( bSigned && ( u8Value & 0x08u ) )
+    {
+      u8Value |= 0xF0u;  // sign extension
+    }
+    pu8Target[ u8Index ] = u8Value;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Runs a step of the TRAIL instruction in gsInstruction
+//! \param  bStart: TRUE at the first run of the instruction: the head is placed at its start
+//! \return -
+//! \global gsInstruction, gau8Trail[], gu8TrailHead, gau8LEDBrightness[], gau8LEDFraction[]
+//! \note   O(LEDS_NUM), no division: the trail loses 1/2^shift of its level in every step, the head is
+//!         drawn on the two LEDs around it by its fraction. The trail isn't cleared at the start.
+//!         With LED_FRC_BITS the top bits of the fraction of the levels are dithered too.
+//-----------------------------------------------------------------------------
+static void Trail( BOOL bStart )
+{
+  const U8 MAIN_DATA* pu8Params = gsInstruction.au8LEDBrightness;
+  U8  u8Index;
+  U8  u8Fraction;
+  U8  u8Level;
+  I16 i16Head;
+  
+  if( bStart )
+  {
+    gu8TrailHead = pu8Params[ 0u ];
+  }
+  else
+  {
+    for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+    {
+      gau8Trail[ u8Index ] -= gau8Trail[ u8Index ] >> pu8Params[ 2u ];
+    }
+    i16Head = (I16)gu8TrailHead + (I8)pu8Params[ 1u ];
+    if( i16Head < 0 )
+    {
+      i16Head += TRAIL_POSITIONS;
+    }
+    else if( i16Head >= TRAIL_POSITIONS )
+    {
+      i16Head -= TRAIL_POSITIONS;
+    }
+    gu8TrailHead = (U8)i16Head;
+  }
+  
+  // The head, between the LED of its position and the next one clockwise
+  u8Index = gu8TrailHead >> 4u;
+  u8Fraction = gu8TrailHead & 0x0Fu;
+  u8Level = pu8Params[ 3u ] * ( 16u - u8Fraction );
+  if( u8Level > gau8Trail[ u8Index ] )
+  {
+    gau8Trail[ u8Index ] = u8Level;
+  }
+  u8Index = ( ( u8Index + 1u ) < LEDS_NUM ) ? ( u8Index + 1u ) : 0u;
+  u8Level = pu8Params[ 3u ] * u8Fraction;
+  if( u8Level > gau8Trail[ u8Index ] )
+  {
+    gau8Trail[ u8Index ] = u8Level;
+  }
+  
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+  {
+    gau8LEDBrightness[ u8Index ] = gau8Trail[ u8Index ] >> 4u;
+#if LED_FRC_BITS
+    gau8LEDFraction[ u8Index ] = ( gau8Trail[ u8Index ] >> ( 4u - LED_FRC_BITS ) ) & LED_FRC_MASK;
+#endif
+  }
+}
+
 
 /***************************************< Public functions >**************************************/
 //----------------------------------------------------------------------------
@@ -652,8 +983,12 @@ static I8 SaturateBrightness( U8* pu8BrightnessVariable )
 void Animation_Init( void )
 {
   gu16NormalTimer = 0u;
+#if BOARD_RGBLED
   gu16RGBTimer = 0u;
+  gu16RGBDeadline = 0u;
+#endif
   gu16LastCall = Util_GetTimerMs();
+  gu16IdleMs = 0u;
 }
 
 //----------------------------------------------------------------------------
@@ -661,59 +996,93 @@ void Animation_Init( void )
 //! \param  -
 //! \return -
 //! \global -
-//! \note   Should be called from main cycle.
+//! \note   Should be called from main cycle. Returns at once until the next instruction of either
+//!         program is due: the instructions of a program run on their deadlines, not every ms.
+//!         A frame of the normal LEDs is committed whole, see LED_Commit(); the next instruction
+//!         waits until the LED driver has taken it, at most a PWM period.
 //-----------------------------------------------------------------------------
 void Animation_Cycle( void )
 {
+  const S_ANIMATION CODE* psAnimation;
+  const S_ANIMATION_INSTRUCTION_NORMAL CODE* psInstructions;
+#if BOARD_RGBLED
+  const S_ANIMATION_INSTRUCTION_RGB CODE* psInstructionsRGB;
+#endif
   U8  u8AnimationState;
+  U8  u8Unit;
+  const U8 CODE* pcu8Timing;
   U16 u16StateTimer = 0u;
   U16 u16TimeNow = Util_GetTimerMs();
-  U8  u8Index, u8InnerIndex;
+  U16 u16Elapsed = u16TimeNow - gu16LastCall;
+  U8  u8Index;
   U8  u8OpCode;
   U8  u8Temp;
   I8  i8Change;
   
-  // Check if time has elapsed since last call
-  if( u16TimeNow != gu16LastCall )
+  // Nothing to do until the next instruction of either program is due, and the last frame is shown
+  if( ( 0u != u16Elapsed ) && ( u16Elapsed >= gu16IdleMs ) && !LED_IsFramePending() )
   {
     // Increase the synchronized timer with the difference
-    DISABLE_IT;
-    gu16NormalTimer += ( u16TimeNow - gu16LastCall );
-    gu16RGBTimer += ( u16TimeNow - gu16LastCall );
-    ENABLE_IT;
+    gu16NormalTimer += u16Elapsed;
+#if BOARD_RGBLED
+    gu16RGBTimer += u16Elapsed;
+#endif
 
     // Make sure not to overindex arrays
     if( gsPersistentData.u8AnimationIndex >= NUM_ANIMATIONS )
     {
       gsPersistentData.u8AnimationIndex = 0u;
+      u8CachedState = 0xFFu;
+#if BOARD_RGBLED
+      u8CachedStateRGB = 0xFFu;
+#endif
     }
+    psAnimation = &gasAnimations[ gsPersistentData.u8AnimationIndex ];
+    psInstructions = psAnimation->psInstructionsNormal;
+    u8Unit = psAnimation->u8TimeUnitNormal;
     
     // --------------------------------------< For the normal LEDs
-    // Calculate the state of the animation
-    for( u8AnimationState = 0u; u8AnimationState < gasAnimations[ gsPersistentData.u8AnimationIndex ].u8AnimationLengthNormal; u8AnimationState++ )
+    // Calculate the state of the animation; a timing times the unit is a single MUL AB, and the
+    // timings are walked by a pointer stepping over the records, without an index multiplication
+    pcu8Timing = &psInstructions[ 0u ].u8Timing;
+    for( u8AnimationState = 0u; u8AnimationState < psAnimation->u8AnimationLengthNormal; u8AnimationState++ )
     {
-      u16StateTimer += gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].u16TimingMs;
+      u16StateTimer += (U16)*pcu8Timing * u8Unit;
       if( u16StateTimer > gu16NormalTimer )
       {
         break;
       }
+      pcu8Timing += sizeof( S_ANIMATION_INSTRUCTION_NORMAL );
     }
-    if( u8AnimationState >= gasAnimations[ gsPersistentData.u8AnimationIndex ].u8AnimationLengthNormal )
+    if( u8AnimationState >= psAnimation->u8AnimationLengthNormal )
     {
-      // restart animation
+      // restart animation, the RGB program restarts with it unless it loops on its own
       u8AnimationState = 0u;
-      DISABLE_IT;
       gu16NormalTimer = 0u;
-      gu16RGBTimer = 0u;
-      ENABLE_IT;
+      u16StateTimer = (U16)psInstructions[ 0u ].u8Timing * u8Unit;
+#if BOARD_RGBLED
+      if( 0u == ( LOOP_RGB & psAnimation->u8Options ) )
+      {
+        gu16RGBTimer = 0u;
+        gu16RGBDeadline = 0u;
+      }
+#endif
     }
     if( u8LastState != u8AnimationState )  // next instruction
     {
-      u8OpCode = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].u8AnimationOpcode;
+      // The instruction is read from the code space once, the repetitions and the operations take the copy
+      if( u8CachedState != u8AnimationState )
+      {
+        Util_CopyCode( (U8 IDATA*)&gsInstruction, (const U8 CODE*)&psInstructions[ u8AnimationState ], sizeof( gsInstruction ) );
+        u8CachedState = u8AnimationState;
+      }
+      u8OpCode = gsInstruction.u8AnimationOpcode;
+      // A LOAD is unpacked right into the driver array, the others into the operand
+      UnpackBrightness( gsInstruction.au8LEDBrightness,
+                        ( LOAD == u8OpCode ) ? gau8LEDBrightness : au8Operand, LEDS_NUM, ( LOAD != u8OpCode ) );
       // Just a load instruction, nothing more
       if( LOAD == u8OpCode )
       {
-        memcpy( gau8LEDBrightness, (void*)gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness, LEDS_NUM );
         u8LastState = u8AnimationState;
       }
       else  // Other opcodes -- IMPORTANT: the order of operations are fixed!
@@ -723,7 +1092,7 @@ void Animation_Cycle( void )
         {
           for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
           {
-            gau8LEDBrightness[ u8Index ] += gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
+            gau8LEDBrightness[ u8Index ] += au8Operand[ u8Index ];
             if( gau8LEDBrightness[ u8Index ] > 15u )  // overflow/underflow happened
             {
               gau8LEDBrightness[ u8Index ] = 0u;
@@ -750,6 +1119,11 @@ void Animation_Cycle( void )
           }
           gau8LEDBrightness[ LEDS_NUM - 1u ] = u8Temp;
         }
+        // Trail operation: a particle and its fading trail
+        if( TRAIL & u8OpCode )
+        {
+          Trail( 0u == u8RepetitionCounter );
+        }
 /*
         // Upward move operation
         if( UMOVE & u8OpCode )
@@ -757,7 +1131,7 @@ void Animation_Cycle( void )
           // Left side
           for( u8Index = 0u; u8Index < (RIGHT_LEDS_START - 1u); u8Index++ )
           {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
+            i8Change = au8Operand[ u8Index ];
             gau8LEDBrightness[ u8Index ] -= i8Change;
             for( u8InnerIndex = u8Index; u8InnerIndex < (RIGHT_LEDS_START - 1u); u8InnerIndex++ )
             {
@@ -766,13 +1140,13 @@ void Animation_Cycle( void )
               i8Change = SaturateBrightness( &gau8LEDBrightness[ u8InnerIndex + 1u ] );
             }
           }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ RIGHT_LEDS_START - 1u ];
+          i8Change = au8Operand[ RIGHT_LEDS_START - 1u ];
           gau8LEDBrightness[ RIGHT_LEDS_START - 1u ] -= i8Change;
           SaturateBrightness( &gau8LEDBrightness[ RIGHT_LEDS_START - 1u ] );
           // Right side
           for( u8Index = LEDS_NUM - 1u; u8Index > RIGHT_LEDS_START; u8Index-- )
           {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
+            i8Change = au8Operand[ u8Index ];
             if( (I8)gau8LEDBrightness[ u8Index ] - i8Change < 0u )  // saturation downwards
             {
               gau8LEDBrightness[ u8Index - 1u ] += gau8LEDBrightness[ u8Index ];
@@ -785,7 +1159,7 @@ void Animation_Cycle( void )
             SaturateBrightness( &gau8LEDBrightness[ u8Index ] );
             SaturateBrightness( &gau8LEDBrightness[ u8Index - 1u ] );  // saturate the next LED too
           }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ RIGHT_LEDS_START ];
+          i8Change = au8Operand[ RIGHT_LEDS_START ];
           gau8LEDBrightness[ RIGHT_LEDS_START ] -= i8Change;
           SaturateBrightness( &gau8LEDBrightness[ RIGHT_LEDS_START ] );
         }
@@ -796,7 +1170,7 @@ void Animation_Cycle( void )
           // Left side
           for( u8Index = (RIGHT_LEDS_START - 1u); u8Index > 0u ; u8Index-- )
           {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
+            i8Change = au8Operand[ u8Index ];
             if( (I8)gau8LEDBrightness[ u8Index ] - i8Change < 0u )  // saturation downwards
             {
               gau8LEDBrightness[ u8Index - 1u ] += gau8LEDBrightness[ u8Index ];
@@ -809,13 +1183,13 @@ void Animation_Cycle( void )
             SaturateBrightness( &gau8LEDBrightness[ u8Index ] );
             SaturateBrightness( &gau8LEDBrightness[ u8Index - 1u ] );  // saturate the next LED too
           }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ 0u ];
+          i8Change = au8Operand[ 0u ];
           gau8LEDBrightness[ 0u ] -= i8Change;
           SaturateBrightness( &gau8LEDBrightness[ 0u ] );
           // Right side
           for( u8Index = RIGHT_LEDS_START; u8Index < (LEDS_NUM - 1u); u8Index++ )
           {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
+            i8Change = au8Operand[ u8Index ];
             if( (I8)gau8LEDBrightness[ u8Index ] - i8Change < 0u )  // saturation downwards
             {
               gau8LEDBrightness[ u8Index + 1u ] += gau8LEDBrightness[ u8Index ];
@@ -828,77 +1202,53 @@ void Animation_Cycle( void )
             SaturateBrightness( &gau8LEDBrightness[ u8Index ] );
             SaturateBrightness( &gau8LEDBrightness[ u8Index + 1u ] );  // saturate the next LED too
           }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ LEDS_NUM - 1u ];
+          i8Change = au8Operand[ LEDS_NUM - 1u ];
           gau8LEDBrightness[ LEDS_NUM - 1u ] -= i8Change;
           SaturateBrightness( &gau8LEDBrightness[ LEDS_NUM - 1u ] );
         }
 */
-        // Upward source instruction
+        // Upward source instruction: one pass per side, the overflow of each LED is added to the next one with its own value
         if( USOURCE & u8OpCode )
         {
           // Left side
-          for( u8Index = 0u; u8Index < (RIGHT_LEDS_START - 1u); u8Index++ )
+          i8Change = 0;
+          for( u8Index = 0u; u8Index < RIGHT_LEDS_START; u8Index++ )
           {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
-            gau8LEDBrightness[ u8Index ] += i8Change;
-            for( u8InnerIndex = u8Index; u8InnerIndex < (RIGHT_LEDS_START - 1u); u8InnerIndex++ )
-            {
-              gau8LEDBrightness[ u8InnerIndex + 1u ] += SaturateBrightness( &gau8LEDBrightness[ u8InnerIndex ] );
-            }
+            gau8LEDBrightness[ u8Index ] += (I8)au8Operand[ u8Index ] + i8Change;
+            i8Change = SaturateBrightness( &gau8LEDBrightness[ u8Index ] );
           }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ RIGHT_LEDS_START - 1u ];
-          gau8LEDBrightness[ RIGHT_LEDS_START - 1u ] += i8Change;
-          SaturateBrightness( &gau8LEDBrightness[ RIGHT_LEDS_START - 1u ] );
           // Right side
-          for( u8Index = LEDS_NUM - 1u; u8Index > RIGHT_LEDS_START; u8Index-- )
+          i8Change = 0;
+          for( u8Index = LEDS_NUM - 1u; u8Index >= RIGHT_LEDS_START; u8Index-- )
           {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
-            gau8LEDBrightness[ u8Index ] += i8Change;
-            for( u8InnerIndex = LEDS_NUM - 1u; u8InnerIndex > RIGHT_LEDS_START; u8InnerIndex-- )
-            {
-              gau8LEDBrightness[ u8InnerIndex - 1u ] += SaturateBrightness( &gau8LEDBrightness[ u8InnerIndex ] );
-            }
+            gau8LEDBrightness[ u8Index ] += (I8)au8Operand[ u8Index ] + i8Change;
+            i8Change = SaturateBrightness( &gau8LEDBrightness[ u8Index ] );
           }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ RIGHT_LEDS_START ];
-          gau8LEDBrightness[ RIGHT_LEDS_START ] += i8Change;
-          SaturateBrightness( &gau8LEDBrightness[ RIGHT_LEDS_START ] );
         }
-        // Downward source instruction
+        // Downward source instruction: the same, from the last LED of each side downwards
         if( DSOURCE & u8OpCode )
         {
           // Left side
-          for( u8Index = (RIGHT_LEDS_START - 1u); u8Index > 0u; u8Index-- )
+          i8Change = 0;
+          for( u8Index = RIGHT_LEDS_START; u8Index > 0u; u8Index-- )
           {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
-            gau8LEDBrightness[ u8Index ] += i8Change;
-            for( u8InnerIndex = u8Index; u8InnerIndex > 0u; u8InnerIndex-- )
-            {
-              gau8LEDBrightness[ u8InnerIndex - 1u ] += SaturateBrightness( &gau8LEDBrightness[ u8InnerIndex ] );
-            }
+            gau8LEDBrightness[ u8Index - 1u ] += (I8)au8Operand[ u8Index - 1u ] + i8Change;
+            i8Change = SaturateBrightness( &gau8LEDBrightness[ u8Index - 1u ] );
           }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ 0u ];
-          gau8LEDBrightness[ 0u ] += i8Change;
-          SaturateBrightness( &gau8LEDBrightness[ 0u ] );
           // Right side
-          for( u8Index = RIGHT_LEDS_START; u8Index < (LEDS_NUM - 1u); u8Index++ )
+          i8Change = 0;
+          for( u8Index = RIGHT_LEDS_START; u8Index < LEDS_NUM; u8Index++ )
           {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
-            gau8LEDBrightness[ u8Index ] += i8Change;
-            for( u8InnerIndex = RIGHT_LEDS_START; u8InnerIndex < (LEDS_NUM - 1u); u8InnerIndex++ )
-            {
-              gau8LEDBrightness[ u8InnerIndex + 1u ] += SaturateBrightness( &gau8LEDBrightness[ u8InnerIndex ] );
-            }
+            gau8LEDBrightness[ u8Index ] += (I8)au8Operand[ u8Index ] + i8Change;
+            i8Change = SaturateBrightness( &gau8LEDBrightness[ u8Index ] );
           }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ LEDS_NUM - 1u ];
-          gau8LEDBrightness[ LEDS_NUM - 1u ] += i8Change;
-          SaturateBrightness( &gau8LEDBrightness[ LEDS_NUM - 1u ] );
         }
         // Divide instruction
         if( DIV & u8OpCode )
         {
           for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
           {
-            u8Temp = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
+            u8Temp = au8Operand[ u8Index ];
             if( u8Temp != 0u )
             {
               gau8LEDBrightness[ u8Index ] /= u8Temp;
@@ -911,9 +1261,9 @@ void Animation_Cycle( void )
           // If we're here the first time
           if( 0u == u8RepetitionCounter )
           {
-            u8RepetitionCounter = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].u8AnimationOperand;
+            u8RepetitionCounter = gsInstruction.u8AnimationOperand;
             // Step back in time
-            gu16NormalTimer -= gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].u16TimingMs;
+            gu16NormalTimer -= (U16)gsInstruction.u8Timing * u8Unit;
           }
           else  // We're already repeating...
           {
@@ -921,7 +1271,7 @@ void Animation_Cycle( void )
             if( 0u != u8RepetitionCounter )
             {
               // Step back in time
-              gu16NormalTimer -= gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].u16TimingMs;
+              gu16NormalTimer -= (U16)gsInstruction.u8Timing * u8Unit;
             }
             else  // No more repeating
             {
@@ -934,148 +1284,277 @@ void Animation_Cycle( void )
           u8LastState = u8AnimationState;  // save that this operation is finished
         }
       }
+      LED_Commit();  // shown from the next PWM period on
+    }
+    // Nothing changes until the end of the instruction, unless it is being repeated
+    gu16IdleMs = 0u;
+    if( ( u8LastState == u8AnimationState ) && ( 0u == u8RepetitionCounter ) )
+    {
+      gu16IdleMs = u16StateTimer - gu16NormalTimer;
     }
     
+#if BOARD_RGBLED
     // --------------------------------------< For the RGB LED
-    // Calculate the state of the animation
-    u16StateTimer = 0u;
-    for( u8AnimationState = 0u; u8AnimationState < gasAnimations[ gsPersistentData.u8AnimationIndex ].u8AnimationLengthRGB; u8AnimationState++ )
+    // The table is only walked when the RGB program changes: a constant color costs nothing
+    if( gu16RGBTimer >= gu16RGBDeadline )
     {
-      u16StateTimer += gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].u16TimingMs;
-      if( u16StateTimer > gu16RGBTimer )
+      psInstructionsRGB = psAnimation->psInstructionsRGB;
+      u8Unit = psAnimation->u8TimeUnitRGB;
+      // Calculate the state of the animation
+      u16StateTimer = 0u;
+      pcu8Timing = &psInstructionsRGB[ 0u ].u8Timing;
+      for( u8AnimationState = 0u; u8AnimationState < psAnimation->u8AnimationLengthRGB; u8AnimationState++ )
       {
-        break;
+        u16StateTimer += (U16)*pcu8Timing * u8Unit;
+        if( u16StateTimer > gu16RGBTimer )
+        {
+          break;
+        }
+        pcu8Timing += sizeof( S_ANIMATION_INSTRUCTION_RGB );
       }
-    }
-/*
-    if( u8AnimationState >= gasAnimations[ gsPersistentData.u8AnimationIndex ].u8AnimationLengthRGB )
-    {
-      // restart animation
-      u8AnimationState = 0u;
-      DISABLE_IT;
-      gu16SynchronizedTimer = 0;
-      ENABLE_IT;
-    }
-*/
-    if( u8LastStateRGB != u8AnimationState )  // next instruction
-    {
-      u8OpCode = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].u8AnimationOpcode;
-      // Just a load instruction, nothing more
-      if( LOAD == u8OpCode )
+      if( ( u8AnimationState >= psAnimation->u8AnimationLengthRGB )
+       && ( 0u != ( LOOP_RGB & psAnimation->u8Options ) ) )
       {
-        memcpy( gau8RGBLEDs, (void*)gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].au8RGBLEDBrightness, NUM_RGBLED_COLORS );
-        u8LastStateRGB = u8AnimationState;
+        // restart the RGB program
+        u8AnimationState = 0u;
+        gu16RGBTimer = 0u;
+        u8LastStateRGB = 0xFFu;
+        u16StateTimer = (U16)psInstructionsRGB[ 0u ].u8Timing * u8Unit;
       }
-      else  // Other opcodes -- IMPORTANT: the order of operations are fixed!
+      // Past the end of a program waiting for the normal LEDs the last instruction is held
+      if( ( u8AnimationState < psAnimation->u8AnimationLengthRGB )
+       && ( u8LastStateRGB != u8AnimationState ) )  // next instruction
       {
-        // Add operation
-        if( ADD & u8OpCode )
+        if( u8CachedStateRGB != u8AnimationState )
         {
-          for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
-          {
-            gau8RGBLEDs[ u8Index ] += gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].au8RGBLEDBrightness[ u8Index ];
-            if( gau8RGBLEDs[ u8Index ] > 15u )  // overflow/underflow happened
-            {
-              gau8RGBLEDs[ u8Index ] = 0u;
-            }
-          }
-        }
-        // Right shift operation
-        if( RSHIFT & u8OpCode )
-        {
-          // Not implemented
-        }
-        // Left shift operation
-        if( LSHIFT & u8OpCode )
-        {
-          // Not implemented
-        }
-/*
-        // Upward move operation
-        if( UMOVE & u8OpCode )
-        {
-          // Not implemented
+          Util_CopyCode( (U8 IDATA*)&gsInstructionRGB, (const U8 CODE*)&psInstructionsRGB[ u8AnimationState ], sizeof( gsInstructionRGB ) );
+          u8CachedStateRGB = u8AnimationState;
         }
-        // Downward move operation
-        if( DMOVE & u8OpCode )
+        u8OpCode = gsInstructionRGB.u8AnimationOpcode;
+        UnpackBrightness( gsInstructionRGB.au8RGBLEDBrightness,
+                          ( LOAD == u8OpCode ) ? (U8*)gau8RGBLEDs : au8Operand, NUM_RGBLED_COLORS, ( LOAD != u8OpCode ) );
+        // Just a load instruction, nothing more
+        if( LOAD == u8OpCode )
         {
-          // Not implemented
+          u8LastStateRGB = u8AnimationState;
         }
-*/
-        if( USOURCE & u8OpCode )
+        else  // Other opcodes -- IMPORTANT: the order of operations are fixed!
         {
-          // Not implemented
-        }
-        if( DSOURCE & u8OpCode )
-        {
-          // Not implemented
-        }
-        if( DIV & u8OpCode )
-        {
-          for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
+          // Add operation
+          if( ADD & u8OpCode )
           {
-            u8Temp = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].au8RGBLEDBrightness[ u8Index ];
-            if( u8Temp != 0u )
+            for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
             {
-              gau8RGBLEDs[ u8Index ] /= u8Temp;
+              gau8RGBLEDs[ u8Index ] += au8Operand[ u8Index ];
+              if( gau8RGBLEDs[ u8Index ] > 15u )  // overflow/underflow happened
+              {
+                gau8RGBLEDs[ u8Index ] = 0u;
+              }
             }
           }
-        }
-        // Repeat instruction
-        if( REPEAT & u8OpCode )
-        {
-          // If we're here the first time
-          if( 0u == u8RepetitionCounterRGB )
+          // Right shift operation
+          if( RSHIFT & u8OpCode )
           {
-            u8RepetitionCounterRGB = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].u8AnimationOperand;
-            // Step back in time
-            gu16RGBTimer -= gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].u16TimingMs;
+            // Not implemented
           }
-          else  // We're already repeating...
+          // Left shift operation
+          if( LSHIFT & u8OpCode )
+          {
+            // Not implemented
+          }
+  /*
+          // Upward move operation
+          if( UMOVE & u8OpCode )
+          {
+            // Not implemented
+          }
+          // Downward move operation
+          if( DMOVE & u8OpCode )
+          {
+            // Not implemented
+          }
+  */
+          if( USOURCE & u8OpCode )
+          {
+            // Not implemented
+          }
+          if( DSOURCE & u8OpCode )
+          {
+            // Not implemented
+          }
+          if( DIV & u8OpCode )
           {
-            u8RepetitionCounterRGB--;
-            if( 0u != u8RepetitionCounterRGB )
+            for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
             {
+              u8Temp = au8Operand[ u8Index ];
+              if( u8Temp != 0u )
+              {
+                gau8RGBLEDs[ u8Index ] /= u8Temp;
+              }
+            }
+          }
+          // Repeat instruction
+          if( REPEAT & u8OpCode )
+          {
+            // If we're here the first time
+            if( 0u == u8RepetitionCounterRGB )
+            {
+              u8RepetitionCounterRGB = gsInstructionRGB.u8AnimationOperand;
               // Step back in time
-              gu16RGBTimer -= gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].u16TimingMs;
+              gu16RGBTimer -= (U16)gsInstructionRGB.u8Timing * u8Unit;
             }
-            else  // No more repeating
+            else  // We're already repeating...
             {
-             u8LastStateRGB = u8AnimationState;
+              u8RepetitionCounterRGB--;
+              if( 0u != u8RepetitionCounterRGB )
+              {
+                // Step back in time
+                gu16RGBTimer -= (U16)gsInstructionRGB.u8Timing * u8Unit;
+              }
+              else  // No more repeating
+              {
+               u8LastStateRGB = u8AnimationState;
+              }
             }
           }
+          else  // if there's no repeat opcode
+          {
+            u8LastStateRGB = u8AnimationState;  // save that this operation is finished
+          }
         }
-        else  // if there's no repeat opcode
+      }
+      // A held last instruction never ends
+      gu16RGBDeadline = 0xFFFFu;
+      if( u8AnimationState < psAnimation->u8AnimationLengthRGB )
+      {
+        gu16RGBDeadline = 0u;
+        if( ( u8LastStateRGB == u8AnimationState ) && ( 0u == u8RepetitionCounterRGB ) )
         {
-          u8LastStateRGB = u8AnimationState;  // save that this operation is finished
+          gu16RGBDeadline = u16StateTimer;
         }
       }
-    }    
+    }
+    if( gu16RGBDeadline <= gu16RGBTimer )
+    {
+      gu16IdleMs = 0u;
+    }
+    else if( ( gu16RGBDeadline - gu16RGBTimer ) < gu16IdleMs )
+    {
+      gu16IdleMs = gu16RGBDeadline - gu16RGBTimer;
+    }
+#endif /* BOARD_RGBLED */
     // Store the timestamp
     gu16LastCall = u16TimeNow;
   }
 }
 
+#if UTIL_SLEEP
+//----------------------------------------------------------------------------
+//! \brief  Tells how long the LEDs stay dark
+//! \param  -
+//! \return Time until the next instruction in ms if every LED is dark now; 0 otherwise
+//! \global gu16IdleMs, gu16LastCall
+//! \note   Should be called from main cycle, after Animation_Cycle(). The time can be slept through:
+//!         the next Animation_Cycle() on time runs the instruction just as without the sleep.
+//-----------------------------------------------------------------------------
+U16 Animation_GetIdleMs( void )
+{
+  U16 u16Idle = 0u;
+  U16 u16Elapsed = Util_GetTimerMs() - gu16LastCall;
+  U8  u8Index;
+  
+  if( ( gu16IdleMs > u16Elapsed ) && !LED_IsFramePending() )  // the sleep stops the driver, it would never take the frame
+  {
+    u16Idle = gu16IdleMs - u16Elapsed;
+  }
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+  {
+    if( 0u != gau8LEDBrightness[ u8Index ] )
+    {
+      u16Idle = 0u;
+    }
+  }
+  if( LED_IsDithering() )  // a fraction of a dark level is lit in some frames
+  {
+    u16Idle = 0u;
+  }
+#if BOARD_RGBLED
+  for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
+  {
+    if( 0u != gau8RGBLEDs[ u8Index ] )
+    {
+      u16Idle = 0u;
+    }
+  }
+#endif
+  
+  return u16Idle;
+}
+#endif
+
 //----------------------------------------------------------------------------
 //! \brief  Set the new animation
 //! \param  -
 //! \return -
-//! \global -
-//! \note   Should be called from main cycle only!
+//! \global gu16NormalTimer, gu16RGBTimer, gu16LastCall, the state of both programs
+//! \note   Should be called from main cycle only! With UTIL_CLOCK_SCALING it sets the system clock
+//!         for the animation too, see SLOW_CLOCK. The entry frame is the LOAD of the first
+//!         instruction: it is played here and committed, so the LEDs change from the next PWM
+//!         period on, and the cycle starts from the end of that instruction. A program that
+//!         starts with any other opcode starts from dark LEDs, not from the previous animation.
 //-----------------------------------------------------------------------------
 void Animation_Set( U8 u8AnimationIndex )
 {
+  const S_ANIMATION CODE* psAnimation;
+  
   if( u8AnimationIndex < NUM_ANIMATIONS )
   {
+    psAnimation = &gasAnimations[ u8AnimationIndex ];
+#if UTIL_CLOCK_SCALING
+    Util_SetClockDivider( ( 0u != ( SLOW_CLOCK & psAnimation->u8Options ) ) ? UTIL_CLKDIV_MAX : 0u );
+#endif
     gsPersistentData.u8AnimationIndex = u8AnimationIndex;
-    DISABLE_IT;
     gu16NormalTimer = 0u;
-    gu16RGBTimer = 0u;
-    ENABLE_IT;
     u8LastState = 0xFFu;
     u8RepetitionCounter = 0u;
+    Util_Fill( gau8Trail, 0u, sizeof( gau8Trail ) );
+#if BOARD_RGBLED
+    gu16RGBTimer = 0u;
+    gu16RGBDeadline = 0u;
     u8LastStateRGB = 0xFFu;
     u8RepetitionCounterRGB = 0u;
+#endif
+    
+    // Entry frame of the normal LEDs: the first instruction, if it is a LOAD
+    gu16IdleMs = 0u;
+    Util_Fill( gau8LEDBrightness, 0u, sizeof( gau8LEDBrightness ) );
+    Util_CopyCode( (U8 IDATA*)&gsInstruction, (const U8 CODE*)&psAnimation->psInstructionsNormal[ 0u ], sizeof( gsInstruction ) );
+    u8CachedState = 0u;
+    if( LOAD == gsInstruction.u8AnimationOpcode )
+    {
+      UnpackBrightness( gsInstruction.au8LEDBrightness, gau8LEDBrightness, LEDS_NUM, FALSE );
+      u8LastState = 0u;
+      gu16IdleMs = (U16)gsInstruction.u8Timing * psAnimation->u8TimeUnitNormal;
+    }
+#if BOARD_RGBLED
+    // Entry color of the RGB LED, the same way
+    Util_Fill( (U8 IDATA*)gau8RGBLEDs, 0u, sizeof( gau8RGBLEDs ) );
+    Util_CopyCode( (U8 IDATA*)&gsInstructionRGB, (const U8 CODE*)&psAnimation->psInstructionsRGB[ 0u ], sizeof( gsInstructionRGB ) );
+    u8CachedStateRGB = 0u;
+    if( LOAD == gsInstructionRGB.u8AnimationOpcode )
+    {
+      UnpackBrightness( gsInstructionRGB.au8RGBLEDBrightness, (U8*)gau8RGBLEDs, NUM_RGBLED_COLORS, FALSE );
+      u8LastStateRGB = 0u;
+      gu16RGBDeadline = (U16)gsInstructionRGB.u8Timing * psAnimation->u8TimeUnitRGB;
+    }
+    if( gu16RGBDeadline < gu16IdleMs )
+    {
+      gu16IdleMs = gu16RGBDeadline;
+    }
+#endif
+    LED_Commit();  // shown from the next PWM period on
+    // The time of the animation starts now, not at the last cycle of the previous one
+    gu16LastCall = Util_GetTimerMs();
   }
 }
 
@@ -12,10 +12,11 @@
 #define ANIMATION_H
 
 /***************************************< Includes >**************************************/
+#include "board.h"
 
 
 /***************************************< Definitions >**************************************/
-#define NUM_ANIMATIONS        (18u)  //!< Number of animations implemented
+#define NUM_ANIMATIONS        BOARD_NUM_ANIMATIONS  //!< Number of animations implemented
 
 
 /***************************************< Types >**************************************/
@@ -31,6 +32,9 @@
 void Animation_Init( void );
 void Animation_Cycle( void );
 void Animation_Set( U8 u8AnimationIndex );
+#if UTIL_SLEEP
+U16  Animation_GetIdleMs( void );
+#endif
 
 
 #endif /* ANIMATION_H */
@@ -13,6 +13,7 @@
 // Own includes
 #include "stc8g.h"
 #include "types.h"
+#include "board.h"
 #include "led.h"
 #include "rgbled.h"
 #include "util.h"
@@ -20,81 +21,201 @@
 
 
 /***************************************< Definitions >**************************************/
-
+#define CHARGE_LEVELS    (7u)  //!< Charge levels above depleted
+#define FULL_LOAD_LIT    ( LEDS_NUM/2u )  //!< LEDs lit at a time with every LED at full brightness: a side
+#define SAMPLES          (32u)    //!< Conversions of a background window; the one after the power-up of the ADC is dropped
+#define SAMPLE_PERIOD_MS (30000u) //!< A background window is started this often by BatteryLevel_Cycle()
+#define ADC_PER_LED      (10u)    //!< Rise of the ADC result per lit LED: about 50 mV of sag of a CR2032 around 2.4 V
+#define SWEEP_STEP_MS    (100u)   //!< Each pair of LEDs of the boot sweep is lit this long before the next one
+#define SETTLE_MS        (100u)   //!< Wait with every LED lit before the measurement, for the supply to settle
+#define GAUGE_MS         (2000u)  //!< How long the charge level is shown, so the user can read it
 
 /***************************************< Types >**************************************/
+//! \brief States of the battery indicator
+typedef enum
+{
+  BATTERY_SWEEP = 0u,  //!< The boot sweep is lighting up the LEDs pair by pair
+#if BATTERY_BACKGROUND
+  BATTERY_MEASURE,     //!< Every LED is lit, the interrupt is sampling the window
+#else
+  BATTERY_SETTLE,      //!< Every LED is lit, the supply is settling for the measurement
+#endif
+  BATTERY_GAUGE,       //!< The charge level is shown
+  BATTERY_DONE         //!< The animation runs; with BATTERY_BACKGROUND the windows are taken
+} E_BATTERY_STATE;
 
 
 /***************************************< Constants >**************************************/
-
+//! \brief Highest ADC result of each charge level above 0, i.e. thresholds of the charge level formula
+//! \note  floor( 42650 / ( 70 + 4*level ) ), so the charge level is looked up without a 16-bit division
+static CODE const U16 gcau16ChargeLevelADC[ CHARGE_LEVELS ] = { 576u, 546u, 520u, 495u, 473u, 453u, 435u };
 
 /***************************************< Global variables >**************************************/
+static MAIN_DATA U8  geBatteryState = BATTERY_DONE;  //!< State of the battery indicator (E_BATTERY_STATE)
+static MAIN_DATA U8  gu8SweepPair;  //!< Pair of LEDs lit last by the boot sweep
+static MAIN_DATA U16 gu16StepMs;    //!< Start time of the running step of the indicator
+#if BATTERY_BACKGROUND
+static ISR_DATA U16 gu16PeakADC;  //!< Highest ADC result of the window at gu8PeakLit LEDs lit: the lowest supply voltage
+static ISR_DATA U8  gu8PeakLit;   //!< Most LEDs lit at a conversion of the window
+static ISR_DATA U8  gu8ConvertLit;  //!< LEDs lit at the start of the running conversion, as the ADC samples
+static ISR_DATA U8  gu8Samples;   //!< Conversions taken in the window
+static DATA volatile BIT gbitSampling;  //!< Set by StartWindow(), cleared by the interrupt after SAMPLES conversions
+static DATA BIT gbitConverting;   //!< A conversion started by the interrupt is running
+static DATA BIT gbitWindowPending;  //!< The charge level of the running window is still to be taken
+static MAIN_DATA U8  gu8ChargeLevel;  //!< Charge level of the last window
+static MAIN_DATA U16 gu16WindowMs;    //!< Start time of the last window
+#endif
 
 
 /***************************************< Static function definitions >**************************************/
-void Delay( U16 u16DelayMs );
+static BOOL StepElapsed( U16 u16StepMs );
+static void ShowGauge( U8 u8ChargeLevel );
+#if BATTERY_BACKGROUND
+static void StartWindow( void );
+static U8   ChargeLevel( void );
+#else
+static U8   MeasureChargeLevel( void );
+#endif
 
 
 /***************************************< Private functions >**************************************/
 //----------------------------------------------------------------------------
-//! \brief  Waits for the given number of milliseconds
-//! \param  u16DelayMs: wait time
+//! \brief  Tells if the running step of the indicator has lasted the given time, and starts the next one then
+//! \param  u16StepMs: length of the step
+//! \return TRUE if it has: gu16StepMs is the start of the next step
+//! \global gu16StepMs
+//-----------------------------------------------------------------------------
+static BOOL StepElapsed( U16 u16StepMs )
+{
+  BOOL bElapsed = FALSE;
+  
+  if( (U16)( Util_GetTimerMs() - gu16StepMs ) >= u16StepMs )
+  {
+    gu16StepMs = Util_GetTimerMs();
+    bElapsed = TRUE;
+  }
+  return bElapsed;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Displays the charge level on the LEDs as a gauge
+//! \param  u8ChargeLevel: charge level, [0; CHARGE_LEVELS]
 //! \return -
-//! \global -
-//! \note   Should be called from init block
+//! \global gau8LEDBrightness[], gau8RGBLEDs[]
 //-----------------------------------------------------------------------------
-void Delay( U16 u16DelayMs )
+static void ShowGauge( U8 u8ChargeLevel )
 {
-  U16 u16DelayEnd = Util_GetTimerMs() + u16DelayMs;
-  while( Util_GetTimerMs() < u16DelayEnd );
+  U8 u8Index;
+  
+#if BOARD_RGBLED
+  for( u8Index = 0u; u8Index < LEDS_NUM/2u; u8Index++ )
+  {
+    if( u8ChargeLevel >= u8Index )
+    {
+      gau8LEDBrightness[ u8Index ] = 15u;
+      gau8LEDBrightness[ LEDS_NUM - u8Index - 1u ] = 15u;
+    }
+    else
+    {
+      gau8LEDBrightness[ u8Index ] = 0u;
+      gau8LEDBrightness[ LEDS_NUM - u8Index - 1u ] = 0u;
+    }
+  }
+  if( u8ChargeLevel > LEDS_NUM/2u )
+  {
+    gau8RGBLEDs[ 0u ] = 15u;  // Light up red LED
+  }
+  else
+  {
+    gau8RGBLEDs[ 0u ] = 0u;
+  }
+#else
+  // No RGB LED: the bar starts from the tail of the shooting star, the top level is the LED in the middle
+  Util_Fill( gau8LEDBrightness, 0u, sizeof( gau8LEDBrightness ) );
+  if( u8ChargeLevel > 0u )
+  {
+    gau8LEDBrightness[ LEDS_NUM - 1u ] = 15u;  // LED in the tail of the shooting star
+  }
+  for( u8Index = 0u; u8Index < ( LEDS_NUM/2u ); u8Index++ )
+  {
+    if( u8ChargeLevel > u8Index + 1u )
+    {
+      gau8LEDBrightness[ u8Index ] = 15u;
+      gau8LEDBrightness[ LEDS_NUM - u8Index - 2u ] = 15u;
+    }
+    else
+    {
+      gau8LEDBrightness[ u8Index ] = 0u;
+      gau8LEDBrightness[ LEDS_NUM - u8Index - 2u ] = 0u;
+    }
+  }
+  if( u8ChargeLevel > LEDS_NUM/2u )
+  {
+    gau8LEDBrightness[ LEDS_NUM/2u - 1u ] = 15u;
+  }
+  else
+  {
+    gau8LEDBrightness[ LEDS_NUM/2u - 1u ] = 0u;
+  }
+#endif
+  LED_Commit();
 }
 
 
-/***************************************< Public functions >**************************************/
+#if BATTERY_BACKGROUND
 //----------------------------------------------------------------------------
-//! \brief  Initializes battery level measurement
+//! \brief  Powers up the ADC, and has the interrupt take a window of conversions
 //! \param  -
 //! \return -
-//! \global -
-//! \note   Should be called from init block
+//! \global gu16PeakADC, gu8PeakLit, gu8Samples, gbitSampling, gbitConverting, gu16WindowMs
+//! \note   The ADC is powered down by the interrupt after the window, some 7 ms later.
 //-----------------------------------------------------------------------------
-void BatteryLevel_Init( void )
+static void StartWindow( void )
 {
-  ADCTIM = 0x3Fu;      // 32 clock sampling time, 2 clocks channel selection hold time
-  ADCCFG = 0x2Fu;      // Right-aligned results registers, slowest conversion
-  ADC_CONTR = 0x80u;   // Enable ADC
-  ADC_CONTR |= 0x0Fu;  // Select internal 1.19V reference
+  gbitSampling = 0;
+  gbitConverting = 0;
+  gu16PeakADC = 0u;
+  gu8PeakLit = 0u;
+  gu8Samples = 0u;
+  ADC_CONTR = 0x8Fu;  // Enable ADC, internal 1.19V reference
+  gu16WindowMs = Util_GetTimerMs();
+  gbitSampling = 1;
 }
 
 //----------------------------------------------------------------------------
-//! \brief  Shows battery level on LEDs as a gauge
+//! \brief  Calculates the charge level from the last window
 //! \param  -
-//! \return -
-//! \global -
-//! \note   Should be called only once! Blocking function! Deinitializes ADC.
+//! \return Charge level, [0; CHARGE_LEVELS]
+//! \global gu16PeakADC, gu8PeakLit
+//! \note   gcau16ChargeLevelADC[] holds at FULL_LOAD_LIT LEDs lit, a lighter peak is corrected to that
+//!         by ADC_PER_LED for each LED missing.
 //-----------------------------------------------------------------------------
-void BatteryLevel_Show( void )
+static U8 ChargeLevel( void )
 {
-  U16 u16MeasuredLevel;
-  U8  u8ChargeLevel;
-  U8  u8Index;
+  U16 u16Level = gu16PeakADC + (U16)( FULL_LOAD_LIT - gu8PeakLit ) * ADC_PER_LED;
+  U8  u8ChargeLevel = 0u;
   
-  // Startup animation
-  // After it, all LED brightness will be set to maximum, to ensure a significant current draw during measurement
-  for( u8Index = 0u; u8Index < LEDS_NUM/2u; u8Index++ )
+  while( ( u8ChargeLevel < CHARGE_LEVELS ) && ( u16Level <= gcau16ChargeLevelADC[ u8ChargeLevel ] ) )
   {
-    gau8LEDBrightness[ u8Index ] = 15u;
-    gau8LEDBrightness[ LEDS_NUM - u8Index - 1u ] = 15u;
-    Delay( 100u );
+    u8ChargeLevel++;
   }
-  gau8RGBLEDs[ 0u ] = 15u;
-  Delay( 100u );
+  return u8ChargeLevel;
+}
+#else
+//----------------------------------------------------------------------------
+//! \brief  Measures the battery with every LED at full brightness, and calculates its charge level
+//! \param  -
+//! \return Charge level, [0; CHARGE_LEVELS]
+//! \global -
+//! \note   Disables the ADC afterwards.
+//-----------------------------------------------------------------------------
+static U8 MeasureChargeLevel( void )
+{
+  U16 u16MeasuredLevel;
+  U8  u8ChargeLevel = 0u;
+  
   // Measure battery voltage
-  ADC_CONTR |= 0x40u;  // Start conversion
-  _nop_();
-  _nop_();
-  while( !( ADC_CONTR & 0x20u ) );  // Wait for completion flag
-  u16MeasuredLevel = ADC_RES<<8u | ADC_RESL;
+  u16MeasuredLevel = BatteryLevel_Measure();
   // Disable ADC to save power
   ADC_CONTR = 0x00u;
   // Calculate battery voltage
@@ -107,38 +228,235 @@ void BatteryLevel_Show( void )
   // As we have 6 + 1 LED levels, we divide this range to 7 levels
   // A floating-point based implementation would be: u8ChargeLevel = round( 7.0f*( f32BatteryVoltage - 2.0f )/0.8f );
   // After simplification, the formula for charge level would be: u8ChargeLevel = round( ( 10662.4f / u16MeasuredLevel ) - 17.5f )
-  if( u16MeasuredLevel >= 610u )  // If the voltage is below 2.0V
+  // Its fixed-point version is ( ( 42650u / u16MeasuredLevel ) - 70u )>>2u, tabulated in gcau16ChargeLevelADC[]
+  // The measurement is always taken with every LED at full brightness, so the load is the same as for the formula
+  while( ( u8ChargeLevel < CHARGE_LEVELS ) && ( u16MeasuredLevel <= gcau16ChargeLevelADC[ u8ChargeLevel ] ) )
   {
-    u8ChargeLevel = 0u;
+    u8ChargeLevel++;
+  }
+  return u8ChargeLevel;
+}
+#endif
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Initializes battery level measurement
+//! \param  -
+//! \return -
+//! \global -
+//! \note   Should be called from init block
+//-----------------------------------------------------------------------------
+void BatteryLevel_Init( void )
+{
+  ADCTIM = 0x3Fu;      // 32 clock sampling time, 2 clocks channel selection hold time
+  ADCCFG = 0x2Fu;      // Right-aligned results registers, slowest conversion
+  ADC_CONTR = 0x80u;   // Enable ADC
+  ADC_CONTR |= 0x0Fu;  // Select internal 1.19V reference
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Takes one conversion of the internal 1.19V reference
+//! \param  -
+//! \return ADC result: 1.19V * 1024 / supply voltage, so it rises as the supply sags
+//! \global -
+//! \note   The ADC has to be enabled by BatteryLevel_Init(). Blocking, for some tens of us.
+//-----------------------------------------------------------------------------
+U16 BatteryLevel_Measure( void )
+{
+  ADC_CONTR |= 0x40u;  // Start conversion
+  _nop_();
+  _nop_();
+  while( !( ADC_CONTR & 0x20u ) );  // Wait for completion flag
+  ADC_CONTR &= ~0x20u;  // Clear completion flag for the next conversion
+  
+  return ADC_RES<<8u | ADC_RESL;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Starts the battery indicator: the boot sweep, the measurement and the gauge
+//! \param  bGauge: FALSE after a warm reset: nothing is shown, the cell has been measured at the power-on
+//! \return -
+//! \global geBatteryState, gu8SweepPair, gu16StepMs
+//! \note   Should be called only once! Non-blocking, the indicator runs in BatteryLevel_Cycle().
+//!         With BATTERY_BACKGROUND the sweep is just shown: the interrupt samples the supply at the
+//!         load its pins have, so it's not held at full brightness for the ADC. Without a gauge its
+//!         windows measure the cell at the load of the animation.
+//-----------------------------------------------------------------------------
+void BatteryLevel_Show( BOOL bGauge )
+{
+  if( !bGauge )
+  {
+    ADC_CONTR = 0x00u;  // Disable ADC to save power, a window enables it again
+    geBatteryState = BATTERY_DONE;
   }
   else
   {
-    u8ChargeLevel = ( ( 42650u / u16MeasuredLevel ) - 70u )>>2u;
+    // Startup animation
+    // After it, all LED brightness will be set to maximum, to ensure a significant current draw during measurement
+    gu8SweepPair = 0u;
+    gau8LEDBrightness[ 0u ] = 15u;
+    gau8LEDBrightness[ LEDS_NUM - 1u ] = 15u;
+    LED_Commit();
+    gu16StepMs = Util_GetTimerMs();
+    geBatteryState = BATTERY_SWEEP;
   }
-  // Display the charge level on the LEDs
-  for( u8Index = 0u; u8Index < LEDS_NUM/2u; u8Index++ )
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Runs the battery indicator; with BATTERY_BACKGROUND measures the battery in the background
+//! \param  -
+//! \return TRUE while the indicator is shown on the LEDs: the animation waits meanwhile
+//! \global geBatteryState, gu8SweepPair, gu16StepMs, gau8LEDBrightness[], gau8RGBLEDs[],
+//!         gu8ChargeLevel, gu16WindowMs, gbitSampling, gbitWindowPending
+//! \note   Should be called from main cycle, after BatteryLevel_Show(). Each step is a deadline of
+//!         the main loop, which idles between the ticks meanwhile, instead of spinning on the timer.
+//!         Afterwards a window is started every SAMPLE_PERIOD_MS, and its charge level is taken
+//!         when the interrupt has finished it.
+//-----------------------------------------------------------------------------
+BOOL BatteryLevel_Cycle( void )
+{
+  BOOL bShown = TRUE;
+  
+  switch( geBatteryState )
   {
-    if( u8ChargeLevel >= u8Index )
+    case BATTERY_SWEEP:    // The boot sweep is lighting up the LEDs pair by pair
+      if( StepElapsed( SWEEP_STEP_MS ) )
+      {
+        gu8SweepPair++;
+        if( gu8SweepPair < LEDS_NUM/2u )
+        {
+          gau8LEDBrightness[ gu8SweepPair ] = 15u;
+          gau8LEDBrightness[ LEDS_NUM - gu8SweepPair - 1u ] = 15u;
+          LED_Commit();
+        }
+        else
+        {
+          gau8RGBLEDs[ 0u ] = 15u;
+#if BATTERY_BACKGROUND
+          // Measure battery voltage: the interrupt samples the heaviest ticks of the full sweep, then disables ADC
+          StartWindow();
+          geBatteryState = BATTERY_MEASURE;
+#else
+          geBatteryState = BATTERY_SETTLE;
+#endif
+        }
+      }
+      break;
+    
+#if BATTERY_BACKGROUND
+    case BATTERY_MEASURE:  // Every LED is lit, the interrupt is sampling the window
+      if( !gbitSampling )
+      {
+        gu8ChargeLevel = ChargeLevel();
+        ShowGauge( gu8ChargeLevel );
+        gu16StepMs = Util_GetTimerMs();
+        geBatteryState = BATTERY_GAUGE;
+      }
+      break;
+#else
+    case BATTERY_SETTLE:   // Every LED is lit, the supply is settling for the measurement
+      if( StepElapsed( SETTLE_MS ) )
+      {
+        ShowGauge( MeasureChargeLevel() );
+        geBatteryState = BATTERY_GAUGE;
+      }
+      break;
+#endif
+    
+    case BATTERY_GAUGE:    // The charge level is shown
+      if( StepElapsed( GAUGE_MS ) )  // so the user can read the battery charge level
+      {
+        geBatteryState = BATTERY_DONE;
+        bShown = FALSE;
+      }
+      break;
+    
+    default:  // BATTERY_DONE -- The animation runs
+      bShown = FALSE;
+#if BATTERY_BACKGROUND
+      if( gbitWindowPending && !gbitSampling )
+      {
+        gbitWindowPending = 0;
+        gu8ChargeLevel = ChargeLevel();
+      }
+      if( (U16)( Util_GetTimerMs() - gu16WindowMs ) >= SAMPLE_PERIOD_MS )
+      {
+        StartWindow();
+        gbitWindowPending = 1;
+      }
+#endif
+      break;
+  }
+  
+  return bShown;
+}
+
+#if BATTERY_BACKGROUND
+//----------------------------------------------------------------------------
+//! \brief  Interrupt routine of the background measurement
+//! \param  -
+//! \return -
+//! \global gu16PeakADC, gu8PeakLit, gu8ConvertLit, gu8Samples, gbitSampling, gbitConverting
+//! \note   Should be called from the Timer0 interrupt, after LED_Interrupt() and RGBLED_Interrupt().
+//!         A conversion is started just after the pins of the tick are set, so their load is the
+//!         one the ADC samples: the lit LEDs are counted on the pins. Ticks with an RGB current
+//!         pulse are skipped, its load is not known. The result is read at the next tick, the
+//!         slowest conversion takes less than 100 us. The window keeps the heaviest load seen,
+//!         and its lowest voltage.
+//-----------------------------------------------------------------------------
+void BatteryLevel_Interrupt( void )
+{
+  U16 u16Result;
+  
+  if( !gbitSampling )
+  {
+    return;
+  }
+  if( gbitConverting )
+  {
+    if( !( ADC_CONTR & 0x20u ) )  // Completion flag
     {
-      gau8LEDBrightness[ u8Index ] = 15u;
-      gau8LEDBrightness[ LEDS_NUM - u8Index - 1u ] = 15u;
+      return;
     }
-    else
+    ADC_CONTR &= ~0x20u;
+    gbitConverting = 0;
+    u16Result = ADC_RES<<8u | ADC_RESL;
+    if( ( 0u != gu8Samples )  // the first one after the power-up is dropped
+     && ( ( gu8ConvertLit > gu8PeakLit ) || ( ( gu8ConvertLit == gu8PeakLit ) && ( u16Result > gu16PeakADC ) ) ) )
     {
-      gau8LEDBrightness[ u8Index ] = 0u;
-      gau8LEDBrightness[ LEDS_NUM - u8Index - 1u ] = 0u;
+      gu8PeakLit = gu8ConvertLit;
+      gu16PeakADC = u16Result;
+    }
+    gu8Samples++;
+    if( SAMPLES <= gu8Samples )
+    {
+      ADC_CONTR = 0x00u;  // Disable ADC to save power
+      gbitSampling = 0;
     }
   }
-  if( u8ChargeLevel > LEDS_NUM/2u )
-  {
-    gau8RGBLEDs[ 0u ] = 15u;  // Light up red LED
-  }
+#if BOARD_RGBLED
+  else if( 0 == CR )  // no RGB current pulse running
+#else
   else
+#endif
   {
-    gau8RGBLEDs[ 0u ] = 0u;
+    gu8ConvertLit = (U8)BOARD_LED0 + (U8)BOARD_LED1 + (U8)BOARD_LED2 + (U8)BOARD_LED3 + (U8)BOARD_LED4 + (U8)BOARD_LED5;
+    ADC_CONTR |= 0x40u;  // Start conversion
+    gbitConverting = 1;
   }
-  // Wait, so the user can read the battery charge level
-  Delay( 2000u );
 }
 
+//----------------------------------------------------------------------------
+//! \brief  Gives the charge level of the battery
+//! \param  -
+//! \return Charge level of the last measurement, [0; 7]
+//! \global gu8ChargeLevel
+//-----------------------------------------------------------------------------
+U8 BatteryLevel_GetChargeLevel( void )
+{
+  return gu8ChargeLevel;
+}
+#endif
+
 /***************************************< End of file >**************************************/
@@ -12,8 +12,12 @@
 #define BATTERYLEVEL_H
 
 /***************************************< Includes >**************************************/
+#include "types.h"
 
 /***************************************< Definitions >**************************************/
+#ifndef BATTERY_BACKGROUND
+#define BATTERY_BACKGROUND    (1u)  //!< 1: the supply is sampled by the Timer0 interrupt at the ticks of the soft-PWM, at the load its pins show
+#endif
 
 /***************************************< Types >**************************************/
 
@@ -23,7 +27,13 @@
 
 /***************************************< Public functions >**************************************/
 void BatteryLevel_Init( void );
-void BatteryLevel_Show( void );
+U16  BatteryLevel_Measure( void );
+void BatteryLevel_Show( BOOL bGauge );
+BOOL BatteryLevel_Cycle( void );
+#if BATTERY_BACKGROUND
+void BatteryLevel_Interrupt( void );
+U8   BatteryLevel_GetChargeLevel( void );
+#endif
 
 
 #endif /* BATTERYLEVEL_H */
@@ -0,0 +1,110 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2021-2022 Hekk_Elek
+*
+* \file board.h
+*
+* \brief Board variants: pin map, LED order and animation set
+*
+* \author Hekk_Elek
+*
+* \note  Select the board with the BOARD define of the project (e.g. BOARD=BOARD_HULLOCSILLAG);
+*        everything that differs between the variants is here and resolved at compile time, so the
+*        drivers and the animation VM are shared.
+*        The pin macros name SFR bits, stc8g.h has to be included before they are used.
+*        led_isr.a51 reads this file too: the values used there have no C suffix.
+*
+**********************************************************************************************************/
+#ifndef BOARD_H
+#define BOARD_H
+
+/***************************************< Includes >**************************************/
+
+
+/***************************************< Definitions >**************************************/
+#define BOARD_KARIFA          (0u)  //!< Christmas tree panel with the RGB LED on the top
+#define BOARD_HULLOCSILLAG    (1u)  //!< Shooting star panel, no RGB LED
+
+#ifndef BOARD
+#define BOARD                 BOARD_KARIFA  //!< Board variant to build for
+#endif
+
+#if BOARD == BOARD_KARIFA
+// LED common pins
+#define BOARD_LED0            (P17)  //!< Pin of LED0 common pin
+#define BOARD_LED1            (P34)  //!< Pin of LED1 common pin
+#define BOARD_LED2            (P35)  //!< Pin of LED2 common pin
+#define BOARD_LED3            (P37)  //!< Pin of LED3 common pin
+#define BOARD_LED4            (P36)  //!< Pin of LED4 common pin
+#define BOARD_LED5            (P33)  //!< Pin of LED5 common pin
+#define BOARD_LEFT_SIDE       (1)    //!< Value of gbitSide while the left side is driven
+// Index in gau8LEDBrightness[] shown by each common pin on the left side
+#define BOARD_LEFT_LED0       (0)    //!< D12
+#define BOARD_LEFT_LED1       (1)    //!< D4
+#define BOARD_LEFT_LED2       (2)    //!< D6
+#define BOARD_LEFT_LED3       (3)    //!< D10
+#define BOARD_LEFT_LED4       (4)    //!< D8
+#define BOARD_LEFT_LED5       (5)    //!< D2
+// Index in gau8LEDBrightness[] shown by each common pin on the right side
+#define BOARD_RIGHT_LED0      (11)   //!< D13
+#define BOARD_RIGHT_LED1      (10)   //!< D5
+#define BOARD_RIGHT_LED2      (9)    //!< D7
+#define BOARD_RIGHT_LED3      (8)    //!< D11
+#define BOARD_RIGHT_LED4      (7)    //!< D9
+#define BOARD_RIGHT_LED5      (6)    //!< D3
+#define BOARD_RGBLED          (1u)   //!< The RGB LED is fitted
+#define BOARD_NUM_ANIMATIONS  (18u)  //!< Number of animations in the set of this board
+
+#elif BOARD == BOARD_HULLOCSILLAG
+// LED common pins
+#define BOARD_LED0            (P35)  //!< Pin of LED0 common pin
+#define BOARD_LED1            (P17)  //!< Pin of LED1 common pin
+#define BOARD_LED2            (P34)  //!< Pin of LED2 common pin
+#define BOARD_LED3            (P36)  //!< Pin of LED3 common pin
+#define BOARD_LED4            (P33)  //!< Pin of LED4 common pin
+#define BOARD_LED5            (P37)  //!< Pin of LED5 common pin
+#define BOARD_LEFT_SIDE       (0)    //!< Value of gbitSide while the left side is driven
+// Index in gau8LEDBrightness[] shown by each common pin on the left side
+#define BOARD_LEFT_LED0       (0)    //!< D7
+#define BOARD_LEFT_LED1       (1)    //!< D13
+#define BOARD_LEFT_LED2       (2)    //!< D5
+#define BOARD_LEFT_LED3       (3)    //!< D9
+#define BOARD_LEFT_LED4       (4)    //!< D3
+#define BOARD_LEFT_LED5       (5)    //!< D11
+// Index in gau8LEDBrightness[] shown by each common pin on the right side
+#define BOARD_RIGHT_LED0      (10)   //!< D6
+#define BOARD_RIGHT_LED1      (9)    //!< D12
+#define BOARD_RIGHT_LED2      (8)    //!< D4
+#define BOARD_RIGHT_LED3      (7)    //!< D8
+#define BOARD_RIGHT_LED4      (6)    //!< D2
+#define BOARD_RIGHT_LED5      (11)   //!< D10
+#define BOARD_RGBLED          (0u)   //!< The RGB LED is not fitted: its driver and the RGB track of the animations are compiled out
+#define BOARD_NUM_ANIMATIONS  (12u)  //!< Number of animations in the set of this board
+
+#else
+#error "Unknown BOARD"
+#endif
+
+// Pin parking in the power-down, see ParkPins() of main.c: the latch, M0 and M1 values of each port.
+// The default is every pin quasi-bidirectional and high: both ends of every LED are high, so it is
+// dark. A variant may define its own, measured on its board; P3.2 of the button has to stay
+// quasi-bidirectional and high, for the INT0 wake-up.
+#ifndef BOARD_PARK_P1
+#define BOARD_PARK_P1         (0xFFu)  //!< P1 latch in the power-down
+#define BOARD_PARK_P1M0       (0x00u)  //!< P1M0 in the power-down
+#define BOARD_PARK_P1M1       (0x00u)  //!< P1M1 in the power-down
+#endif
+#ifndef BOARD_PARK_P3
+#define BOARD_PARK_P3         (0xFFu)  //!< P3 latch in the power-down
+#define BOARD_PARK_P3M0       (0x00u)  //!< P3M0 in the power-down
+#define BOARD_PARK_P3M1       (0x00u)  //!< P3M1 in the power-down
+#endif
+#ifndef BOARD_PARK_P5
+#define BOARD_PARK_P5         (0x3Fu)  //!< P5 latch in the power-down
+#define BOARD_PARK_P5M0       (0x00u)  //!< P5M0 in the power-down
+#define BOARD_PARK_P5M1       (0x00u)  //!< P5M1 in the power-down
+#endif
+
+
+#endif /* BOARD_H */
+
+/***************************************< End of file >**************************************/
@@ -7,45 +7,223 @@
 *
 * \author Hekk_Elek
 *
+* \note  With LED_FRAME_LATCH the program draws into gau8LEDBrightness[], and the interrupt shows
+*        gau8LEDShown[]: LED_Commit() hands a drawn frame over, the interrupt copies it at the next
+*        period boundary, when gu8PWMCounter wraps. So a change lands at the start of a period, and
+*        the steps of an instruction are never shown. Until the copy LED_IsFramePending() tells the
+*        program to leave the frame alone.
+*        With LED_PHASE_STAGGER each common pin compares against the threshold XORed with its own
+*        phase, the bit-reversed 0..5: the XOR is a permutation of the thresholds, so every level
+*        keeps its on-ticks per period, but the LEDs of a side take them in different ticks, and
+*        the peak current of the cell drops, e.g. from 6 LEDs to 3 at level 8. The last tick of a
+*        period isn't dark then, so the pins are cleared before the multiplexer switches.
+*        With LED_RGB_SCHEDULE LED_Commit() also counts the LEDs lit in each tick of the period, and
+*        ranks the ticks in gau8LEDLoadOrder[]: the RGB driver compares its levels against the rank,
+*        so a color of level n is pulsed in the n least loaded ticks. The RGB LED takes the same
+*        ticks in the periods of both sides, so their loads are added. Ties keep the spread order:
+*        with the LEDs dark the RGB pulses are spread like the LED levels.
+*        With LED_FRC_BITS the program may draw a fraction of each level in gau8LEDFraction[] too.
+*        LED_Commit() takes both into gau8FrcLevel[], and LED_DitherCycle() of the main loop stages a
+*        frame of the neighbouring levels for each period in gau8LEDStaged[]: the latch copies it
+*        instead of gau8LEDBrightness[], so the interrupt does just the same work at the same rate.
+*        The fraction is taken in the bit-reversed order of the frames, a frame being the periods of
+*        both sides: a quarter is a level higher in one frame of four, a half in every second one.
+*        Only RankTicks() sees the levels without the fraction.
+*        Every board of board.h is built on the STC8G1K08, which has no PWMA/PWMB units, so the
+*        common pins are soft-PWM'd by Timer0. stc8h.h is kept for a port: in the same footprint the
+*        STC8H1K08 could take MPX1/MPX2 on PWM1P/PWM1N, but P3.5..P3.7 have no PWM output there, so
+*        the six common pins of these boards can't all move to hardware duty registers.
+*
 **********************************************************************************************************/
 
 /***************************************< Includes >**************************************/
 // Own includes
 #include "stc8g.h"
 #include "types.h"
+#include "board.h"
 #include "led.h"
+#if BOARD_RGBLED
+#include "rgbled.h"
+#endif
 
 
 /***************************************< Definitions >**************************************/
-#define PWM_LEVELS      (16u)  //!< PWM levels implemented: [0; PWM_LEVELS)
+#define PWM_LEVELS      (16u)  //!< PWM levels implemented: [0; PWM_LEVELS); led_isr.a51 has its own copy
+
+#if LED_FRAME_LATCH
+#define SHOWN           gau8LEDShown       //!< Frame read by the interrupt
+#else
+#define SHOWN           gau8LEDBrightness  //!< Frame read by the interrupt
+#endif
+#if LED_FRC_BITS
+#define LATCHED         gau8LEDStaged      //!< Frame copied by the latch; led_isr.a51 has its own copy
+#else
+#define LATCHED         gau8LEDBrightness  //!< Frame copied by the latch; led_isr.a51 has its own copy
+#endif
+
+#if LED_ASM_ISR && defined( __IAR_SYSTEMS_ICC__ )
+#error "LED_ASM_ISR: led_isr.a51 is written for Keil A51"
+#endif
 
 // Pin definitions
 #define MPX1            (P10)  //!< Pin of MPX1 multiplexer pin
 #define MPX2            (P11)  //!< Pin of MPX2 multiplexer pin
-#define LED0            (P17)  //!< Pin of LED0 common pin
-#define LED1            (P34)  //!< Pin of LED1 common pin
-#define LED2            (P35)  //!< Pin of LED2 common pin
-#define LED3            (P37)  //!< Pin of LED3 common pin
-#define LED4            (P36)  //!< Pin of LED4 common pin
-#define LED5            (P33)  //!< Pin of LED4 common pin
+#define LED0            BOARD_LED0  //!< Pin of LED0 common pin
+#define LED1            BOARD_LED1  //!< Pin of LED1 common pin
+#define LED2            BOARD_LED2  //!< Pin of LED2 common pin
+#define LED3            BOARD_LED3  //!< Pin of LED3 common pin
+#define LED4            BOARD_LED4  //!< Pin of LED4 common pin
+#define LED5            BOARD_LED5  //!< Pin of LED5 common pin
+
+// PWM phases of the common pins, XORed into the threshold; led_isr.a51 has its own copy
+#if LED_PHASE_STAGGER
+#define PHASE_LED0      (0u)   //!< Phase of LED0 common pin
+#define PHASE_LED1      (8u)   //!< Phase of LED1 common pin
+#define PHASE_LED2      (4u)   //!< Phase of LED2 common pin
+#define PHASE_LED3      (12u)  //!< Phase of LED3 common pin
+#define PHASE_LED4      (2u)   //!< Phase of LED4 common pin
+#define PHASE_LED5      (10u)  //!< Phase of LED5 common pin
+#else
+#define PHASE_LED0      (0u)
+#define PHASE_LED1      (0u)
+#define PHASE_LED2      (0u)
+#define PHASE_LED3      (0u)
+#define PHASE_LED4      (0u)
+#define PHASE_LED5      (0u)
+#endif
 
 
 /***************************************< Types >**************************************/
 
 
 /***************************************< Constants >**************************************/
+#if LED_PWM_SPREAD && ( !LED_ASM_ISR || LED_RGB_SCHEDULE )
+//! \brief Order of the PWM thresholds over a period: the 4-bit reversed counter
+//! \note  A level is on in the ticks whose threshold is below it, so e.g. level 8 is on in every second tick
+static CODE const U8 gcau8PWMOrder[ PWM_LEVELS ] =
+{
+  0u, 8u, 4u, 12u, 2u, 10u, 6u, 14u, 1u, 9u, 5u, 13u, 3u, 11u, 7u, 15u
+};
+#endif
 
+#if LED_FRC_BITS
+//! \brief Thresholds of the fraction over the frames: the 2-bit reversed counter, shifted for LED_FRC_BITS
+static CODE const U8 gcau8FrcOrder[ 4u ] =
+{
+  0u >> ( 2u - LED_FRC_BITS ), 2u >> ( 2u - LED_FRC_BITS ), 1u >> ( 2u - LED_FRC_BITS ), 3u >> ( 2u - LED_FRC_BITS )
+};
+#endif
+
+#if LED_RGB_SCHEDULE && BOARD_RGBLED
+//! \brief Array index of the LED on each common pin, left side
+static CODE const U8 gcau8LeftLED[ LEDS_NUM/2u ] =
+{
+  BOARD_LEFT_LED0, BOARD_LEFT_LED1, BOARD_LEFT_LED2, BOARD_LEFT_LED3, BOARD_LEFT_LED4, BOARD_LEFT_LED5
+};
+//! \brief Array index of the LED on each common pin, right side
+static CODE const U8 gcau8RightLED[ LEDS_NUM/2u ] =
+{
+  BOARD_RIGHT_LED0, BOARD_RIGHT_LED1, BOARD_RIGHT_LED2, BOARD_RIGHT_LED3, BOARD_RIGHT_LED4, BOARD_RIGHT_LED5
+};
+//! \brief PWM phase of each common pin
+static CODE const U8 gcau8PinPhase[ LEDS_NUM/2u ] =
+{
+  PHASE_LED0, PHASE_LED1, PHASE_LED2, PHASE_LED3, PHASE_LED4, PHASE_LED5
+};
+#endif
 
 /***************************************< Global variables >**************************************/
-DATA U8 gau8LEDBrightness[ LEDS_NUM ];  //!< Array for storing individual brightness levels
-DATA U8 gu8PWMCounter;                  //!< Counter for the base of soft-PWM
+ISR_DATA U8 gau8LEDBrightness[ LEDS_NUM ];  //!< Array for storing individual brightness levels
+ISR_DATA U8 gu8PWMCounter;                  //!< Counter for the base of soft-PWM
 DATA BIT gbitSide;                      //!< Stores which side of the panel is active
+#if LED_RGB_SCHEDULE
+ISR_DATA U8 gau8LEDLoadOrder[ PWM_LEVELS ];  //!< Rank of each tick by the LEDs lit in it, lowest first; the RGB thresholds
+#if BOARD_RGBLED
+static MAIN_DATA U8 gau8TickLoad[ PWM_LEVELS ];  //!< LEDs lit in each tick, both sides together; scratch of RankTicks()
+#endif
+#endif
+#if LED_FRAME_LATCH
+ISR_DATA U8 gau8LEDShown[ LEDS_NUM ];       //!< Frame shown by the interrupt, copied from gau8LEDBrightness[] after LED_Commit()
+DATA BIT gbitLEDCommit;                 //!< Set by LED_Commit(), cleared by the interrupt when it has taken the frame
+#endif
+#if LED_FRC_BITS
+MAIN_DATA U8 gau8LEDFraction[ LEDS_NUM ];  //!< Fraction of each level of gau8LEDBrightness[] in LED_FRC_BITS, cleared by LED_Commit()
+ISR_DATA U8 gau8LEDStaged[ LEDS_NUM ];      //!< Dithered frame of the next period, copied by the latch
+static MAIN_DATA U8 gau8FrcLevel[ LEDS_NUM ];  //!< Frame committed last, LED_FRC_BITS more bits of level
+static MAIN_DATA U8 gu8FrcPhase;          //!< Frame of the dither cycle, the index of gcau8FrcOrder[]
+static BIT gbitFrcNew;                    //!< A frame is committed, and not staged yet
+static BIT gbitFrcFirst;                  //!< The staged frame is the first of a committed one
+static BIT gbitFrcActive;                 //!< The frame committed last has a fraction, it is dithered in every period
+#endif
 
 
 /***************************************< Static function definitions >**************************************/
+#if LED_RGB_SCHEDULE && BOARD_RGBLED
+static void RankTicks( void );
+#endif
 
 
 /***************************************< Private functions >**************************************/
+#if LED_RGB_SCHEDULE && BOARD_RGBLED
+//----------------------------------------------------------------------------
+//! \brief  Ranks the ticks of the period by the LEDs lit in them, in the frame drawn
+//! \param  -
+//! \return -
+//! \global gau8LEDBrightness[], gau8TickLoad[], gau8LEDLoadOrder[]
+//! \note   Ticks of the same load are ranked in their spread order. The ranks are written in
+//!         place while the interrupt reads them: for a period at most, a color may take a tick
+//!         more or less.
+//-----------------------------------------------------------------------------
+static void RankTicks( void )
+{
+  U8 u8Tick;
+  U8 u8Pin;
+  U8 u8Threshold;
+  U8 u8Load;
+  U8 u8Rank = 0u;
+  
+  // LEDs lit in each tick, as LED_Interrupt() will light them
+  for( u8Tick = 0u; u8Tick < PWM_LEVELS; u8Tick++ )
+  {
+#if LED_PWM_SPREAD
+    u8Threshold = gcau8PWMOrder[ u8Tick ];
+#else
+    u8Threshold = u8Tick;
+#endif
+    u8Load = 0u;
+    for( u8Pin = 0u; u8Pin < LEDS_NUM/2u; u8Pin++ )
+    {
+      if( gau8LEDBrightness[ gcau8LeftLED[ u8Pin ] ] > ( u8Threshold ^ gcau8PinPhase[ u8Pin ] ) )
+      {
+        u8Load++;
+      }
+      if( gau8LEDBrightness[ gcau8RightLED[ u8Pin ] ] > ( u8Threshold ^ gcau8PinPhase[ u8Pin ] ) )
+      {
+        u8Load++;
+      }
+    }
+    gau8TickLoad[ u8Tick ] = u8Load;
+  }
+  
+  // Counting sort: the lightest ticks first, each load in the spread order
+  for( u8Load = 0u; ( u8Load <= LEDS_NUM ) && ( u8Rank < PWM_LEVELS ); u8Load++ )
+  {
+    for( u8Threshold = 0u; u8Threshold < PWM_LEVELS; u8Threshold++ )
+    {
+#if LED_PWM_SPREAD
+      u8Tick = gcau8PWMOrder[ u8Threshold ];  // the reversed counter is its own inverse: the tick of this threshold
+#else
+      u8Tick = u8Threshold;
+#endif
+      if( u8Load == gau8TickLoad[ u8Tick ] )
+      {
+        gau8LEDLoadOrder[ u8Tick ] = u8Rank;
+        u8Rank++;
+      }
+    }
+  }
+}
+#endif
 
 
 /***************************************< Public functions >**************************************/
@@ -53,7 +231,7 @@ DATA BIT gbitSide;                      //!< Stores which side of the panel is a
 //! \brief  Initialize all IO pins associated with LEDs
 //! \param  -
 //! \return -
-//! \global gau8LEDBrightness[], gu8PWMCounter
+//! \global gau8LEDBrightness[], gau8LEDShown[], gbitLEDCommit, gu8PWMCounter, gau8LEDLoadOrder[], the FRC state
 //! \note   Should be called in the init block
 //-----------------------------------------------------------------------------
 void LED_Init( void )
@@ -65,7 +243,31 @@ void LED_Init( void )
   for( u8Index = 0; u8Index < LEDS_NUM; u8Index++ )
   {
     gau8LEDBrightness[ u8Index ] = 0;
+#if LED_FRAME_LATCH
+    gau8LEDShown[ u8Index ] = 0;
+#endif
   }
+#if LED_FRAME_LATCH
+  gbitLEDCommit = 0;
+#endif
+#if LED_FRC_BITS
+  for( u8Index = 0; u8Index < LEDS_NUM; u8Index++ )
+  {
+    gau8LEDFraction[ u8Index ] = 0;
+    gau8LEDStaged[ u8Index ] = 0;
+    gau8FrcLevel[ u8Index ] = 0;
+  }
+  gu8FrcPhase = 0;
+  gbitFrcNew = 0;
+  gbitFrcFirst = 0;
+  gbitFrcActive = 0;
+#endif
+#if LED_RGB_SCHEDULE
+  for( u8Index = 0; u8Index < PWM_LEVELS; u8Index++ )
+  {
+    gau8LEDLoadOrder[ u8Index ] = u8Index;
+  }
+#endif
   
   // Starting with MPX1
   gbitSide = 0;
@@ -98,25 +300,60 @@ void LED_Init( void )
 //! \brief  Interrupt routine to implement soft-PWM
 //! \param  -
 //! \return -
-//! \global gau8LEDBrightness[], gu8PWMCounter
+//! \global gau8LEDShown[] or gau8LEDBrightness[], gbitLEDCommit, gu8PWMCounter, gbitSide
 //! \note   Should be called from periodic timer interrupt routine.
+//!         With LED_FRAME_LATCH a committed frame is copied at the wrap of gu8PWMCounter, once.
+//!         With LED_PWM_SPREAD the on-ticks of a level are spread over the period, see gcau8PWMOrder[].
+//!         With LED_PHASE_STAGGER every common pin takes them in its own phase, PHASE_LEDn.
+//!         With LED_ASM_ISR led_isr.a51 has the same function, and this one is left out.
 //-----------------------------------------------------------------------------
+#if !LED_ASM_ISR
 void LED_Interrupt( void )
 {
+  U8 u8Threshold;
+#if LED_FRAME_LATCH
+  U8 u8Index;
+#endif
+  
   gu8PWMCounter++;
   if( gu8PWMCounter == PWM_LEVELS )
   {
     gu8PWMCounter = 0;
     gbitSide ^= 1;
+#if LED_PHASE_STAGGER
+    // The last tick isn't dark: no LED of the new side may show it
+    LED0 = 0;
+    LED1 = 0;
+    LED2 = 0;
+    LED3 = 0;
+    LED4 = 0;
+    LED5 = 0;
+#endif
     // Set multiplexer pins
     MPX1 = gbitSide;
     MPX2 = ~gbitSide;
+#if LED_FRAME_LATCH
+    if( gbitLEDCommit )
+    {
+      for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+      {
+        gau8LEDShown[ u8Index ] = LATCHED[ u8Index ];
+      }
+      gbitLEDCommit = 0;
+    }
+#endif
   }
+#if LED_PWM_SPREAD
+  u8Threshold = gcau8PWMOrder[ gu8PWMCounter ];
+#else
+  u8Threshold = gu8PWMCounter;
+#endif
   
-  //NOTE: unfortunately SFRs cannot be put in an array, so this cannot be implented as a for cycle
-  if( gbitSide )  // left side
+  //NOTE: unfortunately SFRs cannot be put in an array, so this cannot be implented as a for cycle;
+  //      the LED order of the board (board.h) is resolved at compile time instead
+  if( BOARD_LEFT_SIDE == gbitSide )  // left side
   {
-    if( gau8LEDBrightness[ 0u ] > gu8PWMCounter )  // D12
+    if( SHOWN[ BOARD_LEFT_LED0 ] > ( u8Threshold ^ PHASE_LED0 ) )
     {
       LED0 = 1;
     }
@@ -124,7 +361,7 @@ void LED_Interrupt( void )
     {
       LED0 = 0;
     }
-    if( gau8LEDBrightness[ 1u ] > gu8PWMCounter )  // D4
+    if( SHOWN[ BOARD_LEFT_LED1 ] > ( u8Threshold ^ PHASE_LED1 ) )
     {
       LED1 = 1;
     }
@@ -132,7 +369,7 @@ void LED_Interrupt( void )
     {
       LED1 = 0;
     }
-    if( gau8LEDBrightness[ 2u ] > gu8PWMCounter )  // D6
+    if( SHOWN[ BOARD_LEFT_LED2 ] > ( u8Threshold ^ PHASE_LED2 ) )
     {
       LED2 = 1;
     }
@@ -140,7 +377,7 @@ void LED_Interrupt( void )
     {
       LED2 = 0;
     }
-    if( gau8LEDBrightness[ 3u ] > gu8PWMCounter )  // D10
+    if( SHOWN[ BOARD_LEFT_LED3 ] > ( u8Threshold ^ PHASE_LED3 ) )
     {
       LED3 = 1;
     }
@@ -148,7 +385,7 @@ void LED_Interrupt( void )
     {
       LED3 = 0;
     }
-    if( gau8LEDBrightness[ 4u ] > gu8PWMCounter )  // D8
+    if( SHOWN[ BOARD_LEFT_LED4 ] > ( u8Threshold ^ PHASE_LED4 ) )
     {
       LED4 = 1;
     }
@@ -156,7 +393,7 @@ void LED_Interrupt( void )
     {
       LED4 = 0;
     }
-    if( gau8LEDBrightness[ 5u ] > gu8PWMCounter )  // D2
+    if( SHOWN[ BOARD_LEFT_LED5 ] > ( u8Threshold ^ PHASE_LED5 ) )
     {
       LED5 = 1;
     }
@@ -167,7 +404,7 @@ void LED_Interrupt( void )
   }
   else  // right side
   {
-    if( gau8LEDBrightness[ 6u ] > gu8PWMCounter )  // D3
+    if( SHOWN[ BOARD_RIGHT_LED5 ] > ( u8Threshold ^ PHASE_LED5 ) )
     {
       LED5 = 1;
     }
@@ -175,7 +412,7 @@ void LED_Interrupt( void )
     {
       LED5 = 0;
     }
-    if( gau8LEDBrightness[ 7u ] > gu8PWMCounter )  // D9
+    if( SHOWN[ BOARD_RIGHT_LED4 ] > ( u8Threshold ^ PHASE_LED4 ) )
     {
       LED4 = 1;
     }
@@ -183,7 +420,7 @@ void LED_Interrupt( void )
     {
       LED4 = 0;
     }
-    if( gau8LEDBrightness[ 8u ] > gu8PWMCounter )  // D11
+    if( SHOWN[ BOARD_RIGHT_LED3 ] > ( u8Threshold ^ PHASE_LED3 ) )
     {
       LED3 = 1;
     }
@@ -191,7 +428,7 @@ void LED_Interrupt( void )
     {
       LED3 = 0;
     }
-    if( gau8LEDBrightness[ 9u ] > gu8PWMCounter )  // D7
+    if( SHOWN[ BOARD_RIGHT_LED2 ] > ( u8Threshold ^ PHASE_LED2 ) )
     {
       LED2 = 1;
     }
@@ -199,7 +436,7 @@ void LED_Interrupt( void )
     {
       LED2 = 0;
     }
-    if( gau8LEDBrightness[ 10u ] > gu8PWMCounter )  // D5
+    if( SHOWN[ BOARD_RIGHT_LED1 ] > ( u8Threshold ^ PHASE_LED1 ) )
     {
       LED1 = 1;
     }
@@ -207,7 +444,7 @@ void LED_Interrupt( void )
     {
       LED1 = 0;
     }
-    if( gau8LEDBrightness[ 11u ] > gu8PWMCounter )  // D13
+    if( SHOWN[ BOARD_RIGHT_LED0 ] > ( u8Threshold ^ PHASE_LED0 ) )
     {
       LED0 = 1;
     }
@@ -217,6 +454,153 @@ void LED_Interrupt( void )
     }
   }
 }
+#endif /* !LED_ASM_ISR */
+
+#if LED_FRAME_LATCH
+//----------------------------------------------------------------------------
+//! \brief  Hands the frame drawn in gau8LEDBrightness[] over to the interrupt
+//! \param  -
+//! \return -
+//! \global gbitLEDCommit, gau8LEDLoadOrder[]; with LED_FRC_BITS gau8LEDFraction[], gau8FrcLevel[], gbitFrcNew
+//! \note   The frame is shown from the next period boundary on. It should not be changed meanwhile,
+//!         see LED_IsFramePending(), or the copy may take it half drawn. With LED_RGB_SCHEDULE
+//!         the ticks are ranked for the RGB LED first. With LED_FRC_BITS the frame is taken with
+//!         its fraction at once, LED_DitherCycle() stages it; the full level takes no fraction.
+//-----------------------------------------------------------------------------
+void LED_Commit( void )
+{
+#if LED_FRC_BITS
+  U8 u8Index;
+  
+#endif
+#if LED_RGB_SCHEDULE && BOARD_RGBLED
+  RankTicks();
+#endif
+#if LED_FRC_BITS
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+  {
+    gau8FrcLevel[ u8Index ] = gau8LEDBrightness[ u8Index ] << LED_FRC_BITS;
+    if( gau8LEDBrightness[ u8Index ] < ( PWM_LEVELS - 1u ) )
+    {
+      gau8FrcLevel[ u8Index ] |= gau8LEDFraction[ u8Index ] & LED_FRC_MASK;
+    }
+    gau8LEDFraction[ u8Index ] = 0u;
+  }
+  gbitFrcNew = 1;
+  LED_DitherCycle();
+#else
+  gbitLEDCommit = 1;
+#endif
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells if a committed frame still waits for the period boundary
+//! \param  -
+//! \return TRUE until the interrupt has copied the frame
+//! \global gbitLEDCommit
+//-----------------------------------------------------------------------------
+BOOL LED_IsFramePending( void )
+{
+#if LED_FRC_BITS
+  return gbitFrcNew || ( gbitFrcFirst && gbitLEDCommit );
+#else
+  return gbitLEDCommit;
+#endif
+}
+#endif
+
+//----------------------------------------------------------------------------
+//! \brief  Tells if the interrupt is in the last tick of a PWM period
+//! \param  -
+//! \return TRUE from the last tick of a side to the next tick, which switches the multiplexer
+//! \global gu8PWMCounter
+//! \note   Should be called from main cycle, right after the tick, e.g. after the idle mode.
+//!         Without LED_PWM_SPREAD and LED_PHASE_STAGGER every LED is dark in this tick already.
+//-----------------------------------------------------------------------------
+BOOL LED_IsPeriodEnd( void )
+{
+  return ( PWM_LEVELS - 1u ) == gu8PWMCounter;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Turns every LED off until the next tick
+//! \param  -
+//! \return -
+//! \global -
+//! \note   Should be called with the interrupts disabled, before the CPU stalls for long, e.g. for an
+//!         EEPROM erase: the pins stay as they are set meanwhile. At LED_IsPeriodEnd() the stall
+//!         only stretches the dark end of the period, the next tick goes on with the other side.
+//!         A pulse of the RGB LED is cut short too.
+//-----------------------------------------------------------------------------
+void LED_Blank( void )
+{
+  LED0 = 0;
+  LED1 = 0;
+  LED2 = 0;
+  LED3 = 0;
+  LED4 = 0;
+  LED5 = 0;
+#if BOARD_RGBLED
+  RGBLED_Blank();
+#endif
+}
+
+#if LED_FRC_BITS
+//----------------------------------------------------------------------------
+//! \brief  Stages the dithered frame of the next period for the latch
+//! \param  -
+//! \return -
+//! \global gau8FrcLevel[], gau8LEDStaged[], gu8FrcPhase, gbitFrcNew, gbitFrcFirst, gbitFrcActive,
+//!         gbitLEDCommit, gbitSide
+//! \note   Should be called from the main loop after every tick; it stages one frame a period at
+//!         most, once the latch has taken the last one, and nothing without a fraction. The next
+//!         period shows the other side: the phase steps before the left side, so both sides of a
+//!         frame are shown with the same threshold. A late call only shows a frame for longer.
+//-----------------------------------------------------------------------------
+void LED_DitherCycle( void )
+{
+  U8 u8Index;
+  U8 u8Level;
+  U8 u8Threshold;
+  
+  if( ( gbitFrcNew || gbitFrcActive ) && !gbitLEDCommit )
+  {
+    if( BOARD_LEFT_SIDE != gbitSide )
+    {
+      gu8FrcPhase = ( gu8FrcPhase + 1u ) & LED_FRC_MASK;
+    }
+    u8Threshold = gcau8FrcOrder[ gu8FrcPhase ];
+    gbitFrcActive = 0;
+    for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+    {
+      u8Level = gau8FrcLevel[ u8Index ];
+      gau8LEDStaged[ u8Index ] = u8Level >> LED_FRC_BITS;
+      if( ( u8Level & LED_FRC_MASK ) > u8Threshold )
+      {
+        gau8LEDStaged[ u8Index ]++;
+      }
+      if( 0u != ( u8Level & LED_FRC_MASK ) )
+      {
+        gbitFrcActive = 1;
+      }
+    }
+    gbitFrcFirst = gbitFrcNew;
+    gbitFrcNew = 0;
+    gbitLEDCommit = 1;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells if the frame committed last is dithered
+//! \param  -
+//! \return TRUE if an LED has a fraction: the driver has to go on, even if the levels are dark
+//! \global gbitFrcActive
+//-----------------------------------------------------------------------------
+BOOL LED_IsDithering( void )
+{
+  return gbitFrcActive;
+}
+#endif
 
 
 /***************************************< End of file >**************************************/
@@ -16,8 +16,38 @@
 
 /***************************************< Definitions >**************************************/
 #define LEDS_NUM               (12u)  //!< Number of LEDs driven by this driver
+#ifndef LED_PWM_SPREAD
+#define LED_PWM_SPREAD          (1u)  //!< On-ticks are spread evenly over the period instead of one block
+#endif
+#ifndef LED_ASM_ISR
+#define LED_ASM_ISR             (0u)  //!< 1: LED_Interrupt() of led_isr.a51 (Keil only); 0: the C version of led.c
+#endif
+#ifndef LED_PHASE_STAGGER
+#define LED_PHASE_STAGGER       (1u)  //!< Every common pin has its own PWM phase, so the lit LEDs of a side don't turn on in the same tick
+#endif
+#ifndef LED_FRAME_LATCH
+#define LED_FRAME_LATCH         (1u)  //!< 1: the interrupt shows a copy of gau8LEDBrightness[], taken at a period boundary after LED_Commit()
+#endif
+#ifndef LED_RGB_SCHEDULE
+#define LED_RGB_SCHEDULE        (1u)  //!< 1: LED_Commit() ranks the ticks by the LEDs lit, the RGB pulses take the least loaded ones
+#endif
+#if LED_RGB_SCHEDULE && !LED_FRAME_LATCH
+#error "LED_RGB_SCHEDULE: the ticks are ranked by LED_Commit(), build it with LED_FRAME_LATCH"
+#endif
+#ifndef LED_FRC_BITS
+#define LED_FRC_BITS            (0u)  //!< Bits of gau8LEDFraction[] below the levels: the periods dither between neighbouring levels, e.g. 2: 61 levels; 0: off
+#endif
+#define LED_FRC_MASK            ( ( 1u << LED_FRC_BITS ) - 1u )  //!< Fraction of a level in gau8LEDFraction[]
+#if LED_FRC_BITS && !LED_FRAME_LATCH
+#error "LED_FRC_BITS: the dithered frames are handed over by the latch, build it with LED_FRAME_LATCH"
+#endif
+#if LED_FRC_BITS > 2u
+#error "LED_FRC_BITS: at most 2 bits, a longer cycle of the dither flickers"
+#endif
 
 
+#ifndef __A51__  // led_isr.a51 only reads the definitions
+
 /***************************************< Types >**************************************/
 
 
@@ -25,13 +55,37 @@
 
 
 /***************************************< Global variables >**************************************/
-extern DATA U8 gau8LEDBrightness[ LEDS_NUM ];
+extern ISR_DATA U8 gau8LEDBrightness[ LEDS_NUM ];
+extern ISR_DATA U8 gu8PWMCounter;
+#if LED_RGB_SCHEDULE
+extern ISR_DATA U8 gau8LEDLoadOrder[ 16u ];
+#endif
+#if LED_FRC_BITS
+extern MAIN_DATA U8 gau8LEDFraction[ LEDS_NUM ];
+#endif
 
 
 /***************************************< Public functions >**************************************/
 void LED_Init( void );
 void LED_Interrupt( void );
+BOOL LED_IsPeriodEnd( void );
+void LED_Blank( void );
+#if LED_FRAME_LATCH
+void LED_Commit( void );
+BOOL LED_IsFramePending( void );
+#else
+#define LED_Commit()                 //!< Without the latch the interrupt shows gau8LEDBrightness[] right away
+#define LED_IsFramePending()  (0u)   //!< Without the latch no frame waits
+#endif
+#if LED_FRC_BITS
+void LED_DitherCycle( void );
+BOOL LED_IsDithering( void );
+#else
+#define LED_DitherCycle()            //!< Without LED_FRC_BITS the committed frame is shown as drawn
+#define LED_IsDithering()     (0u)   //!< Without LED_FRC_BITS nothing is dithered
+#endif
 
+#endif /* __A51__ */
 
 #endif /* LED_H */
 
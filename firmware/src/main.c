@@ -16,16 +16,24 @@
 // Own includes
 #include "stc8g.h"
 #include "types.h"
+#include "board.h"
 #include "util.h"
 #include "led.h"
 #include "rgbled.h"
 #include "animation.h"
 #include "persist.h"
 #include "batterylevel.h"
+#include "selftest.h"
 
 
 /***************************************< Definitions >**************************************/
 #define BUTTON_PIN     (P32)  //!< Button for selecting animation and turning it off and on
+#define BUTTON_MASK    (1u<<2u)  //!< Bit of BUTTON_PIN in the P3 registers
+#define BUTTON_SAMPLE_MS (4u)  //!< Period of the sampling of the button; far below the 50 ms debounce time
+#if ( 0u == ( BOARD_PARK_P3 & BUTTON_MASK ) ) || ( 0u != ( ( BOARD_PARK_P3M0 | BOARD_PARK_P3M1 ) & BUTTON_MASK ) )
+#error "BOARD_PARK_P3: the button has to stay quasi-bidirectional and high in the power-down"
+#endif
+#define SLEEP_MIN_MS   (5u)   //!< Shortest dark period worth powering down for, with UTIL_SLEEP
 
 
 /***************************************< Types >**************************************/
@@ -43,13 +51,22 @@ static enum
   BUTTON_PRESSED,    //!< The button got debounced
   BUTTON_LONGPRESS,  //!< The button has been pressed for long
   BUTTON_RELEASING   //!< The button just got released and it's currently bouncing
-} geButtonState;
+} MAIN_DATA geButtonState;
 
-static U16 gu16ButtonPressTimer;  //!< Timer for the button debouncing state machine
+static MAIN_DATA U16 gu16ButtonPressTimer;  //!< Timer for the button debouncing state machine
+static MAIN_DATA U8  gu8ButtonSampleMs;     //!< Low byte of the ms timer at the last sampling window
+static DATA BIT gbitButtonLevel;            //!< Level of the button at the last sample: 0 is pressed
+static DATA BIT gbitButtonWindow;           //!< The pull-up of the button is on, the pin is read at the next tick
+#if UTIL_SLEEP
+static DATA BIT gbitSleeping;               //!< Util_Sleep() is running: INT0 just wakes up, instead of the reset
+#endif
 
 
 /***************************************< Static function definitions >**************************************/
 static void Timer0Init( void );
+static void ButtonCycle( void );
+static void ButtonWakeMode( void );
+static void ParkPins( void );
 
 
 /***************************************< Private functions >**************************************/
@@ -57,19 +74,93 @@ static void Timer0Init( void );
 //! \brief  Timer 0 initialization (100 us interrupt period)
 //! \param  -
 //! \return -
-//! \note   Assumes 24 MHz system clock. Generated using STC-ISP tool.
+//! \note   Reload from SYSTEM_CLOCK_MHZ, see Util_SetClockDivider(). Generated using STC-ISP tool.
 //-----------------------------------------------------------------------------
 static void Timer0Init( void )
 {
   TR0 = 0;       //Timer0 stop run
   AUXR |= 0x80;  //Timer clock is 1T mode
   TMOD &= 0xF0;  //Set timer work mode
-  TL0 = 0xA0;    //Initial timer value
-  TH0 = 0xF6;    //Initial timer value
+  TL0 = (U8)UTIL_TIMER0_RELOAD;            //Initial timer value
+  TH0 = (U8)( UTIL_TIMER0_RELOAD >> 8u );  //Initial timer value
   TF0 = 0;       //Clear TF0 flag
   TR0 = 1;       //Timer0 start run
 }
 
+//----------------------------------------------------------------------------
+//! \brief  Samples the button in a short window of the pull-up, once in BUTTON_SAMPLE_MS
+//! \param  -
+//! \return -
+//! \global gbitButtonLevel, gbitButtonWindow, gu8ButtonSampleMs
+//! \note   Should be called at every tick of the main loop. The pull-up is on for one tick (100 us),
+//!         the pin is read at the next. Between the windows the pin is driven low: the button shorts it
+//!         to the ground, so nothing flows whether it's pressed or not, and the pin doesn't float.
+//-----------------------------------------------------------------------------
+static void ButtonCycle( void )
+{
+  if( gbitButtonWindow )  // the pull-up has been on for a tick
+  {
+    gbitButtonLevel = BUTTON_PIN;
+    gbitButtonWindow = 0;
+    BUTTON_PIN = 0;
+    P3M0 |= BUTTON_MASK;  // push-pull, low
+    P3M1 &= ~BUTTON_MASK;
+    P_SW2 |= P_SW2_EAXFR;
+    P3PU &= ~BUTTON_MASK;
+    P_SW2 &= ~P_SW2_EAXFR;
+  }
+  else if( (U8)( (U8)Util_GetTimerMs() - gu8ButtonSampleMs ) >= BUTTON_SAMPLE_MS )
+  {
+    gu8ButtonSampleMs = (U8)Util_GetTimerMs();
+    P_SW2 |= P_SW2_EAXFR;
+    P3PU |= BUTTON_MASK;
+    P_SW2 &= ~P_SW2_EAXFR;
+    BUTTON_PIN = 1;
+    P3M1 |= BUTTON_MASK;  // input only, with the 4.1k pull-up
+    P3M0 &= ~BUTTON_MASK;
+    gbitButtonWindow = 1;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Leaves the button to the weak pull-up of the quasi-bidirectional mode, for the INT0 wake-up
+//! \param  -
+//! \return -
+//! \global gbitButtonWindow
+//! \note   For the power-down and Util_Sleep(): the button is released then, the weak pull-up draws
+//!         no current until it's pressed. The next ButtonCycle() takes the pin back.
+//-----------------------------------------------------------------------------
+static void ButtonWakeMode( void )
+{
+  P_SW2 |= P_SW2_EAXFR;
+  P3PU &= ~BUTTON_MASK;
+  P_SW2 &= ~P_SW2_EAXFR;
+  BUTTON_PIN = 1;
+  P3M0 &= ~BUTTON_MASK;
+  P3M1 &= ~BUTTON_MASK;
+  gbitButtonWindow = 0;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Parks the pins for the power-down, as given by the BOARD_PARK_x defines of board.h
+//! \param  -
+//! \return -
+//! \global -
+//! \note   The latches are written before the modes, so a pin doesn't drive its old level meanwhile.
+//-----------------------------------------------------------------------------
+static void ParkPins( void )
+{
+  P1 = BOARD_PARK_P1;
+  P3 = BOARD_PARK_P3;
+  P5 = BOARD_PARK_P5;
+  P1M0 = BOARD_PARK_P1M0;
+  P1M1 = BOARD_PARK_P1M1;
+  P3M0 = BOARD_PARK_P3M0;
+  P3M1 = BOARD_PARK_P3M1;
+  P5M0 = BOARD_PARK_P5M0;
+  P5M1 = BOARD_PARK_P5M1;
+}
+
 
 /***************************************< Public functions >**************************************/
 //----------------------------------------------------------------------------
@@ -81,26 +172,38 @@ void main( void )
 {
   U32  u32UptimeCounter = 0u;
   U16  u16LastCall = 0u;
+#if UTIL_SLEEP
+  U16  u16IdleMs;
+#endif
   U8   u8CurrentAnimation = 0u;
   BOOL bPressedLong = FALSE;
+  BOOL bPowerOn;
+  BOOL bShowing;
 
+  // A power-on is told by the POF flag: the wake-up from power down is a software reset, as the
+  // watchdog and the other warm resets, and they don't set it
+  bPowerOn = ( 0u != ( PCON & 0x10u ) );  // POF bit
+  PCON &= ~0x10u;
+  
   // Initialize modules
   Util_Init();
   LED_Init();
+#if BOARD_RGBLED
   RGBLED_Init();
+#endif
   Animation_Init();
   Persist_Init();
   BatteryLevel_Init();
 
-  // Pushbutton @ P3.2 --> bidirectional with pullup
-  // NOTE: this might not the best in terms of power consumption, but the input mode with pullup was not enough
-  P3M0 &= ~(1u<<2u);  // 0
-  P3M1 &= ~(1u<<2u);  // 0
-  P3PU |= 1u<<2u;
+  // Pushbutton @ P3.2 --> bidirectional with the weak pullup until the main loop, then sampled by ButtonCycle()
+  // NOTE: P3PU is an extended SFR, it was never reached without EAXFR: the input mode had no pullup at all
+  ButtonWakeMode();
   
   // Init global variables in this module
   geButtonState = BUTTON_UNPRESSED;
   gu16ButtonPressTimer = 0u;
+  gu8ButtonSampleMs = 0u;
+  gbitButtonLevel = 1;
   u8CurrentAnimation = gsPersistentData.u8AnimationIndex;
   
   // Init timer and start interrupts
@@ -110,21 +213,39 @@ void main( void )
   ET0 = 1;  // Enable Timer0 interrupts
   EA  = 1;  // Global interrupt enable
 
-  // Wait if the button is pressed on power up
+#if SELFTEST_ENABLE
+  // Button held at a power-on: production self-test instead of the gauge
+  // The wake-up from power down is a software reset with the button pressed, so it is told by the POF flag
+  if( bPowerOn )
+  {
+    gu16ButtonPressTimer = Util_GetTimerMs();
+    while( (U16)( Util_GetTimerMs() - gu16ButtonPressTimer ) < 10u )  // the pull-up has just been enabled
+    {
+      PCON |= 0x01u;  // IDL bit: until the next tick
+    }
+    if( 0 == BUTTON_PIN )
+    {
+      SelfTest_Run();
+    }
+  }
+#endif
+
+  // A button pressed on power up is ignored until it gets released, as a long press is
   // This is necessary, to avoid changing animation on power on
-  while( 0 == BUTTON_PIN )
+  gbitButtonLevel = BUTTON_PIN;
+  if( 0 == gbitButtonLevel )
   {
-    gu16ButtonPressTimer = Util_GetTimerMs() + 100u;  // 1 ms wait
-    while( gu16ButtonPressTimer > Util_GetTimerMs() );
+    geButtonState = BUTTON_LONGPRESS;
   }
 
-  // Measure and show battery level
-  BatteryLevel_Show();
+  // Measure and show battery level, after a power-on only: a warm reset goes on with the animation at once
+  // The indicator runs in BatteryLevel_Cycle(), the button is served meanwhile
+  BatteryLevel_Show( bPowerOn );
     
   // Main loop
   while( TRUE )
   {
-    // Increment uptime counter
+    // Increment uptime counter; the time slept in Util_Sleep() is on the timer too
     if( Util_GetTimerMs() < u16LastCall )
     {
       u32UptimeCounter += (U32)( 65535u - u16LastCall + Util_GetTimerMs() + 1u );
@@ -137,30 +258,25 @@ void main( void )
     if( u32UptimeCounter >= 18000000u )  // turn off after 5 hours = 5*60*60*1000 msec
     {
       // Go to power-down sleep
+      Persist_Flush();
       EA = 0;   // Disable all interrupts
+      ButtonWakeMode();
       TR0 = 0;  // Stop Timer 0
       ET0 = 0;  // Disable Timer 0 interrupt
       EX0 = 1;  // Enable INT0 interrupt
-      P1 = 0xFFu;  // Set all pins to 1
-      P3 = 0xFFu;
-      P5 = 0x3Fu;
-      P1M0 = 0x00u;  // All pins must be bidirectional
-      P1M1 = 0x00u;
-      P3M0 = 0x00u;
-      P3M1 = 0x00u;
-      P5M0 = 0x00u;
-      P5M0 = 0x00u;
+      ParkPins();
       EA = 1;  // Enable all interrupts
       PCON |= 0x02u;  // PD bit
     }
     
     // Debounce button in a nonblocking way
+    ButtonCycle();
     switch( geButtonState )
     {
       case BUTTON_BOUNCING:   // The button just got pressed and it's currently bouncing
         if( Util_GetTimerMs() == gu16ButtonPressTimer )  // the debounce timer has just went off
         {
-          if( 0 == BUTTON_PIN )  // if the button is still pressed
+          if( 0 == gbitButtonLevel )  // if the button is still pressed
           {
             gu16ButtonPressTimer = Util_GetTimerMs() + 2000u;  // 2 sec long press
             geButtonState = BUTTON_PRESSED;
@@ -173,7 +289,7 @@ void main( void )
         break;
       
       case BUTTON_PRESSED:    // The button got debounced
-        if( 1 == BUTTON_PIN )  // just got released
+        if( 1 == gbitButtonLevel )  // just got released
         {
           gu16ButtonPressTimer = Util_GetTimerMs() + 50u;  // 50 ms debounce time
           geButtonState = BUTTON_RELEASING;
@@ -184,13 +300,14 @@ void main( void )
             u8CurrentAnimation = 0u;
           }
           Animation_Set( u8CurrentAnimation );
-          // Save it
-          Persist_Save();
+          // Save it, when the user has stopped clicking
+          Persist_SaveLater();
         }
         else if( Util_GetTimerMs() == gu16ButtonPressTimer )  // the long press timer has just went off
         {
           geButtonState = BUTTON_LONGPRESS;
           // Actions for long button press
+          Persist_Flush();  // the dark animation below must not be saved
           // Signal that it will be shut down by setting a completely black animation
           u8CurrentAnimation = NUM_ANIMATIONS-1u;
           Animation_Set( u8CurrentAnimation );
@@ -199,7 +316,7 @@ void main( void )
         break;
       
       case BUTTON_LONGPRESS:  // The button has been pressed for long
-        if( 1 == BUTTON_PIN )  // just got released
+        if( 1 == gbitButtonLevel )  // just got released
         {
           gu16ButtonPressTimer = Util_GetTimerMs() + 50u;  // 50 ms debounce time
           geButtonState = BUTTON_RELEASING;
@@ -209,7 +326,7 @@ void main( void )
       case BUTTON_RELEASING:  // The button just got released and it's currently bouncing
         if( Util_GetTimerMs() == gu16ButtonPressTimer )  // the debounce timer has just went off
         {
-          if( 1 == BUTTON_PIN )  // if the button is released
+          if( 1 == gbitButtonLevel )  // if the button is released
           {
             gu16ButtonPressTimer = Util_GetTimerMs() + 2000u;  // 2 sec long press
             geButtonState = BUTTON_UNPRESSED;
@@ -218,18 +335,11 @@ void main( void )
             {
               // Go to power-down sleep
               EA = 0;   // Disable all interrupts
+              ButtonWakeMode();
               TR0 = 0;  // Stop Timer 0
               ET0 = 0;  // Disable Timer 0 interrupt
               EX0 = 1;  // Enable INT0 interrupt
-              P1 = 0xFFu;  // Set all pins to 1
-              P3 = 0xFFu;
-              P5 = 0x3Fu;
-              P1M0 = 0x00u;  // All pins must be bidirectional
-              P1M1 = 0x00u;
-              P3M0 = 0x00u;
-              P3M1 = 0x00u;
-              P5M0 = 0x00u;
-              P5M0 = 0x00u;
+              ParkPins();
               EA = 1;  // Enable all interrupts
               PCON |= 0x02u;  // PD bit
               bPressedLong = FALSE;  // This should not be reached...
@@ -243,16 +353,37 @@ void main( void )
         break;
       
       default:  // BUTTON_UNPRESSED -- The button is not pressed
-        if( 0 == BUTTON_PIN )  // if the button has just got pressed
+        if( 0 == gbitButtonLevel )  // if the button has just got pressed
         {
           gu16ButtonPressTimer = Util_GetTimerMs() + 50u;  // 50 ms debounce time
           geButtonState = BUTTON_BOUNCING;
         }
         break;
     }
-    Animation_Cycle();
+    Persist_Cycle();
+    bShowing = BatteryLevel_Cycle();
+    if( !bShowing )  // the animation waits for the battery indicator
+    {
+      Animation_Cycle();
+    }
+    LED_DitherCycle();
     // Sleep until next interrupt
     PCON |= 0x01u;  // IDL bit
+#if UTIL_SLEEP
+    // Dark until the next instruction, and the pins are dark since the last tick: power down,
+    // a press of the button wakes up earlier
+    u16IdleMs = Animation_GetIdleMs();
+    if( !bShowing && ( BUTTON_UNPRESSED == geButtonState ) && ( 1 == gbitButtonLevel ) && ( u16IdleMs >= SLEEP_MIN_MS ) )
+    {
+      gbitSleeping = 1;
+      ButtonWakeMode();
+      IE0 = 0;  // no stale edge
+      EX0 = 1;  // Enable INT0 interrupt
+      Util_Sleep( u16IdleMs );
+      EX0 = 0;
+      gbitSleeping = 0;
+    }
+#endif
   }
 }
 
@@ -265,10 +396,19 @@ void main( void )
 #pragma vector=0x0003
 IT_PRE void INT0_ISR( void ) ITVECTOR0
 {
-  // Normally, only after waking up from power down mode should lead to here
-  // Perform software reset
-  IAP_CONTR |= 0x20u;
-  while( 1 );  // This should not be reached
+#if UTIL_SLEEP
+  if( gbitSleeping )
+  {
+    EX0 = 0;  // the main loop takes the press
+  }
+  else
+#endif
+  {
+    // Normally, only after waking up from power down mode should lead to here
+    // Perform software reset
+    IAP_CONTR |= 0x20u;
+    while( 1 );  // This should not be reached
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -282,7 +422,12 @@ IT_PRE void timer0_isr( void ) ITVECTOR1
 {
   Util_Interrupt();  // Housekeeping, e.g. ms delay timer
   LED_Interrupt();  // Soft-PWM LED driver
+#if BOARD_RGBLED
   RGBLED_Interrupt();  // RGB LED driver
+#endif
+#if BATTERY_BACKGROUND
+  BatteryLevel_Interrupt();  // Supply sampled at the load just set
+#endif
   // End of interrupt
   TF0 = 0;  // clear Timer0 IT flag
 }
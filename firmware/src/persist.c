@@ -10,34 +10,59 @@
 **********************************************************************************************************/
 
 /***************************************< Includes >**************************************/
-// Standard C libraries
-#include <string.h>
-
 // Own includes
 #include "types.h"
 #include "util.h"
+#include "led.h"
 #include "persist.h"
 
 
 /***************************************< Definitions >**************************************/
 #define EEPROM_SIZE           (4096u)  //!< Number of bytes present as EEPROM memory
-#define EEPROM_BASEADDRESS  (0x2000u)  //!< Base address of EEPROM in STC8G1K08
+#define EEPROM_PAGE_SIZE       (512u)  //!< Size of an erasable page
+#define SAVE_DELAY_MS         (5000u)  //!< A deferred save is written after this long without changes
+#define EEPROM_MOVC_BASE    (0x2000u)  //!< Code address of the EEPROM: right after the 8 kB program space of the STC8G1K08
+#define EEPROM_PAGES          ( PERSIST_JOURNAL_PAGES )  //!< Number of pages used by the journal
+#define JOURNAL_BASE          ( EEPROM_SIZE - EEPROM_PAGES * EEPROM_PAGE_SIZE )  //!< EEPROM address of the journal, the animation tables may be below
+//! \brief EEPROM address of a journal page
+#define PAGE_ADDRESS(page)    ( JOURNAL_BASE + (U16)(page) * EEPROM_PAGE_SIZE )
+//! \brief Number of save slots in a page, after the page header
+#define SLOTS_PER_PAGE        ( ( EEPROM_PAGE_SIZE - sizeof( S_PERSIST_PAGE_HEADER ) ) / sizeof( S_PERSIST ) )
+//! \brief EEPROM address of a save slot
+#define SLOT_ADDRESS(page,slot)  ( PAGE_ADDRESS( page ) + sizeof( S_PERSIST_PAGE_HEADER ) + (U16)(slot) * sizeof( S_PERSIST ) )
 
 
 /***************************************< Types >**************************************/
+//! \brief Header at the start of each journal page
+//! \note  The sequence number is increased by one for each new page. Only the last few pages
+//!        are alive, so they are compared by signed difference, and the wrap-around is harmless.
+typedef PACKED struct
+{
+  U16 u16Sequence;                  //!< Sequence number of the page
+  U16 u16SequenceInv;               //!< Bitwise inverse of the sequence number, to detect erased or torn headers
+} S_PERSIST_PAGE_HEADER;
 
 
 /***************************************< Constants >**************************************/
 
 
 /***************************************< Global variables >**************************************/
-DATA S_PERSIST       gsPersistentData;  //!< Globally accessible persistent data structure
-IDATA S_PERSIST CODE* gpsNextSaveSlot;  //!< Address of the next persistent save slot
+MAIN_DATA S_PERSIST gsPersistentData;  //!< Globally accessible persistent data structure
+static MAIN_DATA U8  gu8ActivePage;    //!< Page of the journal being written
+static MAIN_DATA U8  gu8NextSlot;      //!< The next empty save slot in the active page
+static MAIN_DATA U16 gu16Sequence;     //!< Sequence number of the active page
+static BIT gbitDirty;           //!< Set if there are unsaved changes
+static BIT gbitNextErased;      //!< Set if the next page in the ring has been erased in advance
+static MAIN_DATA U16 gu16DirtyTime;  //!< Time of the last unsaved change
 
 
 /***************************************< Static function definitions >**************************************/
-static BOOL IsSaveBlockEmpty( S_PERSIST* psLocalCopy, S_PERSIST CODE* psSaveBlock );
-static BOOL SearchForLatestSave( S_PERSIST CODE** ppsNextEmpty );
+static BOOL ReadPageHeader( U8 u8Page, U16* pu16Sequence );
+static BOOL IsSlotEmpty( U16 u16Address );
+static BOOL IsPageBlank( U8 u8Page );
+static U8   CountSlots( U8 u8Page );
+static BOOL LoadLatestSave( U8 u8Page, U8 u8Slots );
+static BOOL SearchForLatestSave( void );
 static void IAP_Write( U16 u16Address, U8* pu8Data, U8 u8DataLength );
 static void IAP_Erase( U16 u16Address );
 static void IAP_Read( U16 u16Address, U8* pu8Data, U8 u8DataLength );
@@ -45,21 +70,38 @@ static void IAP_Read( U16 u16Address, U8* pu8Data, U8 u8DataLength );
 
 /***************************************< Private functions >**************************************/
 //----------------------------------------------------------------------------
-//! \brief  Check if given block is empty in the EEPROM
-//! \param  psTemp: pointer to a temporary storage
-//! \param  psSaveBlock: pointer to the block in EEPROM
-//! \return TRUE if the block is empty; FALSE if not
+//! \brief  Reads the header of a journal page
+//! \param  u8Page: index of the page
+//! \param  pu16Sequence: the sequence number of the page is written here
+//! \return TRUE if the page has a valid header; FALSE if it is erased or the header is corrupt
 //! \global -
 //-----------------------------------------------------------------------------
-static BOOL IsSaveBlockEmpty( S_PERSIST* psTemp, S_PERSIST CODE* psSaveBlock )
+static BOOL ReadPageHeader( U8 u8Page, U16* pu16Sequence )
+{
+  S_PERSIST_PAGE_HEADER sHeader;
+  
+  IAP_Read( PAGE_ADDRESS( u8Page ), (U8*)&sHeader, sizeof( S_PERSIST_PAGE_HEADER ) );
+  *pu16Sequence = sHeader.u16Sequence;
+  
+  return ( (U16)~sHeader.u16SequenceInv == sHeader.u16Sequence );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Check if given save slot is empty in the EEPROM
+//! \param  u16Address: address of the slot
+//! \return TRUE if the slot is empty; FALSE if not
+//! \global -
+//-----------------------------------------------------------------------------
+static BOOL IsSlotEmpty( U16 u16Address )
 {
   BOOL bEmpty = TRUE;
-  U8  u8ByteIndex;
+  U8   u8ByteIndex;
+  S_PERSIST sLocalCopy;
 
-  IAP_Read( (U16)psSaveBlock, (U8*)psTemp, sizeof( S_PERSIST ) );
-  for( u8ByteIndex = 0u; u8ByteIndex < sizeof( S_PERSIST ); u8ByteIndex++ )
+  IAP_Read( u16Address, (U8*)&sLocalCopy, sizeof( S_PERSIST ) );
+  for( u8ByteIndex = 0u; ( TRUE == bEmpty ) && ( u8ByteIndex < sizeof( S_PERSIST ) ); u8ByteIndex++ )
   {
-    if( 0xFFu != ((U8*)psTemp)[ u8ByteIndex ] )
+    if( 0xFFu != ((U8*)&sLocalCopy)[ u8ByteIndex ] )
     {
       bEmpty = FALSE;
     }
@@ -68,44 +110,139 @@ static BOOL IsSaveBlockEmpty( S_PERSIST* psTemp, S_PERSIST CODE* psSaveBlock )
 }
 
 //----------------------------------------------------------------------------
-//! \brief  Search for the latest save in EEPROM
-//! \param  ppsNextEmpty: address of the next empty block for writing
+//! \brief  Check if a journal page is erased, as on a fresh part
+//! \param  u8Page: index of the page
+//! \return TRUE if its header and all of its slots are empty; FALSE if not
+//! \global -
+//! \note   Stops at the first byte written. The bytes after the last slot are never written.
+//-----------------------------------------------------------------------------
+static BOOL IsPageBlank( U8 u8Page )
+{
+  BOOL bBlank;
+  U8   u8Slot = 0u;
+  S_PERSIST_PAGE_HEADER sHeader;
+  
+  IAP_Read( PAGE_ADDRESS( u8Page ), (U8*)&sHeader, sizeof( S_PERSIST_PAGE_HEADER ) );
+  bBlank = ( 0xFFFFu == sHeader.u16Sequence ) && ( 0xFFFFu == sHeader.u16SequenceInv );
+  while( ( TRUE == bBlank ) && ( u8Slot < SLOTS_PER_PAGE ) )
+  {
+    bBlank = IsSlotEmpty( SLOT_ADDRESS( u8Page, u8Slot ) );
+    u8Slot++;
+  }
+  
+  return bBlank;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Counts the used save slots of a page by binary search
+//! \param  u8Page: index of the page
+//! \return Number of used slots; they are always at the start of the page
+//! \global -
+//! \note   A slot torn by a power loss counts as used, so the search stays monotonic.
+//-----------------------------------------------------------------------------
+static U8 CountSlots( U8 u8Page )
+{
+  U8 u8Low = 0u;               // slots below are used
+  U8 u8High = SLOTS_PER_PAGE;  // slots from here are empty
+  U8 u8Middle;
+  
+  while( u8Low < u8High )
+  {
+    u8Middle = (U8)( ( (U16)u8Low + u8High ) >> 1u );
+    if( IsSlotEmpty( SLOT_ADDRESS( u8Page, u8Middle ) ) )
+    {
+      u8High = u8Middle;
+    }
+    else
+    {
+      u8Low = u8Middle + 1u;
+    }
+  }
+  
+  return u8Low;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Loads the latest save of a page with correct CRC
+//! \param  u8Page: index of the page
+//! \param  u8Slots: number of used slots in the page
 //! \return TRUE, if it found a correct save; FALSE if not
 //! \global gsPersistentData
-//! \note   Takes some time, should only be called in init block.
+//! \note   Normally the last slot is correct, older ones are only read after a torn write.
 //-----------------------------------------------------------------------------
-static BOOL SearchForLatestSave( S_PERSIST CODE** ppsNextEmpty )
+static BOOL LoadLatestSave( U8 u8Page, U8 u8Slots )
 {
-  BOOL bEmpty;
-  U16 u16SaveIndex;
   BOOL bReturn = FALSE;
-  S_PERSIST CODE* psSave = (S_PERSIST CODE*)EEPROM_BASEADDRESS;
-  S_PERSIST  sLocalCopy;
+  S_PERSIST sLocalCopy;
   
-  for( u16SaveIndex = 0u; u16SaveIndex < ( EEPROM_SIZE / sizeof( S_PERSIST ) ); u16SaveIndex++ )
+  while( ( FALSE == bReturn ) && ( u8Slots > 0u ) )
   {
-    IAP_Read( (U16)psSave, (U8*)&sLocalCopy, sizeof( S_PERSIST ) );
+    u8Slots--;
+    IAP_Read( SLOT_ADDRESS( u8Page, u8Slots ), (U8*)&sLocalCopy, sizeof( S_PERSIST ) );
     if( sLocalCopy.u16CRC == Util_CRC16( (U8*)&sLocalCopy, sizeof( S_PERSIST ) - sizeof( U16 ) ) )
     {
-      memcpy( &gsPersistentData, &sLocalCopy, sizeof( S_PERSIST ) );
+      Util_Copy( (U8 IDATA*)&gsPersistentData, (const U8 IDATA*)&sLocalCopy, sizeof( S_PERSIST ) );
       bReturn = TRUE;
     }
-    else  // bad CRC
+  }
+  
+  return bReturn;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Search for the latest save in EEPROM
+//! \param  -
+//! \return TRUE, if it found a correct save; FALSE if not
+//! \global gsPersistentData, gu8ActivePage, gu8NextSlot, gu16Sequence
+//! \note   Reads only the page headers, then binary searches the newest page. If that has no
+//!         correct save (power loss right after starting it), the previous page is used.
+//-----------------------------------------------------------------------------
+static BOOL SearchForLatestSave( void )
+{
+  BOOL bFound = FALSE;
+  BOOL bReturn = FALSE;
+  U8   u8Page;
+  U8   u8PreviousPage = 0u;
+  U16  u16Sequence;
+  
+  // Find the newest page by the sequence numbers
+  for( u8Page = 0u; u8Page < EEPROM_PAGES; u8Page++ )
+  {
+    if( ReadPageHeader( u8Page, &u16Sequence ) )
     {
-      // Check if this block is empty
-      bEmpty = IsSaveBlockEmpty( &sLocalCopy, psSave );
-      if( ( TRUE == bReturn ) && ( TRUE == bEmpty ) )
+      if( ( FALSE == bFound ) || ( (I16)( u16Sequence - gu16Sequence ) > 0 ) )
       {
-        *ppsNextEmpty = psSave;
-        break;
+        gu8ActivePage = u8Page;
+        gu16Sequence = u16Sequence;
+        bFound = TRUE;
       }
     }
-    psSave++;
   }
-#warning "What happens if it rolls over?"
+  
+  if( TRUE == bFound )
+  {
+    gu8NextSlot = CountSlots( gu8ActivePage );
+    bReturn = LoadLatestSave( gu8ActivePage, gu8NextSlot );
+    if( FALSE == bReturn )
+    {
+      // Pages are written in ring order, so the previous one is right before it
+      u8PreviousPage = ( gu8ActivePage + EEPROM_PAGES - 1u ) % EEPROM_PAGES;
+      if( ReadPageHeader( u8PreviousPage, &u16Sequence ) && ( (U16)( gu16Sequence - 1u ) == u16Sequence ) )
+      {
+        bReturn = LoadLatestSave( u8PreviousPage, CountSlots( u8PreviousPage ) );
+      }
+    }
+  }
+  else  // blank EEPROM: the first save starts page 0 with sequence 0
+  {
+    gu8ActivePage = EEPROM_PAGES - 1u;
+    gu8NextSlot = SLOTS_PER_PAGE;
+    gu16Sequence = 0xFFFFu;
+  }
   
   return bReturn;
 }
+
 //----------------------------------------------------------------------------
 //! \brief  Write data block to EEPROM from a given address
 //! \param  u16Address: Start address to be written. Only lower 12 bits are used.
@@ -113,13 +250,12 @@ static BOOL SearchForLatestSave( S_PERSIST CODE** ppsNextEmpty )
 //! \param  u8DataLength: write length
 //! \return -
 //! \global -
-//! \note   Stalls the CPU.
+//! \note   Stalls the CPU for each byte, 6 to 7.5 us on the STC8G. The interrupts are let in
+//!         between the bytes, so the soft-PWM only takes a tick late, it doesn't freeze.
 //-----------------------------------------------------------------------------
 static void IAP_Write( U16 u16Address, U8* pu8Data, U8 u8DataLength )
 {
   U8 u8Index;
-
-  DISABLE_IT;
   
   IAP_CONTR = 0x80u;  // EEPROM is enabled
   IAP_TPS = SYSTEM_CLOCK_MHZ;
@@ -130,17 +266,17 @@ static void IAP_Write( U16 u16Address, U8* pu8Data, U8 u8DataLength )
     IAP_ADDRH = (u16Address>>8u) & 0x0Fu;  // only lower 12 bits are used
     IAP_DATA = pu8Data[ u8Index ];
     // Initiate command by magic code sequence
+    DISABLE_IT;
     IAP_TRIG = 0x5Au;
     IAP_TRIG = 0xA5u;
     NOP();
     NOP();
+    ENABLE_IT;
     u16Address++;
   }
   IAP_CONTR = 0x00u;  // Clear flags, EEPROM is disabled
   IAP_CMD   = 0u;
   IAP_TRIG  = 0u;
-
-  ENABLE_IT;
 }
 
 //----------------------------------------------------------------------------
@@ -148,11 +284,13 @@ static void IAP_Write( U16 u16Address, U8* pu8Data, U8 u8DataLength )
 //! \param  u16Address: Address of page, the lower 9 bits are discarded
 //! \return -
 //! \global -
-//! \note   Stalls the CPU.
+//! \note   Stalls the CPU for 4 to 6 ms, the soft-PWM with it. Should be called at LED_IsPeriodEnd():
+//!         the LEDs are blanked, so the stall only stretches the dark end of a period, see LED_Blank().
 //-----------------------------------------------------------------------------
 static void IAP_Erase( U16 u16Address )
 {
   DISABLE_IT;
+  LED_Blank();
   
   IAP_CONTR = 0x80u;  // EEPROM is enabled
   IAP_TPS = SYSTEM_CLOCK_MHZ;
@@ -179,11 +317,20 @@ static void IAP_Erase( U16 u16Address )
 //! \param  u8DataLength: read length
 //! \return -
 //! \global -
-//! \note   Stalls the CPU.
+//! \note   With PERSIST_MOVC_READ the bytes are read by MOVC from the code space, where the EEPROM
+//!         is mapped: no IAP command, no interrupt lock. Else it stalls the CPU for each byte.
 //-----------------------------------------------------------------------------
 static void IAP_Read( U16 u16Address, U8* pu8Data, U8 u8DataLength )
 {
   U8 u8Index;
+#if PERSIST_MOVC_READ
+  const U8 CODE* pcu8Source = (const U8 CODE*)( EEPROM_MOVC_BASE + ( u16Address & ( EEPROM_SIZE - 1u ) ) );
+  
+  for( u8Index = 0u; u8Index < u8DataLength; u8Index++ )
+  {
+    pu8Data[ u8Index ] = pcu8Source[ u8Index ];
+  }
+#else
 
   DISABLE_IT;
   
@@ -208,6 +355,7 @@ static void IAP_Read( U16 u16Address, U8* pu8Data, U8 u8DataLength )
   IAP_TRIG  = 0u;
 
   ENABLE_IT;
+#endif
 }
 
 
@@ -227,51 +375,118 @@ void Persist_Init( void )
   IAP_CMD = 0x01u;  // Read operation
 
   // Find latest save and load it
-  if( TRUE == SearchForLatestSave( &gpsNextSaveSlot ) )
+  if( TRUE == SearchForLatestSave() )
   {
     // persistent data are loaded to memory
   }
   else  // Default values
   {
-    memset( &gsPersistentData, 0, sizeof( S_PERSIST ) );
-    gpsNextSaveSlot = (S_PERSIST CODE*)EEPROM_BASEADDRESS;
+    Util_Fill( (U8 IDATA*)&gsPersistentData, 0u, sizeof( S_PERSIST ) );
   }
+  // A blank next page needs no erase, Persist_Cycle() erases it once otherwise; on a fresh part it
+  // is page 0. A page without a valid header may be a torn one, so only a blank one is trusted.
+  gbitNextErased = IsPageBlank( ( gu8ActivePage + 1u ) % EEPROM_PAGES );
+  gbitDirty = FALSE;
 }
 
 //----------------------------------------------------------------------------
 //! \brief  Saves the current persistent data structure
 //! \param  -
 //! \return -
-//! \global -
-//! \note   Disables interrupt for a short time. Stalls the CPU during writing.
+//! \global gu8ActivePage, gu8NextSlot, gu16Sequence, gbitNextErased
+//! \note   Disables interrupt for a short time. Stalls the CPU during writing, byte by byte.
+//!         When the active page is full, the next page in the ring is started with the next
+//!         sequence number; the old page keeps the previous save until then. The next page is
+//!         normally erased by Persist_Cycle() already, else it is erased here, at the end of a
+//!         PWM period: it waits up to a period for it while Timer0 runs.
 //-----------------------------------------------------------------------------
 void Persist_Save( void )
 {
   S_PERSIST sLocalCopy;
-  U16       u16PrevSaveAddress = (U16)gpsNextSaveSlot;
+  S_PERSIST_PAGE_HEADER sHeader;
   
-  // Assuming that the gpsNextSaveSlot pointer is correct...
   DISABLE_IT;
-  memcpy( &sLocalCopy, &gsPersistentData, sizeof( S_PERSIST ) );
+  Util_Copy( (U8 IDATA*)&sLocalCopy, (const U8 IDATA*)&gsPersistentData, sizeof( S_PERSIST ) );
   ENABLE_IT;
   // Calculate CRC
   sLocalCopy.u16CRC = Util_CRC16( (U8*)&sLocalCopy, sizeof( S_PERSIST ) - sizeof( U16 ) );
-  // Write EEPROM
-  IAP_Write( (U16)gpsNextSaveSlot, (U8*)&sLocalCopy, sizeof( S_PERSIST ) );
-  // Check if next block is empty; if not, erase
-  gpsNextSaveSlot++;
-  if( FALSE == IsSaveBlockEmpty( &sLocalCopy, gpsNextSaveSlot ) )
+  // Start a new page if needed
+  if( gu8NextSlot >= SLOTS_PER_PAGE )
   {
-    // If the page boundary is inside the save slot
-    if( ((U16)gpsNextSaveSlot & 0xFE00u) < u16PrevSaveAddress )
+    gu8ActivePage = ( gu8ActivePage + 1u ) % EEPROM_PAGES;
+    gu16Sequence++;
+    gu8NextSlot = 0u;
+    sHeader.u16Sequence = gu16Sequence;
+    sHeader.u16SequenceInv = ~gu16Sequence;
+    if( FALSE == gbitNextErased )
     {
-      IAP_Erase( ((U16)gpsNextSaveSlot) + sizeof( S_PERSIST ) );
+      while( TR0 && !LED_IsPeriodEnd() )
+      {
+        // the erase is blanked at the end of a period
+      }
+      IAP_Erase( PAGE_ADDRESS( gu8ActivePage ) );
     }
-    else
+    gbitNextErased = FALSE;
+    IAP_Write( PAGE_ADDRESS( gu8ActivePage ), (U8*)&sHeader, sizeof( S_PERSIST_PAGE_HEADER ) );
+  }
+  // Write EEPROM
+  IAP_Write( SLOT_ADDRESS( gu8ActivePage, gu8NextSlot ), (U8*)&sLocalCopy, sizeof( S_PERSIST ) );
+  gu8NextSlot++;
+  gbitDirty = FALSE;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Marks the persistent data structure as changed, to be saved later
+//! \param  -
+//! \return -
+//! \global gbitDirty
+//! \note   Each call restarts the delay, so quick successive changes are written only once.
+//-----------------------------------------------------------------------------
+void Persist_SaveLater( void )
+{
+  gbitDirty = TRUE;
+  gu16DirtyTime = Util_GetTimerMs();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Writes the deferred save when the delay has elapsed, erases the next page when idle
+//! \param  -
+//! \return -
+//! \global gbitDirty, gbitNextErased
+//! \note   Should be called from main cycle. The next page in the ring is the oldest one, no save
+//!         is read from it, so a power loss during its erase loses nothing. It is erased only
+//!         while nothing is waiting to be saved, so the save before power-down never waits for it,
+//!         and only in the last tick of a PWM period, where its stall is blanked.
+//-----------------------------------------------------------------------------
+void Persist_Cycle( void )
+{
+  if( TRUE == gbitDirty )
+  {
+    if( (U16)( Util_GetTimerMs() - gu16DirtyTime ) >= SAVE_DELAY_MS )
     {
-      IAP_Erase( (U16)gpsNextSaveSlot );
+      Persist_Flush();
     }
   }
+  else if( ( FALSE == gbitNextErased ) && LED_IsPeriodEnd() )
+  {
+    IAP_Erase( PAGE_ADDRESS( ( gu8ActivePage + 1u ) % EEPROM_PAGES ) );
+    gbitNextErased = TRUE;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Writes the deferred save right now, if there is one
+//! \param  -
+//! \return -
+//! \global gbitDirty
+//! \note   Should be called before power-down, or before the saved data get changed temporarily.
+//-----------------------------------------------------------------------------
+void Persist_Flush( void )
+{
+  if( TRUE == gbitDirty )
+  {
+    Persist_Save();
+  }
 }
 
 #warning "Test this module!"
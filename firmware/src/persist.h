@@ -16,6 +16,17 @@
 
 
 /***************************************< Definitions >**************************************/
+#ifndef PERSIST_MOVC_READ
+#define PERSIST_MOVC_READ  (1u)  //!< 1: the EEPROM is read through its mapping in the code space; 0: by IAP read commands
+#endif
+#ifndef PERSIST_ANIMATIONS_IN_EEPROM
+#define PERSIST_ANIMATIONS_IN_EEPROM (0u)  //!< 1: the animation tables are in the EEPROM, below the journal; 0: the whole EEPROM is the journal
+#endif
+#if PERSIST_ANIMATIONS_IN_EEPROM
+#define PERSIST_JOURNAL_PAGES (2u)  //!< EEPROM pages of the journal, at its top; two, so the page erased is never the one with the last save
+#else
+#define PERSIST_JOURNAL_PAGES (8u)  //!< EEPROM pages of the journal: all of them
+#endif
 
 
 /***************************************< Types >**************************************/
@@ -31,12 +42,15 @@ typedef PACKED struct
 
 
 /***************************************< Global variables >**************************************/
-extern DATA S_PERSIST gsPersistentData;
+extern MAIN_DATA S_PERSIST gsPersistentData;
 
 
 /***************************************< Public functions >**************************************/
 void Persist_Init( void );
 void Persist_Save( void );
+void Persist_SaveLater( void );
+void Persist_Cycle( void );
+void Persist_Flush( void );
 
 
 #endif /* PERSIST_H */
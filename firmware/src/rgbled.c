@@ -11,18 +11,23 @@
 
 /***************************************< Includes >**************************************/
 #include "stc8g.h"
-#include <string.h>
 
 // Own includes
 #include "types.h"
+#include "board.h"
+#include "util.h"
+#include "led.h"
 #include "rgbled.h"
 
+#if BOARD_RGBLED  // nothing to drive otherwise
+
 
 /***************************************< Definitions >**************************************/
 #define COLOR_LEVELS   (16u)  //!< Number of brightness levels per color
 #define PIN_R          (P54)  //!< GPIO pin for red LED
 #define PIN_G          (P55)  //!< GPIO pin for green LED
 #define PIN_B          (P16)  //!< GPIO pin for blue LED
+#define PULSE_LENGTH   ( 3u * SYSTEM_CLOCK_MHZ )  //!< Length of a current pulse in PCA clocks -- 3 us
 
 
 /***************************************< Types >**************************************/
@@ -34,62 +39,46 @@
 /***************************************< Global variables >**************************************/
 //! \brief Global array for RGB LED color values
 //! \note  Value set is between [0; COLOR_LEVELS)
-volatile U8 gau8RGBLEDs[ NUM_RGBLED_COLORS ];
+ISR_DATA volatile U8 gau8RGBLEDs[ NUM_RGBLED_COLORS ];
+static ISR_DATA volatile U8 gu8PulseQueue;  //!< Colors still to be pulsed in the current tick; bit 0: red
 
 
 /***************************************< Static function definitions >**************************************/
-static void RedPulseDelay( void );
-static void GreenPulseDelay( void );
-static void BluePulseDelay( void );
+static void StartPulse( void );
 
 
 /***************************************< Private functions >**************************************/
 //----------------------------------------------------------------------------
-//! \brief  Delay for generating current pulse for red LED
-//! \param  -
-//! \return -
-//! \global -
-//! \note   Assumes 24 MHz clock!
-//-----------------------------------------------------------------------------
-static void RedPulseDelay( void )
-{
-  // Wait for 3 usec
-	unsigned char i;
-
-	i = 22;
-	while (--i);
-}
-
-//----------------------------------------------------------------------------
-//! \brief  Delay for generating current pulse for green LED
-//! \param  -
-//! \return -
-//! \global -
-//! \note   Assumes 24 MHz clock!
-//-----------------------------------------------------------------------------
-static void GreenPulseDelay( void )
-{
-  // Wait for 1 usec
-	unsigned char i;
-
-	i = 22;
-	while (--i);
-}
-
-//----------------------------------------------------------------------------
-//! \brief  Delay for generating current pulse for blue LED
+//! \brief  Starts the current pulse of the next queued color, and arms the PCA to end it
 //! \param  -
 //! \return -
-//! \global -
-//! \note   Assumes 24 MHz clock!
+//! \global gu8PulseQueue
+//! \note   Runs in interrupt context. Colors are pulsed one after the other, just like before.
 //-----------------------------------------------------------------------------
-static void BluePulseDelay( void )
+static void StartPulse( void )
 {
-  // Wait for 1 usec
-	unsigned char i;
-
-	i = 22;
-	while (--i);
+  if( gu8PulseQueue & 0x01u )  // Red
+  {
+    gu8PulseQueue &= ~0x01u;
+    PIN_R = 0;
+  }
+  else if( gu8PulseQueue & 0x02u )  // Green
+  {
+    gu8PulseQueue &= ~0x02u;
+    PIN_G = 0;
+  }
+  else  // Blue
+  {
+    gu8PulseQueue &= ~0x04u;
+    PIN_B = 0;
+  }
+  // Restart PCA counter, module 0 matches after the pulse length
+  CR = 0;
+  CL = 0u;
+  CH = 0u;
+  CCAP0L = (U8)PULSE_LENGTH;  // NOTE: writing CCAP0L clears ECOM0, writing CCAP0H sets it again
+  CCAP0H = 0u;
+  CR = 1;
 }
 
 
@@ -102,7 +91,8 @@ static void BluePulseDelay( void )
 //-----------------------------------------------------------------------------
 void RGBLED_Init( void )
 {
-  memset( gau8RGBLEDs, 0, NUM_RGBLED_COLORS );
+  Util_Fill( (U8 IDATA*)gau8RGBLEDs, 0u, NUM_RGBLED_COLORS );
+  gu8PulseQueue = 0u;
   
   // Initialize GPIO pins
 	// NOTE: Pin modes are set by PxM0 and PxM1 registers
@@ -122,43 +112,104 @@ void RGBLED_Init( void )
   PIN_B = 1;
   P5M0 |=  (1u<<4u) |  (1u<<5u);  // push-pull
   P5M1 &= ~(1u<<4u) & ~(1u<<5u);
+  
+  // Initialize PCA module 0 as a software timer to end the pulses
+  CCON = 0x00u;    // stop PCA, clear flags
+  CMOD = 0x08u;    // PCA clock is SYSCLK, no overflow interrupt
+  CL = 0u;
+  CH = 0u;
+  CCAPM0 = 0x49u;  // ECOM0 | MAT0 | ECCF0: compare match with interrupt, no pin output
+  PPCA = 1;        // higher priority than Timer0, so the pulse is not stretched by the other ISRs
 }
 
 //----------------------------------------------------------------------------
 //! \brief  Interrupt routine for pulse-controlled RGB LED driver
 //! \param  -
 //! \return -
-//! \global gau8RGBLEDs
-//! \note   Should be called from periodic timer interrupt routine.
+//! \global gau8RGBLEDs, gu8PulseQueue, gau8LEDLoadOrder[], gu8PWMCounter
+//! \note   Should be called from periodic timer interrupt routine, after LED_Interrupt().
+//!         Only starts the pulses; they are ended by the PCA interrupt, so the CPU does not wait here.
+//!         With LED_RGB_SCHEDULE the threshold of the tick is its rank by the LEDs lit in it, so
+//!         the pulses take the least loaded ticks of the soft-PWM period.
 //-----------------------------------------------------------------------------
 void RGBLED_Interrupt( void )
 {
-  static volatile u8Cnt = 0u;
+#if LED_RGB_SCHEDULE
+  U8 u8Cnt = gau8LEDLoadOrder[ gu8PWMCounter ];
+#else
+  static ISR_DATA volatile U8 u8Cnt = 0u;
+#endif
+  U8 u8Queue = 0u;
   
   if( gau8RGBLEDs[ 0 ] > u8Cnt )  // Red
   {
-    PIN_R = 0;
-    RedPulseDelay();
-    PIN_R = 1;
+    u8Queue |= 0x01u;
   }
   if( gau8RGBLEDs[ 1 ] > u8Cnt )  // Green
   {
-    PIN_G = 0;
-    GreenPulseDelay();
-    PIN_G = 1;
+    u8Queue |= 0x02u;
   }
   if( gau8RGBLEDs[ 2 ] > u8Cnt )  // Blue
   {
-    PIN_B = 0;
-    BluePulseDelay();
-    PIN_B = 1;
+    u8Queue |= 0x04u;
+  }
+  if( ( 0u != u8Queue ) && ( 0u == gu8PulseQueue ) && ( 0 == CR ) )  // previous pulses are surely finished
+  {
+    gu8PulseQueue = u8Queue;
+    StartPulse();
   }
+#if !LED_RGB_SCHEDULE
   u8Cnt++;
   if( COLOR_LEVELS <= u8Cnt )
   {
     u8Cnt = 0u;
   }
+#endif
 }
 
+//----------------------------------------------------------------------------
+//! \brief  Ends the running pulse and drops the queued ones
+//! \param  -
+//! \return -
+//! \global gu8PulseQueue
+//! \note   Should be called with the interrupts disabled, see LED_Blank(); the next tick pulses as usual.
+//-----------------------------------------------------------------------------
+void RGBLED_Blank( void )
+{
+  CR = 0;
+  CCF0 = 0;
+  gu8PulseQueue = 0u;
+  PIN_R = 1;
+  PIN_G = 1;
+  PIN_B = 1;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  PCA interrupt handler: ends the running current pulse
+//! \param  -
+//! \return -
+//! \global gu8PulseQueue
+//! \note   Should be placed at 0x003B (==IT vector 7).
+//-----------------------------------------------------------------------------
+#pragma vector=0x003B
+IT_PRE void pca_isr( void ) ITVECTOR7
+{
+  // End of pulse
+  PIN_R = 1;
+  PIN_G = 1;
+  PIN_B = 1;
+  CCF0 = 0;  // clear PCA module 0 IT flag
+  if( 0u != gu8PulseQueue )
+  {
+    StartPulse();
+  }
+  else
+  {
+    CR = 0;  // stop PCA until the next tick
+  }
+}
+
+
+#endif /* BOARD_RGBLED */
 
 /***************************************< End of file >**************************************/
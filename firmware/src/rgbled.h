@@ -26,12 +26,13 @@
 
 
 /***************************************< Global variables >**************************************/
-extern volatile U8 gau8RGBLEDs[ NUM_RGBLED_COLORS ];
+extern ISR_DATA volatile U8 gau8RGBLEDs[ NUM_RGBLED_COLORS ];
 
 
 /***************************************< Public functions >**************************************/
 void RGBLED_Init( void );
 void RGBLED_Interrupt( void );
+void RGBLED_Blank( void );
 
 
 #endif /* RGBLED_H */
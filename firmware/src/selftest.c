@@ -0,0 +1,176 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file selftest.c
+*
+* \brief Production self-test of the LEDs, for the assembly line
+*
+* \author Hekk_Elek
+*
+* \note  The fixture feeds the board through a series resistor, in place of the cell, so the supply
+*        sags by the current of what is lit. The ADC measures the supply against the internal
+*        1.19V reference: its result rises as the supply sags. The test takes the result with
+*        everything dark, then lights every LED alone: an LED that doesn't load the supply is open
+*        or missing, one that loads it much more than a good one is shorted or wrongly fitted.
+*        The RGB LED is driven by pulses of 3 us, too short to be seen by the ADC: its colors are
+*        shown for the operator only. The whole test takes about 0.4 s; its result stays on the
+*        LEDs until the power is removed.
+*
+**********************************************************************************************************/
+
+/***************************************< Includes >**************************************/
+// Own includes
+#include "stc8g.h"
+#include "types.h"
+#include "board.h"
+#include "led.h"
+#include "rgbled.h"
+#include "util.h"
+#include "batterylevel.h"
+#include "selftest.h"
+
+#if SELFTEST_ENABLE
+
+/***************************************< Definitions >**************************************/
+#define SAMPLE_MS        (4u)    //!< Sampling window of a level: more than a soft-PWM period of both sides
+#define SETTLE_MS        (2u)    //!< Wait after a change of the LEDs, for the supply to settle
+#define COLOR_MS         (100u)  //!< Each color of the RGB LED is shown this long
+#define BLINK_MS         (250u)  //!< Half period of the blinking of the failed LEDs
+#define TEST_LEVEL       (15u)   //!< Brightness of the LED under test: the full load
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+
+
+/***************************************< Static function definitions >**************************************/
+static void Wait( U16 u16Ms );
+static U16  SampleLoad( void );
+
+
+/***************************************< Private functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Waits for the given number of milliseconds
+//! \param  u16Ms: wait time
+//! \return -
+//! \global -
+//! \note   Idles between the ticks of Timer0, instead of spinning on the timer.
+//-----------------------------------------------------------------------------
+static void Wait( U16 u16Ms )
+{
+  U16 u16Start = Util_GetTimerMs();
+  while( (U16)( Util_GetTimerMs() - u16Start ) < u16Ms )
+  {
+    PCON |= 0x01u;  // IDL bit: until the next tick
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Takes the ADC result of the most loaded moment of the soft-PWM
+//! \param  -
+//! \return Highest ADC result within SAMPLE_MS, i.e. the lowest supply voltage
+//! \global -
+//! \note   The LEDs of a side are lit in its half of the period only: the peak is the result of the
+//!         LED under test, whichever side it is on.
+//-----------------------------------------------------------------------------
+static U16 SampleLoad( void )
+{
+  U16 u16Start = Util_GetTimerMs();
+  U16 u16Peak = 0u;
+  U16 u16Level;
+  
+  while( (U16)( Util_GetTimerMs() - u16Start ) < SAMPLE_MS )
+  {
+    u16Level = BatteryLevel_Measure();
+    if( u16Level > u16Peak )
+    {
+      u16Peak = u16Level;
+    }
+  }
+  
+  return u16Peak;
+}
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Tests the LEDs one by one, and shows the result
+//! \param  -
+//! \return -
+//! \global gau8LEDBrightness[], gau8RGBLEDs[]
+//! \note   Should be called after BatteryLevel_Init(), with the Timer0 interrupt running. Never returns.
+//!         Passed: every LED is lit, and the RGB LED is green. Failed: the failed LEDs blink, and
+//!         the RGB LED is red.
+//-----------------------------------------------------------------------------
+void SelfTest_Run( void )
+{
+  U16 u16Dark;
+  U16 u16Droop;
+  U16 u16Failed = 0u;
+  U8  u8Index;
+  
+  // Everything dark for the reference
+  Util_Fill( gau8LEDBrightness, 0u, sizeof( gau8LEDBrightness ) );
+  LED_Commit();
+#if BOARD_RGBLED
+  Util_Fill( (U8 IDATA*)gau8RGBLEDs, 0u, sizeof( gau8RGBLEDs ) );
+#endif
+  Wait( SETTLE_MS );
+  u16Dark = SampleLoad();
+  
+  // Every LED alone
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+  {
+    gau8LEDBrightness[ u8Index ] = TEST_LEVEL;
+    LED_Commit();
+    Wait( SETTLE_MS );
+    u16Droop = SampleLoad();
+    gau8LEDBrightness[ u8Index ] = 0u;
+    LED_Commit();
+    u16Droop = ( u16Droop > u16Dark ) ? ( u16Droop - u16Dark ) : 0u;
+    if( ( u16Droop < SELFTEST_DROOP_MIN ) || ( u16Droop > SELFTEST_DROOP_MAX ) )
+    {
+      u16Failed |= (U16)1u << u8Index;
+    }
+  }
+  ADC_CONTR = 0x00u;  // Disable ADC
+  
+#if BOARD_RGBLED
+  // Colors of the RGB LED, for the operator
+  for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
+  {
+    gau8RGBLEDs[ u8Index ] = TEST_LEVEL;
+    Wait( COLOR_MS );
+    gau8RGBLEDs[ u8Index ] = 0u;
+  }
+  gau8RGBLEDs[ ( 0u == u16Failed ) ? 1u : 0u ] = TEST_LEVEL;  // green or red
+#endif
+  
+  // Show the result until the power is removed
+  if( 0u == u16Failed )
+  {
+    Util_Fill( gau8LEDBrightness, TEST_LEVEL, sizeof( gau8LEDBrightness ) );
+    LED_Commit();
+  }
+  while( TRUE )
+  {
+    for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+    {
+      if( u16Failed & ( (U16)1u << u8Index ) )
+      {
+        gau8LEDBrightness[ u8Index ] ^= TEST_LEVEL;
+      }
+    }
+    LED_Commit();
+    Wait( BLINK_MS );
+  }
+}
+
+#endif /* SELFTEST_ENABLE */
+
+/***************************************< End of file >**************************************/
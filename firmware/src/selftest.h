@@ -0,0 +1,47 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file selftest.h
+*
+* \brief Production self-test of the LEDs, for the assembly line
+*
+* \author Hekk_Elek
+*
+**********************************************************************************************************/
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+/***************************************< Includes >**************************************/
+#include "types.h"
+
+
+/***************************************< Definitions >**************************************/
+#ifndef SELFTEST_ENABLE
+#define SELFTEST_ENABLE       (0u)   //!< 1: holding the button at power-on runs SelfTest_Run() instead of the gauge
+#endif
+#ifndef SELFTEST_DROOP_MIN
+#define SELFTEST_DROOP_MIN    (4u)   //!< Least rise of the ADC result with one LED lit; less is an open LED. Measure on the fixture!
+#endif
+#ifndef SELFTEST_DROOP_MAX
+#define SELFTEST_DROOP_MAX    (60u)  //!< Most rise of the ADC result with one LED lit; more is a shorted LED. Measure on the fixture!
+#endif
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+
+
+/***************************************< Public functions >**************************************/
+#if SELFTEST_ENABLE
+void SelfTest_Run( void );
+#endif
+
+
+#endif /* SELFTEST_H */
+
+/***************************************< End of file >**************************************/
@@ -8,12 +8,6 @@
 * \author Hekk_Elek
 *
 **********************************************************************************************************/
-/*
-TODOs in this module:
--- CRC calculation may need optimization in assembly, as it is a computation-extensive function.
-*/
-
-
 /***************************************< Includes >**************************************/
 // Own includes
 #include "stc8g.h"
@@ -22,7 +16,14 @@ TODOs in this module:
 
 
 /***************************************< Definitions >**************************************/
-#define CRC16_PRECONDITION      (0xBD26u)  //!< Precondition (i.e. initial value) of CRC calculation
+#define CRC16_PRECONDITION      (0xBD26u)  //!< Precondition (i.e. initial value) of CRC calculation; util_crc.a51 has its own copy
+
+#define WAKEUP_COUNTS_PER_MS    (2u)        //!< Power-down wake-up timer: the 32 kHz internal clock divided by 16, nominally
+#define WAKEUP_COUNT_MAX        (0x7FFFu)   //!< Longest period of the wake-up timer, 15 bits
+#define WKTCH_WKTEN             (0x80u)     //!< Enable bit of the wake-up timer in WKTCH
+#if UTIL_ASM_CRC && defined( __IAR_SYSTEMS_ICC__ )
+#error "UTIL_ASM_CRC: util_crc.a51 is written for Keil A51"
+#endif
 
 
 /***************************************< Types >**************************************/
@@ -30,6 +31,7 @@ TODOs in this module:
 
 /***************************************< Constants >**************************************/
 //! \brief Table for calculating CRC-16F/3
+//! \note  Public, as util_crc.a51 reads it too
 CODE const U16 gcau16CRC16F3Table[] =
 {
   0x0000u, 0x1B2Bu, 0x3656u, 0x2D7Du, 0x6CACu, 0x7787u, 0x5AFAu, 0x41D1u,
@@ -68,9 +70,13 @@ CODE const U16 gcau16CRC16F3Table[] =
 
 
 /***************************************< Global variables >**************************************/
-//! \brief Globally accessible timer with millisecond resolution. IDATA for fast access.
-DATA U16 gu16TimerMS;
-DATA U8  gu8Prescaler;  //!< Prescaler for the global timer. IDATA for fast access.
+//! \brief Globally accessible timer with millisecond resolution
+ISR_DATA volatile U16 gu16TimerMS;
+ISR_DATA U8  gu8Prescaler;  //!< Prescaler for the global timer
+#if UTIL_CLOCK_SCALING
+//! \brief System clock in MHz, see SYSTEM_CLOCK_MHZ; read by the RGB LED interrupt too
+ISR_DATA U8  gu8SystemClockMHz;
+#endif
 
 
 /***************************************< Static function definitions >**************************************/
@@ -138,6 +144,9 @@ void Util_Init( void )
 {
   gu8Prescaler = 0u;
   gu16TimerMS = 0u;
+#if UTIL_CLOCK_SCALING
+  gu8SystemClockMHz = SYSTEM_CLOCK_IRC_MHZ;  // CLKDIV is 0 after reset
+#endif
 }
 
 //----------------------------------------------------------------------------
@@ -146,25 +155,99 @@ void Util_Init( void )
 //! \return Timer value
 //! \global Global timer (ms)
 //! \note   Should be called from main program only!
+//!         The 8051 reads the two bytes separately, so the read is repeated until the interrupt
+//!         didn't change the value in between. This doesn't delay the interrupt, unlike locking.
 //-----------------------------------------------------------------------------
 U16 Util_GetTimerMs( void )
 {
   U16 u16Ret;
   
-  DISABLE_IT;
-  u16Ret = gu16TimerMS;
-  ENABLE_IT;
+  do
+  {
+    u16Ret = gu16TimerMS;
+  } while( u16Ret != gu16TimerMS );
   
   return u16Ret;
 }
 
+#if UTIL_SLEEP
+//----------------------------------------------------------------------------
+//! \brief  Sleeps in power-down mode, the global timer goes on meanwhile
+//! \param  u16Ms: time to sleep in ms; at most 16 s, longer is cut
+//! \return -
+//! \global Global timer (ms)
+//! \note   Should be called from main program only, with every LED dark: Timer0 is stopped, the pins
+//!         stay as they are. The wake-up timer runs from the internal 32 kHz clock, so the time slept
+//!         is added as nominal; the uptime and everything timed by Util_GetTimerMs() count it.
+//!         An enabled interrupt, e.g. INT0 of the button, ends it earlier; the whole time is added
+//!         even then, the timer just runs ahead by the rest.
+//-----------------------------------------------------------------------------
+void Util_Sleep( U16 u16Ms )
+{
+  U16 u16Count;
+  
+  if( u16Ms > ( WAKEUP_COUNT_MAX / WAKEUP_COUNTS_PER_MS ) )
+  {
+    u16Ms = WAKEUP_COUNT_MAX / WAKEUP_COUNTS_PER_MS;
+  }
+  if( 0u != u16Ms )
+  {
+    u16Count = u16Ms * WAKEUP_COUNTS_PER_MS - 1u;
+    TR0 = 0;  // Stop Timer 0
+    WKTCL = (U8)u16Count;
+    WKTCH = (U8)( u16Count >> 8u ) | WKTCH_WKTEN;
+    PCON |= 0x02u;  // PD bit
+    NOP();
+    NOP();
+    WKTCH = 0u;
+    gu16TimerMS += u16Ms;  // Timer0 is stopped, nobody else writes it now
+    TR0 = 1;  // Timer0 start run
+  }
+}
+#endif
+
+#if UTIL_CLOCK_SCALING
+//----------------------------------------------------------------------------
+//! \brief  Divides the system clock, and retimes Timer0 for it
+//! \param  u8Shift: the internal RC clock is divided by 2^u8Shift; at most UTIL_CLKDIV_MAX, deeper is cut
+//! \return -
+//! \global gu8SystemClockMHz
+//! \note   Should be called from main program only. The 100 us tick keeps its length: the new reload
+//!         takes effect from the next overflow. Everything timed by the system clock reads
+//!         SYSTEM_CLOCK_MHZ, i.e. the RGB current pulse and the EEPROM wait of persist.c.
+//-----------------------------------------------------------------------------
+void Util_SetClockDivider( U8 u8Shift )
+{
+  U16 u16Reload;
+  
+  if( u8Shift > UTIL_CLKDIV_MAX )
+  {
+    u8Shift = UTIL_CLKDIV_MAX;
+  }
+  if( ( SYSTEM_CLOCK_IRC_MHZ >> u8Shift ) != gu8SystemClockMHz )
+  {
+    DISABLE_IT;
+    P_SW2 |= P_SW2_EAXFR;
+    CLKDIV = (U8)( 1u << u8Shift );  // 1 divides by 1 too
+    P_SW2 &= ~P_SW2_EAXFR;
+    gu8SystemClockMHz = SYSTEM_CLOCK_IRC_MHZ >> u8Shift;
+    u16Reload = UTIL_TIMER0_RELOAD;
+    TL0 = (U8)u16Reload;  // Timer0 runs: this writes the reload register
+    TH0 = (U8)( u16Reload >> 8u );
+    ENABLE_IT;
+  }
+}
+#endif
+
 //----------------------------------------------------------------------------
 //! \brief  Calculates CRC16 of given buffer
 //! \param  *pu8Buffer: given buffer
 //! \param  u8Length: length of the buffer
 //! \return CRC16 value
 //! \global -
+//! \note   With UTIL_ASM_CRC util_crc.a51 has the same function, and this one is left out.
 //-----------------------------------------------------------------------------
+#if !UTIL_ASM_CRC
 U16 Util_CRC16( U8* pu8Buffer, U8 u8Length ) REENTRANT
 {
   U16 u16Crc;
@@ -178,6 +261,67 @@ U16 Util_CRC16( U8* pu8Buffer, U8 u8Length ) REENTRANT
 
   return u16Crc;
 }
+#endif /* !UTIL_ASM_CRC */
+
+//----------------------------------------------------------------------------
+//! \brief  Copies a block within the internal RAM, in place of memcpy()
+//! \param  *pu8Target: where to copy, in DATA or IDATA
+//! \param  *pu8Source: what to copy, in DATA or IDATA
+//! \param  u8Length: number of bytes
+//! \return -
+//! \global -
+//! \note   Every buffer of the firmware is in the internal RAM: 1-byte pointers, one MOV A,@Ri and
+//!         one MOV @Ri,A a byte, without the type dispatch of the generic pointers of the library.
+//!         The blocks mustn't overlap.
+//-----------------------------------------------------------------------------
+void Util_Copy( U8 IDATA* pu8Target, const U8 IDATA* pu8Source, U8 u8Length )
+{
+  while( 0u != u8Length )
+  {
+    *pu8Target = *pu8Source;
+    pu8Target++;
+    pu8Source++;
+    u8Length--;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Copies a block from the code space to the internal RAM, in place of memcpy()
+//! \param  *pu8Target: where to copy, in DATA or IDATA
+//! \param  *pu8Source: what to copy, in CODE
+//! \param  u8Length: number of bytes
+//! \return -
+//! \global -
+//! \note   One MOVC through DPTR and one MOV @Ri,A a byte.
+//-----------------------------------------------------------------------------
+void Util_CopyCode( U8 IDATA* pu8Target, const U8 CODE* pu8Source, U8 u8Length )
+{
+  while( 0u != u8Length )
+  {
+    *pu8Target = *pu8Source;
+    pu8Target++;
+    pu8Source++;
+    u8Length--;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Fills a block of the internal RAM, in place of memset()
+//! \param  *pu8Target: the block, in DATA or IDATA
+//! \param  u8Value: value of every byte
+//! \param  u8Length: number of bytes
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+void Util_Fill( U8 IDATA* pu8Target, U8 u8Value, U8 u8Length )
+{
+  while( 0u != u8Length )
+  {
+    *pu8Target = u8Value;
+    pu8Target++;
+    u8Length--;
+  }
+}
 
 
 /***************************************< End of file >**************************************/
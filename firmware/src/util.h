@@ -12,20 +12,41 @@
 #define UTIL_H
 
 /***************************************< Includes >**************************************/
+#ifndef __A51__  // util_crc.a51 only reads the definitions
 #include "stc8g.h"
 #include "platform.h"
+#endif
 
 
 /***************************************< Definitions >**************************************/
 #define UID_LENGTH        (7u)  //!< Length of the unique ID of the MCU
-#define SYSTEM_CLOCK_MHZ (24u)  //!< System clock in MHz, rounded to integers
+#define SYSTEM_CLOCK_IRC_MHZ (24u)  //!< Internal RC clock in MHz, rounded to integers: the system clock undivided
+#ifndef UTIL_CLOCK_SCALING
+#define UTIL_CLOCK_SCALING   (0u)   //!< 1: Util_SetClockDivider() is built, the system clock may be divided at runtime
+#endif
+#if UTIL_CLOCK_SCALING
+#define SYSTEM_CLOCK_MHZ     ( gu8SystemClockMHz )     //!< System clock in MHz, as set by Util_SetClockDivider()
+#define UTIL_CLKDIV_MAX      (2u)   //!< Deepest division, as a shift: 6 MHz, the 100 us interrupt still fits
+#else
+#define SYSTEM_CLOCK_MHZ     SYSTEM_CLOCK_IRC_MHZ      //!< System clock in MHz, rounded to integers
+#endif
+#ifndef UTIL_SLEEP
+#define UTIL_SLEEP        (0u)  //!< 1: Util_Sleep() is built, the power-down wake-up timer stands for Timer0 meanwhile
+#endif
+#ifndef UTIL_ASM_CRC
+#define UTIL_ASM_CRC      (0u)  //!< 1: Util_CRC16() of util_crc.a51 (Keil only); 0: the C version of util.c
+#endif
 
 
 /***************************************< Macros >**************************************/
 #define DISABLE_IT     EA = 0;NOP();  //!< Global interrupt disable
 #define ENABLE_IT      EA = 1;NOP();  //!< Global interrupt enable
+#define P_SW2_EAXFR    (0x80u)        //!< P_SW2 bit to reach the extended SFRs in XDATA, e.g. CLKDIV or P3PU
+#define UTIL_TIMER0_RELOAD  ( (U16)( 0u - 100u * SYSTEM_CLOCK_MHZ ) )  //!< Reload of Timer0 in 1T mode for the 100 us tick
 
 
+#ifndef __A51__
+
 /***************************************< Types >**************************************/
 
 
@@ -33,7 +54,10 @@
 
 
 /***************************************< Global variables >**************************************/
-extern DATA U16 gu16TimerMS;
+extern ISR_DATA volatile U16 gu16TimerMS;
+#if UTIL_CLOCK_SCALING
+extern ISR_DATA U8 gu8SystemClockMHz;
+#endif
 
 
 /***************************************< Public functions >**************************************/
@@ -42,7 +66,18 @@ void Util_Get_UID( U8* pu8Dest );
 void Util_Interrupt( void );
 void Util_Init( void );
 U16 Util_GetTimerMs( void );
+#if UTIL_SLEEP
+void Util_Sleep( U16 u16Ms );
+#endif
+#if UTIL_CLOCK_SCALING
+void Util_SetClockDivider( U8 u8Shift );
+#endif
 U16 Util_CRC16( U8* pu8Buffer, U8 u8Length ) REENTRANT;
+void Util_Copy( U8 IDATA* pu8Target, const U8 IDATA* pu8Source, U8 u8Length );
+void Util_CopyCode( U8 IDATA* pu8Target, const U8 CODE* pu8Source, U8 u8Length );
+void Util_Fill( U8 IDATA* pu8Target, U8 u8Value, U8 u8Length );
+
+#endif /* __A51__ */
 
 
 #endif /* UTIL_H */
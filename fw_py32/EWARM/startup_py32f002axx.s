@@ -48,7 +48,6 @@
         SECTION .intvec:CODE:NOROOT(2)
 
         EXTERN  __iar_program_start
-        EXTERN  SystemInit        
         PUBLIC  __vector_table
 
         DATA
@@ -113,8 +112,8 @@ __vector_table
         PUBWEAK Reset_Handler
         SECTION .text:CODE:REORDER:NOROOT(2)
 Reset_Handler
-        LDR     R0, =SystemInit
-        BLX     R0
+        ; SystemInit is not called: main() sets up the HSI first thing in APP_SystemClockConfig,
+        ; and VTOR resets to 0, where the flash is mapped
         LDR     R0, =__iar_program_start
         BX      R0
         
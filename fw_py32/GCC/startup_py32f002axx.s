@@ -0,0 +1,152 @@
+/******************************************************************************
+ * @file              : startup_py32f002axx.s
+ * @brief             : PY32F002Axx devices vector table for the GCC toolchain,
+ *                      the counterpart of ../EWARM/startup_py32f002axx.s.
+ *                      This module performs:
+ *                      - Set the initial SP
+ *                      - Set the initial PC == Reset_Handler
+ *                      - Set the vector table entries with the exceptions ISR address
+ *                      - Copy .data (with the .ramfunc code) to the RAM, and zero .bss
+ *                      - Branch to main()
+ *                      After Reset the CortexM0+ processor is in Thread mode,
+ *                      priority is Privileged, and the Stack is set to Main.
+ ******************************************************************************
+ * The symbols come from py32f002ax5_flash.ld. .noinit is left as it is, like
+ * the __no_init variables of the IAR build. SystemInit is not called, as in the
+ * IAR build: main() sets up the HSI first thing in APP_SystemClockConfig, and
+ * VTOR resets to 0, where the flash is mapped. No C++ or libc constructors run.
+ ******************************************************************************/
+
+        .syntax unified
+        .cpu    cortex-m0plus
+        .fpu    softvfp
+        .thumb
+
+        .global __vector_table
+        .global Reset_Handler
+
+/* Reset handler */
+        .section .text.Reset_Handler,"ax",%progbits
+        .type   Reset_Handler, %function
+Reset_Handler:
+        /* .data and .ramfunc from their load address */
+        ldr     r0, =_sdata
+        ldr     r1, =_edata
+        ldr     r2, =_sidata
+        b       CopyCheck
+CopyLoop:
+        ldr     r3, [r2]
+        str     r3, [r0]
+        adds    r0, r0, #4
+        adds    r2, r2, #4
+CopyCheck:
+        cmp     r0, r1
+        bcc     CopyLoop
+
+        /* .bss to zero */
+        ldr     r0, =_sbss
+        ldr     r1, =_ebss
+        movs    r3, #0
+        b       ZeroCheck
+ZeroLoop:
+        str     r3, [r0]
+        adds    r0, r0, #4
+ZeroCheck:
+        cmp     r0, r1
+        bcc     ZeroLoop
+
+        bl      main
+Halt:
+        b       Halt
+        .size   Reset_Handler, .-Reset_Handler
+
+/* Default handler of the unused exceptions: an endless loop */
+        .section .text.Default_Handler,"ax",%progbits
+        .type   Default_Handler, %function
+Default_Handler:
+        b       Default_Handler
+        .size   Default_Handler, .-Default_Handler
+
+/* Vector table */
+        .section .isr_vector,"a",%progbits
+        .type   __vector_table, %object
+__vector_table:
+        .word   _estack                         /* Top of Stack */
+        .word   Reset_Handler                   /* Reset Handler */
+        .word   NMI_Handler                     /* NMI Handler */
+        .word   HardFault_Handler               /* Hard Fault Handler */
+        .word   0                               /* Reserved */
+        .word   0                               /* Reserved */
+        .word   0                               /* Reserved */
+        .word   0                               /* Reserved */
+        .word   0                               /* Reserved */
+        .word   0                               /* Reserved */
+        .word   0                               /* Reserved */
+        .word   SVC_Handler                     /* SVCall Handler */
+        .word   0                               /* Reserved */
+        .word   0                               /* Reserved */
+        .word   PendSV_Handler                  /* PendSV Handler */
+        .word   SysTick_Handler                 /* SysTick Handler */
+
+        /* External Interrupts */
+        .word   0                               /* 0Reserved */
+        .word   0                               /* 1Reserved */
+        .word   0                               /* 2Reserved */
+        .word   FLASH_IRQHandler                /* 3FLASH */
+        .word   RCC_IRQHandler                  /* 4RCC */
+        .word   EXTI0_1_IRQHandler              /* 5EXTI Line 0 and 1 */
+        .word   EXTI2_3_IRQHandler              /* 6EXTI Line 2 and 3 */
+        .word   EXTI4_15_IRQHandler             /* 7EXTI Line 4 to 15 */
+        .word   0                               /* 8Reserved */
+        .word   0                               /* 9Reserved */
+        .word   0                               /* 10Reserved */
+        .word   0                               /* 11Reserved */
+        .word   ADC_COMP_IRQHandler             /* 12ADC&COMP */
+        .word   TIM1_BRK_UP_TRG_COM_IRQHandler  /* 13TIM1 Break, Update, Trigger and Commutation */
+        .word   TIM1_CC_IRQHandler              /* 14TIM1 Capture Compare */
+        .word   0                               /* 15Reserved */
+        .word   0                               /* 16Reserved */
+        .word   LPTIM1_IRQHandler               /* 17LPTIM1 */
+        .word   0                               /* 18Reserved */
+        .word   0                               /* 19Reserved */
+        .word   0                               /* 20Reserved */
+        .word   TIM16_IRQHandler                /* 21TIM16 */
+        .word   0                               /* 22Reserved */
+        .word   I2C1_IRQHandler                 /* 23I2C1 */
+        .word   0                               /* 24Reserved */
+        .word   SPI1_IRQHandler                 /* 25SPI1 */
+        .word   0                               /* 26Reserved */
+        .word   USART1_IRQHandler               /* 27USART1 */
+        .word   0                               /* 28Reserved */
+        .word   0                               /* 29Reserved */
+        .word   0                               /* 30Reserved */
+        .word   0                               /* 31Reserved */
+        .size   __vector_table, .-__vector_table
+
+/* The handlers not defined by the firmware run Default_Handler */
+        .macro  WEAK_HANDLER sName
+        .weak   \sName
+        .thumb_set \sName, Default_Handler
+        .endm
+
+        WEAK_HANDLER NMI_Handler
+        WEAK_HANDLER HardFault_Handler
+        WEAK_HANDLER SVC_Handler
+        WEAK_HANDLER PendSV_Handler
+        WEAK_HANDLER SysTick_Handler
+        WEAK_HANDLER FLASH_IRQHandler
+        WEAK_HANDLER RCC_IRQHandler
+        WEAK_HANDLER EXTI0_1_IRQHandler
+        WEAK_HANDLER EXTI2_3_IRQHandler
+        WEAK_HANDLER EXTI4_15_IRQHandler
+        WEAK_HANDLER ADC_COMP_IRQHandler
+        WEAK_HANDLER TIM1_BRK_UP_TRG_COM_IRQHandler
+        WEAK_HANDLER TIM1_CC_IRQHandler
+        WEAK_HANDLER LPTIM1_IRQHandler
+        WEAK_HANDLER TIM16_IRQHandler
+        WEAK_HANDLER I2C1_IRQHandler
+        WEAK_HANDLER SPI1_IRQHandler
+        WEAK_HANDLER USART1_IRQHandler
+
+        .end
+/*****************************END OF FILE************************************/
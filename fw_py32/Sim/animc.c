@@ -0,0 +1,1520 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file animc.c
+*
+* \brief Animation compiler: text description to the instruction tables of animation.c
+*
+* \author Hekk_Elek
+*
+* \note  Includes the unmodified animation.c, so the opcodes, the instruction layout and the virtual
+*        machine are exactly the firmware's. Every compiled animation is also played on the simulated
+*        LED driver to report its size, cost and average LED current.
+*        Usage: animc [-t py32|stc] [-m mA] [-l ms] [-o output.c] [-b image.bin] [-g trims] [-p map.txt] <description.txt>
+*        The table text goes to the output (stdout by default), the report to stderr. With -b, the
+*        first animation is also written as an image for the UART upload, see upload.c. With -g, the
+*        image also carries the trims of the LEDs, LEDS_NUM comma separated values of 0..255, see
+*        LED_SetTrims(); the device saves them, later images without -g keep them.
+*        The normal tables of the frames option refer to the rows of gcau8Frames[] of animation.c: the
+*        rows not there yet are numbered after its last one, and printed to be added to its end. A
+*        row of the levels of the palette is a PALETTE_FRAME row of gcau8PaletteFrames[] instead, the
+*        same way.
+*        The profile of every animation is measured while it is played, and printed with its tables:
+*        Play() sets the drivers up from it, see S_ANIMATION_PROFILE.
+*        The normal tables of the branches option are written along the left and the right branch of
+*        the tree instead of by LED, and resampled into the LED map of the board here: the firmware
+*        gets ordinary arrays. The map is the one of the Karifa panel, or the one of -p, see LoadLedMap().
+*        See animations.txt for the input format.
+*
+**********************************************************************************************************/
+
+/***************************************< Includes >**************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <time.h>
+
+// The virtual machine itself, with its private types and state
+#include "animation.c"
+
+
+/***************************************< Definitions >**************************************/
+#define MAX_ANIMATIONS        (64u)    //!< Animations in one description file
+#define MAX_INSTRUCTIONS      (255u)   //!< Instructions of one table, the length is stored in a U8
+#define MAX_NAME              (48u)    //!< Length of an animation name
+#define MAX_LINE              (512u)   //!< Length of an input line
+#define MAX_OPERAND_TEXT      (40u)    //!< Length of the operand as printed in C
+#define MAX_BRANCH_SAMPLES    (32u)    //!< Values of a branch in an instruction of a branches table
+#define BRANCH_POSITION_ONE   (256u)   //!< Top of a branch in the fixed point positions of the LED map
+#define MAX_FRAMES            (128u)   //!< Rows of gcau8Frames[], the index of S_ANIMATION_INSTRUCTION_FRAME is a U8 without PALETTE_FRAME
+#define MAX_PALETTE_FRAMES    (128u)   //!< Rows of gcau8PaletteFrames[], the same index with PALETTE_FRAME
+#define DEFAULT_LED_MA        (10u)    //!< Current of one lit LED, if not given; measure it on the board!
+#define MIN_SIM_MS            (1000u)  //!< Shortest simulation
+#define SIM_PERIODS           (4u)     //!< Simulated periods of the longer table, if the length is not given
+#define MAX_SIM_MS            (600000u)  //!< Longest simulation
+#define SIM_TICKS_PER_MS      ( 10u * LED_TICK_DIVIDER )  //!< TIM1 periods per millisecond, as in util.c
+#define PY32_ANIMATION_BYTES  (32u)    //!< sizeof( S_ANIMATION ) with 32-bit pointers
+#define STC_INSTRUCTION_BYTES (3u)     //!< Timing in units, opcode and operand of a packed 8051 instruction
+#define STC_ANIMATION_BYTES   (9u)     //!< sizeof( S_ANIMATION ) with 2-byte CODE pointers and the time units
+#define STC_MAX_UNIT_MS       (255u)   //!< Longest time unit of an 8051 table, and most units of an instruction
+#define MIN( a, b )           ( ( (a) < (b) ) ? (a) : (b) )
+#define MAX( a, b )           ( ( (a) > (b) ) ? (a) : (b) )
+
+
+/***************************************< Types >**************************************/
+//! \brief Target architecture of the generated tables
+typedef enum
+{
+  TARGET_PY32 = 0u,  //!< fw_py32: every opcode
+  TARGET_STC  = 1u   //!< firmware: no LERP and no GENERATE
+} E_ANIMC_TARGET;
+
+//! \brief Branches of the tree, as written in the branches tables
+typedef enum
+{
+  BRANCH_LEFT  = 0u,  //!< Left branch, the values before the /
+  BRANCH_RIGHT = 1u   //!< Right branch, the values after the /
+} E_ANIMC_BRANCH;
+
+//! \brief Place of an LED on the board, see LoadLedMap()
+typedef struct
+{
+  U8  u8Branch;     //!< Branch of the LED (E_ANIMC_BRANCH)
+  U16 u16Position;  //!< Position along the branch from its bottom, in 1/BRANCH_POSITION_ONE of its length
+} S_ANIMC_LED_PLACE;
+
+//! \brief One instruction as read from the description
+typedef struct
+{
+  U16  u16TimingMs;                        //!< Duration
+  I16  ai16Value[ LEDS_NUM ];              //!< Brightness array as written
+  U8   u8Opcode;                           //!< Opcode bits
+  U8   u8Operand;                          //!< Operand value
+  U8   u8Frame;                            //!< Row of the brightness array in the dictionary, for the FRAMES option
+  char acOpcode[ MAX_OPERAND_TEXT ];       //!< Opcode as printed in C
+  char acOperand[ MAX_OPERAND_TEXT ];      //!< Operand as printed in C
+} S_ANIMC_INSTRUCTION;
+
+//! \brief One animation as read from the description
+typedef struct
+{
+  char acName[ MAX_NAME ];                            //!< Name, the tables are gas<Name> and gas<Name>RGB
+  char acDescription[ MAX_LINE ];                     //!< Text of the doc comments
+  U8   au8Length[ 2u ];                               //!< Instructions of the normal and the RGB table
+  U8   u8Options;                                     //!< Option bits of the animation (LOOP_RGB, MIRROR, FRAMES)
+  BOOL bBranches;                                     //!< The normal instructions are written along the branches, see ParseBranches()
+  U8   u8NewFrames;                                   //!< Rows added to the dictionary by the normal table
+  U8   u8NewPaletteFrames;                            //!< Rows added to the palette dictionary by the normal table
+  S_ANIMC_INSTRUCTION asInstr[ 2u ][ MAX_INSTRUCTIONS ];  //!< Normal and RGB instructions
+  S_ANIMATION_PROFILE sProfile;                       //!< Figures measured by Report(), printed with the tables
+  U8   au8UnitMs[ 2u ];                               //!< Time unit of the normal and the RGB table on the STC8, see PickTimeUnits()
+} S_ANIMC_ANIMATION;
+
+//! \brief Name of an opcode or a generator in the description
+typedef struct
+{
+  const char* pcName;  //!< Name, as in animation.c
+  U8          u8Value; //!< Value
+} S_ANIMC_NAME;
+
+
+/***************************************< Constants >**************************************/
+//! \brief Opcode names, as in E_ANIMATION_OPCODE
+static const S_ANIMC_NAME gcasOpcodeNames[] =
+{
+  { "LOAD",     LOAD     },
+  { "ADD",      ADD      },
+  { "RSHIFT",   RSHIFT   },
+  { "LSHIFT",   LSHIFT   },
+  { "LERP",     LERP     },
+  { "DIV",      DIV      },
+  { "USOURCE",  USOURCE  },
+  { "DSOURCE",  DSOURCE  },
+  { "REPEAT",   REPEAT   },
+  { "GENERATE", GENERATE },
+  { "SATADD",   SATADD   },
+  { "HSV",      HSV      },
+  { "JUMP",     JUMP     },
+  { "LOOP",     LOOP     },
+  { "CALL",     CALL     },
+  { "END",      END      },
+  { "PALETTE",  PALETTE  },
+};
+
+//! \brief Generator names, as in E_ANIMATION_GENERATOR
+static const S_ANIMC_NAME gcasGeneratorNames[] =
+{
+  { "GEN_SPARKLE",   GEN_SPARKLE   },
+  { "GEN_FADE",      GEN_FADE      },
+  { "GEN_CHASE_CW",  GEN_CHASE_CW  },
+  { "GEN_CHASE_CCW", GEN_CHASE_CCW },
+};
+
+//! \brief Easing curve names of LERP, as in E_ANIMATION_EASE
+static const S_ANIMC_NAME gcasEaseNames[] =
+{
+  { "EASE_LINEAR", EASE_LINEAR },
+  { "EASE_IN",     EASE_IN     },
+  { "EASE_OUT",    EASE_OUT    },
+  { "EASE_SINE",   EASE_SINE   },
+};
+
+//! \brief Table names in the description and in the doc comments
+static const char* const gcapcTableName[ 2u ] = { "normal", "rgb" };
+static const char* const gcapcTableDoc[ 2u ] = { "normal LEDs", "RGB LED" };
+
+
+/***************************************< Global variables >**************************************/
+GPIO_TypeDef gasSimGPIO[ 3 ];     //!< GPIOA, GPIOB, GPIOF
+S_SIM_TIM gsSimTIM1;              //!< TIM1
+S_SIM_SYSTICK gsSimSysTick;       //!< SysTick
+void (* gpfSimWFI)( void );       //!< Nothing wakes __WFI() up here
+uint32_t gu32SimLPTIMCount;       //!< LPTIM, not used here
+DATA S_PERSIST gsPersistentData;  //!< Normally in persist.c, not used here
+
+static S_ANIMC_ANIMATION gasAnimC[ MAX_ANIMATIONS ];  //!< Animations of the description
+static U8 gu8AnimCCount;                              //!< Number of animations read
+static U8 gau8Frames[ MAX_FRAMES ][ LEDS_NUM ];       //!< Dictionary of the FRAMES tables: gcau8Frames[], then the rows added
+static U16 gu16FrameCount;                            //!< Rows of gau8Frames[]
+static U8 gau8PaletteFrames[ MAX_PALETTE_FRAMES ][ PALETTE_ROW_BYTES ];  //!< Dictionary of the palette rows: gcau8PaletteFrames[], then the rows added
+static U16 gu16PaletteFrameCount;                     //!< Rows of gau8PaletteFrames[]
+static S_ANIMC_LED_PLACE gasLedMap[ LEDS_NUM ];      //!< Place of each LED of gau8LEDBrightness[] on the board
+static const char* gpcFileName;                       //!< Description file, for the error messages
+static U32 gu32LineNumber;                            //!< Line being parsed, for the error messages
+
+
+/***************************************< Static function definitions >**************************************/
+static void Fail( const char* pcMessage, const char* pcToken );
+static BOOL LookupName( const S_ANIMC_NAME* psNames, U8 u8Count, const char* pcName, U8* pu8Value );
+static void DefaultLedMap( void );
+static void LoadLedMap( FILE* psFile );
+static I16  Resample( const I16* pi16Samples, U8 u8Samples, U16 u16Position );
+static char* ParseBranches( S_ANIMC_INSTRUCTION* psInstr, const char* pcDelimiters );
+static void ParseInstruction( S_ANIMC_ANIMATION* psAnim, U8 u8Table, char* pcLine, E_ANIMC_TARGET eTarget );
+static void ParseFile( FILE* psFile, E_ANIMC_TARGET eTarget );
+static void AssignFrames( void );
+static void PickTimeUnits( S_ANIMC_ANIMATION* psAnim );
+static void PrintTable( FILE* psOut, const S_ANIMC_ANIMATION* psAnim, U8 u8Table, E_ANIMC_TARGET eTarget );
+static void PrintAnimations( FILE* psOut, E_ANIMC_TARGET eTarget );
+static U32 TablePeriodMs( const S_ANIMC_ANIMATION* psAnim, U8 u8Table );
+static void BuildTables( const S_ANIMC_ANIMATION* psAnim, S_ANIMATION_INSTRUCTION_NORMAL* psNormal, S_ANIMATION_INSTRUCTION_RGB* psRGB );
+static void WriteImage( FILE* psOut, const S_ANIMC_ANIMATION* psAnim, const char* pcTrims );
+static void Report( S_ANIMC_ANIMATION* psAnim, E_ANIMC_TARGET eTarget, U32 u32LedMa, U32 u32LengthMs );
+static uint64_t NowNs( void );
+
+
+/***************************************< Private functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Stops with an error message pointing to the current line
+//! \param  pcMessage: what is wrong
+//! \param  pcToken: the offending text, or NULL
+//! \return Never returns
+//-----------------------------------------------------------------------------
+static void Fail( const char* pcMessage, const char* pcToken )
+{
+  fprintf( stderr, "%s:%lu: %s%s%s\n", gpcFileName, (unsigned long)gu32LineNumber, pcMessage,
+           pcToken ? ": " : "", pcToken ? pcToken : "" );
+  exit( 1 );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Finds a name in a name table
+//! \param  psNames: the table
+//! \param  u8Count: number of entries
+//! \param  pcName: name to find
+//! \param  pu8Value: value of the name, if found
+//! \return TRUE if found
+//-----------------------------------------------------------------------------
+static BOOL LookupName( const S_ANIMC_NAME* psNames, U8 u8Count, const char* pcName, U8* pu8Value )
+{
+  U8 u8Index;
+
+  for( u8Index = 0u; u8Index < u8Count; u8Index++ )
+  {
+    if( 0 == strcmp( psNames[ u8Index ].pcName, pcName ) )
+    {
+      *pu8Value = psNames[ u8Index ].u8Value;
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Sets the LED map of the Karifa panel
+//! \param  -
+//! \return -
+//! \global gasLedMap[]
+//! \note   The left side is the first part of the array from the bottom up, the right side the rest
+//!         from the top down, evenly spaced: the array mirrors around RIGHT_LEDS_START.
+//-----------------------------------------------------------------------------
+static void DefaultLedMap( void )
+{
+  U8 u8Index;
+
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+  {
+    if( u8Index < RIGHT_LEDS_START )
+    {
+      gasLedMap[ u8Index ].u8Branch = BRANCH_LEFT;
+      gasLedMap[ u8Index ].u16Position = (U16)( ( u8Index * BRANCH_POSITION_ONE + ( RIGHT_LEDS_START - 1u ) / 2u ) / ( RIGHT_LEDS_START - 1u ) );
+    }
+    else
+    {
+      gasLedMap[ u8Index ].u8Branch = BRANCH_RIGHT;
+      gasLedMap[ u8Index ].u16Position = (U16)( ( ( LEDS_NUM - 1u - u8Index ) * BRANCH_POSITION_ONE + ( LEDS_NUM - RIGHT_LEDS_START - 1u ) / 2u )
+                                                / ( LEDS_NUM - RIGHT_LEDS_START - 1u ) );
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Reads the LED map of a board
+//! \param  psFile: the map
+//! \return -
+//! \global gasLedMap[], gu32LineNumber
+//! \note   One line for each LED, in the order of gau8LEDBrightness[], '#' starts a comment:
+//!           left|right <position>   branch of the LED, and its place along it: 0.0 bottom, 1.0 top
+//!         A larger board has its own map, and builds animc with its own LEDS_NUM.
+//-----------------------------------------------------------------------------
+static void LoadLedMap( FILE* psFile )
+{
+  char   acLine[ MAX_LINE ];
+  char   acBranch[ MAX_LINE ];
+  char*  pcComment;
+  double dPosition;
+  U8     u8Count = 0u;
+
+  gu32LineNumber = 0u;
+  while( NULL != fgets( acLine, sizeof( acLine ), psFile ) )
+  {
+    gu32LineNumber++;
+    pcComment = strchr( acLine, '#' );
+    if( NULL != pcComment )
+    {
+      *pcComment = '\0';
+    }
+    if( 1 > sscanf( acLine, "%511s", acBranch ) )
+    {
+      continue;
+    }
+    if( ( 2 != sscanf( acLine, "%511s %lf", acBranch, &dPosition ) ) || ( dPosition < 0.0 ) || ( dPosition > 1.0 )
+     || ( ( 0 != strcmp( acBranch, "left" ) ) && ( 0 != strcmp( acBranch, "right" ) ) ) )
+    {
+      Fail( "An LED needs its branch, left or right, and its position of 0.0..1.0", acBranch );
+    }
+    if( u8Count >= LEDS_NUM )
+    {
+      Fail( "More LEDs than LEDS_NUM", NULL );
+    }
+    gasLedMap[ u8Count ].u8Branch = ( 'r' == acBranch[ 0 ] ) ? BRANCH_RIGHT : BRANCH_LEFT;
+    gasLedMap[ u8Count ].u16Position = (U16)( dPosition * BRANCH_POSITION_ONE + 0.5 );
+    u8Count++;
+  }
+  if( LEDS_NUM != u8Count )
+  {
+    Fail( "The map needs a line for each of the LEDS_NUM LEDs", NULL );
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Takes the value of a branch at a position, linearly interpolated between its values
+//! \param  pi16Samples: values of the branch, evenly spaced from its bottom to its top
+//! \param  u8Samples: number of values, 1..MAX_BRANCH_SAMPLES; a single value is the whole branch
+//! \param  u16Position: position along the branch, [0; BRANCH_POSITION_ONE]
+//! \return Value at the position, rounded to the nearest
+//-----------------------------------------------------------------------------
+static I16 Resample( const I16* pi16Samples, U8 u8Samples, U16 u16Position )
+{
+  U32 u32Scaled = (U32)u16Position * ( u8Samples - 1u );  // in 1/BRANCH_POSITION_ONE values
+  U8  u8Below = (U8)( u32Scaled / BRANCH_POSITION_ONE );
+  I32 i32Fraction = (I32)( u32Scaled % BRANCH_POSITION_ONE );
+  I32 i32Value = (I32)pi16Samples[ u8Below ] * (I32)BRANCH_POSITION_ONE;
+
+  if( ( u8Below + 1u ) < u8Samples )
+  {
+    i32Value += ( (I32)pi16Samples[ u8Below + 1u ] - (I32)pi16Samples[ u8Below ] ) * i32Fraction;
+  }
+  // Halves away from zero, so the signed values of ADD are rounded just like the levels
+  if( i32Value >= 0 )
+  {
+    i32Value = ( i32Value + (I32)BRANCH_POSITION_ONE / 2 ) / (I32)BRANCH_POSITION_ONE;
+  }
+  else
+  {
+    i32Value = -( ( (I32)BRANCH_POSITION_ONE / 2 - i32Value ) / (I32)BRANCH_POSITION_ONE );
+  }
+  return (I16)i32Value;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Parses the brightness values of a branches instruction: <left values> / <right values>
+//! \param  psInstr: instruction, its brightness array is resampled from the branches by gasLedMap[]
+//! \param  pcDelimiters: delimiters of strtok(), it goes on in the line of the instruction
+//! \return The token after the values, i.e. the opcode, or NULL at the end of the line
+//! \global gasLedMap[]
+//! \note   Each branch has 1..MAX_BRANCH_SAMPLES values, from its bottom to its top, so the same
+//!         description fits any board. RSHIFT, LSHIFT and the generators still step by LEDs.
+//-----------------------------------------------------------------------------
+static char* ParseBranches( S_ANIMC_INSTRUCTION* psInstr, const char* pcDelimiters )
+{
+  I16   aai16Samples[ 2u ][ MAX_BRANCH_SAMPLES ];
+  U8    au8Samples[ 2u ] = { 0u, 0u };
+  U8    u8Branch = BRANCH_LEFT;
+  U8    u8Index;
+  BOOL  bValue = TRUE;
+  long  lValue;
+  char* pcToken = strtok( NULL, pcDelimiters );
+  char* pcEnd;
+
+  while( bValue && ( NULL != pcToken ) )
+  {
+    if( ( BRANCH_LEFT == u8Branch ) && ( 0 == strcmp( pcToken, "/" ) ) )
+    {
+      u8Branch = BRANCH_RIGHT;
+    }
+    else if( isdigit( (unsigned char)*pcToken ) || '-' == *pcToken )
+    {
+      lValue = strtol( pcToken, &pcEnd, 0 );
+      if( ( '\0' != *pcEnd ) || ( lValue < -128 ) || ( lValue > 255 ) )
+      {
+        Fail( "Invalid brightness value", pcToken );
+      }
+      if( au8Samples[ u8Branch ] >= MAX_BRANCH_SAMPLES )
+      {
+        Fail( "Too many values on a branch", pcToken );
+      }
+      aai16Samples[ u8Branch ][ au8Samples[ u8Branch ]++ ] = (I16)lValue;
+    }
+    else
+    {
+      bValue = FALSE;  // the opcode
+    }
+    if( bValue )
+    {
+      pcToken = strtok( NULL, pcDelimiters );
+    }
+  }
+  if( ( BRANCH_RIGHT != u8Branch ) || ( 0u == au8Samples[ BRANCH_LEFT ] ) || ( 0u == au8Samples[ BRANCH_RIGHT ] ) )
+  {
+    Fail( "A branches instruction needs the values of the left branch, a /, and the values of the right one", NULL );
+  }
+
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+  {
+    u8Branch = gasLedMap[ u8Index ].u8Branch;
+    psInstr->ai16Value[ u8Index ] = Resample( aai16Samples[ u8Branch ], au8Samples[ u8Branch ], gasLedMap[ u8Index ].u16Position );
+  }
+  return pcToken;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Parses an instruction line: <ms> <brightness values> <OPCODE[|OPCODE]> [operand]
+//! \param  psAnim: animation the instruction belongs to
+//! \param  u8Table: 0 for the normal LEDs, 1 for the RGB LED
+//! \param  pcLine: the line, it is modified
+//! \param  eTarget: target of the tables
+//! \return -
+//-----------------------------------------------------------------------------
+static void ParseInstruction( S_ANIMC_ANIMATION* psAnim, U8 u8Table, char* pcLine, E_ANIMC_TARGET eTarget )
+{
+  const char* pcDelimiters = " \t\r\n,{}";
+  U8    u8Values = u8Table ? NUM_RGBLED_COLORS : LEDS_NUM;
+  U8    u8Index;
+  U8    u8Bits;
+  U8    u8Generator;
+  long  lValue;
+  char* pcToken;
+  char* pcEnd;
+  char* pcBit;
+  char  acOpcode[ MAX_OPERAND_TEXT ];
+  S_ANIMC_INSTRUCTION* psInstr;
+
+  if( psAnim->au8Length[ u8Table ] >= MAX_INSTRUCTIONS )
+  {
+    Fail( "Too many instructions", gcapcTableName[ u8Table ] );
+  }
+  psInstr = &psAnim->asInstr[ u8Table ][ psAnim->au8Length[ u8Table ] ];
+  memset( psInstr, 0, sizeof( *psInstr ) );
+
+  // Timing
+  pcToken = strtok( pcLine, pcDelimiters );
+  lValue = strtol( pcToken, &pcEnd, 0 );
+  if( ( '\0' != *pcEnd && 'u' != *pcEnd ) || ( lValue < 0 ) || ( lValue > 0xFFFF ) )
+  {
+    Fail( "Timing must be 1..65535 ms", pcToken );
+  }
+  psInstr->u16TimingMs = (U16)lValue;  // 0 is for the flow control only, checked with the opcode
+
+  // Brightness array; signed values are for ADD, USOURCE and DSOURCE
+  if( ( 0u == u8Table ) && psAnim->bBranches )
+  {
+    u8Values = 0u;  // resampled from the branches instead
+    pcToken = ParseBranches( psInstr, pcDelimiters );
+  }
+  for( u8Index = 0u; u8Index < u8Values; u8Index++ )
+  {
+    pcToken = strtok( NULL, pcDelimiters );
+    if( NULL == pcToken )
+    {
+      Fail( "Too few brightness values", NULL );
+    }
+    lValue = strtol( pcToken, &pcEnd, 0 );
+    if( ( '\0' != *pcEnd ) || ( lValue < -128 ) || ( lValue > 255 ) )
+    {
+      Fail( "Invalid brightness value", pcToken );
+    }
+    psInstr->ai16Value[ u8Index ] = (I16)lValue;
+  }
+
+  // Opcode bits
+  if( 0u != u8Values )
+  {
+    pcToken = strtok( NULL, pcDelimiters );
+  }
+  if( NULL == pcToken )
+  {
+    Fail( "Missing opcode", NULL );
+  }
+  if( isdigit( (unsigned char)*pcToken ) || '-' == *pcToken )
+  {
+    Fail( "Too many brightness values", pcToken );
+  }
+  snprintf( acOpcode, sizeof( acOpcode ), "%s", pcToken );
+  for( pcBit = strtok_r( acOpcode, "|", &pcEnd ); NULL != pcBit; pcBit = strtok_r( NULL, "|", &pcEnd ) )
+  {
+    if( !LookupName( gcasOpcodeNames, sizeof( gcasOpcodeNames )/sizeof( gcasOpcodeNames[ 0 ] ), pcBit, &u8Bits ) )
+    {
+      Fail( "Unknown opcode", pcBit );
+    }
+    psInstr->u8Opcode |= u8Bits;
+    if( psInstr->acOpcode[ 0 ] )
+    {
+      strcat( psInstr->acOpcode, " | " );
+    }
+    strncat( psInstr->acOpcode, pcBit, sizeof( psInstr->acOpcode ) - strlen( psInstr->acOpcode ) - 1u );
+  }
+  if( 0 == psInstr->acOpcode[ 0 ] )
+  {
+    Fail( "Missing opcode", NULL );
+  }
+  if( 0u == psInstr->u8Opcode )
+  {
+    strcpy( psInstr->acOpcode, "LOAD" );  // LOAD is the absence of the other bits
+  }
+
+  // Opcode combinations the virtual machine cannot run
+  u8Bits = psInstr->u8Opcode & (U8)~REPEAT;
+  if( CONTROL == ( CONTROL & psInstr->u8Opcode ) )
+  {
+    if( ( JUMP != psInstr->u8Opcode ) && ( LOOP != psInstr->u8Opcode ) && ( CALL != psInstr->u8Opcode ) && ( END != psInstr->u8Opcode )
+     && ( PALETTE != psInstr->u8Opcode ) )
+    {
+      Fail( "JUMP, LOOP, CALL, END and PALETTE can't be combined with other opcodes", psInstr->acOpcode );
+    }
+    if( u8Table || ( TARGET_STC == eTarget ) )
+    {
+      Fail( "JUMP, LOOP, CALL, END and PALETTE are for the normal LEDs of the PY32 firmware only", psInstr->acOpcode );
+    }
+    u8Bits = CONTROL;  // no LED is changed, so the rest of the checks don't apply
+  }
+  else
+  {
+    if( 0u == psInstr->u16TimingMs )
+    {
+      Fail( "Timing must be 1..65535 ms", NULL );
+    }
+    if( ( ( u8Bits & GENERATE ) == GENERATE ) && ( u8Bits != GENERATE ) )
+    {
+      Fail( "GENERATE can't be combined with other opcodes", psInstr->acOpcode );
+    }
+    if( ( LERP & u8Bits ) && ( LERP != psInstr->u8Opcode ) && ( 0u == ( ADD & u8Bits ) ) )
+    {
+      Fail( "LERP can't be combined with other opcodes, use SATADD for a saturating ADD", psInstr->acOpcode );
+    }
+    if( ( GENERATE == u8Bits ) && ( REPEAT & psInstr->u8Opcode ) )
+    {
+      Fail( "GENERATE can't be repeated", psInstr->acOpcode );
+    }
+    if( u8Table && ( GENERATE == u8Bits ) )
+    {
+      Fail( "GENERATE is for the normal LEDs only", NULL );
+    }
+    if( u8Table && ( ( u8Bits & HSV ) == HSV ) && ( HSV != psInstr->u8Opcode ) )
+    {
+      Fail( "HSV can't be combined with other opcodes", psInstr->acOpcode );
+    }
+    if( !u8Table && ( NULL != strstr( psInstr->acOpcode, "HSV" ) ) )
+    {
+      Fail( "HSV is for the RGB LED only", NULL );
+    }
+    if( u8Table && ( HSV != u8Bits ) && ( u8Bits & ( RSHIFT | LSHIFT | USOURCE | DSOURCE ) ) )
+    {
+      Fail( "The RGB LED supports LOAD, ADD, SATADD, DIV, LERP, HSV and REPEAT only", psInstr->acOpcode );
+    }
+    if( ( TARGET_STC == eTarget ) && ( ( u8Bits & LERP ) || ( GENERATE == u8Bits ) || ( u8Table && ( HSV == u8Bits ) ) ) )
+    {
+      Fail( "The STC8 firmware has no LERP, SATADD, GENERATE or HSV", psInstr->acOpcode );
+    }
+  }
+
+  // Operand
+  pcToken = strtok( NULL, pcDelimiters );
+  if( GENERATE == u8Bits )
+  {
+    if( ( NULL == pcToken ) || !LookupName( gcasGeneratorNames, sizeof( gcasGeneratorNames )/sizeof( gcasGeneratorNames[ 0 ] ), pcToken, &u8Generator ) )
+    {
+      Fail( "GENERATE needs a generator: GEN_SPARKLE, GEN_FADE, GEN_CHASE_CW or GEN_CHASE_CCW", pcToken );
+    }
+    snprintf( psInstr->acOperand, sizeof( psInstr->acOperand ), "GENERATOR( %s, ", pcToken );
+    pcToken = strtok( NULL, pcDelimiters );
+    lValue = pcToken ? strtol( pcToken, &pcEnd, 0 ) : -1;
+    if( ( NULL == pcToken ) || ( lValue < GENERATOR_STEP_UNIT ) || ( lValue > 63 * GENERATOR_STEP_UNIT ) || ( 0 != lValue % GENERATOR_STEP_UNIT ) )
+    {
+      Fail( "The generator step must be 4..252 ms, in 4 ms units", pcToken );
+    }
+    psInstr->u8Operand = GENERATOR( u8Generator, (U8)lValue );
+    snprintf( psInstr->acOperand + strlen( psInstr->acOperand ), sizeof( psInstr->acOperand ) - strlen( psInstr->acOperand ), "%ldu )", lValue );
+  }
+  else if( ( LERP == u8Bits ) && ( NULL != pcToken ) && isalpha( (unsigned char)*pcToken ) )
+  {
+    if( !LookupName( gcasEaseNames, sizeof( gcasEaseNames )/sizeof( gcasEaseNames[ 0 ] ), pcToken, &psInstr->u8Operand ) )
+    {
+      Fail( "LERP takes an easing curve: EASE_LINEAR, EASE_IN, EASE_OUT or EASE_SINE", pcToken );
+    }
+    snprintf( psInstr->acOperand, sizeof( psInstr->acOperand ), "%s", pcToken );
+  }
+  else
+  {
+    lValue = 0;
+    if( NULL != pcToken )
+    {
+      lValue = strtol( pcToken, &pcEnd, 0 );
+      if( ( '\0' != *pcEnd && 'u' != *pcEnd ) || ( lValue < 0 ) || ( lValue > 255 ) )
+      {
+        Fail( "Operand must be 0..255", pcToken );
+      }
+    }
+    if( ( REPEAT & psInstr->u8Opcode ) && ( 0 == lValue ) )
+    {
+      Fail( "REPEAT needs a repetition count", NULL );
+    }
+    psInstr->u8Operand = (U8)lValue;
+    snprintf( psInstr->acOperand, sizeof( psInstr->acOperand ), "%ldu", lValue );
+  }
+  if( NULL != strtok( NULL, pcDelimiters ) )
+  {
+    Fail( "Unexpected text after the operand", NULL );
+  }
+
+  psAnim->au8Length[ u8Table ]++;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Parses the description file
+//! \param  psFile: the description
+//! \param  eTarget: target of the tables
+//! \return -
+//! \global gasAnimC[], gu8AnimCCount, gu32LineNumber
+//! \note   Format, one item per line, '#' starts a comment:
+//!           animation <Name> [description]   starts an animation, its tables are gas<Name> and gas<Name>RGB
+//!           normal / rgb [options]           starts the instructions of the normal LEDs or of the RGB LED
+//!           <ms> <values> <OPCODE[|OPCODE]> [operand]   one instruction; GENERATE takes <GEN_xxx> <step ms>,
+//!                                                       LERP an optional EASE_xxx
+//-----------------------------------------------------------------------------
+static void ParseFile( FILE* psFile, E_ANIMC_TARGET eTarget )
+{
+  char  acLine[ MAX_LINE ];
+  char  acWord[ MAX_LINE ];
+  char* pcText;
+  char* pcComment;
+  U8    u8Table = 0xFFu;
+  U8    u8Index;
+  U8    u8Instr;
+  U8    u8Value;
+  int   iLength;
+  S_ANIMC_ANIMATION* psAnim = NULL;
+  const I16* pi16Values;
+
+  gu32LineNumber = 0u;
+  while( NULL != fgets( acLine, sizeof( acLine ), psFile ) )
+  {
+    gu32LineNumber++;
+    pcComment = strchr( acLine, '#' );
+    if( NULL != pcComment )
+    {
+      *pcComment = '\0';
+    }
+    for( pcText = acLine; isspace( (unsigned char)*pcText ); pcText++ );
+    if( '\0' == *pcText )
+    {
+      continue;
+    }
+    iLength = 0;
+    sscanf( pcText, "%511s%n", acWord, &iLength );
+
+    if( 0 == strcmp( acWord, "animation" ) )
+    {
+      if( gu8AnimCCount >= MAX_ANIMATIONS )
+      {
+        Fail( "Too many animations", NULL );
+      }
+      psAnim = &gasAnimC[ gu8AnimCCount++ ];
+      memset( psAnim->au8Length, 0, sizeof( psAnim->au8Length ) );
+      psAnim->u8Options = 0u;
+      psAnim->bBranches = FALSE;
+      psAnim->u8NewFrames = 0u;
+      psAnim->u8NewPaletteFrames = 0u;
+      pcText += iLength;
+      if( ( 1 != sscanf( pcText, "%47s%n", psAnim->acName, &iLength ) ) || !( isalpha( (unsigned char)psAnim->acName[ 0 ] ) || '_' == psAnim->acName[ 0 ] ) )
+      {
+        Fail( "Animation needs a name", NULL );
+      }
+      for( u8Index = 0u; psAnim->acName[ u8Index ]; u8Index++ )
+      {
+        if( !isalnum( (unsigned char)psAnim->acName[ u8Index ] ) && ( '_' != psAnim->acName[ u8Index ] ) )
+        {
+          Fail( "Name must be a C identifier", psAnim->acName );
+        }
+      }
+      for( pcText += iLength; isspace( (unsigned char)*pcText ); pcText++ );
+      snprintf( psAnim->acDescription, sizeof( psAnim->acDescription ), "%s", *pcText ? pcText : psAnim->acName );
+      psAnim->acDescription[ strcspn( psAnim->acDescription, "\r\n" ) ] = '\0';
+      u8Table = 0xFFu;
+    }
+    else if( ( 0 == strcmp( acWord, "normal" ) ) || ( 0 == strcmp( acWord, "rgb" ) ) )
+    {
+      if( NULL == psAnim )
+      {
+        Fail( "Table outside of an animation", acWord );
+      }
+      u8Table = ( 'r' == acWord[ 0 ] ) ? 1u : 0u;
+      pcText += iLength;
+      while( 1 == sscanf( pcText, "%511s%n", acWord, &iLength ) )
+      {
+        pcText += iLength;
+        if( ( 1u == u8Table ) && ( 0 == strcmp( acWord, "loop" ) ) )
+        {
+          psAnim->u8Options |= LOOP_RGB;
+        }
+        else if( ( 0u == u8Table ) && ( 0 == strcmp( acWord, "mirror" ) ) )
+        {
+          if( TARGET_STC == eTarget )
+          {
+            Fail( "The STC8 firmware has no mirrored tables", acWord );
+          }
+          psAnim->u8Options |= MIRROR;
+        }
+        else if( ( 0u == u8Table ) && ( 0 == strcmp( acWord, "frames" ) ) )
+        {
+          if( TARGET_STC == eTarget )
+          {
+            Fail( "The STC8 firmware has no frame dictionary", acWord );
+          }
+          psAnim->u8Options |= FRAMES;
+        }
+        else if( ( 0u == u8Table ) && ( 0 == strcmp( acWord, "branches" ) ) )
+        {
+          psAnim->bBranches = TRUE;
+        }
+        else
+        {
+          Fail( "Unknown table option", acWord );
+        }
+      }
+    }
+    else if( isdigit( (unsigned char)acWord[ 0 ] ) )
+    {
+      if( 0xFFu == u8Table )
+      {
+        Fail( "Instruction outside of a normal or rgb table", NULL );
+      }
+      ParseInstruction( psAnim, u8Table, pcText, eTarget );
+    }
+    else
+    {
+      Fail( "Unknown keyword", acWord );
+    }
+  }
+
+  // Checks of the complete animations
+  for( u8Index = 0u; u8Index < gu8AnimCCount; u8Index++ )
+  {
+    psAnim = &gasAnimC[ u8Index ];
+    for( u8Table = 0u; u8Table < 2u; u8Table++ )
+    {
+      if( 0u == psAnim->au8Length[ u8Table ] )
+      {
+        fprintf( stderr, "%s: %s has no %s instructions\n", gpcFileName, psAnim->acName, gcapcTableName[ u8Table ] );
+        exit( 1 );
+      }
+      if( TablePeriodMs( psAnim, u8Table ) > 0xFFFFu )
+      {
+        fprintf( stderr, "%s: %s %s table is longer than 65535 ms, the timer of the virtual machine is 16-bit\n", gpcFileName, psAnim->acName, gcapcTableName[ u8Table ] );
+        exit( 1 );
+      }
+    }
+    // A mirrored table stores the left side only
+    for( u8Instr = 0u; ( MIRROR & psAnim->u8Options ) && ( u8Instr < psAnim->au8Length[ 0 ] ); u8Instr++ )
+    {
+      pi16Values = psAnim->asInstr[ 0 ][ u8Instr ].ai16Value;
+      for( u8Value = 0u; u8Value < RIGHT_LEDS_START; u8Value++ )
+      {
+        if( pi16Values[ u8Value ] != pi16Values[ LEDS_NUM - 1u - u8Value ] )
+        {
+          fprintf( stderr, "%s: %s normal instruction %u is not mirrored\n", gpcFileName, psAnim->acName, u8Instr );
+          exit( 1 );
+        }
+      }
+    }
+  }
+  if( 0u == gu8AnimCCount )
+  {
+    fprintf( stderr, "%s: no animation found\n", gpcFileName );
+    exit( 1 );
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Numbers the brightness arrays of the FRAMES tables by the rows of the dictionaries
+//! \param  -
+//! \return -
+//! \global gasAnimC[], gau8Frames[], gu16FrameCount, gau8PaletteFrames[], gu16PaletteFrameCount
+//! \note   The dictionaries start as gcau8Frames[] and gcau8PaletteFrames[] of the firmware, a row not found
+//!         in them is added to their end; the arrays are compared as stored, modulo 256. An array of the
+//!         levels of the palette only is a row of the palette, a quarter of the size. The palette is known
+//!         only in a straight table: it starts as gcau8DefaultPalette[], a PALETTE replaces it; with a
+//!         CALL, or with a PALETTE and a JUMP or LOOP, every array is a full row.
+//-----------------------------------------------------------------------------
+static void AssignFrames( void )
+{
+  S_ANIMC_ANIMATION* psAnim;
+  const S_ANIMC_INSTRUCTION* psInstr;
+  U8  au8Row[ LEDS_NUM ];
+  U8  au8PaletteRow[ PALETTE_ROW_BYTES ];
+  U8  au8Palette[ PALETTE_SIZE ];
+  U16 u16Frame;
+  U8  u8Index;
+  U8  u8Instr;
+  U8  u8Value;
+  U8  u8Entry;
+  BOOL bPalette;
+  BOOL bBranch;
+  BOOL bKnown;
+
+  memcpy( gau8Frames, gcau8Frames, sizeof( gcau8Frames ) );
+  gu16FrameCount = sizeof( gcau8Frames ) / sizeof( gcau8Frames[ 0 ] );
+  memcpy( gau8PaletteFrames, gcau8PaletteFrames, sizeof( gcau8PaletteFrames ) );
+  gu16PaletteFrameCount = sizeof( gcau8PaletteFrames ) / sizeof( gcau8PaletteFrames[ 0 ] );
+  for( u8Index = 0u; u8Index < gu8AnimCCount; u8Index++ )
+  {
+    psAnim = &gasAnimC[ u8Index ];
+    bPalette = FALSE;
+    bBranch = FALSE;
+    bKnown = TRUE;
+    for( u8Instr = 0u; u8Instr < psAnim->au8Length[ 0 ]; u8Instr++ )
+    {
+      psInstr = &psAnim->asInstr[ 0 ][ u8Instr ];
+      bPalette |= ( PALETTE == psInstr->u8Opcode );
+      bBranch |= ( JUMP == psInstr->u8Opcode ) || ( LOOP == psInstr->u8Opcode );
+      bKnown &= ( CALL != psInstr->u8Opcode );
+    }
+    bKnown &= !( bPalette && bBranch );
+    memcpy( au8Palette, gcau8DefaultPalette, PALETTE_SIZE );
+    for( u8Instr = 0u; ( FRAMES & psAnim->u8Options ) && ( u8Instr < psAnim->au8Length[ 0 ] ); u8Instr++ )
+    {
+      psInstr = &psAnim->asInstr[ 0 ][ u8Instr ];
+      for( u8Value = 0u; u8Value < LEDS_NUM; u8Value++ )
+      {
+        au8Row[ u8Value ] = (U8)psInstr->ai16Value[ u8Value ];
+      }
+
+      // A row of the palette, if every level is in it
+      memset( au8PaletteRow, 0, sizeof( au8PaletteRow ) );
+      for( u8Value = 0u; bKnown && ( CONTROL != ( CONTROL & psInstr->u8Opcode ) ) && ( u8Value < LEDS_NUM ); u8Value++ )
+      {
+        for( u8Entry = 0u; ( u8Entry < PALETTE_SIZE ) && ( au8Palette[ u8Entry ] != au8Row[ u8Value ] ); u8Entry++ );
+        if( PALETTE_SIZE == u8Entry )
+        {
+          break;
+        }
+        au8PaletteRow[ u8Value >> 2u ] |= (U8)( u8Entry << ( ( u8Value & 3u ) << 1u ) );
+      }
+      if( bKnown && ( CONTROL != ( CONTROL & psInstr->u8Opcode ) ) && ( LEDS_NUM == u8Value ) )
+      {
+        for( u16Frame = 0u; ( u16Frame < gu16PaletteFrameCount ) && ( 0 != memcmp( gau8PaletteFrames[ u16Frame ], au8PaletteRow, PALETTE_ROW_BYTES ) ); u16Frame++ );
+        if( u16Frame == gu16PaletteFrameCount )
+        {
+          if( MAX_PALETTE_FRAMES == gu16PaletteFrameCount )
+          {
+            fprintf( stderr, "%s: %s needs more than %u rows in gcau8PaletteFrames[]\n", gpcFileName, psAnim->acName, MAX_PALETTE_FRAMES );
+            exit( 1 );
+          }
+          memcpy( gau8PaletteFrames[ gu16PaletteFrameCount ], au8PaletteRow, PALETTE_ROW_BYTES );
+          gu16PaletteFrameCount++;
+          psAnim->u8NewPaletteFrames++;
+        }
+        psAnim->asInstr[ 0 ][ u8Instr ].u8Frame = (U8)( PALETTE_FRAME | u16Frame );
+        continue;
+      }
+
+      // A full row
+      for( u16Frame = 0u; ( u16Frame < gu16FrameCount ) && ( 0 != memcmp( gau8Frames[ u16Frame ], au8Row, LEDS_NUM ) ); u16Frame++ );
+      if( u16Frame == gu16FrameCount )
+      {
+        if( MAX_FRAMES == gu16FrameCount )
+        {
+          fprintf( stderr, "%s: %s needs more than %u rows in gcau8Frames[]\n", gpcFileName, psAnim->acName, MAX_FRAMES );
+          exit( 1 );
+        }
+        memcpy( gau8Frames[ gu16FrameCount ], au8Row, LEDS_NUM );
+        gu16FrameCount++;
+        psAnim->u8NewFrames++;
+      }
+      psAnim->asInstr[ 0 ][ u8Instr ].u8Frame = (U8)u16Frame;
+      if( PALETTE == psInstr->u8Opcode )
+      {
+        memcpy( au8Palette, au8Row, PALETTE_SIZE );
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Picks the time units of the tables of an animation for the STC8, where a timing is a U8
+//! \param  psAnim: the animation
+//! \return -
+//! \note   The longest unit that divides every timing of the table, so the timings stay exact; it
+//!         stops with an error if no unit of 1..255 ms gives every timing in 255 units.
+//-----------------------------------------------------------------------------
+static void PickTimeUnits( S_ANIMC_ANIMATION* psAnim )
+{
+  U8  u8Table;
+  U8  u8Index;
+  U16 u16Common;
+  U16 u16Longest;
+  U16 u16Unit;
+  U16 u16A;
+  U16 u16B;
+
+  for( u8Table = 0u; u8Table < 2u; u8Table++ )
+  {
+    // Greatest common divisor and maximum of the timings
+    u16Common = 0u;
+    u16Longest = 0u;
+    for( u8Index = 0u; u8Index < psAnim->au8Length[ u8Table ]; u8Index++ )
+    {
+      u16A = psAnim->asInstr[ u8Table ][ u8Index ].u16TimingMs;
+      u16B = u16Common;
+      while( 0u != u16B )
+      {
+        u16Common = u16B;
+        u16B = u16A % u16B;
+        u16A = u16Common;
+      }
+      u16Common = u16A;
+      u16Longest = MAX( u16Longest, psAnim->asInstr[ u8Table ][ u8Index ].u16TimingMs );
+    }
+    // The longest of its divisors that fits
+    for( u16Unit = MIN( u16Common, STC_MAX_UNIT_MS ); u16Unit > 1u; u16Unit-- )
+    {
+      if( ( 0u == ( u16Common % u16Unit ) ) && ( ( u16Longest / u16Unit ) <= STC_MAX_UNIT_MS ) )
+      {
+        break;
+      }
+    }
+    if( ( u16Unit < 1u ) || ( ( u16Longest / u16Unit ) > STC_MAX_UNIT_MS ) )
+    {
+      Fail( "The timings of an STC8 table need a common unit of 1..255 ms, at most 255 units each", psAnim->acName );
+    }
+    psAnim->au8UnitMs[ u8Table ] = (U8)u16Unit;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Prints one instruction table in the layout of animation.c
+//! \param  psOut: output file
+//! \param  psAnim: the animation
+//! \param  u8Table: 0 for the normal LEDs, 1 for the RGB LED
+//! \param  eTarget: target of the tables; the STC8 timings are in the units of the table, the arrays packed
+//! \return -
+//-----------------------------------------------------------------------------
+static void PrintTable( FILE* psOut, const S_ANIMC_ANIMATION* psAnim, U8 u8Table, E_ANIMC_TARGET eTarget )
+{
+  const S_ANIMC_INSTRUCTION* psInstr;
+  BOOL bMirror = !u8Table && ( MIRROR & psAnim->u8Options );
+  BOOL bFrames = !u8Table && ( FRAMES & psAnim->u8Options );
+  U8  u8Values = u8Table ? NUM_RGBLED_COLORS : ( bMirror ? RIGHT_LEDS_START : LEDS_NUM );
+  U8  u8Index;
+  U8  u8Value;
+  int iTimingWidth = 1;
+  int iOpcodeWidth = 1;
+  int iOperandWidth = 1;
+  int iFrameWidth = 0;
+  char acTiming[ 8u ];
+  U16 u16Unit = ( TARGET_STC == eTarget ) ? psAnim->au8UnitMs[ u8Table ] : 1u;
+  char acSteps[ 32u ] = "";
+
+  for( u8Index = 0u; u8Index < psAnim->au8Length[ u8Table ]; u8Index++ )
+  {
+    psInstr = &psAnim->asInstr[ u8Table ][ u8Index ];
+    iTimingWidth = MAX( iTimingWidth, snprintf( acTiming, sizeof( acTiming ), "%u", psInstr->u16TimingMs / u16Unit ) );
+    iOpcodeWidth = MAX( iOpcodeWidth, (int)strlen( psInstr->acOpcode ) + 1 );
+    iOperandWidth = MAX( iOperandWidth, (int)strlen( psInstr->acOperand ) );
+    if( bFrames && ( PALETTE_FRAME & psInstr->u8Frame ) )
+    {
+      iFrameWidth = (int)strlen( "PALETTE_FRAME | " );
+    }
+  }
+
+  if( TARGET_STC == eTarget )
+  {
+    snprintf( acSteps, sizeof( acSteps ), ", in steps of %u ms", u16Unit );
+  }
+  fprintf( psOut, "//! \\brief %s -- %s%s%s\n", psAnim->acDescription, gcapcTableDoc[ u8Table ],
+           bMirror ? ", the left side mirrored" : ( bFrames ? ", the arrays in gcau8Frames[]" : "" ), acSteps );
+  fprintf( psOut, "CODE const S_ANIMATION_INSTRUCTION_%s gas%s%s[ %uu ] =\n{\n", u8Table ? "RGB" : ( bMirror ? "HALF" : ( bFrames ? "FRAME" : "NORMAL" ) ),
+           psAnim->acName, u8Table ? "RGB" : "", psAnim->au8Length[ u8Table ] );
+  for( u8Index = 0u; u8Index < psAnim->au8Length[ u8Table ]; u8Index++ )
+  {
+    psInstr = &psAnim->asInstr[ u8Table ][ u8Index ];
+    fprintf( psOut, "  {%*uu, ", iTimingWidth, psInstr->u16TimingMs / u16Unit );
+    if( bFrames && ( PALETTE_FRAME & psInstr->u8Frame ) )
+    {
+      fprintf( psOut, "PALETTE_FRAME | %2uu", psInstr->u8Frame & (U8)~PALETTE_FRAME );
+    }
+    else if( bFrames )
+    {
+      fprintf( psOut, "%*s%2uu", iFrameWidth, "", psInstr->u8Frame );
+    }
+    else
+    {
+      fprintf( psOut, "%s", ( TARGET_STC != eTarget ) ? "{" : ( u8Table ? "PACK_RGB(" : "PACK_LEDS(" ) );
+      for( u8Value = 0u; u8Value < u8Values; u8Value++ )
+      {
+        fprintf( psOut, "%s%2d", u8Value ? ", " : "", psInstr->ai16Value[ u8Value ] );
+      }
+      fprintf( psOut, "%s", ( TARGET_STC != eTarget ) ? "}" : ")" );
+    }
+    fprintf( psOut, ", %s,%*s%*s },\n", psInstr->acOpcode, iOpcodeWidth - (int)strlen( psInstr->acOpcode ), "",
+             iOperandWidth, psInstr->acOperand );
+  }
+  fprintf( psOut, "};\n" );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Prints all the tables, and the rows to be added to gcau8Frames[], gcau8PaletteFrames[] and gasAnimations[]
+//! \param  psOut: output file
+//! \param  eTarget: target of the tables; the PY32 rows have the layers before the options, and the profile after them
+//! \return -
+//! \global gasAnimC[], gu8AnimCCount
+//! \note   Should be called after AssignFrames(), and after Report() of every animation for the profiles.
+//-----------------------------------------------------------------------------
+static void PrintAnimations( FILE* psOut, E_ANIMC_TARGET eTarget )
+{
+  U8 u8Index;
+  const S_ANIMC_ANIMATION* psAnim;
+  const char* pcNormalType;
+  const char* pcCast;
+  const char* pcOptions;
+  char acOptions[ MAX_OPERAND_TEXT + MAX_NAME + 16u ];  // the options, the layers and the profile reference
+  U16 u16Frame;
+  U8  u8Value;
+
+  fprintf( psOut, "// Generated by animc from %s\n", gpcFileName );
+  if( gu16FrameCount > sizeof( gcau8Frames ) / sizeof( gcau8Frames[ 0 ] ) )
+  {
+    fprintf( psOut, "\n// Rows to be added to the end of gcau8Frames[], it has %u then\n", gu16FrameCount );
+    for( u16Frame = sizeof( gcau8Frames ) / sizeof( gcau8Frames[ 0 ] ); u16Frame < gu16FrameCount; u16Frame++ )
+    {
+      fprintf( psOut, "  {" );
+      for( u8Value = 0u; u8Value < LEDS_NUM; u8Value++ )
+      {
+        fprintf( psOut, "%s%2d", u8Value ? ", " : "", (I8)gau8Frames[ u16Frame ][ u8Value ] );
+      }
+      fprintf( psOut, "},  // %2u\n", u16Frame );
+    }
+  }
+  if( gu16PaletteFrameCount > sizeof( gcau8PaletteFrames ) / sizeof( gcau8PaletteFrames[ 0 ] ) )
+  {
+    fprintf( psOut, "\n// Rows to be added to the end of gcau8PaletteFrames[], it has %u then\n", gu16PaletteFrameCount );
+    for( u16Frame = sizeof( gcau8PaletteFrames ) / sizeof( gcau8PaletteFrames[ 0 ] ); u16Frame < gu16PaletteFrameCount; u16Frame++ )
+    {
+      fprintf( psOut, "  {" );
+      for( u8Value = 0u; u8Value < PALETTE_ROW_BYTES; u8Value++ )
+      {
+        fprintf( psOut, "%s0x%02Xu", u8Value ? ", " : "", gau8PaletteFrames[ u16Frame ][ u8Value ] );
+      }
+      fprintf( psOut, "},  // %2u:", u16Frame );
+      for( u8Value = 0u; u8Value < LEDS_NUM; u8Value++ )
+      {
+        fprintf( psOut, " %u", ( gau8PaletteFrames[ u16Frame ][ u8Value >> 2u ] >> ( ( u8Value & 3u ) << 1u ) ) & 3u );
+      }
+      fprintf( psOut, "\n" );
+    }
+  }
+  for( u8Index = 0u; u8Index < gu8AnimCCount; u8Index++ )
+  {
+    fprintf( psOut, "\n//--------------------------------------------------------\n" );
+    PrintTable( psOut, &gasAnimC[ u8Index ], 0u, eTarget );
+    PrintTable( psOut, &gasAnimC[ u8Index ], 1u, eTarget );
+    if( TARGET_PY32 == eTarget )
+    {
+      psAnim = &gasAnimC[ u8Index ];
+      fprintf( psOut, "\n//! \\brief %s -- profile, for the drivers\n", psAnim->acDescription );
+      fprintf( psOut, "CODE const S_ANIMATION_PROFILE gs%sProfile = { 0x%04Xu, %uu, %uu, %s };\n", psAnim->acName,
+               psAnim->sProfile.u16Levels, psAnim->sProfile.u16MinStepMs, psAnim->sProfile.u8PeakLoad,
+               ( PROFILE_RGB & psAnim->sProfile.u8Flags ) ? "PROFILE_RGB" : "0u" );
+    }
+  }
+  fprintf( psOut, "\n// Rows of gasAnimations[]\n" );
+  for( u8Index = 0u; u8Index < gu8AnimCCount; u8Index++ )
+  {
+    psAnim = &gasAnimC[ u8Index ];
+    pcNormalType = "NORMAL";
+    pcCast = "";
+    if( MIRROR & psAnim->u8Options )
+    {
+      pcNormalType = "HALF";
+      pcCast = "(const S_ANIMATION_INSTRUCTION_NORMAL CODE*)";
+    }
+    else if( FRAMES & psAnim->u8Options )
+    {
+      pcNormalType = "FRAME";
+      pcCast = "(const S_ANIMATION_INSTRUCTION_NORMAL CODE*)";
+    }
+    pcOptions = acOptions;
+    if( TARGET_STC == eTarget )
+    {
+      pcOptions = ( 0u == psAnim->u8Options ) ? "" : ", LOOP_RGB";
+    }
+    else
+    {
+      snprintf( acOptions, sizeof( acOptions ), ", 0u, NULL, %s%s%s%s, &gs%sProfile, NULL", ( LOOP_RGB & psAnim->u8Options ) ? "LOOP_RGB" : "",
+                ( ( LOOP_RGB & psAnim->u8Options ) && ( LOOP_RGB != psAnim->u8Options ) ) ? " | " : "",
+                ( MIRROR & psAnim->u8Options ) ? "MIRROR" : ( ( FRAMES & psAnim->u8Options ) ? "FRAMES" : "" ),
+                ( 0u == psAnim->u8Options ) ? "0u" : "", psAnim->acName );
+    }
+    if( TARGET_STC == eTarget )
+    {
+      fprintf( psOut, "  {sizeof(gas%s)/sizeof(S_ANIMATION_INSTRUCTION_%s), gas%s, %3uu, sizeof(gas%sRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB), gas%sRGB, %3uu%s },\n",
+               psAnim->acName, pcNormalType, psAnim->acName, psAnim->au8UnitMs[ 0u ], psAnim->acName, psAnim->acName, psAnim->au8UnitMs[ 1u ], pcOptions );
+    }
+    else
+    {
+      fprintf( psOut, "  {sizeof(gas%s)/sizeof(S_ANIMATION_INSTRUCTION_%s), %sgas%s, sizeof(gas%sRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB), gas%sRGB%s },\n",
+               psAnim->acName, pcNormalType, pcCast, psAnim->acName, psAnim->acName, psAnim->acName, pcOptions );
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Length of one round of a table
+//! \param  psAnim: the animation
+//! \param  u8Table: 0 for the normal LEDs, 1 for the RGB LED
+//! \return Sum of the instruction timings, the LOOP blocks taken as many times as they run, in ms
+//! \note   A CALL is taken as nothing, and a JUMP as the end of the round, where the timer starts over.
+//-----------------------------------------------------------------------------
+static U32 TablePeriodMs( const S_ANIMC_ANIMATION* psAnim, U8 u8Table )
+{
+  U32 u32Period = 0u;
+  U32 au32Passes[ ANIMATION_STACK_DEPTH + 1u ] = { 1u };
+  U8  u8Depth = 0u;
+  U8  u8Index;
+  const S_ANIMC_INSTRUCTION* psInstr;
+
+  for( u8Index = 0u; u8Index < psAnim->au8Length[ u8Table ]; u8Index++ )
+  {
+    psInstr = &psAnim->asInstr[ u8Table ][ u8Index ];
+    if( JUMP == psInstr->u8Opcode )
+    {
+      break;
+    }
+    else if( ( LOOP == psInstr->u8Opcode ) && ( u8Depth < ANIMATION_STACK_DEPTH ) )
+    {
+      u8Depth++;
+      au32Passes[ u8Depth ] = au32Passes[ u8Depth - 1u ] * psInstr->u8Operand;
+    }
+    else if( ( END == psInstr->u8Opcode ) && ( 0u != u8Depth ) )
+    {
+      u8Depth--;
+    }
+    else if( CONTROL != ( CONTROL & psInstr->u8Opcode ) )
+    {
+      u32Period += au32Passes[ u8Depth ] * psInstr->u16TimingMs;
+    }
+  }
+  return u32Period;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Firmware tables from the parsed instructions
+//! \param  psAnim: the animation
+//! \param  psNormal: the normal LED table is written here
+//! \param  psRGB: the RGB LED table is written here
+//! \return -
+//-----------------------------------------------------------------------------
+static void BuildTables( const S_ANIMC_ANIMATION* psAnim, S_ANIMATION_INSTRUCTION_NORMAL* psNormal, S_ANIMATION_INSTRUCTION_RGB* psRGB )
+{
+  U8  u8Index;
+  U8  u8Value;
+
+  for( u8Index = 0u; u8Index < psAnim->au8Length[ 0 ]; u8Index++ )
+  {
+    psNormal[ u8Index ].u16TimingMs = psAnim->asInstr[ 0 ][ u8Index ].u16TimingMs;
+    for( u8Value = 0u; u8Value < LEDS_NUM; u8Value++ )
+    {
+      psNormal[ u8Index ].au8LEDBrightness[ u8Value ] = (U8)psAnim->asInstr[ 0 ][ u8Index ].ai16Value[ u8Value ];
+    }
+    psNormal[ u8Index ].u8AnimationOpcode = psAnim->asInstr[ 0 ][ u8Index ].u8Opcode;
+    psNormal[ u8Index ].u8AnimationOperand = psAnim->asInstr[ 0 ][ u8Index ].u8Operand;
+  }
+  for( u8Index = 0u; u8Index < psAnim->au8Length[ 1 ]; u8Index++ )
+  {
+    psRGB[ u8Index ].u16TimingMs = psAnim->asInstr[ 1 ][ u8Index ].u16TimingMs;
+    for( u8Value = 0u; u8Value < NUM_RGBLED_COLORS; u8Value++ )
+    {
+      psRGB[ u8Index ].au8RGBLEDBrightness[ u8Value ] = (U8)psAnim->asInstr[ 1 ][ u8Index ].ai16Value[ u8Value ];
+    }
+    psRGB[ u8Index ].u8AnimationOpcode = psAnim->asInstr[ 1 ][ u8Index ].u8Opcode;
+    psRGB[ u8Index ].u8AnimationOperand = psAnim->asInstr[ 1 ][ u8Index ].u8Operand;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Writes the upload image of an animation, see upload.c
+//! \param  psOut: output file, opened in binary mode
+//! \param  psAnim: the animation
+//! \param  pcTrims: the trims of the LEDs, comma separated; NULL: none
+//! \return -
+//! \note   The layout of the instructions is the same on the host as on the Cortex-M0+, both are
+//!         little endian and there are no pointers in them.
+//-----------------------------------------------------------------------------
+static void WriteImage( FILE* psOut, const S_ANIMC_ANIMATION* psAnim, const char* pcTrims )
+{
+  static U8 au8Image[ PERSIST_UPLOAD_SIZE ];
+  S_UPLOAD_HEADER* psHeader = (S_UPLOAD_HEADER*)au8Image;
+  U8* pu8Body = &au8Image[ sizeof( S_UPLOAD_HEADER ) ];
+  U8* pu8Instructions = pu8Body;
+  char* pcEnd;
+  U32 u32Size;
+  U32 u32Trim;
+  U16 u16Offset;
+  U8  u8Part;
+  U8  u8Trims = 0u;
+
+  if( NULL != pcTrims )
+  {
+    for( u8Trims = 0u; u8Trims < LEDS_NUM; u8Trims++ )
+    {
+      u32Trim = strtoul( pcTrims, &pcEnd, 0 );
+      if( ( pcEnd == pcTrims ) || ( u32Trim > 255u ) || ( ( ',' != *pcEnd ) && ( u8Trims < LEDS_NUM - 1u ) ) )
+      {
+        Fail( "-g needs LEDS_NUM comma separated trims of 0..255", pcTrims );
+      }
+      pu8Body[ u8Trims ] = (U8)u32Trim;
+      pcTrims = pcEnd + 1;
+    }
+    if( '\0' != *pcEnd )
+    {
+      Fail( "-g needs LEDS_NUM comma separated trims of 0..255", pcEnd );
+    }
+    pu8Instructions = &pu8Body[ LEDS_NUM ];
+  }
+  u32Size = u8Trims
+          + psAnim->au8Length[ 0 ] * sizeof( S_ANIMATION_INSTRUCTION_NORMAL )
+          + psAnim->au8Length[ 1 ] * sizeof( S_ANIMATION_INSTRUCTION_RGB );
+  if( u32Size > sizeof( au8Image ) - sizeof( S_UPLOAD_HEADER ) )
+  {
+    Fail( "too big for the upload area", psAnim->acName );
+  }
+  if( 0u == psAnim->au8Length[ 0 ] )
+  {
+    Fail( "no normal LED instructions to upload", psAnim->acName );
+  }
+  BuildTables( psAnim, (S_ANIMATION_INSTRUCTION_NORMAL*)pu8Instructions,
+               (S_ANIMATION_INSTRUCTION_RGB*)&pu8Instructions[ psAnim->au8Length[ 0 ] * sizeof( S_ANIMATION_INSTRUCTION_NORMAL ) ] );
+  psHeader->u16Magic = UPLOAD_MAGIC;
+  psHeader->u16MagicInv = (U16)~UPLOAD_MAGIC;
+  psHeader->u16BodySize = (U16)u32Size;
+  psHeader->u8LengthNormal = psAnim->au8Length[ 0 ];
+  psHeader->u8LengthRGB = psAnim->au8Length[ 1 ];
+  psHeader->u8Options = psAnim->u8Options & (U8)~( MIRROR | FRAMES );  // the image has the normal instructions in full
+  psHeader->u8Trims = u8Trims;
+  // Chained in parts, any split gives the same CRC as ImageCRC() of upload.c
+  psHeader->u16CRC = Util_CRC16( (U8*)&psHeader->u16BodySize, sizeof( S_UPLOAD_HEADER ) - offsetof( S_UPLOAD_HEADER, u16BodySize ) );
+  for( u16Offset = 0u; u16Offset < u32Size; u16Offset += u8Part )
+  {
+    u8Part = (U8)MIN( u32Size - u16Offset, 255u );
+    psHeader->u16CRC = Util_CRC16Continue( psHeader->u16CRC, &pu8Body[ u16Offset ], u8Part );
+  }
+  fwrite( au8Image, 1u, sizeof( S_UPLOAD_HEADER ) + u32Size, psOut );
+  fprintf( stderr, "%s: %lu bytes of upload image\n", psAnim->acName, (unsigned long)( sizeof( S_UPLOAD_HEADER ) + u32Size ) );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Plays an animation on the virtual machine and the LED driver, and reports its costs and its profile
+//! \param  psAnim: the animation, its profile is filled in
+//! \param  eTarget: target of the tables
+//! \param  u32LedMa: current of one lit LED, in mA
+//! \param  u32LengthMs: simulated time; 0 for a few rounds of the longer table
+//! \return -
+//! \note   The flash size is exact. The step time is the host's, compare animations with it, the
+//!         target cycles come from the UTIL_PROFILING build. The current counts the normal LEDs only;
+//!         each of them is lit at most half of the time, because of the multiplexing.
+//!         The levels and the peak load of the profile are of the time simulated only.
+//-----------------------------------------------------------------------------
+static void Report( S_ANIMC_ANIMATION* psAnim, E_ANIMC_TARGET eTarget, U32 u32LedMa, U32 u32LengthMs )
+{
+  static S_ANIMATION_INSTRUCTION_NORMAL asNormal[ MAX_INSTRUCTIONS ];
+  static S_ANIMATION_INSTRUCTION_RGB asRGB[ MAX_INSTRUCTIONS ];
+  S_ANIMATION sAnimation;
+  U8  au8Previous[ LEDS_NUM + NUM_RGBLED_COLORS ];
+  U8  au8Now[ LEDS_NUM + NUM_RGBLED_COLORS ];
+  U8  u8Value;
+  U8  u8Table;
+  U8  u8PeakLoad;
+  U32 u32TimeMs;
+  U32 u32Updates = 0u;
+  U32 u32Flash;
+  uint64_t u64Start;
+  uint64_t u64Ns;
+  uint64_t u64TotalNs = 0u;
+  uint64_t u64MaxNs = 0u;
+  uint64_t u64LoadSum = 0u;
+  double dLoad;
+
+  BuildTables( psAnim, asNormal, asRGB );
+  sAnimation.u8AnimationLengthNormal = psAnim->au8Length[ 0 ];
+  sAnimation.psInstructionsNormal = asNormal;
+  sAnimation.u8AnimationLengthRGB = psAnim->au8Length[ 1 ];
+  sAnimation.psInstructionsRGB = asRGB;
+  sAnimation.u8NumLayers = 0u;
+  sAnimation.psLayers = NULL;
+  sAnimation.u8Options = psAnim->u8Options & (U8)~( MIRROR | FRAMES );  // played from the full tables
+  sAnimation.psProfile = NULL;
+  sAnimation.pfNative = NULL;
+  // The shortest step is of the tables; the rest of the profile is measured while played
+  memset( &psAnim->sProfile, 0, sizeof( psAnim->sProfile ) );
+  psAnim->sProfile.u16MinStepMs = 0xFFFFu;
+  for( u8Table = 0u; u8Table < 2u; u8Table++ )
+  {
+    for( u8Value = 0u; u8Value < psAnim->au8Length[ u8Table ]; u8Value++ )
+    {
+      if( 0u != psAnim->asInstr[ u8Table ][ u8Value ].u16TimingMs )
+      {
+        psAnim->sProfile.u16MinStepMs = MIN( psAnim->sProfile.u16MinStepMs, psAnim->asInstr[ u8Table ][ u8Value ].u16TimingMs );
+      }
+    }
+  }
+
+  if( 0u == u32LengthMs )
+  {
+    u32LengthMs = SIM_PERIODS * MAX( TablePeriodMs( psAnim, 0u ), TablePeriodMs( psAnim, 1u ) );
+    u32LengthMs = MIN( MAX( u32LengthMs, MIN_SIM_MS ), MAX_SIM_MS );
+  }
+
+  // Same order as the init block of main()
+  Util_Init();
+  LED_Init();
+  RGBLED_Init();
+  Animation_Init();
+  LED_SetBrightness( LED_DIM_FULL );
+  Play( &sAnimation );
+  memset( au8Previous, 0, sizeof( au8Previous ) );
+  for( u32TimeMs = 0u; u32TimeMs < u32LengthMs; u32TimeMs++ )
+  {
+    Util_Interrupt( SIM_TICKS_PER_MS );
+    u64Start = NowNs();
+    Animation_Cycle();
+    u64Ns = NowNs() - u64Start;
+    u64TotalNs += u64Ns;
+    u64MaxNs = MAX( u64MaxNs, u64Ns );
+    u64LoadSum += LED_GetLoad();
+    memcpy( au8Now, gau8LEDBrightness, LEDS_NUM );
+    u8PeakLoad = 0u;
+    for( u8Value = 0u; u8Value < LEDS_NUM; u8Value++ )
+    {
+      psAnim->sProfile.u16Levels |= (U16)1u << ( gau8LEDBrightness[ u8Value ] & LED_BRIGHTNESS_MAX );
+      u8PeakLoad += gau8LEDBrightness[ u8Value ] & LED_BRIGHTNESS_MAX;
+    }
+    psAnim->sProfile.u8PeakLoad = MAX( psAnim->sProfile.u8PeakLoad, u8PeakLoad );
+    for( u8Value = 0u; u8Value < NUM_RGBLED_COLORS; u8Value++ )
+    {
+      au8Now[ LEDS_NUM + u8Value ] = gau8RGBLEDs[ u8Value ];
+      if( 0u != gau8RGBLEDs[ u8Value ] )
+      {
+        psAnim->sProfile.u8Flags |= PROFILE_RGB;
+      }
+    }
+    if( 0 != memcmp( au8Now, au8Previous, sizeof( au8Now ) ) )
+    {
+      u32Updates++;
+      memcpy( au8Previous, au8Now, sizeof( au8Now ) );
+    }
+  }
+
+  if( TARGET_STC == eTarget )
+  {
+    u32Flash = psAnim->au8Length[ 0 ] * ( STC_INSTRUCTION_BYTES + LEDS_NUM )
+             + psAnim->au8Length[ 1 ] * ( STC_INSTRUCTION_BYTES + NUM_RGBLED_COLORS ) + STC_ANIMATION_BYTES;
+  }
+  else
+  {
+    // No pointers in the instructions, so their size is the same on the host as on the Cortex-M0+; the shared rows aren't counted
+    u32Flash = psAnim->au8Length[ 0 ] * ( ( MIRROR & psAnim->u8Options ) ? sizeof( S_ANIMATION_INSTRUCTION_HALF )
+                                        : ( ( FRAMES & psAnim->u8Options ) ? sizeof( S_ANIMATION_INSTRUCTION_FRAME ) : sizeof( S_ANIMATION_INSTRUCTION_NORMAL ) ) )
+             + psAnim->u8NewFrames * LEDS_NUM + psAnim->u8NewPaletteFrames * PALETTE_ROW_BYTES
+             + psAnim->au8Length[ 1 ] * sizeof( S_ANIMATION_INSTRUCTION_RGB ) + PY32_ANIMATION_BYTES + sizeof( S_ANIMATION_PROFILE );
+  }
+  dLoad = (double)u64LoadSum / ( (double)LED_LOAD_FULL * u32LengthMs );
+
+  fprintf( stderr, "%s: %u + %u instructions, rounds of %lu / %lu ms, %lu bytes of flash on %s\n",
+           psAnim->acName, psAnim->au8Length[ 0 ], psAnim->au8Length[ 1 ],
+           (unsigned long)TablePeriodMs( psAnim, 0u ), (unsigned long)TablePeriodMs( psAnim, 1u ),
+           (unsigned long)u32Flash, ( TARGET_STC == eTarget ) ? "STC8" : "PY32" );
+  fprintf( stderr, "  %lu ms played: %.1f LED updates/s, step %.0f ns average, %lu ns worst on the host\n",
+           (unsigned long)u32LengthMs, u32Updates * 1000.0 / u32LengthMs,
+           (double)u64TotalNs / u32LengthMs, (unsigned long)u64MaxNs );
+  fprintf( stderr, "  average load %.1f%%, LED current %.2f mA at %lu mA per lit LED\n",
+           dLoad * 100.0, dLoad * LEDS_NUM * u32LedMa / 2.0, (unsigned long)u32LedMa );
+  fprintf( stderr, "  profile: levels 0x%04X, shortest step %u ms, peak load %u of %u, RGB %s\n",
+           psAnim->sProfile.u16Levels, psAnim->sProfile.u16MinStepMs, psAnim->sProfile.u8PeakLoad,
+           LEDS_NUM * LED_BRIGHTNESS_MAX, ( PROFILE_RGB & psAnim->sProfile.u8Flags ) ? "lit" : "dark" );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Host time for measuring the animation step
+//! \param  -
+//! \return Monotonic time in ns
+//-----------------------------------------------------------------------------
+static uint64_t NowNs( void )
+{
+  struct timespec sTime;
+
+  clock_gettime( CLOCK_MONOTONIC, &sTime );
+  return (uint64_t)sTime.tv_sec * 1000000000uLL + (uint64_t)sTime.tv_nsec;
+}
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Compiler entry point
+//! \param  argc, argv: see the file header
+//! \return 0 on success
+//-----------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+  E_ANIMC_TARGET eTarget = TARGET_PY32;
+  U32   u32LedMa = DEFAULT_LED_MA;
+  U32   u32LengthMs = 0u;
+  FILE* psIn;
+  FILE* psOut = stdout;
+  FILE* psImage = NULL;
+  const char* pcTrims = NULL;
+  const char* pcMap = NULL;
+  int   iArg;
+  U8    u8Index;
+
+  for( iArg = 1; ( iArg < argc - 1 ) && ( '-' == argv[ iArg ][ 0 ] ); iArg += 2 )
+  {
+    switch( argv[ iArg ][ 1 ] )
+    {
+      case 't':
+        eTarget = ( 0 == strcmp( argv[ iArg + 1 ], "stc" ) ) ? TARGET_STC : TARGET_PY32;
+        break;
+      case 'm':
+        u32LedMa = strtoul( argv[ iArg + 1 ], NULL, 0 );
+        break;
+      case 'l':
+        u32LengthMs = MIN( strtoul( argv[ iArg + 1 ], NULL, 0 ), MAX_SIM_MS );
+        break;
+      case 'o':
+        psOut = fopen( argv[ iArg + 1 ], "w" );
+        if( NULL == psOut )
+        {
+          perror( argv[ iArg + 1 ] );
+          return 1;
+        }
+        break;
+      case 'b':
+        psImage = fopen( argv[ iArg + 1 ], "wb" );
+        if( NULL == psImage )
+        {
+          perror( argv[ iArg + 1 ] );
+          return 1;
+        }
+        break;
+      case 'g':
+        pcTrims = argv[ iArg + 1 ];
+        break;
+      case 'p':
+        pcMap = argv[ iArg + 1 ];
+        break;
+      default:
+        iArg = argc;
+        break;
+    }
+  }
+  if( iArg != argc - 1 )
+  {
+    fprintf( stderr, "Usage: %s [-t py32|stc] [-m mA per lit LED] [-l simulated ms] [-o output.c] [-b image.bin] [-g trims] [-p map.txt] <description.txt>\n", argv[ 0 ] );
+    return 1;
+  }
+
+  DefaultLedMap();
+  if( NULL != pcMap )
+  {
+    gpcFileName = pcMap;
+    psIn = fopen( gpcFileName, "r" );
+    if( NULL == psIn )
+    {
+      perror( gpcFileName );
+      return 1;
+    }
+    LoadLedMap( psIn );
+    fclose( psIn );
+  }
+
+  gpcFileName = argv[ iArg ];
+  psIn = fopen( gpcFileName, "r" );
+  if( NULL == psIn )
+  {
+    perror( gpcFileName );
+    return 1;
+  }
+  ParseFile( psIn, eTarget );
+  fclose( psIn );
+  if( TARGET_STC == eTarget )
+  {
+    for( u8Index = 0u; u8Index < gu8AnimCCount; u8Index++ )
+    {
+      PickTimeUnits( &gasAnimC[ u8Index ] );
+    }
+  }
+  if( NULL != psImage )
+  {
+    if( ( TARGET_PY32 != eTarget ) || ( 0u == gu8AnimCCount ) )
+    {
+      Fail( "the upload image needs a py32 animation", gpcFileName );
+    }
+    WriteImage( psImage, &gasAnimC[ 0u ], pcTrims );
+    fclose( psImage );
+  }
+
+  // The profiles are measured first, the rows carry them
+  AssignFrames();
+  for( u8Index = 0u; u8Index < gu8AnimCCount; u8Index++ )
+  {
+    Report( &gasAnimC[ u8Index ], eTarget, u32LedMa, u32LengthMs );
+  }
+  PrintAnimations( psOut, eTarget );
+  if( stdout != psOut )
+  {
+    fclose( psOut );
+  }
+
+  return 0;
+}
+
+/***************************************< End of file >**************************************/
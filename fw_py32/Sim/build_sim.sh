@@ -0,0 +1,21 @@
+#!/bin/sh
+# Builds the host simulator of the animations and the LED drivers, and the animation compiler
+# Usage: ./build_sim.sh [extra compiler flags, e.g. -DLED_DRIVER_MODE=0 or -DLED_PWM_BITS=6 -DSYSCLK_MHZ=24]
+#        (-DANIMATION_COMPILED=1 generates ../Src/animation_gen.inc first, by ../../tools/animgen.py)
+#        (-DUTIL_PROFILING=1 adds the cost counters of animation.c to the summary of a single animation)
+# Run:   ./karifa_sim <animation index> [length in ms] [frame length in ms, 0: summary only]
+#        ./karifa_sim all [length in ms] [mA per lit LED]   benchmark of every animation
+#        ./karifa_sim golden 60000 golden.txt                check of the VM against its golden timeline
+#        ./karifa_sim button                                 check of a click waking the unit up from a tickless sleep
+#        ./animc [-t py32|stc] [-m mA per lit LED] [-l simulated ms] [-o output.c] [-b image.bin] [-p map.txt] <description.txt>
+cd "$(dirname "$0")" || exit 1
+CFLAGS="-std=gnu99 -O2 -Wall -DSIM_HOST -include sim_hal.h -I. -I../Src -I../../common"
+case "$*" in
+  *ANIMATION_COMPILED=1*) ${PYTHON:-python3} ../../tools/animgen.py --source ../Src/animation.c || exit 1 ;;
+esac
+${CC:-cc} $CFLAGS "$@" \
+  sim_main.c ../Src/animation.c ../Src/button.c ../Src/led.c ../Src/rgbled.c ../Src/util.c ../Src/memmap.c \
+  -o karifa_sim || exit 1
+${CC:-cc} $CFLAGS "$@" \
+  animc.c ../Src/led.c ../Src/rgbled.c ../Src/util.c ../Src/memmap.c \
+  -o animc
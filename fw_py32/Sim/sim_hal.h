@@ -0,0 +1,272 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file sim_hal.h
+*
+* \brief Host replacement of main.h and the PY32 LL drivers, for the simulator
+*
+* \author Hekk_Elek
+*
+* \note  Force-included before every firmware source (-include), so Src/main.h is skipped by its
+*        include guard. Peripherals are plain structs: GPIO writes land in the simulated output
+*        registers and the inputs read IDR, the TIM1 compare values are just stored, everything else
+*        does nothing. __WFI() runs gpfSimWFI(), the interrupt that wakes it up, and the LPTIM has
+*        counted gu32SimLPTIMCount by then: the simulator sets both to play a wakeup from Util_Sleep().
+*        SysTick counts the host time in SYSCLK_MHZ cycles, so UTIL_PROFILING builds: its figures compare
+*        animations and opcodes with each other, they are not cycles of the M0+.
+*
+**********************************************************************************************************/
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+#define __MAIN_H  // Src/main.h is replaced by this file
+
+/***************************************< Includes >**************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+
+/***************************************< Definitions >**************************************/
+// Settings of Src/main.h
+#ifndef SYSCLK_MHZ
+#define SYSCLK_MHZ         (8u)
+#endif
+#define SLEEP_ON_EXIT      (0u)
+#define IRQ_PRIORITY_LED   (0u)
+#define IRQ_PRIORITY_EVENT (2u)
+#define IRQ_PRIORITY_CYCLE (3u)
+#define ISR_CODE
+#define BUTTON_GPIO_PORT   GPIOA
+#define BUTTON_GPIO_PIN    LL_GPIO_PIN_4
+#define BUTTON_EXTI_PORT   LL_EXTI_CONFIG_PORTA
+#define BUTTON_EXTI_CONFIG LL_EXTI_CONFIG_LINE4
+#define BUTTON_EXTI_LINE   LL_EXTI_LINE_4
+#define BUTTON_EXTI_IRQn   EXTI4_15_IRQn
+#define BUTTON_PIN         ( LL_GPIO_IsInputPinSet( BUTTON_GPIO_PORT, BUTTON_GPIO_PIN ) ? 1u : 0u )
+
+// GPIO pins
+#define LL_GPIO_PIN_0      (0x0001u)
+#define LL_GPIO_PIN_1      (0x0002u)
+#define LL_GPIO_PIN_2      (0x0004u)
+#define LL_GPIO_PIN_3      (0x0008u)
+#define LL_GPIO_PIN_4      (0x0010u)
+#define LL_GPIO_PIN_6      (0x0040u)
+#define LL_GPIO_PIN_7      (0x0080u)
+#define LL_GPIO_PIN_9      (0x0200u)
+
+// Peripheral instances
+#define GPIOA              ( &gasSimGPIO[ 0 ] )
+#define GPIOB              ( &gasSimGPIO[ 1 ] )
+#define GPIOF              ( &gasSimGPIO[ 2 ] )
+#define TIM1               ( &gsSimTIM1 )
+#define SysTick            ( Sim_SysTick() )
+#define LPTIM1             ( (void*)0 )
+#define UID_BASE           ( (uintptr_t)"SIM-KARIFA-UID-0" )  // 16 bytes, like a real UID
+#define FLASH_PAGE_SIZE    (0x80u)  // of the PY32F002A, sizes the boot part of Src/memmap.h
+
+// Register access: BSRR is applied to ODR at once
+#define WRITE_REG( REG, VAL )  Sim_WriteReg( &(REG), (VAL) )
+
+// SysTick, as in core_cm0plus.h
+#define SysTick_LOAD_RELOAD_Msk     (0x00FFFFFFuL)
+#define SysTick_CTRL_CLKSOURCE_Msk  (0x00000004uL)
+#define SysTick_CTRL_TICKINT_Msk    (0x00000002uL)
+#define SysTick_CTRL_ENABLE_Msk     (0x00000001uL)
+
+// Configuration values, not interpreted
+#define LL_GPIO_MODE_INPUT              (0u)
+#define LL_GPIO_MODE_OUTPUT             (1u)
+#define LL_GPIO_MODE_ALTERNATE          (2u)
+#define LL_GPIO_OUTPUT_PUSHPULL         (0u)
+#define LL_GPIO_PULL_UP                 (1u)
+#define LL_GPIO_SPEED_FREQ_VERY_HIGH    (3u)
+#define LL_GPIO_AF_2                    (2u)
+#define LL_GPIO_AF_13                   (13u)
+#define LL_TIM_CHANNEL_CH2              (2u)
+#define LL_TIM_CHANNEL_CH3              (3u)
+#define LL_TIM_CHANNEL_CH4              (4u)
+#define LL_TIM_OCMODE_PWM1              (0u)
+#define LL_TIM_OCSTATE_ENABLE           (0u)
+#define LL_TIM_OCPOLARITY_LOW           (0u)
+#define LL_TIM_OCIDLESTATE_HIGH         (0u)
+#define LL_TIM_CLOCKDIVISION_DIV1       (0u)
+#define LL_TIM_COUNTERMODE_UP           (0u)
+#define LL_IOP_GRP1_PERIPH_GPIOA        (0u)
+#define LL_IOP_GRP1_PERIPH_GPIOB        (0u)
+#define LL_IOP_GRP1_PERIPH_GPIOF        (0u)
+#define LL_APB1_GRP1_PERIPH_LPTIM1      (0u)
+#define LL_APB1_GRP1_PERIPH_PWR         (0u)
+#define LL_APB1_GRP2_PERIPH_TIM1        (0u)
+#define LL_RCC_LPTIM1_CLKSOURCE_LSI     (0u)
+#define LL_LPTIM_PRESCALER_DIV32        (0u)
+#define LL_LPTIM_OPERATING_MODE_ONESHOT (0u)
+#define LL_EXTI_LINE_4                  (0u)
+#define LL_EXTI_LINE_29                 (0u)
+#define LL_EXTI_CONFIG_PORTA            (0u)
+#define LL_EXTI_CONFIG_LINE4            (0u)
+#define LPTIM1_IRQn                     (0)
+#define EXTI4_15_IRQn                   (0)
+#define LSI_VALUE                       (32768u)
+#define RCC_ICSCR_HSI_TRIM_Msk          (0x1FFFu)
+
+// Driver functions
+#define LL_GPIO_Init( PORT, INIT )              ( (void)(PORT), (void)(INIT) )
+#define LL_GPIO_WriteOutputPort( PORT, VAL )    ( (PORT)->ODR = (VAL) )
+#define LL_GPIO_TogglePin( ... )                Sim_TogglePin( __VA_ARGS__ )
+#define LL_GPIO_SetPinMode( PORT, PIN, MODE )   ( (void)(PORT), (void)(PIN), (void)(MODE) )
+#define LL_GPIO_SetPinPull( PORT, PIN, PULL )   ( (void)(PORT), (void)(PIN), (void)(PULL) )
+#define LL_GPIO_IsInputPinSet( PORT, PIN )      ( (PORT)->IDR & (PIN) )  // IDR is 0 by default: a dark room, the sensor never charges up
+#define LL_IOP_GRP1_EnableClock( X )            ( (void)(X) )
+#define LL_APB1_GRP1_EnableClock( X )           ( (void)(X) )
+#define LL_APB1_GRP2_EnableClock( X )           ( (void)(X) )
+#define LL_TIM_OC_Init( TIM, CH, INIT )         ( (TIM)->au32CCR[ (CH) ] = (INIT)->CompareValue )
+#define LL_TIM_OC_EnablePreload( TIM, CH )      ( (void)(TIM) )
+#define LL_TIM_OC_SetCompareCH2( TIM, VAL )     ( (TIM)->au32CCR[ 2 ] = (VAL) )
+#define LL_TIM_OC_SetCompareCH3( TIM, VAL )     ( (TIM)->au32CCR[ 3 ] = (VAL) )
+#define LL_TIM_OC_SetCompareCH4( TIM, VAL )     ( (TIM)->au32CCR[ 4 ] = (VAL) )
+#define LL_TIM_SetRepetitionCounter( TIM, VAL ) ( (TIM)->u32RCR = (VAL) )
+#define LL_TIM_Init( TIM, INIT )                ( (TIM)->u32ARR = (INIT)->Autoreload )
+#define LL_TIM_EnableAllOutputs( TIM )          ( (void)(TIM) )
+#define LL_TIM_EnableCounter( TIM )             ( (void)(TIM) )
+#define LL_RCC_LSI_Enable()
+#define LL_RCC_LSI_IsReady()                    (1)
+#define LL_RCC_SetLPTIMClockSource( X )         ( (void)(X) )
+#define LL_RCC_HSI_GetCalibTrimming()           (0u)
+#define LL_RCC_HSI_SetCalibTrimming( X )        ( (void)(X) )
+#define LL_LPTIM_SetPrescaler( TIM, X )         ( (void)(X) )
+#define LL_LPTIM_Enable( TIM )
+#define LL_LPTIM_Disable( TIM )
+#define LL_LPTIM_ClearFLAG_ARRM( TIM )
+#define LL_LPTIM_EnableIT_ARRM( TIM )
+#define LL_LPTIM_SetAutoReload( TIM, X )        ( (void)(X) )
+#define LL_LPTIM_StartCounter( TIM, X )         ( (void)(X) )
+#define LL_LPTIM_GetCounter( TIM )              ( (void)(TIM), gu32SimLPTIMCount )
+#define LL_LPM_EnableSleep()
+#define LL_LPM_EnableDeepSleep()
+#define LL_EXTI_EnableIT( X )                   ( (void)(X) )
+#define LL_EXTI_SetEXTISource( PORT, LINE )     ( (void)(PORT), (void)(LINE) )
+#define LL_EXTI_EnableRisingTrig( X )           ( (void)(X) )
+#define LL_EXTI_EnableFallingTrig( X )          ( (void)(X) )
+#define LL_EXTI_ClearFlag( X )                  ( (void)(X) )
+#define NVIC_SetPriority( IRQ, PRIO )           ( (void)(IRQ), (void)(PRIO) )
+#define NVIC_EnableIRQ( IRQ )                   ( (void)(IRQ) )
+#define __WFI()                                 ( ( NULL != gpfSimWFI ) ? gpfSimWFI() : (void)0 )
+#define __disable_irq()
+#define __enable_irq()
+
+
+/***************************************< Types >**************************************/
+//! \brief Simulated GPIO port
+typedef struct
+{
+  uint32_t IDR;   //!< Input levels, set by the simulator
+  uint32_t ODR;   //!< Output levels
+  uint32_t BSRR;  //!< Set/reset register, never read back
+} GPIO_TypeDef;
+
+//! \brief Simulated TIM1, only what the RGB driver and the bit-plane mode use
+typedef struct
+{
+  uint32_t au32CCR[ 5 ];  //!< Compare values, indexed by channel
+  uint32_t u32ARR;        //!< Auto-reload value
+  uint32_t u32RCR;        //!< Repetition counter
+} S_SIM_TIM;
+
+//! \brief Simulated SysTick: VAL counts down with the host time, writes are ignored
+typedef struct
+{
+  uint32_t CTRL;  //!< Control, not interpreted
+  uint32_t LOAD;  //!< Reload value, not interpreted: it always wraps after 2^24 counts
+  uint32_t VAL;   //!< Current value, updated at every access of SysTick
+} S_SIM_SYSTICK;
+
+//! \brief GPIO initialization, as in the LL driver
+typedef struct
+{
+  uint32_t Pin;
+  uint32_t Mode;
+  uint32_t Speed;
+  uint32_t OutputType;
+  uint32_t Pull;
+  uint32_t Alternate;
+} LL_GPIO_InitTypeDef;
+
+//! \brief Timer output channel initialization, as in the LL driver
+typedef struct
+{
+  uint32_t OCMode;
+  uint32_t OCState;
+  uint32_t OCNState;
+  uint32_t CompareValue;
+  uint32_t OCPolarity;
+  uint32_t OCNPolarity;
+  uint32_t OCIdleState;
+  uint32_t OCNIdleState;
+} LL_TIM_OC_InitTypeDef;
+
+//! \brief Timer base initialization, as in the LL driver
+typedef struct
+{
+  uint32_t Prescaler;
+  uint32_t CounterMode;
+  uint32_t Autoreload;
+  uint32_t ClockDivision;
+  uint32_t RepetitionCounter;
+} LL_TIM_InitTypeDef;
+
+
+/***************************************< Global variables >**************************************/
+extern GPIO_TypeDef gasSimGPIO[ 3 ];
+extern S_SIM_TIM gsSimTIM1;
+extern S_SIM_SYSTICK gsSimSysTick;
+extern void (* gpfSimWFI)( void );  //!< Interrupt that ends the next __WFI(), NULL: none
+extern uint32_t gu32SimLPTIMCount;  //!< LPTIM counter read after a __WFI() not ended by the LPTIM
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Register write; a BSRR write sets and resets the ODR bits, like the hardware
+//! \param  pu32Reg: the register
+//! \param  u32Value: value written
+//! \return -
+//-----------------------------------------------------------------------------
+static inline void Sim_WriteReg( uint32_t* pu32Reg, uint32_t u32Value )
+{
+  GPIO_TypeDef* psPort = (GPIO_TypeDef*)( (char*)pu32Reg - offsetof( GPIO_TypeDef, BSRR ) );
+
+  psPort->ODR = ( psPort->ODR & ~( u32Value >> 16u ) ) | ( u32Value & 0xFFFFu );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Toggles output pins; a function, since the pins come as one "PORT,PIN" macro
+//! \param  psPort: the port
+//! \param  u32Pins: pin mask
+//! \return -
+//-----------------------------------------------------------------------------
+static inline void Sim_TogglePin( GPIO_TypeDef* psPort, uint32_t u32Pins )
+{
+  psPort->ODR ^= u32Pins;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  SysTick, with VAL taken from the host clock
+//! \param  -
+//! \return The simulated SysTick
+//-----------------------------------------------------------------------------
+static inline S_SIM_SYSTICK* Sim_SysTick( void )
+{
+  struct timespec sTime;
+  uint64_t u64Counts;
+
+  clock_gettime( CLOCK_MONOTONIC, &sTime );
+  u64Counts = ( (uint64_t)sTime.tv_sec * 1000000000uLL + (uint64_t)sTime.tv_nsec ) * SYSCLK_MHZ / 1000u;
+  gsSimSysTick.VAL = (uint32_t)~u64Counts & SysTick_LOAD_RELOAD_Msk;  // counting down
+
+  return &gsSimSysTick;
+}
+
+
+#endif /* SIM_HAL_H */
+
+/***************************************< End of file >**************************************/
@@ -0,0 +1,636 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file sim_main.c
+*
+* \brief Host simulator of the animations and the LED drivers
+*
+* \author Hekk_Elek
+*
+* \note  Runs the unmodified animation.c, led.c, rgbled.c and util.c on the host. The TIM1 interrupt
+*        is called period by period, and the LED brightness is measured from the simulated GPIO
+*        outputs, so what is printed is what the driver would really show.
+*        Usage: karifa_sim <animation index> [length in ms] [frame length in ms, 0: summary only]
+*               karifa_sim all [length in ms] [mA per lit LED]  -- benchmark of every animation
+*               karifa_sim golden [length in ms] [golden file]  -- timeline of every animation, or its check
+*               karifa_sim button  -- check of a click that wakes the unit up from a tickless sleep
+*        The golden timeline is the output of the VM, gau8LEDBrightness[] and gau8RGBLEDs[] after every
+*        Animation_Cycle(), summed in a CRC with a checkpoint every GOLDEN_STEP_MS. Written with the
+*        default build to golden.txt, it proves a rework of animation.c bit-exact: the check tells the
+*        first checkpoint of each animation that differs, and fails.
+*        The button check runs the unmodified button.c, and a press that ends a Util_Sleep() of
+*        BUTTON_SLEEP_MS; the press and its release are a click, no hold.
+*        Build: see build_sim.sh
+*
+**********************************************************************************************************/
+
+/***************************************< Includes >**************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Own includes
+#include "types.h"
+#include "led.h"
+#include "rgbled.h"
+#include "util.h"
+#include "animation.h"
+#include "persist.h"
+#include "button.h"
+#include "stats.h"
+
+
+/***************************************< Definitions >**************************************/
+#define DEFAULT_LENGTH_MS   (10000u)  //!< Simulated time, if not given
+#define DEFAULT_FRAME_MS       (40u)  //!< Printed frame length, if not given
+#define DEFAULT_LED_MA         (10u)  //!< Current of one lit LED in the benchmark, if not given
+#define GOLDEN_LENGTH_MS    (60000u)  //!< Golden timeline of each animation, if not given; longer than their rounds
+#define GOLDEN_STEP_MS       (1000u)  //!< Checkpoints of the golden timeline
+#define GOLDEN_STEPS          (600u)  //!< Most checkpoints of an animation, 10 minutes
+#define TICKS_PER_MS          ( 10u * LED_TICK_DIVIDER )  //!< TIM1 periods per millisecond, as in util.c
+#define RGB_PULSE_FULL        ( ( 3u * SYSCLK_MHZ ) / LED_TICK_DIVIDER )  //!< Full RGB pulse width, as in rgbled.c
+#define BUTTON_SLEEP_MS      (3000u)  //!< Tickless sleep ended by the press of the button check
+#define BUTTON_CLICK_LEN_MS   (150u)  //!< Press of the button check, a click
+#define BUTTON_LPTIM_HZ       ( LSI_VALUE / 32u )  //!< LPTIM clock, as in util.c
+
+
+/***************************************< Types >**************************************/
+//! \brief Measurements of one simulation run
+typedef struct
+{
+  U32      u32Calls;     //!< Animation_Cycle() calls
+  uint64_t u64TotalNs;   //!< Host time spent in Animation_Cycle()
+  uint64_t u64MaxNs;     //!< Longest Animation_Cycle() call
+  uint64_t u64LoadSum;   //!< LED_GetLoad() summed after each call
+  U32      u32IsrCalls;  //!< TIM1 interrupts
+  uint64_t u64IsrNs;     //!< Host time spent in the TIM1 interrupt
+  U16      u16Timeline;  //!< CRC of the VM output so far
+  U16      au16Golden[ GOLDEN_STEPS ];  //!< u16Timeline at the end of each GOLDEN_STEP_MS
+#if UTIL_PROFILING
+  S_ANIMATION_COST sCost;                          //!< gasAnimationCost[] of the animation played
+  S_UTIL_PROFILE   asOpCost[ ANIMATION_COST_OPS ];  //!< gasAnimationOpCost[]
+#endif
+} S_SIM_RESULT;
+
+
+/***************************************< Constants >**************************************/
+//! \brief Pin masks of each LED in the order of gau8LEDBrightness[], same as in led.c: GPIOA low, GPIOF high
+static const U32 gcau32SimPinMask[ LEDS_NUM ] =
+{
+  LL_GPIO_PIN_7, LL_GPIO_PIN_6, LL_GPIO_PIN_3, LL_GPIO_PIN_2, (U32)LL_GPIO_PIN_1<<16u, (U32)LL_GPIO_PIN_0<<16u,
+  (U32)LL_GPIO_PIN_0<<16u, (U32)LL_GPIO_PIN_1<<16u, LL_GPIO_PIN_2, LL_GPIO_PIN_3, LL_GPIO_PIN_6, LL_GPIO_PIN_7
+};
+
+//! \brief Characters of increasing brightness
+static const char gcacShades[] = " .:-=+*#%@";
+
+
+/***************************************< Global variables >**************************************/
+GPIO_TypeDef gasSimGPIO[ 3 ];  //!< GPIOA, GPIOB, GPIOF
+S_SIM_TIM gsSimTIM1;           //!< TIM1
+S_SIM_SYSTICK gsSimSysTick;    //!< SysTick
+void (* gpfSimWFI)( void );    //!< Interrupt that ends the next __WFI(), NULL: none
+uint32_t gu32SimLPTIMCount;    //!< LPTIM counter read after a __WFI() not ended by the LPTIM
+DATA S_PERSIST gsPersistentData;  //!< Normally in persist.c, only the animation index is used
+
+extern DATA U8 gu8Side;
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+extern DATA U8 gu8LEDNextRGB;
+extern DATA U8 gu8PlaneTicks;
+#elif LED_ADAPTIVE_TICKS
+extern DATA U8 gu8PlaneTicks;
+#endif
+
+static U32 gau32OnPeriods[ LEDS_NUM ];             //!< TIM1 periods each LED was lit in the frame
+static U32 gau32RGBCounts[ NUM_RGBLED_COLORS ];    //!< RGB pulse width summed over the frame, in TIM1 counts
+static U32 gu32FramePeriods;                       //!< TIM1 periods in the frame
+static S_SIM_RESULT gsResult;                      //!< Measurements of the run
+
+
+/***************************************< Static function definitions >**************************************/
+static void RunPeriod( void );
+static void PrintFrame( U32 u32TimeMs );
+static uint64_t NowNs( void );
+static void Play( U8 u8Animation, U32 u32LengthMs, U32 u32FrameMs );
+static void Run( U8 u8Animation, U32 u32LengthMs, U32 u32FrameMs );
+static int  Golden( U32 u32LengthMs, const char* pcFile );
+static void PressInSleep( void );
+static U32  ButtonUntil( U32 u32TimeMs, E_BUTTON_GESTURE* peGesture );
+static int  ButtonCheck( void );
+
+
+/***************************************< Private functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Runs the TIM1 interrupt once, and measures the outputs until the next one
+//! \param  -
+//! \return -
+//! \global gau32OnPeriods[], gau32RGBCounts[], gu32FramePeriods, gsResult
+//-----------------------------------------------------------------------------
+static void RunPeriod( void )
+{
+  U8  u8Ticks;
+  U8  u8Index;
+  U32 u32Pins;
+  U32 u32Length;
+  U32 au32Compare[ NUM_RGBLED_COLORS ];
+  uint64_t u64Start;
+
+  for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
+  {
+    au32Compare[ u8Index ] = gsSimTIM1.au32CCR[ 2u + u8Index ];
+  }
+  // Same order as TIM1_BRK_UP_TRG_COM_IRQHandler()
+  u64Start = NowNs();
+  u8Ticks = LED_Interrupt();
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+  RGBLED_Interrupt( gu8LEDNextRGB );
+  u32Length = gu8PlaneTicks;  // the segment starting now
+  // Compare values are preloaded, the ones written now are for the next segment
+#else
+#if LED_RGB_SCHEDULE
+  RGBLED_Interrupt( gu8LEDRGBThreshold );
+#else
+  RGBLED_Interrupt( 0u );
+#endif
+#if LED_ADAPTIVE_TICKS
+  u32Length = gu8PlaneTicks;  // the segment starting now
+#else
+  u32Length = 1u;
+#endif
+  for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
+  {
+    au32Compare[ u8Index ] = gsSimTIM1.au32CCR[ 2u + u8Index ];
+  }
+#endif
+  Util_Interrupt( u8Ticks );
+  gsResult.u64IsrNs += NowNs() - u64Start;
+  gsResult.u32IsrCalls++;
+
+  u32Pins = ( GPIOA->ODR & 0xFFFFu ) | ( GPIOF->ODR << 16u );
+  for( u8Index = 0u; u8Index < LEDS_PER_SIDE; u8Index++ )
+  {
+    U8 u8LED = LED_SIDE_FIRST( gu8Side ) + u8Index;
+    if( u32Pins & gcau32SimPinMask[ u8LED ] )
+    {
+      gau32OnPeriods[ u8LED ] += u32Length;
+    }
+  }
+  for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
+  {
+    gau32RGBCounts[ u8Index ] += au32Compare[ u8Index ] * u32Length;
+  }
+  gu32FramePeriods += u32Length;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Prints the measured brightness of the frame, and starts a new one
+//! \param  u32TimeMs: simulated time at the end of the frame
+//! \return -
+//! \global gau32OnPeriods[], gau32RGBCounts[], gu32FramePeriods
+//-----------------------------------------------------------------------------
+static void PrintFrame( U32 u32TimeMs )
+{
+  U8  u8Index;
+  U32 u32Level;
+
+  printf( "%7lu ms |", (unsigned long)u32TimeMs );
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+  {
+    // A side is lit 1/LED_SIDES of the time, so full brightness is that share of the periods
+    u32Level = ( gau32OnPeriods[ u8Index ] * LED_SIDES * ( sizeof( gcacShades ) - 2u ) + gu32FramePeriods/2u ) / ( gu32FramePeriods ? gu32FramePeriods : 1u );
+    if( u32Level > sizeof( gcacShades ) - 2u )
+    {
+      u32Level = sizeof( gcacShades ) - 2u;
+    }
+    putchar( gcacShades[ u32Level ] );
+    if( ( 0u == ( ( u8Index + 1u ) % LEDS_PER_SIDE ) ) && ( ( u8Index + 1u ) < LEDS_NUM ) )
+    {
+      putchar( '|' );
+    }
+    gau32OnPeriods[ u8Index ] = 0u;
+  }
+  printf( "| RGB" );
+  for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
+  {
+    u32Level = ( gau32RGBCounts[ u8Index ] * 15u + ( gu32FramePeriods * RGB_PULSE_FULL )/2u ) / ( ( gu32FramePeriods ? gu32FramePeriods : 1u ) * RGB_PULSE_FULL );
+    printf( " %2lu", (unsigned long)u32Level );
+    gau32RGBCounts[ u8Index ] = 0u;
+  }
+  printf( " | load %3lu%%\n", (unsigned long)( ( LED_GetLoad() * 100u ) / LED_LOAD_FULL ) );
+  gu32FramePeriods = 0u;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Host time for measuring the animation step
+//! \param  -
+//! \return Monotonic time in ns
+//-----------------------------------------------------------------------------
+static uint64_t NowNs( void )
+{
+  struct timespec sTime;
+
+  clock_gettime( CLOCK_MONOTONIC, &sTime );
+  return (uint64_t)sTime.tv_sec * 1000000000uLL + (uint64_t)sTime.tv_nsec;
+}
+
+
+//----------------------------------------------------------------------------
+//! \brief  Plays an animation after the init block of main()
+//! \param  u8Animation: index in gasAnimations[]
+//! \param  u32LengthMs: simulated time
+//! \param  u32FrameMs: length of the printed frames; 0: nothing is printed
+//! \return -
+//! \global gsResult, the measured outputs
+//! \note   The init functions don't reset every static of the modules, as the startup code does
+//!         that in the firmware: called again, it would go on from the previous animation. See Run().
+//-----------------------------------------------------------------------------
+static void Play( U8 u8Animation, U32 u32LengthMs, U32 u32FrameMs )
+{
+  U32 u32TimeMs;
+  U8  au8Output[ LEDS_NUM + NUM_RGBLED_COLORS ];
+  uint64_t u64Start;
+  uint64_t u64Ns;
+
+  memset( &gsResult, 0, sizeof( gsResult ) );
+  memset( gau32OnPeriods, 0, sizeof( gau32OnPeriods ) );
+  memset( gau32RGBCounts, 0, sizeof( gau32RGBCounts ) );
+  gu32FramePeriods = 0u;
+
+  // Same order as the init block of main()
+  memset( &gsPersistentData, 0, sizeof( gsPersistentData ) );
+  Util_Init();
+  LED_Init();
+  RGBLED_Init();
+  Animation_Init();
+  LED_SetBrightness( LED_DIM_FULL );
+  Animation_Set( u8Animation );
+
+  // One main cycle per ms, the interrupt runs period by period in between
+  for( u32TimeMs = 1u; u32TimeMs <= u32LengthMs; u32TimeMs++ )
+  {
+    while( Util_GetTimerMs32() < u32TimeMs )
+    {
+      RunPeriod();
+    }
+    u64Start = NowNs();
+    Animation_Cycle();
+    u64Ns = NowNs() - u64Start;
+#if LED_SOFT_START_MS
+    if( Animation_GetIdleMs() >= LED_SOFT_START_STEP_MS )  // as TaskAnimation() does, a bit more often
+    {
+      (void)LED_SoftStartCycle();
+    }
+#endif
+    gsResult.u64TotalNs += u64Ns;
+    if( u64Ns > gsResult.u64MaxNs )
+    {
+      gsResult.u64MaxNs = u64Ns;
+    }
+    gsResult.u32Calls++;
+    gsResult.u64LoadSum += LED_GetLoad();
+    memcpy( au8Output, gau8LEDBrightness, LEDS_NUM );
+    memcpy( &au8Output[ LEDS_NUM ], (U8*)gau8RGBLEDs, NUM_RGBLED_COLORS );
+    gsResult.u16Timeline = ( 1u == u32TimeMs ) ? Util_CRC16( au8Output, sizeof( au8Output ) )
+                                               : Util_CRC16Continue( gsResult.u16Timeline, au8Output, sizeof( au8Output ) );
+    if( ( 0u == ( u32TimeMs % GOLDEN_STEP_MS ) ) && ( u32TimeMs / GOLDEN_STEP_MS <= GOLDEN_STEPS ) )
+    {
+      gsResult.au16Golden[ u32TimeMs / GOLDEN_STEP_MS - 1u ] = gsResult.u16Timeline;
+    }
+    if( ( 0u != u32FrameMs ) && ( 0u == ( u32TimeMs % u32FrameMs ) ) )
+    {
+      PrintFrame( u32TimeMs );
+    }
+  }
+#if UTIL_PROFILING
+  memcpy( &gsResult.sCost, (const void*)&gasAnimationCost[ u8Animation ], sizeof( gsResult.sCost ) );
+  memcpy( gsResult.asOpCost, (const void*)gasAnimationOpCost, sizeof( gsResult.asOpCost ) );
+#endif
+}
+
+
+//----------------------------------------------------------------------------
+//! \brief  Plays an animation from power-on, like the firmware
+//! \param  u8Animation: index in gasAnimations[]
+//! \param  u32LengthMs: simulated time
+//! \param  u32FrameMs: length of the printed frames; 0: nothing is printed
+//! \return -
+//! \global gsResult, the measured outputs
+//! \note   Played by a child process, in the statics of the program loaded, so no state of an
+//!         earlier run leaks into it: the timeline of an animation doesn't depend on the others.
+//!         The parent never plays itself. The results come back through a pipe.
+//-----------------------------------------------------------------------------
+static void Run( U8 u8Animation, U32 u32LengthMs, U32 u32FrameMs )
+{
+  int   aiPipe[ 2 ];
+  pid_t iChild;
+  int   iStatus;
+
+  fflush( stdout );  // the child would print the buffered lines again
+  if( ( 0 != pipe( aiPipe ) ) || ( ( iChild = fork() ) < 0 ) )
+  {
+    perror( "fork" );
+    exit( 1 );
+  }
+  if( 0 == iChild )
+  {
+    close( aiPipe[ 0 ] );
+    Play( u8Animation, u32LengthMs, u32FrameMs );
+    fflush( stdout );
+    _exit( ( sizeof( gsResult ) == write( aiPipe[ 1 ], &gsResult, sizeof( gsResult ) ) ) ? 0 : 1 );
+  }
+  close( aiPipe[ 1 ] );
+  if( ( sizeof( gsResult ) != read( aiPipe[ 0 ], &gsResult, sizeof( gsResult ) ) )
+   || ( iChild != waitpid( iChild, &iStatus, 0 ) ) || !WIFEXITED( iStatus ) || ( 0 != WEXITSTATUS( iStatus ) ) )
+  {
+    fprintf( stderr, "Animation %u failed in its process\n", u8Animation );
+    exit( 1 );
+  }
+  close( aiPipe[ 0 ] );
+}
+
+
+//----------------------------------------------------------------------------
+//! \brief  Prints the golden timeline of every animation, or checks it against a file
+//! \param  u32LengthMs: simulated time of each animation
+//! \param  pcFile: golden file to check; NULL: the timeline is printed in its format
+//! \return 0 if it matches, 1 if it differs or the file is bad
+//! \note   A line of the file is "<animation> <ms> <CRC>", '#' starts a comment. Checkpoints beyond
+//!         u32LengthMs fail, so give at least the length the file was written with.
+//-----------------------------------------------------------------------------
+static int Golden( U32 u32LengthMs, const char* pcFile )
+{
+  static U16 au16Timelines[ NUM_ANIMATIONS ][ GOLDEN_STEPS ];
+  U32   u32Animation;
+  U32   u32Step;
+  U32   u32Steps = u32LengthMs / GOLDEN_STEP_MS;
+  U32   u32Line = 0u;
+  U32   u32Checked = 0u;
+  U32   au32FirstMs[ NUM_ANIMATIONS ] = { 0u };
+  unsigned long ulAnimation, ulMs, ulCrc;
+  char  acLine[ 128 ];
+  FILE* psFile = NULL;
+  int   iResult = 0;
+
+  if( u32Steps > GOLDEN_STEPS )
+  {
+    u32Steps = GOLDEN_STEPS;
+  }
+  if( NULL != pcFile )
+  {
+    psFile = fopen( pcFile, "r" );
+    if( NULL == psFile )
+    {
+      fprintf( stderr, "Cannot open %s\n", pcFile );
+      return 1;
+    }
+  }
+  for( u32Animation = 0u; u32Animation < NUM_ANIMATIONS; u32Animation++ )
+  {
+    Run( (U8)u32Animation, u32Steps * GOLDEN_STEP_MS, 0u );
+    memcpy( au16Timelines[ u32Animation ], gsResult.au16Golden, sizeof( au16Timelines[ 0 ] ) );
+  }
+
+  if( NULL == psFile )
+  {
+    printf( "# Golden timeline of the VM: <animation> <ms> <CRC of the output so far>\n" );
+    for( u32Animation = 0u; u32Animation < NUM_ANIMATIONS; u32Animation++ )
+    {
+      for( u32Step = 0u; u32Step < u32Steps; u32Step++ )
+      {
+        printf( "%lu %lu %04X\n", (unsigned long)u32Animation, (unsigned long)( ( u32Step + 1u ) * GOLDEN_STEP_MS ),
+                au16Timelines[ u32Animation ][ u32Step ] );
+      }
+    }
+    return 0;
+  }
+
+  while( NULL != fgets( acLine, sizeof( acLine ), psFile ) )
+  {
+    u32Line++;
+    if( ( '#' == acLine[ 0 ] ) || ( '\n' == acLine[ 0 ] ) )
+    {
+      continue;
+    }
+    if( ( 3 != sscanf( acLine, "%lu %lu %lx", &ulAnimation, &ulMs, &ulCrc ) ) || ( ulAnimation >= NUM_ANIMATIONS )
+        || ( 0u != ( ulMs % GOLDEN_STEP_MS ) ) || ( ulMs / GOLDEN_STEP_MS > u32Steps ) || ( 0u == ulMs ) )
+    {
+      fprintf( stderr, "%s(%lu): Error: not a checkpoint of animation 0..%u, %u..%lu ms\n", pcFile, (unsigned long)u32Line,
+               NUM_ANIMATIONS - 1u, GOLDEN_STEP_MS, (unsigned long)( u32Steps * GOLDEN_STEP_MS ) );
+      iResult = 1;
+      continue;
+    }
+    u32Checked++;
+    if( ( au16Timelines[ ulAnimation ][ ulMs / GOLDEN_STEP_MS - 1u ] != ulCrc )
+        && ( ( 0u == au32FirstMs[ ulAnimation ] ) || ( ulMs < au32FirstMs[ ulAnimation ] ) ) )
+    {
+      au32FirstMs[ ulAnimation ] = ulMs;
+    }
+  }
+  fclose( psFile );
+  for( u32Animation = 0u; u32Animation < NUM_ANIMATIONS; u32Animation++ )
+  {
+    if( 0u != au32FirstMs[ u32Animation ] )
+    {
+      fprintf( stderr, "Animation %lu differs from the golden timeline in %lu..%lu ms\n", (unsigned long)u32Animation,
+               (unsigned long)( au32FirstMs[ u32Animation ] - GOLDEN_STEP_MS ), (unsigned long)au32FirstMs[ u32Animation ] );
+      iResult = 1;
+    }
+  }
+  printf( "%s: %lu checkpoints, %s\n", pcFile, (unsigned long)u32Checked, iResult ? "FAILED" : "all match" );
+
+  return iResult;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Presses the button, as its EXTI interrupt waking a __WFI() up
+//! \param  -
+//! \return -
+//-----------------------------------------------------------------------------
+static void PressInSleep( void )
+{
+  BUTTON_GPIO_PORT->IDR &= ~BUTTON_GPIO_PIN;
+  Button_Interrupt();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Runs the button task every ms, until the given time
+//! \param  u32TimeMs: simulated time to stop at
+//! \param  peGesture: the last gesture recognized meanwhile, left as it was if none
+//! \return Number of the gestures recognized meanwhile
+//-----------------------------------------------------------------------------
+static U32 ButtonUntil( U32 u32TimeMs, E_BUTTON_GESTURE* peGesture )
+{
+  E_BUTTON_GESTURE eGesture;
+  U32 u32Gestures = 0u;
+
+  while( Util_GetTimerMs32() < u32TimeMs )
+  {
+    Util_Interrupt( TICKS_PER_MS );
+    eGesture = Button_Cycle();
+    if( BUTTON_NONE != eGesture )
+    {
+      *peGesture = eGesture;
+      u32Gestures++;
+    }
+  }
+
+  return u32Gestures;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Checks that a click waking the unit up from a tickless sleep is told as a click
+//! \param  -
+//! \return 0 if it is, 1 if not
+//! \note   The sleep is played like in TicklessIdle(): the press ends Util_Sleep() after
+//!         BUTTON_SLEEP_MS, and it is stamped before the clock is brought forward.
+//-----------------------------------------------------------------------------
+static int ButtonCheck( void )
+{
+  E_BUTTON_GESTURE eGesture = BUTTON_NONE;
+  U32 u32Gestures;
+  U32 u32WokenMs;
+  BOOL bClick;
+
+  Util_Init();
+  BUTTON_GPIO_PORT->IDR |= BUTTON_GPIO_PIN;  // released, pulled up
+  Button_Init();
+  u32Gestures = ButtonUntil( 100u, &eGesture );
+
+  // Asleep, until the press; the LPTIM has counted BUTTON_SLEEP_MS by then
+  gpfSimWFI = PressInSleep;
+  gu32SimLPTIMCount = ( BUTTON_SLEEP_MS * BUTTON_LPTIM_HZ ) / 1000u;
+  Util_Sleep( 2u * BUTTON_SLEEP_MS );
+  gpfSimWFI = NULL;
+  Button_Woken();
+  u32WokenMs = Util_GetTimerMs32();
+
+  u32Gestures += ButtonUntil( u32WokenMs + BUTTON_CLICK_LEN_MS, &eGesture );
+  BUTTON_GPIO_PORT->IDR |= BUTTON_GPIO_PIN;
+  Button_Interrupt();
+  u32Gestures += ButtonUntil( u32WokenMs + BUTTON_CLICK_LEN_MS + BUTTON_HOLD_2S_MS, &eGesture );
+  bClick = ( 1u == u32Gestures ) && ( BUTTON_CLICK == eGesture );
+  printf( "Button: a %u ms press waking a %u ms sleep up at %lu ms: %lu gesture(s), the last %u; %s\n", BUTTON_CLICK_LEN_MS,
+          2u * BUTTON_SLEEP_MS, (unsigned long)u32WokenMs, (unsigned long)u32Gestures, eGesture, bClick ? "a click" : "FAILED" );
+
+  return bClick ? 0 : 1;
+}
+
+
+/***************************************< Public functions >**************************************/
+#if STATS_ENABLE
+//----------------------------------------------------------------------------
+//! \brief  Normally in stats.c, the usage counters aren't simulated
+//! \param  -
+//! \return -
+//-----------------------------------------------------------------------------
+void Stats_CountPress( void )
+{
+}
+#endif
+
+//----------------------------------------------------------------------------
+//! \brief  Simulator entry point
+//! \param  argc, argv: see the file header
+//! \return 0 on success
+//-----------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+  U32 u32Animation;
+  U32 u32LengthMs = DEFAULT_LENGTH_MS;
+  U32 u32FrameMs = DEFAULT_FRAME_MS;
+  U32 u32Calls;
+  double dLoad;
+
+  if( argc < 2 )
+  {
+    fprintf( stderr, "Usage: %s <animation 0..%u> [length ms] [frame ms, 0: summary only]\n"
+                     "       %s all [length ms] [mA per lit LED]\n"
+                     "       %s golden [length ms] [golden file]\n"
+                     "       %s button\n", argv[ 0 ], NUM_ANIMATIONS - 1u, argv[ 0 ], argv[ 0 ], argv[ 0 ] );
+    return 1;
+  }
+  if( argc > 2 )
+  {
+    u32LengthMs = strtoul( argv[ 2 ], NULL, 0 );
+  }
+
+  // Golden timeline: written, or checked
+  if( 0 == strcmp( argv[ 1 ], "golden" ) )
+  {
+    return Golden( ( argc > 2 ) ? u32LengthMs : GOLDEN_LENGTH_MS, ( argc > 3 ) ? argv[ 3 ] : NULL );
+  }
+
+  // Click that wakes the unit up
+  if( 0 == strcmp( argv[ 1 ], "button" ) )
+  {
+    return ButtonCheck();
+  }
+
+  // Benchmark: every animation for the same time, one row each
+  if( 0 == strcmp( argv[ 1 ], "all" ) )
+  {
+    U32 u32LedMa = ( argc > 3 ) ? strtoul( argv[ 3 ], NULL, 0 ) : DEFAULT_LED_MA;
+
+    printf( "LED_DRIVER_MODE %u, LED_PWM_BITS %u, SYSCLK_MHZ %u, %lu ms each, %lu mA per lit LED\n",
+            LED_DRIVER_MODE, LED_PWM_BITS, SYSCLK_MHZ, (unsigned long)u32LengthMs, (unsigned long)u32LedMa );
+    printf( "%4s | %12s %6s | %5s %10s | %4s %7s\n", "anim", "step ns avg", "worst", "ISR/s", "ISR ns/ms", "load", "LED mA" );
+    for( u32Animation = 0u; u32Animation < NUM_ANIMATIONS; u32Animation++ )
+    {
+      Run( (U8)u32Animation, u32LengthMs, 0u );
+      u32Calls = gsResult.u32Calls ? gsResult.u32Calls : 1u;
+      dLoad = (double)gsResult.u64LoadSum / ( (double)LED_LOAD_FULL * u32Calls );
+      printf( "%4lu | %12.0f %6lu | %5.0f %10.0f | %3.0f%% %7.2f\n", (unsigned long)u32Animation,
+              (double)gsResult.u64TotalNs / u32Calls, (unsigned long)gsResult.u64MaxNs,
+              gsResult.u32IsrCalls * 1000.0 / u32Calls, (double)gsResult.u64IsrNs / u32Calls,
+              dLoad * 100.0, dLoad * LEDS_NUM * u32LedMa / 2.0 );  // each LED is lit at most half of the time
+    }
+    return 0;
+  }
+
+  u32Animation = strtoul( argv[ 1 ], NULL, 0 );
+  if( argc > 3 )
+  {
+    u32FrameMs = strtoul( argv[ 3 ], NULL, 0 );
+  }
+  if( u32Animation >= NUM_ANIMATIONS )
+  {
+    fprintf( stderr, "No such animation: %lu\n", (unsigned long)u32Animation );
+    return 1;
+  }
+
+  Run( (U8)u32Animation, u32LengthMs, u32FrameMs );
+  u32Calls = gsResult.u32Calls ? gsResult.u32Calls : 1u;
+  printf( "Animation %lu, %lu ms: %lu steps, %.0f ns average, %lu ns worst on the host; average load %lu%%; %.0f interrupts/s\n",
+          (unsigned long)u32Animation, (unsigned long)u32LengthMs, (unsigned long)gsResult.u32Calls,
+          (double)gsResult.u64TotalNs / u32Calls, (unsigned long)gsResult.u64MaxNs,
+          (unsigned long)( ( gsResult.u64LoadSum * 100u ) / ( (uint64_t)LED_LOAD_FULL * u32Calls ) ),
+          gsResult.u32IsrCalls * 1000.0 / u32Calls );
+#if UTIL_PROFILING
+  {
+    static const char* const gcapcOps[ ANIMATION_COST_OPS ] =
+    {
+      "LOAD", "LERP", "GENERATE", "CONTROL", "COMPILED", "ADD", "RSHIFT", "LSHIFT", "USOURCE", "DSOURCE", "DIV"
+    };
+    U8 u8Op;
+
+    printf( "Cost: %lu cycles, %lu avg, %lu max; %lu changes; %lu ms, duty %.1f%%  (SYSCLK_MHZ cycles of the host time)\n",
+            (unsigned long)gsResult.sCost.sCycles.u32Count, (unsigned long)( gsResult.sCost.sCycles.u32Avg16 >> 4u ),
+            (unsigned long)gsResult.sCost.sCycles.u32Max, (unsigned long)gsResult.sCost.u32Changes, (unsigned long)gsResult.sCost.u32Ms,
+            gsResult.sCost.u32LevelMs * 100.0 / ( ( gsResult.sCost.u32Ms ? gsResult.sCost.u32Ms : 1u ) * (double)( LEDS_NUM * LED_BRIGHTNESS_MAX ) ) );
+    for( u8Op = 0u; u8Op < ANIMATION_COST_OPS; u8Op++ )
+    {
+      if( 0u != gsResult.asOpCost[ u8Op ].u32Count )
+      {
+        printf( "  %-8s %8lu runs, %6lu avg, %6lu max\n", gcapcOps[ u8Op ], (unsigned long)gsResult.asOpCost[ u8Op ].u32Count,
+                (unsigned long)( gsResult.asOpCost[ u8Op ].u32Avg16 >> 4u ), (unsigned long)gsResult.asOpCost[ u8Op ].u32Max );
+      }
+    }
+  }
+#endif
+
+  return 0;
+}
+
+/***************************************< End of file >**************************************/
@@ -17,6 +17,16 @@ the LED brightness state variables. Each animation program runs in a loop. Instr
 the following format:
   [ LED brightness array -- signed integer ] [ Opcode ] [ Opcode specific operand ]
 
+The LERP opcode is different from the others: it is not executed once, but it fades the
+LEDs from their current brightness to the given array during the whole duration of the
+instruction: linearly, or along the easing curve of its operand (E_ANIMATION_EASE), looked up
+in gcaau8EaseCurve[] once a frame. It can't be combined with other opcodes, except with ADD: SATADD is an ADD
+which saturates at 0 and LED_BRIGHTNESS_MAX instead of wrapping to 0. The LEDs with 0 in the
+array are left alone by both, so the array is the mask of the instruction as well.
+GENERATE works the same way, but it runs a procedural effect during the instruction; the
+operand tells the generator type and its step time, the LED brightness array holds the
+parameters of the effect.
+
 ----------------------------------------------------------------------------------------*/
 
 /***************************************< Includes >**************************************/
@@ -24,16 +34,63 @@ the following format:
 #include <string.h>
 
 // Own includes
+#include "main.h"
 #include "types.h"
 #include "led.h"
 #include "rgbled.h"
 #include "util.h"
 #include "animation.h"
 #include "persist.h"
+#include "upload.h"
 
 
 /***************************************< Definitions >**************************************/
 #define RIGHT_LEDS_START    (6u)  //!< Index of the first LED on the right side of the board
+#define GENERATOR_STEP_UNIT (4u)  //!< Resolution of the generator step time in ms
+//! \brief Operand of a GENERATE instruction: generator type and step time (max. 252 ms)
+#define GENERATOR(type,ms)  ((U8)(((type) << 6u) | ((ms) / GENERATOR_STEP_UNIT)))
+#define LOOP_RGB            (0x01u)  //!< Option of an animation: the RGB program loops on its own instead of restarting with the normal one
+#define MIRROR              (0x02u)  //!< Option of an animation: its normal program is of S_ANIMATION_INSTRUCTION_HALF, cast to the pointer of the normal one
+#define FRAMES              (0x04u)  //!< Option of an animation: its normal program is of S_ANIMATION_INSTRUCTION_FRAME, cast to the pointer of the normal one
+#define FAST_REFRESH        (0x08u)  //!< Option of an animation: the LEDs are refreshed at 2.5 kHz, for the cameras; only with LED_FAST_REFRESH 1
+#define BEACON              (0x10u)  //!< Option of an animation: a frame of one LED lit alone is held by its pins in stop mode, see LED_SoloOn()
+#define PROFILE_RGB         (0x01u)  //!< Flag of S_ANIMATION_PROFILE: the RGB LED is lit by the animation
+#define PALETTE_FRAME       (0x80u)  //!< Bit of u8Frame of S_ANIMATION_INSTRUCTION_FRAME: the array is the row of gcau8PaletteFrames[] of the other bits
+#define PALETTE_SIZE        (4u)     //!< Entries of the palette of a track, 2 bits a LED in gcau8PaletteFrames[]
+#define PALETTE_ROW_BYTES   ( ( LEDS_NUM + 3u ) / 4u )  //!< Size of an array of gcau8PaletteFrames[]
+#define CROSSFADE_END       (0x10000uL)  //!< Weight of the incoming animation at the end of a crossfade: 1.0 in 16.16 fixed point
+#define DIV_RECIPROCALS     (16u)  //!< Divisors of DIV below this multiply by gcau16Reciprocal[]
+#define SPEED_ONE           (256u) //!< Playback rate of real time in the 8.8 fixed point of gcau16SpeedQ8[]
+#define BEAT_MIN_MS         ( ANIMATION_BEAT_MS / 4u )  //!< Shortest beat of Animation_SetBeat(), 4 times the speed
+#define BEAT_MAX_MS         ( ANIMATION_BEAT_MS * 4u )  //!< Longest beat of Animation_SetBeat(), a quarter of the speed
+#define CONTROL_TRANSFERS_MAX (16u)  //!< Most flow control instructions of a track in one cycle, so a table looping on itself can't hang the main cycle
+#define RESUME_MAGIC        (0x52534D31uL)  //!< "RSM1": S_ANIMATION_RESUME holds a snapshot
+#define EASE_STEPS          (64u)  //!< Points of a curve of gcaau8EaseCurve[] over a fade
+#define EASE_CURVES         (3u)   //!< Curves of gcaau8EaseCurve[], from EASE_IN on
+//! \brief Progress of the curves at point (i) of EASE_STEPS, in 1/256; 255 at most, the end of a fade loads the target
+#define EASE_IN_AT( i )     ( ( (i) * (i) ) / 16u )
+#define EASE_OUT_AT( i )    ( 256u - ( ( EASE_STEPS - (i) ) * ( EASE_STEPS - (i) ) + 15u ) / 16u )
+#define EASE_SINE_AT( i )   ( ( (i) * (i) * ( 96u - (i) ) ) / 512u )
+//! \brief Points (i)..(i)+7 of a curve, and all the EASE_STEPS of it
+#define EASE_POINTS8( f, i )  f( (i) ), f( (i)+1u ), f( (i)+2u ), f( (i)+3u ), f( (i)+4u ), f( (i)+5u ), f( (i)+6u ), f( (i)+7u )
+#define EASE_POINTS( f )      EASE_POINTS8( f, 0u ), EASE_POINTS8( f, 8u ), EASE_POINTS8( f, 16u ), EASE_POINTS8( f, 24u ), \
+                              EASE_POINTS8( f, 32u ), EASE_POINTS8( f, 40u ), EASE_POINTS8( f, 48u ), EASE_POINTS8( f, 56u )
+
+// Native animations: C functions in place of the normal LED table, run by TrackNative() as stackless
+// coroutines. A call draws a frame on the levels, and returns the ms until the next one; the
+// function is entered again after its last NATIVE_YIELD(). The locals are lost at a yield, the state
+// kept over it has to be static. No switch() of its own may span a yield.
+//! \brief Starts the body of a native animation, before its first statement
+#define NATIVE_BEGIN(pu16Resume)     switch( *(pu16Resume) ) { case 0u:
+//! \brief Ends the frame, the native animation goes on here after (ms); 1..65535
+#define NATIVE_YIELD(pu16Resume,ms)  do { *(pu16Resume) = (U16)__LINE__; return (U16)(ms); case __LINE__:; } while( 0 )
+//! \brief Ends the body of a native animation: its round is over, the next call starts it again
+#define NATIVE_END(pu16Resume)       } *(pu16Resume) = 0u; return 0u
+#define BOUNCE_FRAME_MS     (20u)    //!< Frame of Bounce()
+#define BOUNCE_TOP          ( ( RIGHT_LEDS_START - 1u ) * 256u )  //!< Height Bounce() drops its ball from, in 1/256 LEDs above the bottom one
+#define BOUNCE_GRAVITY      (3)      //!< Speed gained by the ball of Bounce() in a frame while falling, 1/256 LEDs a frame
+#define BOUNCE_REST_SPEED   (16)     //!< A ball of Bounce() bouncing off slower than this stays at the bottom
+#define BOUNCE_REST_MS      (1000u)  //!< The ball of Bounce() rests this long, then it is dropped again
 
 
 /***************************************< Types >**************************************/
@@ -42,16 +99,52 @@ typedef enum
 {
   LOAD      = 0x00u,  //!< Loads the LED brightness array to the PWM driver
   ADD       = 0x01u,  //!< Adds the LED brightness array elements to the current brightness level; if overflows, it sets to zero
-  RSHIFT    = 0x02u,  //!< Shifts all the current LED brightness levels clockwise
-  LSHIFT    = 0x04u,  //!< Shifts all the current LED brightness levels anticlockwise
+  RSHIFT    = 0x02u,  //!< Rotates all the current LED brightness levels clockwise, by (operand) LEDs at once without REPEAT and DIV (0: by one)
+  LSHIFT    = 0x04u,  //!< Rotates all the current LED brightness levels anticlockwise, by (operand) LEDs at once without REPEAT and DIV (0: by one)
 //  UMOVE     = 0x04u,  //!< Moves some of the values upwards. Uses saturation logic. Doesn't roll over.
 //  DMOVE     = 0x08u,  //!< Moves some of the values downwards. Uses saturation logic. Doesn't roll over.
+  LERP      = 0x08u,  //!< Fades from the current brightness levels to the LED brightness array during the instruction, along the curve of (operand)
   DIV       = 0x10u,  //!< Divides the the current LED brightness levels by the given number
   USOURCE   = 0x20u,  //!< Add values to the brightness and if it overflows/underflows then it will be added to the upwards next value. If it overflows/underflows then it will do the same until it reaches the uppper or lower end.
   DSOURCE   = 0x40u,  //!< Add values to the brightness and if it overflows/underflows then it will be added to the downwards next value. If it overflows/underflows then it will do the same until it reaches the uppper or lower end.
-  REPEAT    = 0x80u   //!< Do the instruction and repeat by (operand)-times
+  REPEAT    = 0x80u,  //!< Do the instruction and repeat by (operand)-times
+  GENERATE  = RSHIFT | LSHIFT,  //!< Runs a generator during the instruction (shifting both ways would make no sense anyway)
+  SATADD    = LERP | ADD,       //!< Adds the array as ADD, but saturates at 0 and LED_BRIGHTNESS_MAX; it can be combined as ADD
+  HSV       = USOURCE | DSOURCE,  //!< RGB LED only: loads the color given as hue [0; 255], saturation and value [0; 15] (the sources aren't implemented there)
+  CONTROL   = LERP | GENERATE,  //!< Flow control of the normal LEDs, with the bits below; takes no time and changes no LED (a fade of a generator would make no sense)
+  JUMP      = CONTROL,          //!< Goes on at the instruction of index (operand) of the same program; the timing starts over there, as at a restart
+  LOOP      = CONTROL | REPEAT, //!< Runs the instructions up to the matching END (operand)-times
+  CALL      = CONTROL | DIV,    //!< Runs the normal LED program of gasAnimations[ (operand) ], then goes on after the CALL
+  END       = CONTROL | ADD,    //!< Ends the block of a LOOP; returns from a CALL, as the end of the program does
+  PALETTE   = CONTROL | USOURCE //!< The first PALETTE_SIZE values of the array become the palette of the track, for the PALETTE_FRAME arrays fetched after it
 } E_ANIMATION_OPCODE;
 
+//! \brief Generators of the GENERATE opcode
+typedef enum
+{
+  GEN_SPARKLE   = 0u,  //!< Loads the array, then lights up a random LED fully in each step
+  GEN_FADE      = 1u,  //!< A random LED fades up to its array value while all the others fade out
+  GEN_CHASE_CW  = 2u,  //!< The array is rotated clockwise by one LED in each step
+  GEN_CHASE_CCW = 3u   //!< The array is rotated anticlockwise by one LED in each step
+} E_ANIMATION_GENERATOR;
+
+//! \brief Easing curves of the LERP opcode, its operand
+typedef enum
+{
+  EASE_LINEAR = 0u,  //!< The same change in every ms
+  EASE_IN     = 1u,  //!< Starts slowly and speeds up, quadratic
+  EASE_OUT    = 2u,  //!< Starts quickly and slows down, quadratic
+  EASE_SINE   = 3u   //!< Slow at both ends as half a sine wave: a cubic smoothstep, within 1% of it
+} E_ANIMATION_EASE;
+
+//! \brief Blend modes of the layers
+typedef enum
+{
+  BLEND_ADD  = 0u,  //!< Adds the layer to the levels below, saturating at LED_BRIGHTNESS_MAX
+  BLEND_MAX  = 1u,  //!< Keeps the brighter one of the layer and the levels below
+  BLEND_MASK = 2u   //!< Scales the levels below by the layer: LED_BRIGHTNESS_MAX keeps them, 0 turns them off
+} E_ANIMATION_BLEND;
+
 //! \brief Instruction used by the animation state machine -- for normal LEDs
 typedef struct
 {
@@ -61,6 +154,27 @@ typedef struct
   U8  u8AnimationOperand;                        //!< Opcode-specific operand
 } S_ANIMATION_INSTRUCTION_NORMAL;
 
+//! \brief Instruction of an animation with the MIRROR option -- for normal LEDs
+//! \note  Only the left side is stored, LED n of the right side shows LED ( LEDS_NUM - 1 - n ); TrackFetch() expands it.
+typedef struct
+{
+  U16 u16TimingMs;                               //!< How long the machine should stay in this state
+  U8  au8LEDBrightness[ RIGHT_LEDS_START ];      //!< Brightness of each LED on the left side
+  U8  u8AnimationOpcode;                         //!< Opcode (E_ANIMATION_OPCODE)
+  U8  u8AnimationOperand;                        //!< Opcode-specific operand
+} S_ANIMATION_INSTRUCTION_HALF;
+
+//! \brief Instruction of an animation with the FRAMES option -- for normal LEDs
+//! \note  The brightness array is row u8Frame of gcau8Frames[], or the palette of the track indexed by a row of
+//!         gcau8PaletteFrames[]; TrackFetch() expands it.
+typedef struct
+{
+  U16 u16TimingMs;                               //!< How long the machine should stay in this state
+  U8  u8Frame;                                   //!< Index of the brightness array in gcau8Frames[]; with PALETTE_FRAME, in gcau8PaletteFrames[]
+  U8  u8AnimationOpcode;                         //!< Opcode (E_ANIMATION_OPCODE)
+  U8  u8AnimationOperand;                        //!< Opcode-specific operand
+} S_ANIMATION_INSTRUCTION_FRAME;
+
 //! \brief Instruction used by the animation state machine -- for the RGB LED
 typedef struct
 {
@@ -70,6 +184,96 @@ typedef struct
   U8  u8AnimationOperand;                        //!< Opcode-specific operand
 } S_ANIMATION_INSTRUCTION_RGB;
 
+//! \brief Entry of the opcode dispatch table
+typedef struct
+{
+  U8   u8Opcode;                                                        //!< Opcode bit (E_ANIMATION_OPCODE)
+  void (*pfOperation)( CODE const S_ANIMATION_INSTRUCTION_NORMAL*, U8* );  //!< Function implementing it, on the levels of a track
+} S_ANIMATION_OPERATION;
+
+//! \brief State of a running LERP instruction
+typedef struct
+{
+  const U8 CODE* pu8Target;                      //!< Brightness levels to reach; NULL if there's no fade running
+  const U8 CODE* pu8Curve;                       //!< Easing curve, a row of gcaau8EaseCurve[]; NULL: linear fade
+  U16 u16RemainingMs;                            //!< Time left until the target is reached
+  U32 u32Phase;                                  //!< Eased: point of the curve reached, 16.16 fixed point
+  U32 u32PhaseStep;                              //!< Eased: points of the curve passed in every ms, 16.16 fixed point
+  I32 ai32Value[ LEDS_NUM ];                     //!< Current brightness levels, 16.16 fixed point; eased: the levels at the start
+  I32 ai32Step[ LEDS_NUM ];                      //!< Brightness change in every ms, 16.16 fixed point; eased: the whole change, 24.8 fixed point
+} S_ANIMATION_LERP;
+
+//! \brief State of a running GENERATE instruction
+typedef struct
+{
+  const U8 CODE* pu8Params;                      //!< Parameters of the generator; NULL if there's no generator running
+  U8  u8Type;                                    //!< Generator type (E_ANIMATION_GENERATOR)
+  U8  u8Phase;                                   //!< Chase position, or the LED lit by the generator
+  U8  u8Previous;                                //!< The LED lit in the previous round
+  U16 u16StepMs;                                 //!< Step time
+  U16 u16ElapsedMs;                              //!< Time elapsed since the last step
+} S_ANIMATION_GENERATOR;
+
+//! \brief Entry of the return stack of a track: a running LOOP or CALL
+typedef struct
+{
+  const S_ANIMATION_INSTRUCTION_NORMAL CODE* psCode;  //!< Program to go on with; NULL: the program of the track itself
+  U8  u8CodeLength;                              //!< Number of instructions of that program
+  U8  u8CodeFormat;                              //!< Layout of that program: MIRROR, FRAMES or 0 for S_ANIMATION_INSTRUCTION_NORMAL
+  U8  u8Cursor;                                  //!< LOOP: index of the first instruction of the block; CALL: index of the instruction after the CALL
+  U8  u8Passes;                                  //!< LOOP: passes left, the running one included; 0 for a CALL
+} S_ANIMATION_FRAME;
+
+//! \brief State of a program of normal LED instructions: the base one or a layer
+typedef struct
+{
+  U8* pu8Levels;                                 //!< Brightness levels written by the instructions
+  U16 u16Timer;                                  //!< Ms resolution timer of the track
+  U16 u16Deadline;                               //!< Value of u16Timer when the next instruction starts
+  U8  u8Cursor;                                  //!< Index of the next instruction to be executed
+  U8  u8LastState;                               //!< Previously executed instruction index
+  U8  u8RepetitionCounter;                       //!< Instruction repetition counter
+  S_ANIMATION_LERP sLerp;                        //!< Running fade
+  S_ANIMATION_GENERATOR sGenerator;              //!< Running generator
+  const S_ANIMATION_INSTRUCTION_NORMAL CODE* psCode;  //!< Program of the CALL running; NULL: the program of the track itself
+  U8  u8CodeLength;                              //!< Number of instructions of psCode
+  U8  u8CodeFormat;                              //!< Layout of psCode: MIRROR, FRAMES or 0 for S_ANIMATION_INSTRUCTION_NORMAL
+  U8  u8Format;                                  //!< Layout of the program of the track itself, as u8CodeFormat
+  S_ANIMATION_INSTRUCTION_NORMAL sExpanded;      //!< The last S_ANIMATION_INSTRUCTION_HALF or _FRAME fetched, expanded to a normal one
+  U8  au8Palette[ PALETTE_SIZE ];                //!< Levels of the PALETTE_FRAME arrays, set by PALETTE; a CALLed program shares it
+  U8  u8Depth;                                   //!< LOOPs and CALLs running; the ones beyond ANIMATION_STACK_DEPTH aren't stored in asStack[]
+  S_ANIMATION_FRAME asStack[ ANIMATION_STACK_DEPTH ];  //!< Return stack, the innermost one last
+  U16 (*pfNative)( U16* pu16Resume, U8* pu8Levels );  //!< Native animation run in place of the program, see NATIVE_BEGIN(); NULL for a table
+  U16 u16Resume;                                 //!< Where pfNative goes on: the line of its last NATIVE_YIELD(), 0 at its start
+} S_ANIMATION_TRACK;
+
+#if ANIMATION_CROSSFADE_MS
+//! \brief State of a crossfade from the last frame of the previous animation to the running one
+typedef struct
+{
+  U32 u32Mix;                                    //!< Weight of the running animation, 16.16 fixed point; CROSSFADE_END if there's no crossfade
+  U8  au8Frame[ LEDS_NUM + NUM_RGBLED_COLORS ];  //!< Last frame of the previous animation: normal LEDs, then the colors
+} S_ANIMATION_CROSSFADE;
+#endif
+
+//! \brief Layer of an animation: a program of normal LED instructions blended over the ones below
+typedef struct
+{
+  U8                                         u8Length;                 //!< How many instructions the layer has
+  const S_ANIMATION_INSTRUCTION_NORMAL CODE* psInstructions;           //!< Pointer to the instructions themselves
+  U16                                        u16Mask;                  //!< LEDs covered by the layer, bit n is LED n; the others are left alone
+  U8                                         u8Blend;                  //!< Blend mode (E_ANIMATION_BLEND)
+} S_ANIMATION_LAYER;
+
+//! \brief Figures of an animation measured by animc while it compiles it, so the drivers are set up once in Play()
+typedef struct
+{
+  U16 u16Levels;                                 //!< Levels lit on the normal LEDs, bit n is level n: 0x8001 for a binary animation
+  U16 u16MinStepMs;                              //!< Shortest instruction of the programs in ms; a LERP changes the LEDs more often, smoothly
+  U8  u8PeakLoad;                                //!< Highest sum of the normal LED levels in a frame, of LEDS_NUM * LED_BRIGHTNESS_MAX
+  U8  u8Flags;                                   //!< PROFILE_RGB if the RGB LED is ever lit
+} S_ANIMATION_PROFILE;
+
 //! \brief Animation structure
 typedef struct
 {
@@ -77,21 +281,161 @@ typedef struct
   const S_ANIMATION_INSTRUCTION_NORMAL CODE* psInstructionsNormal;     //!< Pointer to the instructions themselves -- normal LEDs
   U8                                         u8AnimationLengthRGB;     //!< How many instructions this animation has for the RGB LED
   const S_ANIMATION_INSTRUCTION_RGB CODE*    psInstructionsRGB;        //!< Pointer to the instructions themselves -- RGB LED
+  U8                                         u8NumLayers;              //!< How many layers are blended over the normal LEDs, in order; 0 for most animations
+  const S_ANIMATION_LAYER CODE*              psLayers;                 //!< Pointer to the layers
+  U8                                         u8Options;                //!< Option bits (LOOP_RGB, MIRROR, FRAMES, FAST_REFRESH, BEACON), 0 if not given
+  const S_ANIMATION_PROFILE CODE*            psProfile;                //!< Figures of the animation from animc, NULL if not given
+  U16 (*pfNative)( U16* pu16Resume, U8* pu8Levels );                   //!< Native animation of the normal LEDs in place of the table, see NATIVE_BEGIN(); NULL if not given
 } S_ANIMATION;
 
+#if ANIMATION_RESUME
+//! \brief Snapshot of the programs of an animation, see Animation_Suspend()
+typedef struct
+{
+  U32 u32Magic;                                  //!< RESUME_MAGIC while the snapshot is valid
+  const S_ANIMATION CODE* psAnimation;           //!< The animation of the snapshot
+  S_ANIMATION_TRACK sTrackNormal;                //!< Its normal LED program
+  S_ANIMATION_LERP sLerpRGB;                     //!< The running fade of the RGB LED
+  U16 u16RGBTimer;                               //!< The RGB program: timer, deadline, cursor, last state, repetitions
+  U16 u16RGBDeadline;
+  U8  u8RGBCursor;
+  U8  u8LastStateRGB;
+  U8  u8RepetitionCounterRGB;
+  U8  u8SpeedFraction;                           //!< Fraction of a ms of the animation time
+  U8  au8Levels[ LEDS_NUM + NUM_RGBLED_COLORS ]; //!< gau8LEDBrightness[], then gau8RGBLEDs[]
+#if ANIMATION_MAX_LAYERS
+  U8  u8NumLayers;                               //!< The layers: their programs and levels
+  S_ANIMATION_TRACK asLayerTracks[ ANIMATION_MAX_LAYERS ];
+  U8  au8LayerLevels[ ANIMATION_MAX_LAYERS ][ LEDS_NUM ];
+#endif
+  U32 u32Seal;                                   //!< ~RESUME_MAGIC while the snapshot is valid: RAM just powered up matches both hardly ever
+} S_ANIMATION_RESUME;
+#endif
+
+#if ANIMATION_COMPILED
+//! \brief Entry of the table of the compiled programs, generated by tools/animgen.py
+typedef struct
+{
+  const S_ANIMATION_INSTRUCTION_NORMAL CODE* psInstructions;  //!< Program compiled, as in gasAnimations[]; NULL ends the table
+  BOOL (*pfExecute)( U8 u8Index, U8* pu8Levels );             //!< Runs the operations of instruction (u8Index) on the levels; FALSE if it has none
+} S_ANIMATION_COMPILED;
+#endif
+
 
 /***************************************< Constants >**************************************/
-//! \brief Retro animation -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasRetroVersion[ 8u ] = 
-{
-  {133u, {15,  0, 15,  0,  0, 15, 15,  0, 15,  0,  0, 15}, LOAD, 0u },
-  {133u, { 0, 15,  0, 15, 15,  0,  0, 15,  0, 15, 15,  0}, LOAD, 0u },
-  {133u, {15,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0}, LOAD, 0u },
-  {133u, { 0, 15,  0, 15, 15,  0,  0, 15,  0, 15, 15,  0}, LOAD, 0u },
-  {133u, {15,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0}, LOAD, 0u },
-  {133u, { 0,  0,  0, 15,  0,  0,  0,  0,  0, 15,  0,  0}, LOAD, 0u },
-  {133u, {15,  0, 15,  0,  0, 15, 15,  0,  0, 15,  0, 15}, LOAD, 0u },
-  {133u, { 0,  0,  0, 15,  0,  0,  0,  0,  0, 15,  0,  0}, LOAD, 0u },
+//! \brief Reciprocals of the small divisors of DIV, 2^16 / divisor rounded up; exact for every 8-bit dividend
+//! \note  The Cortex-M0+ has no divide instruction, a multiplication is a single cycle
+static CODE const U16 gcau16Reciprocal[ DIV_RECIPROCALS ] =
+{
+  0u, 0u, 32768u, 21846u, 16384u, 13108u, 10923u, 9363u, 8192u, 7282u, 6554u, 5958u, 5462u, 5042u, 4682u, 4370u
+};
+
+//! \brief Easing curves of LERP from EASE_IN on: progress of the fade at each of EASE_STEPS points, in 1/256
+//! \note  Computed by the compiler; a frame of an eased fade looks its progress up once
+static CODE const U8 gcaau8EaseCurve[ EASE_CURVES ][ EASE_STEPS ] =
+{
+  { EASE_POINTS( EASE_IN_AT ) },
+  { EASE_POINTS( EASE_OUT_AT ) },
+  { EASE_POINTS( EASE_SINE_AT ) }
+};
+
+//! \brief Playback rates of Animation_SetSpeed(), in 8.8 fixed point: real time first, then slower and faster
+static CODE const U16 gcau16SpeedQ8[ ANIMATION_SPEEDS ] =
+{
+  SPEED_ONE, SPEED_ONE / 2u, SPEED_ONE / 4u, SPEED_ONE * 2u
+};
+
+//! \brief Inverse of gcau16SpeedQ8[], in 8.8 fixed point
+static CODE const U16 gcau16SpeedInvQ8[ ANIMATION_SPEEDS ] =
+{
+  SPEED_ONE, SPEED_ONE * 2u, SPEED_ONE * 4u, SPEED_ONE / 2u
+};
+
+//! \brief Brightness arrays of the normal LED programs of S_ANIMATION_INSTRUCTION_FRAME, indexed by u8Frame
+//! \note  Shared by every animation: an array used by several instructions, of the same table or not, is stored once.
+//!         The arrays of the values of a palette are in gcau8PaletteFrames[] instead.
+static CODE const U8 gcau8Frames[ 5u ][ LEDS_NUM ] =
+{
+  { 0,  0,  0,  0,  0, -5, -5,  0,  0,  0,  0,  0},  //  0
+  { 1,  2,  1,  2,  1,  2,  1,  2,  1,  2,  1,  2},  //  1
+  { 2,  1,  2,  1,  2,  1,  2,  1,  2,  1,  2,  1},  //  2
+  { 4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4},  //  3
+  { 0,  4,  9, 15,  0,  0,  0,  0,  0,  0,  0,  0},  //  4
+};
+
+//! \brief Arrays of S_ANIMATION_INSTRUCTION_FRAME of the palette of the track, indexed by u8Frame without PALETTE_FRAME
+//! \note  2 bits a LED, LED 0 in the lowest bits of the first byte; the comments list the palette entries from LED 0 on
+static CODE const U8 gcau8PaletteFrames[ 50u ][ PALETTE_ROW_BYTES ] =
+{
+  {0x33u, 0x3Cu, 0xC3u},  //  0: 3 0 3 0 0 3 3 0 3 0 0 3
+  {0xCCu, 0xC3u, 0x3Cu},  //  1: 0 3 0 3 3 0 0 3 0 3 3 0
+  {0x03u, 0x30u, 0x00u},  //  2: 3 0 0 0 0 0 3 0 0 0 0 0
+  {0xC0u, 0x00u, 0x0Cu},  //  3: 0 0 0 3 0 0 0 0 0 3 0 0
+  {0x33u, 0x3Cu, 0xCCu},  //  4: 3 0 3 0 0 3 3 0 0 3 0 3
+  {0x39u, 0x00u, 0x00u},  //  5: 1 2 3 0 0 0 0 0 0 0 0 0
+  {0x00u, 0x00u, 0x00u},  //  6: 0 0 0 0 0 0 0 0 0 0 0 0
+  {0x00u, 0x09u, 0x00u},  //  7: 0 0 0 0 1 2 0 0 0 0 0 0
+  {0x00u, 0x34u, 0x00u},  //  8: 0 0 0 0 0 1 3 0 0 0 0 0
+  {0x00u, 0xE0u, 0x00u},  //  9: 0 0 0 0 0 0 2 3 0 0 0 0
+  {0x00u, 0x90u, 0x03u},  // 10: 0 0 0 0 0 0 1 2 3 0 0 0
+  {0x01u, 0x00u, 0x00u},  // 11: 1 0 0 0 0 0 0 0 0 0 0 0
+  {0x01u, 0x00u, 0x40u},  // 12: 1 0 0 0 0 0 0 0 0 0 0 1
+  {0xFFu, 0xEFu, 0xFFu},  // 13: 3 3 3 3 3 3 2 3 3 3 3 3
+  {0xCCu, 0xCCu, 0xCCu},  // 14: 0 3 0 3 0 3 0 3 0 3 0 3
+  {0x33u, 0x33u, 0x33u},  // 15: 3 0 3 0 3 0 3 0 3 0 3 0
+  {0xFFu, 0xFFu, 0xFFu},  // 16: 3 3 3 3 3 3 3 3 3 3 3 3
+  {0x03u, 0x00u, 0x00u},  // 17: 3 0 0 0 0 0 0 0 0 0 0 0
+  {0x30u, 0x00u, 0x00u},  // 18: 0 0 3 0 0 0 0 0 0 0 0 0
+  {0x00u, 0x00u, 0x03u},  // 19: 0 0 0 0 0 0 0 0 3 0 0 0
+  {0x00u, 0x03u, 0x00u},  // 20: 0 0 0 0 3 0 0 0 0 0 0 0
+  {0x00u, 0x30u, 0x00u},  // 21: 0 0 0 0 0 0 3 0 0 0 0 0
+  {0x00u, 0x0Cu, 0x00u},  // 22: 0 0 0 0 0 3 0 0 0 0 0 0
+  {0x00u, 0xC0u, 0x00u},  // 23: 0 0 0 0 0 0 0 3 0 0 0 0
+  {0xC0u, 0x00u, 0x00u},  // 24: 0 0 0 3 0 0 0 0 0 0 0 0
+  {0x00u, 0x00u, 0x0Cu},  // 25: 0 0 0 0 0 0 0 0 0 3 0 0
+  {0x00u, 0x00u, 0xC0u},  // 26: 0 0 0 0 0 0 0 0 0 0 0 3
+  {0x0Cu, 0x00u, 0x00u},  // 27: 0 3 0 0 0 0 0 0 0 0 0 0
+  {0x0Cu, 0x00u, 0x30u},  // 28: 0 3 0 0 0 0 0 0 0 0 3 0
+  {0x00u, 0x21u, 0x0Cu},  // 29: 0 0 0 0 1 0 2 0 0 3 0 0
+  {0xC0u, 0x10u, 0x08u},  // 30: 0 0 0 3 0 0 1 0 0 2 0 0
+  {0x83u, 0x00u, 0x04u},  // 31: 3 0 0 2 0 0 0 0 0 1 0 0
+  {0x42u, 0xC0u, 0x00u},  // 32: 2 0 0 1 0 0 0 3 0 0 0 0
+  {0x01u, 0x80u, 0xC0u},  // 33: 1 0 0 0 0 0 0 2 0 0 0 3
+  {0x00u, 0x40u, 0x83u},  // 34: 0 0 0 0 0 0 0 1 3 0 0 2
+  {0x30u, 0x00u, 0x42u},  // 35: 0 0 3 0 0 0 0 0 2 0 0 1
+  {0x20u, 0x00u, 0x31u},  // 36: 0 0 2 0 0 0 0 0 1 0 3 0
+  {0x10u, 0x0Cu, 0x20u},  // 37: 0 0 1 0 0 3 0 0 0 0 2 0
+  {0x0Cu, 0x08u, 0x10u},  // 38: 0 3 0 0 0 2 0 0 0 0 1 0
+  {0x08u, 0x07u, 0x00u},  // 39: 0 2 0 0 3 1 0 0 0 0 0 0
+  {0x04u, 0x32u, 0x00u},  // 40: 0 1 0 0 2 0 3 0 0 0 0 0
+  {0xE4u, 0x40u, 0x0Eu},  // 41: 0 1 2 3 0 0 0 1 2 3 0 0
+  {0x00u, 0x0Bu, 0x00u},  // 42: 0 0 0 0 3 2 0 0 0 0 0 0
+  {0xC0u, 0x36u, 0x00u},  // 43: 0 0 0 3 2 1 3 0 0 0 0 0
+  {0xB0u, 0xE1u, 0x00u},  // 44: 0 0 3 2 1 0 2 3 0 0 0 0
+  {0x6Cu, 0x90u, 0x03u},  // 45: 0 3 2 1 0 0 1 2 3 0 0 0
+  {0x1Bu, 0x40u, 0x0Eu},  // 46: 3 2 1 0 0 0 0 1 2 3 0 0
+  {0x07u, 0x00u, 0x39u},  // 47: 3 1 0 0 0 0 0 0 1 2 3 0
+  {0x03u, 0x00u, 0xE4u},  // 48: 3 0 0 0 0 0 0 0 0 1 2 3
+  {0x00u, 0x00u, 0xD0u},  // 49: 0 0 0 0 0 0 0 0 0 0 1 3
+};
+
+//! \brief Palette of a track at the start of each round of its program, until a PALETTE instruction
+static CODE const U8 gcau8DefaultPalette[ PALETTE_SIZE ] =
+{
+  0u, 5u, 10u, 15u
+};
+
+//! \brief Retro animation -- normal LEDs, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasRetroVersion[ 8u ] =
+{
+  {133u, PALETTE_FRAME |  0u, LOAD, 0u },
+  {133u, PALETTE_FRAME |  1u, LOAD, 0u },
+  {133u, PALETTE_FRAME |  2u, LOAD, 0u },
+  {133u, PALETTE_FRAME |  1u, LOAD, 0u },
+  {133u, PALETTE_FRAME |  2u, LOAD, 0u },
+  {133u, PALETTE_FRAME |  3u, LOAD, 0u },
+  {133u, PALETTE_FRAME |  4u, LOAD, 0u },
+  {133u, PALETTE_FRAME |  3u, LOAD, 0u },
 };
 //! \brief Retro animation -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasRetroVersionRGB[ 4u ] = 
@@ -103,50 +447,50 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasRetroVersionRGB[ 4u ] =
 };
 
 //--------------------------------------------------------
-//! \brief "Sine" wave flasher animation -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasSoftFlashing[ 4u ] = 
+//! \brief "Sine" wave flasher animation -- normal LEDs, the left side mirrored
+CODE const S_ANIMATION_INSTRUCTION_HALF gasSoftFlashing[ 4u ] = 
 {
-  {125u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,          0u },
-  {125u, { 1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1}, ADD | REPEAT, 14u },
-  {125u, {15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15}, LOAD,          0u }, 
-  {125u, {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, ADD | REPEAT, 14u },
+  { 125u, { 0,  0,  0,  0,  0,  0}, LOAD, 0u },
+  {1875u, {15, 15, 15, 15, 15, 15}, LERP, EASE_SINE },
+  { 125u, {15, 15, 15, 15, 15, 15}, LOAD, 0u }, 
+  {1875u, { 0,  0,  0,  0,  0,  0}, LERP, EASE_SINE },
 };
 //! \brief "Sine" wave flasher animation -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasSoftFlashingRGB[ 4u ] = 
 {
-  {125u, { 0,  0,  0}, LOAD,          0u },
-  {125u, { 1,  0,  0}, ADD | REPEAT, 14u },
-  {125u, {15,  0,  0}, LOAD,          0u }, 
-  {125u, {-1,  0,  0}, ADD | REPEAT, 14u },
+  { 125u, { 0,  0,  0}, LOAD, 0u },
+  {1875u, {15,  0,  0}, LERP, EASE_SINE },
+  { 125u, {15,  0,  0}, LOAD, 0u }, 
+  {1875u, { 0,  0,  0}, LERP, EASE_SINE },
 };
 
 //--------------------------------------------------------
-//! \brief "Fade ring" animation -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasFadeRing[ 3u ] =
+//! \brief "Fade ring" animation -- normal LEDs, the left side mirrored
+CODE const S_ANIMATION_INSTRUCTION_HALF gasFadeRing[ 3u ] =
 {
-  { 40u, {15,  1, 15,  1, 15,  1,  1, 15,  1, 15,  1, 15}, LOAD,          0u },
-  { 40u, {-1,  1, -1,  1, -1,  1,  1, -1,  1, -1,  1, -1}, ADD | REPEAT, 13u },
-  { 40u, { 1, -1,  1, -1,  1, -1, -1,  1, -1,  1, -1,  1}, ADD | REPEAT, 13u },
+  { 40u, {15,  1, 15,  1, 15,  1}, LOAD, 0u },
+  {560u, { 1, 15,  1, 15,  1, 15}, LERP, EASE_SINE },
+  {560u, {15,  1, 15,  1, 15,  1}, LERP, EASE_SINE },
 };
 //! \brief "Fade ring" animation -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasFadeRingRGB[ 3u ] =
 {
-  { 40u, {15,  1,  0}, LOAD,          0u },
-  { 40u, {-1,  0,  0}, ADD | REPEAT, 13u },
-  { 40u, { 1,  0,  0}, ADD | REPEAT, 13u },
+  { 40u, {15,  1,  0}, LOAD, 0u },
+  {560u, { 1,  1,  0}, LERP, EASE_SINE },
+  {560u, {15,  1,  0}, LERP, EASE_SINE },
 };
 
 //--------------------------------------------------------
-//! \brief Shooting star anticlockwise animation -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasShootingStar[ 7u ] = 
-{ 
-  {100u, { 5, 10, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 2u },
-  {100u, { 0,  0,  0,  0,  5, 10,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  5, 15,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0, 10, 15,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  5, 10, 15,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 4u },
+//! \brief Shooting star anticlockwise animation -- normal LEDs, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasShootingStar[ 7u ] =
+{
+  {100u, PALETTE_FRAME |  5u, LOAD,            0u },
+  {100u, PALETTE_FRAME |  6u, RSHIFT | REPEAT, 2u },
+  {100u, PALETTE_FRAME |  7u, LOAD,            0u },
+  {100u, PALETTE_FRAME |  8u, LOAD,            0u },
+  {100u, PALETTE_FRAME |  9u, LOAD,            0u },
+  {100u, PALETTE_FRAME | 10u, LOAD,            0u },
+  {100u, PALETTE_FRAME |  6u, RSHIFT | REPEAT, 4u },
 };
 //! \brief Shooting star anticlockwise animation -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasShootingStarRGB[ 4u ] = 
@@ -158,14 +502,14 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasShootingStarRGB[ 4u ] =
 };
 
 //--------------------------------------------------------
-//! \brief Star launch animation -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasStarLaunch[ 5u ] = 
-{
-  {400u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,              0u },
-  {200u, { 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,              0u },
-  {200u, { 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5}, USOURCE | REPEAT, 18u },
-  {200u, {15, 15, 15, 15, 15, 15, 10, 15, 15, 15, 15, 15}, LOAD,              0u },
-  {200u, { 0,  0,  0,  0,  0, -5, -5,  0,  0,  0,  0,  0}, DSOURCE | REPEAT, 16u },
+//! \brief Star launch animation -- normal LEDs, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasStarLaunch[ 5u ] =
+{
+  {400u, PALETTE_FRAME |  6u, LOAD,              0u },
+  {200u, PALETTE_FRAME | 11u, LOAD,              0u },
+  {200u, PALETTE_FRAME | 12u, USOURCE | REPEAT, 18u },
+  {200u, PALETTE_FRAME | 13u, LOAD,              0u },
+  {200u,                  0u, DSOURCE | REPEAT, 16u },
 };
 //! \brief Star launch animation -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasStarLaunchRGB[ 5u ] = 
@@ -178,11 +522,11 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasStarLaunchRGB[ 5u ] =
 };
 
 //--------------------------------------------------------
-//! \brief Generic flasher animation -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasGenericFlasher[ 2u ] = 
+//! \brief Generic flasher animation -- normal LEDs, the left side mirrored
+CODE const S_ANIMATION_INSTRUCTION_HALF gasGenericFlasher[ 2u ] = 
 {
-  {500u, {15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15}, LOAD, 0u }, 
-  {500u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD, 0u },
+  {500u, {15, 15, 15, 15, 15, 15}, LOAD, 0u }, 
+  {500u, { 0,  0,  0,  0,  0,  0}, LOAD, 0u },
 };
 //! \brief Generic flasher animation -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasGenericFlasherRGB[ 2u ] = 
@@ -192,31 +536,31 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasGenericFlasherRGB[ 2u ] =
 };
 
 //--------------------------------------------------------
-//! \brief KITT animation -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasKITT[ 22u ] = 
-{
-  {200u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {100u, { 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5}, LOAD,  0u },
-  {100u, {10,  5,  0,  0,  0,  0,  0,  0,  0,  0,  5, 10}, LOAD,  0u },
-  {100u, {15, 10,  5,  0,  0,  0,  0,  0,  0,  5, 10, 15}, LOAD,  0u },
-  {100u, {10, 15, 10,  5,  0,  0,  0,  0,  5, 10, 15, 10}, LOAD,  0u },
-  {100u, { 5, 10, 15, 10,  5,  0,  0,  5, 10, 15, 10,  5}, LOAD,  0u },
-  {100u, { 0,  5, 10, 15, 10,  5,  5, 10, 15, 10,  5,  0}, LOAD,  0u },
-  {100u, { 0,  0,  5, 10, 15, 10, 10, 15, 10,  5,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  5, 10, 15, 15, 10,  5,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  0,  5, 10, 10,  5,  0,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  0,  0,  5,  5,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  0,  0,  5,  5,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  0,  5, 10, 10,  5,  0,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  0,  5, 10, 15, 15, 10,  5,  0,  0,  0}, LOAD,  0u },
-  {100u, { 0,  0,  5, 10, 15, 10, 10, 15, 10,  5,  0,  0}, LOAD,  0u },
-  {100u, { 0,  5, 10, 15, 10,  5,  5, 10, 15, 10,  5,  0}, LOAD,  0u },
-  {100u, { 5, 10, 15, 10,  5,  0,  0,  5, 10, 15, 10,  5}, LOAD,  0u },
-  {100u, {10, 15, 10,  5,  0,  0,  0,  0,  5, 10, 15, 10}, LOAD,  0u },
-  {100u, {15, 10,  5,  0,  0,  0,  0,  0,  0,  5, 10, 15}, LOAD,  0u },
-  {100u, {10,  5,  0,  0,  0,  0,  0,  0,  0,  0,  5, 10}, LOAD,  0u },
-  {100u, { 5,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5}, LOAD,  0u },
+//! \brief KITT animation -- normal LEDs, the left side mirrored
+CODE const S_ANIMATION_INSTRUCTION_HALF gasKITT[ 22u ] = 
+{
+  {200u, { 0,  0,  0,  0,  0,  0}, LOAD,  0u },
+  {100u, { 5,  0,  0,  0,  0,  0}, LOAD,  0u },
+  {100u, {10,  5,  0,  0,  0,  0}, LOAD,  0u },
+  {100u, {15, 10,  5,  0,  0,  0}, LOAD,  0u },
+  {100u, {10, 15, 10,  5,  0,  0}, LOAD,  0u },
+  {100u, { 5, 10, 15, 10,  5,  0}, LOAD,  0u },
+  {100u, { 0,  5, 10, 15, 10,  5}, LOAD,  0u },
+  {100u, { 0,  0,  5, 10, 15, 10}, LOAD,  0u },
+  {100u, { 0,  0,  0,  5, 10, 15}, LOAD,  0u },
+  {100u, { 0,  0,  0,  0,  5, 10}, LOAD,  0u },
+  {100u, { 0,  0,  0,  0,  0,  5}, LOAD,  0u },
+  {100u, { 0,  0,  0,  0,  0,  0}, LOAD,  0u },
+  {100u, { 0,  0,  0,  0,  0,  5}, LOAD,  0u },
+  {100u, { 0,  0,  0,  0,  5, 10}, LOAD,  0u },
+  {100u, { 0,  0,  0,  5, 10, 15}, LOAD,  0u },
+  {100u, { 0,  0,  5, 10, 15, 10}, LOAD,  0u },
+  {100u, { 0,  5, 10, 15, 10,  5}, LOAD,  0u },
+  {100u, { 5, 10, 15, 10,  5,  0}, LOAD,  0u },
+  {100u, {10, 15, 10,  5,  0,  0}, LOAD,  0u },
+  {100u, {15, 10,  5,  0,  0,  0}, LOAD,  0u },
+  {100u, {10,  5,  0,  0,  0,  0}, LOAD,  0u },
+  {100u, { 5,  0,  0,  0,  0,  0}, LOAD,  0u },
 };
 //! \brief KITT animation -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasKITTRGB[ 4u ] = 
@@ -228,15 +572,15 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasKITTRGB[ 4u ] =
 };
 
 //--------------------------------------------------------
-//! \brief Disco animation -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasDisco[ 6u ] = 
-{
-  {40u, {  0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15}, LOAD,         0u },
-  {40u, {  1,  2,  1,  2,  1,  2,  1,  2,  1,  2,  1,  2}, DIV | REPEAT, 3u },
-  {100u,{  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,         0u },
-  {40u, { 15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0}, LOAD,         0u },
-  {40u, {  2,  1,  2,  1,  2,  1,  2,  1,  2,  1,  2,  1}, DIV | REPEAT, 3u },
-  {100u,{  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,         0u },
+//! \brief Disco animation -- normal LEDs, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasDisco[ 6u ] =
+{
+  {40u, PALETTE_FRAME | 14u, LOAD,         0u },
+  {40u,                  1u, DIV | REPEAT, 3u },
+  {100u, PALETTE_FRAME |  6u, LOAD,         0u },
+  {40u, PALETTE_FRAME | 15u, LOAD,         0u },
+  {40u,                  2u, DIV | REPEAT, 3u },
+  {100u, PALETTE_FRAME |  6u, LOAD,         0u },
 };
 //! \brief Disco animation -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasDiscoRGB[ 6u ] = 
@@ -250,24 +594,10 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasDiscoRGB[ 6u ] =
 };
 
 //--------------------------------------------------------
-//! \brief Pseudo-random fade animation -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasPseudoRandomFade[ 15u ] = 
-{
-  { 66u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  { 66u, { 0,  0,  0,  0,  0,  0,  0,  1,  0,  0,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  1,  0,  0,  0,  0, -1,  0,  0,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0, -1,  0,  0,  0,  0,  0,  0,  0,  1,  0}, ADD | REPEAT, 14u },
-  { 66u, { 1,  0,  0,  0,  0,  0,  0,  0,  0,  0, -1,  0}, ADD | REPEAT, 14u },
-  { 66u, {-1,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  0,  0,  0, -1,  0,  1,  0,  0,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  0,  0,  0,  0,  0, -1,  0,  0,  0,  1}, ADD | REPEAT, 14u },
-  { 66u, { 0,  1,  0,  0,  0,  0,  0,  0,  0,  0,  0, -1}, ADD | REPEAT, 14u },
-  { 66u, { 0, -1,  0,  1,  0,  0,  0,  0,  0,  0,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  0, -1,  0,  0,  1,  0,  0,  0,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  0,  0,  0,  0, -1,  0,  0,  0,  0,  0}, ADD | REPEAT, 14u },  //RGB lights up here
-  { 66u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  0,  0,  1,  0,  0,  0,  0, -1,  0,  0}, ADD | REPEAT, 14u },
-  { 66u, { 0,  0,  0,  0, -1,  0,  0,  0,  0,  0,  0,  0}, ADD | REPEAT, 14u },
+//! \brief Pseudo-random fade animation -- normal LEDs, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasPseudoRandomFade[ 1u ] =
+{
+  {13926u, PALETTE_FRAME | 16u, GENERATE, GENERATOR( GEN_FADE, 64u ) },
 };
 //! \brief Pseudo-random fade animation -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasPseudoRandomFadeRGB[ 4u ] = 
@@ -279,22 +609,21 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasPseudoRandomFadeRGB[ 4u ] =
 };
 
 //--------------------------------------------------------
-//! \brief CrissCross -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasCrissCross[ 12u ] = 
-{
-        //0    1   2   3   4   5   6   7   8   9  10  11
-  {350u, {15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15}, LOAD,  0u },
-  {350u, { 0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0, 15,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0}, LOAD,  0u },
+//! \brief CrissCross -- normal LEDs, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasCrissCross[ 12u ] =
+{
+  {350u, PALETTE_FRAME | 17u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 18u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 19u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 20u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 21u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 22u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 23u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 24u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 25u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 26u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 27u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 28u, LOAD,  0u },
 };
 //! \brief CrissCross -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasCrissCrossRGB[ 4u ] = 
@@ -306,21 +635,22 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasCrissCrossRGB[ 4u ] =
 };
 
 //--------------------------------------------------------
-//! \brief Fadeout -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasFadeout[ 12u ] = 
-{
-  {350u, { 0,  0,  0,  0,  4,  0,  9,  0,  0, 15,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0, 15,  0,  0,  4,  0,  0,  9,  0,  0}, LOAD,  0u },
-  {350u, {15,  0,  0,  9,  0,  0,  0,  0,  0,  4,  0,  0}, LOAD,  0u },
-  {350u, { 9,  0,  0,  4,  0,  0,  0, 15,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 4,  0,  0,  0,  0,  0,  0,  9,  0,  0,  0, 15}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0,  0,  4, 15,  0,  0,  9}, LOAD,  0u },
-  {350u, { 0,  0, 15,  0,  0,  0,  0,  0,  9,  0,  0,  4}, LOAD,  0u },
-  {350u, { 0,  0,  9,  0,  0,  0,  0,  0,  4,  0, 15,  0}, LOAD,  0u },
-  {350u, { 0,  0,  4,  0,  0, 15,  0,  0,  0,  0,  9,  0}, LOAD,  0u },
-  {350u, { 0, 15,  0,  0,  0,  9,  0,  0,  0,  0,  4,  0}, LOAD,  0u },
-  {350u, { 0,  9,  0,  0, 15,  4,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  4,  0,  0,  9,  0, 15,  0,  0,  0,  0,  0}, LOAD,  0u },
+//! \brief Fadeout -- normal LEDs, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasFadeout[ 13u ] =
+{
+  {  0u,                  4u, PALETTE, 0u },  // the levels of the arrays: 0, 4, 9, 15
+  {350u, PALETTE_FRAME | 29u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 30u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 31u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 32u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 33u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 34u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 35u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 36u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 37u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 38u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 39u, LOAD,  0u },
+  {350u, PALETTE_FRAME | 40u, LOAD,  0u },
 };
 //! \brief Fadeout -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasFadeoutRGB[ 6u ] = 
@@ -334,19 +664,10 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasFadeoutRGB[ 6u ] =
 };
 
 //--------------------------------------------------------
-//! \brief Flicker -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasFlicker[ 10u ] = 
-{
-  {200u, { 0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0}, LOAD,  0u },
-  {200u, { 0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {200u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0}, LOAD,  0u },
-  {200u, { 0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {200u, {15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {200u, { 0, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {200u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15}, LOAD,  0u },
-  {200u, { 0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0}, LOAD,  0u },
-  {200u, { 0,  0,  0, 15,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {200u, { 0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0}, LOAD,  0u },
+//! \brief Flicker -- normal LEDs, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasFlicker[ 1u ] =
+{
+  {2000u, PALETTE_FRAME |  6u, GENERATE, GENERATOR( GEN_SPARKLE, 200u ) },
 };
 //! \brief Flicker -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasFlickerRGB[ 6u ] = 
@@ -360,21 +681,21 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasFlickerRGB[ 6u ] =
 };
 
 //--------------------------------------------------------
-//! \brief Pingpong -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasPingpong[ 12u ] = 
-{
-  {175u, {15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT,4u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT,4u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LSHIFT | REPEAT,4u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LSHIFT | REPEAT,4u },
-  {175u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
+//! \brief Pingpong -- normal LEDs, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasPingpong[ 12u ] =
+{
+  {175u, PALETTE_FRAME | 17u, LOAD,  0u },
+  {175u, PALETTE_FRAME |  6u, RSHIFT | REPEAT,4u },
+  {175u, PALETTE_FRAME |  6u, LOAD,  0u },
+  {175u, PALETTE_FRAME | 21u, LOAD,  0u },
+  {175u, PALETTE_FRAME |  6u, RSHIFT | REPEAT,4u },
+  {175u, PALETTE_FRAME |  6u, LOAD,  0u },
+  {175u, PALETTE_FRAME | 26u, LOAD,  0u },
+  {175u, PALETTE_FRAME |  6u, LSHIFT | REPEAT,4u },
+  {175u, PALETTE_FRAME |  6u, LOAD,  0u },
+  {175u, PALETTE_FRAME | 22u, LOAD,  0u },
+  {175u, PALETTE_FRAME |  6u, LSHIFT | REPEAT,4u },
+  {175u, PALETTE_FRAME |  6u, LOAD,  0u },
 };
 //! \brief Pingpong -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasPingpongRGB[ 3u ] = 
@@ -385,19 +706,10 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasPingpongRGB[ 3u ] =
 };
 
 //--------------------------------------------------------
-//! \brief Sparkle -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasSparkle[ 10u ] = 
-{
-  {200u, { 4,  4,  4,  4, 15,  4,  4,  4,  4,  4,  4,  4}, LOAD,  0u },
-  {200u, { 4, 15,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4}, LOAD,  0u },
-  {200u, { 4,  4,  4,  4,  4,  4, 15,  4,  4,  4,  4,  4}, LOAD,  0u },
-  {200u, { 4,  4,  4,  4,  4,  4,  4,  4,  4,  4, 15,  4}, LOAD,  0u },
-  {200u, { 4,  4, 15,  4,  4,  4,  4,  4,  4,  4,  4,  4}, LOAD,  0u },
-  {200u, {15,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4}, LOAD,  0u },
-  {200u, { 4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4, 15}, LOAD,  0u },
-  {200u, { 4,  4,  4, 15,  4,  4,  4,  4,  4,  4,  4,  4}, LOAD,  0u },
-  {200u, { 4,  4,  4,  4,  4,  4,  4,  4,  4, 15,  4,  4}, LOAD,  0u },
-  {200u, { 4,  4,  4,  4,  4, 15,  4,  4,  4,  4,  4,  4}, LOAD,  0u },
+//! \brief Sparkle -- normal LEDs, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasSparkle[ 1u ] =
+{
+  {2000u,  3u, GENERATE, GENERATOR( GEN_SPARKLE, 200u ) },
 };
 //! \brief Sparkle -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasSparkleRGB[ 6u ] = 
@@ -411,11 +723,11 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasSparkleRGB[ 6u ] =
 };
 
 //--------------------------------------------------------
-//! \brief Split2 -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasSplit2[ 2u ] = 
+//! \brief Split2 -- normal LEDs, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasSplit2[ 2u ] =
 {
-  {500u, {15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0}, LOAD,  0u },
-  {500u, { 0, 15,  0, 15,  0, 15,  0, 15,  0, 15,  0, 15}, LOAD,  0u },
+  {500u, PALETTE_FRAME | 15u, LOAD,  0u },
+  {500u, PALETTE_FRAME | 14u, LOAD,  0u },
 };
 //! \brief Split2 -- RGB LED
 CODE const S_ANIMATION_INSTRUCTION_RGB gasSplit2RGB[ 3u ] = 
@@ -450,11 +762,11 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasSplit3fadeRGB[ 6u ] =
 */
 
 //--------------------------------------------------------
-//! \brief Stepping -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasStepping[ 2u ] = 
+//! \brief Stepping -- normal LEDs, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasStepping[ 2u ] =
 {
-  {350u, {15,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {350u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT,10u },
+  {350u, PALETTE_FRAME | 17u, LOAD,  0u },
+  {350u, PALETTE_FRAME |  6u, RSHIFT | REPEAT,10u },
 };
 
 
@@ -475,30 +787,44 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasSteppingRGB[ 11u ] =
 };
 
 //--------------------------------------------------------
-//! \brief Race -- A trace is circulating and accelerating
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasRace[ 21u ] = 
-{
-  {100u, { 5, 10, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 2u },
-  {100u, { 0,  0,  0,  0,  5, 10,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  5, 15,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0, 10, 15,  0,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  5, 10, 15,  0,  0,  0}, LOAD,            0u },
-  {100u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 4u },
-  {70u, { 5, 10, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {70u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 2u },
-  {70u, { 0,  0,  0,  0,  5, 10,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {70u, { 0,  0,  0,  0,  0,  5, 15,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {70u, { 0,  0,  0,  0,  0,  0, 10, 15,  0,  0,  0,  0}, LOAD,            0u },
-  {70u, { 0,  0,  0,  0,  0,  0,  5, 10, 15,  0,  0,  0}, LOAD,            0u },
-  {70u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 4u },
-  {40u, { 5, 10, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {40u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 2u },
-  {40u, { 0,  0,  0,  0,  5, 10,  0,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {40u, { 0,  0,  0,  0,  0,  5, 15,  0,  0,  0,  0,  0}, LOAD,            0u },
-  {40u, { 0,  0,  0,  0,  0,  0, 10, 15,  0,  0,  0,  0}, LOAD,            0u },
-  {40u, { 0,  0,  0,  0,  0,  0,  5, 10, 15,  0,  0,  0}, LOAD,            0u },
-  {40u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 4u },
+//! \brief Beacon -- normal LEDs: D3 blinks every 3 s; with BEACON the blink is held in stop mode, at full drive
+CODE const S_ANIMATION_INSTRUCTION_NORMAL gasBeacon[ 2u ] =
+{
+  {  15u, { 0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0}, LOAD,  0u },
+  {2985u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
+};
+
+//! \brief Beacon -- RGB LED, dark: a lit RGB LED needs the multiplexing
+CODE const S_ANIMATION_INSTRUCTION_RGB gasBeaconRGB[ 1u ] =
+{
+  {3000u, { 0,  0,  0}, LOAD,  0u },
+};
+
+//--------------------------------------------------------
+//! \brief Race -- A trace is circulating and accelerating, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasRace[ 21u ] =
+{
+  {100u, PALETTE_FRAME |  5u, LOAD,            0u },
+  {100u, PALETTE_FRAME |  6u, RSHIFT | REPEAT, 2u },
+  {100u, PALETTE_FRAME |  7u, LOAD,            0u },
+  {100u, PALETTE_FRAME |  8u, LOAD,            0u },
+  {100u, PALETTE_FRAME |  9u, LOAD,            0u },
+  {100u, PALETTE_FRAME | 10u, LOAD,            0u },
+  {100u, PALETTE_FRAME |  6u, RSHIFT | REPEAT, 4u },
+  {70u, PALETTE_FRAME |  5u, LOAD,            0u },
+  {70u, PALETTE_FRAME |  6u, RSHIFT | REPEAT, 2u },
+  {70u, PALETTE_FRAME |  7u, LOAD,            0u },
+  {70u, PALETTE_FRAME |  8u, LOAD,            0u },
+  {70u, PALETTE_FRAME |  9u, LOAD,            0u },
+  {70u, PALETTE_FRAME | 10u, LOAD,            0u },
+  {70u, PALETTE_FRAME |  6u, RSHIFT | REPEAT, 4u },
+  {40u, PALETTE_FRAME |  5u, LOAD,            0u },
+  {40u, PALETTE_FRAME |  6u, RSHIFT | REPEAT, 2u },
+  {40u, PALETTE_FRAME |  7u, LOAD,            0u },
+  {40u, PALETTE_FRAME |  8u, LOAD,            0u },
+  {40u, PALETTE_FRAME |  9u, LOAD,            0u },
+  {40u, PALETTE_FRAME | 10u, LOAD,            0u },
+  {40u, PALETTE_FRAME |  6u, RSHIFT | REPEAT, 4u },
 };
 //! \brief Race -- RGB
 CODE const S_ANIMATION_INSTRUCTION_RGB gasRaceRGB[ 12u ] = 
@@ -520,11 +846,11 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasRaceRGB[ 12u ] =
 };
 
 //--------------------------------------------------------
-//! \brief Ying-yang
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasYingYang[ 2u ] = 
+//! \brief Ying-yang, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasYingYang[ 2u ] =
 {
-  {150u, { 0,  5, 10, 15,  0,  0,  0,  5, 10, 15,  0,  0}, LOAD,            0u },
-  {150u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, RSHIFT | REPEAT, 4u },
+  {150u, PALETTE_FRAME | 41u, LOAD,            0u },
+  {150u, PALETTE_FRAME |  6u, RSHIFT | REPEAT, 4u },
 };
 //! \brief Ying Yang RGB
 CODE const S_ANIMATION_INSTRUCTION_RGB gasYingYangRGB[ 2u ] = 
@@ -534,20 +860,20 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasYingYangRGB[ 2u ] =
 };
 
 //--------------------------------------------------------
-//! \brief Ice
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasIce[ 11u ] = 
-{
-  {300u, { 0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {300u, { 0,  0,  0,  0, 15, 10,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
-  {300u, { 0,  0,  0, 15, 10,  5, 15,  0,  0,  0,  0,  0}, LOAD, 0u },
-  {300u, { 0,  0, 15, 10,  5,  0, 10, 15,  0,  0,  0,  0}, LOAD, 0u },
-  {300u, { 0, 15, 10,  5,  0,  0,  5, 10, 15,  0,  0,  0}, LOAD, 0u },
-  {300u, {15, 10,  5,  0,  0,  0,  0,  5, 10, 15,  0,  0}, LOAD, 0u },
-  {300u, {15,  5,  0,  0,  0,  0,  0,  0,  5, 10, 15,  0}, LOAD, 0u },
-  {300u, {15,  0,  0,  0,  0,  0,  0,  0,  0,  5, 10, 15}, LOAD, 0u },
-  {300u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5, 15}, LOAD, 0u },
-  {300u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15}, LOAD, 0u },
-  {300u, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD,  0u },
+//! \brief Ice, the arrays in gcau8Frames[]
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasIce[ 11u ] =
+{
+  {300u, PALETTE_FRAME | 22u, LOAD,  0u },
+  {300u, PALETTE_FRAME | 42u, LOAD,  0u },
+  {300u, PALETTE_FRAME | 43u, LOAD, 0u },
+  {300u, PALETTE_FRAME | 44u, LOAD, 0u },
+  {300u, PALETTE_FRAME | 45u, LOAD, 0u },
+  {300u, PALETTE_FRAME | 46u, LOAD, 0u },
+  {300u, PALETTE_FRAME | 47u, LOAD, 0u },
+  {300u, PALETTE_FRAME | 48u, LOAD, 0u },
+  {300u, PALETTE_FRAME | 49u, LOAD, 0u },
+  {300u, PALETTE_FRAME | 26u, LOAD, 0u },
+  {300u, PALETTE_FRAME |  6u, LOAD,  0u },
 };
 //! \brief Ice
 CODE const S_ANIMATION_INSTRUCTION_RGB gasIceRGB[ 2u ] = 
@@ -559,62 +885,280 @@ CODE const S_ANIMATION_INSTRUCTION_RGB gasIceRGB[ 2u ] =
 };
 
 //--------------------------------------------------------
-//! \brief All blackness, reached right before going to power down mode -- normal LEDs
-CODE const S_ANIMATION_INSTRUCTION_NORMAL gasBlackness[ 1u ] =
+//! \brief All blackness, reached right before going to power down mode: the frame shown fades out, then it stays dark -- normal LEDs, the arrays in gcau8Frames[]
+//! \note  Played without a crossfade, the LERP starts from the levels of the animation interrupted
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasBlackness[ 2u ] =
 {
-  {0xFFFFu, { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0}, LOAD, 0u },
+  {ANIMATION_FADE_OUT_MS, PALETTE_FRAME | 6u, LERP, 0u },
+  {0xFFFFu,               PALETTE_FRAME | 6u, LOAD, 0u },
 };
 //! \brief All blackness, reached right before going to power down mode -- RGB LED
-CODE const S_ANIMATION_INSTRUCTION_RGB gasBlacknessRGB[ 1u ] =
+CODE const S_ANIMATION_INSTRUCTION_RGB gasBlacknessRGB[ 2u ] =
 {
+  {ANIMATION_FADE_OUT_MS, { 0,  0,  0}, LERP, 0u },
   {0xFFFFu, { 0,  0,  0}, LOAD, 0u },
 };
 
+#if ANIMATION_IN_SET( BOUNCE )
+//--------------------------------------------------------
+//! \brief Bouncing ball -- normal LEDs, drawn by Bounce()
+static U16 Bounce( U16* pu16Resume, U8* pu8Levels );
+//! \brief Bouncing ball -- RGB LED
+CODE const S_ANIMATION_INSTRUCTION_RGB gasBounceRGB[ 1u ] =
+{
+  {0xFFFFu, { 0,  0,  0}, LOAD, 0u },
+};
+#endif
+
 // *******************************************************
 //! \brief Table of animations
 CODE const S_ANIMATION gasAnimations[ NUM_ANIMATIONS ] = 
 {
-  {sizeof(gasRetroVersion)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasRetroVersion,     sizeof(gasRetroVersionRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasRetroVersionRGB },
-  {sizeof(gasSoftFlashing)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSoftFlashing,     sizeof(gasSoftFlashingRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSoftFlashingRGB },
-//  {sizeof(gasShootingStar)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasShootingStar,     sizeof(gasShootingStarRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasShootingStarRGB },
-  {sizeof(gasDisco)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),            gasDisco,            sizeof(gasDiscoRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),            gasDiscoRGB },
-  {sizeof(gasStarLaunch)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),       gasStarLaunch,       sizeof(gasStarLaunchRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),       gasStarLaunchRGB },
-  {sizeof(gasCrissCross)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),       gasCrissCross,       sizeof(gasCrissCrossRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),       gasCrissCrossRGB },
-  {sizeof(gasGenericFlasher)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),   gasGenericFlasher,   sizeof(gasGenericFlasherRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),   gasGenericFlasherRGB },
-  {sizeof(gasKITT)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),             gasKITT,             sizeof(gasKITTRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),             gasKITTRGB },
-  {sizeof(gasPingpong)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasPingpong,     sizeof(gasPingpongRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasPingpongRGB },
-  {sizeof(gasFadeRing)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),         gasFadeRing,         sizeof(gasFadeRingRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),         gasFadeRingRGB },
-  {sizeof(gasYingYang)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasYingYang,     sizeof(gasYingYangRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasYingYangRGB },
-  {sizeof(gasPseudoRandomFade)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL), gasPseudoRandomFade, sizeof(gasPseudoRandomFadeRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB), gasPseudoRandomFadeRGB },
-
-//  {sizeof(gasFadeout)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasFadeout,     sizeof(gasFadeoutRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasFadeoutRGB },
-  {sizeof(gasFlicker)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasFlicker,     sizeof(gasFlickerRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasFlickerRGB },
-  {sizeof(gasRace)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasRace,     sizeof(gasRaceRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasRaceRGB },
-  {sizeof(gasSparkle)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSparkle,     sizeof(gasSparkleRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSparkleRGB },
-  {sizeof(gasIce)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasIce,     sizeof(gasIceRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasIceRGB },
-  {sizeof(gasSplit2)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSplit2,     sizeof(gasSplit2RGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSplit2RGB },
-//  {sizeof(gasSplit3fade)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSplit3fade,     sizeof(gasSplit3fadeRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSplit3fadeRGB },
-  {sizeof(gasStepping)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasStepping,     sizeof(gasSteppingRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSteppingRGB },
+#if ANIMATION_IN_SET( RETRO_VERSION )
+  {sizeof(gasRetroVersion)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasRetroVersion, sizeof(gasRetroVersionRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasRetroVersionRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( SOFT_FLASHING )
+  {sizeof(gasSoftFlashing)/sizeof(S_ANIMATION_INSTRUCTION_HALF), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasSoftFlashing, sizeof(gasSoftFlashingRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSoftFlashingRGB, 0u, NULL, MIRROR, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( SHOOTING_STAR )
+  {sizeof(gasShootingStar)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasShootingStar, sizeof(gasShootingStarRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasShootingStarRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( DISCO )
+  {sizeof(gasDisco)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasDisco, sizeof(gasDiscoRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),            gasDiscoRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( STAR_LAUNCH )
+  {sizeof(gasStarLaunch)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasStarLaunch, sizeof(gasStarLaunchRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),       gasStarLaunchRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( CRISS_CROSS )
+  {sizeof(gasCrissCross)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasCrissCross, sizeof(gasCrissCrossRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),       gasCrissCrossRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( GENERIC_FLASHER )
+  {sizeof(gasGenericFlasher)/sizeof(S_ANIMATION_INSTRUCTION_HALF), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasGenericFlasher, sizeof(gasGenericFlasherRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),   gasGenericFlasherRGB, 0u, NULL, MIRROR, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( KITT )
+  {sizeof(gasKITT)/sizeof(S_ANIMATION_INSTRUCTION_HALF), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasKITT, sizeof(gasKITTRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),             gasKITTRGB, 0u, NULL, MIRROR, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( PINGPONG )
+  {sizeof(gasPingpong)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasPingpong, sizeof(gasPingpongRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasPingpongRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( FADE_RING )
+  {sizeof(gasFadeRing)/sizeof(S_ANIMATION_INSTRUCTION_HALF), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasFadeRing, sizeof(gasFadeRingRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),         gasFadeRingRGB, 0u, NULL, MIRROR, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( YING_YANG )
+  {sizeof(gasYingYang)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasYingYang, sizeof(gasYingYangRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasYingYangRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( PSEUDO_RANDOM_FADE )
+  {sizeof(gasPseudoRandomFade)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasPseudoRandomFade, sizeof(gasPseudoRandomFadeRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB), gasPseudoRandomFadeRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( FADEOUT )
+  {sizeof(gasFadeout)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasFadeout, sizeof(gasFadeoutRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasFadeoutRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( FLICKER )
+  {sizeof(gasFlicker)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasFlicker, sizeof(gasFlickerRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasFlickerRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( RACE )
+  {sizeof(gasRace)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasRace, sizeof(gasRaceRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasRaceRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( SPARKLE )
+  {sizeof(gasSparkle)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasSparkle, sizeof(gasSparkleRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSparkleRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( ICE )
+  {sizeof(gasIce)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasIce, sizeof(gasIceRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasIceRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( SPLIT2 )
+  {sizeof(gasSplit2)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasSplit2, sizeof(gasSplit2RGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSplit2RGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( SPLIT3FADE )
+  {sizeof(gasSplit3fade)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasSplit3fade,     sizeof(gasSplit3fadeRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSplit3fadeRGB, 0u, NULL, 0u, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( STEPPING )
+  {sizeof(gasStepping)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasStepping, sizeof(gasSteppingRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSteppingRGB, 0u, NULL, FRAMES, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( BEACON )
+  {sizeof(gasBeacon)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasBeacon,     sizeof(gasBeaconRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasBeaconRGB, 0u, NULL, BEACON, NULL, NULL },
+#endif
+#if ANIMATION_IN_SET( BOUNCE )
+  {1u,                                                         NULL,          sizeof(gasBounceRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasBounceRGB, 0u, NULL, 0u, NULL, Bounce },
+#endif
 
   // Last animation, don't change its location
-  {sizeof(gasStepping)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),     gasStepping,     sizeof(gasSteppingRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),     gasSteppingRGB },
-//  {sizeof(gasBlackness)/sizeof(S_ANIMATION_INSTRUCTION_NORMAL),        gasBlackness,        sizeof(gasBlacknessRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),        gasBlackness }
+  {sizeof(gasBlackness)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasBlackness, sizeof(gasBlacknessRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB),        gasBlacknessRGB, 0u, NULL, FRAMES, NULL, NULL }
+};
+
+//--------------------------------------------------------
+//! \brief Boot animation: the battery gauge sweeps up, then all the LEDs stay lit as load for the measurement -- normal LEDs, the left side mirrored
+CODE const S_ANIMATION_INSTRUCTION_HALF gasBootGauge[ 7u ] =
+{
+  {  100u, {15,  0,  0,  0,  0,  0}, LOAD, 0u },
+  {  100u, {15, 15,  0,  0,  0,  0}, LOAD, 0u },
+  {  100u, {15, 15, 15,  0,  0,  0}, LOAD, 0u },
+  {  100u, {15, 15, 15, 15,  0,  0}, LOAD, 0u },
+  {  100u, {15, 15, 15, 15, 15,  0}, LOAD, 0u },
+  {  100u, {15, 15, 15, 15, 15, 15}, LOAD, 0u },
+  {60000u, {15, 15, 15, 15, 15, 15}, LOAD, 0u },  // held until the gauge is shown
+};
+//! \brief Boot animation -- RGB LED
+CODE const S_ANIMATION_INSTRUCTION_RGB gasBootGaugeRGB[ 2u ] =
+{
+  {  600u, { 0,  0,  0}, LOAD, 0u },
+  {60000u, {15,  0,  0}, LOAD, 0u },
+};
+
+//! \brief Boot animation, played by Animation_PlayBoot(); not selectable by the button
+CODE const S_ANIMATION gsBootAnimation =
+{
+  sizeof(gasBootGauge)/sizeof(S_ANIMATION_INSTRUCTION_HALF), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasBootGauge, sizeof(gasBootGaugeRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB), gasBootGaugeRGB, 0u, NULL, MIRROR, NULL, NULL
+};
+
+//--------------------------------------------------------
+//! \brief Survival animation of a depleted cell: a short blink walking on the left side only -- normal LEDs, the arrays in gcau8Frames[]
+//! \note  The LEDs are dark most of the time, so the main loop mostly sleeps without the LED timer
+CODE const S_ANIMATION_INSTRUCTION_FRAME gasSurvival[ 12u ] =
+{
+  {  60u, PALETTE_FRAME | 17u, LOAD, 0u },
+  {1940u, PALETTE_FRAME |  6u, LOAD, 0u },
+  {  60u, PALETTE_FRAME | 27u, LOAD, 0u },
+  {1940u, PALETTE_FRAME |  6u, LOAD, 0u },
+  {  60u, PALETTE_FRAME | 18u, LOAD, 0u },
+  {1940u, PALETTE_FRAME |  6u, LOAD, 0u },
+  {  60u, PALETTE_FRAME | 24u, LOAD, 0u },
+  {1940u, PALETTE_FRAME |  6u, LOAD, 0u },
+  {  60u, PALETTE_FRAME | 20u, LOAD, 0u },
+  {1940u, PALETTE_FRAME |  6u, LOAD, 0u },
+  {  60u, PALETTE_FRAME | 22u, LOAD, 0u },
+  {1940u, PALETTE_FRAME |  6u, LOAD, 0u },
+};
+//! \brief Survival animation -- RGB LED
+CODE const S_ANIMATION_INSTRUCTION_RGB gasSurvivalRGB[ 1u ] =
+{
+  {0xFFFFu, { 0,  0,  0}, LOAD, 0u },
+};
+
+//! \brief Survival animation, played instead of the selected one after Animation_SetSurvival()
+CODE const S_ANIMATION gsSurvivalAnimation =
+{
+  sizeof(gasSurvival)/sizeof(S_ANIMATION_INSTRUCTION_FRAME), (const S_ANIMATION_INSTRUCTION_NORMAL CODE*)gasSurvival, sizeof(gasSurvivalRGB)/sizeof(S_ANIMATION_INSTRUCTION_RGB), gasSurvivalRGB, 0u, NULL, FRAMES, NULL, NULL
 };
 
 
 /***************************************< Global variables >**************************************/
-IDATA U16 gu16NormalTimer;                    //!< Ms resolution timer for normal LED animation
 IDATA U16 gu16RGBTimer;                       //!< Ms resolution timer for the RGB LED animation
 IDATA U16 gu16LastCall;                       //!< The last time the main cycle was called
+static U16 gu16AheadMs = 0u;                  //!< The programs have been played this far past gu16LastCall, see ANIMATION_RENDER_AHEAD_MS
+IDATA U16 gu16RGBDeadline;                    //!< Value of gu16RGBTimer when the next RGB instruction starts
+static IDATA U8 u8RGBCursor = 0u;             //!< Index of the next RGB instruction to be executed
 // Local variables
-static IDATA U8 u8LastState = 0xFFu;          //!< Previously executed instruction index for normal LEDs
-static IDATA U8 u8RepetitionCounter = 0u;     //!< Instruction repetition counter for normal LEDs
 static IDATA U8 u8LastStateRGB = 0xFFu;       //!< Previously executed instruction index for RGB LED
 static IDATA U8 u8RepetitionCounterRGB = 0u;  //!< Instruction repetition counter for RGB LED
+static S_ANIMATION_LERP sLerpRGB;             //!< Running fade of the RGB LED
+static S_ANIMATION_TRACK sTrackNormal;        //!< The normal LED program of the animation, on gau8LEDBrightness[]
+#if ANIMATION_MAX_LAYERS
+static NO_INIT S_ANIMATION_TRACK gasLayerTracks[ ANIMATION_MAX_LAYERS ];  //!< Programs of the layers of the animation; reset by Play() up to gu8NumLayers
+static U8 gau8LayerLevels[ ANIMATION_MAX_LAYERS ][ LEDS_NUM ];    //!< Brightness levels of the layers
+static U8 gu8NumLayers = 0u;                  //!< Layers of the animation being played, at most ANIMATION_MAX_LAYERS
+#endif
+static U8 gau8Shown[ LEDS_NUM + NUM_RGBLED_COLORS ];  //!< Composed frame handed over to the driver last: normal LEDs, then the colors
+#if ANIMATION_CROSSFADE_MS
+static S_ANIMATION_CROSSFADE sCrossfade = { CROSSFADE_END };  //!< Running crossfade between two animations
+#endif
+static U32 u32RandomState = 0x2545F491u;      //!< State of the xorshift pseudo-random generator, never zero; seeded from the UID
+static U16 gu16SpeedQ8 = SPEED_ONE;           //!< Playback rate in 8.8 fixed point
+static U16 gu16SpeedInvQ8 = SPEED_ONE;        //!< Inverse of gu16SpeedQ8, to turn the idle time back to real ms without a division
+static U8  gu8SpeedFraction = 0u;             //!< Fraction of a ms of the animation time, left over by the last cycle
+#if ANIMATION_PHASE_MS
+static U16 gu16PhaseMs;                       //!< Per-unit head start of the animations, [0; ANIMATION_PHASE_MS)
+#endif
+#if SYNC_ENABLE
+static U16 gu16FlashMs;                       //!< Rest of the flash burst of the phase lock, all LEDs at full brightness
+#endif
+static const S_ANIMATION CODE* gpsAnimation = &gasAnimations[ 0u ];  //!< The animation being played
+static BIT gbitSurvival;                      //!< The cell is nearly depleted: gsSurvivalAnimation is played instead of the selected one
+#if UPLOAD_ENABLE
+static S_ANIMATION gsUploadedAnimation;       //!< The uploaded animation, its tables are in the upload area
+static const S_ANIMATION CODE* gpsFirstAnimation = &gasAnimations[ 0u ];  //!< Played as animation 0: the uploaded one, if there is any
+#endif
+#if ANIMATION_RESUME
+static NO_INIT S_ANIMATION_RESUME gsResume;   //!< Snapshot of the animation left by the last power-down, kept over it and over a reset
+#endif
+#if UTIL_PROFILING
+//! \brief Cost statistics of the animations and the opcodes, fixed symbols to be read by the debugger
+volatile S_ANIMATION_COST gasAnimationCost[ NUM_ANIMATIONS ];
+volatile S_UTIL_PROFILE gasAnimationOpCost[ ANIMATION_COST_OPS ];
+static U32 gu32CostChanges;                   //!< Instructions executed since the last Animation_Cycle(), see S_ANIMATION_COST
+#endif
+#if ANIMATION_IN_SET( BOUNCE )
+static I16 gi16BounceHeight;                  //!< Height of the ball of Bounce(), in 1/256 LEDs above the bottom one
+static I16 gi16BounceSpeed;                   //!< Upward speed of the ball of Bounce(), 1/256 LEDs a frame
+#endif
 
 
 /***************************************< Static function definitions >**************************************/
 static I8 SaturateBrightness( U8* pu8BrightnessVariable );
+static void OpAdd( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels );
+static void OpRightShift( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels );
+static void OpLeftShift( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels );
+static U8   ShiftDistance( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr );
+static void Rotate( U8* pu8Levels, U8 u8Distance );
+static void OpUpwardSource( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels );
+static void OpDownwardSource( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels );
+static void OpDivide( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels );
+static U8   Divide( U8 u8Value, U8 u8Divisor );
+#if ANIMATION_COMPILED
+static BOOL CompiledExecute( const S_ANIMATION_INSTRUCTION_NORMAL CODE* psInstructions, U8 u8Index, U8* pu8Levels );
+#endif
+static void LerpStart( S_ANIMATION_LERP* psLerp, const U8* pu8Current, const U8 CODE* pu8Target, U8 u8Count, U16 u16DurationMs, U8 u8Ease );
+static BOOL LerpStep( S_ANIMATION_LERP* psLerp, U8* pu8Current, U8 u8Count, U16 u16ElapsedMs );
+static U8 RandomLED( void );
+static void HsvToRgb( const U8 CODE* pu8HSV, U8* pu8RGB );
+static void GeneratorStart( S_ANIMATION_GENERATOR* psGenerator, CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels );
+static void GeneratorRender( S_ANIMATION_GENERATOR* psGenerator, U8* pu8Levels );
+static BOOL GeneratorStep( S_ANIMATION_GENERATOR* psGenerator, U8* pu8Levels, U16 u16ElapsedMs );
+static void TrackReset( S_ANIMATION_TRACK* psTrack, U8* pu8Levels, U8 u8Format );
+static BOOL TrackStep( S_ANIMATION_TRACK* psTrack, U16 u16ElapsedMs );
+static BOOL TrackRestart( S_ANIMATION_TRACK* psTrack, U8 u8Length );
+static BOOL TrackFetch( S_ANIMATION_TRACK* psTrack, const S_ANIMATION_INSTRUCTION_NORMAL CODE* psInstructions, U8 u8Length, CODE const S_ANIMATION_INSTRUCTION_NORMAL** ppsInstr );
+static void TrackControl( S_ANIMATION_TRACK* psTrack, CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr );
+static BOOL TrackExecute( S_ANIMATION_TRACK* psTrack, const S_ANIMATION_INSTRUCTION_NORMAL CODE* psInstructions, U8 u8Length );
+static BOOL TrackNative( S_ANIMATION_TRACK* psTrack, U8 u8Length );
+static U16  TrackIdleMs( const S_ANIMATION_TRACK* psTrack, U16 u16Pending );
+static void Play( const S_ANIMATION CODE* psAnimation );
+static void Position( U16 u16Ms );
+#if ANIMATION_RESUME
+static BOOL Resume( const S_ANIMATION CODE* psAnimation );
+#endif
+#if ANIMATION_MAX_LAYERS
+static void Blend( U8* pu8Frame, const U8* pu8Layer, const S_ANIMATION_LAYER CODE* psLayer );
+#endif
+static void Render( U8* pu8Frame );
+static U32  ScaleTime( U16 u16Ms );
+static void Commit( BOOL bChanged, U16 u16DueMs );
+static void Advance( U16 u16Elapsed, U16 u16TimeNow );
+static U16  IdleMs( U16 u16Pending );
+#if ANIMATION_RENDER_AHEAD_MS
+static U16  RenderAheadMs( U16 u16Pending );
+#endif
+#if ANIMATION_CROSSFADE_MS
+static U8   Mix( U8 u8From, U8 u8To, U16 u16Weight );
+#endif
+
+//! \brief Opcode dispatch table for normal LEDs -- IMPORTANT: the order of operations is fixed!
+static CODE const S_ANIMATION_OPERATION gcasNormalOperations[] =
+{
+  { ADD,     OpAdd            },
+  { RSHIFT,  OpRightShift     },
+  { LSHIFT,  OpLeftShift      },
+  { USOURCE, OpUpwardSource   },
+  { DSOURCE, OpDownwardSource },
+  { DIV,     OpDivide         }
+};
+#if UTIL_PROFILING
+STATIC_ASSERT( ( sizeof( gcasNormalOperations )/sizeof( S_ANIMATION_OPERATION ) ) == ( ANIMATION_COST_OPS - ANIMATION_COST_ADD ) );
+#endif
+
+#if ANIMATION_COMPILED
+// The operations of the built-in programs as C, with gcasCompiled[]; generated by tools/animgen.py
+#include "animation_gen.inc"
+#endif
 
 
 /***************************************< Private functions >**************************************/
@@ -633,132 +1177,533 @@ static I8 SaturateBrightness( U8* pu8BrightnessVariable )
     i8Return = (I8)*pu8BrightnessVariable;
     *pu8BrightnessVariable = 0u;
   }
-  else if( (I8)*pu8BrightnessVariable > 15u )
+  else if( (I8)*pu8BrightnessVariable > LED_BRIGHTNESS_MAX )
   {
-    i8Return = (I8)*pu8BrightnessVariable - 15;
-    *pu8BrightnessVariable = 15u;
+    i8Return = (I8)*pu8BrightnessVariable - (I8)LED_BRIGHTNESS_MAX;
+    *pu8BrightnessVariable = LED_BRIGHTNESS_MAX;
   }
   return i8Return;
 }
 
+//----------------------------------------------------------------------------
+//! \brief  Add operation
+//! \param  *psInstr: the instruction being executed
+//! \param  *pu8Levels: brightness levels of the track
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+static void OpAdd( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels )
+{
+  U8 u8Index;
+  
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+  {
+    pu8Levels[ u8Index ] += psInstr->au8LEDBrightness[ u8Index ];
+    if( LERP & psInstr->u8AnimationOpcode )  // SATADD
+    {
+      (void)SaturateBrightness( &pu8Levels[ u8Index ] );
+    }
+    else if( pu8Levels[ u8Index ] > LED_BRIGHTNESS_MAX )  // overflow/underflow happened
+    {
+      pu8Levels[ u8Index ] = 0u;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Right shift operation
+//! \param  *psInstr: the instruction being executed
+//! \param  *pu8Levels: brightness levels of the track
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+static void OpRightShift( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels )
+{
+  Rotate( pu8Levels, ShiftDistance( psInstr ) );
+}
 
-/***************************************< Public functions >**************************************/
 //----------------------------------------------------------------------------
-//! \brief  Initialize layer
-//! \param  -
+//! \brief  Left shift operation
+//! \param  *psInstr: the instruction being executed
+//! \param  *pu8Levels: brightness levels of the track
 //! \return -
-//! \global All globals in this layer.
-//! \note   Should be called in the init block of the firmware.
+//! \global -
 //-----------------------------------------------------------------------------
-void Animation_Init( void )
+static void OpLeftShift( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels )
 {
-  gu16NormalTimer = 0u;
-  gu16RGBTimer = 0u;
-  gu16LastCall = Util_GetTimerMs();
+  Rotate( pu8Levels, LEDS_NUM - ShiftDistance( psInstr ) );
 }
 
 //----------------------------------------------------------------------------
-//! \brief  Check timer and update LED brightnesses based on the animation.
-//! \param  -
+//! \brief  Tells how far a shift instruction rotates the levels
+//! \param  *psInstr: the instruction being executed
+//! \return Distance in LEDs, [0; LEDS_NUM)
+//! \global -
+//! \note   With REPEAT or DIV the operand is their count or divisor, each step moves by one LED then.
+//-----------------------------------------------------------------------------
+static U8 ShiftDistance( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr )
+{
+  U8 u8Distance = 1u;
+  
+  if( ( 0u == ( ( REPEAT | DIV ) & psInstr->u8AnimationOpcode ) ) && ( 0u != psInstr->u8AnimationOperand ) )
+  {
+    u8Distance = psInstr->u8AnimationOperand % LEDS_NUM;
+  }
+  
+  return u8Distance;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Rotates the levels of a track clockwise
+//! \param  *pu8Levels: brightness levels of the track
+//! \param  u8Distance: LEDs to rotate by, [0; LEDS_NUM]
 //! \return -
 //! \global -
-//! \note   Should be called from main cycle.
+//! \note   One pass through a copy, whatever the distance: LED n takes the level of LED ( n - distance ).
 //-----------------------------------------------------------------------------
-void Animation_Cycle( void )
+static void Rotate( U8* pu8Levels, U8 u8Distance )
 {
-  U8  u8AnimationState;
-  U16 u16StateTimer = 0u;
-  U16 u16TimeNow = Util_GetTimerMs();
-  U8  u8Index, u8InnerIndex;
-  U8  u8OpCode;
-  U8  u8Temp;
-  I8  i8Change;
+  U8 au8Copy[ LEDS_NUM ];
+  U8 u8Index;
+  U8 u8Source;
   
-  // Check if time has elapsed since last call
-  if( u16TimeNow != gu16LastCall )
+  memcpy( au8Copy, pu8Levels, LEDS_NUM );
+  u8Source = ( LEDS_NUM - u8Distance ) % LEDS_NUM;
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+  {
+    pu8Levels[ u8Index ] = au8Copy[ u8Source ];
+    u8Source++;
+    if( LEDS_NUM == u8Source )
+    {
+      u8Source = 0u;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Upward source instruction
+//! \param  *psInstr: the instruction being executed
+//! \param  *pu8Levels: brightness levels of the track
+//! \return -
+//! \global -
+//! \note   One pass per side, from its first LED upwards: the overflow of each LED is added to the
+//!         next one together with its own value, the overflow of the last one is lost.
+//-----------------------------------------------------------------------------
+static void OpUpwardSource( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels )
+{
+  U8 u8Index;
+  I8 i8Carry = 0;
+  
+  // Left side
+  for( u8Index = 0u; u8Index < RIGHT_LEDS_START; u8Index++ )
+  {
+    pu8Levels[ u8Index ] += (I8)psInstr->au8LEDBrightness[ u8Index ] + i8Carry;
+    i8Carry = SaturateBrightness( &pu8Levels[ u8Index ] );
+  }
+  // Right side
+  i8Carry = 0;
+  for( u8Index = LEDS_NUM - 1u; u8Index >= RIGHT_LEDS_START; u8Index-- )
+  {
+    pu8Levels[ u8Index ] += (I8)psInstr->au8LEDBrightness[ u8Index ] + i8Carry;
+    i8Carry = SaturateBrightness( &pu8Levels[ u8Index ] );
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Downward source instruction
+//! \param  *psInstr: the instruction being executed
+//! \param  *pu8Levels: brightness levels of the track
+//! \return -
+//! \global -
+//! \note   Like OpUpwardSource(), from the last LED of each side downwards.
+//-----------------------------------------------------------------------------
+static void OpDownwardSource( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels )
+{
+  U8 u8Index;
+  I8 i8Carry = 0;
+  
+  // Left side
+  for( u8Index = RIGHT_LEDS_START; u8Index > 0u; u8Index-- )
+  {
+    pu8Levels[ u8Index - 1u ] += (I8)psInstr->au8LEDBrightness[ u8Index - 1u ] + i8Carry;
+    i8Carry = SaturateBrightness( &pu8Levels[ u8Index - 1u ] );
+  }
+  // Right side
+  i8Carry = 0;
+  for( u8Index = RIGHT_LEDS_START; u8Index < LEDS_NUM; u8Index++ )
+  {
+    pu8Levels[ u8Index ] += (I8)psInstr->au8LEDBrightness[ u8Index ] + i8Carry;
+    i8Carry = SaturateBrightness( &pu8Levels[ u8Index ] );
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Divide instruction
+//! \param  *psInstr: the instruction being executed
+//! \param  *pu8Levels: brightness levels of the track
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+static void OpDivide( CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels )
+{
+  U8 u8Index;
+  
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+  {
+    pu8Levels[ u8Index ] = Divide( pu8Levels[ u8Index ], psInstr->au8LEDBrightness[ u8Index ] );
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Divides a brightness level for DIV
+//! \param  u8Value: the brightness level
+//! \param  u8Divisor: the divisor of the instruction; 0 leaves the level as it is
+//! \return The quotient, rounded down
+//! \global gcau16Reciprocal[]
+//! \note   The small divisors of the tables multiply by the reciprocal, instead of the division
+//!         routine of the library.
+//-----------------------------------------------------------------------------
+static U8 Divide( U8 u8Value, U8 u8Divisor )
+{
+  if( u8Divisor >= DIV_RECIPROCALS )
   {
-    // Increase the synchronized timer with the difference
-    DISABLE_IT;
-    gu16NormalTimer += ( u16TimeNow - gu16LastCall );
-    gu16RGBTimer += ( u16TimeNow - gu16LastCall );
-    ENABLE_IT;
+    u8Value /= u8Divisor;
+  }
+  else if( u8Divisor > 1u )
+  {
+    u8Value = (U8)( ( (U32)u8Value * gcau16Reciprocal[ u8Divisor ] ) >> 16u );
+  }
+  
+  return u8Value;
+}
 
-    // Make sure not to overindex arrays
-    if( gsPersistentData.u8AnimationIndex >= NUM_ANIMATIONS )
+#if ANIMATION_COMPILED
+//----------------------------------------------------------------------------
+//! \brief  Runs the operations of an instruction by the compiled code of its program
+//! \param  psInstructions: program of the instruction
+//! \param  u8Index: index of the instruction in the program
+//! \param  pu8Levels: brightness levels of the track
+//! \return TRUE if done; FALSE if the program isn't compiled, e.g. an uploaded one: the dispatch table runs them
+//! \global gcasCompiled[]
+//! \note   Only the operations of gcasNormalOperations[]: the instruction is executed by TrackExecute().
+//-----------------------------------------------------------------------------
+static BOOL CompiledExecute( const S_ANIMATION_INSTRUCTION_NORMAL CODE* psInstructions, U8 u8Index, U8* pu8Levels )
+{
+  CODE const S_ANIMATION_COMPILED* psCompiled = gcasCompiled;
+  BOOL bExecuted = FALSE;
+#if UTIL_PROFILING
+  U32  u32ProfileStart = Util_ProfileStart();
+#endif
+  
+  while( NULL != psCompiled->psInstructions )
+  {
+    if( psInstructions == psCompiled->psInstructions )
     {
-      gsPersistentData.u8AnimationIndex = 0u;
+      bExecuted = psCompiled->pfExecute( u8Index, pu8Levels );
+      break;
     }
-    
-    // --------------------------------------< For the normal LEDs
-    // Calculate the state of the animation
-    for( u8AnimationState = 0u; u8AnimationState < gasAnimations[ gsPersistentData.u8AnimationIndex ].u8AnimationLengthNormal; u8AnimationState++ )
+    psCompiled++;
+  }
+#if UTIL_PROFILING
+  if( bExecuted )
+  {
+    Util_ProfileAdd( &gasAnimationOpCost[ ANIMATION_COST_COMPILED ], u32ProfileStart );
+  }
+#endif
+  
+  return bExecuted;
+}
+#endif
+
+//----------------------------------------------------------------------------
+//! \brief  Starts a fade from the current brightness levels to the target
+//! \param  *psLerp: fade state to initialize
+//! \param  *pu8Current: current brightness levels
+//! \param  *pu8Target: brightness levels to reach
+//! \param  u8Count: number of LEDs
+//! \param  u16DurationMs: length of the fade
+//! \param  u8Ease: easing curve (E_ANIMATION_EASE); an unknown one fades linearly
+//! \return -
+//! \global gcaau8EaseCurve[]
+//! \note   The divisions are done here once, LerpStep() only adds, or looks the curve up.
+//-----------------------------------------------------------------------------
+static void LerpStart( S_ANIMATION_LERP* psLerp, const U8* pu8Current, const U8 CODE* pu8Target, U8 u8Count, U16 u16DurationMs, U8 u8Ease )
+{
+  U8 u8Index;
+  
+  psLerp->pu8Curve = NULL;
+  if( ( EASE_LINEAR != u8Ease ) && ( u8Ease <= EASE_CURVES ) && ( 0u != u16DurationMs ) )
+  {
+    psLerp->pu8Curve = gcaau8EaseCurve[ u8Ease - 1u ];
+    psLerp->u32Phase = 0u;
+    psLerp->u32PhaseStep = ( (U32)EASE_STEPS << 16 ) / u16DurationMs;
+  }
+  for( u8Index = 0u; u8Index < u8Count; u8Index++ )
+  {
+    psLerp->ai32Value[ u8Index ] = (I32)pu8Current[ u8Index ] << 16;
+    psLerp->ai32Step[ u8Index ] = 0;
+    if( NULL != psLerp->pu8Curve )
     {
-      u16StateTimer += gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].u16TimingMs;
-      if( u16StateTimer > gu16NormalTimer )
-      {
-        break;
-      }
+      psLerp->ai32Step[ u8Index ] = ( (I32)pu8Target[ u8Index ] - (I32)pu8Current[ u8Index ] ) << 8;
+    }
+    else if( 0u != u16DurationMs )
+    {
+      psLerp->ai32Step[ u8Index ] = ( ( (I32)pu8Target[ u8Index ] - (I32)pu8Current[ u8Index ] ) << 16 ) / (I32)u16DurationMs;
     }
-    if( u8AnimationState >= gasAnimations[ gsPersistentData.u8AnimationIndex ].u8AnimationLengthNormal )
+  }
+  psLerp->u16RemainingMs = u16DurationMs;
+  psLerp->pu8Target = pu8Target;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Continues a running fade
+//! \param  *psLerp: fade state
+//! \param  *pu8Current: brightness levels to update
+//! \param  u8Count: number of LEDs
+//! \param  u16ElapsedMs: time elapsed since the previous step
+//! \return TRUE if any brightness level has changed
+//! \global -
+//! \note   Reaching the end of the fade loads the exact target and stops the fade.
+//-----------------------------------------------------------------------------
+static BOOL LerpStep( S_ANIMATION_LERP* psLerp, U8* pu8Current, U8 u8Count, U16 u16ElapsedMs )
+{
+  U8   u8Index;
+  U8   u8Value;
+  U8   u8Ease = 0u;
+  BOOL bChanged = FALSE;
+  
+  if( NULL != psLerp->pu8Target )
+  {
+    if( u16ElapsedMs >= psLerp->u16RemainingMs )  // end of the fade
     {
-      // restart animation
-      u8AnimationState = 0u;
-      DISABLE_IT;
-      gu16NormalTimer = 0u;
-      gu16RGBTimer = 0u;
-      ENABLE_IT;
+      for( u8Index = 0u; u8Index < u8Count; u8Index++ )
+      {
+        u8Value = psLerp->pu8Target[ u8Index ];
+        if( pu8Current[ u8Index ] != u8Value )
+        {
+          pu8Current[ u8Index ] = u8Value;
+          bChanged = TRUE;
+        }
+      }
+      psLerp->pu8Target = NULL;
     }
-    if( u8LastState != u8AnimationState )  // next instruction
+    else
     {
-      u8OpCode = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].u8AnimationOpcode;
-      // Just a load instruction, nothing more
-      if( LOAD == u8OpCode )
+      psLerp->u16RemainingMs -= u16ElapsedMs;
+      if( NULL != psLerp->pu8Curve )  // the phase stays below EASE_STEPS until the end of the fade
       {
-        memcpy( gau8LEDBrightness, (void*)gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness, LEDS_NUM );
-        u8LastState = u8AnimationState;
+        psLerp->u32Phase += psLerp->u32PhaseStep * u16ElapsedMs;
+        u8Ease = psLerp->pu8Curve[ psLerp->u32Phase >> 16 ];
       }
-      else  // Other opcodes -- IMPORTANT: the order of operations are fixed!
+      for( u8Index = 0u; u8Index < u8Count; u8Index++ )
       {
-        // Add operation
-        if( ADD & u8OpCode )
+        if( NULL != psLerp->pu8Curve )
         {
-          for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
-          {
-            gau8LEDBrightness[ u8Index ] += gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
-            if( gau8LEDBrightness[ u8Index ] > 15u )  // overflow/underflow happened
-            {
-              gau8LEDBrightness[ u8Index ] = 0u;
-            }
-          }
+          u8Value = (U8)( ( psLerp->ai32Value[ u8Index ] + psLerp->ai32Step[ u8Index ] * (I32)u8Ease + 0x8000 ) >> 16 );  // rounding
         }
-        // Right shift operation
-        if( RSHIFT & u8OpCode )
+        else
         {
-          u8Temp = gau8LEDBrightness[ LEDS_NUM - 1u ];
-          for( u8Index = LEDS_NUM - 1u; u8Index > 0u; u8Index-- )
-          {
-            gau8LEDBrightness[ u8Index ] = gau8LEDBrightness[ u8Index - 1u ];
-          }
-          gau8LEDBrightness[ 0u ] = u8Temp;
+          psLerp->ai32Value[ u8Index ] += psLerp->ai32Step[ u8Index ] * (I32)u16ElapsedMs;
+          u8Value = (U8)( ( psLerp->ai32Value[ u8Index ] + 0x8000 ) >> 16 );  // rounding
         }
-        // Left shift operation
-        if( LSHIFT & u8OpCode )
+        if( pu8Current[ u8Index ] != u8Value )
         {
-          u8Temp = gau8LEDBrightness[ 0u ];
-          for( u8Index = 0u; u8Index < (LEDS_NUM - 1u); u8Index++ )
-          {
-            gau8LEDBrightness[ u8Index ] = gau8LEDBrightness[ u8Index + 1u ];
-          }
-          gau8LEDBrightness[ LEDS_NUM - 1u ] = u8Temp;
+          pu8Current[ u8Index ] = u8Value;
+          bChanged = TRUE;
+        }
+      }
+    }
+  }
+  
+  return bChanged;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Gives a pseudo-random LED index
+//! \param  -
+//! \return Index between 0 and LEDS_NUM-1
+//! \global u32RandomState
+//! \note   xorshift32; scaled by a multiplication, as there's no hardware divider.
+//-----------------------------------------------------------------------------
+static U8 RandomLED( void )
+{
+  u32RandomState ^= u32RandomState << 13u;
+  u32RandomState ^= u32RandomState >> 17u;
+  u32RandomState ^= u32RandomState << 5u;
+  return (U8)( ( ( u32RandomState & 0xFFFFu ) * LEDS_NUM ) >> 16u );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Converts a hue, saturation, value color to the levels of the RGB LED
+//! \param  *pu8HSV: hue [0; 255] (0: red, 85: green, 170: blue), saturation and value [0; LED_BRIGHTNESS_MAX]
+//! \param  *pu8RGB: the color levels, [0; LED_BRIGHTNESS_MAX]
+//! \return -
+//! \global -
+//! \note   Integer only: the hue is split into the six sectors of the color wheel by a
+//!         multiplication, and x/15 is done as (x*17+128)/256, which is exact on the corners.
+//!         The channels are balanced by the pulse widths of the RGB LED driver, not here.
+//-----------------------------------------------------------------------------
+static void HsvToRgb( const U8 CODE* pu8HSV, U8* pu8RGB )
+{
+  U16 u16Hue = (U16)pu8HSV[ 0u ] * 6u;  // sector in the high byte, position in the low byte
+  U8  u8Sat = ( pu8HSV[ 1u ] < LED_BRIGHTNESS_MAX ) ? pu8HSV[ 1u ] : LED_BRIGHTNESS_MAX;
+  U8  u8Val = ( pu8HSV[ 2u ] < LED_BRIGHTNESS_MAX ) ? pu8HSV[ 2u ] : LED_BRIGHTNESS_MAX;
+  U8  u8Chroma = (U8)( ( (U16)u8Val * u8Sat * 17u + 128u ) >> 8u );
+  U8  u8Min = u8Val - u8Chroma;
+  U8  u8Rising = u8Min + (U8)( ( (U16)u8Chroma * ( u16Hue & 0xFFu ) + 128u ) >> 8u );
+  U8  u8Falling = u8Val + u8Min - u8Rising;
+  
+  switch( u16Hue >> 8u )
+  {
+    case 0u:  // red to yellow
+      pu8RGB[ 0u ] = u8Val;     pu8RGB[ 1u ] = u8Rising;  pu8RGB[ 2u ] = u8Min;
+      break;
+    case 1u:  // yellow to green
+      pu8RGB[ 0u ] = u8Falling; pu8RGB[ 1u ] = u8Val;     pu8RGB[ 2u ] = u8Min;
+      break;
+    case 2u:  // green to cyan
+      pu8RGB[ 0u ] = u8Min;     pu8RGB[ 1u ] = u8Val;     pu8RGB[ 2u ] = u8Rising;
+      break;
+    case 3u:  // cyan to blue
+      pu8RGB[ 0u ] = u8Min;     pu8RGB[ 1u ] = u8Falling; pu8RGB[ 2u ] = u8Val;
+      break;
+    case 4u:  // blue to magenta
+      pu8RGB[ 0u ] = u8Rising;  pu8RGB[ 1u ] = u8Min;     pu8RGB[ 2u ] = u8Val;
+      break;
+    default:  // magenta to red
+      pu8RGB[ 0u ] = u8Val;     pu8RGB[ 1u ] = u8Min;     pu8RGB[ 2u ] = u8Falling;
+      break;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Starts the generator of a GENERATE instruction
+//! \param  *psGenerator: generator of the track
+//! \param  *psInstr: the instruction being executed
+//! \param  *pu8Levels: brightness levels of the track
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+static void GeneratorStart( S_ANIMATION_GENERATOR* psGenerator, CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr, U8* pu8Levels )
+{
+  psGenerator->pu8Params = psInstr->au8LEDBrightness;
+  psGenerator->u8Type = psInstr->u8AnimationOperand >> 6u;
+  psGenerator->u16StepMs = (U16)( psInstr->u8AnimationOperand & 0x3Fu ) * GENERATOR_STEP_UNIT;
+  psGenerator->u16ElapsedMs = 0u;
+  psGenerator->u8Phase = 0u;
+  psGenerator->u8Previous = LEDS_NUM;  // none
+  if( GEN_FADE == psGenerator->u8Type )
+  {
+    psGenerator->u8Phase = RandomLED();
+  }
+  GeneratorRender( psGenerator, pu8Levels );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Calculates the next step of the running generator
+//! \param  *psGenerator: generator of the track
+//! \param  *pu8Levels: brightness levels of the track
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+static void GeneratorRender( S_ANIMATION_GENERATOR* psGenerator, U8* pu8Levels )
+{
+  U8 u8Index;
+  U8 u8Source;
+  
+  switch( psGenerator->u8Type )
+  {
+    case GEN_SPARKLE:
+      memcpy( pu8Levels, (void*)psGenerator->pu8Params, LEDS_NUM );
+      do
+      {
+        psGenerator->u8Phase = RandomLED();
+      } while( psGenerator->u8Phase == psGenerator->u8Previous );
+      psGenerator->u8Previous = psGenerator->u8Phase;
+      pu8Levels[ psGenerator->u8Phase ] = LED_BRIGHTNESS_MAX;
+      break;
+    
+    case GEN_FADE:
+      for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+      {
+        if( ( u8Index != psGenerator->u8Phase ) && ( pu8Levels[ u8Index ] > 0u ) )
+        {
+          pu8Levels[ u8Index ]--;
+        }
+      }
+      if( pu8Levels[ psGenerator->u8Phase ] < psGenerator->pu8Params[ psGenerator->u8Phase ] )
+      {
+        pu8Levels[ psGenerator->u8Phase ]++;
+      }
+      else  // faded in, choose the next one
+      {
+        psGenerator->u8Previous = psGenerator->u8Phase;
+        do
+        {
+          psGenerator->u8Phase = RandomLED();
+        } while( psGenerator->u8Phase == psGenerator->u8Previous );
+      }
+      break;
+    
+    case GEN_CHASE_CW:
+    case GEN_CHASE_CCW:
+      // Element u8Index of the array goes to LED (u8Index + u8Phase) when going clockwise
+      u8Source = ( GEN_CHASE_CW == psGenerator->u8Type ) ? ( LEDS_NUM - psGenerator->u8Phase ) : psGenerator->u8Phase;
+      for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+      {
+        if( u8Source >= LEDS_NUM )
+        {
+          u8Source -= LEDS_NUM;
         }
+        pu8Levels[ u8Index ] = psGenerator->pu8Params[ u8Source ];
+        u8Source++;
+      }
+      psGenerator->u8Phase++;
+      if( psGenerator->u8Phase >= LEDS_NUM )
+      {
+        psGenerator->u8Phase = 0u;
+      }
+      break;
+    
+    default:
+      break;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Continues the running generator
+//! \param  *psGenerator: generator of the track
+//! \param  *pu8Levels: brightness levels of the track
+//! \param  u16ElapsedMs: time elapsed since the previous call
+//! \return TRUE if the generator made a step
+//! \global -
+//-----------------------------------------------------------------------------
+static BOOL GeneratorStep( S_ANIMATION_GENERATOR* psGenerator, U8* pu8Levels, U16 u16ElapsedMs )
+{
+  BOOL bStepped = FALSE;
+  
+  if( ( NULL != psGenerator->pu8Params ) && ( 0u != psGenerator->u16StepMs ) )
+  {
+    psGenerator->u16ElapsedMs += u16ElapsedMs;
+    while( psGenerator->u16ElapsedMs >= psGenerator->u16StepMs )
+    {
+      psGenerator->u16ElapsedMs -= psGenerator->u16StepMs;
+      GeneratorRender( psGenerator, pu8Levels );
+      bStepped = TRUE;
+    }
+  }
+  
+  return bStepped;
+}
+
 /*
-        // Upward move operation
+        // Upward move operation -- disabled, kept for reference
         if( UMOVE & u8OpCode )
         {
           // Left side
           for( u8Index = 0u; u8Index < (RIGHT_LEDS_START - 1u); u8Index++ )
           {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
+            i8Change = psInstr->au8LEDBrightness[ u8Index ];
             gau8LEDBrightness[ u8Index ] -= i8Change;
             for( u8InnerIndex = u8Index; u8InnerIndex < (RIGHT_LEDS_START - 1u); u8InnerIndex++ )
             {
@@ -767,13 +1712,13 @@ void Animation_Cycle( void )
               i8Change = SaturateBrightness( &gau8LEDBrightness[ u8InnerIndex + 1u ] );
             }
           }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ RIGHT_LEDS_START - 1u ];
+          i8Change = psInstr->au8LEDBrightness[ RIGHT_LEDS_START - 1u ];
           gau8LEDBrightness[ RIGHT_LEDS_START - 1u ] -= i8Change;
           SaturateBrightness( &gau8LEDBrightness[ RIGHT_LEDS_START - 1u ] );
           // Right side
           for( u8Index = LEDS_NUM - 1u; u8Index > RIGHT_LEDS_START; u8Index-- )
           {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
+            i8Change = psInstr->au8LEDBrightness[ u8Index ];
             if( (I8)gau8LEDBrightness[ u8Index ] - i8Change < 0u )  // saturation downwards
             {
               gau8LEDBrightness[ u8Index - 1u ] += gau8LEDBrightness[ u8Index ];
@@ -786,7 +1731,7 @@ void Animation_Cycle( void )
             SaturateBrightness( &gau8LEDBrightness[ u8Index ] );
             SaturateBrightness( &gau8LEDBrightness[ u8Index - 1u ] );  // saturate the next LED too
           }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ RIGHT_LEDS_START ];
+          i8Change = psInstr->au8LEDBrightness[ RIGHT_LEDS_START ];
           gau8LEDBrightness[ RIGHT_LEDS_START ] -= i8Change;
           SaturateBrightness( &gau8LEDBrightness[ RIGHT_LEDS_START ] );
         }
@@ -797,7 +1742,7 @@ void Animation_Cycle( void )
           // Left side
           for( u8Index = (RIGHT_LEDS_START - 1u); u8Index > 0u ; u8Index-- )
           {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
+            i8Change = psInstr->au8LEDBrightness[ u8Index ];
             if( (I8)gau8LEDBrightness[ u8Index ] - i8Change < 0u )  // saturation downwards
             {
               gau8LEDBrightness[ u8Index - 1u ] += gau8LEDBrightness[ u8Index ];
@@ -810,13 +1755,13 @@ void Animation_Cycle( void )
             SaturateBrightness( &gau8LEDBrightness[ u8Index ] );
             SaturateBrightness( &gau8LEDBrightness[ u8Index - 1u ] );  // saturate the next LED too
           }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ 0u ];
+          i8Change = psInstr->au8LEDBrightness[ 0u ];
           gau8LEDBrightness[ 0u ] -= i8Change;
           SaturateBrightness( &gau8LEDBrightness[ 0u ] );
           // Right side
           for( u8Index = RIGHT_LEDS_START; u8Index < (LEDS_NUM - 1u); u8Index++ )
           {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
+            i8Change = psInstr->au8LEDBrightness[ u8Index ];
             if( (I8)gau8LEDBrightness[ u8Index ] - i8Change < 0u )  // saturation downwards
             {
               gau8LEDBrightness[ u8Index + 1u ] += gau8LEDBrightness[ u8Index ];
@@ -829,256 +1774,1538 @@ void Animation_Cycle( void )
             SaturateBrightness( &gau8LEDBrightness[ u8Index ] );
             SaturateBrightness( &gau8LEDBrightness[ u8Index + 1u ] );  // saturate the next LED too
           }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ LEDS_NUM - 1u ];
+          i8Change = psInstr->au8LEDBrightness[ LEDS_NUM - 1u ];
           gau8LEDBrightness[ LEDS_NUM - 1u ] -= i8Change;
           SaturateBrightness( &gau8LEDBrightness[ LEDS_NUM - 1u ] );
         }
 */
-        // Upward source instruction
-        if( USOURCE & u8OpCode )
+
+
+//----------------------------------------------------------------------------
+//! \brief  Resets a track to the start of its program
+//! \param  *psTrack: the track
+//! \param  *pu8Levels: brightness levels written by the track
+//! \param  u8Format: layout of the program of the track: MIRROR, FRAMES or 0 for S_ANIMATION_INSTRUCTION_NORMAL
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+static void TrackReset( S_ANIMATION_TRACK* psTrack, U8* pu8Levels, U8 u8Format )
+{
+  psTrack->pu8Levels = pu8Levels;
+  psTrack->u8Format = u8Format;
+  psTrack->u16Timer = 0u;
+  psTrack->u16Deadline = 0u;
+  psTrack->u8Cursor = 0u;
+  psTrack->u8LastState = 0xFFu;
+  psTrack->u8RepetitionCounter = 0u;
+  psTrack->sLerp.pu8Target = NULL;
+  psTrack->sGenerator.pu8Params = NULL;
+  psTrack->psCode = NULL;
+  psTrack->u8Depth = 0u;
+  psTrack->pfNative = NULL;
+  psTrack->u16Resume = 0u;
+  memcpy( psTrack->au8Palette, (void*)gcau8DefaultPalette, PALETTE_SIZE );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Advances the timer of a track and continues its running fade and generator
+//! \param  *psTrack: the track
+//! \param  u16ElapsedMs: time elapsed since the previous call
+//! \return TRUE if the levels of the track have changed
+//! \global -
+//-----------------------------------------------------------------------------
+static BOOL TrackStep( S_ANIMATION_TRACK* psTrack, U16 u16ElapsedMs )
+{
+  BOOL bChanged;
+#if UTIL_PROFILING
+  BOOL bStepped;
+  U32  u32ProfileStart = Util_ProfileStart();
+#endif
+  
+  psTrack->u16Timer += u16ElapsedMs;
+#if UTIL_PROFILING
+  // Only the steps which changed the levels are counted: the others are a single comparison
+  bChanged = LerpStep( &psTrack->sLerp, psTrack->pu8Levels, LEDS_NUM, u16ElapsedMs );
+  if( bChanged )
+  {
+    Util_ProfileAdd( &gasAnimationOpCost[ ANIMATION_COST_LERP ], u32ProfileStart );
+  }
+  u32ProfileStart = Util_ProfileStart();
+  bStepped = GeneratorStep( &psTrack->sGenerator, psTrack->pu8Levels, u16ElapsedMs );
+  if( bStepped )
+  {
+    Util_ProfileAdd( &gasAnimationOpCost[ ANIMATION_COST_GENERATE ], u32ProfileStart );
+  }
+  bChanged |= bStepped;
+#else
+  bChanged = LerpStep( &psTrack->sLerp, psTrack->pu8Levels, LEDS_NUM, u16ElapsedMs );
+  bChanged |= GeneratorStep( &psTrack->sGenerator, psTrack->pu8Levels, u16ElapsedMs );
+#endif
+  
+  return bChanged;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Restarts the program of a track if it has ended
+//! \param  *psTrack: the track
+//! \param  u8Length: number of instructions of the program
+//! \return TRUE if the program has been restarted
+//! \global -
+//! \note   The levels, the running fade and generator are kept, they continue into the next round; the
+//!         palette starts over, as the program sets it.
+//!         The time past the end is kept too, so a late cycle or a seek goes on in the next round.
+//-----------------------------------------------------------------------------
+static BOOL TrackRestart( S_ANIMATION_TRACK* psTrack, U8 u8Length )
+{
+  BOOL bRestarted = FALSE;
+  
+  if( ( NULL == psTrack->psCode ) && ( psTrack->u8Cursor >= u8Length ) && ( psTrack->u16Timer >= psTrack->u16Deadline ) )
+  {
+    psTrack->u16Timer -= psTrack->u16Deadline;
+    psTrack->u8Cursor = 0u;
+    psTrack->u16Deadline = 0u;
+    psTrack->u8LastState = 0xFFu;
+    psTrack->u8Depth = 0u;
+    memcpy( psTrack->au8Palette, (void*)gcau8DefaultPalette, PALETTE_SIZE );
+    bRestarted = TRUE;
+  }
+  
+  return bRestarted;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Fetches the next instruction of a track
+//! \param  *psTrack: the track
+//! \param  *psInstructions: program of the track
+//! \param  u8Length: number of instructions of the program
+//! \param  **ppsInstr: the instruction at the cursor is returned here
+//! \return FALSE at the end of the program of the track
+//! \global -
+//! \note   A program called by CALL returns at its end, the LOOPs left open in it are dropped.
+//!         The previous instruction ends here, before a half or a frame one is expanded over it.
+//-----------------------------------------------------------------------------
+static BOOL TrackFetch( S_ANIMATION_TRACK* psTrack, const S_ANIMATION_INSTRUCTION_NORMAL CODE* psInstructions, U8 u8Length, CODE const S_ANIMATION_INSTRUCTION_NORMAL** ppsInstr )
+{
+  U8   u8Index;
+  BOOL bFetched = TRUE;
+  U8   u8Format = psTrack->u8Format;
+  S_ANIMATION_FRAME* psFrame;
+  CODE const S_ANIMATION_INSTRUCTION_HALF* psHalf;
+  CODE const S_ANIMATION_INSTRUCTION_FRAME* psFrameInstr;
+  CODE const U8* pu8Row;
+  
+  while( ( NULL != psTrack->psCode ) && ( psTrack->u8Cursor >= psTrack->u8CodeLength ) )
+  {
+    psTrack->u8Depth--;
+    if( psTrack->u8Depth < ANIMATION_STACK_DEPTH )
+    {
+      psFrame = &psTrack->asStack[ psTrack->u8Depth ];
+      psTrack->psCode = psFrame->psCode;
+      psTrack->u8CodeLength = psFrame->u8CodeLength;
+      psTrack->u8CodeFormat = psFrame->u8CodeFormat;
+      if( 0u == psFrame->u8Passes )  // the CALL itself
+      {
+        psTrack->u8Cursor = psFrame->u8Cursor;
+      }
+    }
+    psTrack->u8LastState = 0xFFu;
+  }
+  if( NULL != psTrack->psCode )
+  {
+    psInstructions = psTrack->psCode;
+    u8Format = psTrack->u8CodeFormat;
+  }
+  else if( psTrack->u8Cursor >= u8Length )
+  {
+    bFetched = FALSE;
+  }
+  
+  if( bFetched )
+  {
+    // The previous fade must end before the next instruction, even if this cycle came late
+    LerpStep( &psTrack->sLerp, psTrack->pu8Levels, LEDS_NUM, 0xFFFFu );
+    psTrack->sGenerator.pu8Params = NULL;
+    if( MIRROR == u8Format )
+    {
+      psHalf = &( (CODE const S_ANIMATION_INSTRUCTION_HALF*)psInstructions )[ psTrack->u8Cursor ];
+      psTrack->sExpanded.u16TimingMs = psHalf->u16TimingMs;
+      for( u8Index = 0u; u8Index < RIGHT_LEDS_START; u8Index++ )
+      {
+        psTrack->sExpanded.au8LEDBrightness[ u8Index ] = psHalf->au8LEDBrightness[ u8Index ];
+        psTrack->sExpanded.au8LEDBrightness[ LEDS_NUM - 1u - u8Index ] = psHalf->au8LEDBrightness[ u8Index ];
+      }
+      psTrack->sExpanded.u8AnimationOpcode = psHalf->u8AnimationOpcode;
+      psTrack->sExpanded.u8AnimationOperand = psHalf->u8AnimationOperand;
+      *ppsInstr = &psTrack->sExpanded;
+    }
+    else if( FRAMES == u8Format )
+    {
+      psFrameInstr = &( (CODE const S_ANIMATION_INSTRUCTION_FRAME*)psInstructions )[ psTrack->u8Cursor ];
+      psTrack->sExpanded.u16TimingMs = psFrameInstr->u16TimingMs;
+      if( PALETTE_FRAME & psFrameInstr->u8Frame )
+      {
+        pu8Row = gcau8PaletteFrames[ psFrameInstr->u8Frame & (U8)~PALETTE_FRAME ];
+        for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
         {
-          // Left side
-          for( u8Index = 0u; u8Index < (RIGHT_LEDS_START - 1u); u8Index++ )
-          {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
-            gau8LEDBrightness[ u8Index ] += i8Change;
-            for( u8InnerIndex = u8Index; u8InnerIndex < (RIGHT_LEDS_START - 1u); u8InnerIndex++ )
-            {
-              gau8LEDBrightness[ u8InnerIndex + 1u ] += SaturateBrightness( &gau8LEDBrightness[ u8InnerIndex ] );
-            }
-          }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ RIGHT_LEDS_START - 1u ];
-          gau8LEDBrightness[ RIGHT_LEDS_START - 1u ] += i8Change;
-          SaturateBrightness( &gau8LEDBrightness[ RIGHT_LEDS_START - 1u ] );
-          // Right side
-          for( u8Index = LEDS_NUM - 1u; u8Index > RIGHT_LEDS_START; u8Index-- )
-          {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
-            gau8LEDBrightness[ u8Index ] += i8Change;
-            for( u8InnerIndex = LEDS_NUM - 1u; u8InnerIndex > RIGHT_LEDS_START; u8InnerIndex-- )
-            {
-              gau8LEDBrightness[ u8InnerIndex - 1u ] += SaturateBrightness( &gau8LEDBrightness[ u8InnerIndex ] );
-            }
-          }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ RIGHT_LEDS_START ];
-          gau8LEDBrightness[ RIGHT_LEDS_START ] += i8Change;
-          SaturateBrightness( &gau8LEDBrightness[ RIGHT_LEDS_START ] );
+          psTrack->sExpanded.au8LEDBrightness[ u8Index ] = psTrack->au8Palette[ ( pu8Row[ u8Index >> 2u ] >> ( ( u8Index & 3u ) << 1u ) ) & 3u ];
         }
-        // Downward source instruction
-        if( DSOURCE & u8OpCode )
+      }
+      else
+      {
+        memcpy( psTrack->sExpanded.au8LEDBrightness, (void*)gcau8Frames[ psFrameInstr->u8Frame ], LEDS_NUM );
+      }
+      psTrack->sExpanded.u8AnimationOpcode = psFrameInstr->u8AnimationOpcode;
+      psTrack->sExpanded.u8AnimationOperand = psFrameInstr->u8AnimationOperand;
+      *ppsInstr = &psTrack->sExpanded;
+    }
+    else
+    {
+      *ppsInstr = &psInstructions[ psTrack->u8Cursor ];
+    }
+  }
+  
+  return bFetched;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Executes a flow control instruction of a track
+//! \param  *psTrack: the track
+//! \param  *psInstr: the instruction, CONTROL is set in its opcode
+//! \return -
+//! \global gasAnimations[]
+//! \note   Takes no time, the deadline stays. Only JUMP starts the timing over, so a round stays in the
+//!         16-bit timer as long as it ends; the LOOPs and CALLs are counted in the round as any other
+//!         instruction, Animation_GetPhaseMs() doesn't see them. A CALL or a LOOP beyond ANIMATION_STACK_DEPTH,
+//!         and an END without any of them are skipped; so is an unknown combination with CONTROL.
+//-----------------------------------------------------------------------------
+static void TrackControl( S_ANIMATION_TRACK* psTrack, CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr )
+{
+  U8 u8Operand = psInstr->u8AnimationOperand;
+  S_ANIMATION_FRAME* psFrame = &psTrack->asStack[ ( psTrack->u8Depth < ANIMATION_STACK_DEPTH ) ? psTrack->u8Depth : 0u ];
+  
+  psTrack->u8Cursor++;
+  if( JUMP == psInstr->u8AnimationOpcode )
+  {
+    psTrack->u8Cursor = u8Operand;
+    psTrack->u16Timer -= psTrack->u16Deadline;
+    psTrack->u16Deadline = 0u;
+  }
+  else if( LOOP == psInstr->u8AnimationOpcode )
+  {
+    if( psTrack->u8Depth < ANIMATION_STACK_DEPTH )
+    {
+      psFrame->psCode = psTrack->psCode;
+      psFrame->u8CodeLength = psTrack->u8CodeLength;
+      psFrame->u8CodeFormat = psTrack->u8CodeFormat;
+      psFrame->u8Cursor = psTrack->u8Cursor;
+      psFrame->u8Passes = ( 0u != u8Operand ) ? u8Operand : 1u;
+    }
+    if( psTrack->u8Depth < 0xFFu )
+    {
+      psTrack->u8Depth++;  // one too deep runs once, its END has to be matched still
+    }
+  }
+  else if( CALL == psInstr->u8AnimationOpcode )
+  {
+    if( ( psTrack->u8Depth < ANIMATION_STACK_DEPTH ) && ( u8Operand < ( sizeof( gasAnimations )/sizeof( S_ANIMATION ) ) )
+     && ( NULL == gasAnimations[ u8Operand ].pfNative ) )  // a native animation has no table to run
+    {
+      psFrame->psCode = psTrack->psCode;
+      psFrame->u8CodeLength = psTrack->u8CodeLength;
+      psFrame->u8CodeFormat = psTrack->u8CodeFormat;
+      psFrame->u8Cursor = psTrack->u8Cursor;
+      psFrame->u8Passes = 0u;
+      psTrack->u8Depth++;
+      psTrack->psCode = gasAnimations[ u8Operand ].psInstructionsNormal;
+      psTrack->u8CodeLength = gasAnimations[ u8Operand ].u8AnimationLengthNormal;
+      psTrack->u8CodeFormat = ( MIRROR | FRAMES ) & gasAnimations[ u8Operand ].u8Options;
+      psTrack->u8Cursor = 0u;
+    }
+  }
+  else if( PALETTE == psInstr->u8AnimationOpcode )
+  {
+    memcpy( psTrack->au8Palette, (void*)psInstr->au8LEDBrightness, PALETTE_SIZE );
+  }
+  else if( ( END == psInstr->u8AnimationOpcode ) && ( 0u != psTrack->u8Depth ) )
+  {
+    if( psTrack->u8Depth > ANIMATION_STACK_DEPTH )
+    {
+      psTrack->u8Depth--;  // a LOOP that hasn't been stored
+    }
+    else
+    {
+      psFrame = &psTrack->asStack[ psTrack->u8Depth - 1u ];
+      if( psFrame->u8Passes > 1u )  // the next pass of the block
+      {
+        psFrame->u8Passes--;
+        psTrack->u8Cursor = psFrame->u8Cursor;
+      }
+      else
+      {
+        psTrack->u8Depth--;
+        psTrack->psCode = psFrame->psCode;
+        psTrack->u8CodeLength = psFrame->u8CodeLength;
+        psTrack->u8CodeFormat = psFrame->u8CodeFormat;
+        if( 0u == psFrame->u8Passes )  // return from the CALL
         {
-          // Left side
-          for( u8Index = (RIGHT_LEDS_START - 1u); u8Index > 0u; u8Index-- )
-          {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
-            gau8LEDBrightness[ u8Index ] += i8Change;
-            for( u8InnerIndex = u8Index; u8InnerIndex > 0u; u8InnerIndex-- )
-            {
-              gau8LEDBrightness[ u8InnerIndex - 1u ] += SaturateBrightness( &gau8LEDBrightness[ u8InnerIndex ] );
-            }
-          }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ 0u ];
-          gau8LEDBrightness[ 0u ] += i8Change;
-          SaturateBrightness( &gau8LEDBrightness[ 0u ] );
-          // Right side
-          for( u8Index = RIGHT_LEDS_START; u8Index < (LEDS_NUM - 1u); u8Index++ )
-          {
-            i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
-            gau8LEDBrightness[ u8Index ] += i8Change;
-            for( u8InnerIndex = RIGHT_LEDS_START; u8InnerIndex < (LEDS_NUM - 1u); u8InnerIndex++ )
-            {
-              gau8LEDBrightness[ u8InnerIndex + 1u ] += SaturateBrightness( &gau8LEDBrightness[ u8InnerIndex ] );
-            }
-          }
-          i8Change = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ LEDS_NUM - 1u ];
-          gau8LEDBrightness[ LEDS_NUM - 1u ] += i8Change;
-          SaturateBrightness( &gau8LEDBrightness[ LEDS_NUM - 1u ] );
+          psTrack->u8Cursor = psFrame->u8Cursor;
         }
-        // Divide instruction
-        if( DIV & u8OpCode )
+      }
+    }
+  }
+  // The instructions may run again at the same index, so REPEAT has to start over
+  psTrack->u8LastState = 0xFFu;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Executes the instructions of a track which are due
+//! \param  *psTrack: the track
+//! \param  *psInstructions: program of the track
+//! \param  u8Length: number of instructions of the program
+//! \return TRUE if an instruction has been executed
+//! \global -
+//! \note   Usually there's none due, so this is a single comparison. The flow control ones run in the
+//!         same call as the instruction after them, at most CONTROL_TRANSFERS_MAX of them; the rest of
+//!         a table looping without any time in its loop goes on in the next cycles.
+//-----------------------------------------------------------------------------
+static BOOL TrackExecute( S_ANIMATION_TRACK* psTrack, const S_ANIMATION_INSTRUCTION_NORMAL CODE* psInstructions, U8 u8Length )
+{
+  U8   u8AnimationState;
+  U8   u8Index;
+  U8   u8OpCode;
+  U8   u8Transfers = 0u;
+  BOOL bExecuted = FALSE;
+  CODE const S_ANIMATION_INSTRUCTION_NORMAL* psInstr;
+#if UTIL_PROFILING
+  E_ANIMATION_COST_OP eCost;
+  U32  u32ProfileStart;
+#endif
+  
+  while( ( psTrack->u16Timer >= psTrack->u16Deadline ) && ( u8Transfers < CONTROL_TRANSFERS_MAX )
+      && TrackFetch( psTrack, psInstructions, u8Length, &psInstr ) )
+  {
+    u8AnimationState = psTrack->u8Cursor;
+    u8OpCode = psInstr->u8AnimationOpcode;
+#if UTIL_PROFILING
+    u32ProfileStart = Util_ProfileStart();
+    eCost = ANIMATION_COST_OPS;  // the operations are measured one by one
+#endif
+    if( CONTROL == ( CONTROL & u8OpCode ) )  // flow control, goes on at once
+    {
+      TrackControl( psTrack, psInstr );
+      u8Transfers++;
+#if UTIL_PROFILING
+      eCost = ANIMATION_COST_CONTROL;
+#endif
+    }
+    // Just a load instruction, nothing more
+    else if( LOAD == u8OpCode )
+    {
+      memcpy( psTrack->pu8Levels, (void*)psInstr->au8LEDBrightness, LEDS_NUM );
+      psTrack->u8LastState = u8AnimationState;
+#if UTIL_PROFILING
+      eCost = ANIMATION_COST_LOAD;
+#endif
+    }
+    else if( LERP == u8OpCode )  // fade, continued by LerpStep() in the next cycles
+    {
+      LerpStart( &psTrack->sLerp, psTrack->pu8Levels, psInstr->au8LEDBrightness, LEDS_NUM, psInstr->u16TimingMs, psInstr->u8AnimationOperand );
+      psTrack->u8LastState = u8AnimationState;
+#if UTIL_PROFILING
+      eCost = ANIMATION_COST_LERP;
+#endif
+    }
+    else if( GENERATE == u8OpCode )  // generator, continued by GeneratorStep() in the next cycles
+    {
+      GeneratorStart( &psTrack->sGenerator, psInstr, psTrack->pu8Levels );
+      psTrack->u8LastState = u8AnimationState;
+#if UTIL_PROFILING
+      eCost = ANIMATION_COST_GENERATE;
+#endif
+    }
+    else  // Other opcodes -- IMPORTANT: the order of operations are fixed!
+    {
+#if ANIMATION_COMPILED
+      // A built-in program runs its own straight-line code
+      if( !CompiledExecute( ( NULL != psTrack->psCode ) ? psTrack->psCode : psInstructions, u8AnimationState, psTrack->pu8Levels ) )
+#endif
+      {
+        // Execute the operations in the fixed order of the dispatch table
+        for( u8Index = 0u; u8Index < ( sizeof( gcasNormalOperations )/sizeof( S_ANIMATION_OPERATION ) ); u8Index++ )
         {
-          for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+          if( gcasNormalOperations[ u8Index ].u8Opcode & u8OpCode )
           {
-            u8Temp = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].au8LEDBrightness[ u8Index ];
-            if( u8Temp != 0u )
-            {
-              gau8LEDBrightness[ u8Index ] /= u8Temp;
-            }
+#if UTIL_PROFILING
+            u32ProfileStart = Util_ProfileStart();
+            gcasNormalOperations[ u8Index ].pfOperation( psInstr, psTrack->pu8Levels );
+            Util_ProfileAdd( &gasAnimationOpCost[ ANIMATION_COST_ADD + u8Index ], u32ProfileStart );
+#else
+            gcasNormalOperations[ u8Index ].pfOperation( psInstr, psTrack->pu8Levels );
+#endif
           }
         }
-        // Repeat instruction
-        if( REPEAT & u8OpCode )
+      }
+      // Repeat instruction
+      if( REPEAT & u8OpCode )
+      {
+        // If we're here the first time
+        if( 0u == psTrack->u8RepetitionCounter )
+        {
+          psTrack->u8RepetitionCounter = psInstr->u8AnimationOperand;
+          // Step back in time
+          psTrack->u16Timer -= psInstr->u16TimingMs;
+        }
+        else  // We're already repeating...
         {
-          // If we're here the first time
-          if( 0u == u8RepetitionCounter )
+          psTrack->u8RepetitionCounter--;
+          if( 0u != psTrack->u8RepetitionCounter )
           {
-            u8RepetitionCounter = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].u8AnimationOperand;
             // Step back in time
-            gu16NormalTimer -= gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].u16TimingMs;
+            psTrack->u16Timer -= psInstr->u16TimingMs;
           }
-          else  // We're already repeating...
+          else  // No more repeating
           {
-            u8RepetitionCounter--;
-            if( 0u != u8RepetitionCounter )
-            {
-              // Step back in time
-              gu16NormalTimer -= gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsNormal[ u8AnimationState ].u16TimingMs;
-            }
-            else  // No more repeating
-            {
-             u8LastState = u8AnimationState;
-            }
+            psTrack->u8LastState = u8AnimationState;
           }
         }
-        else  // if there's no repeat opcode
-        {
-          u8LastState = u8AnimationState;  // save that this operation is finished
-        }
       }
-    }
-    
-    // --------------------------------------< For the RGB LED
-    // Calculate the state of the animation
-    u16StateTimer = 0u;
-    for( u8AnimationState = 0u; u8AnimationState < gasAnimations[ gsPersistentData.u8AnimationIndex ].u8AnimationLengthRGB; u8AnimationState++ )
-    {
-      u16StateTimer += gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].u16TimingMs;
-      if( u16StateTimer > gu16RGBTimer )
+      else  // if there's no repeat opcode
       {
-        break;
+        psTrack->u8LastState = u8AnimationState;  // save that this operation is finished
       }
     }
-/*
-    if( u8AnimationState >= gasAnimations[ gsPersistentData.u8AnimationIndex ].u8AnimationLengthRGB )
+    if( ( psTrack->u8LastState == u8AnimationState ) && ( CONTROL != ( CONTROL & u8OpCode ) ) )  // finished, step to the next instruction
     {
-      // restart animation
-      u8AnimationState = 0u;
-      DISABLE_IT;
-      gu16SynchronizedTimer = 0;
-      ENABLE_IT;
+      psTrack->u16Deadline += psInstr->u16TimingMs;
+      psTrack->u8Cursor++;
     }
-*/
-    if( u8LastStateRGB != u8AnimationState )  // next instruction
+#if UTIL_PROFILING
+    if( ANIMATION_COST_OPS != eCost )
     {
-      u8OpCode = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].u8AnimationOpcode;
-      // Just a load instruction, nothing more
-      if( LOAD == u8OpCode )
-      {
-        memcpy( (U8*)gau8RGBLEDs, (void*)gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].au8RGBLEDBrightness, NUM_RGBLED_COLORS );
-        u8LastStateRGB = u8AnimationState;
-      }
-      else  // Other opcodes -- IMPORTANT: the order of operations are fixed!
-      {
-        // Add operation
-        if( ADD & u8OpCode )
-        {
-          for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
-          {
-            gau8RGBLEDs[ u8Index ] += gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].au8RGBLEDBrightness[ u8Index ];
-            if( gau8RGBLEDs[ u8Index ] > 15u )  // overflow/underflow happened
-            {
-              gau8RGBLEDs[ u8Index ] = 0u;
-            }
-          }
-        }
-        // Right shift operation
-        if( RSHIFT & u8OpCode )
-        {
-          // Not implemented
-        }
-        // Left shift operation
-        if( LSHIFT & u8OpCode )
-        {
-          // Not implemented
-        }
-/*
-        // Upward move operation
-        if( UMOVE & u8OpCode )
-        {
-          // Not implemented
-        }
-        // Downward move operation
-        if( DMOVE & u8OpCode )
-        {
-          // Not implemented
-        }
-*/
-        if( USOURCE & u8OpCode )
+      Util_ProfileAdd( &gasAnimationOpCost[ eCost ], u32ProfileStart );
+    }
+    gu32CostChanges++;
+#endif
+    bExecuted = TRUE;
+  }
+  
+  return bExecuted;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Runs the frames of the native animation of a track which are due
+//! \param  *psTrack: the track, with its pfNative
+//! \param  u8Length: number of instructions of the program, the end of the round
+//! \return TRUE if a frame has been drawn
+//! \global -
+//! \note   The time of a frame is added to the deadline as the one of an instruction, so the track
+//!         restarts, seeks and idles as the one of a table. No more than CONTROL_TRANSFERS_MAX frames
+//!         are drawn in a call, the rest of a seek goes on in the next cycles.
+//-----------------------------------------------------------------------------
+static BOOL TrackNative( S_ANIMATION_TRACK* psTrack, U8 u8Length )
+{
+  U16  u16WaitMs;
+  U8   u8Frames = 0u;
+  BOOL bExecuted = FALSE;
+  
+  while( ( psTrack->u16Timer >= psTrack->u16Deadline ) && ( u8Frames < CONTROL_TRANSFERS_MAX ) && ( psTrack->u8Cursor < u8Length ) )
+  {
+    u16WaitMs = psTrack->pfNative( &psTrack->u16Resume, psTrack->pu8Levels );
+    if( 0u == u16WaitMs )  // end of the round, restarted by TrackRestart()
+    {
+      psTrack->u8Cursor = u8Length;
+    }
+    else
+    {
+      psTrack->u16Deadline += u16WaitMs;
+      bExecuted = TRUE;
+    }
+    u8Frames++;
+  }
+  
+  return bExecuted;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells how long a track will surely not change its levels
+//! \param  *psTrack: the track
+//! \param  u16Pending: time elapsed, but not yet accounted by Animation_Cycle()
+//! \return Time until the next instruction of the track in ms; 0 if it is due or a fade/generator is running
+//! \global -
+//-----------------------------------------------------------------------------
+static U16 TrackIdleMs( const S_ANIMATION_TRACK* psTrack, U16 u16Pending )
+{
+  U16 u16Idle = 0u;
+  
+  if( ( NULL == psTrack->sLerp.pu8Target ) && ( NULL == psTrack->sGenerator.pu8Params ) && ( psTrack->u16Deadline > ( psTrack->u16Timer + u16Pending ) ) )
+  {
+    u16Idle = psTrack->u16Deadline - psTrack->u16Timer - u16Pending;
+  }
+  
+  return u16Idle;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Converts real time to the time of the animation, by the playback rate
+//! \param  u16Ms: real time in ms
+//! \return Time of the animation in 8.8 fixed point ms, with the fraction left over by the last cycle
+//! \global gu16SpeedQ8, gu8SpeedFraction
+//-----------------------------------------------------------------------------
+static U32 ScaleTime( U16 u16Ms )
+{
+  return (U32)u16Ms * gu16SpeedQ8 + gu8SpeedFraction;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Restart the animation state machine with a new program
+//! \param  psAnimation: the animation to be played
+//! \return -
+//! \global All the animation state
+//! \note   Should be called from main cycle only! The drivers are set up here for the whole
+//!         animation, from its options and its profile, so the frames aren't analyzed for it.
+//-----------------------------------------------------------------------------
+static void Play( const S_ANIMATION CODE* psAnimation )
+{
+#if ANIMATION_MAX_LAYERS
+  U8 u8Index;
+  
+#endif
+  gpsAnimation = psAnimation;
+  gu16AheadMs = 0u;
+  TrackReset( &sTrackNormal, gau8LEDBrightness, ( MIRROR | FRAMES ) & psAnimation->u8Options );
+  sTrackNormal.pfNative = psAnimation->pfNative;
+  gu16RGBTimer = 0u;
+  u8LastStateRGB = 0xFFu;
+  u8RepetitionCounterRGB = 0u;
+  u8RGBCursor = 0u;
+  gu16RGBDeadline = 0u;
+  sLerpRGB.pu8Target = NULL;
+#if ANIMATION_MAX_LAYERS
+  gu8NumLayers = ( psAnimation->u8NumLayers < ANIMATION_MAX_LAYERS ) ? psAnimation->u8NumLayers : ANIMATION_MAX_LAYERS;
+  for( u8Index = 0u; u8Index < gu8NumLayers; u8Index++ )
+  {
+    memset( gau8LayerLevels[ u8Index ], 0, LEDS_NUM );
+    TrackReset( &gasLayerTracks[ u8Index ], gau8LayerLevels[ u8Index ], 0u );
+  }
+#endif
+  gau8Shown[ 0u ] = 0xFFu;  // no level is this high, the first frame is handed over for sure
+#if LED_FAST_REFRESH
+  // Steps shorter than a few periods of the normal refresh would be shown with the jitter of its period
+  LED_SetFastRefresh( ( 0u != ( FAST_REFRESH & psAnimation->u8Options ) )
+                   || ( ( NULL != psAnimation->psProfile ) && ( psAnimation->psProfile->u16MinStepMs < ANIMATION_FAST_STEP_MS ) ) );
+#endif
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Puts the programs of the animation just started to the given time
+//! \param  u16Ms: time since the start of the animation, in ms of the animation
+//! \return -
+//! \global sTrackNormal, gu16RGBTimer, gasLayerTracks[]
+//! \note   The instructions due by then run in the next Advance().
+//-----------------------------------------------------------------------------
+static void Position( U16 u16Ms )
+{
+#if ANIMATION_MAX_LAYERS
+  U8 u8Index;
+  
+#endif
+  sTrackNormal.u16Timer = u16Ms;
+  gu16RGBTimer = u16Ms;
+#if ANIMATION_MAX_LAYERS
+  for( u8Index = 0u; u8Index < gu8NumLayers; u8Index++ )
+  {
+    gasLayerTracks[ u8Index ].u16Timer = u16Ms;
+  }
+#endif
+}
+
+#if ANIMATION_RESUME
+//----------------------------------------------------------------------------
+//! \brief  Puts back the programs of the animation just started from the snapshot of the last power-down
+//! \param  psAnimation: the animation just started
+//! \return TRUE if the snapshot was of this animation, and it goes on from there
+//! \global gsResume, all the program state of the animation
+//! \note   The snapshot is used once: it is dropped whether it matches or not, so a later start of
+//!         the same animation starts over. Copies only, no replay: it costs the same at any depth.
+//!         The levels are put back too, they are the operands of the next ADDs and shifts.
+//!         A native animation starts over: its static state isn't in the snapshot.
+//-----------------------------------------------------------------------------
+static BOOL Resume( const S_ANIMATION CODE* psAnimation )
+{
+  BOOL bResumed = FALSE;
+  
+  if( ( RESUME_MAGIC == gsResume.u32Magic ) && ( (U32)~RESUME_MAGIC == gsResume.u32Seal )
+   && ( psAnimation == gsResume.psAnimation ) && ( NULL == psAnimation->pfNative ) )
+  {
+    sTrackNormal = gsResume.sTrackNormal;
+    sLerpRGB = gsResume.sLerpRGB;
+    gu16RGBTimer = gsResume.u16RGBTimer;
+    gu16RGBDeadline = gsResume.u16RGBDeadline;
+    u8RGBCursor = gsResume.u8RGBCursor;
+    u8LastStateRGB = gsResume.u8LastStateRGB;
+    u8RepetitionCounterRGB = gsResume.u8RepetitionCounterRGB;
+    gu8SpeedFraction = gsResume.u8SpeedFraction;
+    memcpy( gau8LEDBrightness, gsResume.au8Levels, LEDS_NUM );
+    memcpy( (U8*)gau8RGBLEDs, &gsResume.au8Levels[ LEDS_NUM ], NUM_RGBLED_COLORS );
+#if ANIMATION_MAX_LAYERS
+    gu8NumLayers = gsResume.u8NumLayers;
+    memcpy( gasLayerTracks, gsResume.asLayerTracks, sizeof( gasLayerTracks ) );
+    memcpy( gau8LayerLevels, gsResume.au8LayerLevels, sizeof( gau8LayerLevels ) );
+#endif
+    bResumed = TRUE;
+  }
+  gsResume.u32Magic = 0u;
+  
+  return bResumed;
+}
+#endif
+
+#if ANIMATION_MAX_LAYERS
+//----------------------------------------------------------------------------
+//! \brief  Blends a layer over a frame
+//! \param  *pu8Frame: normal LED levels below the layer, overwritten by the result
+//! \param  *pu8Layer: levels of the layer
+//! \param  *psLayer: the layer, for its LED mask and blend mode
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+static void Blend( U8* pu8Frame, const U8* pu8Layer, const S_ANIMATION_LAYER CODE* psLayer )
+{
+  U8  u8Index;
+  U8  u8Level;
+  U16 u16Mask = psLayer->u16Mask;
+  
+  for( u8Index = 0u; ( u8Index < LEDS_NUM ) && ( 0u != u16Mask ); u8Index++, u16Mask >>= 1u )
+  {
+    if( u16Mask & 1u )
+    {
+      u8Level = pu8Layer[ u8Index ];
+      switch( psLayer->u8Blend )
+      {
+        case BLEND_ADD:
+          u8Level += pu8Frame[ u8Index ];
+          if( u8Level > LED_BRIGHTNESS_MAX )
+          {
+            u8Level = LED_BRIGHTNESS_MAX;
+          }
+          break;
+        
+        case BLEND_MAX:
+          if( u8Level < pu8Frame[ u8Index ] )
+          {
+            u8Level = pu8Frame[ u8Index ];
+          }
+          break;
+        
+        case BLEND_MASK:
+          // Multiplying by 17 makes LED_BRIGHTNESS_MAX * 17 = 255, i.e. practically 1.0 in 8 bit fixed point
+          u8Level = (U8)( ( (U16)pu8Frame[ u8Index ] * u8Level * 17u + 128u ) >> 8u );
+          break;
+        
+        default:
+          u8Level = pu8Frame[ u8Index ];
+          break;
+      }
+      pu8Frame[ u8Index ] = u8Level;
+    }
+  }
+}
+#endif
+
+//----------------------------------------------------------------------------
+//! \brief  Composes the frame to be shown: the normal LEDs with the layers blended over them,
+//!         mixed with the previous animation while a crossfade is running
+//! \param  *pu8Frame: the frame, normal LEDs then the colors
+//! \return -
+//! \global gau8LEDBrightness[], gau8RGBLEDs[], gau8LayerLevels[][], sCrossfade, gu16FlashMs
+//! \note   A flash burst of the phase lock covers the normal LEDs.
+//-----------------------------------------------------------------------------
+static void Render( U8* pu8Frame )
+{
+  U8 u8Index;
+  
+  memcpy( pu8Frame, gau8LEDBrightness, LEDS_NUM );
+  memcpy( &pu8Frame[ LEDS_NUM ], (U8*)gau8RGBLEDs, NUM_RGBLED_COLORS );
+#if ANIMATION_MAX_LAYERS
+  for( u8Index = 0u; u8Index < gu8NumLayers; u8Index++ )
+  {
+    Blend( pu8Frame, gau8LayerLevels[ u8Index ], &gpsAnimation->psLayers[ u8Index ] );
+  }
+#endif
+#if ANIMATION_CROSSFADE_MS
+  if( sCrossfade.u32Mix < CROSSFADE_END )
+  {
+    for( u8Index = 0u; u8Index < ( LEDS_NUM + NUM_RGBLED_COLORS ); u8Index++ )
+    {
+      pu8Frame[ u8Index ] = Mix( sCrossfade.au8Frame[ u8Index ], pu8Frame[ u8Index ], (U16)( sCrossfade.u32Mix >> 8u ) );
+    }
+  }
+#endif
+#if SYNC_ENABLE
+  if( 0u != gu16FlashMs )
+  {
+    memset( pu8Frame, LED_BRIGHTNESS_MAX, LEDS_NUM );
+  }
+#endif
+  (void)u8Index;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Hands over the frame to the LED driver, if it really differs from the one shown
+//! \param  bChanged: TRUE if the VM has executed an instruction or stepped a fade since the previous call
+//! \param  u16DueMs: time to show the frame at, see LED_CommitAt()
+//! \return -
+//! \global gau8LEDBrightness[], gau8RGBLEDs[], gau8Shown[]
+//! \note   The VM writes its levels even if they stay the same (e.g. a shift of a uniform frame,
+//!         or an ADD of zeros), so the frame is compared to the one handed over last, and the
+//!         precomputation of LED_Commit() is skipped on an unchanged frame. Most animations have
+//!         no layers, and between the animations there's no crossfade, so the levels of the VM
+//!         are the frame itself. Otherwise it is composed after every change (in every cycle of a
+//!         crossfade), and as the VM works on the level arrays in place, they hold the composed
+//!         frame only for the time of LED_Commit(). In ladder mode the RGB LED driver reads
+//!         gau8RGBLEDs[] by itself, so the colors are not crossfaded there.
+//-----------------------------------------------------------------------------
+static void Commit( BOOL bChanged, U16 u16DueMs )
+{
+  BOOL bCompose = FALSE;
+  U8   au8Frame[ LEDS_NUM + NUM_RGBLED_COLORS ];
+  U8   au8RGB[ NUM_RGBLED_COLORS ];
+  
+#if ANIMATION_MAX_LAYERS
+  bCompose = ( 0u != gu8NumLayers );
+#endif
+#if SYNC_ENABLE
+  bCompose |= ( 0u != gu16FlashMs );
+#endif
+#if ANIMATION_CROSSFADE_MS
+  if( sCrossfade.u32Mix < CROSSFADE_END )  // the mix changes by itself
+  {
+    bCompose = TRUE;
+    bChanged = TRUE;
+  }
+#endif
+  if( bChanged )
+  {
+    Render( au8Frame );
+    if( 0 != memcmp( au8Frame, gau8Shown, sizeof( gau8Shown ) ) )
+    {
+      memcpy( gau8Shown, au8Frame, sizeof( gau8Shown ) );
+      if( !bCompose )
+      {
+        LED_CommitAt( u16DueMs );
+      }
+      else
+      {
+        // Swap the frame in, hand it over, then give the VM its levels back
+        memcpy( au8Frame, gau8LEDBrightness, LEDS_NUM );
+        memcpy( au8RGB, (U8*)gau8RGBLEDs, NUM_RGBLED_COLORS );
+        memcpy( gau8LEDBrightness, gau8Shown, LEDS_NUM );
+        memcpy( (U8*)gau8RGBLEDs, &gau8Shown[ LEDS_NUM ], NUM_RGBLED_COLORS );
+        LED_CommitAt( u16DueMs );
+        memcpy( gau8LEDBrightness, au8Frame, LEDS_NUM );
+        memcpy( (U8*)gau8RGBLEDs, au8RGB, NUM_RGBLED_COLORS );
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Plays the programs for the time elapsed, and hands over the frame
+//! \param  u16Elapsed: real time elapsed since the previous call, 0 for the entry state of an animation
+//! \param  u16TimeNow: time of Util_GetTimerMs() played to, the render-ahead not included
+//! \return -
+//! \global All the animation state
+//! \note   With no time elapsed, only the instructions due are run: the ones at the start of the
+//!         programs, or the ones up to the position set by Position() or Resume().
+//-----------------------------------------------------------------------------
+static void Advance( U16 u16Elapsed, U16 u16TimeNow )
+{
+  U8  u8AnimationState;
+  CODE const S_ANIMATION_INSTRUCTION_RGB*    psInstrRGB;
+  U16 u16Played;
+  U32 u32Scaled;
+  U8  u8Index;
+  U8  u8OpCode;
+  BOOL bFrameChanged = FALSE;
+  
+  // The programs run at the playback rate, the crossfade and the flash in real time
+  u32Scaled = ScaleTime( u16Elapsed );
+  u16Played = (U16)( u32Scaled >> 8u );
+  gu8SpeedFraction = (U8)u32Scaled;
+  // Increase the synchronized timers with the difference, and continue the running fades and generators
+  bFrameChanged |= TrackStep( &sTrackNormal, u16Played );
+  gu16RGBTimer += u16Played;
+  bFrameChanged |= LerpStep( &sLerpRGB, (U8*)gau8RGBLEDs, NUM_RGBLED_COLORS, u16Played );
+#if ANIMATION_MAX_LAYERS
+  for( u8Index = 0u; u8Index < gu8NumLayers; u8Index++ )
+  {
+    bFrameChanged |= TrackStep( &gasLayerTracks[ u8Index ], u16Played );
+  }
+#endif
+  
+  // --------------------------------------< For the normal LEDs
+  // Restart animation at the end of the program, the RGB program restarts with it unless it loops on its own
+  if( TrackRestart( &sTrackNormal, gpsAnimation->u8AnimationLengthNormal ) && ( 0u == ( LOOP_RGB & gpsAnimation->u8Options ) ) )
+  {
+    gu16RGBTimer = sTrackNormal.u16Timer;
+    u8RGBCursor = 0u;
+    gu16RGBDeadline = 0u;
+    u8LastStateRGB = 0xFFu;
+  }
+  if( NULL != sTrackNormal.pfNative )
+  {
+    bFrameChanged |= TrackNative( &sTrackNormal, gpsAnimation->u8AnimationLengthNormal );
+  }
+  else
+  {
+    bFrameChanged |= TrackExecute( &sTrackNormal, gpsAnimation->psInstructionsNormal, gpsAnimation->u8AnimationLengthNormal );
+  }
+  
+  // --------------------------------------< For the RGB LED
+  // The RGB program waits for the normal LEDs at its end, or restarts by itself if it loops on its own
+  if( ( 0u != ( LOOP_RGB & gpsAnimation->u8Options ) ) && ( 0u != gpsAnimation->u8AnimationLengthRGB )
+   && ( u8RGBCursor >= gpsAnimation->u8AnimationLengthRGB ) && ( gu16RGBTimer >= gu16RGBDeadline ) )
+  {
+    gu16RGBTimer -= gu16RGBDeadline;
+    u8RGBCursor = 0u;
+    gu16RGBDeadline = 0u;
+    u8LastStateRGB = 0xFFu;
+  }
+  while( ( u8RGBCursor < gpsAnimation->u8AnimationLengthRGB ) && ( gu16RGBTimer >= gu16RGBDeadline ) )
+  {
+    u8AnimationState = u8RGBCursor;
+    psInstrRGB = &gpsAnimation->psInstructionsRGB[ u8AnimationState ];
+    u8OpCode = psInstrRGB->u8AnimationOpcode;
+    // The previous fade must end before the next instruction, even if this cycle came late
+    LerpStep( &sLerpRGB, (U8*)gau8RGBLEDs, NUM_RGBLED_COLORS, 0xFFFFu );
+    // Just a load instruction, nothing more
+    if( LOAD == u8OpCode )
+    {
+      memcpy( (U8*)gau8RGBLEDs, (void*)psInstrRGB->au8RGBLEDBrightness, NUM_RGBLED_COLORS );
+      u8LastStateRGB = u8AnimationState;
+    }
+    else if( LERP == u8OpCode )  // fade, continued by LerpStep() in the next cycles
+    {
+      LerpStart( &sLerpRGB, (U8*)gau8RGBLEDs, psInstrRGB->au8RGBLEDBrightness, NUM_RGBLED_COLORS, psInstrRGB->u16TimingMs, psInstrRGB->u8AnimationOperand );
+      u8LastStateRGB = u8AnimationState;
+    }
+    else if( HSV == u8OpCode )  // a load, converted once
+    {
+      HsvToRgb( psInstrRGB->au8RGBLEDBrightness, (U8*)gau8RGBLEDs );
+      u8LastStateRGB = u8AnimationState;
+    }
+    else  // Other opcodes -- IMPORTANT: the order of operations are fixed!
+    {
+      // Add operation
+      if( ADD & u8OpCode )
+      {
+        for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
         {
-          // Not implemented
+          gau8RGBLEDs[ u8Index ] += gpsAnimation->psInstructionsRGB[ u8AnimationState ].au8RGBLEDBrightness[ u8Index ];
+          if( LERP & u8OpCode )  // SATADD
+          {
+            (void)SaturateBrightness( (U8*)&gau8RGBLEDs[ u8Index ] );
+          }
+          else if( gau8RGBLEDs[ u8Index ] > 15u )  // overflow/underflow happened
+          {
+            gau8RGBLEDs[ u8Index ] = 0u;
+          }
         }
-        if( DSOURCE & u8OpCode )
+      }
+      // Right shift operation
+      if( RSHIFT & u8OpCode )
+      {
+        // Not implemented
+      }
+      // Left shift operation
+      if( LSHIFT & u8OpCode )
+      {
+        // Not implemented
+      }
+/*
+      // Upward move operation
+      if( UMOVE & u8OpCode )
+      {
+        // Not implemented
+      }
+      // Downward move operation
+      if( DMOVE & u8OpCode )
+      {
+        // Not implemented
+      }
+*/
+      if( USOURCE & u8OpCode )
+      {
+        // Not implemented
+      }
+      if( DSOURCE & u8OpCode )
+      {
+        // Not implemented
+      }
+      if( DIV & u8OpCode )
+      {
+        for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
         {
-          // Not implemented
+          gau8RGBLEDs[ u8Index ] = Divide( gau8RGBLEDs[ u8Index ],
+                                           gpsAnimation->psInstructionsRGB[ u8AnimationState ].au8RGBLEDBrightness[ u8Index ] );
         }
-        if( DIV & u8OpCode )
+      }
+      // Repeat instruction
+      if( REPEAT & u8OpCode )
+      {
+        // If we're here the first time
+        if( 0u == u8RepetitionCounterRGB )
         {
-          for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
-          {
-            u8Temp = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].au8RGBLEDBrightness[ u8Index ];
-            if( u8Temp != 0u )
-            {
-              gau8RGBLEDs[ u8Index ] /= u8Temp;
-            }
-          }
+          u8RepetitionCounterRGB = gpsAnimation->psInstructionsRGB[ u8AnimationState ].u8AnimationOperand;
+          // Step back in time
+          gu16RGBTimer -= gpsAnimation->psInstructionsRGB[ u8AnimationState ].u16TimingMs;
         }
-        // Repeat instruction
-        if( REPEAT & u8OpCode )
+        else  // We're already repeating...
         {
-          // If we're here the first time
-          if( 0u == u8RepetitionCounterRGB )
+          u8RepetitionCounterRGB--;
+          if( 0u != u8RepetitionCounterRGB )
           {
-            u8RepetitionCounterRGB = gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].u8AnimationOperand;
             // Step back in time
-            gu16RGBTimer -= gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].u16TimingMs;
+            gu16RGBTimer -= gpsAnimation->psInstructionsRGB[ u8AnimationState ].u16TimingMs;
           }
-          else  // We're already repeating...
+          else  // No more repeating
           {
-            u8RepetitionCounterRGB--;
-            if( 0u != u8RepetitionCounterRGB )
-            {
-              // Step back in time
-              gu16RGBTimer -= gasAnimations[ gsPersistentData.u8AnimationIndex ].psInstructionsRGB[ u8AnimationState ].u16TimingMs;
-            }
-            else  // No more repeating
-            {
-             u8LastStateRGB = u8AnimationState;
-            }
+           u8LastStateRGB = u8AnimationState;
           }
         }
-        else  // if there's no repeat opcode
-        {
-          u8LastStateRGB = u8AnimationState;  // save that this operation is finished
-        }
       }
-    }    
-    // Store the timestamp
+      else  // if there's no repeat opcode
+      {
+        u8LastStateRGB = u8AnimationState;  // save that this operation is finished
+      }
+    }
+    if( u8LastStateRGB == u8AnimationState )  // finished, step to the next instruction
+    {
+      gu16RGBDeadline += gpsAnimation->psInstructionsRGB[ u8AnimationState ].u16TimingMs;
+      u8RGBCursor++;
+      if( ( u8RGBCursor >= gpsAnimation->u8AnimationLengthRGB ) && ( 0u == ( LOOP_RGB & gpsAnimation->u8Options ) ) )
+      {
+        gu16RGBDeadline = 0xFFFFu;  // no more RGB events until restart
+      }
+    }
+    bFrameChanged = TRUE;
+  }
+#if ANIMATION_MAX_LAYERS
+  // --------------------------------------< For the layers, each loops on its own
+  for( u8Index = 0u; u8Index < gu8NumLayers; u8Index++ )
+  {
+    TrackRestart( &gasLayerTracks[ u8Index ], gpsAnimation->psLayers[ u8Index ].u8Length );
+    bFrameChanged |= TrackExecute( &gasLayerTracks[ u8Index ], gpsAnimation->psLayers[ u8Index ].psInstructions, gpsAnimation->psLayers[ u8Index ].u8Length );
+  }
+#endif
+#if ANIMATION_CROSSFADE_MS
+  if( sCrossfade.u32Mix < CROSSFADE_END )
+  {
+    sCrossfade.u32Mix += ( CROSSFADE_END / ANIMATION_CROSSFADE_MS ) * u16Elapsed;
+    if( sCrossfade.u32Mix >= CROSSFADE_END )
+    {
+      sCrossfade.u32Mix = CROSSFADE_END;
+      bFrameChanged = TRUE;  // the last step hands over the running animation alone
+    }
+  }
+#endif
+#if SYNC_ENABLE
+  if( 0u != gu16FlashMs )
+  {
+    // The frame changes at both ends of the flash
+    gu16FlashMs = ( u16Elapsed < gu16FlashMs ) ? ( gu16FlashMs - u16Elapsed ) : 0u;
+    bFrameChanged = TRUE;
+  }
+#endif
+  // Hand over the new frame to the LED driver, for the time it has been played to
+  Commit( bFrameChanged, u16TimeNow + gu16AheadMs );
+}
+
+#if ANIMATION_CROSSFADE_MS
+//----------------------------------------------------------------------------
+//! \brief  Mixes two brightness levels
+//! \param  u8From: level of the previous animation
+//! \param  u8To: level of the running animation
+//! \param  u16Weight: weight of the running animation, [0; 256]
+//! \return Rounded mix of the levels
+//! \global -
+//-----------------------------------------------------------------------------
+static U8 Mix( U8 u8From, U8 u8To, U16 u16Weight )
+{
+  return (U8)( ( (U16)u8To * u16Weight + (U16)u8From * ( 256u - u16Weight ) + 128u ) >> 8u );
+}
+#endif
+
+#if ANIMATION_IN_SET( BOUNCE )
+//----------------------------------------------------------------------------
+//! \brief  Native animation: a ball dropped from the top on both sides, bouncing till it rests
+//! \param  *pu16Resume: where the animation goes on, see NATIVE_BEGIN()
+//! \param  *pu8Levels: normal LED levels to be drawn on
+//! \return Time until the next frame in ms; 0 at the end of the round
+//! \global gi16BounceHeight, gi16BounceSpeed
+//! \note   The ball is drawn between the two LEDs of its height, so it moves smoothly. Every bounce
+//!         keeps 3/4 of the speed.
+//-----------------------------------------------------------------------------
+static U16 Bounce( U16* pu16Resume, U8* pu8Levels )
+{
+  U8 u8Led;
+  U8 u8Fraction;
+  
+  NATIVE_BEGIN( pu16Resume );
+  gi16BounceHeight = (I16)BOUNCE_TOP;
+  gi16BounceSpeed = 0;
+  do
+  {
+    gi16BounceSpeed -= BOUNCE_GRAVITY;
+    gi16BounceHeight += gi16BounceSpeed;
+    if( gi16BounceHeight <= 0 )
+    {
+      gi16BounceHeight = 0;
+      gi16BounceSpeed = (I16)( ( -3 * gi16BounceSpeed ) >> 2 );
+    }
+    
+    // The ball on the left side, from the bottom up, and mirrored on the right one
+    memset( pu8Levels, 0, LEDS_NUM );
+    u8Led = (U8)( (U16)gi16BounceHeight >> 8u );
+    u8Fraction = (U8)gi16BounceHeight;
+    pu8Levels[ u8Led ] = (U8)( ( ( 256u - u8Fraction ) * LED_BRIGHTNESS_MAX ) >> 8u );
+    pu8Levels[ LEDS_NUM - 1u - u8Led ] = pu8Levels[ u8Led ];
+    if( ( u8Led + 1u ) < RIGHT_LEDS_START )
+    {
+      pu8Levels[ u8Led + 1u ] = (U8)( ( (U16)u8Fraction * LED_BRIGHTNESS_MAX ) >> 8u );
+      pu8Levels[ LEDS_NUM - 2u - u8Led ] = pu8Levels[ u8Led + 1u ];
+    }
+    NATIVE_YIELD( pu16Resume, BOUNCE_FRAME_MS );
+  } while( ( 0 != gi16BounceHeight ) || ( gi16BounceSpeed >= BOUNCE_REST_SPEED ) );
+  
+  NATIVE_YIELD( pu16Resume, BOUNCE_REST_MS );
+  NATIVE_END( pu16Resume );
+}
+#endif
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Initialize layer
+//! \param  -
+//! \return -
+//! \global All globals in this layer.
+//! \note   Should be called in the init block of the firmware. The pseudo-random generator and
+//!         the phase are seeded from the UID here, once.
+//-----------------------------------------------------------------------------
+void Animation_Init( void )
+{
+  char CODE* pu8UID = Util_Get_UID_ptr();
+  U32 u32Hash = 2166136261uL;
+  U8  u8Index;
+  
+  // FNV-1a of the UID: every unit plays its own random sequences, and starts at its own phase
+  for( u8Index = 0u; u8Index < UID_LENGTH; u8Index++ )
+  {
+    u32Hash = ( u32Hash ^ (U8)pu8UID[ u8Index ] ) * 16777619uL;
+  }
+  if( 0u != u32Hash )
+  {
+    u32RandomState = u32Hash;
+  }
+#if ANIMATION_PHASE_MS
+  gu16PhaseMs = (U16)( ( u32Hash >> 8u ) % ANIMATION_PHASE_MS );
+#endif
+  Play( gpsAnimation );
+  gu16LastCall = Util_GetTimerMs();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Check timer and update LED brightnesses based on the animation.
+//! \param  -
+//! \return -
+//! \global With UTIL_PROFILING gasAnimationCost[]
+//! \note   Should be called from main cycle. With UTIL_PROFILING, the costs are booked to the selected
+//!         animation, so the boot and the survival animations and a crossfade count to it too.
+//-----------------------------------------------------------------------------
+void Animation_Cycle( void )
+{
+  U16 u16TimeNow = Util_GetTimerMs();
+  U16 u16Elapsed = u16TimeNow - gu16LastCall;
+#if UTIL_PROFILING
+  U32 u32ProfileStart = Util_ProfileStart();
+  volatile S_ANIMATION_COST* psCost;
+  U16 u16Levels = 0u;
+  U8  u8Index;
+#endif
+  
+  // The time played ahead is taken first; after that the next change may be played ahead again
+  if( u16Elapsed >= gu16AheadMs )
+  {
+    u16Elapsed -= gu16AheadMs;
+    gu16AheadMs = 0u;
+#if ANIMATION_RENDER_AHEAD_MS
+    gu16AheadMs = RenderAheadMs( u16Elapsed );
+    u16Elapsed += gu16AheadMs;
+#endif
     gu16LastCall = u16TimeNow;
   }
+  else
+  {
+    u16Elapsed = 0u;
+  }
+  
+  // Check if time has elapsed since last call
+  if( 0u != u16Elapsed )
+  {
+#if UTIL_PROFILING
+    // The frame shown until now, for the time elapsed
+    for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+    {
+      u16Levels += gau8Shown[ u8Index ];
+    }
+    Advance( u16Elapsed, u16TimeNow );
+    if( gsPersistentData.u8AnimationIndex < NUM_ANIMATIONS )
+    {
+      psCost = &gasAnimationCost[ gsPersistentData.u8AnimationIndex ];
+      if( 0u == psCost->u32Ms )  // restarted over SWD
+      {
+        psCost->u32LevelMs = 0u;
+      }
+      psCost->u32Ms += u16Elapsed;
+      psCost->u32LevelMs += (U32)u16Levels * u16Elapsed;
+      psCost->u32Changes += gu32CostChanges;
+      Util_ProfileAdd( &psCost->sCycles, u32ProfileStart );
+    }
+    gu32CostChanges = 0u;
+#else
+    Advance( u16Elapsed, u16TimeNow );
+#endif
+  }
 }
 
 //----------------------------------------------------------------------------
 //! \brief  Set the new animation
-//! \param  -
+//! \param  u8AnimationIndex: index of the animation in gasAnimations[]; ignored if out of range
 //! \return -
-//! \global -
-//! \note   Should be called from main cycle only!
+//! \global gsPersistentData, sCrossfade, gu16PhaseMs, gsResume, gu16LastCall
+//! \note   Should be called from main cycle only! The new animation fades in over
+//!         ANIMATION_CROSSFADE_MS, except the shutdown signal, which must be seen at once.
+//!         With ANIMATION_PHASE_MS it starts gu16PhaseMs ahead, so neighbouring units differ.
+//!         After Animation_SetSurvival() the survival animation is played instead, but the index
+//!         is saved all the same. With ANIMATION_RESUME the animation of the last Animation_Suspend()
+//!         goes on from the snapshot, once. Its entry state is played here, not in the next
+//!         cycle: the first frame is handed over to the driver for the next period boundary.
 //-----------------------------------------------------------------------------
 void Animation_Set( U8 u8AnimationIndex )
 {
+  const S_ANIMATION CODE* psAnimation;
+  
   if( u8AnimationIndex < NUM_ANIMATIONS )
   {
-    gsPersistentData.u8AnimationIndex = u8AnimationIndex;
-    DISABLE_IT;
-    gu16NormalTimer = 0u;
-    gu16RGBTimer = 0u;
-    ENABLE_IT;
-    u8LastState = 0xFFu;
-    u8RepetitionCounter = 0u;
-    u8LastStateRGB = 0xFFu;
-    u8RepetitionCounterRGB = 0u;
+    // The last one is the shutdown signal, it is never resumed
+    if( u8AnimationIndex < NUM_ANIMATIONS-1u )
+    {
+      gsPersistentData.u8AnimationIndex = u8AnimationIndex;
+#if ANIMATION_CROSSFADE_MS
+      // Start from the frame shown now; an interrupted crossfade starts from its mix, so nothing jumps
+      Render( sCrossfade.au8Frame );
+      sCrossfade.u32Mix = 0u;
+#endif
+    }
+#if ANIMATION_CROSSFADE_MS
+    else
+    {
+      sCrossfade.u32Mix = CROSSFADE_END;
+    }
+#endif
+    psAnimation = &gasAnimations[ u8AnimationIndex ];
+#if UPLOAD_ENABLE
+    if( 0u == u8AnimationIndex )
+    {
+      psAnimation = gpsFirstAnimation;
+    }
+#endif
+    if( gbitSurvival && ( u8AnimationIndex < NUM_ANIMATIONS-1u ) )
+    {
+      psAnimation = &gsSurvivalAnimation;
+    }
+    Play( psAnimation );
+#if ANIMATION_RESUME
+    // Back from a power-down: on from where it was left
+    if( ( u8AnimationIndex >= NUM_ANIMATIONS-1u ) || !Resume( psAnimation ) )
+#endif
+    {
+#if ANIMATION_PHASE_MS
+      if( u8AnimationIndex < NUM_ANIMATIONS-1u )
+      {
+        Position( gu16PhaseMs );  // start with the head start of this unit
+      }
+#endif
+    }
+    // The entry state is played at once, and the time of the animation starts now: the time the
+    // previous one has idled since its last cycle isn't taken for the new one
+    gu16LastCall = Util_GetTimerMs();
+    Advance( 0u, gu16LastCall );
   }
 }
 
+//----------------------------------------------------------------------------
+//! \brief  Plays the animation from the given time on
+//! \param  u16Ms: time since the start of the animation, in ms of the animation
+//! \return -
+//! \global sTrackNormal, gu16RGBTimer, gasLayerTracks[]
+//! \note   Should be called from main cycle only! The effects of ADD and REPEAT add up, so the
+//!         programs start over and replay the instructions due by then in the next cycle, without
+//!         showing the frames in between. The time past the end of a round goes on in the next
+//!         one, a round is replayed per cycle. The fades and generators running by then start at
+//!         the time they are reached, not in the middle.
+//-----------------------------------------------------------------------------
+void Animation_Seek( U16 u16Ms )
+{
+  Play( gpsAnimation );
+  Position( u16Ms );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Start the boot animation
+//! \param  -
+//! \return -
+//! \global -
+//! \note   Should be called from main cycle only! Doesn't change the saved animation index.
+//-----------------------------------------------------------------------------
+void Animation_PlayBoot( void )
+{
+  Play( &gsBootAnimation );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Plays the survival animation from now on, instead of the selected ones
+//! \param  -
+//! \return -
+//! \global gbitSurvival
+//! \note   Should be called from main cycle only! Takes effect at the next Animation_Set(); it
+//!         lasts until the next reset, the cell doesn't recover.
+//-----------------------------------------------------------------------------
+void Animation_SetSurvival( void )
+{
+  gbitSurvival = 1;
+}
+
+#if ANIMATION_RESUME
+//----------------------------------------------------------------------------
+//! \brief  Takes a snapshot of the animation being played, for the wake-up from a power-down
+//! \param  -
+//! \return -
+//! \global gsResume, all the program state of the animation
+//! \note   Should be called from main cycle only, before the fade-out of the power-down replaces
+//!         the animation. The next Animation_Set() of the same animation goes on from here, in the
+//!         time of the animation: the time powered down doesn't count. The snapshot is in RAM kept
+//!         by the stop mode and by a reset, not over a change of the cell. The frames rendered
+//!         ahead are not kept, so it may go on up to ANIMATION_RENDER_AHEAD_MS later.
+//-----------------------------------------------------------------------------
+void Animation_Suspend( void )
+{
+  gsResume.psAnimation = gpsAnimation;
+  gsResume.sTrackNormal = sTrackNormal;
+  gsResume.sLerpRGB = sLerpRGB;
+  gsResume.u16RGBTimer = gu16RGBTimer;
+  gsResume.u16RGBDeadline = gu16RGBDeadline;
+  gsResume.u8RGBCursor = u8RGBCursor;
+  gsResume.u8LastStateRGB = u8LastStateRGB;
+  gsResume.u8RepetitionCounterRGB = u8RepetitionCounterRGB;
+  gsResume.u8SpeedFraction = gu8SpeedFraction;
+  memcpy( gsResume.au8Levels, gau8LEDBrightness, LEDS_NUM );
+  memcpy( &gsResume.au8Levels[ LEDS_NUM ], (const U8*)gau8RGBLEDs, NUM_RGBLED_COLORS );
+#if ANIMATION_MAX_LAYERS
+  gsResume.u8NumLayers = gu8NumLayers;
+  memcpy( gsResume.asLayerTracks, gasLayerTracks, sizeof( gasLayerTracks ) );
+  memcpy( gsResume.au8LayerLevels, gau8LayerLevels, sizeof( gau8LayerLevels ) );
+#endif
+  gsResume.u32Seal = ~RESUME_MAGIC;
+  gsResume.u32Magic = RESUME_MAGIC;
+}
+#endif
+
+#if UPLOAD_ENABLE
+//----------------------------------------------------------------------------
+//! \brief  Plays the uploaded animation instead of the first one
+//! \param  psImage: the uploaded image, from Upload_GetImage(); NULL if there is none
+//! \return -
+//! \global gsUploadedAnimation, gpsFirstAnimation
+//! \note   Should be called from init block, after Animation_Init(). The instructions are executed
+//!         right from the flash, only the table pointers are in RAM. An image whose size doesn't
+//!         match its instruction counts is ignored, like one without normal LED instructions.
+//-----------------------------------------------------------------------------
+void Animation_SetUploaded( const S_UPLOAD_HEADER* psImage )
+{
+  const U8* pu8Body;
+  
+  if( ( NULL != psImage ) && ( 0u != psImage->u8LengthNormal )
+   && ( psImage->u16BodySize == psImage->u8Trims + psImage->u8LengthNormal * sizeof( S_ANIMATION_INSTRUCTION_NORMAL )
+                              + psImage->u8LengthRGB * sizeof( S_ANIMATION_INSTRUCTION_RGB ) ) )
+  {
+    pu8Body = &( (const U8*)&psImage[ 1u ] )[ psImage->u8Trims ];  // the instructions are after the trims
+    gsUploadedAnimation.u8AnimationLengthNormal = psImage->u8LengthNormal;
+    gsUploadedAnimation.psInstructionsNormal = (const S_ANIMATION_INSTRUCTION_NORMAL*)pu8Body;
+    gsUploadedAnimation.u8AnimationLengthRGB = psImage->u8LengthRGB;
+    gsUploadedAnimation.psInstructionsRGB = (const S_ANIMATION_INSTRUCTION_RGB*)&pu8Body[ psImage->u8LengthNormal * sizeof( S_ANIMATION_INSTRUCTION_NORMAL ) ];
+    gsUploadedAnimation.u8NumLayers = 0u;
+    gsUploadedAnimation.psLayers = NULL;
+    gsUploadedAnimation.u8Options = psImage->u8Options & (U8)~( MIRROR | FRAMES );  // the image has the normal instructions in full
+    gsUploadedAnimation.psProfile = NULL;
+    gsUploadedAnimation.pfNative = NULL;
+    gpsFirstAnimation = &gsUploadedAnimation;
+  }
+}
+#endif
+
+//----------------------------------------------------------------------------
+//! \brief  Tells how long the programs will surely not change the LEDs
+//! \param  u16Pending: real time since the time the programs have been played to, in ms
+//! \return Time until the next instruction in ms; 0 if it is already due or a fade/generator/crossfade is running
+//! \global sTrackNormal, gasLayerTracks[], gu16RGBTimer, gu16RGBDeadline, gu16SpeedInvQ8
+//! \note   The programs wait in the time of the animation, that is turned back to real ms rounded
+//!         up, so a slow playback sleeps longer.
+//-----------------------------------------------------------------------------
+static U16 IdleMs( U16 u16Pending )
+{
+  U16 u16Idle;
+  U16 u16Played = (U16)( ScaleTime( u16Pending ) >> 8u );  // the same in the time of the animation
+  U32 u32Real;
+#if ANIMATION_MAX_LAYERS
+  U8  u8Index;
+  U16 u16Layer;
+#endif
+  
+  u16Idle = TrackIdleMs( &sTrackNormal, u16Played );
+#if ANIMATION_MAX_LAYERS
+  for( u8Index = 0u; u8Index < gu8NumLayers; u8Index++ )
+  {
+    u16Layer = TrackIdleMs( &gasLayerTracks[ u8Index ], u16Played );
+    if( u16Layer < u16Idle )
+    {
+      u16Idle = u16Layer;
+    }
+  }
+#endif
+  if( ( 0u != u16Idle ) && ( 0xFFFFu != gu16RGBDeadline ) )
+  {
+    if( gu16RGBDeadline > ( gu16RGBTimer + u16Played ) )
+    {
+      if( ( gu16RGBDeadline - gu16RGBTimer - u16Played ) < u16Idle )
+      {
+        u16Idle = gu16RGBDeadline - gu16RGBTimer - u16Played;
+      }
+    }
+    else
+    {
+      u16Idle = 0u;
+    }
+  }
+  // Back to real time
+  u32Real = ( (U32)u16Idle * gu16SpeedInvQ8 + ( SPEED_ONE - 1u ) ) >> 8u;
+  u16Idle = ( u32Real < 0xFFFFu ) ? (U16)u32Real : 0xFFFFu;
+  if( NULL != sLerpRGB.pu8Target )
+  {
+    u16Idle = 0u;
+  }
+#if ANIMATION_CROSSFADE_MS
+  if( sCrossfade.u32Mix < CROSSFADE_END )
+  {
+    u16Idle = 0u;
+  }
+#endif
+#if SYNC_ENABLE
+  if( ( 0u != gu16FlashMs ) && ( gu16FlashMs < u16Idle + u16Pending ) )
+  {
+    u16Idle = ( gu16FlashMs > u16Pending ) ? ( gu16FlashMs - u16Pending ) : 0u;
+  }
+#endif
+  
+  return u16Idle;
+}
+
+#if ANIMATION_RENDER_AHEAD_MS
+//----------------------------------------------------------------------------
+//! \brief  Tells how far the programs can be played ahead now
+//! \param  u16Pending: real time since the time the programs have been played to, in ms
+//! \return Time to play ahead in ms, up to the next instruction; 0: not now
+//! \global -
+//! \note   Only when nothing changes the LEDs until the next instruction, within
+//!         ANIMATION_RENDER_AHEAD_MS, and the driver has taken the previous frame already.
+//-----------------------------------------------------------------------------
+static U16 RenderAheadMs( U16 u16Pending )
+{
+  U16 u16Ahead = IdleMs( u16Pending );
+  
+  if( ( u16Ahead > ANIMATION_RENDER_AHEAD_MS ) || LED_IsFramePending() )
+  {
+    u16Ahead = 0u;
+  }
+  
+  return u16Ahead;
+}
+#endif
+
+//----------------------------------------------------------------------------
+//! \brief  Tells how long the animation will surely not change the LEDs
+//! \param  -
+//! \return Time until the main cycle has to call Animation_Cycle() again, in ms
+//! \global gu16LastCall, gu16AheadMs
+//! \note   Should be called from main cycle, right after Animation_Cycle(). With
+//!         ANIMATION_RENDER_AHEAD_MS the main cycle wakes up that much before the next instruction,
+//!         to play it ahead, but not before the time played ahead already has passed.
+//-----------------------------------------------------------------------------
+U16 Animation_GetIdleMs( void )
+{
+  U16 u16Since = Util_GetTimerMs() - gu16LastCall;
+  U16 u16Wait = 0u;
+  U16 u16Idle;
+  
+  if( u16Since < gu16AheadMs )
+  {
+    u16Wait = gu16AheadMs - u16Since;
+    u16Idle = IdleMs( 0u );
+    u16Idle = ( u16Idle < ( 0xFFFFu - u16Wait ) ) ? ( u16Idle + u16Wait ) : 0xFFFFu;
+  }
+  else
+  {
+    u16Idle = IdleMs( u16Since - gu16AheadMs );
+  }
+#if ANIMATION_RENDER_AHEAD_MS
+  u16Idle = ( u16Idle > ANIMATION_RENDER_AHEAD_MS ) ? ( u16Idle - ANIMATION_RENDER_AHEAD_MS ) : 0u;
+  if( u16Idle < u16Wait )
+  {
+    u16Idle = u16Wait;
+  }
+#endif
+  
+  return u16Idle;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells if the animation being played is a beacon
+//! \param  -
+//! \return TRUE if it has the BEACON option: a frame of one LED lit alone may be held in stop mode
+//! \global gpsAnimation
+//-----------------------------------------------------------------------------
+BOOL Animation_IsBeacon( void )
+{
+  return ( 0u != ( BEACON & gpsAnimation->u8Options ) );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Sets the playback rate of the animations
+//! \param  u8Speed: index of the rate, 0: real time, 1: half, 2: quarter, 3: double speed; ignored if out of range
+//! \return -
+//! \global gu16SpeedQ8, gu16SpeedInvQ8, gu8SpeedFraction
+//! \note   Scales the time of every program, so the tables don't change. A slower playback
+//!         changes the LEDs less often, and the main cycle sleeps longer in between.
+//-----------------------------------------------------------------------------
+void Animation_SetSpeed( U8 u8Speed )
+{
+  if( u8Speed < ANIMATION_SPEEDS )
+  {
+    gu16SpeedQ8 = gcau16SpeedQ8[ u8Speed ];
+    gu16SpeedInvQ8 = gcau16SpeedInvQ8[ u8Speed ];
+    gu8SpeedFraction = 0u;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Sets the playback rate of the animations by a beat
+//! \param  u16BeatMs: the beat to be played to; ANIMATION_BEAT_MS is real time
+//! \return -
+//! \global gu16SpeedQ8, gu16SpeedInvQ8, gu8SpeedFraction
+//! \note   For the tap tempo of the button. The beat is limited to a quarter and 4 times the
+//!         speed; the two divisions are done once here, not in the cycles.
+//-----------------------------------------------------------------------------
+void Animation_SetBeat( U16 u16BeatMs )
+{
+  if( u16BeatMs < BEAT_MIN_MS )
+  {
+    u16BeatMs = BEAT_MIN_MS;
+  }
+  else if( u16BeatMs > BEAT_MAX_MS )
+  {
+    u16BeatMs = BEAT_MAX_MS;
+  }
+  gu16SpeedQ8 = (U16)( ( (U32)ANIMATION_BEAT_MS * SPEED_ONE + ( u16BeatMs / 2u ) ) / u16BeatMs );
+  gu16SpeedInvQ8 = (U16)( ( (U32)u16BeatMs * SPEED_ONE + ( ANIMATION_BEAT_MS / 2u ) ) / ANIMATION_BEAT_MS );
+  gu8SpeedFraction = 0u;
+}
+
+#if SYNC_ENABLE || BUS_ENABLE
+//----------------------------------------------------------------------------
+//! \brief  Tells the phase of the animation
+//! \param  -
+//! \return Time since the start of the round of the normal LED program, in ms of the animation
+//! \global sTrackNormal, gu16LastCall, gu16AheadMs
+//! \note   Includes the time not yet accounted by Animation_Cycle(), as that only runs when an
+//!         instruction is due; the start of a round is an instruction, so it is never skipped.
+//-----------------------------------------------------------------------------
+U16 Animation_GetPhaseMs( void )
+{
+  U16 u16Phase = sTrackNormal.u16Timer + (U16)( ScaleTime( Util_GetTimerMs() - gu16LastCall ) >> 8u );
+  U16 u16Ahead = (U16)( ScaleTime( gu16AheadMs ) >> 8u );
+  
+  // A round played ahead hasn't started yet
+  return ( u16Phase > u16Ahead ) ? ( u16Phase - u16Ahead ) : 0u;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Shifts the phase of the animation
+//! \param  i16Ms: shift in ms; positive: ahead, negative: back
+//! \return -
+//! \global sTrackNormal, gu16RGBTimer, gasLayerTracks[]
+//! \note   Ahead, the instructions due run in the next cycle; back, no instruction is undone, the
+//!         program just waits a bit longer, down to the start of the round.
+//-----------------------------------------------------------------------------
+void Animation_Slew( I16 i16Ms )
+{
+  U16 u16Back;
+#if ANIMATION_MAX_LAYERS
+  U8  u8Index;
+#endif
+  
+  if( i16Ms >= 0 )
+  {
+    sTrackNormal.u16Timer += (U16)i16Ms;
+    gu16RGBTimer += (U16)i16Ms;
+#if ANIMATION_MAX_LAYERS
+    for( u8Index = 0u; u8Index < gu8NumLayers; u8Index++ )
+    {
+      gasLayerTracks[ u8Index ].u16Timer += (U16)i16Ms;
+    }
+#endif
+  }
+  else
+  {
+    u16Back = (U16)( -i16Ms );
+    if( u16Back > sTrackNormal.u16Timer )
+    {
+      u16Back = sTrackNormal.u16Timer;
+    }
+    sTrackNormal.u16Timer -= u16Back;
+    gu16RGBTimer = ( gu16RGBTimer > u16Back ) ? ( gu16RGBTimer - u16Back ) : 0u;
+#if ANIMATION_MAX_LAYERS
+    for( u8Index = 0u; u8Index < gu8NumLayers; u8Index++ )
+    {
+      gasLayerTracks[ u8Index ].u16Timer = ( gasLayerTracks[ u8Index ].u16Timer > u16Back ) ? ( gasLayerTracks[ u8Index ].u16Timer - u16Back ) : 0u;
+    }
+#endif
+  }
+}
+#endif
+
+#if SYNC_ENABLE
+//----------------------------------------------------------------------------
+//! \brief  Starts a flash burst: all LEDs at full brightness over the animation
+//! \param  u16DurationMs: length of the flash
+//! \return -
+//! \global gu16FlashMs
+//! \note   Should be called from main cycle only! The animation runs on below it.
+//-----------------------------------------------------------------------------
+void Animation_Flash( U16 u16DurationMs )
+{
+  gu16FlashMs = u16DurationMs;
+}
+#endif
 
 /***************************************< End of file >**************************************/
@@ -12,25 +12,163 @@
 #define ANIMATION_H
 
 /***************************************< Includes >**************************************/
+#include "util.h"
+#include "upload.h"
+#include "sync.h"
+#include "bus.h"
 
 
 /***************************************< Definitions >**************************************/
-#define NUM_ANIMATIONS        (18u)  //!< Number of animations implemented
+// Animations of the build, in the order of gasAnimations[], which is the order of the button. A SKU
+// selects its own with ANIMATION_SET in the project; the tables left out aren't referenced, so the
+// linker drops them. The indices follow the set: the saved animation, the playlist and CALL count in it.
+#define ANIMATION_RETRO_VERSION        (1uL << 0u)   //!< gasRetroVersion
+#define ANIMATION_SOFT_FLASHING        (1uL << 1u)   //!< gasSoftFlashing
+#define ANIMATION_SHOOTING_STAR        (1uL << 2u)   //!< gasShootingStar
+#define ANIMATION_DISCO                (1uL << 3u)   //!< gasDisco
+#define ANIMATION_STAR_LAUNCH          (1uL << 4u)   //!< gasStarLaunch
+#define ANIMATION_CRISS_CROSS          (1uL << 5u)   //!< gasCrissCross
+#define ANIMATION_GENERIC_FLASHER      (1uL << 6u)   //!< gasGenericFlasher
+#define ANIMATION_KITT                 (1uL << 7u)   //!< gasKITT
+#define ANIMATION_PINGPONG             (1uL << 8u)   //!< gasPingpong
+#define ANIMATION_FADE_RING            (1uL << 9u)   //!< gasFadeRing
+#define ANIMATION_YING_YANG            (1uL << 10u)  //!< gasYingYang
+#define ANIMATION_PSEUDO_RANDOM_FADE   (1uL << 11u)  //!< gasPseudoRandomFade
+#define ANIMATION_FADEOUT              (1uL << 12u)  //!< gasFadeout
+#define ANIMATION_FLICKER              (1uL << 13u)  //!< gasFlicker
+#define ANIMATION_RACE                 (1uL << 14u)  //!< gasRace
+#define ANIMATION_SPARKLE              (1uL << 15u)  //!< gasSparkle
+#define ANIMATION_ICE                  (1uL << 16u)  //!< gasIce
+#define ANIMATION_SPLIT2               (1uL << 17u)  //!< gasSplit2
+#define ANIMATION_SPLIT3FADE           (1uL << 18u)  //!< gasSplit3fade
+#define ANIMATION_STEPPING             (1uL << 19u)  //!< gasStepping
+#define ANIMATION_BEACON               (1uL << 20u)  //!< gasBeacon, the blink of the weeks-long SKUs
+#define ANIMATION_BOUNCE               (1uL << 21u)  //!< Bounce(), a native animation: a ball dropped on both sides
+#define ANIMATION_ALL         ( ( 1uL << 22u ) - 1u )  //!< Every animation implemented
+#ifndef ANIMATION_SET
+#define ANIMATION_SET         ( ANIMATION_ALL & ~( ANIMATION_SHOOTING_STAR | ANIMATION_FADEOUT | ANIMATION_SPLIT3FADE | ANIMATION_BEACON | ANIMATION_BOUNCE ) )  //!< Animations of the build, the bits above
+#endif
+#if ( 0u == ( ANIMATION_SET & ANIMATION_ALL ) )
+#error "ANIMATION_SET: a build needs at least one animation!"
+#endif
+#define ANIMATION_IN_SET( name ) ( ( ANIMATION_SET & ANIMATION_##name ) ? 1u : 0u )  //!< 1 if the animation is built in
+#define NUM_ANIMATIONS        ( ANIMATION_IN_SET( RETRO_VERSION ) \
+                               + ANIMATION_IN_SET( SOFT_FLASHING ) \
+                               + ANIMATION_IN_SET( SHOOTING_STAR ) \
+                               + ANIMATION_IN_SET( DISCO ) \
+                               + ANIMATION_IN_SET( STAR_LAUNCH ) \
+                               + ANIMATION_IN_SET( CRISS_CROSS ) \
+                               + ANIMATION_IN_SET( GENERIC_FLASHER ) \
+                               + ANIMATION_IN_SET( KITT ) \
+                               + ANIMATION_IN_SET( PINGPONG ) \
+                               + ANIMATION_IN_SET( FADE_RING ) \
+                               + ANIMATION_IN_SET( YING_YANG ) \
+                               + ANIMATION_IN_SET( PSEUDO_RANDOM_FADE ) \
+                               + ANIMATION_IN_SET( FADEOUT ) \
+                               + ANIMATION_IN_SET( FLICKER ) \
+                               + ANIMATION_IN_SET( RACE ) \
+                               + ANIMATION_IN_SET( SPARKLE ) \
+                               + ANIMATION_IN_SET( ICE ) \
+                               + ANIMATION_IN_SET( SPLIT2 ) \
+                               + ANIMATION_IN_SET( SPLIT3FADE ) \
+                               + ANIMATION_IN_SET( STEPPING ) \
+                               + ANIMATION_IN_SET( BEACON ) \
+                               + ANIMATION_IN_SET( BOUNCE ) \
+                               + 1u )  //!< Number of animations of the build; the last one isn't selectable
+#ifndef ANIMATION_CROSSFADE_MS
+#define ANIMATION_CROSSFADE_MS (400u) //!< Length of the crossfade when the animation is changed; 0: switch at once
+#endif
+#define ANIMATION_FADE_OUT_MS  (1000u) //!< Length of the fade of the last animation of the table, the power-down signal
+#ifndef ANIMATION_PHASE_MS
+#define ANIMATION_PHASE_MS    (2000u) //!< Range of the per-unit phase of the animations, from the UID; 0: every unit in step
+#endif
+#ifndef ANIMATION_MAX_LAYERS
+#define ANIMATION_MAX_LAYERS  (2u)   //!< Most layers an animation can blend over its normal LEDs; 0: no layer support
+#endif
+#ifndef ANIMATION_FAST_STEP_MS
+#define ANIMATION_FAST_STEP_MS (10u) //!< With LED_FAST_REFRESH 1, an animation with steps shorter than this in its profile is refreshed fast too
+#endif
+#ifndef ANIMATION_RENDER_AHEAD_MS
+#define ANIMATION_RENDER_AHEAD_MS (2u) //!< The next instruction is played this much ahead, the LED driver shows it on time; 0: when due
+#endif
+#define ANIMATION_SPEEDS      (4u)   //!< Playback rates selectable by Animation_SetSpeed()
+#define ANIMATION_BEAT_MS     (500u) //!< Beat the programs are timed to, 120 BPM: Animation_SetBeat() plays them in real time with it
+#ifndef ANIMATION_STACK_DEPTH
+#define ANIMATION_STACK_DEPTH (2u)   //!< Most LOOPs and CALLs of a track inside each other, at least 1; the further ones are ignored
+#endif
+#ifndef ANIMATION_RESUME
+#define ANIMATION_RESUME      (0u)   //!< 1: an animation left by a power-down goes on where it was after the wake-up, from a snapshot in retained RAM
+#endif
+#ifndef ANIMATION_COMPILED
+#define ANIMATION_COMPILED    (0u)   //!< 1: the operations of the built-in programs run as the C of animation_gen.inc, from tools/animgen.py
+#endif
 
 
 /***************************************< Types >**************************************/
+#if UTIL_PROFILING
+//! \brief Opcode types of the cost statistics, the index of gasAnimationOpCost[]
+typedef enum
+{
+  ANIMATION_COST_LOAD = 0u,   //!< LOAD
+  ANIMATION_COST_LERP,        //!< LERP started, and the steps of its fade in the next cycles
+  ANIMATION_COST_GENERATE,    //!< GENERATE started, and the steps of its generator in the next cycles
+  ANIMATION_COST_CONTROL,     //!< JUMP, LOOP, CALL, END and PALETTE
+  ANIMATION_COST_COMPILED,    //!< The operations of a built-in program, run as C with ANIMATION_COMPILED 1
+  ANIMATION_COST_ADD,         //!< ADD and SATADD; from here on in the order of the dispatch table, each measured alone
+  ANIMATION_COST_RSHIFT,      //!< RSHIFT
+  ANIMATION_COST_LSHIFT,      //!< LSHIFT
+  ANIMATION_COST_USOURCE,     //!< USOURCE
+  ANIMATION_COST_DSOURCE,     //!< DSOURCE
+  ANIMATION_COST_DIV,         //!< DIV
+  ANIMATION_COST_OPS          //!< Number of the opcode types
+} E_ANIMATION_COST_OP;
+
+//! \brief Cost statistics of an animation, for reading over SWD
+//! \note  The average duty of the normal LEDs is u32LevelMs / ( u32Ms * LEDS_NUM * LED_BRIGHTNESS_MAX ).
+typedef struct
+{
+  S_UTIL_PROFILE sCycles;     //!< Cycles of Animation_Cycle() with time to play, taking the interrupts preempting it; u32Count: the cycles
+  U32 u32Changes;             //!< Instructions executed by the tracks of the normal LEDs, the flow control too
+  U32 u32Ms;                  //!< Time played, the tickless sleeps too; writing 0 restarts this, and u32LevelMs in the next cycle
+  U32 u32LevelMs;             //!< Levels of the normal LEDs summed, times the ms they were shown for
+} S_ANIMATION_COST;
+#endif
 
 
 /***************************************< Constants >**************************************/
 
 
 /***************************************< Global variables >**************************************/
+#if UTIL_PROFILING
+extern volatile S_ANIMATION_COST gasAnimationCost[ NUM_ANIMATIONS ];
+extern volatile S_UTIL_PROFILE gasAnimationOpCost[ ANIMATION_COST_OPS ];
+#endif
 
 
 /***************************************< Public functions >**************************************/
 void Animation_Init( void );
 void Animation_Cycle( void );
 void Animation_Set( U8 u8AnimationIndex );
+void Animation_Seek( U16 u16Ms );
+void Animation_PlayBoot( void );
+void Animation_SetSurvival( void );
+#if ANIMATION_RESUME
+void Animation_Suspend( void );
+#endif
+U16  Animation_GetIdleMs( void );
+BOOL Animation_IsBeacon( void );
+void Animation_SetSpeed( U8 u8Speed );
+void Animation_SetBeat( U16 u16BeatMs );
+#if UPLOAD_ENABLE
+void Animation_SetUploaded( const S_UPLOAD_HEADER* psImage );
+#endif
+#if SYNC_ENABLE || BUS_ENABLE
+U16  Animation_GetPhaseMs( void );
+void Animation_Slew( I16 i16Ms );
+#endif
+#if SYNC_ENABLE
+void Animation_Flash( U16 u16DurationMs );
+#endif
 
 
 #endif /* ANIMATION_H */
@@ -16,118 +16,222 @@
 #include "led.h"
 #include "rgbled.h"
 #include "util.h"
+#include "persist.h"
+#include "animation.h"
+#include "sensor.h"
 #include "batterylevel.h"
 
 
 /***************************************< Definitions >**************************************/
+#define SWEEP_MS               (700u)  //!< Length of the sweep of the boot animation, until all LEDs are lit
+#define GAUGE_MS              (2000u)  //!< How long the charge level is shown, so the user can read it
+#define SAMPLE_PERIOD_MS     (30000u)  //!< Period of the background measurements
+#define CAP_HYSTERESIS_MV      (100u)  //!< Extra voltage needed to raise the brightness cap again
+#define CHARGE_LEVELS            (7u)  //!< Charge levels above depleted
+#define LOAD_DROP_MV           (300u)  //!< Estimated sag of the cell from no load to every LED at full brightness
+#define LOAD_DROP_MIN_MV        (50u)  //!< Measured sags are limited to this range, a glitch of the ADC can't take the cap away
+#define LOAD_DROP_MAX_MV      (1500u)
+#define PAIR_LOAD_MIN  ( LED_LOAD_FULL / 4u )  //!< Least difference of the loads of two measurements that gives a sag
+#define SOURCE_STIFF_MV         (80u)  //!< A first sag up to this is a stiff source, not a CR2032: its measured sags hit LOAD_DROP_MIN_MV
+#define SOURCE_USB_MV         (3400u)  //!< A stiff source above this is the USB supply: two fresh alkaline cells stay below it
+#define SHUTDOWN_MV           (2000u)  //!< Below this battery voltage under the present load the unit powers down, before a brown-out
+#define WRITE_THROUGH_MV      (2200u)  //!< Below this battery voltage under the present load the changes are saved at once
+#define FULL_LOAD_UA         (12000u)  //!< Estimated current of the LEDs at LED_LOAD_FULL, for the charge meter; measure it on the board
+#define UA_MS_PER_UAH      (3600000uL) //!< uA*ms in a uAh
+#define METER_SAVE_SAMPLES      (20u)  //!< The charge meter is saved after this many background measurements: 10 minutes
+#define TEMPERATURE_SAMPLES      (4u)  //!< The temperature is read after this many background measurements: 2 minutes
+#define TEMPERATURE_MIN_C      (-40)   //!< Readings are limited to the range of the sensor
+#define TEMPERATURE_MAX_C       (85)
+#if SENSOR_DARK_SLOTS
+#define TEMPERATURE_SENSORS  ( SENSOR_BIT( SENSOR_TEMPERATURE ) | SENSOR_BIT( SENSOR_VDD_DARK ) )  //!< The sensor is read in the dark, with the supply of the same slots
+#else
+#define TEMPERATURE_SENSORS  ( SENSOR_BIT( SENSOR_TEMPERATURE ) )
+#endif
 
 
 /***************************************< Types >**************************************/
+//! \brief States of the battery indicator
+typedef enum
+{
+#if BATTERY_RESISTANCE
+  BATTERY_OPEN,        //!< The ADC is converting at the light load of the start of the boot sweep
+#endif
+  BATTERY_SWEEP,       //!< The boot animation is sweeping up the gauge
+  BATTERY_MEASURE,     //!< All LEDs are lit as load, the ADC is converting
+  BATTERY_GAUGE,       //!< The charge level is shown
+  BATTERY_SAMPLE,      //!< The ADC is converting in the background
+#if BATTERY_TEMPERATURE
+  BATTERY_SAMPLE_TEMPERATURE,  //!< The ADC is converting the temperature sensor, after a background measurement
+#endif
+  BATTERY_WAIT,        //!< Waiting for the next background measurement
+  BATTERY_DONE         //!< Not started yet
+} E_BATTERY_STATE;
+
+//! \brief What a power source affords
+typedef struct
+{
+  U16  u16LoadBudget;  //!< Highest load of a frame, see LED_SetLoadBudget()
+  BOOL bCap;           //!< The global brightness is capped by the voltage, see gcau16CapMv[]
+  BOOL bFastRefresh;   //!< Every animation is refreshed fast, with LED_FAST_REFRESH
+} S_BATTERY_PROFILE;
 
 
 /***************************************< Constants >**************************************/
+//! \brief Battery voltage needed for each global brightness above the night mode, lowest first
+//! \note  The LEDs load a CR2032 heavily; near 2.0V it resets on brown-out, so it's dimmed well before that
+static CODE const U16 gcau16CapMv[ LED_DIM_FULL ] = { 2200u, 2400u, 2600u };
+//! \brief Lowest full-load battery voltage of each charge level above 0: 2.0V + level*0.8V/7
+static CODE const U16 gcau16ChargeLevelMv[ CHARGE_LEVELS ] = { 2114u, 2229u, 2343u, 2457u, 2571u, 2686u, 2800u };
+//! \brief Profile of each power source, see E_BATTERY_SOURCE
+//! \note  The AA cells don't brown out under the LEDs like a CR2032, only the shutdown voltage holds for them
+static CODE const S_BATTERY_PROFILE gcasProfiles[ BATTERY_SOURCES ] =
+{
+  { LED_LOAD_BUDGET, TRUE,  FALSE },  // BATTERY_SOURCE_COIN
+  { LED_LOAD_FULL,   FALSE, FALSE },  // BATTERY_SOURCE_AA
+  { LED_LOAD_FULL,   FALSE, TRUE  }   // BATTERY_SOURCE_USB
+};
 
 
 /***************************************< Global variables >**************************************/
+static E_BATTERY_STATE geBatteryState = BATTERY_DONE;  //!< State of the battery indicator
+static U8 gu8ChargeLevel;  //!< Charge level of the last measurement, 0..LEDS_NUM/2+1
+static U16 gu16BatteryMv;  //!< Battery voltage of the last measurement in mV
+static U8 gu8BrightnessCap = LED_DIM_FULL;  //!< Highest global brightness the battery can afford
+static BIT gbitSurvival;   //!< The charge level has dropped to 0, the survival animation is played
+static U32 gu32UsedUah;    //!< Charge drawn by the LEDs in uAh; saved in gsPersistentData.u32UsedUah every METER_SAVE_SAMPLES
+static U32 gu32UaMs;       //!< Rest of the charge below 1 uAh, in uA*ms
+static U16 gu16AverageUa;  //!< Average current of the LEDs since the previous measurement
+static U8  gu8MeterSamples;  //!< Background measurements since the charge meter has been saved
+static U32 gu32MeterMs;    //!< Time of the previous MeterCharge()
+static BIT gbitMetered;    //!< MeterCharge() has run since the boot
+#if BATTERY_RESISTANCE
+static U16 gu16LoadDropMv = LOAD_DROP_MV;  //!< Sag of the cell from no load to full load, measured by EstimateDrop()
+static U16 gu16PairMv;     //!< Battery voltage of the previous measurement, 0: none
+static U16 gu16PairLoad;   //!< Load of the LEDs at the previous measurement
+#define LOAD_DROP  ( gu16LoadDropMv )  //!< Sag of the cell at full load
+#else
+#define LOAD_DROP  ( LOAD_DROP_MV )
+#endif
+static U8 gu8Source = BATTERY_SOURCE_COIN;  //!< Power source told by DetectSource() (E_BATTERY_SOURCE)
+#if BATTERY_SOURCE_DETECT
+static BIT gbitSourceKnown;  //!< DetectSource() has run since the boot
+#endif
+#if BATTERY_TEMPERATURE
+static I8 gi8Temperature = BATTERY_TEMPERATURE_NONE;  //!< Chip temperature of the last reading in degC
+static U8 gu8TemperatureSamples = TEMPERATURE_SAMPLES;  //!< Background measurements since the last reading; the first one reads it
+#endif
 
 
 /***************************************< Static function definitions >**************************************/
-void Delay( U16 u16DelayMs );
+static void StartConversion( void );
+static BOOL ReadConversion( void );
+static void ShowGauge( void );
+static void UpdateBrightnessCap( U16 u16FullLoadMv );
+static BOOL IsDepleted( void );
+static void MeterCharge( void );
+#if BATTERY_RESISTANCE
+static void EstimateDrop( U16 u16Load );
+#endif
+#if BATTERY_SOURCE_DETECT
+static void DetectSource( U16 u16DropMv );
+#endif
+#if BATTERY_TEMPERATURE
+static void StartTemperature( void );
+static BOOL ReadTemperature( void );
+#endif
 
 
 /***************************************< Private functions >**************************************/
 //----------------------------------------------------------------------------
-//! \brief  Waits for the given number of milliseconds
-//! \param  u16DelayMs: wait time
+//! \brief  Starts measuring the internal reference against the battery voltage
+//! \param  -
 //! \return -
 //! \global -
-//! \note   Should be called from init block
+//! \note   Stop mode would halt the ADC, so the battery timer is kept due while it is converting.
+//!         The conversions are run by the sensor service.
 //-----------------------------------------------------------------------------
-void Delay( U16 u16DelayMs )
+static void StartConversion( void )
 {
-  U16 u16DelayEnd = Util_GetTimerMs() + u16DelayMs;
-  while( Util_GetTimerMs() < u16DelayEnd );
+  Sensor_Request( SENSOR_BIT( SENSOR_VDD ) );
+  Util_TimerStart( UTIL_TIMER_BATTERY, 0u );  // keeps the main loop out of stop mode until the conversion completes
 }
 
-
-/***************************************< Public functions >**************************************/
 //----------------------------------------------------------------------------
-//! \brief  Initializes battery level measurement
+//! \brief  Checks if the measurement has completed, and calculates the charge level from it
 //! \param  -
-//! \return -
-//! \global -
-//! \note   Should be called from init block
+//! \return TRUE if the measurement has completed; gu8ChargeLevel and gu16BatteryMv are valid then
+//! \global gu8ChargeLevel, gu16BatteryMv
+//! \note   The sensor service disables the ADC after the measurement. The brightness cap and the
+//!         pulses of the RGB LED follow the result.
 //-----------------------------------------------------------------------------
-void BatteryLevel_Init( void )
+static BOOL ReadConversion( void )
 {
-#warning "Port to PY32F002!"
-  /*
-  ADCTIM = 0x3Fu;      // 32 clock sampling time, 2 clocks channel selection hold time
-  ADCCFG = 0x2Fu;      // Right-aligned results registers, slowest conversion
-  ADC_CONTR = 0x80u;   // Enable ADC
-  ADC_CONTR |= 0x0Fu;  // Select internal 1.19V reference
-*/
+  BOOL bReady = FALSE;
+  U16  u16FullLoadMv;
+  U16  u16Load;
+  U16  u16Sum;
+  
+  if( Sensor_IsReady( SENSOR_BIT( SENSOR_VDD ) ) )
+  {
+    Util_TimerStop( UTIL_TIMER_BATTERY );
+    // Calculate battery voltage
+    // The voltage can be calculated using this formula: BatteryVoltage = 1.2/( u16MeasuredLevel / ADC_MAX_VALUE )
+    // The sum keeps the extra resolution of the oversampling
+    u16Sum = Sensor_GetSum( SENSOR_VDD );
+    if( 0u != u16Sum )
+    {
+      gu16BatteryMv = SENSOR_MV( u16Sum );
+    }
+    RGBLED_SetSupplyMv( gu16BatteryMv );
+    // Charge level model:
+    // As CR2032 batteries quickly drop to 2.8V under load, we assume that 2.8V means full charge
+    // And since at 2.0V our LEDs can be barely seen, at 2.0V we assume that our battery is completely depleted
+    // As we have 6 + 1 LED levels, we divide this range to 7 levels, see gcau16ChargeLevelMv[]
+    // These voltages hold with every LED at full brightness. With a lighter frame the cell sags less,
+    // so the voltage is corrected to full load first, in proportion to the duty of the current frame.
+    // With BATTERY_RESISTANCE the sag is the one measured on this cell, at its charge and temperature.
+    u16Load = LED_GetLoad();
+#if BATTERY_RESISTANCE
+    EstimateDrop( u16Load );
+#endif
+    u16FullLoadMv = (U16)( ( LOAD_DROP * (U32)( LED_LOAD_FULL - u16Load ) ) / LED_LOAD_FULL );
+    if( gu16BatteryMv > u16FullLoadMv )
+    {
+      u16FullLoadMv = gu16BatteryMv - u16FullLoadMv;
+    }
+    else
+    {
+      u16FullLoadMv = 0u;
+    }
+    gu8ChargeLevel = 0u;
+    while( ( gu8ChargeLevel < CHARGE_LEVELS ) && ( u16FullLoadMv >= gcau16ChargeLevelMv[ gu8ChargeLevel ] ) )
+    {
+      gu8ChargeLevel++;
+    }
+    UpdateBrightnessCap( u16FullLoadMv );
+    bReady = TRUE;
+  }
+  
+  return bReady;
 }
 
 //----------------------------------------------------------------------------
-//! \brief  Shows battery level on LEDs as a gauge
+//! \brief  Displays the charge level on the LEDs as a gauge
 //! \param  -
 //! \return -
-//! \global -
-//! \note   Should be called only once! Blocking function! Deinitializes ADC.
+//! \global gu8ChargeLevel, gau8LEDBrightness[], gau8RGBLEDs[]
+//! \note   The boot animation holds its last instruction meanwhile, so it doesn't overwrite it.
 //-----------------------------------------------------------------------------
-void BatteryLevel_Show( void )
+static void ShowGauge( void )
 {
-  U16 u16MeasuredLevel = 2048u;
-  U8  u8ChargeLevel;
-  U8  u8Index;
+  U8 u8Index;
   
-  // Startup animation
-  // After it, all LED brightness will be set to maximum, to ensure a significant current draw during measurement
-  for( u8Index = 0u; u8Index < LEDS_NUM/2u; u8Index++ )
-  {
-    gau8LEDBrightness[ u8Index ] = 15u;
-    gau8LEDBrightness[ LEDS_NUM - u8Index - 1u ] = 15u;
-    Delay( 100u );
-  }
-  gau8RGBLEDs[ 0u ] = 15u;
-  Delay( 100u );
-#warning "Port to PY32F002!"  
-  /*
-  // Measure battery voltage
-  ADC_CONTR |= 0x40u;  // Start conversion
-  _nop_();
-  _nop_();
-  while( !( ADC_CONTR & 0x20u ) );  // Wait for completion flag
-  u16MeasuredLevel = ADC_RES<<8u | ADC_RESL;
-  // Disable ADC to save power
-  ADC_CONTR = 0x00u;
-  // Calculate battery voltage
-  // The voltage can be calculated using this formula: BatteryVoltage = 1.19/( u16MeasuredLevel / ADC_MAX_VALUE )
-  // So the floating-point implementation would be: f32BatteryVoltage = 1.19f/( (float)u16MeasuredLevel/1024.0f );
-  // But since floating point calculations are expensive in terms of program memory(!), here we use fixed-point arithmetic...
-  // Charge level formula:
-  // As CR2032 batteries quickly drop to 2.8V under load, we assume that 2.8V means full charge
-  // And since at 2.0V our LEDs can be barely seen, at 2.0V we assume that our battery is completely depleted
-  // As we have 6 + 1 LED levels, we divide this range to 7 levels
-  // A floating-point based implementation would be: u8ChargeLevel = round( 7.0f*( f32BatteryVoltage - 2.0f )/0.8f );
-  // After simplification, the formula for charge level would be: u8ChargeLevel = round( ( 10662.4f / u16MeasuredLevel ) - 17.5f )
-*/
-  if( u16MeasuredLevel >= 610u )  // If the voltage is below 2.0V
-  {
-    u8ChargeLevel = 0u;
-  }
-  else
-  {
-    u8ChargeLevel = ( ( 42650u / u16MeasuredLevel ) - 70u )>>2u;
-  }
-  // Display the charge level on the LEDs
   for( u8Index = 0u; u8Index < LEDS_NUM/2u; u8Index++ )
   {
-    if( u8ChargeLevel >= u8Index )
+    if( gu8ChargeLevel >= u8Index )
     {
-      gau8LEDBrightness[ u8Index ] = 15u;
-      gau8LEDBrightness[ LEDS_NUM - u8Index - 1u ] = 15u;
+      gau8LEDBrightness[ u8Index ] = LED_BRIGHTNESS_MAX;
+      gau8LEDBrightness[ LEDS_NUM - u8Index - 1u ] = LED_BRIGHTNESS_MAX;
     }
     else
     {
@@ -135,7 +239,7 @@ void BatteryLevel_Show( void )
       gau8LEDBrightness[ LEDS_NUM - u8Index - 1u ] = 0u;
     }
   }
-  if( u8ChargeLevel > LEDS_NUM/2u )
+  if( gu8ChargeLevel > LEDS_NUM/2u )
   {
     gau8RGBLEDs[ 0u ] = 15u;  // Light up red LED
   }
@@ -143,8 +247,486 @@ void BatteryLevel_Show( void )
   {
     gau8RGBLEDs[ 0u ] = 0u;
   }
-  // Wait, so the user can read the battery charge level
-  Delay( 2000u );
+  LED_Commit();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Limits the global brightness according to the battery voltage
+//! \param  u16FullLoadMv: battery voltage corrected to full load
+//! \return -
+//! \global gu8BrightnessCap, gu8Source
+//! \note   The load correction takes out most of the effect of dimming on the voltage, the rest is
+//!         covered by the hysteresis: the cap is raised only well above the threshold. A source
+//!         whose profile isn't capped always gets LED_DIM_FULL.
+//-----------------------------------------------------------------------------
+static void UpdateBrightnessCap( U16 u16FullLoadMv )
+{
+  U8 u8Cap = 0u;
+  
+  if( !gcasProfiles[ gu8Source ].bCap )
+  {
+    u8Cap = LED_DIM_FULL;
+  }
+  while( ( u8Cap < LED_DIM_FULL )
+      && ( u16FullLoadMv >= ( gcau16CapMv[ u8Cap ] + ( ( u8Cap >= gu8BrightnessCap ) ? CAP_HYSTERESIS_MV : 0u ) ) ) )
+  {
+    u8Cap++;
+  }
+  gu8BrightnessCap = u8Cap;
+  LED_SetBrightnessCap( u8Cap );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Integrates the charge drawn by the LEDs since the previous call
+//! \param  -
+//! \return -
+//! \global gu32UsedUah, gu32UaMs, gu16AverageUa, gu8MeterSamples, gu32MeterMs, gbitMetered, gsPersistentData
+//! \note   The current is modelled from the load of the frames shown, as FULL_LOAD_UA at full load;
+//!         the MCU itself and the stop mode are not counted. Split in quotient and remainder, so
+//!         it fits 32 bits. The meter is saved by the deferred save, once in METER_SAVE_SAMPLES calls.
+//!         A boot on a full cell is taken as a new cell, the meter starts from 0 then; so is a
+//!         reset early in the life of the cell, the saved count is a lower bound.
+//-----------------------------------------------------------------------------
+static void MeterCharge( void )
+{
+  U32 u32Now = Util_GetTimerMs32();
+  U32 u32LoadMs = LED_TakeLoadMs();
+  U32 u32UaMs = ( u32LoadMs / LED_LOAD_FULL ) * FULL_LOAD_UA
+              + ( ( u32LoadMs % LED_LOAD_FULL ) * FULL_LOAD_UA ) / LED_LOAD_FULL;
+  
+  if( u32Now != gu32MeterMs )
+  {
+    gu16AverageUa = (U16)( u32UaMs / ( u32Now - gu32MeterMs ) );
+  }
+  gu32MeterMs = u32Now;
+  if( !gbitMetered && ( gu8ChargeLevel >= CHARGE_LEVELS ) )
+  {
+    gu32UsedUah = 0u;
+    gu32UaMs = 0u;
+    gsPersistentData.u32UsedUah = 0u;
+    Persist_SaveLater();
+  }
+  gbitMetered = 1;
+  gu32UaMs += u32UaMs;
+  gu32UsedUah += gu32UaMs / UA_MS_PER_UAH;
+  gu32UaMs %= UA_MS_PER_UAH;
+  
+  gu8MeterSamples++;
+  if( gu8MeterSamples >= METER_SAVE_SAMPLES )
+  {
+    gu8MeterSamples = 0u;
+    if( gsPersistentData.u32UsedUah != gu32UsedUah )
+    {
+      gsPersistentData.u32UsedUah = gu32UsedUah;
+      Persist_SaveLater();
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells if the cell is about to brown out
+//! \param  -
+//! \return TRUE if the last measurement is below SHUTDOWN_MV
+//! \global gu16BatteryMv
+//! \note   The voltage under the present load counts here, not the full-load one: the survival
+//!         animation is light, the cell lasts until it sags below this even with that.
+//-----------------------------------------------------------------------------
+static BOOL IsDepleted( void )
+{
+  return ( 0u != gu16BatteryMv ) && ( gu16BatteryMv < SHUTDOWN_MV );
+}
+
+#if BATTERY_RESISTANCE
+//----------------------------------------------------------------------------
+//! \brief  Measures the sag of the cell at full load from the last two measurements
+//! \param  u16Load: load of the LEDs at the measurement just taken, see LED_GetLoad()
+//! \return -
+//! \global gu16BatteryMv, gu16LoadDropMv, gu16PairMv, gu16PairLoad
+//! \note   The cell is taken as a source with an internal resistance: its voltage falls in
+//!         proportion to the current drawn, so two voltages at two loads give the sag at full
+//!         load, and the open-circuit voltage above them. This resistance rises as the cell is
+//!         drained or cold, so the full-load voltage falls with it, and the caps come earlier.
+//!         Only consecutive measurements are paired, the charge drawn between them is negligible.
+//!         The boot takes one at the start of the sweep and one at its end; the background ones
+//!         pair whenever the animation has changed the load enough. Each sag is averaged with
+//!         the previous one, for the noise of the ADC. The first sag tells the power source.
+//-----------------------------------------------------------------------------
+static void EstimateDrop( U16 u16Load )
+{
+  U16 u16LightMv = gu16PairMv;
+  U16 u16HeavyMv = gu16BatteryMv;
+  U16 u16Loads = u16Load - gu16PairLoad;
+  U32 u32Drop;
+  
+  if( u16Load < gu16PairLoad )
+  {
+    u16LightMv = gu16BatteryMv;
+    u16HeavyMv = gu16PairMv;
+    u16Loads = gu16PairLoad - u16Load;
+  }
+  if( ( 0u != gu16PairMv ) && ( 0u != gu16BatteryMv ) && ( u16Loads >= PAIR_LOAD_MIN ) && ( u16LightMv >= u16HeavyMv ) )
+  {
+    u32Drop = ( (U32)( u16LightMv - u16HeavyMv ) * LED_LOAD_FULL ) / u16Loads;
+    if( u32Drop < LOAD_DROP_MIN_MV )
+    {
+      u32Drop = LOAD_DROP_MIN_MV;
+    }
+    else if( u32Drop > LOAD_DROP_MAX_MV )
+    {
+      u32Drop = LOAD_DROP_MAX_MV;
+    }
+    gu16LoadDropMv = (U16)( ( gu16LoadDropMv + u32Drop + 1u ) / 2u );
+#if BATTERY_SOURCE_DETECT
+    if( !gbitSourceKnown )
+    {
+      DetectSource( (U16)u32Drop );  // the average still holds half of LOAD_DROP_MV
+    }
+#endif
+  }
+  gu16PairMv = gu16BatteryMv;
+  gu16PairLoad = u16Load;
+}
+#endif
+
+#if BATTERY_SOURCE_DETECT
+//----------------------------------------------------------------------------
+//! \brief  Tells the power source from the sag of the first pair of measurements, and applies its profile
+//! \param  u16DropMv: sag of the pair at full load, limited to LOAD_DROP_MIN_MV..LOAD_DROP_MAX_MV
+//! \return -
+//! \global gu8Source, gbitSourceKnown, gu16BatteryMv
+//! \note   A CR2032 sags hundreds of mV under the LEDs, two AA cells or a regulated supply a few
+//!         only. Of the stiff ones, the USB supply is told by its voltage. Runs once per boot: with
+//!         the gauge at its measurement, without it at the first background pair of different
+//!         loads; until then the unit runs as on a CR2032. The brightness cap follows at once.
+//-----------------------------------------------------------------------------
+static void DetectSource( U16 u16DropMv )
+{
+  gbitSourceKnown = 1;
+  if( u16DropMv > SOURCE_STIFF_MV )
+  {
+    gu8Source = BATTERY_SOURCE_COIN;
+  }
+  else if( gu16BatteryMv >= SOURCE_USB_MV )
+  {
+    gu8Source = BATTERY_SOURCE_USB;
+  }
+  else
+  {
+    gu8Source = BATTERY_SOURCE_AA;
+  }
+  LED_SetLoadBudget( gcasProfiles[ gu8Source ].u16LoadBudget );
+#if LED_FAST_REFRESH
+  LED_SetFastRefreshAlways( gcasProfiles[ gu8Source ].bFastRefresh );
+#endif
+}
+#endif
+
+#if BATTERY_TEMPERATURE
+//----------------------------------------------------------------------------
+//! \brief  Starts measuring the internal temperature sensor
+//! \param  -
+//! \return -
+//! \global -
+//! \note   Like StartConversion(), with the sensor instead of the reference. The sensor needs
+//!         10 us to settle from its enable: the 239.5 cycles of sampling at any clock, or the wait
+//!         for the first dark segment with SENSOR_DARK_SLOTS.
+//-----------------------------------------------------------------------------
+static void StartTemperature( void )
+{
+  Sensor_Request( TEMPERATURE_SENSORS );
+  Util_TimerStart( UTIL_TIMER_BATTERY, 0u );  // keeps the main loop out of stop mode until the conversion completes
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Checks if the temperature measurement has completed, and calculates the temperature
+//! \param  -
+//! \return TRUE if the measurement has completed; gi8Temperature is valid then
+//! \global gi8Temperature, gu16BatteryMv
+//! \note   The factory calibration is taken at 30 and 85 degC with 12 bits and a 3.3V supply, so
+//!         the sum of the 10-bit conversions is scaled to 12 bits and to 3.3V with the supply of
+//!         the conversions: with SENSOR_DARK_SLOTS the one in the same dark segments, otherwise
+//!         the battery voltage measured just before. A chip without calibration values keeps the
+//!         old reading.
+//-----------------------------------------------------------------------------
+static BOOL ReadTemperature( void )
+{
+  BOOL bReady = FALSE;
+  I32  i32Cal1 = (I32)( *TEMPSENSOR_CAL1_ADDR & 0x0FFFu );
+  I32  i32Cal2 = (I32)( *TEMPSENSOR_CAL2_ADDR & 0x0FFFu );
+  I32  i32Raw;
+  I32  i32Celsius;
+  U16  u16SupplyMv = gu16BatteryMv;
+  
+  if( Sensor_IsReady( TEMPERATURE_SENSORS ) )
+  {
+    Util_TimerStop( UTIL_TIMER_BATTERY );
+#if SENSOR_DARK_SLOTS
+    u16SupplyMv = ( 0u != Sensor_GetSum( SENSOR_VDD_DARK ) ) ? SENSOR_MV( Sensor_GetSum( SENSOR_VDD_DARK ) ) : 0u;
+#endif
+    if( ( i32Cal2 != i32Cal1 ) && ( 0u != u16SupplyMv ) )
+    {
+      i32Raw = (I32)( ( ( (U32)Sensor_GetSum( SENSOR_TEMPERATURE ) * 4u / SENSOR_OVERSAMPLES ) * u16SupplyMv ) / TEMPSENSOR_CAL_VREFANALOG );
+      i32Celsius = TEMPSENSOR_CAL1_TEMP
+                 + ( ( i32Raw - i32Cal1 ) * ( TEMPSENSOR_CAL2_TEMP - TEMPSENSOR_CAL1_TEMP ) ) / ( i32Cal2 - i32Cal1 );
+      if( i32Celsius < TEMPERATURE_MIN_C )
+      {
+        i32Celsius = TEMPERATURE_MIN_C;
+      }
+      else if( i32Celsius > TEMPERATURE_MAX_C )
+      {
+        i32Celsius = TEMPERATURE_MAX_C;
+      }
+      gi8Temperature = (I8)i32Celsius;
+      Util_SetTemperature( gi8Temperature );
+      LED_SetTemperature( gi8Temperature );
+    }
+    bReady = TRUE;
+  }
+  
+  return bReady;
+}
+#endif
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Initializes battery level measurement
+//! \param  -
+//! \return -
+//! \global -
+//! \note   Should be called from init block, after Sensor_Init()
+//-----------------------------------------------------------------------------
+void BatteryLevel_Init( void )
+{
+  geBatteryState = BATTERY_DONE;
+  gu32MeterMs = Util_GetTimerMs32();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Starts the battery indicator: the boot animation, the measurement and the gauge
+//! \param  bGauge: FALSE after a warm reset: the gauge is skipped, as with PERSIST_OPTION_SKIP_GAUGE
+//! \return -
+//! \global geBatteryState
+//! \note   Should be called only once, after Persist_Init()! Non-blocking, the indicator runs in
+//!         BatteryLevel_Cycle(). If the gauge is skipped, the saved animation starts right away,
+//!         and the ADC is sampled in the background.
+//!         Afterwards the battery is measured periodically, to cap the global brightness.
+//-----------------------------------------------------------------------------
+void BatteryLevel_Show( BOOL bGauge )
+{
+  gu32UsedUah = gsPersistentData.u32UsedUah;
+  if( !bGauge || ( gsPersistentData.u8Options & PERSIST_OPTION_SKIP_GAUGE ) )
+  {
+    Animation_Set( gsPersistentData.u8AnimationIndex );
+    StartConversion();
+    geBatteryState = BATTERY_SAMPLE;
+  }
+  else
+  {
+#if BATTERY_RESISTANCE
+    // The start of the sweep is a light load: the first of the two measurements of the sag
+    StartConversion();
+    geBatteryState = BATTERY_OPEN;
+#else
+    // The boot animation lights up all the LEDs at the end, to ensure a significant current draw during measurement
+    Animation_PlayBoot();
+    Util_TimerStart( UTIL_TIMER_BATTERY, SWEEP_MS );
+    geBatteryState = BATTERY_SWEEP;
+#endif
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Runs the battery indicator, and the survival mode of a depleted cell
+//! \param  -
+//! \return TRUE if the cell is about to brown out: the caller should power down now
+//! \global geBatteryState, gu8ChargeLevel, gbitSurvival
+//! \note   Should be called from main cycle, before Animation_Cycle(). At charge level 0 the
+//!         survival animation takes over, for the last hours of the cell. Both are decided after
+//!         the gauge, or after a background measurement.
+//!         The PY32F002A has no PVD, and its comparators need an external divider for the supply,
+//!         so a falling cell is only seen by these measurements: below WRITE_THROUGH_MV the
+//!         deferred saves are given up, a pending change is not lost when the cell dies.
+//-----------------------------------------------------------------------------
+BOOL BatteryLevel_Cycle( void )
+{
+  BOOL bMeasured = FALSE;
+  BOOL bShutdown = FALSE;
+  
+  switch( geBatteryState )
+  {
+#if BATTERY_RESISTANCE
+    case BATTERY_OPEN:     // The ADC is converting at the light load of the start of the boot sweep
+      if( ReadConversion() )
+      {
+        // The boot animation lights up all the LEDs at the end, to ensure a significant current draw during measurement
+        Animation_PlayBoot();
+        Util_TimerStart( UTIL_TIMER_BATTERY, SWEEP_MS );
+        geBatteryState = BATTERY_SWEEP;
+      }
+      break;
+    
+#endif
+    case BATTERY_SWEEP:    // The boot animation is sweeping up the gauge
+      if( Util_TimerExpired( UTIL_TIMER_BATTERY ) )
+      {
+        StartConversion();
+        geBatteryState = BATTERY_MEASURE;
+      }
+      break;
+    
+    case BATTERY_MEASURE:  // All LEDs are lit as load, the ADC is converting
+      if( ReadConversion() )
+      {
+        ShowGauge();
+        Util_TimerStart( UTIL_TIMER_BATTERY, GAUGE_MS );
+        geBatteryState = BATTERY_GAUGE;
+      }
+      break;
+    
+    case BATTERY_GAUGE:    // The charge level is shown
+      if( Util_TimerExpired( UTIL_TIMER_BATTERY ) )
+      {
+        bMeasured = TRUE;
+        Animation_Set( gsPersistentData.u8AnimationIndex );
+        Util_TimerStart( UTIL_TIMER_BATTERY, SAMPLE_PERIOD_MS );
+        geBatteryState = BATTERY_WAIT;
+      }
+      break;
+    
+    case BATTERY_SAMPLE:   // The ADC is converting in the background
+      if( ReadConversion() )
+      {
+#if BATTERY_TEMPERATURE
+        gu8TemperatureSamples++;
+        if( gu8TemperatureSamples >= TEMPERATURE_SAMPLES )
+        {
+          gu8TemperatureSamples = 0u;
+          StartTemperature();
+          geBatteryState = BATTERY_SAMPLE_TEMPERATURE;
+        }
+        else
+#endif
+        {
+          bMeasured = TRUE;
+          Util_TimerStart( UTIL_TIMER_BATTERY, SAMPLE_PERIOD_MS );
+          geBatteryState = BATTERY_WAIT;
+        }
+      }
+      break;
+    
+#if BATTERY_TEMPERATURE
+    case BATTERY_SAMPLE_TEMPERATURE:  // The ADC is converting the temperature sensor, after a background measurement
+      if( ReadTemperature() )
+      {
+        bMeasured = TRUE;
+        Util_TimerStart( UTIL_TIMER_BATTERY, SAMPLE_PERIOD_MS );
+        geBatteryState = BATTERY_WAIT;
+      }
+      break;
+#endif
+    
+    case BATTERY_WAIT:     // Waiting for the next background measurement
+      if( Util_TimerExpired( UTIL_TIMER_BATTERY ) )
+      {
+        StartConversion();
+        geBatteryState = BATTERY_SAMPLE;
+      }
+      break;
+    
+    default:  // BATTERY_DONE -- Not started yet
+      break;
+  }
+  
+  if( bMeasured )
+  {
+    MeterCharge();
+    if( ( 0u == gu8ChargeLevel ) && !gbitSurvival )
+    {
+      gbitSurvival = 1;
+      Animation_SetSurvival();
+      Animation_Set( gsPersistentData.u8AnimationIndex );
+    }
+    if( ( 0u != gu16BatteryMv ) && ( gu16BatteryMv < WRITE_THROUGH_MV ) )
+    {
+      Persist_SetWriteThrough();
+    }
+    bShutdown = IsDepleted();
+  }
+  
+  return bShutdown;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Gives the battery voltage
+//! \param  -
+//! \return Average battery voltage of the last measurement in mV; 0 before the first one
+//! \global gu16BatteryMv
+//-----------------------------------------------------------------------------
+U16 BatteryLevel_GetMv( void )
+{
+  return gu16BatteryMv;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Gives the charge drawn by the LEDs from the cell
+//! \param  -
+//! \return Charge in uAh, since the meter has been cleared
+//! \global gu32UsedUah
+//-----------------------------------------------------------------------------
+U32 BatteryLevel_GetUsedUah( void )
+{
+  return gu32UsedUah;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Gives the average current of the LEDs
+//! \param  -
+//! \return Average current in uA between the last two measurements; 0 before them
+//! \global gu16AverageUa
+//-----------------------------------------------------------------------------
+U16 BatteryLevel_GetAverageUa( void )
+{
+  return gu16AverageUa;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Gives the power source
+//! \param  -
+//! \return Source told at the boot (E_BATTERY_SOURCE); BATTERY_SOURCE_COIN until then, or without BATTERY_SOURCE_DETECT
+//! \global gu8Source
+//-----------------------------------------------------------------------------
+U8 BatteryLevel_GetSource( void )
+{
+  return gu8Source;
+}
+
+#if BATTERY_RESISTANCE
+//----------------------------------------------------------------------------
+//! \brief  Gives the internal resistance of the cell
+//! \param  -
+//! \return Resistance in ohms, from the sag measured at full load and FULL_LOAD_UA
+//! \global gu16LoadDropMv
+//! \note   LOAD_DROP_MV until two measurements at different loads have been taken.
+//-----------------------------------------------------------------------------
+U16 BatteryLevel_GetResistance( void )
+{
+  return (U16)( ( gu16LoadDropMv * 1000uL ) / FULL_LOAD_UA );
+}
+#endif
+
+#if BATTERY_TEMPERATURE
+//----------------------------------------------------------------------------
+//! \brief  Gives the temperature of the chip
+//! \param  -
+//! \return Temperature of the last reading in degC; BATTERY_TEMPERATURE_NONE before the first one
+//! \global gi8Temperature
+//! \note   The LEDs heat the chip a little, it reads somewhat above the air around the board.
+//-----------------------------------------------------------------------------
+I8 BatteryLevel_GetTemperature( void )
+{
+  return gi8Temperature;
 }
+#endif
 
 /***************************************< End of file >**************************************/
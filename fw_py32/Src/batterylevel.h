@@ -12,10 +12,32 @@
 #define BATTERYLEVEL_H
 
 /***************************************< Includes >**************************************/
+#include "types.h"
 
 /***************************************< Definitions >**************************************/
+#ifndef BATTERY_TEMPERATURE
+#define BATTERY_TEMPERATURE       (0)     //!< 1: the internal temperature sensor is read with the background measurements; the HSI trim and the LED levels follow it
+#endif
+#ifndef BATTERY_RESISTANCE
+#define BATTERY_RESISTANCE        (1)     //!< 1: the sag of the cell under load is measured from two measurements at different loads, instead of LOAD_DROP_MV
+#endif
+#ifndef BATTERY_SOURCE_DETECT
+#define BATTERY_SOURCE_DETECT     ( BATTERY_RESISTANCE )  //!< 1: the power source is told from the sag of the first pair of measurements, and its profile applied, see E_BATTERY_SOURCE
+#endif
+#if BATTERY_SOURCE_DETECT && !BATTERY_RESISTANCE
+#error "BATTERY_SOURCE_DETECT: the source is told from the sag, set BATTERY_RESISTANCE too!"
+#endif
+#define BATTERY_TEMPERATURE_NONE  (-128)  //!< BatteryLevel_GetTemperature() before the first reading
 
 /***************************************< Types >**************************************/
+//! \brief Power sources told apart by BATTERY_SOURCE_DETECT
+typedef enum
+{
+  BATTERY_SOURCE_COIN = 0u,  //!< CR2032, or not told yet: the LED load is budgeted, the brightness capped by the voltage
+  BATTERY_SOURCE_AA,         //!< 2xAA or 2xAAA pack: a stiff source, the full load is allowed
+  BATTERY_SOURCE_USB,        //!< Stiff, and above what two cells give: the full load, the fast refresh and no auto-off
+  BATTERY_SOURCES
+} E_BATTERY_SOURCE;
 
 /***************************************< Constants >**************************************/
 
@@ -23,7 +45,18 @@
 
 /***************************************< Public functions >**************************************/
 void BatteryLevel_Init( void );
-void BatteryLevel_Show( void );
+void BatteryLevel_Show( BOOL bGauge );
+BOOL BatteryLevel_Cycle( void );
+U16  BatteryLevel_GetMv( void );
+U32  BatteryLevel_GetUsedUah( void );
+U16  BatteryLevel_GetAverageUa( void );
+U8   BatteryLevel_GetSource( void );
+#if BATTERY_RESISTANCE
+U16  BatteryLevel_GetResistance( void );
+#endif
+#if BATTERY_TEMPERATURE
+I8   BatteryLevel_GetTemperature( void );
+#endif
 
 
 #endif /* BATTERYLEVEL_H */
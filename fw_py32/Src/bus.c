@@ -0,0 +1,284 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file bus.c
+*
+* \brief Wired phase lock of chained units: one master times the followers by pulses on a shared line
+*
+* \author Hekk_Elek
+*
+* \note  The units of an installation run from one supply, and share one more wire, on BUS_GPIO_PIN of
+*        each: open drain with the pull-up, so any unit can pull it low. Long chains need a stronger
+*        pull-up on the wire, e.g. 4.7k at one end.
+*        - after Bus_Init() a unit listens; a silence of BUS_CLAIM_MS, plus its UID times BUS_UNIT_MS,
+*          makes it the master, so the units of a chain don't claim it at the same time
+*        - at the start of every round of its program the master pulls the line low, for
+*          ( index of its animation + 1 ) * BUS_UNIT_MS
+*        - a follower takes the animation of the pulse, and slews its program so its round starts
+*          at the falling edge; a master seeing a pulse of another one becomes a follower
+*        - the fade-out of the master isn't followed, every unit has its own auto-off; a follower
+*          without a pulse for BUS_LOST_MS listens again, and becomes the master later
+*        The interrupt of the pin only stamps the edges; the rest runs in the main cycle. The units
+*        should play at the same speed, the pulses carry the animation only.
+*
+**********************************************************************************************************/
+
+/***************************************< Includes >**************************************/
+// Own includes
+#include "main.h"
+#include "types.h"
+#include "util.h"
+#include "animation.h"
+#include "bus.h"
+
+#if BUS_ENABLE
+
+/***************************************< Definitions >**************************************/
+#define BUS_GPIO_PORT         GPIOA    //!< Port of the bus pin, with the button on the same EXTI interrupt
+#define BUS_LINE_HIGH         ( LL_GPIO_IsInputPinSet( BUS_GPIO_PORT, BUS_GPIO_PIN ) ? 1u : 0u )  //!< Level of the line: 0 while a unit pulls it low
+
+
+/***************************************< Types >**************************************/
+//! \brief Role of the unit on the bus
+typedef enum
+{
+  BUS_LISTEN = 0u,  //!< No master heard yet
+  BUS_MASTER,       //!< Sends the pulses
+  BUS_FOLLOWER      //!< Follows the pulses of the master
+} E_BUS_ROLE;
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+static U8  gu8Role;              //!< Role of the unit (E_BUS_ROLE)
+static volatile BIT gbitDriving; //!< The unit pulls the line low itself, its edges aren't stamped
+static volatile BIT gbitFall;    //!< A falling edge of another unit is stamped
+static volatile BIT gbitRise;    //!< The pulse of the falling edge has ended
+static volatile U32 gu32FallMs;  //!< Time of the falling edge; written by Bus_Interrupt() only
+static volatile U32 gu32RiseMs;  //!< Time of the rising edge; written by Bus_Interrupt() only
+static U32 gu32HeardMs;          //!< Time of the start of listening, or of the last pulse heard
+static U32 gu32ReleaseMs;        //!< Time the master releases the line at
+static U16 gu16LastPhase;        //!< Phase of the program in the previous cycle
+static U16 gu16PeriodMs;         //!< Length of the last round of the program; 0: not known yet
+
+
+/***************************************< Static function definitions >**************************************/
+static void Lock( U16 u16Phase, U32 u32SinceMs );
+
+
+/***************************************< Private functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Slews the program so its round starts at the falling edge of the master
+//! \param  u16Phase: phase of the own program now
+//! \param  u32SinceMs: time since the falling edge
+//! \return -
+//! \global gu16PeriodMs, gu16LastPhase
+//! \note   The error is taken the shorter way round, and corrected in full: the master doesn't move.
+//-----------------------------------------------------------------------------
+static void Lock( U16 u16Phase, U32 u32SinceMs )
+{
+  I32 i32Error;
+  
+  if( ( 0u != gu16PeriodMs ) && ( u32SinceMs < gu16PeriodMs ) )
+  {
+    // Phase of the own program at the start of the round of the master
+    i32Error = (I32)u16Phase - (I32)u32SinceMs;
+    if( i32Error < 0 )
+    {
+      i32Error += (I32)gu16PeriodMs;
+    }
+    if( i32Error > (I32)( gu16PeriodMs / 2u ) )
+    {
+      i32Error -= (I32)gu16PeriodMs;
+    }
+    Animation_Slew( (I16)-i32Error );
+    gu16LastPhase = Animation_GetPhaseMs();  // a slew back is not a new round
+  }
+}
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Initializes the bus pin and its EXTI line on both edges, and starts listening
+//! \param  -
+//! \return -
+//! \global All globals of this module
+//! \note   Should be called after Button_Init(), and again after the wakeup from the power-down,
+//!         which parks the pin.
+//-----------------------------------------------------------------------------
+void Bus_Init( void )
+{
+  LL_IOP_GRP1_EnableClock( LL_IOP_GRP1_PERIPH_GPIOA );
+  LL_GPIO_SetOutputPin( BUS_GPIO_PORT, BUS_GPIO_PIN );  // released
+  LL_GPIO_SetPinOutputType( BUS_GPIO_PORT, BUS_GPIO_PIN, LL_GPIO_OUTPUT_OPENDRAIN );
+  LL_GPIO_SetPinPull( BUS_GPIO_PORT, BUS_GPIO_PIN, LL_GPIO_PULL_UP );
+  LL_GPIO_SetPinMode( BUS_GPIO_PORT, BUS_GPIO_PIN, LL_GPIO_MODE_OUTPUT );
+  
+  gu8Role = BUS_LISTEN;
+  gbitDriving = 0;
+  gbitFall = 0;
+  gbitRise = 0;
+  gu32HeardMs = Util_GetTimerMs32();
+  gu16LastPhase = 0u;
+  gu16PeriodMs = 0u;
+  
+#ifdef BUS_EXTI_CONFIG
+  LL_EXTI_SetEXTISource( LL_EXTI_CONFIG_PORTA, BUS_EXTI_CONFIG );
+#endif
+  LL_EXTI_EnableRisingTrig( BUS_EXTI_LINE );
+  LL_EXTI_EnableFallingTrig( BUS_EXTI_LINE );
+  LL_EXTI_ClearFlag( BUS_EXTI_LINE );
+  LL_EXTI_EnableIT( BUS_EXTI_LINE );
+  NVIC_SetPriority( BUTTON_EXTI_IRQn, IRQ_PRIORITY_EVENT );
+  NVIC_EnableIRQ( BUTTON_EXTI_IRQn );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Stamps an edge of the pulse of another unit
+//! \param  -
+//! \return -
+//! \global gbitDriving, gbitFall, gbitRise, gu32FallMs, gu32RiseMs
+//! \note   Should be called from the EXTI interrupt of the bus pin. The edges of the own pulse are
+//!         left out: the line is read high at its rising edge, with no falling edge stamped.
+//-----------------------------------------------------------------------------
+void Bus_Interrupt( void )
+{
+  if( !gbitDriving )
+  {
+    if( 0u == BUS_LINE_HIGH )
+    {
+      gu32FallMs = Util_GetTimerMs32();
+      gbitRise = 0;
+      gbitFall = 1;
+    }
+    else if( gbitFall )
+    {
+      gu32RiseMs = Util_GetTimerMs32();
+      gbitRise = 1;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Sends the pulses as the master, or follows them
+//! \param  pu8Animation: index of the animation played; a follower sets the one of the master, and plays it
+//! \return Time until it has to be called again in ms
+//! \global All globals of this module
+//! \note   Should be called from main cycle, after Animation_Cycle(); the EXTI of the bus wakes it up.
+//!         A new round is seen when the animation has run at its start, so the pulse is sent on time.
+//!         The index of the power-down signal, the last one, is only followed in phase.
+//-----------------------------------------------------------------------------
+U32 Bus_Cycle( U8* pu8Animation )
+{
+  U32 u32Now = Util_GetTimerMs32();
+  U16 u16Phase = Animation_GetPhaseMs();
+  BOOL bRound = ( u16Phase < gu16LastPhase );
+  U32 u32Fall;
+  U32 u32Width;
+  U8  u8Index;
+  U32 u32Next = UTIL_TIMER_NONE;
+  
+  // The length of a round is known at the start of the next one
+  if( bRound )
+  {
+    gu16PeriodMs = gu16LastPhase;
+  }
+  gu16LastPhase = u16Phase;
+  
+  if( BUS_MASTER == gu8Role )
+  {
+    if( gbitDriving )
+    {
+      if( (I32)( u32Now - gu32ReleaseMs ) >= 0 )
+      {
+        LL_GPIO_SetOutputPin( BUS_GPIO_PORT, BUS_GPIO_PIN );
+        gbitDriving = 0;
+      }
+      else
+      {
+        u32Next = gu32ReleaseMs - u32Now;
+      }
+    }
+    else if( gbitFall )
+    {
+      // Another master: the one heard first keeps sending
+      gu8Role = BUS_FOLLOWER;
+      gu32HeardMs = u32Now;
+    }
+    else if( bRound )
+    {
+      gbitDriving = 1;
+      LL_GPIO_ResetOutputPin( BUS_GPIO_PORT, BUS_GPIO_PIN );
+      gu32ReleaseMs = u32Now + (U32)( *pu8Animation + 1u ) * BUS_UNIT_MS;
+      u32Next = gu32ReleaseMs - u32Now;
+    }
+  }
+  
+  if( BUS_MASTER != gu8Role )
+  {
+    if( gbitRise )
+    {
+      u32Fall = gu32FallMs;
+      u32Width = gu32RiseMs - u32Fall;
+      gbitFall = 0;
+      gbitRise = 0;
+      gu8Role = BUS_FOLLOWER;
+      gu32HeardMs = u32Now;
+  
+      u8Index = (U8)( ( u32Width + BUS_UNIT_MS / 2u ) / BUS_UNIT_MS );
+      if( ( u8Index >= 1u ) && ( u8Index < NUM_ANIMATIONS ) && ( ( u8Index - 1u ) != *pu8Animation ) )
+      {
+        // Another animation: started at the time of the falling edge
+        *pu8Animation = u8Index - 1u;
+        Animation_Set( *pu8Animation );
+        Animation_Seek( (U16)( u32Now - u32Fall ) );
+        gu16LastPhase = Animation_GetPhaseMs();
+        gu16PeriodMs = 0u;
+      }
+      else
+      {
+        Lock( u16Phase, u32Now - u32Fall );
+      }
+    }
+  
+    // The silence on the bus
+    if( BUS_LISTEN == gu8Role )
+    {
+      u32Width = BUS_CLAIM_MS + (U32)Util_Get_UID_ptr()[ 0u ] * BUS_UNIT_MS;
+    }
+    else
+    {
+      u32Width = BUS_LOST_MS;
+    }
+    if( ( u32Now - gu32HeardMs ) >= u32Width )
+    {
+      gu8Role = ( BUS_LISTEN == gu8Role ) ? BUS_MASTER : BUS_LISTEN;
+      gu32HeardMs = u32Now;
+      u32Next = 0u;
+    }
+    else
+    {
+      u32Next = u32Width - ( u32Now - gu32HeardMs );
+    }
+  }
+  
+  return u32Next;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells if the unit takes its timing from the bus
+//! \param  -
+//! \return TRUE while listening or following: the edges are stamped by the ms timer
+//! \global gu8Role
+//! \note   The ms timer doesn't run in stop mode, so these units shouldn't stop TIM1.
+//-----------------------------------------------------------------------------
+BOOL Bus_IsFollower( void )
+{
+  return ( BUS_MASTER != gu8Role );
+}
+
+#endif /* BUS_ENABLE */
+
+/***************************************< End of file >**************************************/
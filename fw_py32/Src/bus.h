@@ -0,0 +1,61 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file bus.h
+*
+* \brief Wired phase lock of chained units: one master times the followers by pulses on a shared line
+*
+* \author Hekk_Elek
+*
+**********************************************************************************************************/
+#ifndef BUS_H
+#define BUS_H
+
+/***************************************< Includes >**************************************/
+#include "types.h"
+#include "util.h"
+#include "sync.h"
+
+
+/***************************************< Definitions >**************************************/
+#ifndef BUS_ENABLE
+#define BUS_ENABLE            (0u)     //!< 1: the units chained by a wire on BUS_GPIO_PIN play the animation of the master, in its step
+#endif
+#ifndef BUS_GPIO_PIN
+#define BUS_GPIO_PIN          LL_GPIO_PIN_10         //!< Pin of the bus on GPIOA, open drain; spare on the board. EXTI lines 9..15 are wired to port A,
+                                                     //!< a pin below PA9 needs BUS_EXTI_CONFIG too, e.g. LL_EXTI_CONFIG_LINE5
+#define BUS_EXTI_LINE         LL_EXTI_LINE_10        //!< EXTI line of the bus pin, in EXTI4_15_IRQHandler() with the button
+#if BUS_ENABLE && UTIL_PROBES
+#error "BUS_ENABLE: PA10 is the probe of Animation_Cycle(), choose another BUS_GPIO_PIN!"
+#endif
+#endif
+#define BUS_UNIT_MS           (4u)     //!< A pulse of the master is this long for every animation index, plus one unit
+#define BUS_CLAIM_MS          (1000u)  //!< Silence on the bus makes a unit the master after this, plus its UID times BUS_UNIT_MS
+#define BUS_LOST_MS           (30000u) //!< A follower without a pulse this long listens for a master again
+
+#if BUS_ENABLE && SYNC_ENABLE
+#error "BUS_ENABLE: the units locked by wire don't need the optical phase lock!"
+#endif
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+
+
+/***************************************< Public functions >**************************************/
+#if BUS_ENABLE
+void Bus_Init( void );
+void Bus_Interrupt( void );
+U32  Bus_Cycle( U8* pu8Animation );
+BOOL Bus_IsFollower( void );
+#endif
+
+
+#endif /* BUS_H */
+
+/***************************************< End of file >**************************************/
@@ -0,0 +1,331 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file button.c
+*
+* \brief Gesture decoder of the pushbutton
+*
+* \author Hekk_Elek
+*
+* \note  The EXTI of the button stamps every edge with the time, and wakes the button task up.
+*        The task takes a level as debounced, once it has been stable for BUTTON_DEBOUNCE_MS since
+*        its last edge; the press and the release are dated by those edges, so a late task doesn't
+*        stretch the gestures. Between the edges only UTIL_TIMER_BUTTON makes the task due, for the
+*        end of a bounce or the next hold level: nothing runs while the button is idle.
+*        The press edges of single clicks are the taps of the tempo: a steady beat of them is told
+*        by BUTTON_TAP_TEMPO, from the edges already there, it doesn't need a timer of its own.
+*
+**********************************************************************************************************/
+
+/***************************************< Includes >**************************************/
+// Own includes
+#include "main.h"
+#include "types.h"
+#include "util.h"
+#include "button.h"
+#include "stats.h"
+
+
+/***************************************< Definitions >**************************************/
+#define HOLD_REPEAT_MS ( BUTTON_HOLD_4S_MS - BUTTON_HOLD_2S_MS )  //!< Period of BUTTON_HOLD_4S while held on
+#define SERIES_CLICKS  (4u)  //!< Clicks of the longest series, see BUTTON_QUADRUPLE_CLICK
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+static volatile U32 gu32EdgeMs;  //!< Time of the last edge; written by Button_Interrupt() only
+static U32 gu32SeenMs;           //!< Time of the previous Button_Cycle()
+static U32 gu32WokenMs;          //!< Time of the last wakeup from Util_Sleep(), see Button_Woken()
+static U32 gu32PressMs;          //!< Time of the debounced press
+static U32 gu32ReleaseMs;        //!< Time of the debounced release
+static U32 gu32NextHoldMs;       //!< Press duration of the next hold gesture
+static U16 gu16BeatMs;           //!< Beat of the taps, averaged over them
+static U8  gu8Clicks;            //!< Clicks of the series so far
+static U8  gu8Taps;              //!< Presses on the beat so far, saturated at BUTTON_TAPS; 0: no tap tempo running
+static BIT gbitDown;             //!< Debounced level: the button is pressed
+static BIT gbitLong;             //!< The press has reached BUTTON_HOLD_2S_MS
+
+
+/***************************************< Static function definitions >**************************************/
+
+
+/***************************************< Private functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Takes a press as a tap of the tempo
+//! \param  u32Interval: time since the previous press
+//! \return -
+//! \global gu8Taps, gu16BeatMs
+//! \note   A press off the beat, or far from the previous one, starts the taps anew; the beat is a
+//!         running average, there's no division.
+//-----------------------------------------------------------------------------
+static void Tap( U32 u32Interval )
+{
+  U16 u16Off;
+  
+  if( ( 0u == gu8Taps ) || ( u32Interval < BUTTON_TAP_MIN_MS ) || ( u32Interval > BUTTON_TAP_MAX_MS ) )
+  {
+    gu8Taps = 1u;
+  }
+  else if( 1u == gu8Taps )
+  {
+    gu16BeatMs = (U16)u32Interval;
+    gu8Taps++;
+  }
+  else
+  {
+    u16Off = ( u32Interval > gu16BeatMs ) ? (U16)( u32Interval - gu16BeatMs ) : (U16)( gu16BeatMs - u32Interval );
+    if( u16Off > ( gu16BeatMs >> BUTTON_TAP_JITTER ) )
+    {
+      gu8Taps = 1u;
+    }
+    else
+    {
+      gu16BeatMs = (U16)( ( 3u * gu16BeatMs + u32Interval + 2u ) >> 2u );
+      if( gu8Taps < BUTTON_TAPS )
+      {
+        gu8Taps++;
+      }
+    }
+  }
+}
+
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Initialize the pushbutton input and its EXTI line on both edges
+//! \param  -
+//! \return -
+//! \global All globals of this module
+//! \note   The interrupt wakes the main loop up on every edge, so it doesn't have to poll the pin.
+//!         Also called before stop mode, only the button is left powered then.
+//-----------------------------------------------------------------------------
+void Button_Init( void )
+{
+  LL_IOP_GRP1_EnableClock( LL_IOP_GRP1_PERIPH_GPIOA );
+  LL_GPIO_SetPinMode( BUTTON_GPIO_PORT, BUTTON_GPIO_PIN, LL_GPIO_MODE_INPUT );
+  LL_GPIO_SetPinPull( BUTTON_GPIO_PORT, BUTTON_GPIO_PIN, LL_GPIO_PULL_UP );
+  
+  LL_EXTI_SetEXTISource( BUTTON_EXTI_PORT, BUTTON_EXTI_CONFIG );
+  LL_EXTI_EnableRisingTrig( BUTTON_EXTI_LINE );
+  LL_EXTI_EnableFallingTrig( BUTTON_EXTI_LINE );
+  LL_EXTI_ClearFlag( BUTTON_EXTI_LINE );
+  LL_EXTI_EnableIT( BUTTON_EXTI_LINE );
+  NVIC_SetPriority( BUTTON_EXTI_IRQn, IRQ_PRIORITY_EVENT );
+  NVIC_EnableIRQ( BUTTON_EXTI_IRQn );
+  
+  gu32SeenMs = Util_GetTimerMs32();
+  gu32WokenMs = gu32SeenMs;
+  gu32EdgeMs = gu32SeenMs;
+  gu32ReleaseMs = gu32SeenMs;
+  gu8Clicks = 0u;
+  gu8Taps = 0u;
+  gbitDown = 0;
+  gbitLong = 0;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Stamps an edge of the button
+//! \param  -
+//! \return -
+//! \global gu32EdgeMs
+//! \note   Should be called from the EXTI interrupt of the button.
+//-----------------------------------------------------------------------------
+void Button_Interrupt( void )
+{
+  gu32EdgeMs = Util_GetTimerMs32();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Takes the time of a wakeup from Util_Sleep()
+//! \param  -
+//! \return -
+//! \global gu32WokenMs
+//! \note   Should be called right after Util_Sleep() returns. The clock is brought forward only then,
+//!         so an edge that has woken the sleep up is stamped with its start; Button_Cycle() dates it
+//!         to the wakeup instead, and the debounce and the hold levels run from there.
+//-----------------------------------------------------------------------------
+void Button_Woken( void )
+{
+  gu32WokenMs = Util_GetTimerMs32();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Debounces the button and recognizes the gestures
+//! \param  -
+//! \return The gesture recognized now, BUTTON_NONE mostly
+//! \global All globals of this module
+//! \note   Should be called from the button task; it is due again at the end of UTIL_TIMER_BUTTON.
+//!         A click is told at once on its release, a double click replaces it BUTTON_CLICK_MS later
+//!         at most, so the caller acts on the first click without a delay, and undoes it if needed.
+//-----------------------------------------------------------------------------
+E_BUTTON_GESTURE Button_Cycle( void )
+{
+  E_BUTTON_GESTURE eGesture = BUTTON_NONE;
+  U32  u32Now = Util_GetTimerMs32();
+  U32  u32Edge = gu32EdgeMs;
+  U32  u32Wait = UTIL_TIMER_NONE;
+  U32  u32Held;
+  BOOL bDown = ( 0u == BUTTON_PIN );
+  
+  // An edge that has woken Util_Sleep() up is stamped before the clock is brought forward
+  if( (I32)( u32Edge - gu32WokenMs ) < 0 )
+  {
+    u32Edge = gu32WokenMs;
+  }
+  gu32SeenMs = u32Now;
+  
+  if( bDown != gbitDown )
+  {
+    if( ( u32Now - u32Edge ) < BUTTON_DEBOUNCE_MS )
+    {
+      u32Wait = BUTTON_DEBOUNCE_MS - ( u32Now - u32Edge );  // still bouncing
+    }
+    else if( bDown )
+    {
+      gbitDown = 1;
+      gbitLong = 0;
+      Tap( u32Edge - gu32PressMs );
+      gu32PressMs = u32Edge;
+      gu32NextHoldMs = BUTTON_HOLD_2S_MS;
+#if STATS_ENABLE
+      Stats_CountPress();
+#endif
+    }
+    else
+    {
+      gbitDown = 0;
+      u32Held = u32Edge - gu32PressMs;
+      if( gbitLong )
+      {
+        eGesture = BUTTON_RELEASE_LONG;
+        gu8Clicks = 0u;
+      }
+      else if( u32Held >= BUTTON_HOLD_1S_MS )
+      {
+        eGesture = BUTTON_HOLD_1S;
+        gu8Clicks = 0u;
+      }
+      else
+      {
+        if( ( u32Edge - gu32ReleaseMs ) > BUTTON_CLICK_MS )
+        {
+          gu8Clicks = 0u;
+        }
+        gu8Clicks++;
+        eGesture = (E_BUTTON_GESTURE)( BUTTON_CLICK + gu8Clicks - 1u );
+        if( SERIES_CLICKS == gu8Clicks )
+        {
+          gu8Clicks = 0u;
+        }
+      }
+      // Only single clicks are taps, the tempo goes on from one
+      if( BUTTON_CLICK != eGesture )
+      {
+        gu8Taps = 0u;
+      }
+      else if( BUTTON_TAPS == gu8Taps )
+      {
+        eGesture = BUTTON_TAP_TEMPO;
+      }
+      gu32ReleaseMs = u32Edge;
+    }
+  }
+  
+  // Hold levels, while it is down
+  if( gbitDown && ( UTIL_TIMER_NONE == u32Wait ) )
+  {
+    u32Held = u32Now - gu32PressMs;
+    if( u32Held >= gu32NextHoldMs )
+    {
+      eGesture = gbitLong ? BUTTON_HOLD_4S : BUTTON_HOLD_2S;
+      gbitLong = 1;
+      gu32NextHoldMs += HOLD_REPEAT_MS;
+    }
+    u32Wait = 0u;  // a late task catches up
+    if( gu32NextHoldMs > u32Held )
+    {
+      u32Wait = gu32NextHoldMs - u32Held;
+    }
+  }
+  
+  if( UTIL_TIMER_NONE != u32Wait )
+  {
+    Util_TimerStart( UTIL_TIMER_BUTTON, u32Wait );
+  }
+  else
+  {
+    Util_TimerStop( UTIL_TIMER_BUTTON );
+  }
+#if UTIL_TRACE
+  if( BUTTON_NONE != eGesture )
+  {
+    UTIL_TRACE_EVENT( UTIL_TRACE_GESTURE, eGesture );
+  }
+#endif
+  
+  return eGesture;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Takes the button as held for long already
+//! \param  -
+//! \return -
+//! \global All globals of this module
+//! \note   For the press that has woken the unit up: its release does nothing, holding it on
+//!         goes on with BUTTON_HOLD_4S. Makes the button task due.
+//-----------------------------------------------------------------------------
+void Button_SetHeld( void )
+{
+  gu32SeenMs = Util_GetTimerMs32();
+  gu32WokenMs = gu32SeenMs;
+  gu32PressMs = gu32SeenMs - BUTTON_HOLD_2S_MS;
+  gu32NextHoldMs = BUTTON_HOLD_4S_MS;
+  gu8Clicks = 0u;
+  gu8Taps = 0u;
+  gbitDown = 1;
+  gbitLong = 1;
+  Util_TimerStart( UTIL_TIMER_BUTTON, 0u );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells if the button is left alone
+//! \param  -
+//! \return TRUE if it is not pressed
+//! \global gbitDown
+//-----------------------------------------------------------------------------
+BOOL Button_IsIdle( void )
+{
+  return !gbitDown;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells the presses of the tap tempo so far
+//! \param  -
+//! \return 1 for the press starting the taps, up to BUTTON_TAPS; 0 if the last gesture wasn't a tap
+//! \global gu8Taps
+//! \note   The caller can save its state at the first one, and get back to it at BUTTON_TAP_TEMPO.
+//-----------------------------------------------------------------------------
+U8 Button_GetTaps( void )
+{
+  return gu8Taps;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells the beat of the tap tempo
+//! \param  -
+//! \return Beat in ms, [BUTTON_TAP_MIN_MS; BUTTON_TAP_MAX_MS]
+//! \global gu16BeatMs
+//! \note   Valid with BUTTON_TAP_TEMPO.
+//-----------------------------------------------------------------------------
+U16 Button_GetBeatMs( void )
+{
+  return gu16BeatMs;
+}
+
+/***************************************< End of file >**************************************/
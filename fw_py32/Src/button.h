@@ -0,0 +1,61 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file button.h
+*
+* \brief Gesture decoder of the pushbutton
+*
+* \author Hekk_Elek
+*
+**********************************************************************************************************/
+#ifndef BUTTON_H
+#define BUTTON_H
+
+/***************************************< Includes >**************************************/
+#include "types.h"
+
+/***************************************< Definitions >**************************************/
+#define BUTTON_DEBOUNCE_MS (50u)    //!< The pin has to be stable this long after its last edge
+#define BUTTON_CLICK_MS    (400u)   //!< A click released within this time after the previous one continues the series
+#define BUTTON_HOLD_1S_MS  (1000u)  //!< A press released after this long is a hold, not a click
+#define BUTTON_HOLD_2S_MS  (2000u)  //!< A press held this long is a long press
+#define BUTTON_HOLD_4S_MS  (4000u)  //!< A press held this long repeats, once per ( BUTTON_HOLD_4S_MS - BUTTON_HOLD_2S_MS )
+#define BUTTON_TAPS        (4u)     //!< Evenly spaced clicks of a tap tempo, see BUTTON_TAP_TEMPO
+#define BUTTON_TAP_MIN_MS  ( BUTTON_CLICK_MS + 50u )  //!< Shortest beat of the taps: a faster one makes a series of clicks, 150 BPM
+#define BUTTON_TAP_MAX_MS  (1500u)  //!< Longest beat of the taps, 40 BPM
+#define BUTTON_TAP_JITTER  (3u)     //!< A tap can be off the beat by 1/2^BUTTON_TAP_JITTER of it
+
+/***************************************< Types >**************************************/
+//! \brief Gestures recognized by Button_Cycle()
+typedef enum
+{
+  BUTTON_NONE = 0u,        //!< Nothing to do
+  BUTTON_CLICK,            //!< A short press released, the first of a series
+  BUTTON_DOUBLE_CLICK,     //!< The second click of a series
+  BUTTON_TRIPLE_CLICK,     //!< The third click of a series
+  BUTTON_QUADRUPLE_CLICK,  //!< The fourth click of a series; the next one starts a new series
+  BUTTON_HOLD_1S,          //!< A press released after BUTTON_HOLD_1S_MS, before BUTTON_HOLD_2S_MS
+  BUTTON_HOLD_2S,          //!< Still held at BUTTON_HOLD_2S_MS
+  BUTTON_HOLD_4S,          //!< Still held at BUTTON_HOLD_4S_MS, then again every 2 s
+  BUTTON_RELEASE_LONG,     //!< Released after BUTTON_HOLD_2S
+  BUTTON_TAP_TEMPO         //!< A click is given instead for the BUTTON_TAPS-th press on the beat of the ones before, and for each further one; see Button_GetBeatMs()
+} E_BUTTON_GESTURE;
+
+/***************************************< Constants >**************************************/
+
+/***************************************< Global variables >**************************************/
+
+/***************************************< Public functions >**************************************/
+void             Button_Init( void );
+void             Button_Interrupt( void );
+void             Button_Woken( void );
+E_BUTTON_GESTURE Button_Cycle( void );
+void             Button_SetHeld( void );
+BOOL             Button_IsIdle( void );
+U8               Button_GetTaps( void );
+U16              Button_GetBeatMs( void );
+
+
+#endif /* BUTTON_H */
+
+/***************************************< End of file >**************************************/
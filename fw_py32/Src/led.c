@@ -10,42 +10,786 @@
 **********************************************************************************************************/
 
 /***************************************< Includes >**************************************/
+// Standard C libraries
+#include <string.h>
+
 // Own includes
 #include "main.h"
 #include "types.h"
 #include "led.h"
+#include "memmap.h"
+#include "rgbled.h"
+#include "util.h"
+#if LED_FAULT_CHECK
+#include "sensor.h"
+#include "stats.h"
+#endif
 
 
 /***************************************< Definitions >**************************************/
 #define PWM_LEVELS      (16u)  //!< PWM levels implemented: [0; PWM_LEVELS)
+#define TEMP_REFERENCE_C (25)  //!< Temperature the LED trims are taken at
+#define TEMP_DIM_PER_C  (2u)   //!< Scale-down of the driver levels per degC below TEMP_REFERENCE_C, in 1/256; measure on the board
+#define TEMP_DIM_MAX    (64u)  //!< Largest scale-down for the temperature, in 1/256: a quarter
+
+// Pin definitions: a larger board lists its MPX pins and common pins here, and sets LEDS_NUM and LED_SIDES in led.h
+#define MPX1            LL_GPIO_PIN_0  //!< Pin of MPX1 multiplexer pin on GPIOB
+#define MPX2            LL_GPIO_PIN_1  //!< Pin of MPX2 multiplexer pin on GPIOB
+#define LED_MPX_PINS    MPX2, MPX1     //!< MPX pins on GPIOB in the order of the sides, see gcau32MPXPin[]
+#define LED_MASK_MPX    ( MPX1 | MPX2 )  //!< Every MPX pin on GPIOB
+#define LED0            A,7  //!< Port and pin number of LED0 common pin
+#define LED1            A,6  //!< Port and pin number of LED1 common pin
+#define LED2            A,3  //!< Port and pin number of LED2 common pin
+#define LED3            A,2  //!< Port and pin number of LED3 common pin
+#define LED4            F,1  //!< Port and pin number of LED4 common pin
+#define LED5            F,0  //!< Port and pin number of LED5 common pin
 
-// Pin definitions
-#define MPX1            GPIOB,LL_GPIO_PIN_0  //!< Pin of MPX1 multiplexer pin
-#define MPX2            GPIOB,LL_GPIO_PIN_1  //!< Pin of MPX2 multiplexer pin
-#define LED0            GPIOA,LL_GPIO_PIN_7  //!< Pin of LED0 common pin
-#define LED1            GPIOA,LL_GPIO_PIN_6  //!< Pin of LED1 common pin
-#define LED2            GPIOA,LL_GPIO_PIN_3  //!< Pin of LED2 common pin
-#define LED3            GPIOA,LL_GPIO_PIN_2  //!< Pin of LED3 common pin
-#define LED4            GPIOF,LL_GPIO_PIN_1  //!< Pin of LED4 common pin
-#define LED5            GPIOF,LL_GPIO_PIN_0  //!< Pin of LED5 common pin
+// Pin masks of the LED common pins, generated from the pin definitions: low half is GPIOA, high half is GPIOF
+#define LED_PORT_SHIFT_A  (0u)   //!< GPIOA pins are in the low half
+#define LED_PORT_SHIFT_F  (16u)  //!< GPIOF pins are in the high half
+#define LED_PIN_MASK( pin )         LED_PIN_MASK_( pin )  //!< Mask of an LED pin, argument is expanded first
+#define LED_PIN_MASK_( port, num )  ( (U32)1u << ( LED_PORT_SHIFT_##port + (num) ) )
+#define LED_MASK_ALL    ( LED_PIN_MASK( LED0 ) | LED_PIN_MASK( LED1 ) | LED_PIN_MASK( LED2 ) \
+                        | LED_PIN_MASK( LED3 ) | LED_PIN_MASK( LED4 ) | LED_PIN_MASK( LED5 ) )  //!< All LED pins
+#define LED_MASK_GPIOA  ( LED_MASK_ALL & 0xFFFFu )  //!< LED pins on GPIOA
+#define LED_MASK_GPIOF  ( LED_MASK_ALL >> 16u )     //!< LED pins on GPIOF
+#define LED_SIDE_PWM    (0xFFFFFFFFuL)  //!< gau32StaticSet[][] of a side that needs the PWM comparisons
+#define LED_SIDE_BIT( side )  ( 1u << (side) )  //!< Bit of a side in gau8LitSides[], side is the value of gu8Side
+#define LED_SIDE_AFTER( side )  ( ( (side) + 1u < LED_SIDES ) ? ( (side) + 1u ) : 0u )  //!< Side following a side in the multiplexing order
+#define LED_SIDE_OF( led )    ( LED_SIDES - 1u - (led) / LEDS_PER_SIDE )  //!< Side of an LED of gau8LEDBrightness[], see LED_SIDE_FIRST()
+#define LED_SENSE       LED0  //!< Common pin of the LEDs used as light sensor
+#define LED_GPIO_PORT( pin )        LED_GPIO_PORT_( pin )  //!< GPIO port of an LED pin, argument is expanded first
+#define LED_GPIO_PORT_( port, num ) ( GPIO##port )
+#define LED_GPIO_PIN( pin )         LED_GPIO_PIN_( pin )   //!< LL pin mask of an LED pin in its port, argument is expanded first
+#define LED_GPIO_PIN_( port, num )  ( (U32)1u << (num) )
+#define LED_MPX_PIN( side )   ( gcau32MPXPin[ side ] )  //!< MPX pin of a side, low while the side is lit; side is the value of gu8Side
+#define LED_BIT( led )        ( 1u << (led) )  //!< Bit of an LED of gau8LEDBrightness[] in the fault masks
+#define PROBE_TICKS           ( SENSOR_DARK_TICKS )  //!< TIM1 periods of a probe slot: the sampling of a conversion fits in it
+
+#if LED_SIDES > 8u
+#error "LED_SIDES: gau8LitSides[] has a bit for at most 8 sides!"
+#endif
+#if ( LEDS_PER_SIDE * LED_SIDES ) != LEDS_NUM
+#error "LEDS_NUM: every side needs an LED on each common pin!"
+#endif
+#if ( LED_DRIVER_MODE == LED_MODE_LADDER ) && LED_PHASE_STAGGER && ( LEDS_PER_SIDE != 6u )
+#error "LED_PHASE_STAGGER: gcau8PhaseOrder[] has a row for each of the 6 common pins!"
+#endif
 
 
 /***************************************< Types >**************************************/
+#if LED_LIGHT_SENSE
+//! \brief States of the ambient light measurement
+typedef enum
+{
+  SENSE_IDLE = 0u,   //!< Not measuring, the periods are played as usual
+  SENSE_START,       //!< The dark slot starts at this interrupt, instead of the next period
+  SENSE_RUN          //!< The sensor pin is floating, waiting for it to charge up
+} E_LED_SENSE;
+#endif
 
+#if LED_FAULT_CHECK
+//! \brief States of the probe slot of the fault check
+typedef enum
+{
+  PROBE_IDLE = 0u,   //!< Not probing, the periods are played as usual
+  PROBE_START,       //!< The probe slot starts at this interrupt, instead of the next period
+  PROBE_RUN          //!< The LED probed is lit alone
+} E_LED_PROBE;
+
+//! \brief Steps of the fault check
+typedef enum
+{
+  FAULT_WAIT = 0u,   //!< Waiting for the next probe
+  FAULT_REFERENCE,   //!< The supply is converted in the dark segments
+  FAULT_PROBE        //!< The supply is converted in the probe slots
+} E_LED_FAULT;
+#endif
 
 /***************************************< Constants >**************************************/
+//! \brief MPX pin of each side on GPIOB: side 1 is the left one, side 0 the right one
+static CODE const U32 gcau32MPXPin[ LED_SIDES ] =
+{
+  LED_MPX_PINS
+};
+
+//! \brief Pin masks of each LED in the order of gau8LEDBrightness[]: low half is GPIOA, high half is GPIOF
+static CODE const U32 gcau32LEDPinMask[ LEDS_NUM ] =
+{
+  // Left side: D12, D4, D6, D10, D8, D2
+  LED_PIN_MASK( LED0 ), LED_PIN_MASK( LED1 ), LED_PIN_MASK( LED2 ), LED_PIN_MASK( LED3 ), LED_PIN_MASK( LED4 ), LED_PIN_MASK( LED5 ),
+  // Right side: D3, D9, D11, D7, D5, D13
+  LED_PIN_MASK( LED5 ), LED_PIN_MASK( LED4 ), LED_PIN_MASK( LED3 ), LED_PIN_MASK( LED2 ), LED_PIN_MASK( LED1 ), LED_PIN_MASK( LED0 )
+};
+
+#if ( LED_DRIVER_MODE == LED_MODE_LADDER ) && LED_PWM_SPREAD && ( !LED_PHASE_STAGGER || LED_RGB_SCHEDULE )
+//! \brief Order of the PWM thresholds over a period: the 4-bit reversed counter
+//! \note  A level is on in the ticks whose threshold is below it, so e.g. level 8 is on in every second tick
+static CODE const U8 gcau8PWMOrder[ PWM_LEVELS ] =
+{
+  0u, 8u, 4u, 12u, 2u, 10u, 6u, 14u, 1u, 9u, 5u, 13u, 3u, 11u, 7u, 15u
+};
+#endif
+
+#if ( LED_DRIVER_MODE == LED_MODE_LADDER ) && LED_PHASE_STAGGER
+#if LED_PWM_SPREAD
+#define ORDER( t )      ( ( ( (t) & 1u ) << 3u ) | ( ( (t) & 2u ) << 1u ) | ( ( (t) & 4u ) >> 1u ) | ( ( (t) & 8u ) >> 3u ) )  //!< Threshold of tick t: the 4-bit reversed counter
+#else
+#define ORDER( t )      (t)  //!< Threshold of tick t
+#endif
+//! \brief Threshold of tick t XORed with the phase m, but the dark last tick and its pair are left in place
+#define PHASED( t, m )  ( ( ( LED_PWM_MAX == ORDER( t ) ) || ( LED_PWM_MAX == ( ORDER( t ) ^ (m) ) ) ) ? ORDER( t ) : ( ORDER( t ) ^ (m) ) )
+#define PHASE_ROW( m )  { PHASED(  0u, m ), PHASED(  1u, m ), PHASED(  2u, m ), PHASED(  3u, m ), \
+                          PHASED(  4u, m ), PHASED(  5u, m ), PHASED(  6u, m ), PHASED(  7u, m ), \
+                          PHASED(  8u, m ), PHASED(  9u, m ), PHASED( 10u, m ), PHASED( 11u, m ), \
+                          PHASED( 12u, m ), PHASED( 13u, m ), PHASED( 14u, m ), PHASED( 15u, m ) }
+//! \brief PWM thresholds of the LEDs of a side over a period, each in its own phase, generated at compile time
+//! \note  Each row is a permutation of the thresholds that keeps the last tick dark, so every level
+//!        keeps its on-ticks per period, but the LEDs of a side take them in different ticks: e.g.
+//!        4 LEDs are lit at a time instead of 6 at level 8, so the peak current of the cell drops.
+static CODE const U8 gcau8PhaseOrder[ LEDS_PER_SIDE ][ PWM_LEVELS ] =
+{
+  PHASE_ROW(  2u ), PHASE_ROW(  4u ), PHASE_ROW(  6u ), PHASE_ROW(  8u ), PHASE_ROW( 10u ), PHASE_ROW( 12u )
+};
+#endif
+
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+#if LED_GAMMA_CORRECTION
+//! \brief Gamma 2.0 curve, rounded upwards so that the lowest level stays visible
+#define GAMMA( x )      ( ( (x)*(x)*LED_PWM_MAX + LED_BRIGHTNESS_MAX*LED_BRIGHTNESS_MAX - 1u ) / ( LED_BRIGHTNESS_MAX*LED_BRIGHTNESS_MAX ) )
+#else
+//! \brief Linear scaling
+#define GAMMA( x )      ( ( (x)*LED_PWM_MAX + LED_BRIGHTNESS_MAX/2u ) / LED_BRIGHTNESS_MAX )
+#endif
+//! \brief Converts animation levels to PWM levels of the driver, generated at compile time
+static CODE const U8 gcau8GammaLUT[ LED_BRIGHTNESS_MAX + 1u ] =
+{
+  GAMMA(  0u ), GAMMA(  1u ), GAMMA(  2u ), GAMMA(  3u ), GAMMA(  4u ), GAMMA(  5u ), GAMMA(  6u ), GAMMA(  7u ),
+  GAMMA(  8u ), GAMMA(  9u ), GAMMA( 10u ), GAMMA( 11u ), GAMMA( 12u ), GAMMA( 13u ), GAMMA( 14u ), GAMMA( 15u )
+};
+#endif
 
 
 /***************************************< Global variables >**************************************/
 DATA U8 gau8LEDBrightness[ LEDS_NUM ];  //!< Array for storing individual brightness levels
+static U8 gau8LevelLUT[ LED_BRIGHTNESS_MAX + 1u ];  //!< Animation level to driver level, global brightness included
+static U8 gu8DimLevel = LED_DIM_FULL;  //!< Global brightness selected by the user
+static U8 gu8DimCap = LED_DIM_FULL;    //!< Highest global brightness the battery can afford, kept over LED_Init()
+static U16 gu16LoadBudget = LED_LOAD_BUDGET;  //!< Highest load of a frame the supply can afford, see LED_SetLoadBudget(); kept over LED_Init()
+static U16 gu16Load;                   //!< Sum of the driver levels of the LEDs in the last frame
+static U32 gu32LoadMs;                 //!< Load of the frames integrated over their time since LED_TakeLoadMs()
+static U32 gu32LoadSinceMs;            //!< Time of Util_GetTimerMs32() the load is integrated to
+static U8 gau8Trim[ LEDS_NUM ];        //!< Per-LED trim of the driver levels, see LED_SetTrims(); kept over LED_Init()
+static U8 gu8TempDim;                  //!< Scale-down of the driver levels for the temperature, see LED_SetTemperature(); kept over LED_Init()
+static U8 gu8PlanDim;                  //!< Scale-down of the driver levels for the runtime, see LED_SetPlanDim(); kept over LED_Init()
+#if LED_SOFT_START_MS
+static U32 gu32SoftStartMs;            //!< Time of Util_GetTimerMs32() the ramp of the budget has started from, at LED_Init()
+static BIT gbitSoftLimited;            //!< The last frame is scaled below LED_LOAD_BUDGET by the ramp, see LED_SoftStartCycle()
+#endif
 DATA U8 gu8PWMCounter;                  //!< Counter for the base of soft-PWM
-DATA BIT gbitSide;                      //!< Stores which side of the panel is active
+DATA U8  gu8Side;                       //!< Stores which side of the panel is active, [0; LED_SIDES)
+DATA volatile U8  gu8FrontBuffer;       //!< Index of the buffer shown by the interrupt
+static U32 gu32SoloMPX;                 //!< Multiplexer outputs before LED_SoloOn()
+DATA volatile BIT gbitFramePending;     //!< The back buffer holds a new frame, to be swapped at the next period boundary
+static volatile U16 gu16FrameDueMs;     //!< The frame pending is swapped in at the first period boundary from this time of Util_GetTimerMs()
+#if LED_ADAPTIVE_MPX
+DATA U8  gau8LitSides[ LED_BUFFERS ];   //!< Sides with any LED lit in each buffer, see LED_SIDE_BIT()
+#endif
+#if LED_LIGHT_SENSE
+static volatile U8  gu8SenseState = SENSE_IDLE;  //!< State of the measurement (E_LED_SENSE)
+static volatile BIT gbitSenseRequest;   //!< Set to insert a dark slot at the next period boundary
+static volatile U8  gu8SenseTicks;      //!< TIM1 periods of the running dark slot
+static volatile U8  gu8SenseResult;     //!< Charge time of the last measurement in TIM1 periods; 0: none, or already taken
+static U8  gu8SenseMaxTicks;            //!< Longest dark slot of the requested measurement
+static BIT gbitAmbientPending;          //!< The measurement requested is the one of the ambient light
+static U32 gu32SenseMPX;                //!< Multiplexer outputs before the dark slot
+static U8  gu8DimAmbient;               //!< Global brightness steps taken off for the ambient light
+static U8  gu8SensePrevious;            //!< Steps of the previous measurement, a change must be seen twice
+#endif
+#if LED_FAULT_CHECK
+static volatile U8  gu8ProbeState = PROBE_IDLE;  //!< State of the probe slot (E_LED_PROBE)
+static volatile BIT gbitProbeRequest;   //!< Set to insert a probe slot at every period boundary
+static volatile U8  gu8ProbeTicks;      //!< TIM1 periods of the running probe slot
+#if LED_DRIVER_MODE == LED_MODE_LADDER
+static BIT gbitProbeTaken;              //!< The probe slot of this period boundary is over, the period follows it
+#endif
+static U8  gu8ProbeLED;                 //!< LED lit in the probe slots
+static U32 gu32ProbeMPX;                //!< Multiplexer outputs before the probe slot
+static U8  gu8FaultStep;                //!< Step of the fault check (E_LED_FAULT)
+static U8  gu8FaultLED = LEDS_NUM;      //!< LED probed by the running step of the round; LEDS_NUM: the next step starts a round
+static U16 gu16FaultRefMv;              //!< Supply of the dark segments before the probe of gu8FaultLED
+static U16 gau16FaultSagMv[ LEDS_NUM ]; //!< Sag of the supply by each LED lit alone, in the running round
+static U16 gu16FaultSuspects;           //!< LED_BIT() of the LEDs found faulty by the last round, a fault must be seen twice
+static U16 gu16Faults;                  //!< LED_BIT() of the LEDs found open or shorted, dark in every frame; kept over LED_Init()
+DATA BIT gbitLEDProbeSlot;              //!< The probe slot starts at this update event
+#endif
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+DATA U8  gu8LEDNextRGB;                 //!< RGB colors of the segment starting at the next timer update event
+#if LED_FAST_REFRESH
+static BIT gbitFastRefresh = ( 2u == LED_FAST_REFRESH );  //!< The frames are built of the short segments, see LED_SetFastRefresh()
+static BIT gbitFastAlways = ( 2u == LED_FAST_REFRESH );   //!< Every animation is refreshed fast, see LED_SetFastRefreshAlways()
+#endif
+DATA U8  gu8PlaneTicks;                 //!< Length of the running segment in TIM1 periods
+DATA U8  gu8NextPlaneTicks;             //!< Length of the next segment in TIM1 periods
+DATA U8  gu8NextSegment;                //!< Index of the segment starting at the next timer update event
+DATA U8  gu8NextSide;                   //!< Side of the segment starting at the next timer update event
+DATA U8  gau8SegmentCount[ LED_BUFFERS ][ LED_SIDES ];  //!< Number of valid segments per side
+//! \brief Precomputed waveform for each side, in the run part of the arena, see memmap.h
+//! \note  Only the segments below gau8SegmentCount[][] are read, so it needs no zero initialization
+#define gasSegments  ( guMemMap.sRun.aaasLEDSegments )
+#else
+DATA U8  gau8LEDFrame[ LED_BUFFERS ][ LEDS_NUM ];  //!< Brightness levels shown by the interrupt
+//! \brief Pins set on each side if it has only dark and full LEDs, otherwise LED_SIDE_PWM
+DATA U32 gau32StaticSet[ LED_BUFFERS ][ LED_SIDES ];
+#if LED_RGB_SCHEDULE
+DATA U8  gu8LEDRGBThreshold;            //!< RGB threshold of the running tick: its rank by the LEDs lit in it, lowest first
+static U8 gau8RGBOrder[ LED_BUFFERS ][ PWM_LEVELS ];  //!< Rank of each tick of the period by the LEDs lit in it, see RankTicks()
+#endif
+#if LED_ADAPTIVE_TICKS
+DATA U8  gu8PlaneTicks;                 //!< Length of the running segment in TIM1 periods: 1, or LED_PWM_MAX for a static side
+DATA U8  gu8NextPlaneTicks;             //!< Length of the segment starting at the next timer update event
+#endif
+#endif
+#if LED_DARK_SLOTS
+DATA U8  gu8LEDDarkTicks;               //!< TIM1 periods of the segment starting at this update event if every LED is dark in it; 0: lit
+#endif
 
 
 /***************************************< Static function definitions >**************************************/
+static void BuildLevelLUT( U8 u8Level );
+static void ApplyBrightness( void );
+static U16 LoadBudget( void );
+static U16 LimitLoad( U8* pu8Levels, U16 u16Load );
+static U8  TrimmedLevel( U8 u8LED, U8 u8Brightness );
+#if LED_ADAPTIVE_MPX
+static U8 LitSides( const U8* pu8Levels );
+static U16 SharedLoad( U16 u16Load, U8 u8Lit );
+#endif
+ISR_CODE static U8 NextSide( U8 u8Side );
+static void IntegrateLoad( void );
+#if LED_LIGHT_SENSE
+ISR_CODE static BOOL SenseStep( void );
+#endif
+#if LED_FAULT_CHECK
+ISR_CODE static BOOL ProbeStep( void );
+static U8   NextProbed( U8 u8LED );
+static void JudgeRound( void );
+#endif
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+ISR_CODE static void PreloadSegment( void );
+#elif LED_RGB_SCHEDULE
+static void RankTicks( U8 u8Buffer );
+#endif
 
 
 /***************************************< Private functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Builds the level table for a global brightness
+//! \param  u8Level: global brightness, [0; LED_DIM_FULL]
+//! \return -
+//! \global gau8LevelLUT[], gu8TempDim, gu8PlanDim
+//! \note   Every step below LED_DIM_FULL halves the driver levels. A lit level never rounds down
+//!         to dark, so the dimmest animation levels merge instead of disappearing. The scales of
+//!         the temperature and of the runtime are rounded, a few percent leave the dim levels alone.
+//-----------------------------------------------------------------------------
+static void BuildLevelLUT( U8 u8Level )
+{
+  U8 u8Index;
+  U8 u8Full;
+  U8 u8Shift;
+  
+  if( u8Level > LED_DIM_FULL )
+  {
+    u8Level = LED_DIM_FULL;
+  }
+  u8Shift = LED_DIM_FULL - u8Level;
+  for( u8Index = 0u; u8Index <= LED_BRIGHTNESS_MAX; u8Index++ )
+  {
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+    u8Full = gcau8GammaLUT[ u8Index ];
+#else
+    u8Full = u8Index;
+#endif
+    gau8LevelLUT[ u8Index ] = (U8)( ( (U32)u8Full * ( 256u - gu8TempDim ) * ( 256u - gu8PlanDim ) + 32768u ) >> 16u ) >> u8Shift;
+    if( ( 0u != u8Full ) && ( 0u == gau8LevelLUT[ u8Index ] ) )
+    {
+      gau8LevelLUT[ u8Index ] = 1u;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Applies the lower of the selected brightness and the cap to every LED
+//! \param  -
+//! \return -
+//! \global gu8DimLevel, gu8DimCap, gu8DimAmbient, gau8LevelLUT[]
+//! \note   With LED_LIGHT_SENSE a dark room takes gu8DimAmbient steps off, down to the night mode.
+//-----------------------------------------------------------------------------
+static void ApplyBrightness( void )
+{
+  U8 u8Level = gu8DimLevel;
+  
+  if( u8Level > gu8DimCap )
+  {
+    u8Level = gu8DimCap;
+  }
+#if LED_LIGHT_SENSE
+  u8Level = ( u8Level > gu8DimAmbient ) ? ( u8Level - gu8DimAmbient ) : 0u;
+#endif
+  BuildLevelLUT( u8Level );
+  RGBLED_SetBrightness( u8Level );
+  // Show it even if the animation is standing still
+  LED_Commit();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Maps an animation level of an LED to its driver level
+//! \param  u8LED: index of the LED
+//! \param  u8Brightness: animation level
+//! \return Driver level, global brightness and the trim of the LED included
+//! \global gau8LevelLUT[], gau8Trim[], gu16Faults
+//! \note   A lit level never rounds down to dark, like in BuildLevelLUT(). With LED_FAULT_CHECK a
+//!         faulty LED is dark: it takes no bit-plane and no budget.
+//-----------------------------------------------------------------------------
+static U8 TrimmedLevel( U8 u8LED, U8 u8Brightness )
+{
+  U8 u8Level = gau8LevelLUT[ u8Brightness & LED_BRIGHTNESS_MAX ];
+  U8 u8Trimmed = (U8)( ( (U16)u8Level * ( 256u - gau8Trim[ u8LED ] ) ) >> 8u );
+  
+  if( ( 0u != u8Level ) && ( 0u == u8Trimmed ) )
+  {
+    u8Trimmed = 1u;
+  }
+#if LED_FAULT_CHECK
+  if( 0u != ( gu16Faults & LED_BIT( u8LED ) ) )
+  {
+    u8Trimmed = 0u;
+  }
+#endif
+  
+  return u8Trimmed;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells the highest load of a frame committed now
+//! \param  -
+//! \return gu16LoadBudget; with LED_SOFT_START_MS less, ramping up linearly after LED_Init()
+//! \global gu16LoadBudget, gu32SoftStartMs
+//! \note   A cell at the end of its life, or a cold one, resets the MCU when the LEDs of the gauge
+//!         or of the first frame are lit at once after the reset or the wakeup, and then again at
+//!         every boot. The ramp gives its voltage time to settle. One division per frame, only
+//!         while it runs.
+//-----------------------------------------------------------------------------
+static U16 LoadBudget( void )
+{
+  U16 u16Budget = gu16LoadBudget;
+#if LED_SOFT_START_MS
+  U32 u32Elapsed = Util_GetTimerMs32() - gu32SoftStartMs;
+  
+  if( u32Elapsed < LED_SOFT_START_MS )
+  {
+    u16Budget = (U16)( LED_SOFT_START_LOAD + ( ( gu16LoadBudget - LED_SOFT_START_LOAD ) * u32Elapsed ) / LED_SOFT_START_MS );
+  }
+#endif
+  
+  return u16Budget;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Scales a frame down to the current budget of the cell
+//! \param  pu8Levels: driver levels of the LEDs, LEDS_NUM of them; scaled in place
+//! \param  u16Load: sum of the levels
+//! \return Sum of the levels after scaling
+//! \global -
+//! \note   Bright frames, e.g. every LED flashing at once, pull the CR2032 far down and risk a
+//!         brown-out reset. The scale is rounded down, so the result never exceeds the budget, see
+//!         LoadBudget(). With LED_ADAPTIVE_MPX the lit sides share the whole period, see SharedLoad().
+//-----------------------------------------------------------------------------
+static U16 LimitLoad( U8* pu8Levels, U16 u16Load )
+{
+  U8  u8Index;
+  U16 u16Scale;
+  U16 u16Budget = LoadBudget();
+#if LED_ADAPTIVE_MPX
+  U8  u8Lit = LitSides( pu8Levels );
+  
+  u16Load = SharedLoad( u16Load, u8Lit );
+#endif
+  
+#if LED_SOFT_START_MS
+  gbitSoftLimited = ( u16Load > u16Budget ) && ( u16Budget < gu16LoadBudget );
+#endif
+  if( u16Load > u16Budget )
+  {
+    u16Scale = (U16)( ( u16Budget * 256uL ) / u16Load );  // one division per heavy frame
+    u16Load = 0u;
+    for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+    {
+      pu8Levels[ u8Index ] = (U8)( ( pu8Levels[ u8Index ] * u16Scale ) >> 8u );
+      u16Load += pu8Levels[ u8Index ];
+    }
+#if LED_ADAPTIVE_MPX
+    u16Load = SharedLoad( u16Load, u8Lit );
+#endif
+  }
+  
+  return u16Load;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Adds the load of the last frame for the time since the previous call
+//! \param  -
+//! \return -
+//! \global gu32LoadMs, gu32LoadSinceMs
+//! \note   The frame is taken as shown from its commit, the rendering ahead is negligible.
+//-----------------------------------------------------------------------------
+static void IntegrateLoad( void )
+{
+  U32 u32Now = Util_GetTimerMs32();
+  
+  gu32LoadMs += (U32)gu16Load * ( u32Now - gu32LoadSinceMs );
+  gu32LoadSinceMs = u32Now;
+}
+
+#if LED_ADAPTIVE_MPX
+//----------------------------------------------------------------------------
+//! \brief  Tells which sides of a frame have any LED lit
+//! \param  pu8Levels: driver levels of the LEDs, LEDS_NUM of them
+//! \return LED_SIDE_BIT() of each side with a lit LED
+//! \global -
+//-----------------------------------------------------------------------------
+static U8 LitSides( const U8* pu8Levels )
+{
+  U8 u8Index;
+  U8 u8Side;
+  U8 u8Lit = 0u;
+  
+  for( u8Side = 0u; u8Side < LED_SIDES; u8Side++ )
+  {
+    for( u8Index = 0u; u8Index < LEDS_PER_SIDE; u8Index++ )
+    {
+      if( 0u != pu8Levels[ LED_SIDE_FIRST( u8Side ) + u8Index ] )
+      {
+        u8Lit |= LED_SIDE_BIT( u8Side );
+      }
+    }
+  }
+  
+  return u8Lit;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Scales the load of a frame by the share of the period its lit sides get
+//! \param  u16Load: sum of the levels
+//! \param  u8Lit: LED_SIDE_BIT() of each side with a lit LED, see LitSides()
+//! \return Load as if every side was driven for its own share of the period
+//! \global -
+//! \note   The dark sides are skipped, so e.g. a side lit alone is driven for the whole period and
+//!         counts LED_SIDES times. One division per frame, only if any side is dark.
+//-----------------------------------------------------------------------------
+static U16 SharedLoad( U16 u16Load, U8 u8Lit )
+{
+  U8 u8Side;
+  U8 u8Shown = 0u;
+  
+  for( u8Side = 0u; u8Side < LED_SIDES; u8Side++ )
+  {
+    if( 0u != ( u8Lit & LED_SIDE_BIT( u8Side ) ) )
+    {
+      u8Shown++;
+    }
+  }
+  if( ( 0u != u8Shown ) && ( u8Shown < LED_SIDES ) )
+  {
+    u16Load = (U16)( ( (U32)u16Load * LED_SIDES ) / u8Shown );
+  }
+  
+  return u16Load;
+}
+#endif
+
+//----------------------------------------------------------------------------
+//! \brief  Tells the side the multiplexer steps to at a period boundary
+//! \param  u8Side: side of the period ending
+//! \return Side of the next period
+//! \global gau8LitSides[], gu8FrontBuffer
+//! \note   The sides follow each other in their order. With LED_ADAPTIVE_MPX the dark sides are
+//!         skipped, a side lit alone keeps the multiplexer; an all-dark frame steps on as usual.
+//-----------------------------------------------------------------------------
+ISR_CODE static U8 NextSide( U8 u8Side )
+{
+  U8 u8Next = LED_SIDE_AFTER( u8Side );
+#if LED_ADAPTIVE_MPX
+  U8 u8Lit = gau8LitSides[ gu8FrontBuffer ];
+  
+  if( 0u != ( u8Lit & ~LED_SIDE_BIT( u8Side ) ) )
+  {
+    // Another side is lit: the first one of them in the order
+    while( 0u == ( u8Lit & LED_SIDE_BIT( u8Next ) ) )
+    {
+      u8Next = LED_SIDE_AFTER( u8Next );
+    }
+  }
+  else if( 0u != u8Lit )
+  {
+    u8Next = u8Side;
+  }
+#endif
+  
+  return u8Next;
+}
+
+#if LED_LIGHT_SENSE
+//----------------------------------------------------------------------------
+//! \brief  One interrupt of the dark slot of an ambient light measurement
+//! \param  -
+//! \return TRUE while the slot lasts; FALSE if it has just ended, the periods go on
+//! \global gu8SenseState, gu8SenseTicks, gu8SenseMaxTicks, gu8SenseResult, gu32SenseMPX
+//! \note   A lit LED has its common pin high and the MPX pin of its side low. In the slot every
+//!         MPX pin is high and every common pin low, so every LED is dark and reverse biased,
+//!         with its junction capacitance charged. Then the sensor pin floats: the photocurrent
+//!         of its LEDs pulls it up, the faster the brighter the room. A dark room doesn't
+//!         get there in gu8SenseMaxTicks, the slot is cut there, short enough not to be seen.
+//-----------------------------------------------------------------------------
+ISR_CODE static BOOL SenseStep( void )
+{
+  BOOL bRunning = TRUE;
+  
+  if( SENSE_START == gu8SenseState )
+  {
+    gu32SenseMPX = GPIOB->ODR & LED_MASK_MPX;
+    WRITE_REG( GPIOB->BSRR, LED_MASK_MPX );
+    WRITE_REG( GPIOA->BSRR, LED_MASK_GPIOA << 16u );
+    WRITE_REG( GPIOF->BSRR, LED_MASK_GPIOF << 16u );
+    LL_GPIO_SetPinMode( LED_GPIO_PORT( LED_SENSE ), LED_GPIO_PIN( LED_SENSE ), LL_GPIO_MODE_INPUT );
+    gu8SenseTicks = 0u;
+    gu8SenseState = SENSE_RUN;
+  }
+  else
+  {
+    gu8SenseTicks++;
+    if( LL_GPIO_IsInputPinSet( LED_GPIO_PORT( LED_SENSE ), LED_GPIO_PIN( LED_SENSE ) ) || ( gu8SenseMaxTicks <= gu8SenseTicks ) )
+    {
+      // Back to driving it low, and the multiplexer as it was
+      LL_GPIO_SetPinMode( LED_GPIO_PORT( LED_SENSE ), LED_GPIO_PIN( LED_SENSE ), LL_GPIO_MODE_OUTPUT );
+      WRITE_REG( GPIOB->BSRR, gu32SenseMPX | ( ( ~gu32SenseMPX & LED_MASK_MPX ) << 16u ) );
+      gu8SenseResult = gu8SenseTicks;
+      gu8SenseState = SENSE_IDLE;
+      bRunning = FALSE;
+    }
+  }
+  
+  return bRunning;
+}
+#endif
+
+#if LED_FAULT_CHECK
+//----------------------------------------------------------------------------
+//! \brief  One interrupt of the probe slot of the fault check
+//! \param  -
+//! \return TRUE while the slot lasts; FALSE if it has just ended, the periods go on
+//! \global gu8ProbeState, gu8ProbeTicks, gu8ProbeLED, gu32ProbeMPX, gbitLEDProbeSlot
+//! \note   The LED probed is lit alone at full drive for PROBE_TICKS timer periods, its side is
+//!         switched break-before-make. A waiting conversion is started at the update event of
+//!         the slot, see Sensor_ProbeSlot(). The slot ends dark, the next period writes the pins.
+//-----------------------------------------------------------------------------
+ISR_CODE static BOOL ProbeStep( void )
+{
+  BOOL bRunning = TRUE;
+  U32  u32Set;
+  
+  if( PROBE_START == gu8ProbeState )
+  {
+    u32Set = gcau32LEDPinMask[ gu8ProbeLED ];
+    gu32ProbeMPX = GPIOB->ODR & LED_MASK_MPX;
+    WRITE_REG( GPIOB->BSRR, LED_MASK_MPX );  // blank every side
+    // BSRR: set bits in the low half, reset bits in the high half
+    WRITE_REG( GPIOA->BSRR, ( u32Set & LED_MASK_GPIOA ) | ( ( ~u32Set & LED_MASK_GPIOA ) << 16u ) );
+    WRITE_REG( GPIOF->BSRR, ( ( u32Set >> 16u ) & LED_MASK_GPIOF ) | ( ( ~( u32Set >> 16u ) & LED_MASK_GPIOF ) << 16u ) );
+    WRITE_REG( GPIOB->BSRR, LED_MPX_PIN( LED_SIDE_OF( gu8ProbeLED ) ) << 16u );  // light its side
+    gbitLEDProbeSlot = 1;
+    gu8ProbeTicks = 0u;
+    gu8ProbeState = PROBE_RUN;
+  }
+  else
+  {
+    gu8ProbeTicks++;
+    if( gu8ProbeTicks >= PROBE_TICKS )
+    {
+      // Dark again, and the multiplexer as it was
+      WRITE_REG( GPIOB->BSRR, LED_MASK_MPX );
+      WRITE_REG( GPIOA->BSRR, LED_MASK_GPIOA << 16u );
+      WRITE_REG( GPIOF->BSRR, LED_MASK_GPIOF << 16u );
+      WRITE_REG( GPIOB->BSRR, gu32ProbeMPX | ( ( ~gu32ProbeMPX & LED_MASK_MPX ) << 16u ) );
+      gu8ProbeState = PROBE_IDLE;
+      bRunning = FALSE;
+    }
+  }
+  
+  return bRunning;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells the first LED to be probed from the given one on
+//! \param  u8LED: index of the LED, [0; LEDS_NUM]
+//! \return Index of the first LED not faulty from u8LED on; LEDS_NUM if there is none
+//! \global gu16Faults
+//-----------------------------------------------------------------------------
+static U8 NextProbed( U8 u8LED )
+{
+  while( ( u8LED < LEDS_NUM ) && ( 0u != ( gu16Faults & LED_BIT( u8LED ) ) ) )
+  {
+    u8LED++;
+  }
+  
+  return u8LED;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells the faulty LEDs from the sags of a round, and drops the ones seen twice
+//! \param  -
+//! \return -
+//! \global gau16FaultSagMv[], gu16FaultSuspects, gu16Faults
+//! \note   The sags are compared with their median, not with a fixed range: the internal
+//!         resistance of the cell changes with its charge and its temperature, the LEDs of a board
+//!         don't. A median below LED_FAULT_MIN_MV tells nothing, the suspects wait for the next
+//!         round. A faulty LED found again by the next round is dark from then on, and the fault
+//!         is counted in the statistics.
+//-----------------------------------------------------------------------------
+static void JudgeRound( void )
+{
+  U16 au16Sorted[ LEDS_NUM ];
+  U16 u16Sag;
+  U16 u16Median;
+  U16 u16Found = 0u;
+  U8  u8Count = 0u;
+  U8  u8LED;
+  U8  u8Index;
+  
+  // Insertion sort of the sags of the LEDs probed
+  for( u8LED = NextProbed( 0u ); u8LED < LEDS_NUM; u8LED = NextProbed( u8LED + 1u ) )
+  {
+    u16Sag = gau16FaultSagMv[ u8LED ];
+    for( u8Index = u8Count; ( 0u != u8Index ) && ( au16Sorted[ u8Index - 1u ] > u16Sag ); u8Index-- )
+    {
+      au16Sorted[ u8Index ] = au16Sorted[ u8Index - 1u ];
+    }
+    au16Sorted[ u8Index ] = u16Sag;
+    u8Count++;
+  }
+  u16Median = ( 0u != u8Count ) ? au16Sorted[ u8Count / 2u ] : 0u;
+  
+  if( u16Median >= LED_FAULT_MIN_MV )
+  {
+    for( u8LED = NextProbed( 0u ); u8LED < LEDS_NUM; u8LED = NextProbed( u8LED + 1u ) )
+    {
+      u16Sag = gau16FaultSagMv[ u8LED ];
+      if( ( ( u16Sag * LED_FAULT_RATIO ) < u16Median )  // open: no current flows
+       || ( u16Sag > ( u16Median * LED_FAULT_RATIO ) ) )  // shorted: only the pins limit it
+      {
+        u16Found |= LED_BIT( u8LED );
+      }
+    }
+    for( u8LED = 0u; u8LED < LEDS_NUM; u8LED++ )
+    {
+      if( 0u != ( u16Found & gu16FaultSuspects & LED_BIT( u8LED ) ) )
+      {
+        gu16Faults |= LED_BIT( u8LED );
+#if STATS_ENABLE
+        Stats_CountLEDFault( u8LED );
+#endif
+      }
+    }
+    gu16FaultSuspects = u16Found & ~gu16Faults;
+    if( 0u != ( u16Found & gu16Faults ) )
+    {
+      LED_Commit();  // the faulty LEDs go dark at once
+    }
+  }
+}
+#endif
+
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+//----------------------------------------------------------------------------
+//! \brief  Preloads the RGB output and the length of the next segment
+//! \param  -
+//! \return -
+//! \global gasSegments[][][], gu8NextSegment, gu8NextSide, gu8LEDNextRGB, gu8NextPlaneTicks
+//! \note   The length is loaded by TIM1 at the next update event.
+//-----------------------------------------------------------------------------
+ISR_CODE static void PreloadSegment( void )
+{
+  const S_LED_SEGMENT* psSegment;
+  
+  psSegment = &gasSegments[ gu8FrontBuffer ][ gu8NextSide ][ gu8NextSegment ];
+  gu8LEDNextRGB = psSegment->u8RGB;
+  gu8NextPlaneTicks = psSegment->u8Ticks;
+  LL_TIM_SetRepetitionCounter( TIM1, gu8NextPlaneTicks - 1u );
+}
+#endif
+
+
+#if ( LED_DRIVER_MODE == LED_MODE_LADDER ) && LED_RGB_SCHEDULE
+//----------------------------------------------------------------------------
+//! \brief  Ranks the ticks of the period by the LEDs lit in them, for the RGB LED
+//! \param  u8Buffer: frame buffer to be ranked
+//! \return -
+//! \global gau8LEDFrame[][], gau8RGBOrder[][]
+//! \note   The RGB LED pulses in the same ticks in the periods of every side, so their loads are
+//!         added. Ticks of the same load are ranked in the spread order: with the LEDs dark the
+//!         RGB levels are spread just like the ones of the LEDs.
+//-----------------------------------------------------------------------------
+static void RankTicks( U8 u8Buffer )
+{
+  U8 au8Load[ PWM_LEVELS ];
+  U8 u8Tick;
+  U8 u8Index;
+  U8 u8LED;
+  U8 u8Threshold;
+  U8 u8Load;
+  U8 u8Rank = 0u;
+  
+  // LEDs lit in each tick, compared just like LED_Interrupt() does
+  for( u8Tick = 0u; u8Tick < PWM_LEVELS; u8Tick++ )
+  {
+#if LED_PWM_SPREAD
+    u8Threshold = gcau8PWMOrder[ u8Tick ];
+#else
+    u8Threshold = u8Tick;
+#endif
+    u8Load = 0u;
+    for( u8Index = 0u; u8Index < LEDS_PER_SIDE; u8Index++ )
+    {
+#if LED_PHASE_STAGGER
+      u8Threshold = gcau8PhaseOrder[ u8Index ][ u8Tick ];
+#endif
+      for( u8LED = u8Index; u8LED < LEDS_NUM; u8LED += LEDS_PER_SIDE )
+      {
+        u8Load += ( gau8LEDFrame[ u8Buffer ][ u8LED ] > u8Threshold ) ? 1u : 0u;
+      }
+    }
+    au8Load[ u8Tick ] = u8Load;
+  }
+  
+  // Counting sort: the lightest ticks first, each load in the spread order
+  for( u8Load = 0u; ( u8Load <= LEDS_NUM ) && ( u8Rank < PWM_LEVELS ); u8Load++ )
+  {
+    for( u8Threshold = 0u; u8Threshold < PWM_LEVELS; u8Threshold++ )
+    {
+#if LED_PWM_SPREAD
+      u8Tick = gcau8PWMOrder[ u8Threshold ];  // the reversed counter is its own inverse: the tick of this threshold
+#else
+      u8Tick = u8Threshold;
+#endif
+      if( u8Load == au8Load[ u8Tick ] )
+      {
+        gau8RGBOrder[ u8Buffer ][ u8Tick ] = u8Rank;
+        u8Rank++;
+      }
+    }
+  }
+}
+#endif
 
 
 /***************************************< Public functions >**************************************/
@@ -53,12 +797,15 @@ DATA BIT gbitSide;                      //!< Stores which side of the panel is a
 //! \brief  Initialize all IO pins associated with LEDs
 //! \param  -
 //! \return -
-//! \global gau8LEDBrightness[], gu8PWMCounter
-//! \note   Should be called in the init block
+//! \global gau8LEDBrightness[], gau8LevelLUT[], gu8DimLevel, gu8PWMCounter, frame buffers, bit-plane state
+//! \note   Should be called in the init block. Global brightness is reset to full, or to the cap.
+//!         With LED_FAULT_CHECK the faults found stay, and the check goes on.
 //-----------------------------------------------------------------------------
 void LED_Init( void )
 {
+#if !UTIL_REGISTER_INIT
   LL_GPIO_InitTypeDef TIM1CH1MapInit= {0};
+#endif
   U8 u8Index;
   
   // Init globals
@@ -67,6 +814,45 @@ void LED_Init( void )
   {
     gau8LEDBrightness[ u8Index ] = 0;
   }
+  gu8DimLevel = LED_DIM_FULL;
+  BuildLevelLUT( gu8DimCap );
+  gu8FrontBuffer = 0u;
+  gu16Load = 0u;  // the LEDs have been dark since the drivers stopped
+  gu32LoadSinceMs = Util_GetTimerMs32();
+#if LED_SOFT_START_MS
+  gu32SoftStartMs = gu32LoadSinceMs;  // at the reset and at every wakeup
+  gbitSoftLimited = 0;
+#endif
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+  // The first update event starts segment 0, and switches the side, just like a wrap-around
+  gu8NextSegment = 0u;
+  gu8NextSide = LED_SIDE_AFTER( gu8Side );
+  gu8LEDNextRGB = 0u;
+  gu8PlaneTicks = 1u;
+  gu8NextPlaneTicks = 1u;  // TIM1 starts with zero repetition counter
+#elif LED_ADAPTIVE_TICKS
+  gu8PlaneTicks = 1u;
+  gu8NextPlaneTicks = 1u;  // TIM1 starts with zero repetition counter
+#endif
+  // Fill both buffers
+  LED_Commit();
+  gu8FrontBuffer = 1u;
+  LED_Commit();
+  gbitFramePending = 0;
+#if LED_LIGHT_SENSE
+  gu8SenseState = SENSE_IDLE;
+  gbitSenseRequest = 0;
+  gu8SenseResult = 0u;
+  gbitAmbientPending = 0;
+  Util_TimerStart( UTIL_TIMER_LIGHT_SENSE, LED_SENSE_PERIOD_MS );
+#endif
+#if LED_FAULT_CHECK
+  gu8ProbeState = PROBE_IDLE;  // a probe waiting for its slots goes on: the sensor service waits for them
+  if( FAULT_WAIT == gu8FaultStep )
+  {
+    Util_TimerStart( UTIL_TIMER_LED_FAULT, LED_FAULT_START_MS );
+  }
+#endif
   
   // Enable clocks
   LL_IOP_GRP1_EnableClock( LL_IOP_GRP1_PERIPH_GPIOA );
@@ -76,153 +862,1057 @@ void LED_Init( void )
   // Initialize GPIO pins
   /* Default output states */
   LL_GPIO_WriteOutputPort( GPIOA, 0u );
-  LL_GPIO_WriteOutputPort( GPIOB, LL_GPIO_PIN_0 );  // MPX1 starts as 1
+  LL_GPIO_WriteOutputPort( GPIOB, LED_MASK_MPX & ~LED_MPX_PIN( 0u ) );  // every side but side 0 starts as 1
   LL_GPIO_WriteOutputPort( GPIOF, 0u );
+#if UTIL_REGISTER_INIT
+  Util_GPIO_Init( GPIOA, LED_MASK_GPIOA, LL_GPIO_MODE_OUTPUT, LL_GPIO_SPEED_FREQ_VERY_HIGH, LL_GPIO_PULL_NO, 0u );
+  Util_GPIO_Init( GPIOB, LED_MASK_MPX, LL_GPIO_MODE_OUTPUT, LL_GPIO_SPEED_FREQ_VERY_HIGH, LL_GPIO_PULL_NO, 0u );
+  Util_GPIO_Init( GPIOF, LED_MASK_GPIOF, LL_GPIO_MODE_OUTPUT, LL_GPIO_SPEED_FREQ_VERY_HIGH, LL_GPIO_PULL_NO, 0u );
+#else
   /* GPIOA */
-  TIM1CH1MapInit.Pin        = LL_GPIO_PIN_7 | LL_GPIO_PIN_6 | LL_GPIO_PIN_3 | LL_GPIO_PIN_2;
+  TIM1CH1MapInit.Pin        = LED_MASK_GPIOA;
   TIM1CH1MapInit.Mode       = LL_GPIO_MODE_OUTPUT;
   TIM1CH1MapInit.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
   TIM1CH1MapInit.Speed      = LL_GPIO_SPEED_FREQ_VERY_HIGH;
   LL_GPIO_Init( GPIOA, &TIM1CH1MapInit );
 
   /* GPIOB */
-  TIM1CH1MapInit.Pin        = LL_GPIO_PIN_0 | LL_GPIO_PIN_1;
+  TIM1CH1MapInit.Pin        = LED_MASK_MPX;
   TIM1CH1MapInit.Mode       = LL_GPIO_MODE_OUTPUT;
   TIM1CH1MapInit.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
   TIM1CH1MapInit.Speed      = LL_GPIO_SPEED_FREQ_VERY_HIGH;
   LL_GPIO_Init( GPIOB, &TIM1CH1MapInit );
 
   /* GPIOF */
-  TIM1CH1MapInit.Pin        = LL_GPIO_PIN_0 | LL_GPIO_PIN_1;
+  TIM1CH1MapInit.Pin        = LED_MASK_GPIOF;
   TIM1CH1MapInit.Mode       = LL_GPIO_MODE_OUTPUT;
   TIM1CH1MapInit.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
   TIM1CH1MapInit.Speed      = LL_GPIO_SPEED_FREQ_VERY_HIGH;
   LL_GPIO_Init( GPIOF, &TIM1CH1MapInit );
+#endif
 }
 
 //----------------------------------------------------------------------------
-//! \brief  Interrupt routine to implement soft-PWM
+//! \brief  Hands over the brightness levels to the interrupt as a new frame, to be shown at once
 //! \param  -
 //! \return -
-//! \global gau8LEDBrightness[], gu8PWMCounter
-//! \note   Should be called from periodic timer interrupt routine.
+//! \global see LED_CommitAt()
+//! \note   Should be called after gau8LEDBrightness[] or gau8RGBLEDs[] has been changed.
 //-----------------------------------------------------------------------------
-void LED_Interrupt( void )
+void LED_Commit( void )
 {
-  gu8PWMCounter++;
-  if( gu8PWMCounter == PWM_LEVELS )
+  LED_CommitAt( Util_GetTimerMs() );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Hands over the brightness levels to the interrupt as a new frame
+//! \param  u16DueMs: the frame is shown from this time of Util_GetTimerMs() on; at most 32 s ahead
+//! \return -
+//! \global gau8LEDBrightness[], gau8RGBLEDs[], gau8LevelLUT[], gu16Load, frame buffers, gu8FrontBuffer, gbitFramePending, gu16FrameDueMs, gau8LitSides[], gau32StaticSet[][]
+//! \note   The frame is built in the back buffer, and the interrupt swaps the buffers at the first
+//!         period boundary from the due time, so a half-finished frame is never shown and no locking
+//!         is needed. A frame built ahead is shown on time, the swap costs the same as ever.
+//!         Levels of the LEDs go through the level table and their trims here, once per frame, so
+//!         the global brightness and the calibration cost nothing in the interrupt. In bit-plane mode the RGB levels go through
+//!         the gamma table; their global brightness is set by the pulse width instead.
+//!         Frames heavier than LED_LOAD_BUDGET are scaled down, to spare the cell.
+//!         Neighbouring planes with identical LED and RGB outputs are merged into one segment,
+//!         so e.g. an all-dark or all-bright side costs only one interrupt.
+//!         In bit-plane mode each side ends with LED_BLANK_TICKS of blanking slot; it merges into a
+//!         dark last plane, otherwise it is one more segment. The ladder needs none: its last tick
+//!         is dark for every level. With LED_FAST_REFRESH a plane unit is one TIM1 period for the
+//!         fast refresh, LED_FAST_DIVIDER of them for the normal one.
+//!         In ladder mode a side with only dark and full LEDs is marked in gau32StaticSet[][],
+//!         so the interrupt doesn't compare its levels. With LED_RGB_SCHEDULE the ticks of the
+//!         frame are ranked for the RGB LED too, see RankTicks().
+//-----------------------------------------------------------------------------
+void LED_CommitAt( U16 u16DueMs )
+{
+  U8  u8Back;
+  U8  u8Index;
+  U16 u16Load;
+  U8  u8Side;
+  U8  u8LED;
+  U32 u32Set;
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+  U8  u8Plane;
+  U8  u8Segment;
+  U8  u8RGBBits;
+  U8  u8LastRGBBits = 0u;
+  U8  u8Unit = 1u;
+  U32 u32GPIOA;
+  U32 u32GPIOF;
+  U8  au8Level[ LEDS_NUM ];
+  U8  au8RGBLevel[ NUM_RGBLED_COLORS ];
+#endif
+  
+  // Claim the back buffer: the interrupt doesn't swap while the flag is cleared
+  gbitFramePending = 0;
+  u8Back = gu8FrontBuffer ^ 1u;
+  
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+#if LED_FAST_REFRESH
+  // TIM1 periods of the shortest plane: the normal refresh takes LED_FAST_DIVIDER of the fast ones
+  u8Unit = gbitFastRefresh ? 1u : LED_FAST_DIVIDER;
+#endif
+  // Map animation levels to PWM levels
+  u16Load = 0u;
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
   {
-    gu8PWMCounter = 0;
-    gbitSide ^= 1;
-    // Set multiplexer pins
-    LL_GPIO_TogglePin( MPX1 );
-    LL_GPIO_TogglePin( MPX2 );
+    au8Level[ u8Index ] = TrimmedLevel( u8Index, gau8LEDBrightness[ u8Index ] );
+    u16Load += au8Level[ u8Index ];
+  }
+  u16Load = LimitLoad( au8Level, u16Load );
+#if LED_ADAPTIVE_MPX
+  gau8LitSides[ u8Back ] = LitSides( au8Level );
+#endif
+  for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
+  {
+    au8RGBLevel[ u8Index ] = gcau8GammaLUT[ gau8RGBLEDs[ u8Index ] & LED_BRIGHTNESS_MAX ];
   }
   
-  //NOTE: unfortunately SFRs cannot be put in an array, so this cannot be implented as a for cycle
-  if( gbitSide )  // left side
+  for( u8Side = 0u; u8Side < LED_SIDES; u8Side++ )
   {
-    if( gau8LEDBrightness[ 0u ] > gu8PWMCounter )  // D12
-    {
-      LL_GPIO_SetOutputPin( LED0 );
-    }
-    else
+    u8Segment = 0u;
+    for( u8Plane = 0u; u8Plane < LED_PWM_BITS; u8Plane++ )
     {
-      LL_GPIO_ResetOutputPin( LED0 );
+      u32Set = 0u;
+      for( u8Index = 0u; u8Index < LEDS_PER_SIDE; u8Index++ )
+      {
+        u8LED = LED_SIDE_FIRST( u8Side ) + u8Index;
+        if( au8Level[ u8LED ] & ( 1u << u8Plane ) )
+        {
+          u32Set |= gcau32LEDPinMask[ u8LED ];
+        }
+      }
+      // BSRR: set bits in the low half, reset bits in the high half
+      u32GPIOA = ( u32Set & 0xFFFFu ) | ( ( ~u32Set & LED_MASK_GPIOA ) << 16u );
+      u32GPIOF = ( u32Set >> 16u ) | ( ( ~( u32Set >> 16u ) & LED_MASK_GPIOF ) << 16u );
+      u8RGBBits = 0u;
+      for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
+      {
+        u8RGBBits |= ( ( au8RGBLevel[ u8Index ] >> u8Plane ) & 1u ) << u8Index;
+      }
+      
+      if( ( 0u != u8Plane )
+       && ( u32GPIOA == gasSegments[ u8Back ][ u8Side ][ u8Segment - 1u ].u32GPIOA )
+       && ( u32GPIOF == gasSegments[ u8Back ][ u8Side ][ u8Segment - 1u ].u32GPIOF )
+       && ( u8RGBBits == u8LastRGBBits ) )
+      {
+        // Same output as the previous plane: just make it longer
+        gasSegments[ u8Back ][ u8Side ][ u8Segment - 1u ].u8Ticks += (U8)( u8Unit << u8Plane );
+      }
+      else
+      {
+        gasSegments[ u8Back ][ u8Side ][ u8Segment ].u32GPIOA = u32GPIOA;
+        gasSegments[ u8Back ][ u8Side ][ u8Segment ].u32GPIOF = u32GPIOF;
+        gasSegments[ u8Back ][ u8Side ][ u8Segment ].u8Ticks  = (U8)( u8Unit << u8Plane );
+        gasSegments[ u8Back ][ u8Side ][ u8Segment ].u8RGB    = u8RGBBits;
+        u8Segment++;
+      }
+      u8LastRGBBits = u8RGBBits;
     }
-    if( gau8LEDBrightness[ 1u ] > gu8PWMCounter )  // D4
+#if LED_BLANK_TICKS
+    // Blanking slot: the common pins go dark before the multiplexer switches, the MPX transistors turn off meanwhile
+    u32GPIOA = LED_MASK_GPIOA << 16u;
+    u32GPIOF = LED_MASK_GPIOF << 16u;
+    if( ( u32GPIOA == gasSegments[ u8Back ][ u8Side ][ u8Segment - 1u ].u32GPIOA )
+     && ( u32GPIOF == gasSegments[ u8Back ][ u8Side ][ u8Segment - 1u ].u32GPIOF )
+     && ( 0u == u8LastRGBBits ) )
     {
-      LL_GPIO_SetOutputPin( LED1 );
+      gasSegments[ u8Back ][ u8Side ][ u8Segment - 1u ].u8Ticks += LED_BLANK_TICKS * u8Unit;
     }
     else
     {
-      LL_GPIO_ResetOutputPin( LED1 );
+      gasSegments[ u8Back ][ u8Side ][ u8Segment ].u32GPIOA = u32GPIOA;
+      gasSegments[ u8Back ][ u8Side ][ u8Segment ].u32GPIOF = u32GPIOF;
+      gasSegments[ u8Back ][ u8Side ][ u8Segment ].u8Ticks  = LED_BLANK_TICKS * u8Unit;
+      gasSegments[ u8Back ][ u8Side ][ u8Segment ].u8RGB    = 0u;
+      u8Segment++;
     }
-    if( gau8LEDBrightness[ 2u ] > gu8PWMCounter )  // D6
-    {
-      LL_GPIO_SetOutputPin( LED2 );
-    }
-    else
+#endif
+    gau8SegmentCount[ u8Back ][ u8Side ] = u8Segment;
+  }
+#else
+  u16Load = 0u;
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+  {
+    gau8LEDFrame[ u8Back ][ u8Index ] = TrimmedLevel( u8Index, gau8LEDBrightness[ u8Index ] );
+    u16Load += gau8LEDFrame[ u8Back ][ u8Index ];
+  }
+  u16Load = LimitLoad( gau8LEDFrame[ u8Back ], u16Load );
+#if LED_ADAPTIVE_MPX
+  gau8LitSides[ u8Back ] = LitSides( gau8LEDFrame[ u8Back ] );
+#endif
+  // A side with only dark and full LEDs changes at the start of the period and before its last tick only
+  for( u8Side = 0u; u8Side < LED_SIDES; u8Side++ )
+  {
+    u32Set = 0u;
+    u8LED = LED_SIDE_FIRST( u8Side );
+    for( u8Index = 0u; u8Index < LEDS_PER_SIDE; u8Index++ )
     {
-      LL_GPIO_ResetOutputPin( LED2 );
+      if( LED_PWM_MAX == gau8LEDFrame[ u8Back ][ u8LED ] )
+      {
+        u32Set |= gcau32LEDPinMask[ u8LED ];
+      }
+      else if( 0u != gau8LEDFrame[ u8Back ][ u8LED ] )
+      {
+        u32Set = LED_SIDE_PWM;
+        break;
+      }
+      u8LED++;
     }
-    if( gau8LEDBrightness[ 3u ] > gu8PWMCounter )  // D10
+    gau32StaticSet[ u8Back ][ u8Side ] = u32Set;
+  }
+#if LED_RGB_SCHEDULE
+  RankTicks( u8Back );
+#endif
+#endif
+  IntegrateLoad();
+  gu16Load = u16Load;
+  UTIL_TRACE_EVENT( UTIL_TRACE_COMMIT, u16DueMs );
+  
+  gu16FrameDueMs = u16DueMs;
+  gbitFramePending = 1;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells if the interrupt hasn't taken the last frame yet
+//! \param  -
+//! \return TRUE while the back buffer holds a frame to be shown
+//! \global gbitFramePending
+//-----------------------------------------------------------------------------
+BOOL LED_IsFramePending( void )
+{
+  return gbitFramePending;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells if every LED, including the RGB LED, is dark
+//! \param  -
+//! \return TRUE if nothing is lit, i.e. the multiplexing can be stopped
+//! \global gau8LEDBrightness[], gau8RGBLEDs[], gbitFramePending
+//! \note   Not while a frame is pending: the levels may be ahead of the frame shown.
+//-----------------------------------------------------------------------------
+BOOL LED_IsDark( void )
+{
+  U8   u8Index;
+  BOOL bDark = !gbitFramePending;
+  
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+  {
+    if( 0u != gau8LEDBrightness[ u8Index ] )
     {
-      LL_GPIO_SetOutputPin( LED3 );
+      bDark = FALSE;
     }
-    else
+  }
+  for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
+  {
+    if( 0u != gau8RGBLEDs[ u8Index ] )
     {
-      LL_GPIO_ResetOutputPin( LED3 );
+      bDark = FALSE;
     }
-    if( gau8LEDBrightness[ 4u ] > gu8PWMCounter )  // D8
+  }
+  
+  return bDark;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells if the frame shown has a single LED lit, and the RGB LED dark
+//! \param  -
+//! \return TRUE if LED_SoloOn() can hold the frame without the multiplexing
+//! \global gau8LEDBrightness[], gau8RGBLEDs[], gbitFramePending
+//! \note   Not while a frame is pending, just like LED_IsDark().
+//-----------------------------------------------------------------------------
+BOOL LED_IsSolo( void )
+{
+  U8   u8Index;
+  U8   u8Lit = 0u;
+  BOOL bSolo = !gbitFramePending;
+  
+  for( u8Index = 0u; u8Index < LEDS_NUM; u8Index++ )
+  {
+    if( 0u != gau8LEDBrightness[ u8Index ] )
     {
-      LL_GPIO_SetOutputPin( LED4 );
+      u8Lit++;
     }
-    else
+  }
+  for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
+  {
+    if( 0u != gau8RGBLEDs[ u8Index ] )
     {
-      LL_GPIO_ResetOutputPin( LED4 );
+      bSolo = FALSE;
     }
-    if( gau8LEDBrightness[ 5u ] > gu8PWMCounter )  // D2
+  }
+  
+  return bSolo && ( 1u == u8Lit );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Lights the single LED of the frame by its pins alone, for the stop mode
+//! \param  -
+//! \return -
+//! \global gau8LEDBrightness[], gu32SoloMPX
+//! \note   Should be called with TIM1 stopped, if LED_IsSolo() is TRUE, and followed by LED_SoloOff()
+//!         before TIM1 is started again. The LED is lit all the time, at full drive: its level and
+//!         the global brightness are not applied, only the length of the frame sets the brightness.
+//!         The side is switched break-before-make, just like the interrupt does.
+//-----------------------------------------------------------------------------
+void LED_SoloOn( void )
+{
+  U8  u8LED = 0u;
+  U32 u32Set;
+  
+  while( ( u8LED < ( LEDS_NUM - 1u ) ) && ( 0u == gau8LEDBrightness[ u8LED ] ) )
+  {
+    u8LED++;
+  }
+  u32Set = gcau32LEDPinMask[ u8LED ];
+  
+  gu32SoloMPX = GPIOB->ODR & LED_MASK_MPX;
+  WRITE_REG( GPIOB->BSRR, LED_MASK_MPX );  // blank every side
+  // BSRR: set bits in the low half, reset bits in the high half
+  WRITE_REG( GPIOA->BSRR, ( u32Set & LED_MASK_GPIOA ) | ( ( ~u32Set & LED_MASK_GPIOA ) << 16u ) );
+  WRITE_REG( GPIOF->BSRR, ( ( u32Set >> 16u ) & LED_MASK_GPIOF ) | ( ( ~( u32Set >> 16u ) & LED_MASK_GPIOF ) << 16u ) );
+  WRITE_REG( GPIOB->BSRR, LED_MPX_PIN( LED_SIDE_OF( u8LED ) ) << 16u );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Gives the pins back to the interrupt after LED_SoloOn()
+//! \param  -
+//! \return -
+//! \global gu32SoloMPX
+//! \note   Every common pin goes low and the multiplexer back to the side of the interrupt; its next
+//!         segment writes the common pins of the frame again.
+//-----------------------------------------------------------------------------
+void LED_SoloOff( void )
+{
+  WRITE_REG( GPIOB->BSRR, LED_MASK_MPX );
+  WRITE_REG( GPIOA->BSRR, LED_MASK_GPIOA << 16u );
+  WRITE_REG( GPIOF->BSRR, LED_MASK_GPIOF << 16u );
+  WRITE_REG( GPIOB->BSRR, gu32SoloMPX | ( ( ~gu32SoloMPX & LED_MASK_MPX ) << 16u ) );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Sets the global brightness of every LED, including the RGB LED
+//! \param  u8Level: global brightness, [0; LED_DIM_FULL]; 0 is the night mode, 1/8 of full
+//! \return -
+//! \global gu8DimLevel
+//! \note   Should be called after LED_Init() and RGBLED_Init(), both reset it to full.
+//!         The brightness cap of LED_SetBrightnessCap() still applies.
+//-----------------------------------------------------------------------------
+void LED_SetBrightness( U8 u8Level )
+{
+  gu8DimLevel = u8Level;
+  ApplyBrightness();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Sets the calibration of the LEDs
+//! \param  pu8Trims: trim of each LED, LEDS_NUM of them; the driver level is scaled by ( 256 - trim ) / 256
+//! \return -
+//! \global gau8Trim[]
+//! \note   LEDs of different efficiency, or a brighter side of the multiplexer, are trimmed down to
+//!         the dimmest one, so the output is even without driving anything harder. 0: untrimmed.
+//-----------------------------------------------------------------------------
+void LED_SetTrims( const U8* pu8Trims )
+{
+  memcpy( gau8Trim, pu8Trims, LEDS_NUM );
+  // Show it even if the animation is standing still
+  LED_Commit();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Compensates the efficiency of the LEDs for the temperature
+//! \param  i8Celsius: temperature of the board in degC
+//! \return -
+//! \global gu8TempDim
+//! \note   The LEDs give more light in the cold, so below TEMP_REFERENCE_C the driver levels are
+//!         scaled down by TEMP_DIM_PER_C/256 per degC, at most TEMP_DIM_MAX/256; above it they are
+//!         left at full, there is no headroom. Nothing is rebuilt if the scale doesn't change.
+//-----------------------------------------------------------------------------
+void LED_SetTemperature( I8 i8Celsius )
+{
+  U8 u8Dim = 0u;
+  
+  if( i8Celsius < TEMP_REFERENCE_C )
+  {
+    u8Dim = TEMP_DIM_MAX;
+    if( (U8)( TEMP_REFERENCE_C - i8Celsius ) < ( TEMP_DIM_MAX / TEMP_DIM_PER_C ) )
     {
-      LL_GPIO_SetOutputPin( LED5 );
+      u8Dim = (U8)( (U8)( TEMP_REFERENCE_C - i8Celsius ) * TEMP_DIM_PER_C );
     }
-    else
+  }
+  if( u8Dim != gu8TempDim )
+  {
+    gu8TempDim = u8Dim;
+    ApplyBrightness();
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Scales the driver levels down for the runtime on the cell
+//! \param  u8Dim: scale-down in 1/256, see runtime.c; 0: full scale
+//! \return -
+//! \global gu8PlanDim
+//! \note   Applied on top of the temperature, unlike the global brightness in fine steps. Nothing
+//!         is rebuilt if the scale doesn't change.
+//-----------------------------------------------------------------------------
+void LED_SetPlanDim( U8 u8Dim )
+{
+  if( u8Dim != gu8PlanDim )
+  {
+    gu8PlanDim = u8Dim;
+    ApplyBrightness();
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Limits the global brightness, e.g. when the battery is getting weak
+//! \param  u8Cap: highest global brightness, [0; LED_DIM_FULL]
+//! \return -
+//! \global gu8DimCap
+//! \note   Nothing is rebuilt if the cap doesn't change, so it can be called after every measurement.
+//-----------------------------------------------------------------------------
+void LED_SetBrightnessCap( U8 u8Cap )
+{
+  if( u8Cap != gu8DimCap )
+  {
+    gu8DimCap = u8Cap;
+    ApplyBrightness();
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Sets the highest load of a frame, for the power source
+//! \param  u16Budget: heavier frames are scaled down to it, [LED_SOFT_START_LOAD; LED_LOAD_FULL]
+//! \return -
+//! \global gu16LoadBudget
+//! \note   LED_LOAD_BUDGET spares a CR2032; a stiff source, e.g. a 2xAA pack, may take LED_LOAD_FULL.
+//!         The soft start ramps up to it all the same. Nothing is rebuilt if it doesn't change.
+//-----------------------------------------------------------------------------
+void LED_SetLoadBudget( U16 u16Budget )
+{
+  if( u16Budget != gu16LoadBudget )
+  {
+    gu16LoadBudget = u16Budget;
+    LED_Commit();
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells the load of the last frame, proportional to the average current of the LEDs
+//! \param  -
+//! \return Sum of the driver levels of the LEDs, [0; LED_LOAD_FULL]
+//! \global gu16Load
+//! \note   The RGB LED is left out, its short pulses are negligible next to the LEDs.
+//!         With LED_ADAPTIVE_MPX a side lit alone counts twice, as it is driven for the whole period.
+//-----------------------------------------------------------------------------
+U16 LED_GetLoad( void )
+{
+  return gu16Load;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Takes the load integrated over time, for the charge drawn by the LEDs
+//! \param  -
+//! \return Sum of LED_GetLoad() times the ms each frame has been shown, since the previous call
+//! \global gu32LoadMs
+//! \note   Should be called from main cycle only, at least every few minutes, so the sum can't
+//!         overflow: at LED_LOAD_FULL it holds about 6 hours.
+//-----------------------------------------------------------------------------
+U32 LED_TakeLoadMs( void )
+{
+  U32 u32LoadMs;
+  
+  IntegrateLoad();
+  u32LoadMs = gu32LoadMs;
+  gu32LoadMs = 0u;
+  
+  return u32LoadMs;
+}
+
+#if LED_FAST_REFRESH
+//----------------------------------------------------------------------------
+//! \brief  Selects the refresh of the next frames
+//! \param  bFast: TRUE: the planes are single TIM1 periods, every side is refreshed at 2.5 kHz;
+//!                FALSE: LED_FAST_DIVIDER periods each, at 312 Hz as without LED_FAST_REFRESH
+//! \return -
+//! \global gbitFastRefresh
+//! \note   Should be called from main cycle only, it takes effect at the next LED_Commit(). Cameras
+//!         see no bands at the fast refresh, but every segment is an interrupt: it takes
+//!         LED_FAST_DIVIDER times as many. With LED_FAST_REFRESH 2 it is always fast.
+//-----------------------------------------------------------------------------
+void LED_SetFastRefresh( BOOL bFast )
+{
+  gbitFastRefresh = bFast || gbitFastAlways;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Selects the fast refresh for every animation, e.g. on a supply that affords its interrupts
+//! \param  bAlways: TRUE: always fast, like with LED_FAST_REFRESH 2; FALSE: from the next animation, as LED_SetFastRefresh() selects
+//! \return -
+//! \global gbitFastAlways, gbitFastRefresh
+//! \note   Should be called from main cycle only. LED_FAST_REFRESH 2 stays always fast.
+//-----------------------------------------------------------------------------
+void LED_SetFastRefreshAlways( BOOL bAlways )
+{
+  gbitFastAlways = bAlways || ( 2u == LED_FAST_REFRESH );
+  gbitFastRefresh = gbitFastRefresh || gbitFastAlways;
+}
+#endif
+
+#if LED_SOFT_START_MS
+//----------------------------------------------------------------------------
+//! \brief  Rebuilds the frame held back by the ramp of the budget, until it is shown in full
+//! \param  -
+//! \return Time until it has to be called again in ms; UTIL_TIMER_NONE once the frame is in full
+//! \global gbitSoftLimited, gu32SoftStartMs
+//! \note   Should be called from main cycle only, while the animation stands still for at least
+//!         LED_SOFT_START_STEP_MS: it commits no frame, so its frame is committed again from the same
+//!         levels, and taken by the driver long before the next instruction. A frame pending for later
+//!         is left alone, its own commit takes the budget then.
+//-----------------------------------------------------------------------------
+U32 LED_SoftStartCycle( void )
+{
+  U32 u32Next = UTIL_TIMER_NONE;
+  
+  if( gbitSoftLimited && !LED_IsFramePending() )
+  {
+    LED_Commit();  // clears gbitSoftLimited at the full budget
+  }
+  if( gbitSoftLimited )
+  {
+    u32Next = LED_SOFT_START_STEP_MS;
+  }
+  
+  return u32Next;
+}
+#endif
+
+#if LED_LIGHT_SENSE
+//----------------------------------------------------------------------------
+//! \brief  Requests a light measurement in a dark slot before the next period
+//! \param  u8MaxTicks: longest dark slot in TIM1 periods, [1; 255]; a darker room reads as this
+//! \return TRUE if requested; FALSE if another measurement is on the way or its result is not taken yet
+//! \global gu8SenseState, gbitSenseRequest, gu8SenseResult, gu8SenseMaxTicks
+//! \note   Should be called from main cycle only! The result is read by LED_SenseResult().
+//!         The measurement waits while the multiplexing is stopped.
+//-----------------------------------------------------------------------------
+BOOL LED_SenseRequest( U8 u8MaxTicks )
+{
+  BOOL bRequested = FALSE;
+  
+  if( ( SENSE_IDLE == gu8SenseState ) && !gbitSenseRequest && ( 0u == gu8SenseResult ) )
+  {
+    gu8SenseMaxTicks = u8MaxTicks;
+    gbitSenseRequest = 1;
+    bRequested = TRUE;
+  }
+  
+  return bRequested;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Takes the result of the requested light measurement
+//! \param  -
+//! \return Charge time of the sensor in TIM1 periods, [1; u8MaxTicks]; 0 if it is not ready yet
+//! \global gu8SenseResult
+//! \note   Should be called from main cycle only, by the one who has requested it. A result is
+//!         returned once, then the next measurement can be requested.
+//-----------------------------------------------------------------------------
+U8 LED_SenseResult( void )
+{
+  U8 u8Ticks = gu8SenseResult;
+  
+  gu8SenseResult = 0u;
+  
+  return u8Ticks;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Requests the ambient light measurements and dims the LEDs by their results
+//! \param  -
+//! \return Time until it has to be called again in ms; 0 while a result is awaited
+//! \global gbitAmbientPending, gu8SensePrevious, gu8DimAmbient
+//! \note   Should be called from main cycle only! A measurement is taken every LED_SENSE_PERIOD_MS,
+//!         and the brightness only follows a result seen twice in a row, so a passing shadow or a
+//!         hand over the tree doesn't make it blink. If the sensor is busy, it is tried again soon.
+//-----------------------------------------------------------------------------
+U32 LED_LightSenseCycle( void )
+{
+  U8  u8Ticks;
+  U8  u8Steps;
+  U32 u32Next = 0u;
+  
+  if( gbitAmbientPending )
+  {
+    u8Ticks = LED_SenseResult();
+    if( 0u != u8Ticks )
     {
-      LL_GPIO_ResetOutputPin( LED5 );
+      gbitAmbientPending = 0;
+      // The darker the room, the longer the pin takes to charge up
+      if( u8Ticks < LED_SENSE_DIM_TICKS )
+      {
+        u8Steps = 0u;
+      }
+      else if( u8Ticks < LED_SENSE_MAX_TICKS )
+      {
+        u8Steps = 1u;
+      }
+      else
+      {
+        u8Steps = 2u;
+      }
+      if( ( u8Steps == gu8SensePrevious ) && ( u8Steps != gu8DimAmbient ) )
+      {
+        gu8DimAmbient = u8Steps;
+        ApplyBrightness();
+      }
+      gu8SensePrevious = u8Steps;
+      Util_TimerStart( UTIL_TIMER_LIGHT_SENSE, LED_SENSE_PERIOD_MS );
     }
   }
-  else  // right side
+  else if( Util_TimerExpired( UTIL_TIMER_LIGHT_SENSE ) )
   {
-    if( gau8LEDBrightness[ 6u ] > gu8PWMCounter )  // D3
+    if( LED_SenseRequest( LED_SENSE_MAX_TICKS ) )
     {
-      LL_GPIO_SetOutputPin( LED5 );
+      gbitAmbientPending = 1;
     }
     else
     {
-      LL_GPIO_ResetOutputPin( LED5 );
+      Util_TimerStart( UTIL_TIMER_LIGHT_SENSE, LED_SENSE_RETRY_MS );
     }
-    if( gau8LEDBrightness[ 7u ] > gu8PWMCounter )  // D9
+  }
+  if( !gbitAmbientPending )
+  {
+    u32Next = Util_TimerLeftMs( UTIL_TIMER_LIGHT_SENSE );
+  }
+  
+  return u32Next;
+}
+#endif
+
+#if LED_FAULT_CHECK
+//----------------------------------------------------------------------------
+//! \brief  Probes the LEDs one after the other, and drops the faulty ones from the frames
+//! \param  -
+//! \return Time until it has to be called again in ms; 0 while a result is awaited
+//! \global gu8FaultStep, gu8FaultLED, gu16FaultRefMv, gau16FaultSagMv[], gu8ProbeLED, gbitProbeRequest
+//! \note   Should be called from main cycle only! Every LED_FAULT_PERIOD_MS a round probes each
+//!         LED not faulty yet, one per LED_FAULT_STEP_MS: the supply of the dark segments is
+//!         converted first, then the one of the probe slots, which the interrupt inserts at every
+//!         period boundary until the conversions are done. The sag between them is the load of
+//!         the LED alone: an open LED takes no current, a shorted one, or a short of its common
+//!         pin, all the pins can give. Judged by JudgeRound() at the end of the round. A step
+//!         waits while the frame is dark, so a dark pause doesn't blink, and the stop mode runs.
+//-----------------------------------------------------------------------------
+U32 LED_FaultCheckCycle( void )
+{
+  U16 u16Sum;
+  U16 u16ProbeMv;
+  U32 u32Next = 0u;
+  
+  switch( gu8FaultStep )
+  {
+    case FAULT_REFERENCE:  // The supply is converted in the dark segments
+      if( Sensor_IsReady( SENSOR_BIT( SENSOR_VDD_DARK ) ) )
+      {
+        u16Sum = Sensor_GetSum( SENSOR_VDD_DARK );
+        gu16FaultRefMv = ( 0u != u16Sum ) ? SENSOR_MV( u16Sum ) : 0u;
+        gu8ProbeLED = gu8FaultLED;
+        gbitProbeRequest = 1;
+        Sensor_Request( SENSOR_BIT( SENSOR_VDD_PROBE ) );
+        gu8FaultStep = FAULT_PROBE;
+      }
+      break;
+    
+    case FAULT_PROBE:      // The supply is converted in the probe slots
+      if( Sensor_IsReady( SENSOR_BIT( SENSOR_VDD_PROBE ) ) )
+      {
+        gbitProbeRequest = 0;
+        u16Sum = Sensor_GetSum( SENSOR_VDD_PROBE );
+        u16ProbeMv = ( 0u != u16Sum ) ? SENSOR_MV( u16Sum ) : gu16FaultRefMv;
+        gau16FaultSagMv[ gu8FaultLED ] = ( gu16FaultRefMv > u16ProbeMv ) ? ( gu16FaultRefMv - u16ProbeMv ) : 0u;
+        gu8FaultLED = NextProbed( gu8FaultLED + 1u );
+        if( LEDS_NUM == gu8FaultLED )
+        {
+          JudgeRound();
+          Util_TimerStart( UTIL_TIMER_LED_FAULT, LED_FAULT_PERIOD_MS );
+        }
+        else
+        {
+          Util_TimerStart( UTIL_TIMER_LED_FAULT, LED_FAULT_STEP_MS );
+        }
+        gu8FaultStep = FAULT_WAIT;
+      }
+      break;
+    
+    default:  // FAULT_WAIT -- Waiting for the next probe
+      if( Util_TimerExpired( UTIL_TIMER_LED_FAULT ) )
+      {
+        if( LEDS_NUM == gu8FaultLED )
+        {
+          gu8FaultLED = NextProbed( 0u );  // a new round
+        }
+        if( ( LEDS_NUM == gu8FaultLED ) || LED_IsDark() )
+        {
+          Util_TimerStart( UTIL_TIMER_LED_FAULT, ( LEDS_NUM == gu8FaultLED ) ? LED_FAULT_PERIOD_MS : LED_FAULT_STEP_MS );
+        }
+        else
+        {
+          Sensor_Request( SENSOR_BIT( SENSOR_VDD_DARK ) );
+          gu8FaultStep = FAULT_REFERENCE;
+        }
+      }
+      if( FAULT_WAIT == gu8FaultStep )
+      {
+        u32Next = Util_TimerLeftMs( UTIL_TIMER_LED_FAULT );
+      }
+      break;
+  }
+  
+  return u32Next;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Gives the LEDs found faulty
+//! \param  -
+//! \return LED_BIT() of each LED found open or shorted since the boot, in the order of gau8LEDBrightness[]
+//! \global gu16Faults
+//-----------------------------------------------------------------------------
+U16 LED_GetFaults( void )
+{
+  return gu16Faults;
+}
+#endif
+
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+//----------------------------------------------------------------------------
+//! \brief  Interrupt routine to implement binary code modulation
+//! \param  -
+//! \return Number of TIM1 periods elapsed since the previous call
+//! \global gasSegments[][][], gau8SegmentCount[][], gu8PWMCounter, gu8Side, gu8NextSide, gu8LEDNextRGB, frame buffers
+//! \note   Should be called from the TIM1 update interrupt, which fires only at segment boundaries.
+//!         Each segment lasts 1..( LED_PWM_MAX + LED_BLANK_TICKS ) timer periods, using the repetition counter of TIM1.
+//!         The buffers are swapped when the next segment is preloaded at the end of a side, so the
+//!         preloaded segment and everything after it is taken from the same frame.
+//!         The side is switched break-before-make: every MPX pin goes high, the common pins of the
+//!         new side are written, then its MPX pin goes low, so no LED shows another side's levels.
+//!         With LED_ADAPTIVE_MPX the dark sides are skipped, see NextSide().
+//!         With LED_LIGHT_SENSE a requested measurement takes a dark slot between two periods.
+//!         With LED_DARK_SLOTS a segment without any LED or RGB output is told in gu8LEDDarkTicks:
+//!         the blanking slot, with the dark last plane merged into it.
+//!         With LED_FAULT_CHECK a probe requested takes a probe slot between two periods.
+//-----------------------------------------------------------------------------
+ISR_CODE U8 LED_Interrupt( void )
+{
+  U8  u8Elapsed;
+  BIT bitSwitch;
+  U8  u8Next;
+  U8  u8NextSide;
+  const S_LED_SEGMENT* psSegment;
+  
+  // The repetition counter has just been reloaded with the length of the segment starting now
+  u8Elapsed = gu8PlaneTicks;
+  gu8PlaneTicks = gu8NextPlaneTicks;
+#if LED_DARK_SLOTS
+  gu8LEDDarkTicks = 0u;
+#endif
+#if LED_LIGHT_SENSE
+  if( SENSE_IDLE != gu8SenseState )
+  {
+    // Dark slot, one timer period a call; the preloaded segment follows it
+    if( !SenseStep() )
     {
-      LL_GPIO_SetOutputPin( LED4 );
+      PreloadSegment();
     }
-    else
+    return u8Elapsed;
+  }
+#endif
+#if LED_FAULT_CHECK
+  gbitLEDProbeSlot = 0;
+  if( PROBE_IDLE != gu8ProbeState )
+  {
+    // Probe slot, one timer period a call; the preloaded segment follows it
+    if( !ProbeStep() )
     {
-      LL_GPIO_ResetOutputPin( LED4 );
+      PreloadSegment();
     }
-    if( gau8LEDBrightness[ 8u ] > gu8PWMCounter )  // D11
+    return u8Elapsed;
+  }
+#endif
+  
+  // Step to the segment preloaded by the previous call
+  gu8PWMCounter = gu8NextSegment;
+  bitSwitch = ( gu8NextSide != gu8Side );
+  if( bitSwitch )
+  {
+    gu8Side = gu8NextSide;
+    WRITE_REG( GPIOB->BSRR, LED_MASK_MPX );  // blank every side
+  }
+  // One write per port
+  psSegment = &gasSegments[ gu8FrontBuffer ][ gu8Side ][ gu8PWMCounter ];
+  WRITE_REG( GPIOA->BSRR, psSegment->u32GPIOA );
+  WRITE_REG( GPIOF->BSRR, psSegment->u32GPIOF );
+  if( bitSwitch )
+  {
+    WRITE_REG( GPIOB->BSRR, LED_MPX_PIN( gu8Side ) << 16u );  // light the new side
+  }
+#if LED_DARK_SLOTS
+  if( ( ( LED_MASK_GPIOA << 16u ) == psSegment->u32GPIOA ) && ( ( LED_MASK_GPIOF << 16u ) == psSegment->u32GPIOF ) && ( 0u == psSegment->u8RGB ) )
+  {
+    gu8LEDDarkTicks = gu8PlaneTicks;
+  }
+#endif
+  
+  // Preload the length of the next segment; it is loaded at the next update event
+  u8Next = gu8PWMCounter + 1u;
+  u8NextSide = gu8Side;
+  if( u8Next >= gau8SegmentCount[ gu8FrontBuffer ][ u8NextSide ] )
+  {
+    u8Next = 0u;
+    // Period boundary: show the new frame, if there's one and it is due
+    if( gbitFramePending && ( (I16)( (U16)gu32TimerMS - gu16FrameDueMs ) >= 0 ) )
     {
-      LL_GPIO_SetOutputPin( LED3 );
+      gu8FrontBuffer ^= 1u;
+      gbitFramePending = 0;
     }
-    else
+    u8NextSide = NextSide( gu8Side );
+  }
+  gu8NextSegment = u8Next;
+  gu8NextSide = u8NextSide;
+#if LED_LIGHT_SENSE
+  if( ( 0u == u8Next ) && gbitSenseRequest )
+  {
+    // The dark slot comes before the next period, the RGB LED is off during it
+    gbitSenseRequest = 0;
+    gu8SenseState = SENSE_START;
+    gu8LEDNextRGB = 0u;
+    gu8NextPlaneTicks = 1u;
+    LL_TIM_SetRepetitionCounter( TIM1, 0u );
+    return u8Elapsed;
+  }
+#endif
+#if LED_FAULT_CHECK
+  if( ( 0u == u8Next ) && gbitProbeRequest )
+  {
+    // The probe slot comes before the next period, the RGB LED is off during it
+    gu8ProbeState = PROBE_START;
+    gu8LEDNextRGB = 0u;
+    gu8NextPlaneTicks = 1u;
+    LL_TIM_SetRepetitionCounter( TIM1, 0u );
+    return u8Elapsed;
+  }
+#endif
+  PreloadSegment();
+  
+  return u8Elapsed;
+}
+#else
+//----------------------------------------------------------------------------
+//! \brief  Interrupt routine to implement soft-PWM
+//! \param  -
+//! \return Number of 100 us ticks elapsed since the previous call
+//! \global gau8LEDFrame[][], gau32StaticSet[][], gu8PWMCounter, gu8Side, frame buffers, gu8PlaneTicks, gu8LEDRGBThreshold
+//! \note   Should be called from periodic timer interrupt routine.
+//!         Every port is updated by a single BSRR write, so all edges of a port are simultaneous.
+//!         A side with only dark and full LEDs is written twice per period, without comparisons.
+//!         With LED_PWM_SPREAD the on-ticks of a level are spread over the period, see gcau8PWMOrder[].
+//!         With LED_PHASE_STAGGER every LED of a side takes them in its own phase, see gcau8PhaseOrder[].
+//!         With LED_RGB_SCHEDULE the RGB threshold of the tick is set for RGBLED_Interrupt().
+//!         The side is switched break-before-make: every MPX pin goes high, the common pins of the
+//!         new side are written, then its MPX pin goes low, so no LED shows another side's levels.
+//!         With LED_ADAPTIVE_MPX the dark sides are skipped, see NextSide().
+//!         With LED_LIGHT_SENSE a requested measurement takes a dark slot between two periods.
+//!         Every LED is dark in the last tick of a period, so the frame is swapped there, and the
+//!         next period is known one tick ahead. With LED_ADAPTIVE_TICKS the first LED_PWM_MAX
+//!         ticks of a static period are then one segment of the repetition counter, if the RGB LED
+//!         is dark: its ladder needs the ticks.
+//!         With LED_DARK_SLOTS the last tick is told in gu8LEDDarkTicks; only the RGB LED may pulse in it.
+//!         With LED_FAULT_CHECK a probe requested takes a probe slot between two periods.
+//-----------------------------------------------------------------------------
+ISR_CODE U8 LED_Interrupt( void )
+{
+  U8  u8Index;
+  U8  u8LED;
+  U8  u8Threshold;
+  U32 u32Set;
+  BIT bitSwitch = 0;
+  U8  u8Elapsed = 1u;
+  U8  u8NextSide;
+#if LED_ADAPTIVE_TICKS
+  U8  u8NextTicks;
+  
+  // The repetition counter has just been reloaded with the length of the segment starting now
+  u8Elapsed = gu8PlaneTicks;
+  gu8PlaneTicks = gu8NextPlaneTicks;
+#endif
+#if LED_DARK_SLOTS
+  gu8LEDDarkTicks = 0u;
+#endif
+  
+#if LED_LIGHT_SENSE
+  if( SENSE_IDLE != gu8SenseState )
+  {
+#if LED_RGB_SCHEDULE
+    gu8LEDRGBThreshold = PWM_LEVELS;  // above every RGB level: the RGB LED stays dark in the dark slot
+#endif
+    (void)SenseStep();
+    return 1u;
+  }
+#endif
+#if LED_FAULT_CHECK
+  gbitLEDProbeSlot = 0;
+  if( PROBE_IDLE != gu8ProbeState )
+  {
+#if LED_RGB_SCHEDULE
+    gu8LEDRGBThreshold = PWM_LEVELS;  // the RGB LED stays dark in the probe slot too
+#endif
+    (void)ProbeStep();
+    return 1u;
+  }
+#endif
+  gu8PWMCounter += u8Elapsed;
+  if( gu8PWMCounter == PWM_LEVELS )
+  {
+#if LED_LIGHT_SENSE
+#if LED_ADAPTIVE_TICKS
+    if( gbitSenseRequest && ( 1u == gu8PlaneTicks ) )  // the dark slot needs every tick, it waits for a period of them
+#else
+    if( gbitSenseRequest )
+#endif
     {
-      LL_GPIO_ResetOutputPin( LED3 );
+      // Dark slot first; the boundary is taken again after it
+      gbitSenseRequest = 0;
+      gu8PWMCounter = PWM_LEVELS - 1u;
+      gu8SenseState = SENSE_START;
+#if LED_RGB_SCHEDULE
+      gu8LEDRGBThreshold = PWM_LEVELS;
+#endif
+      (void)SenseStep();
+      return 1u;
     }
-    if( gau8LEDBrightness[ 9u ] > gu8PWMCounter )  // D7
+#endif
+#if LED_FAULT_CHECK
+#if LED_ADAPTIVE_TICKS
+    if( gbitProbeRequest && !gbitProbeTaken && ( 1u == gu8PlaneTicks ) )  // the probe slot needs every tick too
+#else
+    if( gbitProbeRequest && !gbitProbeTaken )
+#endif
     {
-      LL_GPIO_SetOutputPin( LED2 );
+      // Probe slot first; the boundary is taken again after it, without another one
+      gbitProbeTaken = 1;
+      gu8PWMCounter = PWM_LEVELS - 1u;
+      gu8ProbeState = PROBE_START;
+#if LED_RGB_SCHEDULE
+      gu8LEDRGBThreshold = PWM_LEVELS;
+#endif
+      (void)ProbeStep();
+      return 1u;
     }
-    else
+    gbitProbeTaken = 0;
+#endif
+    gu8PWMCounter = 0;
+    u8NextSide = NextSide( gu8Side );
+    if( u8NextSide != gu8Side )
     {
-      LL_GPIO_ResetOutputPin( LED2 );
+      gu8Side = u8NextSide;
+      bitSwitch = 1;
+      WRITE_REG( GPIOB->BSRR, LED_MASK_MPX );  // blank every side
     }
-    if( gau8LEDBrightness[ 10u ] > gu8PWMCounter )  // D5
+  }
+  
+#if LED_RGB_SCHEDULE
+  gu8LEDRGBThreshold = gau8RGBOrder[ gu8FrontBuffer ][ gu8PWMCounter ];
+#endif
+  
+  u32Set = gau32StaticSet[ gu8FrontBuffer ][ gu8Side ];
+  if( LED_SIDE_PWM == u32Set )
+  {
+#if !LED_PHASE_STAGGER
+#if LED_PWM_SPREAD
+    u8Threshold = gcau8PWMOrder[ gu8PWMCounter ];
+#else
+    u8Threshold = gu8PWMCounter;
+#endif
+#endif
+    // Collect the pins to be set
+    u32Set = 0u;
+    u8LED = LED_SIDE_FIRST( gu8Side );
+    for( u8Index = 0u; u8Index < LEDS_PER_SIDE; u8Index++ )
     {
-      LL_GPIO_SetOutputPin( LED1 );
+#if LED_PHASE_STAGGER
+      u8Threshold = gcau8PhaseOrder[ u8Index ][ gu8PWMCounter ];
+#endif
+      if( gau8LEDFrame[ gu8FrontBuffer ][ u8LED ] > u8Threshold )
+      {
+        u32Set |= gcau32LEDPinMask[ u8LED ];
+      }
+      u8LED++;
     }
-    else
+  }
+  else if( 0u != gu8PWMCounter )
+  {
+    if( LED_PWM_MAX != gu8PWMCounter )
     {
-      LL_GPIO_ResetOutputPin( LED1 );
+      return u8Elapsed;  // static side: the pins are already right
     }
-    if( gau8LEDBrightness[ 11u ] > gu8PWMCounter )  // D13
+    u32Set = 0u;  // full LEDs are dark in the last tick, its threshold is the highest in both orders
+  }
+  // BSRR: set bits in the low half, reset bits in the high half
+  WRITE_REG( GPIOA->BSRR, ( u32Set & 0xFFFFu ) | ( ( ~u32Set & LED_MASK_GPIOA ) << 16u ) );
+  WRITE_REG( GPIOF->BSRR, ( u32Set >> 16u ) | ( ( ~( u32Set >> 16u ) & LED_MASK_GPIOF ) << 16u ) );
+  if( bitSwitch )
+  {
+    WRITE_REG( GPIOB->BSRR, LED_MPX_PIN( gu8Side ) << 16u );  // light the new side
+  }
+  
+  if( LED_PWM_MAX == gu8PWMCounter )
+  {
+    // Last tick, dark in any frame: show the new frame from here, if there's one and it is due
+    if( gbitFramePending && ( (I16)( (U16)gu32TimerMS - gu16FrameDueMs ) >= 0 ) )
     {
-      LL_GPIO_SetOutputPin( LED0 );
+      gu8FrontBuffer ^= 1u;
+      gbitFramePending = 0;
     }
-    else
+#if LED_DARK_SLOTS
+    gu8LEDDarkTicks = 1u;
+#endif
+#if LED_ADAPTIVE_TICKS
+    // The side of the next period, as the boundary will choose it
+    u8NextSide = NextSide( gu8Side );
+    u8NextTicks = 1u;
+    if( ( LED_SIDE_PWM != gau32StaticSet[ gu8FrontBuffer ][ u8NextSide ] )
+     && ( 0u == ( gau8RGBLEDs[ 0u ] | gau8RGBLEDs[ 1u ] | gau8RGBLEDs[ 2u ] ) )
+#if LED_LIGHT_SENSE
+     && !gbitSenseRequest
+#endif
+#if LED_FAULT_CHECK
+     && !gbitProbeRequest
+#endif
+       )
     {
-      LL_GPIO_ResetOutputPin( LED0 );
+      u8NextTicks = LED_PWM_MAX;  // static: the pins change next at its last tick
     }
   }
+  else
+  {
+    u8NextTicks = 1u;
+  }
+  // Preload the length of the next segment; it is loaded at the next update event
+  if( u8NextTicks != gu8NextPlaneTicks )
+  {
+    gu8NextPlaneTicks = u8NextTicks;
+    LL_TIM_SetRepetitionCounter( TIM1, u8NextTicks - 1u );
+  }
+#else
+  }
+#endif
+  
+  return u8Elapsed;
 }
+#endif
 
 
 /***************************************< End of file >**************************************/
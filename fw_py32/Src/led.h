@@ -16,9 +16,123 @@
 
 /***************************************< Definitions >**************************************/
 #define LEDS_NUM               (12u)  //!< Number of LEDs driven by this driver
+#define LED_SIDES               (2u)  //!< Multiplexed sides of the board, each with its MPX pin, see the pin definitions in led.c; at most 8
+#define LEDS_PER_SIDE           ( LEDS_NUM / LED_SIDES )  //!< Number of LEDs lit at the same time, one on each common pin
+#define LED_SIDE_FIRST( side )  ( ( LED_SIDES - 1u - (side) ) * LEDS_PER_SIDE )  //!< First LED of a side in gau8LEDBrightness[]: the last side is the first part of the array
+
+// Driver modes
+#define LED_MODE_LADDER         (0u)  //!< Every LED is compared against the PWM counter on every 100 us tick
+#define LED_MODE_BITPLANE       (1u)  //!< Binary code modulation: precomputed bit-planes with binary weighted lengths
+#ifndef LED_DRIVER_MODE
+#define LED_DRIVER_MODE         (LED_MODE_BITPLANE)  //!< Selected driver mode
+#endif
+
+#define LED_BUFFERS             (2u)  //!< Front buffer is shown by the interrupt, back buffer is written by LED_Commit()
+#define LED_BRIGHTNESS_MAX     (15u)  //!< Maximal brightness level in gau8LEDBrightness[], as used by the animations
+#ifndef LED_PWM_BITS
+#define LED_PWM_BITS            (4u)  //!< Bits of brightness per LED in the driver, i.e. number of bit-planes
+#endif
+#define LED_PWM_MAX             ( ( 1u << LED_PWM_BITS ) - 1u )  //!< Maximal PWM level of the driver
+#ifndef LED_FAST_REFRESH
+#define LED_FAST_REFRESH        (0u)  //!< Bit-plane mode: 1: the animations with the FAST_REFRESH option, 2: every one, are refreshed LED_FAST_DIVIDER times faster, for cameras; 0: none
+#endif
+#define LED_FAST_DIVIDER        (8u)  //!< With LED_FAST_REFRESH: TIM1 periods of a bit-plane unit of the normal refresh, so the fast one is 2.5 kHz
+#define LED_TICK_DIVIDER        ( ( 1u << ( LED_PWM_BITS - 4u ) ) * ( LED_FAST_REFRESH ? LED_FAST_DIVIDER : 1u ) )  //!< TIM1 periods per 100 us tick
+
+#define LED_LOAD_FULL           ( LEDS_NUM * LED_PWM_MAX )  //!< Load of a frame with every LED at full brightness, see LED_GetLoad()
+#ifndef LED_LOAD_BUDGET
+#define LED_LOAD_BUDGET         ( LED_LOAD_FULL * 3u / 4u )  //!< Highest load of a frame, heavier frames are scaled down to it
+#endif
+#ifndef LED_SOFT_START_MS
+#define LED_SOFT_START_MS       (1000u)  //!< The budget ramps up from LED_SOFT_START_LOAD to LED_LOAD_BUDGET this long after LED_Init(); 0: no ramp
+#endif
+#ifndef LED_SOFT_START_LOAD
+#define LED_SOFT_START_LOAD     ( LED_LOAD_FULL / 4u )  //!< Budget of the first frame after LED_Init(), with LED_SOFT_START_MS
+#endif
+#define LED_SOFT_START_STEP_MS  (50u)  //!< A frame held back by the ramp is rebuilt this often, see LED_SoftStartCycle()
+#if LED_SOFT_START_MS && ( LED_SOFT_START_LOAD > LED_LOAD_BUDGET )
+#error "LED_SOFT_START_LOAD: the ramp starts above LED_LOAD_BUDGET!"
+#endif
+#define LED_DIM_FULL            (3u)  //!< Global brightness at full scale, each step below halves the light output
+
+#ifndef LED_GAMMA_CORRECTION
+#define LED_GAMMA_CORRECTION    ( LED_PWM_BITS > 4u )  //!< Gamma correction needs extra depth, otherwise dim levels merge
+#endif
+
+#ifndef LED_PWM_SPREAD
+#define LED_PWM_SPREAD          (1u)  //!< Ladder mode: on-ticks are spread evenly over the period instead of one block
+#endif
+#ifndef LED_PHASE_STAGGER
+#define LED_PHASE_STAGGER       (1u)  //!< Ladder mode: every common pin has its own PWM phase, so the lit LEDs of a side don't turn on in the same tick
+#endif
+#ifndef LED_RGB_SCHEDULE
+#define LED_RGB_SCHEDULE        (1u)  //!< Ladder mode: the RGB pulses take the ticks with the fewest LEDs lit, ranked by LED_Commit()
+#endif
+#ifndef LED_BLANK_TICKS
+#define LED_BLANK_TICKS         (1u)  //!< Bit-plane mode: dark TIM1 periods at the end of each side, before the multiplexer switches; 0: none
+#endif
+#define LED_SEGMENTS_MAX        ( LED_PWM_BITS + ( 0u != LED_BLANK_TICKS ) )  //!< Bit-plane mode: most segments of a side, the bit-planes and the blanking slot
+#ifndef LED_DARK_SLOTS
+#define LED_DARK_SLOTS          (1u)  //!< The interrupt tells the TIM1 periods of each dark segment in gu8LEDDarkTicks, for the dark conversions of the sensor service
+#endif
+#ifndef LED_ADAPTIVE_MPX
+#define LED_ADAPTIVE_MPX        (0u)  //!< A side lit alone keeps the multiplexer, a dark side is skipped: twice the duty
+#endif
+#ifndef LED_ADAPTIVE_TICKS
+#define LED_ADAPTIVE_TICKS      (0u)  //!< Ladder mode: a period of a static side takes two TIM1 interrupts instead of 16, see LED_Interrupt(); the bit-plane mode does it anyway
+#endif
+#ifndef LED_LIGHT_SENSE
+#define LED_LIGHT_SENSE         (0u)  //!< Ambient light is measured on a reverse-biased LED, the dark room dims everything
+#endif
+#ifndef LED_SENSE_PERIOD_MS
+#define LED_SENSE_PERIOD_MS     (5000u)  //!< Period of the ambient light measurements
+#endif
+#define LED_SENSE_RETRY_MS      (50u)    //!< Delay of the ambient light measurement if the sensor is busy
+#ifndef LED_SENSE_MAX_TICKS
+#define LED_SENSE_MAX_TICKS     ( 20u * LED_TICK_DIVIDER )  //!< Longest dark slot of a measurement in TIM1 periods: 2 ms
+#endif
+#ifndef LED_SENSE_DIM_TICKS
+#define LED_SENSE_DIM_TICKS     ( LED_SENSE_MAX_TICKS / 4u )  //!< A slower charge-up than this is a dim room: one step darker
+#endif
+#ifndef LED_FAULT_CHECK
+#define LED_FAULT_CHECK         (0u)  //!< Every LED is lit alone in short probe slots now and then, an open or shorted one is told by its sag of the supply, and left dark
+#endif
+#ifndef LED_FAULT_PERIOD_MS
+#define LED_FAULT_PERIOD_MS     (600000uL)  //!< A round of the fault check probes every LED this often: 10 minutes
+#endif
+#define LED_FAULT_START_MS      (10000u)  //!< The first round starts this long after LED_Init(), after the gauge and the soft start
+#define LED_FAULT_STEP_MS       (100u)    //!< The LEDs of a round are probed one after the other this often, while the frame has any LED lit
+#define LED_FAULT_MIN_MV        (20u)     //!< A round with its median sag below this tells nothing: the supply is too stiff, e.g. USB
+#define LED_FAULT_RATIO         (4u)      //!< An LED sagging the supply this many times less than the median is open, this many times more is shorted
+
+#if ( LED_PWM_BITS != 4u ) && ( LED_PWM_BITS != 6u )
+#error "LED_PWM_BITS: only 4 and 6 bits are supported!"
+#endif
+#if ( LED_DRIVER_MODE == LED_MODE_LADDER ) && ( LED_PWM_BITS != 4u )
+#error "LED_PWM_BITS: ladder mode supports 4 bits only!"
+#endif
+#if LED_FAST_REFRESH && ( ( LED_DRIVER_MODE != LED_MODE_BITPLANE ) || ( LED_PWM_BITS != 4u ) )
+#error "LED_FAST_REFRESH: the bit-plane mode of 4 bits only, the ladder interrupts every tick!"
+#endif
+#if LED_FAULT_CHECK && !LED_DARK_SLOTS
+#error "LED_FAULT_CHECK: the sag is taken against the supply of the dark segments, build it with LED_DARK_SLOTS"
+#endif
+#if LED_FAULT_CHECK && ( LEDS_NUM > 16u )
+#error "LED_FAULT_CHECK: the faults are a 16-bit mask, see LED_GetFaults()"
+#endif
 
 
 /***************************************< Types >**************************************/
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+//! \brief One segment of the LED waveform: one or more neighbouring bit-planes with the same output
+typedef struct
+{
+  U32 u32GPIOA;   //!< BSRR word of GPIOA
+  U32 u32GPIOF;   //!< BSRR word of GPIOF
+  U8  u8Ticks;    //!< Length of the segment in TIM1 periods
+  U8  u8RGB;      //!< Colors of the RGB LED to be pulsed: bit 0 red, bit 1 green, bit 2 blue
+} S_LED_SEGMENT;
+#endif
 
 
 /***************************************< Constants >**************************************/
@@ -26,11 +140,50 @@
 
 /***************************************< Global variables >**************************************/
 extern DATA U8 gau8LEDBrightness[ LEDS_NUM ];
+extern DATA U8 gu8LEDNextRGB;
+extern DATA U8 gu8LEDRGBThreshold;
+#if LED_DARK_SLOTS
+extern DATA U8 gu8LEDDarkTicks;
+#endif
+#if LED_FAULT_CHECK
+extern DATA BIT gbitLEDProbeSlot;
+#endif
 
 
 /***************************************< Public functions >**************************************/
 void LED_Init( void );
-void LED_Interrupt( void );
+void LED_Commit( void );
+void LED_CommitAt( U16 u16DueMs );
+BOOL LED_IsFramePending( void );
+BOOL LED_IsDark( void );
+BOOL LED_IsSolo( void );
+void LED_SoloOn( void );
+void LED_SoloOff( void );
+void LED_SetBrightness( U8 u8Level );
+void LED_SetBrightnessCap( U8 u8Cap );
+void LED_SetLoadBudget( U16 u16Budget );
+void LED_SetTrims( const U8* pu8Trims );
+void LED_SetTemperature( I8 i8Celsius );
+void LED_SetPlanDim( U8 u8Dim );
+U16  LED_GetLoad( void );
+U32  LED_TakeLoadMs( void );
+#if LED_FAST_REFRESH
+void LED_SetFastRefresh( BOOL bFast );
+void LED_SetFastRefreshAlways( BOOL bAlways );
+#endif
+#if LED_SOFT_START_MS
+U32  LED_SoftStartCycle( void );
+#endif
+#if LED_LIGHT_SENSE
+BOOL LED_SenseRequest( U8 u8MaxTicks );
+U8   LED_SenseResult( void );
+U32  LED_LightSenseCycle( void );
+#endif
+#if LED_FAULT_CHECK
+U32  LED_FaultCheckCycle( void );
+U16  LED_GetFaults( void );
+#endif
+ISR_CODE U8 LED_Interrupt( void );
 
 
 #endif /* LED_H */
@@ -15,6 +15,7 @@
 
 // Own includes
 #include "main.h"
+#include "py32f0xx_it.h"
 #include "types.h"
 #include "util.h"
 #include "led.h"
@@ -22,49 +23,118 @@
 #include "animation.h"
 #include "persist.h"
 #include "batterylevel.h"
+#include "sensor.h"
+#include "upload.h"
+#include "sync.h"
+#include "bus.h"
+#include "button.h"
+#include "stats.h"
+#include "schedule.h"
+#include "runtime.h"
+#include "stream.h"
 
 
 /***************************************< Definitions >**************************************/
-#warning "Port to PY32F002!"
-#define BUTTON_PIN     (u8ButtonPin)  //!< Button for selecting animation and turning it off and on
+#define IDLE_MIN_MS    (5u)           //!< Shortest dark period worth stopping TIM1 for
+#define PLAYLIST_ALL   ( ( 1uL << ( NUM_ANIMATIONS - 1u ) ) - 1u )  //!< Playlist bits of the selectable animations
+#define OPTION_HOLD_MS (3000u)        //!< Holding the button this long on power up toggles the battery gauge
+#define SCHEDULE_HOLD_MS (6000u)      //!< Holding it this long undoes that, and toggles the schedule instead
+#ifndef AUTO_CYCLE_MIN
+#define AUTO_CYCLE_MIN (10u)          //!< The auto-cycle mode steps to the next animation of the playlist this often
+#endif
+#ifndef TEST_CYCLE_S
+#define TEST_CYCLE_S   (0u)           //!< Test build for tools/current_profile.py: every animation in turn from the first, this many s each; 0: off
+#endif
+#define TASK_MAX_MS    (0x40000000uL) //!< Longest time a task is left alone, also without a deadline of its own
+#define EVENT_QUEUE_LEN (8u)          //!< Entries of the event queue, a power of 2
 
 
 /***************************************< Types >**************************************/
+//! \brief Parking of the pins of a port in the stop mode, see ParkPins()
+typedef struct
+{
+  GPIO_TypeDef* psPort;   //!< The port
+  U16 u16PullDown;        //!< Pins parked as inputs with pull-down
+  U16 u16Low;             //!< Pins parked as low outputs
+  U16 u16Keep;            //!< Pins left as they are; every other one is analog
+} S_PARK_PORT;
 
 
 /***************************************< Constants >**************************************/
+//! \brief Pin parking of each port in the stop mode, from the PARK_x defines of main.h
+static const S_PARK_PORT gcasParkPorts[] =
+{
+  { GPIOA, PARK_PULLDOWN_GPIOA, PARK_LOW_GPIOA, BUTTON_GPIO_PIN | LL_GPIO_PIN_13 | LL_GPIO_PIN_14 },
+  { GPIOB, PARK_PULLDOWN_GPIOB, PARK_LOW_GPIOB, 0u },
+  { GPIOF, PARK_PULLDOWN_GPIOF, PARK_LOW_GPIOF, 0u }
+};
 
 
 /***************************************< Global variables >**************************************/
-//! \brief State machine for button debouncing
-static enum
-{
-  BUTTON_UNPRESSED,  //!< The button is not pressed
-  BUTTON_BOUNCING,   //!< The button just got pressed and it's currently bouncing
-  BUTTON_PRESSED,    //!< The button got debounced
-  BUTTON_LONGPRESS,  //!< The button has been pressed for long
-  BUTTON_RELEASING   //!< The button just got released and it's currently bouncing
-} geButtonState;
-
-static U16 gu16ButtonPressTimer;  //!< Timer for the button debouncing state machine
+static U8   gu8CurrentAnimation = 0u;  //!< Index of the animation played, selected by the button
+static BOOL gbPressedLong = FALSE;     //!< The button was pressed for long: power down on release
+static BOOL gbFadingOut = FALSE;       //!< The power-down signal is fading out, UTIL_TIMER_AUTO_OFF times it; the save is written
+static U8   gu8PowerSource = BATTERY_SOURCE_COIN;  //!< Power source the auto-off has been started for, see TaskBattery()
+static U8   gu8ClickAnimation;         //!< Animation played before the first click of a series
+static U8   gu8TapAnimation;           //!< Animation played before the first tap of a tap tempo
+#if STREAM_ENABLE
+static BOOL gbStreaming = FALSE;       //!< A host drives the LEDs with frames, the VM stands still, see TaskAnimation()
+#endif
+static U32  gau32TaskDeadline[ MAIN_NUM_TASKS ];  //!< When each task is due; all are due in the first cycle
+static U8   gu8TasksWoken;              //!< Bit of each task due in the next cycle, whatever its deadline
+static volatile U8  gau8EventQueue[ EVENT_QUEUE_LEN ];  //!< Tasks woken by the interrupts, see Main_PostEvent()
+static volatile U8  gu8EventHead;       //!< Free running count of the events posted; written by the interrupts only
+static volatile U8  gu8EventTail;       //!< Free running count of the events taken; written by Main_Cycle() only
+static volatile BIT gbitEventOverflow;  //!< An event didn't fit in the queue: every task is woken
 
 
 /***************************************< Static function definitions >**************************************/
 static void APP_SystemClockConfig( void );
-static void PowerDown( void );
+static void ParkPins( void );
+static void PowerDown( BOOL bWakeOnSchedule );
+static void StartFadeOut( void );
+static void ResumeAnimation( void );
+static void TicklessIdle( U16 u16Ms, BOOL bSolo );
+#if TICK_IN_THREAD
+static void WaitTicks( U16 u16Ms );
+#endif
+static void StartAutoOff( void );
+static void StartAutoCycle( void );
+static U8   NextAnimation( U8 u8Animation );
+static void TogglePlaylist( U8 u8Animation );
+#if UPLOAD_ENABLE
+static void TakeTrims( const U8* pu8Trims );
+#endif
+static U32  AnimationFrame( void );
+static U32  TaskButton( void );
+static U32  TaskPersist( void );
+static U32  TaskBattery( void );
+static U32  TaskLightSense( void );
+static U32  TaskLEDFault( void );
+static U32  TaskClockCal( void );
+static U32  TaskAnimation( void );
+static U32  TaskSync( void );
+
+//! \brief The tasks of the main cycle, indexed by E_MAIN_TASK; each returns the time until it is due again in ms
+static U32 (* const gcapfTasks[ MAIN_NUM_TASKS ])( void ) =
+{
+  TaskButton, TaskPersist, TaskBattery, TaskLightSense, TaskLEDFault, TaskClockCal, TaskAnimation, TaskSync
+};
 
 
 /***************************************< Private functions >**************************************/
 //----------------------------------------------------------------------------
-//! \brief  Initialize 24 MHz HSI system clock
+//! \brief  Initialize HSI system clock, SYSCLK_MHZ
 //! \param  -
 //! \return -
+//! \note   The workload is a 10 kHz interrupt and a ms-rate animation VM, so the clock is kept low
+//!         for lower active current. TIM1 and the ADC follow SYSCLK_MHZ by themselves.
 //-----------------------------------------------------------------------------
 static void APP_SystemClockConfig( void )
 {
   /* 使能HSI */
   LL_RCC_HSI_Enable();
-  LL_RCC_HSI_SetCalibFreq(LL_RCC_HSICALIBRATION_24MHz);
+  LL_RCC_HSI_SetCalibFreq(SYSCLK_HSI_CALIBRATION);
   while(LL_RCC_HSI_IsReady() != 1)
   {
   }
@@ -83,31 +153,93 @@ static void APP_SystemClockConfig( void )
   //LL_Init1msTick(24000000);
   
   /* 更新系统时钟全局变量SystemCoreClock(也可以通过调用SystemCoreClockUpdate函数更新) */
-  LL_SetSystemCoreClock(24000000);
+  LL_SetSystemCoreClock(SYSCLK_MHZ * 1000000uL);
 }
 
 //----------------------------------------------------------------------------
-//! \brief  Enter deep sleep mode with peripherials set to low-current mode
+//! \brief  Parks the pins for the stop mode, as given by gcasParkPorts[]
 //! \param  -
 //! \return -
+//! \global -
+//! \note   One write per register of each port. The output level and the pulls are set before the
+//!         mode, so a pin never drives high or floats on the way. A pin spreads its 2 bits over MODER
+//!         and PUPDR: the mask of a pin set is multiplied out, as in Util_GPIO_Init().
 //-----------------------------------------------------------------------------
-static void PowerDown( void )
+static void ParkPins( void )
 {
-  // Gradually disable stuff and enter deep sleep
+  const S_PARK_PORT* psPark;
+  U32 u32Keep2;
+  U32 u32PullDown2;
+  U32 u32Low2;
+  U8  u8Pin;
+  
+  for( psPark = gcasParkPorts; psPark < &gcasParkPorts[ sizeof( gcasParkPorts ) / sizeof( gcasParkPorts[ 0 ] ) ]; psPark++ )
+  {
+    u32Keep2 = 0u;
+    u32PullDown2 = 0u;
+    u32Low2 = 0u;
+    for( u8Pin = 0u; u8Pin < 16u; u8Pin++ )
+    {
+      if( psPark->u16Keep & ( 1u << u8Pin ) )
+      {
+        u32Keep2 |= 0x3uL << ( 2u * u8Pin );
+      }
+      else if( psPark->u16PullDown & ( 1u << u8Pin ) )
+      {
+        u32PullDown2 |= 0x3uL << ( 2u * u8Pin );
+      }
+      else if( psPark->u16Low & ( 1u << u8Pin ) )
+      {
+        u32Low2 |= 0x3uL << ( 2u * u8Pin );
+      }
+    }
+    psPark->psPort->BRR = psPark->u16Low;
+    CLEAR_BIT( psPark->psPort->OTYPER, psPark->u16Low );
+    MODIFY_REG( psPark->psPort->PUPDR, ~u32Keep2, ( u32PullDown2 / 0x3u ) * LL_GPIO_PULL_DOWN );
+    MODIFY_REG( psPark->psPort->MODER, ~u32Keep2, ( ~( u32Keep2 | u32PullDown2 | u32Low2 ) & ( LL_GPIO_MODE_ANALOG * 0x55555555uL ) )
+                                                | ( u32Low2 / 0x3u ) * LL_GPIO_MODE_OUTPUT );
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Enter stop mode with peripherials set to low-current mode, until the button is pressed
+//! \param  bWakeOnSchedule: with PERSIST_OPTION_SCHEDULE the next run of the schedule wakes it up too
+//! \return -
+//! \global -
+//! \note   Returns after wakeup with the LED drivers restarted, and the button taken as held
+//!         for long, so the press that has woken it up doesn't change the animation on release.
+//!         A wakeup by the button starts the schedule over from now.
+//-----------------------------------------------------------------------------
+static void PowerDown( BOOL bWakeOnSchedule )
+{
+  BOOL bScheduled = FALSE;
+#if STATS_RESIDENCY
+  U32  u32Start;
+#endif
+  
+  // Write the pending save first, unless StartFadeOut() has done it already
+#if STATS_ENABLE
+  if( !gbFadingOut )
+  {
+    Stats_Suspend();
+  }
+#endif
+  Persist_Flush();
+  gbFadingOut = FALSE;
+  
+  // Gradually disable stuff
   LL_APB1_GRP1_EnableClock( LL_APB1_GRP1_PERIPH_PWR );
-  DISABLE_IT;
   NVIC_DisableIRQ( TIM1_BRK_UP_TRG_COM_IRQn );
   LL_TIM_DisableCounter( TIM1 );
   LL_TIM_DisableAllOutputs( TIM1 );
   LL_APB1_GRP2_DisableClock( LL_APB1_GRP2_PERIPH_TIM1 );
-  LL_GPIO_DeInit( GPIOA );
-  LL_GPIO_DeInit( GPIOB );
-  LL_GPIO_DeInit( GPIOF );
-//  LL_GPIO_SetPinPull( GPIOA, LL_GPIO_PIN_ALL, LL_GPIO_PULL_DOWN );
-//  LL_GPIO_SetPinPull( GPIOB, LL_GPIO_PIN_ALL, LL_GPIO_PULL_DOWN );
-//  LL_GPIO_SetPinPull( GPIOF, LL_GPIO_PIN_ALL, LL_GPIO_PULL_DOWN );
-#warning "Enable EXTI on button line!"
-  LL_IOP_GRP1_DisableClock( LL_IOP_GRP1_PERIPH_GPIOA );
+  // Park the pins, analog by default: no current through the LEDs or the input buffers
+  LL_IOP_GRP1_EnableClock( LL_IOP_GRP1_PERIPH_GPIOA | LL_IOP_GRP1_PERIPH_GPIOB | LL_IOP_GRP1_PERIPH_GPIOF );
+  ParkPins();
+  Button_Init();  // except the button, it stays an input with pullup, waking up by EXTI
+#if BUS_ENABLE
+  LL_EXTI_DisableIT( BUS_EXTI_LINE );  // parked with the rest
+#endif
   LL_IOP_GRP1_DisableClock( LL_IOP_GRP1_PERIPH_GPIOB );
   LL_IOP_GRP1_DisableClock( LL_IOP_GRP1_PERIPH_GPIOF );
   LL_PWR_EnableLowPowerRunMode();
@@ -116,10 +248,675 @@ static void PowerDown( void )
   LL_PWR_SetWakeUpFlashDelay( LL_PWR_WAKEUP_FLASH_DELAY_0US );
   LL_PWR_SetWakeUpLPToVRReadyTime( LL_PWR_WAKEUP_LP_TO_VR_READY_5US );
   LL_LPM_DisableEventOnPend();
-  LL_LPM_EnableDeepSleep();
-  SET_BIT( SCB->SCR, SCB_SCR_SLEEPDEEP_Msk );
-  __WFI();
-  NVIC_SystemReset();  // This should not be reached...
+  
+  // Stop mode until the button gets pressed, releases and bounces are slept through
+#if STATS_RESIDENCY
+  u32Start = Util_GetTimerMs32();  // the global timer runs in the sleeps of the schedule only
+#endif
+#if SCHEDULE_ENABLE
+  if( bWakeOnSchedule && ( gsPersistentData.u8Options & PERSIST_OPTION_SCHEDULE ) )
+  {
+    bScheduled = Schedule_Sleep();
+  }
+  else
+#else
+  (void)bWakeOnSchedule;
+#endif
+  {
+    LL_LPM_EnableDeepSleep();
+    do
+    {
+      __WFI();
+    } while( 1 == BUTTON_PIN );
+    LL_LPM_EnableSleep();
+  }
+#if STATS_RESIDENCY
+  Stats_Stopped( STATS_POWER_OFF, Util_GetTimerMs32() - u32Start );
+#endif
+  
+  // Restart the LED drivers, the system clock is HSI again after wakeup, just like before
+  LED_Init();
+#if SYNC_ENABLE
+  Sync_Init();
+#endif
+#if BUS_ENABLE
+  Bus_Init();
+#endif
+#if STREAM_ENABLE
+  Stream_Init();
+  gbStreaming = FALSE;  // the animation starts over anyway
+#endif
+  RGBLED_Init();
+  LED_SetBrightness( gsPersistentData.u8Brightness );
+#if UTIL_PROBES
+  Util_ProbeInit();
+#endif
+  LL_TIM_EnableIT_UPDATE( TIM1 );
+  NVIC_EnableIRQ( TIM1_BRK_UP_TRG_COM_IRQn );
+  
+  // Start over
+#if STATS_ENABLE
+  Stats_Resume();
+#endif
+#if RUNTIME_PLAN
+  Runtime_Resume();
+#endif
+  if( !bScheduled )
+  {
+#if SCHEDULE_ENABLE
+    Schedule_Start();
+#endif
+    Button_SetHeld();
+  }
+  StartAutoOff();
+  StartAutoCycle();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Starts the power-down signal: the frame shown fades out, PowerDown() follows at its end
+//! \param  -
+//! \return -
+//! \global gu8CurrentAnimation, gbFadingOut
+//! \note   The fade is played by the VM in real time, whatever the playback rate; meanwhile the
+//!         save of the session is written, so the power-down doesn't take any time after it.
+//!         UTIL_TIMER_AUTO_OFF times the fade, TaskButton() powers down when it expires.
+//-----------------------------------------------------------------------------
+static void StartFadeOut( void )
+{
+#if ANIMATION_RESUME
+  if( !gbFadingOut )
+  {
+    Animation_Suspend();  // the wake-up goes on from here
+  }
+#endif
+  gu8CurrentAnimation = NUM_ANIMATIONS-1u;
+  Animation_SetSpeed( 0u );
+  Animation_Set( gu8CurrentAnimation );
+  Util_TimerStart( UTIL_TIMER_AUTO_OFF, ANIMATION_FADE_OUT_MS );
+  if( !gbFadingOut )
+  {
+#if STATS_ENABLE
+    Stats_Suspend();
+#endif
+    Persist_Flush();  // while the LEDs are still fading
+    gbFadingOut = TRUE;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Continues with the saved animation, after a power-down or instead of it
+//! \param  -
+//! \return -
+//! \global gu8CurrentAnimation, gbFadingOut, gsPersistentData
+//! \note   A fade-out given up restarts the auto-off time too.
+//-----------------------------------------------------------------------------
+static void ResumeAnimation( void )
+{
+  if( gbFadingOut )
+  {
+    gbFadingOut = FALSE;
+    StartAutoOff();
+  }
+  Animation_SetSpeed( ( gsPersistentData.u8Options & PERSIST_OPTION_SPEED ) >> PERSIST_OPTION_SPEED_SHIFT );
+  gu8CurrentAnimation = gsPersistentData.u8AnimationIndex;
+  Animation_Set( gu8CurrentAnimation );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Stops the 10 kHz timer and sleeps in stop mode until the next animation event
+//! \param  u16Ms: time until the next animation event
+//! \param  bSolo: TRUE to hold the single LED of the frame lit by its pins meanwhile, see LED_SoloOn()
+//! \return -
+//! \note   All LEDs must be dark, as multiplexing stops, or with bSolo, only one lit. That is how a
+//!         BEACON animation blinks: both its blink and the dark time in between are spent in stop mode.
+//-----------------------------------------------------------------------------
+static void TicklessIdle( U16 u16Ms, BOOL bSolo )
+{
+#if STATS_RESIDENCY
+  U32 u32Start = Util_GetTimerMs32();
+#endif
+  
+  UTIL_TRACE_EVENT( UTIL_TRACE_SLEEP, ( u16Ms > 0xFFu ) ? 0xFFu : u16Ms );
+  LL_TIM_DisableCounter( TIM1 );
+  NVIC_DisableIRQ( TIM1_BRK_UP_TRG_COM_IRQn );
+  if( bSolo )
+  {
+    LED_SoloOn();
+  }
+  Util_Sleep( u16Ms );
+  Button_Woken();
+  if( bSolo )
+  {
+    LED_SoloOff();
+  }
+#if STATS_RESIDENCY
+  Stats_Stopped( STATS_POWER_STOP, Util_GetTimerMs32() - u32Start );
+#endif
+  NVIC_EnableIRQ( TIM1_BRK_UP_TRG_COM_IRQn );
+  LL_TIM_EnableCounter( TIM1 );
+  UTIL_TRACE_EVENT( UTIL_TRACE_WAKEUP, 0u );
+}
+
+#if TICK_IN_THREAD
+//----------------------------------------------------------------------------
+//! \brief  Sleeps until the next deadline or event, running the TIM1 ticks in thread mode meanwhile
+//! \param  u16Ms: time until the next deadline
+//! \return -
+//! \global gu8EventHead, gu8EventTail, gbitEventOverflow
+//! \note   The TIM1 interrupt is disabled in the NVIC while waiting, it only gets pending. With
+//!         SEVONPEND that wakes WFE up, and its handler is called here, without the stacking of an
+//!         exception entry, and without a pass of Main_Cycle() for every tick. The interrupts of the
+//!         events still run as usual; their exception entry wakes WFE up too, so none is missed.
+//!         The tasks run with the TIM1 interrupt enabled, so they never delay the LED drivers.
+//-----------------------------------------------------------------------------
+static void WaitTicks( U16 u16Ms )
+{
+  U32 u32Deadline = Util_GetTimerMs32() + u16Ms;
+  
+  LL_LPM_EnableEventOnPend();  // PowerDown() turns it off
+  NVIC_DisableIRQ( TIM1_BRK_UP_TRG_COM_IRQn );
+  while( !Util_IsDeadlineReached( u32Deadline ) && ( gu8EventTail == gu8EventHead ) && !gbitEventOverflow )
+  {
+    STATS_WFE();
+    if( NVIC_GetPendingIRQ( TIM1_BRK_UP_TRG_COM_IRQn ) )
+    {
+      TIM1_BRK_UP_TRG_COM_IRQHandler();
+      NVIC_ClearPendingIRQ( TIM1_BRK_UP_TRG_COM_IRQn );  // after the flag has been cleared, or it pends again
+    }
+  }
+  NVIC_EnableIRQ( TIM1_BRK_UP_TRG_COM_IRQn );
+}
+#endif
+
+//----------------------------------------------------------------------------
+//! \brief  Starts the automatic power-down timer with the saved duration
+//! \param  -
+//! \return -
+//! \global gsPersistentData
+//! \note   A unit on the USB supply doesn't power down by itself.
+//-----------------------------------------------------------------------------
+static void StartAutoOff( void )
+{
+  if( ( 0u != gsPersistentData.u16AutoOffMin ) && ( BATTERY_SOURCE_USB != BatteryLevel_GetSource() ) )
+  {
+    Util_TimerStart( UTIL_TIMER_AUTO_OFF, (U32)gsPersistentData.u16AutoOffMin * 60000u );
+  }
+  else
+  {
+    Util_TimerStop( UTIL_TIMER_AUTO_OFF );
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Starts the timer of the next auto-cycle step, if the mode is on
+//! \param  -
+//! \return -
+//! \global gsPersistentData
+//! \note   Called after every change of the animation, so a step always lasts AUTO_CYCLE_MIN.
+//!         A TEST_CYCLE_S build steps by TEST_CYCLE_S, whatever the mode. With RUNTIME_PLAN the
+//!         plan is made for the new animation, and its step is weighted by its current.
+//-----------------------------------------------------------------------------
+static void StartAutoCycle( void )
+{
+#if TEST_CYCLE_S
+  Util_TimerStart( UTIL_TIMER_AUTO_CYCLE, TEST_CYCLE_S * 1000uL );
+#elif RUNTIME_PLAN
+  U32 u32StepMs = Runtime_StepMs( AUTO_CYCLE_MIN * 60000uL );
+  
+  if( gsPersistentData.u8Options & PERSIST_OPTION_AUTO_CYCLE )
+  {
+    Util_TimerStart( UTIL_TIMER_AUTO_CYCLE, u32StepMs );
+  }
+  else
+  {
+    Util_TimerStop( UTIL_TIMER_AUTO_CYCLE );
+  }
+#else
+  if( gsPersistentData.u8Options & PERSIST_OPTION_AUTO_CYCLE )
+  {
+    Util_TimerStart( UTIL_TIMER_AUTO_CYCLE, AUTO_CYCLE_MIN * 60000uL );
+  }
+  else
+  {
+    Util_TimerStop( UTIL_TIMER_AUTO_CYCLE );
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells the next animation of the playlist
+//! \param  u8Animation: the current animation
+//! \return Index of the next animation
+//! \global gsPersistentData
+//! \note   An empty playlist plays all the animations, except the last one of the table; so does
+//!         a TEST_CYCLE_S build.
+//-----------------------------------------------------------------------------
+static U8 NextAnimation( U8 u8Animation )
+{
+  U32 u32Playlist = gsPersistentData.u32Playlist & PLAYLIST_ALL;
+  
+  if( ( 0u == u32Playlist ) || ( 0u != TEST_CYCLE_S ) )
+  {
+    u32Playlist = PLAYLIST_ALL;
+  }
+  do
+  {
+    u8Animation++;
+    if( u8Animation >= NUM_ANIMATIONS-1u )
+    {
+      u8Animation = 0u;
+    }
+  } while( 0u == ( u32Playlist & ( 1uL << u8Animation ) ) );
+  
+  return u8Animation;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Adds an animation to the playlist, or removes it from there
+//! \param  u8Animation: index of the animation
+//! \return -
+//! \global gsPersistentData
+//! \note   Removing the last favorite empties the playlist, which plays all of them again.
+//-----------------------------------------------------------------------------
+static void TogglePlaylist( U8 u8Animation )
+{
+  U32 u32Playlist = gsPersistentData.u32Playlist & PLAYLIST_ALL;
+  
+  if( 0u == u32Playlist )
+  {
+    u32Playlist = PLAYLIST_ALL;
+  }
+  u32Playlist ^= ( 1uL << u8Animation );
+  if( PLAYLIST_ALL == u32Playlist )
+  {
+    u32Playlist = 0u;
+  }
+  gsPersistentData.u32Playlist = u32Playlist;
+}
+
+#if UPLOAD_ENABLE
+//----------------------------------------------------------------------------
+//! \brief  Saves the trims of the LEDs brought by an upload
+//! \param  pu8Trims: trims of the uploaded image, from Upload_GetTrims(); NULL if it has none
+//! \return -
+//! \global gsPersistentData
+//! \note   Saved at once, and only if they have changed, so the next image without trims keeps them.
+//-----------------------------------------------------------------------------
+static void TakeTrims( const U8* pu8Trims )
+{
+  if( ( NULL != pu8Trims ) && ( 0 != memcmp( gsPersistentData.au8LEDTrim, pu8Trims, LEDS_NUM ) ) )
+  {
+    memcpy( gsPersistentData.au8LEDTrim, pu8Trims, LEDS_NUM );
+    Persist_Save();
+  }
+}
+#endif
+
+//----------------------------------------------------------------------------
+//! \brief  Task of the button: the actions of the gestures; auto-off and auto-cycle
+//! \param  -
+//! \return Time until it is due again in ms
+//! \global gu8CurrentAnimation, gu8ClickAnimation, gu8TapAnimation, gbPressedLong, gsPersistentData
+//! \note   Only the timers make it due, and the edges of the button by its EXTI.
+//-----------------------------------------------------------------------------
+static U32 TaskButton( void )
+{
+  E_BUTTON_GESTURE eGesture;
+  U32 u32Next;
+  U32 u32Left;
+#if RUNTIME_PLAN
+  U8  u8Tries;
+#endif
+  
+#if STATS_ENABLE
+  Stats_Account();  // the time so far goes to the animation played until now
+#endif
+  // Check uptime: fade out first, then power down at the end of the fade
+  if( Util_TimerExpired( UTIL_TIMER_AUTO_OFF ) )
+  {
+    if( !gbFadingOut )
+    {
+      StartFadeOut();
+    }
+    else if( Button_IsIdle() )  // a long press still held powers down on its release, or holding on gives it up
+    {
+      // Go to power-down sleep, then continue with the saved animation
+      PowerDown( TRUE );
+      gbPressedLong = FALSE;
+      ResumeAnimation();
+    }
+  }
+  
+  // Auto-cycle mode: next animation of the playlist, unless the button is in use or it is fading out; it isn't saved
+  // With RUNTIME_PLAN the ones the plan doesn't afford are skipped, as long as any other one is affordable
+  if( Util_TimerExpired( UTIL_TIMER_AUTO_CYCLE ) )
+  {
+    if( Button_IsIdle() && !gbFadingOut )
+    {
+      gu8CurrentAnimation = NextAnimation( gu8CurrentAnimation );
+#if RUNTIME_PLAN
+      for( u8Tries = 1u; ( u8Tries < NUM_ANIMATIONS ) && !Runtime_Affords( gu8CurrentAnimation ); u8Tries++ )
+      {
+        gu8CurrentAnimation = NextAnimation( gu8CurrentAnimation );
+      }
+#endif
+      Animation_Set( gu8CurrentAnimation );
+    }
+    StartAutoCycle();
+  }
+  
+  // Gestures of the button; a click given during the fade-out of the auto-off keeps the unit on
+  eGesture = Button_Cycle();
+  if( gbFadingOut && !gbPressedLong && ( ( ( eGesture >= BUTTON_CLICK ) && ( eGesture <= BUTTON_HOLD_1S ) ) || ( BUTTON_TAP_TEMPO == eGesture ) ) )
+  {
+    ResumeAnimation();
+  }
+  switch( eGesture )
+  {
+    case BUTTON_CLICK:         // Next animation of the playlist
+      if( 1u == Button_GetTaps() )
+      {
+        gu8TapAnimation = gu8CurrentAnimation;
+      }
+      gu8ClickAnimation = gu8CurrentAnimation;
+      gu8CurrentAnimation = NextAnimation( gu8CurrentAnimation );
+      Animation_Set( gu8CurrentAnimation );
+      StartAutoCycle();
+      Persist_SaveLater();  // save it, when the user has stopped clicking
+      break;
+    
+    case BUTTON_DOUBLE_CLICK:  // Back to the animation of the first click, and toggle the auto-cycle mode
+      gsPersistentData.u8Options ^= PERSIST_OPTION_AUTO_CYCLE;
+      gu8CurrentAnimation = gu8ClickAnimation;
+      Animation_Set( gu8CurrentAnimation );
+      StartAutoCycle();
+      Persist_SaveLater();
+      break;
+    
+    case BUTTON_TRIPLE_CLICK:  // Undo the auto-cycle toggle, and add the animation to the playlist or remove it
+      gsPersistentData.u8Options ^= PERSIST_OPTION_AUTO_CYCLE;
+      TogglePlaylist( gu8ClickAnimation );
+      StartAutoCycle();
+      Persist_SaveLater();
+      break;
+    
+    case BUTTON_QUADRUPLE_CLICK:  // Undo the playlist toggle, and step the playback rate of the animations
+      TogglePlaylist( gu8ClickAnimation );
+      gsPersistentData.u8Options = (U8)( ( gsPersistentData.u8Options & ~PERSIST_OPTION_SPEED )
+                                       | ( ( ( ( gsPersistentData.u8Options >> PERSIST_OPTION_SPEED_SHIFT ) + 1u ) % ANIMATION_SPEEDS ) << PERSIST_OPTION_SPEED_SHIFT ) );
+      Animation_SetSpeed( ( gsPersistentData.u8Options & PERSIST_OPTION_SPEED ) >> PERSIST_OPTION_SPEED_SHIFT );
+      Persist_SaveLater();
+      break;
+    
+    case BUTTON_TAP_TEMPO:     // Back to the animation of the first tap, played to the beat; the beat isn't saved
+      if( gu8TapAnimation != gu8CurrentAnimation )
+      {
+        gu8CurrentAnimation = gu8TapAnimation;
+        Animation_Set( gu8CurrentAnimation );
+        StartAutoCycle();
+        Persist_SaveLater();
+      }
+      Animation_SetBeat( Button_GetBeatMs() );
+      break;
+    
+    case BUTTON_HOLD_1S:       // Night mode on, or back to full brightness
+      if( 0u == gsPersistentData.u8Brightness )
+      {
+        gsPersistentData.u8Brightness = PERSIST_BRIGHTNESS_FULL;
+      }
+      else
+      {
+        gsPersistentData.u8Brightness = 0u;
+      }
+      LED_SetBrightness( gsPersistentData.u8Brightness );
+      Persist_SaveLater();
+      break;
+    
+    case BUTTON_HOLD_2S:       // Long press: power down on release
+      // Signal that it will be shut down by fading out, the save is written meanwhile
+      StartFadeOut();
+      gbPressedLong = TRUE;
+      break;
+    
+    case BUTTON_HOLD_4S:       // Held on after the long press
+      // Step the global brightness downwards, from the night mode back to full, instead of shutting down
+      if( 0u == gsPersistentData.u8Brightness )
+      {
+        gsPersistentData.u8Brightness = PERSIST_BRIGHTNESS_FULL;
+      }
+      else
+      {
+        gsPersistentData.u8Brightness--;
+      }
+      LED_SetBrightness( gsPersistentData.u8Brightness );
+      gbPressedLong = FALSE;
+      ResumeAnimation();
+      Persist_SaveLater();
+      break;
+    
+    case BUTTON_RELEASE_LONG:  // Power down, at once if the fade-out has ended, otherwise at its end
+      if( ( TRUE == gbPressedLong ) && ( UTIL_TIMER_NONE == Util_TimerLeftMs( UTIL_TIMER_AUTO_OFF ) ) )
+      {
+        PowerDown( TRUE );
+        gbPressedLong = FALSE;
+        ResumeAnimation();
+      }
+      break;
+    
+    default:  // BUTTON_NONE
+      break;
+  }
+  
+  u32Next = Util_TimerLeftMs( UTIL_TIMER_BUTTON );
+  u32Left = Util_TimerLeftMs( UTIL_TIMER_AUTO_OFF );
+  if( u32Left < u32Next )
+  {
+    u32Next = u32Left;
+  }
+  u32Left = Util_TimerLeftMs( UTIL_TIMER_AUTO_CYCLE );
+  if( u32Left < u32Next )
+  {
+    u32Next = u32Left;
+  }
+  
+  return u32Next;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Task of the deferred save
+//! \param  -
+//! \return Time until it is due again in ms
+//-----------------------------------------------------------------------------
+static U32 TaskPersist( void )
+{
+  Persist_Cycle();
+  
+  return Util_TimerLeftMs( UTIL_TIMER_PERSIST );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Task of the battery indicator and the background samples
+//! \param  -
+//! \return Time until it is due again in ms
+//! \note   The end of the conversions wakes it up by the ADC interrupt. A depleted cell powers
+//!         down before its brown-out, with the pending save written. The auto-off follows the
+//!         power source once it is told, unless the fade-out is timed already. The runtime plan
+//!         follows the charge meter here.
+//-----------------------------------------------------------------------------
+static U32 TaskBattery( void )
+{
+  U32 u32Next;
+#if RUNTIME_PLAN
+  U32 u32Left;
+#endif
+  
+  if( BatteryLevel_Cycle() )
+  {
+    // Go to power-down sleep, then continue with the saved animation, like after the auto-off; the schedule can't wake a dead cell
+#if ANIMATION_RESUME
+    Animation_Suspend();
+#endif
+    PowerDown( FALSE );
+    ResumeAnimation();
+  }
+  if( ( gu8PowerSource != BatteryLevel_GetSource() ) && !gbFadingOut )
+  {
+    gu8PowerSource = BatteryLevel_GetSource();
+    StartAutoOff();
+  }
+  u32Next = Util_TimerLeftMs( UTIL_TIMER_BATTERY );
+#if RUNTIME_PLAN
+  u32Left = Runtime_Cycle();
+  if( u32Left < u32Next )
+  {
+    u32Next = u32Left;
+  }
+#endif
+  
+  return u32Next;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Task of the ambient light measurements
+//! \param  -
+//! \return Time until it is due again in ms
+//-----------------------------------------------------------------------------
+static U32 TaskLightSense( void )
+{
+#if LED_LIGHT_SENSE
+  return LED_LightSenseCycle();
+#else
+  return UTIL_TIMER_NONE;
+#endif
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Task of the LED fault check
+//! \param  -
+//! \return Time until it is due again in ms
+//! \note   Polled every ms while a probe converts: it keeps the main cycle out of the stop mode,
+//!         the probe slots need TIM1.
+//-----------------------------------------------------------------------------
+static U32 TaskLEDFault( void )
+{
+#if LED_FAULT_CHECK
+  return LED_FaultCheckCycle();
+#else
+  return UTIL_TIMER_NONE;
+#endif
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Task of the clock calibration
+//! \param  -
+//! \return Time until it is due again in ms
+//! \note   The end of a window wakes it up by the LPTIM interrupt, its timer is stopped meanwhile.
+//-----------------------------------------------------------------------------
+static U32 TaskClockCal( void )
+{
+#if UTIL_CLOCK_CAL
+  Util_ClockCalCycle();
+  
+  return Util_TimerLeftMs( UTIL_TIMER_CLOCK_CAL );
+#else
+  return UTIL_TIMER_NONE;
+#endif
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Runs the animation VM for a frame
+//! \param  -
+//! \return Time until the next frame in ms: until the next instruction, or the next ms during a fade;
+//!         sooner for the next step of the soft start of the LEDs
+//! \global -
+//-----------------------------------------------------------------------------
+static U32 AnimationFrame( void )
+{
+  U32 u32Next;
+#if LED_SOFT_START_MS
+  U32 u32Soft;
+#endif
+#if UTIL_PROFILING
+  U32 u32ProfileStart = Util_ProfileStart();
+  
+  UTIL_PROBE_HIGH( PROBE_ANIMATION_PIN );
+  Animation_Cycle();
+  UTIL_PROBE_LOW( PROBE_ANIMATION_PIN );
+  Util_ProfileEnd( UTIL_PROFILE_ANIMATION, u32ProfileStart );
+#else
+  UTIL_PROBE_HIGH( PROBE_ANIMATION_PIN );
+  Animation_Cycle();
+  UTIL_PROBE_LOW( PROBE_ANIMATION_PIN );
+#endif
+  u32Next = Animation_GetIdleMs();
+#if LED_SOFT_START_MS
+  // A frame held back by the soft start of the LEDs is rebuilt with the growing budget, while the
+  // animation stands still: the rebuilt frame is taken long before the next instruction
+  if( u32Next >= LED_SOFT_START_STEP_MS )
+  {
+    u32Soft = LED_SoftStartCycle();
+    if( u32Soft < u32Next )
+    {
+      u32Next = u32Soft;
+    }
+  }
+#endif
+  
+  return u32Next;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Task of the animation VM
+//! \param  -
+//! \return Time until it is due again in ms: until the next instruction, or the next ms during a fade;
+//!         sooner for the next step of the soft start of the LEDs
+//! \global gbStreaming, gu8CurrentAnimation, gbFadingOut
+//! \note   With STREAM_ENABLE the frames of a host take the place of the VM, until the stream
+//!         stops; the power-down signal is still played by the VM.
+//-----------------------------------------------------------------------------
+static U32 TaskAnimation( void )
+{
+  U32 u32Next;
+#if STREAM_ENABLE
+  
+  if( !gbFadingOut && Stream_Cycle() )  // woken by each frame received
+  {
+    gbStreaming = TRUE;
+    u32Next = Util_TimerLeftMs( UTIL_TIMER_STREAM );
+  }
+  else
+  {
+    if( gbStreaming )  // the stream has stopped, or the fade-out takes over: the VM starts over
+    {
+      gbStreaming = FALSE;
+      Animation_Set( gu8CurrentAnimation );
+    }
+    u32Next = AnimationFrame();
+  }
+#else
+  u32Next = AnimationFrame();
+#endif
+  
+  return u32Next;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Task of the phase lock, optical or by wire
+//! \param  -
+//! \return Time until it is due again in ms
+//! \global gu8CurrentAnimation, gbFadingOut
+//! \note   Runs after every animation cycle too, to see the start of each round. Woken by the EXTI
+//!         of the bus too. A follower of the bus plays the animation of the master, it isn't saved.
+//-----------------------------------------------------------------------------
+static U32 TaskSync( void )
+{
+#if SYNC_ENABLE
+  return Sync_Cycle();
+#elif BUS_ENABLE
+  return gbFadingOut ? UTIL_TIMER_NONE : Bus_Cycle( &gu8CurrentAnimation );
+#else
+  return UTIL_TIMER_NONE;
+#endif
 }
 
 
@@ -131,172 +928,269 @@ static void PowerDown( void )
 //-----------------------------------------------------------------------------
 void main( void )
 {
-  U32  u32UptimeCounter = 0u;
-  U16  u16LastCall = 0u;
-  U8   u8CurrentAnimation = 0u;
-  BOOL bPressedLong = FALSE;
+  U8   u8HeldTicks = 0u;
+  BOOL bPowerOn;
 
   // Initialize system clock
   APP_SystemClockConfig();
   
-  // Initialize modules
+#if UPLOAD_ENABLE
+  // Take a new animation, while the ISP pins are still free
+  Upload_Run();
+#endif
+  // Stage 1: the timebase, the LED drivers and the VM, then the first frame at once
   Util_Init();
+#if UTIL_PROBES
+  Util_ProbeInit();
+#endif
   LED_Init();
+#if SYNC_ENABLE
+  Sync_Init();
+#endif
   RGBLED_Init();
   Animation_Init();
+#if UPLOAD_ENABLE
+  Animation_SetUploaded( Upload_GetImage() );
+#endif
+  // The start of the boot sweep; if the gauge is skipped, the saved animation fades in from it
+  Animation_PlayBoot();
+  
+  // Start TIM1 update interrupts
+  LL_TIM_EnableIT_UPDATE( TIM1 );
+  NVIC_SetPriority( TIM1_BRK_UP_TRG_COM_IRQn, IRQ_PRIORITY_LED );
+  NVIC_EnableIRQ( TIM1_BRK_UP_TRG_COM_IRQn );
+  Util_WaitUntil( Util_GetTimerMs32() + 1u );  // the VM steps on elapsed time only
+  Animation_Cycle();
+#if UTIL_PROFILING
+  Util_ProfileEnd( UTIL_PROFILE_BOOT, SysTick_LOAD_RELOAD_Msk );  // SysTick has been counting down since Util_Init()
+#endif
+  
+  // Stage 2: the saved state and the battery, while the LEDs are already driven
+  // A power-on or a brown-out has changed the cell; the watchdog, the software and the pin resets
+  // haven't, they go on with the animation at once. Stats_Init() takes the flags, and clears them.
+  bPowerOn = ( 0u != LL_RCC_IsActiveFlag_PWRRST() );
   Persist_Init();
+#if STATS_ENABLE
+  Stats_Init();
+#else
+  LL_RCC_ClearResetFlags();  // so the cause of the next reset is told alone
+#endif
+#if UPLOAD_ENABLE
+  TakeTrims( Upload_GetTrims( Upload_GetImage() ) );
+#endif
+  LED_SetTrims( gsPersistentData.au8LEDTrim );
+  Sensor_Init();
   BatteryLevel_Init();
+#if RUNTIME_PLAN
+  Runtime_Init();
+#endif
+  LED_SetBrightness( gsPersistentData.u8Brightness );
+  Animation_SetSpeed( ( gsPersistentData.u8Options & PERSIST_OPTION_SPEED ) >> PERSIST_OPTION_SPEED_SHIFT );
 
-  // Pushbutton @ P3.2 --> bidirectional with pullup
-  // NOTE: this might not the best in terms of power consumption, but the input mode with pullup was not enough
-#warning "Port to PY32F002!"
-  /*
-  P3M0 &= ~(1u<<2u);  // 0
-  P3M1 &= ~(1u<<2u);  // 0
-  P3PU |= 1u<<2u;
-  */
-  U8 u8ButtonPin = 1u;
+  // Pushbutton @ PA4 --> input with pullup, EXTI on both edges
+  Button_Init();
+#if BUS_ENABLE
+  Bus_Init();
+#endif
+#if STREAM_ENABLE
+  Stream_Init();
+#endif
   
   // Init global variables in this module
-  geButtonState = BUTTON_UNPRESSED;
-  gu16ButtonPressTimer = 0u;
-  u8CurrentAnimation = gsPersistentData.u8AnimationIndex;
-  
-  // Start TIM1 update interrupts
-  LL_TIM_EnableIT_UPDATE( TIM1 );
-  NVIC_EnableIRQ( TIM1_BRK_UP_TRG_COM_IRQn );
+  StartAutoOff();
+  StartAutoCycle();
+  gu8CurrentAnimation = gsPersistentData.u8AnimationIndex;
 
   // Wait if the button is pressed on power up
   // This is necessary, to avoid changing animation on power on
+  // If it is held for long, the battery gauge gets turned on or off; even longer, the schedule instead
   while( 0 == BUTTON_PIN )
   {
-    gu16ButtonPressTimer = Util_GetTimerMs() + 100u;  // 100 ms wait
-    while( gu16ButtonPressTimer > Util_GetTimerMs() );
+    Util_WaitUntil( Util_GetTimerMs32() + 100u );  // 100 ms wait
+    u8HeldTicks++;
+    if( ( OPTION_HOLD_MS / 100u ) == u8HeldTicks )
+    {
+      gsPersistentData.u8Options ^= PERSIST_OPTION_SKIP_GAUGE;
+      Persist_Save();
+    }
+#if SCHEDULE_ENABLE
+    if( ( SCHEDULE_HOLD_MS / 100u ) == u8HeldTicks )
+    {
+      gsPersistentData.u8Options ^= PERSIST_OPTION_SKIP_GAUGE | PERSIST_OPTION_SCHEDULE;
+      Persist_Save();
+    }
+#endif
   }
+#if SCHEDULE_ENABLE
+  Schedule_Start();  // the first run starts now
+#endif
 
-  // Measure and show battery level
-  BatteryLevel_Show();
+  // Measure and show battery level, without blocking
+  if( gu8CurrentAnimation >= NUM_ANIMATIONS-1u )
+  {
+    gu8CurrentAnimation = 0u;
+    gsPersistentData.u8AnimationIndex = 0u;
+  }
+#if TEST_CYCLE_S
+  gu8CurrentAnimation = 0u;  // the profile starts with the first animation, after the gauge
+  gsPersistentData.u8AnimationIndex = 0u;
+#endif
+  BatteryLevel_Show( bPowerOn );
     
+#if SLEEP_ON_EXIT
+  // From now on only interrupts run, the main cycle is raised through PendSV when something is due
+  NVIC_SetPriority( PendSV_IRQn, IRQ_PRIORITY_CYCLE );  // every interrupt preempts the main cycle, just like the main loop
+  SCB->SCR |= SCB_SCR_SLEEPONEXIT_Msk;
+  SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;  // first cycle
+  while( TRUE )
+  {
+    __WFI();  // never returns to thread mode
+  }
+#else
   // Main loop
   while( TRUE )
   {
-#warning "ˇˇFIXME: delete"
-    static U16 u16LastPushMs = 5000u;
-    if( Util_GetTimerMs() > u16LastPushMs )
+    Main_Cycle();
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------
+//! \brief  One cycle of the main program: runs the tasks that are due, then sleeps until the next one
+//! \param  -
+//! \return -
+//! \global gau32TaskDeadline[], gu8TasksWoken, the event queue
+//! \note   Called by the main loop, or with SLEEP_ON_EXIT from PendSV_Handler() only.
+//!         Returns after sleeping, or with SLEEP_ON_EXIT after arming the next wakeup.
+//!         A task is due at its deadline, or when it has been woken by an event; once one
+//!         has run, the ones after it run too, as it may have changed their input (e.g. Animation_Set()).
+//!         A wakeup with nothing due, like most of the TIM1 interrupts, goes back to sleep at once.
+//-----------------------------------------------------------------------------
+void Main_Cycle( void )
+{
+  U8   u8Task;
+  BOOL bRun = FALSE;
+  BOOL bSolo;
+  U32  u32Delay;
+  U32  u32IdleMs = TASK_MAX_MS;
+  I32  i32Left;
+  
+  // Take the events of the interrupts
+  if( gbitEventOverflow )
+  {
+    gbitEventOverflow = FALSE;  // before the wakeup, so an overflow meanwhile isn't lost
+    gu8TasksWoken = ( 1u << MAIN_NUM_TASKS ) - 1u;
+  }
+  while( gu8EventTail != gu8EventHead )
+  {
+    gu8TasksWoken |= 1u << gau8EventQueue[ gu8EventTail % EVENT_QUEUE_LEN ];
+    gu8EventTail++;  // the entry may be reused from now on
+  }
+  
+  for( u8Task = 0u; u8Task < MAIN_NUM_TASKS; u8Task++ )
+  {
+    if( bRun || ( gu8TasksWoken & ( 1u << u8Task ) ) || Util_IsDeadlineReached( gau32TaskDeadline[ u8Task ] ) )
     {
-      if( Util_GetTimerMs() < u16LastPushMs + 100u )
+      bRun = TRUE;
+      gu8TasksWoken &= ~( 1u << u8Task );  // before the task, so it can wake itself again
+      UTIL_TRACE_EVENT( UTIL_TRACE_TASK, u8Task );
+      u32Delay = gcapfTasks[ u8Task ]();
+      if( 0u == u32Delay )
       {
-        u8ButtonPin = 0;
+        u32Delay = 1u;  // nothing changes within a ms
       }
-      else
+      else if( u32Delay > TASK_MAX_MS )
       {
-        // release
-        u8ButtonPin = 1;
-        u16LastPushMs = Util_GetTimerMs() + 5000;
+        u32Delay = TASK_MAX_MS;
       }
+      gau32TaskDeadline[ u8Task ] = Util_GetTimerMs32() + u32Delay;
     }
-    
-    // Increment uptime counter
-    if( Util_GetTimerMs() < u16LastCall )
+    // The earliest deadline
+    i32Left = (I32)( gau32TaskDeadline[ u8Task ] - Util_GetTimerMs32() );
+    if( i32Left < 0 )
     {
-      u32UptimeCounter += (U32)( 65535u - u16LastCall + Util_GetTimerMs() + 1u );
+      i32Left = 0;
     }
-    else
+    if( (U32)i32Left < u32IdleMs )
     {
-      u32UptimeCounter += (U32)( Util_GetTimerMs() - u16LastCall );
+      u32IdleMs = (U32)i32Left;
     }
-    u16LastCall = Util_GetTimerMs();
-    if( u32UptimeCounter >= 18000000u )  // turn off after 5 hours = 5*60*60*1000 msec
-    {
-      // Go to power-down sleep
-      PowerDown();
-    }
-    
-    // Debounce button in a nonblocking way
-    switch( geButtonState )
-    {
-      case BUTTON_BOUNCING:   // The button just got pressed and it's currently bouncing
-        if( Util_GetTimerMs() == gu16ButtonPressTimer )  // the debounce timer has just went off
-        {
-          if( 0 == BUTTON_PIN )  // if the button is still pressed
-          {
-            gu16ButtonPressTimer = Util_GetTimerMs() + 2000u;  // 2 sec long press
-            geButtonState = BUTTON_PRESSED;
-          }
-          else  // not pressed anymore
-          {
-            geButtonState = BUTTON_UNPRESSED;
-          }
-        }
-        break;
-      
-      case BUTTON_PRESSED:    // The button got debounced
-        if( 1 == BUTTON_PIN )  // just got released
-        {
-          gu16ButtonPressTimer = Util_GetTimerMs() + 50u;  // 50 ms debounce time
-          geButtonState = BUTTON_RELEASING;
-          // Actions for short button press
-          u8CurrentAnimation++;
-          if( u8CurrentAnimation >= NUM_ANIMATIONS-1u )
-          {
-            u8CurrentAnimation = 0u;
-          }
-          Animation_Set( u8CurrentAnimation );
-          // Save it
-          Persist_Save();
-        }
-        else if( Util_GetTimerMs() == gu16ButtonPressTimer )  // the long press timer has just went off
-        {
-          geButtonState = BUTTON_LONGPRESS;
-          // Actions for long button press
-          // Signal that it will be shut down by setting a completely black animation
-          u8CurrentAnimation = NUM_ANIMATIONS-1u;
-          Animation_Set( u8CurrentAnimation );
-          bPressedLong = TRUE;
-        }
-        break;
-      
-      case BUTTON_LONGPRESS:  // The button has been pressed for long
-        if( 1 == BUTTON_PIN )  // just got released
-        {
-          gu16ButtonPressTimer = Util_GetTimerMs() + 50u;  // 50 ms debounce time
-          geButtonState = BUTTON_RELEASING;
-        }
-        break;
-      
-      case BUTTON_RELEASING:  // The button just got released and it's currently bouncing
-        if( Util_GetTimerMs() == gu16ButtonPressTimer )  // the debounce timer has just went off
-        {
-          if( 1 == BUTTON_PIN )  // if the button is released
-          {
-            gu16ButtonPressTimer = Util_GetTimerMs() + 2000u;  // 2 sec long press
-            geButtonState = BUTTON_UNPRESSED;
-            
-            if( TRUE == bPressedLong )
-            {
-              PowerDown();
-              bPressedLong = FALSE;
-            }
-          }
-          else  // still pushed
-          {
-            gu16ButtonPressTimer = Util_GetTimerMs() + 50u;  // 50 ms debounce time
-          }
-        }
-        break;
-      
-      default:  // BUTTON_UNPRESSED -- The button is not pressed
-        if( 0 == BUTTON_PIN )  // if the button has just got pressed
-        {
-          gu16ButtonPressTimer = Util_GetTimerMs() + 50u;  // 50 ms debounce time
-          geButtonState = BUTTON_BOUNCING;
-        }
-        break;
-    }
-    Animation_Cycle();
-    // Sleep until next interrupt
-    __WFI();  // Wait for interrupt instruction
   }
+  if( ( 0u != gu8TasksWoken ) || ( gu8EventTail != gu8EventHead ) || gbitEventOverflow )
+  {
+    u32IdleMs = 0u;  // woken meanwhile
+  }
+  else if( u32IdleMs > 0xFFFFu )
+  {
+    u32IdleMs = 0xFFFFu;
+  }
+  
+  // Sleep until the next deadline; the interrupts of the events wake up earlier
+  bSolo = Animation_IsBeacon() && LED_IsSolo();
+#if BUS_ENABLE
+  if( ( u32IdleMs >= IDLE_MIN_MS ) && ( bSolo || LED_IsDark() ) && !Bus_IsFollower() )  // the edges of the bus are stamped by the ms timer
+#elif STREAM_ENABLE
+  if( ( u32IdleMs >= IDLE_MIN_MS ) && ( bSolo || LED_IsDark() ) && !gbStreaming )  // the USART doesn't receive in stop mode
+#else
+  if( ( u32IdleMs >= IDLE_MIN_MS ) && ( bSolo || LED_IsDark() ) )
+#endif
+  {
+    TicklessIdle( (U16)u32IdleMs, bSolo );
+#if SLEEP_ON_EXIT
+    Util_WakeAfter( 0u );  // whatever has woken it up is handled by the next cycle
+#endif
+  }
+  else
+  {
+#if SLEEP_ON_EXIT
+    Util_WakeAfter( (U16)u32IdleMs );  // the ISR that ends the wait pends the next cycle
+#elif TICK_IN_THREAD
+    WaitTicks( (U16)u32IdleMs );
+#else
+    STATS_WFI();  // Wait for interrupt instruction
+#endif
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Makes a task due in the next cycle, whatever its deadline
+//! \param  eTask: the task
+//! \return -
+//! \global gu8TasksWoken
+//! \note   Should be called from the tasks only! The interrupts use Main_PostEvent().
+//-----------------------------------------------------------------------------
+void Main_Wake( E_MAIN_TASK eTask )
+{
+  gu8TasksWoken |= 1u << eTask;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Posts an event of an interrupt: the task is due in the next cycle, whatever its deadline
+//! \param  eTask: the task handling the event
+//! \return -
+//! \global gau8EventQueue[], gu8EventHead, gbitEventOverflow
+//! \note   Should be called from the interrupts of IRQ_PRIORITY_EVENT only! They don't preempt each
+//!         other, so the queue has a single producer, and Main_Cycle() is the single consumer: each
+//!         index is written by one side only, no lock is needed. With SLEEP_ON_EXIT it pends the
+//!         main cycle too.
+//-----------------------------------------------------------------------------
+void Main_PostEvent( E_MAIN_TASK eTask )
+{
+  if( (U8)( gu8EventHead - gu8EventTail ) < EVENT_QUEUE_LEN )
+  {
+    gau8EventQueue[ gu8EventHead % EVENT_QUEUE_LEN ] = (U8)eTask;
+    gu8EventHead++;  // the entry is complete, the main cycle may take it
+  }
+  else
+  {
+    gbitEventOverflow = TRUE;
+  }
+#if SLEEP_ON_EXIT
+  if( SCB->SCR & SCB_SCR_SLEEPONEXIT_Msk )  // not during the init block
+  {
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+  }
+#endif
 }
 
 
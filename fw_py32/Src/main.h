@@ -40,6 +40,7 @@ extern "C" {
 #include "py32f0xx_ll_gpio.h"
 #include "py32f0xx_ll_tim.h"
 #include "py32f0xx_ll_adc.h"
+#include "py32f0xx_ll_lptim.h"
 
 #if defined(USE_FULL_ASSERT)
 #include "py32_assert.h"
@@ -47,12 +48,117 @@ extern "C" {
 
 /* Private includes ----------------------------------------------------------*/
 /* Exported types ------------------------------------------------------------*/
+//! \brief Tasks of the main cycle, in the order they run, see Main_Cycle()
+typedef enum
+{
+  MAIN_TASK_BUTTON = 0u,   //!< Button, auto-off and auto-cycle; woken by the EXTI of the button
+  MAIN_TASK_PERSIST,       //!< Deferred save
+  MAIN_TASK_BATTERY,       //!< Battery indicator and background samples; woken by the ADC
+  MAIN_TASK_LIGHT_SENSE,   //!< Ambient light measurements (LED_LIGHT_SENSE)
+  MAIN_TASK_LED_FAULT,     //!< LED fault check (LED_FAULT_CHECK)
+  MAIN_TASK_CLOCK_CAL,     //!< Clock calibration (UTIL_CLOCK_CAL); woken by the LPTIM
+  MAIN_TASK_ANIMATION,     //!< Animation VM
+  MAIN_TASK_SYNC,          //!< Phase lock (SYNC_ENABLE or BUS_ENABLE), after the animation
+  MAIN_NUM_TASKS           //!< Number of tasks
+} E_MAIN_TASK;
+
 /* Exported constants --------------------------------------------------------*/
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions prototypes ---------------------------------------------*/
 void Error_Handler(void);
+void Main_Cycle( void );
+void Main_Wake( E_MAIN_TASK eTask );
+void Main_PostEvent( E_MAIN_TASK eTask );
 
 /* Private defines -----------------------------------------------------------*/
+#define BUTTON_GPIO_PORT   GPIOA                //!< Port of the pushbutton
+#define BUTTON_GPIO_PIN    LL_GPIO_PIN_4        //!< Pin of the pushbutton, active low
+#define BUTTON_EXTI_PORT   LL_EXTI_CONFIG_PORTA //!< EXTI source port of the pushbutton
+#define BUTTON_EXTI_CONFIG LL_EXTI_CONFIG_LINE4 //!< EXTI source line of the pushbutton
+#define BUTTON_EXTI_LINE   LL_EXTI_LINE_4       //!< EXTI line of the pushbutton
+#define BUTTON_EXTI_IRQn   EXTI4_15_IRQn        //!< Interrupt of the pushbutton, see EXTI4_15_IRQHandler()
+#define BUTTON_PIN         ( LL_GPIO_IsInputPinSet( BUTTON_GPIO_PORT, BUTTON_GPIO_PIN ) ? 1u : 0u )  //!< Level of the pushbutton: 0 when pressed
+#define UPLOAD_GPIO_PORT   GPIOA                //!< Port of the ISP UART, shared with the LEDs
+#define UPLOAD_TX_GPIO_PIN LL_GPIO_PIN_2        //!< USART1 TX of the ISP UART
+#define UPLOAD_RX_GPIO_PIN LL_GPIO_PIN_3        //!< USART1 RX of the ISP UART
+#define UPLOAD_GPIO_AF     LL_GPIO_AF_1         //!< Alternate function of USART1 on the ISP pins
+
+// Pins of the debug probes (UTIL_PROBES) as port and pin number, spare on the board; a variant may
+// define its own. The default ones take SWD away, so the timing is measured without a debugger.
+#ifndef PROBE_LED_IRQ_PIN
+#define PROBE_LED_IRQ_PIN   A,13                //!< High during TIM1_BRK_UP_TRG_COM_IRQHandler(); SWDIO
+#endif
+#ifndef PROBE_LED_PIN
+#define PROBE_LED_PIN       A,14                //!< High during LED_Interrupt(); SWCLK
+#endif
+#ifndef PROBE_RGBLED_PIN
+#define PROBE_RGBLED_PIN    A,5                 //!< High during RGBLED_Interrupt()
+#endif
+#ifndef PROBE_ANIMATION_PIN
+#define PROBE_ANIMATION_PIN A,10                //!< High during Animation_Cycle()
+#endif
+
+// Pin parking in the stop mode, see PowerDown(): the pins of each port parked as inputs with pull-down,
+// or as low outputs; the rest is analog, the reset state. A variant may define its own, measured on
+// its board. The button and SWD (PA13, PA14) are left as they are.
+#ifndef PARK_PULLDOWN_GPIOA
+#define PARK_PULLDOWN_GPIOA (0x0000u)           //!< GPIOA pins parked as inputs with pull-down
+#endif
+#ifndef PARK_LOW_GPIOA
+#define PARK_LOW_GPIOA      (0x0000u)           //!< GPIOA pins parked as low outputs
+#endif
+#ifndef PARK_PULLDOWN_GPIOB
+#define PARK_PULLDOWN_GPIOB (0x0000u)           //!< GPIOB pins parked as inputs with pull-down
+#endif
+#ifndef PARK_LOW_GPIOB
+#define PARK_LOW_GPIOB      (0x0000u)           //!< GPIOB pins parked as low outputs, e.g. MPX1 and MPX2 (0x0003)
+#endif
+#ifndef PARK_PULLDOWN_GPIOF
+#define PARK_PULLDOWN_GPIOF (0x0000u)           //!< GPIOF pins parked as inputs with pull-down
+#endif
+#ifndef PARK_LOW_GPIOF
+#define PARK_LOW_GPIOF      (0x0000u)           //!< GPIOF pins parked as low outputs
+#endif
+
+// Interrupt priorities, 0 is the highest
+#define IRQ_PRIORITY_LED   (0u)                 //!< TIM1: pin updates of the LED drivers, nothing may delay them
+#define IRQ_PRIORITY_TIME  (1u)                 //!< SysTick: the global timer with UTIL_SYSTICK_MS, a few cycles a ms
+#define IRQ_PRIORITY_EVENT (2u)                 //!< Button, ADC and LPTIM: short, not time-critical
+#define IRQ_PRIORITY_CYCLE (3u)                 //!< PendSV: the main cycle with SLEEP_ON_EXIT, the lowest
+
+#ifndef ISR_IN_RAM
+#define ISR_IN_RAM         (0u)                 //!< 1: the TIM1 interrupt path runs from RAM; compare with UTIL_PROFILING
+#endif
+#if ISR_IN_RAM
+#define ISR_CODE           RAMFUNC              //!< Placement of the functions of the TIM1 interrupt path
+#else
+#define ISR_CODE
+#endif
+
+#ifndef SLEEP_ON_EXIT
+#define SLEEP_ON_EXIT      (0u)                 //!< 1: only interrupts run after init, the main cycle is raised by PendSV
+#endif
+#ifndef TICK_IN_THREAD
+#define TICK_IN_THREAD     (0u)                 //!< 1: while the main loop waits, it takes the TIM1 ticks itself through WFE, without exception entry
+#endif
+#if SLEEP_ON_EXIT && TICK_IN_THREAD
+#error "TICK_IN_THREAD: the main loop doesn't run with SLEEP_ON_EXIT!"
+#endif
+
+#ifndef SYSCLK_MHZ
+#define SYSCLK_MHZ         (8u)                 //!< HSI system clock in MHz: 4, 8, 16 or 24
+#endif
+#if SYSCLK_MHZ == 4u
+#define SYSCLK_HSI_CALIBRATION  LL_RCC_HSICALIBRATION_4MHz   //!< HSI trimming of the system clock
+#elif SYSCLK_MHZ == 8u
+#define SYSCLK_HSI_CALIBRATION  LL_RCC_HSICALIBRATION_8MHz   //!< HSI trimming of the system clock
+#elif SYSCLK_MHZ == 16u
+#define SYSCLK_HSI_CALIBRATION  LL_RCC_HSICALIBRATION_16MHz  //!< HSI trimming of the system clock
+#elif SYSCLK_MHZ == 24u
+#define SYSCLK_HSI_CALIBRATION  LL_RCC_HSICALIBRATION_24MHz  //!< HSI trimming of the system clock
+#else
+#error "SYSCLK_MHZ: only 4, 8, 16 and 24 MHz are supported!"
+#endif
 
 #ifdef __cplusplus
 }
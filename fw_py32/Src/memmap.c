@@ -0,0 +1,46 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file memmap.c
+*
+* \brief Static memory map: the buffers of the modes that never run at the same time share one arena
+*
+* \author Hekk_Elek
+*
+* \note  Only the arena itself, and the checks of the map at compile time; see memmap.h.
+*
+**********************************************************************************************************/
+
+/***************************************< Includes >**************************************/
+// Own includes
+#include "main.h"
+#include "types.h"
+#include "memmap.h"
+
+#if MEMMAP_BOOT_PART || MEMMAP_RUN_PART
+
+/***************************************< Definitions >**************************************/
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+NO_INIT U_MEMMAP_ARENA guMemMap;  //!< The arena of the modes
+
+
+/***************************************< Static assertions >**************************************/
+#ifndef SIM_HOST  // the U32 of the host may be twice as long
+STATIC_ASSERT( sizeof( U_MEMMAP_ARENA ) <= MEMMAP_ARENA_MAX );
+#endif
+#if MEMMAP_BOOT_PART && ( LED_DRIVER_MODE == LED_MODE_BITPLANE )
+// The upload is free in the bit-plane mode: the chunk fits in the waveform of the LEDs
+STATIC_ASSERT( sizeof( guMemMap.sBoot ) <= sizeof( guMemMap.sRun ) );
+#endif
+
+#endif /* MEMMAP_BOOT_PART || MEMMAP_RUN_PART */
+
+/***************************************< End of file >**************************************/
@@ -0,0 +1,80 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file memmap.h
+*
+* \brief Static memory map: the buffers of the modes that never run at the same time share one arena
+*
+* \author Hekk_Elek
+*
+* \note  The 3 KB SRAM of the PY32F002A leaves little room for the buffers of the optional modules. A
+*        buffer of a mode goes into the part of its mode in U_MEMMAP_ARENA, and is used by its module
+*        through a macro of the old name, e.g. gasSegments of led.c. The parts overlap, so a buffer
+*        costs RAM only above the largest part. The modes:
+*        - boot: Upload_Run(), before the LED driver, the stream and the timers start
+*        - run:  everything after the init block; the power-down keeps it, LED_Init() rebuilds it
+*        A buffer used in both modes, or by the persistent storage, which Upload_Run() programs
+*        through, stays a global of its module. The arena is NO_INIT: every buffer in it is written
+*        before it is read by its own module. Its size is checked against MEMMAP_ARENA_MAX at compile
+*        time, see memmap.c.
+*
+**********************************************************************************************************/
+#ifndef MEMMAP_H
+#define MEMMAP_H
+
+/***************************************< Includes >**************************************/
+#include "types.h"
+#include "led.h"
+#include "upload.h"
+#include "stream.h"
+
+
+/***************************************< Definitions >**************************************/
+#define MEMMAP_ARENA_MAX      (384u)  //!< Largest arena: an eighth of the SRAM, the bit-planes of 6 bits and the stream fit
+#define MEMMAP_BOOT_PART      ( UPLOAD_ENABLE )  //!< The boot mode has buffers in the arena
+#define MEMMAP_RUN_PART       ( ( LED_DRIVER_MODE == LED_MODE_BITPLANE ) || STREAM_ENABLE )  //!< The run mode has buffers in the arena
+
+
+/***************************************< Types >**************************************/
+#if MEMMAP_BOOT_PART || MEMMAP_RUN_PART
+//! \brief The arena: one part for each mode, all at the same address
+typedef union
+{
+#if MEMMAP_BOOT_PART
+  //! \brief Buffers of the boot mode
+  struct
+  {
+    U32 au32UploadChunk[ FLASH_PAGE_SIZE / sizeof( U32 ) ];  //!< Chunk of the upload received, up to a flash page, see upload.c
+  } sBoot;
+#endif
+#if MEMMAP_RUN_PART
+  //! \brief Buffers of the run mode
+  struct
+  {
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+    S_LED_SEGMENT aaasLEDSegments[ LED_BUFFERS ][ LED_SIDES ][ LED_SEGMENTS_MAX ];  //!< Precomputed waveform of each side, see led.c
+#endif
+#if STREAM_ENABLE
+    U8  aau8StreamFrames[ STREAM_BUFFERS ][ STREAM_FRAME_BYTES ];  //!< Levels of the frames received, see stream.c
+#endif
+  } sRun;
+#endif
+} U_MEMMAP_ARENA;
+#endif
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+#if MEMMAP_BOOT_PART || MEMMAP_RUN_PART
+extern U_MEMMAP_ARENA guMemMap;
+#endif
+
+
+/***************************************< Public functions >**************************************/
+
+
+#endif /* MEMMAP_H */
+
+/***************************************< End of file >**************************************/
@@ -11,33 +11,120 @@
 
 /***************************************< Includes >**************************************/
 // Standard C libraries
+#include <stddef.h>
 #include <string.h>
 
 // Own includes
+#include "main.h"
 #include "types.h"
 #include "util.h"
 #include "persist.h"
+#include "stats.h"
 
 
 /***************************************< Definitions >**************************************/
-#define EEPROM_SIZE           (4096u)  //!< Number of bytes present as EEPROM memory
-#define EEPROM_BASEADDRESS  (0x2000u)  //!< Base address of EEPROM in STC8G1K08
+#define PERSIST_FLASH_BASE  (0x08004C00u)  //!< Start of the flash area reserved for persistent data, see the linker file
+#define EEPROM_SIZE           (1024u)  //!< Number of bytes in the reserved flash area: the last 1 kB
+#define EEPROM_PAGE_SIZE       (FLASH_PAGE_SIZE)  //!< Size of an erasable and programmable flash page
+#define PAGE_WORDS            ( EEPROM_PAGE_SIZE / sizeof( U32 ) )  //!< Number of words in a flash page
+#define SAVE_DELAY_MS         (5000u)  //!< A deferred save is written after this long without changes
+#define EEPROM_PAGES          ( EEPROM_SIZE / EEPROM_PAGE_SIZE )  //!< Number of pages used by the journal
+#define PERSIST_KEYS          ( offsetof( S_PERSIST, u16CRC ) )  //!< Keys of the records: the bytes of S_PERSIST before the CRC
+//! \brief Number of records in a page, after the page header and the snapshot
+#define RECORDS_PER_PAGE      ( ( EEPROM_PAGE_SIZE - sizeof( S_PERSIST_PAGE_HEADER ) - sizeof( S_PERSIST ) ) / sizeof( S_PERSIST_RECORD ) )
+//! \brief EEPROM address of the snapshot of a page
+#define SNAPSHOT_ADDRESS(page)  ( (U16)(page) * EEPROM_PAGE_SIZE + sizeof( S_PERSIST_PAGE_HEADER ) )
+//! \brief EEPROM address of a record
+#define RECORD_ADDRESS(page,record)  ( SNAPSHOT_ADDRESS( page ) + sizeof( S_PERSIST ) + (U16)(record) * sizeof( S_PERSIST_RECORD ) )
+#define RETAINED_MAGIC        (0x50525354uL)  //!< "PRST": S_PERSIST_RETAINED holds the state of the module
 
 
 /***************************************< Types >**************************************/
+//! \brief Header at the start of each journal page
+//! \note  The sequence number is increased by one for each new page. Only the last few pages
+//!        are alive, so they are compared by signed difference, and the wrap-around is harmless.
+typedef PACKED struct
+{
+  U16 u16Sequence;                  //!< Sequence number of the page
+  U16 u16SequenceInv;               //!< Bitwise inverse of the sequence number, to detect erased or torn headers
+} S_PERSIST_PAGE_HEADER;
+
+//! \brief Change of one byte of the persistent data, appended to the journal page
+//! \note  A page starts with a snapshot of the whole S_PERSIST, then each save appends a record for
+//!        every byte changed since the previous one: a click costs one flash word, not a record.
+//!        When the records don't fit any more, the next page is started with a new snapshot.
+//!        An empty word has key 0xFF, which is never a valid key.
+typedef PACKED struct
+{
+  U8  u8Key;                        //!< Offset of the byte in S_PERSIST, below PERSIST_KEYS
+  U8  u8Value;                      //!< New value of the byte
+  U16 u16CRC;                       //!< CRC of the key and the value
+} S_PERSIST_RECORD;
+
+#if PERSIST_RETAIN
+//! \brief State of the module kept over a reset, see Persist_Init()
+//! \note  The SRAM keeps its content over every reset but a power-on; a power-on leaves random
+//!        data, which match the magic and the CRC hardly ever.
+typedef struct
+{
+  U32 u32Magic;                     //!< RETAINED_MAGIC while the copy is valid
+  S_PERSIST sData;                  //!< gsPersistentData, with the changes not saved yet
+  S_PERSIST sStored;                //!< gsStoredData: the persistent data as the flash has them
+  U16 u16Sequence;                  //!< gu16Sequence
+  U8  u8ActivePage;                 //!< gu8ActivePage
+  U8  u8NextRecord;                 //!< gu8NextRecord
+  U8  u8NextErased;                 //!< gbitNextErased
+  U16 u16CRC;                       //!< CRC of the fields above
+} S_PERSIST_RETAINED;
+#endif
 
 
 /***************************************< Constants >**************************************/
+//! \brief Addresses of the factory flash timing values for each HSI frequency (4, 8, 16, 22.12, 24 MHz)
+static CODE const U32 gcau32FlashTimingTable[ 8u ] =
+{
+  0x1FFF0F1Cu, 0x1FFF0F30u, 0x1FFF0F44u, 0x1FFF0F58u, 0x1FFF0F6Cu, 0x1FFF0F1Cu, 0x1FFF0F1Cu, 0x1FFF0F1Cu
+};
 
 
 /***************************************< Global variables >**************************************/
-DATA S_PERSIST       gsPersistentData;  //!< Globally accessible persistent data structure
-IDATA S_PERSIST CODE* gpsNextSaveSlot;  //!< Address of the next persistent save slot
+DATA S_PERSIST gsPersistentData;  //!< Globally accessible persistent data structure
+static IDATA U8  gu8ActivePage;    //!< Page of the journal being written
+static IDATA U8  gu8NextRecord;    //!< The next empty record in the active page
+static IDATA U16 gu16Sequence;     //!< Sequence number of the active page
+static BIT gbitDirty;           //!< Set if there are unsaved changes
+static BIT gbitWriteThrough;    //!< Set if the changes are saved at once, see Persist_SetWriteThrough()
+static BIT gbitNextErased;      //!< Set if the next page in the ring is known to be blank, as on a fresh part
+static S_PERSIST gsStoredData;  //!< RAM shadow of the journal: the persistent data as the flash has them
+static U32 gau32PageBuffer[ PAGE_WORDS ];  //!< Data of a flash page to be programmed
+#if PERSIST_RETAIN
+static NO_INIT S_PERSIST_RETAINED gsRetained;  //!< The state of the module, kept over a reset
+#endif
+
+
+/***************************************< Static assertions >**************************************/
+// A page holds its header, the snapshot and at least one record, or RECORDS_PER_PAGE underflows
+STATIC_ASSERT( sizeof( S_PERSIST_PAGE_HEADER ) + sizeof( S_PERSIST ) + sizeof( S_PERSIST_RECORD ) <= EEPROM_PAGE_SIZE );
 
 
 /***************************************< Static function definitions >**************************************/
-static BOOL IsSaveBlockEmpty( S_PERSIST* psLocalCopy, S_PERSIST CODE* psSaveBlock );
-static BOOL SearchForLatestSave( S_PERSIST CODE** ppsNextEmpty );
+static BOOL ReadPageHeader( U8 u8Page, U16* pu16Sequence );
+static BOOL IsEmpty( U16 u16Address, U8 u8Length );
+static U8   CountRecords( U8 u8Page );
+static BOOL LoadPage( U8 u8Page, U8 u8Records );
+static BOOL SearchForLatestSave( void );
+static void UpgradeRecord( void );
+#if PERSIST_RETAIN
+static U16  RetainedCRC( void );
+static void Retain( void );
+static BOOL Restore( void );
+#endif
+static void FlashConfigTiming( void );
+static void FlashUnlock( void );
+static void FlashFinish( U32 u32Operation );
+RAMFUNC static void FlashProgramPage( U32 u32Address );
+RAMFUNC static void FlashErasePage( U32 u32Address );
+RAMFUNC static void FlashSleep( void );
 static void IAP_Write( U16 u16Address, U8* pu8Data, U8 u8DataLength );
 static void IAP_Erase( U16 u16Address );
 static void IAP_Read( U16 u16Address, U8* pu8Data, U8 u8DataLength );
@@ -45,21 +132,38 @@ static void IAP_Read( U16 u16Address, U8* pu8Data, U8 u8DataLength );
 
 /***************************************< Private functions >**************************************/
 //----------------------------------------------------------------------------
-//! \brief  Check if given block is empty in the EEPROM
-//! \param  psTemp: pointer to a temporary storage
-//! \param  psSaveBlock: pointer to the block in EEPROM
-//! \return TRUE if the block is empty; FALSE if not
+//! \brief  Reads the header of a journal page
+//! \param  u8Page: index of the page
+//! \param  pu16Sequence: the sequence number of the page is written here
+//! \return TRUE if the page has a valid header; FALSE if it is erased or the header is corrupt
+//! \global -
+//-----------------------------------------------------------------------------
+static BOOL ReadPageHeader( U8 u8Page, U16* pu16Sequence )
+{
+  S_PERSIST_PAGE_HEADER sHeader;
+  
+  IAP_Read( (U16)u8Page * EEPROM_PAGE_SIZE, (U8*)&sHeader, sizeof( S_PERSIST_PAGE_HEADER ) );
+  *pu16Sequence = sHeader.u16Sequence;
+  
+  return ( (U16)~sHeader.u16SequenceInv == sHeader.u16Sequence );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Check if given area is empty in the EEPROM
+//! \param  u16Address: address of the area
+//! \param  u8Length: length of the area
+//! \return TRUE if the area is empty; FALSE if not
 //! \global -
 //-----------------------------------------------------------------------------
-static BOOL IsSaveBlockEmpty( S_PERSIST* psTemp, S_PERSIST CODE* psSaveBlock )
+static BOOL IsEmpty( U16 u16Address, U8 u8Length )
 {
   BOOL bEmpty = TRUE;
-  U8  u8ByteIndex;
+  U8   u8ByteIndex;
+  const U8* pu8Data = (const U8*)( PERSIST_FLASH_BASE + u16Address );
 
-  IAP_Read( (U16)psSaveBlock, (U8*)psTemp, sizeof( S_PERSIST ) );
-  for( u8ByteIndex = 0u; u8ByteIndex < sizeof( S_PERSIST ); u8ByteIndex++ )
+  for( u8ByteIndex = 0u; u8ByteIndex < u8Length; u8ByteIndex++ )
   {
-    if( 0xFFu != ((U8*)psTemp)[ u8ByteIndex ] )
+    if( 0xFFu != pu8Data[ u8ByteIndex ] )
     {
       bEmpty = FALSE;
     }
@@ -67,155 +171,398 @@ static BOOL IsSaveBlockEmpty( S_PERSIST* psTemp, S_PERSIST CODE* psSaveBlock )
   return bEmpty;
 }
 
+//----------------------------------------------------------------------------
+//! \brief  Counts the used records of a page by binary search
+//! \param  u8Page: index of the page
+//! \return Number of used records; they are always at the start of the page
+//! \global -
+//! \note   A record torn by a power loss counts as used, so the search stays monotonic.
+//-----------------------------------------------------------------------------
+static U8 CountRecords( U8 u8Page )
+{
+  U8 u8Low = 0u;                 // records below are used
+  U8 u8High = RECORDS_PER_PAGE;  // records from here are empty
+  U8 u8Middle;
+  
+  while( u8Low < u8High )
+  {
+    u8Middle = (U8)( ( (U16)u8Low + u8High ) >> 1u );
+    if( IsEmpty( RECORD_ADDRESS( u8Page, u8Middle ), sizeof( S_PERSIST_RECORD ) ) )
+    {
+      u8High = u8Middle;
+    }
+    else
+    {
+      u8Low = u8Middle + 1u;
+    }
+  }
+  
+  return u8Low;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Loads the snapshot of a page, and replays its records on it
+//! \param  u8Page: index of the page
+//! \param  u8Records: number of used records in the page
+//! \return TRUE, if the snapshot is correct; FALSE if not, nothing is loaded then
+//! \global gsPersistentData
+//! \note   A record with a wrong CRC, torn by a power loss, is skipped.
+//-----------------------------------------------------------------------------
+static BOOL LoadPage( U8 u8Page, U8 u8Records )
+{
+  BOOL bReturn = FALSE;
+  U8   u8Record;
+  S_PERSIST sLocalCopy;
+  S_PERSIST_RECORD sRecord;
+  
+  IAP_Read( SNAPSHOT_ADDRESS( u8Page ), (U8*)&sLocalCopy, sizeof( S_PERSIST ) );
+  if( sLocalCopy.u16CRC == Util_CRC16( (U8*)&sLocalCopy, PERSIST_KEYS ) )
+  {
+    for( u8Record = 0u; u8Record < u8Records; u8Record++ )
+    {
+      IAP_Read( RECORD_ADDRESS( u8Page, u8Record ), (U8*)&sRecord, sizeof( S_PERSIST_RECORD ) );
+      if( ( sRecord.u8Key < PERSIST_KEYS )
+       && ( sRecord.u16CRC == Util_CRC16( (U8*)&sRecord, sizeof( S_PERSIST_RECORD ) - sizeof( U16 ) ) ) )
+      {
+        ((U8*)&sLocalCopy)[ sRecord.u8Key ] = sRecord.u8Value;
+      }
+    }
+    memcpy( &gsPersistentData, &sLocalCopy, sizeof( S_PERSIST ) );
+    bReturn = TRUE;
+  }
+  
+  return bReturn;
+}
+
 //----------------------------------------------------------------------------
 //! \brief  Search for the latest save in EEPROM
-//! \param  ppsNextEmpty: address of the next empty block for writing
+//! \param  -
 //! \return TRUE, if it found a correct save; FALSE if not
-//! \global gsPersistentData
-//! \note   Takes some time, should only be called in init block.
+//! \global gsPersistentData, gu8ActivePage, gu8NextRecord, gu16Sequence, gbitNextErased
+//! \note   Reads only the page headers, then the newest page. If its snapshot is not correct (power
+//!         loss right after starting it), the previous page is used, and the next save starts a
+//!         new page. Without any valid header, the first page is checked to be blank instead.
 //-----------------------------------------------------------------------------
-static BOOL SearchForLatestSave( S_PERSIST CODE** ppsNextEmpty )
+static BOOL SearchForLatestSave( void )
 {
-  BOOL bEmpty;
-  U16 u16SaveIndex;
+  BOOL bFound = FALSE;
   BOOL bReturn = FALSE;
-  S_PERSIST CODE* psSave = (S_PERSIST CODE*)EEPROM_BASEADDRESS;
-  S_PERSIST  sLocalCopy;
+  U8   u8Page;
+  U8   u8PreviousPage = 0u;
+  U16  u16Sequence;
   
-  for( u16SaveIndex = 0u; u16SaveIndex < ( EEPROM_SIZE / sizeof( S_PERSIST ) ); u16SaveIndex++ )
+  // Find the newest page by the sequence numbers
+  for( u8Page = 0u; u8Page < EEPROM_PAGES; u8Page++ )
   {
-    IAP_Read( (U16)psSave, (U8*)&sLocalCopy, sizeof( S_PERSIST ) );
-    if( sLocalCopy.u16CRC == Util_CRC16( (U8*)&sLocalCopy, sizeof( S_PERSIST ) - sizeof( U16 ) ) )
+    if( ReadPageHeader( u8Page, &u16Sequence ) )
     {
-      memcpy( &gsPersistentData, &sLocalCopy, sizeof( S_PERSIST ) );
-      bReturn = TRUE;
+      if( ( FALSE == bFound ) || ( (I16)( u16Sequence - gu16Sequence ) > 0 ) )
+      {
+        gu8ActivePage = u8Page;
+        gu16Sequence = u16Sequence;
+        bFound = TRUE;
+      }
     }
-    else  // bad CRC
+  }
+  
+  if( TRUE == bFound )
+  {
+    gu8NextRecord = CountRecords( gu8ActivePage );
+    bReturn = LoadPage( gu8ActivePage, gu8NextRecord );
+    if( FALSE == bReturn )
     {
-      // Check if this block is empty
-      bEmpty = IsSaveBlockEmpty( &sLocalCopy, psSave );
-      if( ( TRUE == bReturn ) && ( TRUE == bEmpty ) )
+      gu8NextRecord = RECORDS_PER_PAGE;  // no record may go after a torn snapshot
+      // Pages are written in ring order, so the previous one is right before it
+      u8PreviousPage = ( gu8ActivePage + EEPROM_PAGES - 1u ) % EEPROM_PAGES;
+      if( ReadPageHeader( u8PreviousPage, &u16Sequence ) && ( (U16)( gu16Sequence - 1u ) == u16Sequence ) )
       {
-        *ppsNextEmpty = psSave;
-        break;
+        bReturn = LoadPage( u8PreviousPage, CountRecords( u8PreviousPage ) );
       }
     }
-    psSave++;
   }
-#warning "What happens if it rolls over?"
+  else  // blank EEPROM: the first save starts page 0 with sequence 0
+  {
+    gu8ActivePage = EEPROM_PAGES - 1u;
+    gu8NextRecord = RECORDS_PER_PAGE;
+    gu16Sequence = 0xFFFFu;
+    // A fresh part needs no erase before its first save; no valid header may be a torn page too
+    gbitNextErased = IsEmpty( 0u, EEPROM_PAGE_SIZE );
+  }
   
   return bReturn;
 }
+
+#if PERSIST_RETAIN
 //----------------------------------------------------------------------------
-//! \brief  Write data block to EEPROM from a given address
-//! \param  u16Address: Start address to be written. Only lower 12 bits are used.
-//! \param  pu8Data: pointer to the data to be written
-//! \param  u8DataLength: write length
+//! \brief  Calculates the CRC of the retained state
+//! \param  -
+//! \return CRC of the fields of gsRetained before its CRC
+//! \global gsRetained
+//! \note   In parts, every one is shorter than the 255 bytes of Util_CRC16().
+//-----------------------------------------------------------------------------
+static U16 RetainedCRC( void )
+{
+  U16 u16Crc;
+  
+  u16Crc = Util_CRC16( (U8*)&gsRetained, offsetof( S_PERSIST_RETAINED, sData ) );
+  u16Crc = Util_CRC16Continue( u16Crc, (U8*)&gsRetained.sData, sizeof( S_PERSIST ) );
+  u16Crc = Util_CRC16Continue( u16Crc, (U8*)&gsRetained.sStored, sizeof( S_PERSIST ) );
+  u16Crc = Util_CRC16Continue( u16Crc, (U8*)&gsRetained.u16Sequence, offsetof( S_PERSIST_RETAINED, u16CRC ) - offsetof( S_PERSIST_RETAINED, u16Sequence ) );
+  
+  return u16Crc;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Copies the state of the module to the RAM kept over a reset
+//! \param  -
 //! \return -
-//! \global -
-//! \note   Stalls the CPU.
+//! \global gsRetained, all globals of the journal
+//! \note   Called at every change, so a reset from then on doesn't read the flash.
 //-----------------------------------------------------------------------------
-static void IAP_Write( U16 u16Address, U8* pu8Data, U8 u8DataLength )
+static void Retain( void )
 {
-  U8 u8Index;
-#warning "Port to PY32F002!"
-/*
+  gsRetained.u32Magic = RETAINED_MAGIC;
   DISABLE_IT;
+  memcpy( &gsRetained.sData, &gsPersistentData, sizeof( S_PERSIST ) );
+  ENABLE_IT;
+  memcpy( &gsRetained.sStored, &gsStoredData, sizeof( S_PERSIST ) );
+  gsRetained.u16Sequence = gu16Sequence;
+  gsRetained.u8ActivePage = gu8ActivePage;
+  gsRetained.u8NextRecord = gu8NextRecord;
+  gsRetained.u8NextErased = gbitNextErased ? 1u : 0u;
+  gsRetained.u16CRC = RetainedCRC();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Takes the state of the module from the RAM kept over a reset
+//! \param  -
+//! \return TRUE if it was valid and of this layout; FALSE if the journal has to be read
+//! \global gsRetained, gsPersistentData, all globals of the journal
+//! \note   The changes not saved before the reset are kept, they are saved later.
+//-----------------------------------------------------------------------------
+static BOOL Restore( void )
+{
+  BOOL bRestored = FALSE;
+  
+  if( ( RETAINED_MAGIC == gsRetained.u32Magic ) && ( gsRetained.u16CRC == RetainedCRC() )
+   && ( PERSIST_VERSION == gsRetained.sData.u8Version ) )
+  {
+    memcpy( &gsPersistentData, &gsRetained.sData, sizeof( S_PERSIST ) );
+    memcpy( &gsStoredData, &gsRetained.sStored, sizeof( S_PERSIST ) );
+    gu16Sequence = gsRetained.u16Sequence;
+    gu8ActivePage = gsRetained.u8ActivePage;
+    gu8NextRecord = gsRetained.u8NextRecord;
+    gbitNextErased = ( 0u != gsRetained.u8NextErased );
+    bRestored = TRUE;
+  }
+  
+  return bRestored;
+}
+#endif
+
+//----------------------------------------------------------------------------
+//! \brief  Sets the flash erase/program timing for the current HSI frequency
+//! \param  -
+//! \return -
+//! \global -
+//! \note   The timing values are factory calibrated, and stored in a table for each HSI frequency.
+//-----------------------------------------------------------------------------
+static void FlashConfigTiming( void )
+{
+  const U32* pu32Timing = (const U32*)gcau32FlashTimingTable[ ( RCC->ICSCR & RCC_ICSCR_HSI_FS ) >> RCC_ICSCR_HSI_FS_Pos ];
+  
+  FLASH->TS0     = pu32Timing[ 0u ] & 0xFFu;
+  FLASH->TS1     = ( pu32Timing[ 0u ] >> 16u ) & 0x1FFu;
+  FLASH->TS3     = ( pu32Timing[ 0u ] >> 8u ) & 0xFFu;
+  FLASH->TS2P    = pu32Timing[ 1u ] & 0xFFu;
+  FLASH->TPS3    = ( pu32Timing[ 1u ] >> 16u ) & 0x7FFu;
+  FLASH->PERTPE  = pu32Timing[ 2u ] & 0x1FFFFu;
+  FLASH->SMERTPE = pu32Timing[ 3u ] & 0x1FFFFu;
+  FLASH->PRGTPE  = pu32Timing[ 4u ] & 0xFFFFu;
+  FLASH->PRETPE  = ( pu32Timing[ 4u ] >> 16u ) & 0x3FFFu;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Unlocks the flash controller for an erase or program operation
+//! \param  -
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+static void FlashUnlock( void )
+{
+  if( FLASH->CR & FLASH_CR_LOCK )
+  {
+    FLASH->KEYR = FLASH_KEY1;
+    FLASH->KEYR = FLASH_KEY2;
+  }
+  FlashConfigTiming();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Waits for the end of the flash operation, then locks the flash controller
+//! \param  u32Operation: the operation bits to be cleared in FLASH->CR
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+static void FlashFinish( U32 u32Operation )
+{
+  while( FLASH->SR & FLASH_SR_BSY );
+  FLASH->SR = FLASH_SR_EOP;  // cleared by writing 1
+  FLASH->CR &= ~u32Operation;
+  FLASH->CR |= FLASH_CR_LOCK;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Programs a whole flash page from the page buffer
+//! \param  u32Address: address of the page, must be page aligned
+//! \return -
+//! \global gau32PageBuffer[]
+//! \note   Runs from RAM, as the start bit must be set between the last two words without any
+//!         flash access. Interrupts are disabled meanwhile, and it sleeps until the end of the
+//!         programming, see FlashSleep().
+//-----------------------------------------------------------------------------
+RAMFUNC static void FlashProgramPage( U32 u32Address )
+{
+  U8  u8Index;
   
-  IAP_CONTR = 0x80u;  // EEPROM is enabled
-  IAP_TPS = SYSTEM_CLOCK_MHZ;
-  IAP_CMD = 0x02u;  // Write operation
-  for( u8Index = 0u; u8Index < u8DataLength; u8Index++ )
+  FLASH->CR |= FLASH_CR_PG;
+  DISABLE_IT;
+  for( u8Index = 0u; u8Index < PAGE_WORDS; u8Index++ )
   {
-    IAP_ADDRL = u16Address;
-    IAP_ADDRH = (u16Address>>8u) & 0x0Fu;  // only lower 12 bits are used
-    IAP_DATA = pu8Data[ u8Index ];
-    // Initiate command by magic code sequence
-    IAP_TRIG = 0x5Au;
-    IAP_TRIG = 0xA5u;
-    NOP();
-    NOP();
-    u16Address++;
+    ((volatile U32*)u32Address)[ u8Index ] = gau32PageBuffer[ u8Index ];
+    if( ( PAGE_WORDS - 2u ) == u8Index )
+    {
+      FLASH->CR |= FLASH_CR_PGSTRT;
+    }
   }
-  IAP_CONTR = 0x00u;  // Clear flags, EEPROM is disabled
-  IAP_CMD   = 0u;
-  IAP_TRIG  = 0u;
+  FlashSleep();
+  ENABLE_IT;
+}
 
+//----------------------------------------------------------------------------
+//! \brief  Erases a flash page
+//! \param  u32Address: address of the page, must be page aligned
+//! \return -
+//! \global -
+//! \note   Runs from RAM with interrupts disabled, and sleeps until the end of the erase, see FlashSleep().
+//-----------------------------------------------------------------------------
+RAMFUNC static void FlashErasePage( U32 u32Address )
+{
+  DISABLE_IT;
+  *(volatile U32*)u32Address = 0xFFFFFFFFu;  // any write starts the erase
+  FlashSleep();
   ENABLE_IT;
-*/
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Sleeps until the flash operation started has ended
+//! \param  -
+//! \return -
+//! \global -
+//! \note   Runs from RAM, with interrupts disabled: the CPU would only stall on the next flash fetch,
+//!         at the full run current, for the milliseconds of an erase. The end of the operation wakes
+//!         WFI by the FLASH interrupt, which pends but is never taken. Every other interrupt is
+//!         masked in the NVIC meanwhile, so none wakes it early; their handlers are in flash
+//!         anyway. They pend, and are taken at the end, as after the stall.
+//-----------------------------------------------------------------------------
+RAMFUNC static void FlashSleep( void )
+{
+  U32 u32Enabled = NVIC->ISER[ 0u ];
+  
+  NVIC->ICER[ 0u ] = u32Enabled;
+  NVIC->ICPR[ 0u ] = 1uL << FLASH_IRQn;
+  NVIC->ISER[ 0u ] = 1uL << FLASH_IRQn;
+  FLASH->CR |= FLASH_CR_EOPIE;
+  while( FLASH->SR & FLASH_SR_BSY )
+  {
+    __WFI();
+  }
+  FLASH->CR &= ~FLASH_CR_EOPIE;
+  NVIC->ICER[ 0u ] = 1uL << FLASH_IRQn;
+  NVIC->ICPR[ 0u ] = 1uL << FLASH_IRQn;
+  NVIC->ISER[ 0u ] = u32Enabled;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Write data block to EEPROM from a given address
+//! \param  u16Address: Start address to be written, relative to the persistent area
+//! \param  pu8Data: pointer to the data to be written
+//! \param  u8DataLength: write length, must not cross a page boundary
+//! \return -
+//! \global gau32PageBuffer[]
+//! \note   Sleeps meanwhile.
+//-----------------------------------------------------------------------------
+static void IAP_Write( U16 u16Address, U8* pu8Data, U8 u8DataLength )
+{
+  Persist_WriteFlash( PERSIST_FLASH_BASE + u16Address, pu8Data, u8DataLength );
 }
 
 //----------------------------------------------------------------------------
 //! \brief  Erases one page in EEPROM
-//! \param  u16Address: Address of page, the lower 9 bits are discarded
+//! \param  u16Address: Address of page, relative to the persistent area; the lower 7 bits are discarded
 //! \return -
 //! \global -
-//! \note   Stalls the CPU.
+//! \note   Sleeps meanwhile.
 //-----------------------------------------------------------------------------
 static void IAP_Erase( U16 u16Address )
 {
-#warning "Port to PY32F002!"
-/*  
-  DISABLE_IT;
-  
-  IAP_CONTR = 0x80u;  // EEPROM is enabled
-  IAP_TPS = SYSTEM_CLOCK_MHZ;
-  IAP_CMD = 0x03u;  // Erase operation
-  IAP_ADDRL = u16Address;  // NOTE: lower 9 bits are automatically discarded
-  IAP_ADDRH = (u16Address>>8u) & 0x0Fu;  // only lower 12 bits are used
-  // Initiate command by magic code sequence
-  IAP_TRIG = 0x5Au;
-  IAP_TRIG = 0xA5u;
-  NOP();
-  NOP();
-  // Clear flags and registers
-  IAP_CONTR = 0x00u;  // Clear flags, EEPROM is disabled
-  IAP_CMD   = 0u;
-  IAP_TRIG  = 0u;
-  
-  ENABLE_IT;
-*/
+  Persist_EraseFlash( PERSIST_FLASH_BASE + u16Address );
 }
 
 //----------------------------------------------------------------------------
 //! \brief  Reads given number of bytes from EEPROM
-//! \param  u16Address: Start address to be read. Only lower 12 bits are used.
+//! \param  u16Address: Start address to be read, relative to the persistent area
 //! \param  pu8Data: data read from EEPROM are written here
 //! \param  u8DataLength: read length
 //! \return -
 //! \global -
-//! \note   Stalls the CPU.
+//! \note   The flash is memory mapped, so this is a plain copy.
 //-----------------------------------------------------------------------------
 static void IAP_Read( U16 u16Address, U8* pu8Data, U8 u8DataLength )
 {
-#warning "Port to PY32F002!"
-/*  
-  U8 u8Index;
+  memcpy( pu8Data, (const U8*)( PERSIST_FLASH_BASE + u16Address ), u8DataLength );
+}
 
-  DISABLE_IT;
-  
-  IAP_CONTR = 0x80u;  // EEPROM is enabled
-  IAP_TPS = SYSTEM_CLOCK_MHZ;
-  IAP_CMD = 0x01u;  // Read operation
-  for( u8Index = 0u; u8Index < u8DataLength; u8Index++ )
+//----------------------------------------------------------------------------
+//! \brief  Fills the fields missing from an older (or blank) record with their defaults
+//! \param  -
+//! \return -
+//! \global gsPersistentData
+//! \note   The cases fall through, so a record is brought up to date from any older version.
+//-----------------------------------------------------------------------------
+static void UpgradeRecord( void )
+{
+  switch( gsPersistentData.u8Version )
   {
-    IAP_ADDRL = u16Address;
-    IAP_ADDRH = (u16Address>>8u) & 0x0Fu;  // only lower 12 bits are used
-    // Initiate command by magic code sequence
-    IAP_TRIG = 0x5Au;
-    IAP_TRIG = 0xA5u;
-    NOP();
-    NOP();
-    // Output
-    pu8Data[ u8Index ] = IAP_DATA;
-    u16Address++;
+    case 0u:  // Blank
+      gsPersistentData.u8Brightness = PERSIST_BRIGHTNESS_FULL;
+      gsPersistentData.u32Playlist = 0u;
+      gsPersistentData.u16AutoOffMin = PERSIST_AUTO_OFF_MIN;
+      // fall through
+    case 1u:
+      memset( gsPersistentData.au8LEDTrim, 0, LEDS_NUM );
+      // fall through
+    case 2u:
+      gsPersistentData.u32UsedUah = 0u;
+      // fall through
+    case 3u:
+      gsPersistentData.u32OnMin = 0u;
+      gsPersistentData.u32Presses = 0u;
+      gsPersistentData.u32Saves = 0u;
+      memset( gsPersistentData.au16Resets, 0, sizeof( gsPersistentData.au16Resets ) );
+      memset( gsPersistentData.au16AnimationMin, 0, sizeof( gsPersistentData.au16AnimationMin ) );
+      // fall through
+    case 4u:
+      gsPersistentData.u16SchedulePeriodMin = SCHEDULE_PERIOD_MIN;
+      // fall through
+    case 5u:
+      gsPersistentData.u16LEDFaultMask = 0u;
+      gsPersistentData.u16LEDFaults = 0u;
+      // fall through
+    default:  // PERSIST_VERSION -- Up to date
+      gsPersistentData.u8Version = PERSIST_VERSION;
+      break;
   }
-  IAP_CONTR = 0x00u;  // Clear flags, EEPROM is disabled
-  IAP_CMD   = 0u;
-  IAP_TRIG  = 0u;
-
-  ENABLE_IT;
-*/
 }
 
 
@@ -225,26 +572,39 @@ static void IAP_Read( U16 u16Address, U8* pu8Data, U8 u8DataLength )
 //! \param  -
 //! \return -
 //! \global All globals from this module
-//! \note   Should be called from init block
+//! \note   Should be called from init block. With PERSIST_RETAIN, after a warm reset the state is
+//!         taken from the RAM, and the flash is not read at all.
 //-----------------------------------------------------------------------------
 void Persist_Init( void )
 {
-#warning "Port to PY32F002!"
-/*
-  // Enable EEPROM
-  IAP_CONTR = 0x80u;
-  IAP_TPS = SYSTEM_CLOCK_MHZ;
-  IAP_CMD = 0x01u;  // Read operation
-*/
-  // Find latest save and load it
-  if( TRUE == SearchForLatestSave( &gpsNextSaveSlot ) )
+  gbitDirty = FALSE;
+  gbitWriteThrough = FALSE;
+#if PERSIST_RETAIN
+  if( Restore() )
   {
-    // persistent data are loaded to memory
+    if( 0 != memcmp( &gsPersistentData, &gsStoredData, PERSIST_KEYS ) )
+    {
+      Persist_SaveLater();  // the changes not saved before the reset
+    }
   }
-  else  // Default values
+  else
+#endif
   {
-    memset( &gsPersistentData, 0, sizeof( S_PERSIST ) );
-    gpsNextSaveSlot = (S_PERSIST CODE*)EEPROM_BASEADDRESS;
+    gbitNextErased = FALSE;
+    // Find latest save and load it
+    if( TRUE == SearchForLatestSave() )
+    {
+      // persistent data are loaded to memory
+    }
+    else  // Default values
+    {
+      memset( &gsPersistentData, 0, sizeof( S_PERSIST ) );
+    }
+    UpgradeRecord();
+    memcpy( &gsStoredData, &gsPersistentData, sizeof( S_PERSIST ) );
+#if PERSIST_RETAIN
+    Retain();
+#endif
   }
 }
 
@@ -252,39 +612,177 @@ void Persist_Init( void )
 //! \brief  Saves the current persistent data structure
 //! \param  -
 //! \return -
-//! \global -
-//! \note   Disables interrupt for a short time. Stalls the CPU during writing.
+//! \global gu8ActivePage, gu8NextRecord, gu16Sequence, gsStoredData, gbitNextErased
+//! \note   Disables interrupt for a short time. Sleeps during writing.
+//!         Only the bytes changed since the last save are appended, as records in one write. When
+//!         they don't fit in the active page, the next page in the ring is erased and started with
+//!         the next sequence number and a snapshot; the old page keeps the previous save until then.
 //-----------------------------------------------------------------------------
 void Persist_Save( void )
 {
   S_PERSIST sLocalCopy;
-  U16       u16PrevSaveAddress = (U16)gpsNextSaveSlot;
+  S_PERSIST_PAGE_HEADER sHeader;
+  S_PERSIST_RECORD asRecords[ RECORDS_PER_PAGE ];  // more changes than these make a snapshot anyway
+  U8 u8Key;
+  U8 u8Records = 0u;
   
-  // Assuming that the gpsNextSaveSlot pointer is correct...
+#if STATS_ENABLE
+  Stats_Fold();
+#endif
   DISABLE_IT;
   memcpy( &sLocalCopy, &gsPersistentData, sizeof( S_PERSIST ) );
   ENABLE_IT;
   // Calculate CRC
-  sLocalCopy.u16CRC = Util_CRC16( (U8*)&sLocalCopy, sizeof( S_PERSIST ) - sizeof( U16 ) );
-  // Write EEPROM
-  IAP_Write( (U16)gpsNextSaveSlot, (U8*)&sLocalCopy, sizeof( S_PERSIST ) );
-  // Check if next block is empty; if not, erase
-  gpsNextSaveSlot++;
-  if( FALSE == IsSaveBlockEmpty( &sLocalCopy, gpsNextSaveSlot ) )
+  sLocalCopy.u16CRC = Util_CRC16( (U8*)&sLocalCopy, PERSIST_KEYS );
+  // Collect the changes
+  for( u8Key = 0u; u8Key < PERSIST_KEYS; u8Key++ )
   {
-    // If the page boundary is inside the save slot
-    if( ((U16)gpsNextSaveSlot & 0xFE00u) < u16PrevSaveAddress )
+    if( ((U8*)&sLocalCopy)[ u8Key ] != ((U8*)&gsStoredData)[ u8Key ] )
     {
-      IAP_Erase( ((U16)gpsNextSaveSlot) + sizeof( S_PERSIST ) );
+      if( u8Records < RECORDS_PER_PAGE )
+      {
+        asRecords[ u8Records ].u8Key = u8Key;
+        asRecords[ u8Records ].u8Value = ((U8*)&sLocalCopy)[ u8Key ];
+        asRecords[ u8Records ].u16CRC = Util_CRC16( (U8*)&asRecords[ u8Records ], sizeof( S_PERSIST_RECORD ) - sizeof( U16 ) );
+      }
+      u8Records++;
     }
-    else
+  }
+  if( ( (U16)gu8NextRecord + u8Records ) > RECORDS_PER_PAGE )
+  {
+    // Compaction: a new page with a snapshot
+    gu8ActivePage = ( gu8ActivePage + 1u ) % EEPROM_PAGES;
+    gu16Sequence++;
+    gu8NextRecord = 0u;
+    sHeader.u16Sequence = gu16Sequence;
+    sHeader.u16SequenceInv = ~gu16Sequence;
+    if( FALSE == gbitNextErased )
     {
-      IAP_Erase( (U16)gpsNextSaveSlot );
+      IAP_Erase( (U16)gu8ActivePage * EEPROM_PAGE_SIZE );
     }
+    gbitNextErased = FALSE;
+    IAP_Write( (U16)gu8ActivePage * EEPROM_PAGE_SIZE, (U8*)&sHeader, sizeof( S_PERSIST_PAGE_HEADER ) );
+    IAP_Write( SNAPSHOT_ADDRESS( gu8ActivePage ), (U8*)&sLocalCopy, sizeof( S_PERSIST ) );
+  }
+  else if( 0u != u8Records )
+  {
+    // Write EEPROM
+    IAP_Write( RECORD_ADDRESS( gu8ActivePage, gu8NextRecord ), (U8*)asRecords, u8Records * sizeof( S_PERSIST_RECORD ) );
+    gu8NextRecord += u8Records;
+  }
+  memcpy( &gsStoredData, &sLocalCopy, sizeof( S_PERSIST ) );
+  gbitDirty = FALSE;
+#if PERSIST_RETAIN
+  Retain();
+#endif
+  Util_TimerStop( UTIL_TIMER_PERSIST );
+  UTIL_TRACE_EVENT( UTIL_TRACE_SAVE, u8Records );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Marks the persistent data structure as changed, to be saved later
+//! \param  -
+//! \return -
+//! \global gbitDirty, gsRetained
+//! \note   Each call restarts the delay, so quick successive changes are written only once.
+//!         After Persist_SetWriteThrough() it saves at once instead. With PERSIST_RETAIN the change
+//!         is kept over a warm reset from now on, saved or not.
+//-----------------------------------------------------------------------------
+void Persist_SaveLater( void )
+{
+  gbitDirty = TRUE;
+#if PERSIST_RETAIN
+  Retain();
+#endif
+  if( gbitWriteThrough )
+  {
+    Persist_Save();
+  }
+  else
+  {
+    Util_TimerStart( UTIL_TIMER_PERSIST, SAVE_DELAY_MS );
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Writes the deferred save now, and every further change at once
+//! \param  -
+//! \return -
+//! \global gbitWriteThrough
+//! \note   For a weak cell, which may die before a deferred save is due. Lasts until the next
+//!         reset; a save costs only the flash words of the changed bytes.
+//-----------------------------------------------------------------------------
+void Persist_SetWriteThrough( void )
+{
+  gbitWriteThrough = TRUE;
+  Persist_Flush();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Writes the deferred save when the delay has elapsed
+//! \param  -
+//! \return -
+//! \global gbitDirty
+//! \note   Should be called from main cycle.
+//-----------------------------------------------------------------------------
+void Persist_Cycle( void )
+{
+  if( Util_TimerExpired( UTIL_TIMER_PERSIST ) )
+  {
+    Persist_Flush();
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Writes the deferred save right now, if there is one
+//! \param  -
+//! \return -
+//! \global gbitDirty
+//! \note   Should be called before power-down, or before the saved data get changed temporarily.
+//-----------------------------------------------------------------------------
+void Persist_Flush( void )
+{
+  if( TRUE == gbitDirty )
+  {
+    Persist_Save();
   }
 }
 
+//----------------------------------------------------------------------------
+//! \brief  Writes a data block to the flash
+//! \param  u32Address: Start address to be written, in a reserved flash area
+//! \param  pu8Data: pointer to the data to be written
+//! \param  u8DataLength: write length, must not cross a page boundary
+//! \return -
+//! \global gau32PageBuffer[]
+//! \note   Sleeps meanwhile, see FlashSleep(). The flash can only be programmed a whole page at once: the other words
+//!         of the page are programmed as all ones, which leaves them unchanged, so every word is
+//!         programmed only once between two erases.
+//-----------------------------------------------------------------------------
+void Persist_WriteFlash( U32 u32Address, const U8* pu8Data, U8 u8DataLength )
+{
+  memset( gau32PageBuffer, 0xFF, EEPROM_PAGE_SIZE );
+  memcpy( (U8*)gau32PageBuffer + ( u32Address & ( EEPROM_PAGE_SIZE - 1u ) ), pu8Data, u8DataLength );
+  FlashUnlock();
+  FlashProgramPage( u32Address & ~( EEPROM_PAGE_SIZE - 1u ) );
+  FlashFinish( FLASH_CR_PG );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Erases one page of the flash
+//! \param  u32Address: Address in the page, in a reserved flash area; the lower 7 bits are discarded
+//! \return -
+//! \global -
+//! \note   Sleeps meanwhile, see FlashSleep().
+//-----------------------------------------------------------------------------
+void Persist_EraseFlash( U32 u32Address )
+{
+  FlashUnlock();
+  FLASH->CR |= FLASH_CR_PER;
+  FlashErasePage( u32Address & ~( EEPROM_PAGE_SIZE - 1u ) );
+  FlashFinish( FLASH_CR_PER );
+}
+
 #warning "Test this module!"
-#warning "Port to PY32F002!"
 
 /***************************************< End of file >**************************************/
@@ -13,16 +13,53 @@
 
 /***************************************< Includes >**************************************/
 #include "util.h"
+#include "led.h"
+#include "animation.h"
+#include "stats.h"
+#include "schedule.h"
 
 
 /***************************************< Definitions >**************************************/
+#define PERSIST_VERSION            (6u)     //!< Version of the S_PERSIST layout, increase when adding a field
+#define PERSIST_OPTION_SKIP_GAUGE  (0x01u)  //!< Option bit: start the animation right away, without the battery gauge
+#define PERSIST_OPTION_AUTO_CYCLE  (0x02u)  //!< Option bit: step through the playlist by itself, see AUTO_CYCLE_MIN
+#define PERSIST_OPTION_SPEED       (0x0Cu)  //!< Option bits: playback rate of the animations, see Animation_SetSpeed(); 0: real time
+#define PERSIST_OPTION_SPEED_SHIFT (2u)     //!< Position of PERSIST_OPTION_SPEED in the option bits
+#define PERSIST_OPTION_SCHEDULE    (0x10u)  //!< Option bit: the auto-off wakes up for the next run of the schedule, see schedule.c
+#define PERSIST_BRIGHTNESS_FULL    (3u)     //!< Brightness setting of full light output, lower values dim
+#define PERSIST_AUTO_OFF_MIN       (300u)   //!< Default automatic power-down time: 5 hours
+#define PERSIST_UPLOAD_BASE        (0x08004800u)  //!< Start of the flash area of the uploaded animation, see the linker file
+#define PERSIST_UPLOAD_SIZE        (1024u)  //!< Number of bytes in the flash area of the uploaded animation, right below the journal
+#ifndef PERSIST_RETAIN
+#define PERSIST_RETAIN             (1u)     //!< 1: the state of the module is kept in RAM not initialized at startup, a warm reset doesn't read the journal
+#endif
 
 
 /***************************************< Types >**************************************/
 //! \brief Structure for persistent data
+//! \note  Read and checked as a whole, with one CRC. New fields go before the CRC, with a new
+//!        PERSIST_VERSION, and get their defaults in Persist_Init() when an older record is loaded.
+//!        PACKED is empty on the Cortex-M0+, so keep every field naturally aligned: the CRC covers
+//!        the bytes before u16CRC, the padding after it only rounds the size up to a whole number
+//!        of flash words, and the journal records after the snapshot don't share them.
 typedef PACKED struct
 {
+  U8  u8Version;                    //!< Layout version of the record (PERSIST_VERSION)
   U8  u8AnimationIndex;             //!< Index of the last played animation
+  U8  u8Options;                    //!< Option bits (PERSIST_OPTION_...)
+  U8  u8Brightness;                 //!< Global brightness setting, 0..PERSIST_BRIGHTNESS_FULL
+  U32 u32Playlist;                  //!< Bit mask of the favorite animations played by the button; 0: all of them
+  U16 u16AutoOffMin;                //!< Automatic power-down time in minutes; 0: never
+  U8  au8LEDTrim[ LEDS_NUM ];       //!< Calibration of the LEDs, see LED_SetTrims(); 0: untrimmed (version 2)
+  U16 u16SchedulePeriodMin;         //!< Period of the runs of the schedule in minutes, see schedule.c (version 5; reserved, 0 since version 3)
+  U32 u32UsedUah;                   //!< Charge drawn from the cell by the LEDs in uAh, see BatteryLevel_GetUsedUah() (version 3)
+  U32 u32OnMin;                     //!< Time the LEDs have been driven in minutes, see stats.c (version 4)
+  U32 u32Presses;                   //!< Presses of the button (version 4)
+  U32 u32Saves;                     //!< Calls of Persist_Save(), i.e. writes of the journal (version 4)
+  U16 au16Resets[ STATS_RESET_CAUSES ];    //!< Resets by cause, E_STATS_RESET (version 4)
+  U16 au16AnimationMin[ NUM_ANIMATIONS ];  //!< Time played of each animation in minutes (version 4)
+  U16 u16LEDFaultMask;              //!< LEDs ever found open or shorted by the fault check, see LED_GetFaults() (version 6)
+  U16 u16LEDFaults;                 //!< Faults found by the fault check (version 6)
   U16 u16CRC;                       //!< CRC for protecting structure against bit errors
 } S_PERSIST;
 
@@ -37,6 +74,12 @@ extern DATA S_PERSIST gsPersistentData;
 /***************************************< Public functions >**************************************/
 void Persist_Init( void );
 void Persist_Save( void );
+void Persist_SaveLater( void );
+void Persist_Cycle( void );
+void Persist_Flush( void );
+void Persist_SetWriteThrough( void );
+void Persist_WriteFlash( U32 u32Address, const U8* pu8Data, U8 u8DataLength );
+void Persist_EraseFlash( U32 u32Address );
 
 
 #endif /* PERSIST_H */
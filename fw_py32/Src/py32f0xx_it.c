@@ -27,6 +27,10 @@
 #include "util.h"
 #include "led.h"
 #include "rgbled.h"
+#include "sensor.h"
+#include "button.h"
+#include "bus.h"
+#include "stream.h"
 
 /* Private includes ----------------------------------------------------------*/
 
@@ -76,6 +80,9 @@ void SVC_Handler(void)
   */
 void PendSV_Handler(void)
 {
+#if SLEEP_ON_EXIT
+  Main_Cycle();
+#endif
 }
 
 /**
@@ -83,6 +90,9 @@ void PendSV_Handler(void)
   */
 void SysTick_Handler(void)
 {
+#if UTIL_SYSTICK_MS
+  Util_TickInterrupt();  // the global timer
+#endif
 }
 
 /******************************************************************************/
@@ -95,15 +105,127 @@ void SysTick_Handler(void)
 //! \brief  Timer 1 interrupt handler (10 kHz)
 //! \param  -
 //! \return -
+//! \note   Runs at IRQ_PRIORITY_LED, above every other interrupt. The pin and compare updates come
+//!         first, so their jitter doesn't depend on anything else; the animation never runs here.
+//!         With ISR_IN_RAM it runs from RAM with all its callees, the vector is fetched from flash.
 //-----------------------------------------------------------------------------
-void TIM1_BRK_UP_TRG_COM_IRQHandler( void )
+ISR_CODE void TIM1_BRK_UP_TRG_COM_IRQHandler( void )
 {
-  Util_Interrupt();  // Housekeeping, e.g. ms delay timer
-  LED_Interrupt();  // Soft-PWM LED driver
-  RGBLED_Interrupt();  // RGB LED driver
+  U8 u8Ticks;
+#if UTIL_PROFILING
+  U32 u32Start = Util_ProfileStart();
+#endif
+  
+  UTIL_PROBE_HIGH( PROBE_LED_IRQ_PIN );
+  UTIL_TRACE_EVENT( UTIL_TRACE_LED_IRQ, 0u );
+  UTIL_PROBE_HIGH( PROBE_LED_PIN );
+  u8Ticks = LED_Interrupt();  // Soft-PWM LED driver
+  UTIL_PROBE_LOW( PROBE_LED_PIN );
+#if SENSOR_DARK_SLOTS
+  if( 0u != gu8LEDDarkTicks )
+  {
+    Sensor_DarkSlot( gu8LEDDarkTicks );  // a waiting ADC conversion samples while the LEDs are dark
+  }
+#endif
+#if SENSOR_PROBE_SLOTS
+  if( gbitLEDProbeSlot )
+  {
+    Sensor_ProbeSlot();  // a waiting ADC conversion samples while the LED probed is lit alone
+  }
+#endif
+  UTIL_PROBE_HIGH( PROBE_RGBLED_PIN );
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+  RGBLED_Interrupt( gu8LEDNextRGB );  // RGB LED driver
+#else
+#if LED_RGB_SCHEDULE
+  RGBLED_Interrupt( gu8LEDRGBThreshold );  // RGB LED driver
+#else
+  RGBLED_Interrupt( 0u );  // RGB LED driver
+#endif
+#endif
+  UTIL_PROBE_LOW( PROBE_RGBLED_PIN );
+  Util_Interrupt( u8Ticks );  // Housekeeping, e.g. ms delay timer, may pend the main cycle
   // End of interrupt
   LL_TIM_ClearFlag_UPDATE( TIM1 );
+  UTIL_TRACE_EVENT( UTIL_TRACE_LED_IRQ_END, u8Ticks );
+#if UTIL_PROFILING
+  Util_ProfileEnd( UTIL_PROFILE_LED_IRQ, u32Start );
+#endif
+  UTIL_PROBE_LOW( PROBE_LED_IRQ_PIN );
+}
+
+
+//----------------------------------------------------------------------------
+//! \brief  LPTIM interrupt handler, wakes up from tickless sleep
+//! \param  -
+//! \return -
+//-----------------------------------------------------------------------------
+void LPTIM1_IRQHandler( void )
+{
+  Util_WakeupInterrupt();
+#if UTIL_CLOCK_CAL
+  Main_PostEvent( MAIN_TASK_CLOCK_CAL );  // the end of a calibration window
+#endif
+}
+
+
+//----------------------------------------------------------------------------
+//! \brief  EXTI interrupt handler of the pushbutton (both edges), and of the bus with BUS_ENABLE
+//! \param  -
+//! \return -
+//! \note   It stamps the edge and wakes the button task up, even from stop mode; the task reads
+//!         the pin, debounces it and decodes the gestures. An edge of the bus wakes the phase lock.
+//-----------------------------------------------------------------------------
+void EXTI4_15_IRQHandler( void )
+{
+#if BUS_ENABLE
+  if( LL_EXTI_IsActiveFlag( BUS_EXTI_LINE ) )
+  {
+    LL_EXTI_ClearFlag( BUS_EXTI_LINE );
+    Bus_Interrupt();
+    Main_PostEvent( MAIN_TASK_SYNC );
+  }
+  if( !LL_EXTI_IsActiveFlag( BUTTON_EXTI_LINE ) )
+  {
+    return;
+  }
+#endif
+  LL_EXTI_ClearFlag( BUTTON_EXTI_LINE );
+  Button_Interrupt();
+  Main_PostEvent( MAIN_TASK_BUTTON );
+}
+
+
+//----------------------------------------------------------------------------
+//! \brief  ADC interrupt handler of the sensor service
+//! \param  -
+//! \return -
+//! \note   The battery task, the only client of the sensors, is woken up by a completed result.
+//-----------------------------------------------------------------------------
+void ADC_COMP_IRQHandler( void )
+{
+  if( Sensor_Interrupt() )
+  {
+    Main_PostEvent( MAIN_TASK_BATTERY );
+  }
+}
+
+
+#if STREAM_ENABLE
+//----------------------------------------------------------------------------
+//! \brief  USART1 interrupt handler of the frame stream
+//! \param  -
+//! \return -
+//! \note   The animation task, which shows the frames, is woken up by a completed one.
+//-----------------------------------------------------------------------------
+void USART1_IRQHandler( void )
+{
+  if( Stream_Interrupt() )
+  {
+    Main_PostEvent( MAIN_TASK_ANIMATION );
+  }
 }
+#endif
 
 
 /************************ (C) COPYRIGHT Puya *****END OF FILE****/
@@ -32,6 +32,8 @@ extern "C" {
 #endif
 
 /* Private includes ----------------------------------------------------------*/
+#include "main.h"
+#include "types.h"
 
 /* Exported types ------------------------------------------------------------*/
 
@@ -45,6 +47,7 @@ void HardFault_Handler(void);
 void SVC_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
+ISR_CODE void TIM1_BRK_UP_TRG_COM_IRQHandler(void);
 
 #ifdef __cplusplus
 }
@@ -16,11 +16,32 @@
 // Own includes
 #include "types.h"
 #include "rgbled.h"
+#include "led.h"
+#include "util.h"
 
 
 /***************************************< Definitions >**************************************/
 #define COLOR_LEVELS       (16u)  //!< Number of brightness levels per color
-#define PWM_BRIGHT         (36u)  //!< PWM duty cycle for bright color -- 3 us pulse
+#define TIM1_PERIOD        ( ( 100u * SYSCLK_MHZ ) / LED_TICK_DIVIDER )  //!< TIM1 counts per period: 100 us divided by the tick divider
+#define PWM_BRIGHT         ( ( 3u * SYSCLK_MHZ ) / LED_TICK_DIVIDER )  //!< PWM duty cycle for bright color -- 3 us pulse per 100 us
+#define PWM_TRIM( trim )   ( ( PWM_BRIGHT * (trim) + 50u ) / 100u )     //!< Trimmed duty cycle of a color
+
+#if RGBLED_SUPPLY_COMP
+#define PWM_LONGEST( trim ) ( ( PWM_TRIM( trim ) * RGBLED_COMP_MAX ) / 100u )  //!< Longest compensated duty cycle of a color
+#else
+#define PWM_LONGEST( trim ) PWM_TRIM( trim )
+#endif
+
+#if ( PWM_LONGEST( RGBLED_TRIM_RED ) >= TIM1_PERIOD ) || ( PWM_LONGEST( RGBLED_TRIM_GREEN ) >= TIM1_PERIOD ) || ( PWM_LONGEST( RGBLED_TRIM_BLUE ) >= TIM1_PERIOD )
+#error "RGBLED_TRIM_*: the pulse must be shorter than the timer period, with RGBLED_SUPPLY_COMP the longest one!"
+#endif
+
+#if ( LED_PWM_BITS > 4u ) && ( SYSCLK_MHZ < 16u )
+#error "SYSCLK_MHZ: the shortest bit-plane is too short for the interrupt below 16 MHz!"
+#endif
+#if LED_FAST_REFRESH && ( SYSCLK_MHZ < 24u )
+#error "SYSCLK_MHZ: the shortest bit-plane of the fast refresh is too short for the interrupt below 24 MHz!"
+#endif
 #define PWM_DARK            (0u)  //!< PWM duty cycle for darkness
 
 
@@ -28,12 +49,37 @@
 
 
 /***************************************< Constants >**************************************/
+//! \brief Duty cycle of each color at full brightness: red, green, blue
+static CODE const U16 gcau16PulseBright[ NUM_RGBLED_COLORS ] =
+{
+  PWM_TRIM( RGBLED_TRIM_RED ), PWM_TRIM( RGBLED_TRIM_GREEN ), PWM_TRIM( RGBLED_TRIM_BLUE )
+};
+
+#if RGBLED_SUPPLY_COMP
+//! \brief Forward voltage of each color in mV: red, green, blue
+static CODE const U16 gcau16ForwardMv[ NUM_RGBLED_COLORS ] =
+{
+  RGBLED_VF_RED_MV, RGBLED_VF_GREEN_MV, RGBLED_VF_BLUE_MV
+};
+#endif
 
 
 /***************************************< Global variables >**************************************/
 //! \brief Global array for RGB LED color values
 //! \note  Value set is between [0; COLOR_LEVELS)
 volatile U8 gau8RGBLEDs[ NUM_RGBLED_COLORS ];
+static volatile U16 gau16PulseWidth[ NUM_RGBLED_COLORS ];  //!< PWM duty cycle of each color, scaled by the global brightness
+static U8 gu8LastColors;  //!< Colors of the compare values written last
+#if RGBLED_SUPPLY_COMP
+static U16 gau16PulseFull[ NUM_RGBLED_COLORS ] =  //!< Duty cycle of each color at full brightness, for the supply; kept over RGBLED_Init()
+{
+  PWM_TRIM( RGBLED_TRIM_RED ), PWM_TRIM( RGBLED_TRIM_GREEN ), PWM_TRIM( RGBLED_TRIM_BLUE )
+};
+static U16 gu16SupplyMv;  //!< Supply gau16PulseFull[] is computed for; 0: none yet, the trimmed widths
+static U8  gu8Level = LED_DIM_FULL;  //!< Global brightness of the last RGBLED_SetBrightness()
+#else
+#define gau16PulseFull  gcau16PulseBright  //!< Without the compensation the trimmed widths are the full ones
+#endif
 
 
 /***************************************< Static function definitions >**************************************/
@@ -47,21 +93,60 @@ volatile U8 gau8RGBLEDs[ NUM_RGBLED_COLORS ];
 //! \brief  Initialize hardware and software layer
 //! \param  -
 //! \return -
-//! \global gau8RGBLEDs
+//! \global gau8RGBLEDs, gau16PulseWidth[], gau16PulseFull[]
+//! \note   With UTIL_REGISTER_INIT the timer registers are written as a whole, to the same values
+//!         LL_TIM_OC_Init() and LL_TIM_Init() would leave, so it doesn't rely on their reset state.
 //-----------------------------------------------------------------------------
 void RGBLED_Init( void )
 {
+#if !UTIL_REGISTER_INIT
   LL_GPIO_InitTypeDef TIM1CH1MapInit= {0};
   LL_TIM_OC_InitTypeDef TIM_OC_Initstruct ={0};
   LL_TIM_InitTypeDef TIM1CountInit = {0};
+#endif
 
   // Initialize global variables
   memset( (U8*)gau8RGBLEDs, 0, NUM_RGBLED_COLORS );
+  memcpy( (U16*)gau16PulseWidth, gau16PulseFull, sizeof( gcau16PulseBright ) );
+  gu8LastColors = 0u;  // matches the dark compare values below
+#if RGBLED_SUPPLY_COMP
+  gu8Level = LED_DIM_FULL;
+#endif
   
   // Enable clocks
   LL_APB1_GRP2_EnableClock( LL_APB1_GRP2_PERIPH_TIM1 );
   LL_IOP_GRP1_EnableClock( LL_IOP_GRP1_PERIPH_GPIOA );
   
+#if UTIL_REGISTER_INIT
+  // Initialize GPIO pins: PA0/PA1 as TIM1_CH3/TIM1_CH4, PA9 as TIM1_CH2
+  Util_GPIO_Init( GPIOA, LL_GPIO_PIN_0 | LL_GPIO_PIN_1, LL_GPIO_MODE_ALTERNATE, LL_GPIO_SPEED_FREQ_LOW, LL_GPIO_PULL_NO, LL_GPIO_AF_13 );
+  Util_GPIO_Init( GPIOA, LL_GPIO_PIN_9, LL_GPIO_MODE_ALTERNATE, LL_GPIO_SPEED_FREQ_LOW, LL_GPIO_PULL_NO, LL_GPIO_AF_2 );
+  
+  // Stop, upcounting, no clock division; PWM channels off while they are set up
+  WRITE_REG( TIM1->CR1, LL_TIM_COUNTERMODE_UP | LL_TIM_CLOCKDIVISION_DIV1 );
+  WRITE_REG( TIM1->CCER, 0u );
+  // PWM1 on CH2..CH4, idle high
+  WRITE_REG( TIM1->CR2, TIM_CR2_OIS2 | TIM_CR2_OIS3 | TIM_CR2_OIS4 );
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+  // Compare values are written one bit-plane ahead, they take effect at the next update event
+  WRITE_REG( TIM1->CCMR1, ( LL_TIM_OCMODE_PWM1 << 8u ) | TIM_CCMR1_OC2PE );
+  WRITE_REG( TIM1->CCMR2, LL_TIM_OCMODE_PWM1 | ( LL_TIM_OCMODE_PWM1 << 8u ) | TIM_CCMR2_OC3PE | TIM_CCMR2_OC4PE );
+#else
+  WRITE_REG( TIM1->CCMR1, LL_TIM_OCMODE_PWM1 << 8u );
+  WRITE_REG( TIM1->CCMR2, LL_TIM_OCMODE_PWM1 | ( LL_TIM_OCMODE_PWM1 << 8u ) );
+#endif
+  WRITE_REG( TIM1->CCR2, PWM_DARK );
+  WRITE_REG( TIM1->CCR3, PWM_DARK );
+  WRITE_REG( TIM1->CCR4, PWM_DARK );
+  // Enabled, active low
+  WRITE_REG( TIM1->CCER, TIM_CCER_CC2E | TIM_CCER_CC2P | TIM_CCER_CC3E | TIM_CCER_CC3P | TIM_CCER_CC4E | TIM_CCER_CC4P );
+  
+  // Initialize TIM1 base
+  WRITE_REG( TIM1->ARR, TIM1_PERIOD - 1u );  // Period: 100 usec / 10 kHz at any system clock, divided by the tick divider
+  WRITE_REG( TIM1->PSC, 0u );
+  WRITE_REG( TIM1->RCR, 0u );
+  WRITE_REG( TIM1->EGR, TIM_EGR_UG );  // load the prescaler, the repetition counter and the preloaded compare values now
+#else
   // Initialize GPIO pins
   /* Initialize PA0/PA1 as TIM1_CH3/TIM1_CH4 */
   TIM1CH1MapInit.Pin        = LL_GPIO_PIN_0 | LL_GPIO_PIN_1;
@@ -89,14 +174,21 @@ void RGBLED_Init( void )
   // Set CH4
   TIM_OC_Initstruct.CompareValue  = PWM_DARK;
   LL_TIM_OC_Init( TIM1, LL_TIM_CHANNEL_CH4, &TIM_OC_Initstruct );
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+  // Compare values are written one bit-plane ahead, they take effect at the next update event
+  LL_TIM_OC_EnablePreload( TIM1, LL_TIM_CHANNEL_CH2 );
+  LL_TIM_OC_EnablePreload( TIM1, LL_TIM_CHANNEL_CH3 );
+  LL_TIM_OC_EnablePreload( TIM1, LL_TIM_CHANNEL_CH4 );
+#endif
   
   // Initialize TIM1 base
   TIM1CountInit.ClockDivision       = LL_TIM_CLOCKDIVISION_DIV1;
   TIM1CountInit.CounterMode         = LL_TIM_COUNTERMODE_UP;
-  TIM1CountInit.Prescaler           = 1;
-  TIM1CountInit.Autoreload          = 1200u - 1u;  // Period: 100 usec / 10 kHz @ 24 MHz system clock
+  TIM1CountInit.Prescaler           = 0;
+  TIM1CountInit.Autoreload          = TIM1_PERIOD - 1u;  // Period: 100 usec / 10 kHz at any system clock, divided by the tick divider
   TIM1CountInit.RepetitionCounter   = 0;
   LL_TIM_Init( TIM1, &TIM1CountInit );
+#endif
 
   // Enable output drive
   LL_TIM_EnableAllOutputs( TIM1 );
@@ -105,58 +197,162 @@ void RGBLED_Init( void )
   LL_TIM_EnableCounter( TIM1 );
 }
 
+#if LED_DRIVER_MODE == LED_MODE_BITPLANE
+//----------------------------------------------------------------------------
+//! \brief  Interrupt routine for timer-controlled RGB LED driver, bit-plane mode
+//! \param  u8Colors: colors to be pulsed in the segment starting at the next update event (bit 0: red)
+//! \return -
+//! \global gu8LastColors, gau16PulseWidth[]
+//! \note   Should be called from the TIM1 update interrupt, after LED_Interrupt().
+//!         A pulse is emitted in every timer period of the segment if the bit of the color is set.
+//!         The bits are precomputed by LED_Commit() from gau8RGBLEDs[], so the color pattern of a
+//!         whole frame is prepared once. Registers are only touched when the colors change.
+//-----------------------------------------------------------------------------
+ISR_CODE void RGBLED_Interrupt( U8 u8Colors )
+{
+  // Preloaded compare values stay in effect, no need to write the same ones again
+  if( u8Colors != gu8LastColors )
+  {
+    gu8LastColors = u8Colors;
+    // Red
+    LL_TIM_OC_SetCompareCH2( TIM1, ( u8Colors & 0x01u ) ? gau16PulseWidth[ 0u ] : PWM_DARK );
+    // Green
+    LL_TIM_OC_SetCompareCH3( TIM1, ( u8Colors & 0x02u ) ? gau16PulseWidth[ 1u ] : PWM_DARK );
+    // Blue
+    LL_TIM_OC_SetCompareCH4( TIM1, ( u8Colors & 0x04u ) ? gau16PulseWidth[ 2u ] : PWM_DARK );
+  }
+}
+#else
 //----------------------------------------------------------------------------
 //! \brief  Interrupt routine for timer-controlled RGB LED driver
-//! \param  -
+//! \param  u8Colors: with LED_RGB_SCHEDULE the threshold of the tick, gu8LEDRGBThreshold; not used otherwise
 //! \return -
-//! \global gau8RGBLEDs
-//! \note   Should be called from periodic timer interrupt routine.
+//! \global gau8RGBLEDs, gu8LastColors, gau16PulseWidth[]
+//! \note   Should be called from periodic timer interrupt routine, after LED_Interrupt().
+//!         With LED_RGB_SCHEDULE a color of level n is pulsed in the n ticks with the fewest LEDs
+//!         lit, otherwise in a block of n ticks.
+//!         The compare registers are only written when a color turns on or off, so a dark or
+//!         steady RGB LED costs the three comparisons only.
 //-----------------------------------------------------------------------------
-void RGBLED_Interrupt( void )
+ISR_CODE void RGBLED_Interrupt( U8 u8Colors )
 {
+#if LED_RGB_SCHEDULE
+  U8 u8Cnt = u8Colors;
+#else
   static U8 u8Cnt = 0u;
+#endif
+  U8 u8Bits = 0u;
   
-  // Red
-  if( gau8RGBLEDs[ 0 ] > u8Cnt )
+#if !LED_RGB_SCHEDULE
+  (void)u8Colors;
+#endif
+  if( gau8RGBLEDs[ 0 ] > u8Cnt )  // Red
   {
-    // Pulse for 1 usec
-    LL_TIM_OC_SetCompareCH2( TIM1, PWM_BRIGHT );
+    u8Bits |= 0x01u;
   }
-  else
+  if( gau8RGBLEDs[ 1 ] > u8Cnt )  // Green
   {
-    // No pulse
-    LL_TIM_OC_SetCompareCH2( TIM1, PWM_DARK );
+    u8Bits |= 0x02u;
   }
-  
-  // Green
-  if( gau8RGBLEDs[ 1 ] > u8Cnt )
+  if( gau8RGBLEDs[ 2 ] > u8Cnt )  // Blue
   {
-    // Pulse for 1 usec
-    LL_TIM_OC_SetCompareCH3( TIM1, PWM_BRIGHT );
+    u8Bits |= 0x04u;
   }
-  else
+  if( u8Bits != gu8LastColors )
   {
-    // No pulse
-    LL_TIM_OC_SetCompareCH3( TIM1, PWM_DARK );
+    gu8LastColors = u8Bits;
+    // Pulse for about 3 usec, or no pulse
+    LL_TIM_OC_SetCompareCH2( TIM1, ( u8Bits & 0x01u ) ? gau16PulseWidth[ 0u ] : PWM_DARK );
+    LL_TIM_OC_SetCompareCH3( TIM1, ( u8Bits & 0x02u ) ? gau16PulseWidth[ 1u ] : PWM_DARK );
+    LL_TIM_OC_SetCompareCH4( TIM1, ( u8Bits & 0x04u ) ? gau16PulseWidth[ 2u ] : PWM_DARK );
   }
-  
-  // Blue
-  if( gau8RGBLEDs[ 2 ] > u8Cnt )
+#if !LED_RGB_SCHEDULE
+  u8Cnt++;
+  if( COLOR_LEVELS <= u8Cnt )
   {
-    // Pulse for 1 usec
-    LL_TIM_OC_SetCompareCH4( TIM1, PWM_BRIGHT );
+    u8Cnt = 0u;
   }
-  else
+#endif
+}
+#endif
+
+
+//----------------------------------------------------------------------------
+//! \brief  Scales the light output of the RGB LED by the pulse width
+//! \param  u8Level: global brightness, [0; LED_DIM_FULL]
+//! \return -
+//! \global gau16PulseWidth[], gu8LastColors, gau16PulseFull[]
+//! \note   Every step below LED_DIM_FULL halves the pulses, the color levels and the balance of the
+//!         colors are kept.
+//-----------------------------------------------------------------------------
+void RGBLED_SetBrightness( U8 u8Level )
+{
+  U8  u8Index;
+  U16 u16Width;
+  
+  if( u8Level > LED_DIM_FULL )
   {
-    // No pulse
-    LL_TIM_OC_SetCompareCH4( TIM1, PWM_DARK );
+    u8Level = LED_DIM_FULL;
   }
-  u8Cnt++;
-  if( COLOR_LEVELS <= u8Cnt )
+#if RGBLED_SUPPLY_COMP
+  gu8Level = u8Level;
+#endif
+  for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
   {
-    u8Cnt = 0u;
+    u16Width = gau16PulseFull[ u8Index ] >> ( LED_DIM_FULL - u8Level );
+    if( ( 0u == u16Width ) && ( 0u != gau16PulseFull[ u8Index ] ) )
+    {
+      u16Width = 1u;
+    }
+    gau16PulseWidth[ u8Index ] = u16Width;
   }
+  // Colors never exceed 0x07, so the next interrupt rewrites every compare value
+  gu8LastColors = 0xFFu;
 }
 
+#if RGBLED_SUPPLY_COMP
+//----------------------------------------------------------------------------
+//! \brief  Compensates the pulse widths for the supply voltage
+//! \param  u16Mv: battery voltage of the last measurement in mV; 0: not known
+//! \return -
+//! \global gau16PulseFull[], gu16SupplyMv, gu8Level
+//! \note   The current of a pulse follows the headroom of the color, the supply above its forward
+//!         voltage. So the trimmed width is stretched by the ratio of the headroom at
+//!         RGBLED_NOMINAL_MV to the one now, for each color on its own, up to RGBLED_COMP_MAX
+//!         percent; it gets shorter above the nominal supply. Nothing is computed if the voltage
+//!         doesn't change; should be called after every battery measurement.
+//-----------------------------------------------------------------------------
+void RGBLED_SetSupplyMv( U16 u16Mv )
+{
+  U8  u8Index;
+  U32 u32Width;
+  U32 u32Longest;
+  
+  if( u16Mv != gu16SupplyMv )
+  {
+    gu16SupplyMv = u16Mv;
+    for( u8Index = 0u; u8Index < NUM_RGBLED_COLORS; u8Index++ )
+    {
+      u32Width = gcau16PulseBright[ u8Index ];
+      u32Longest = ( u32Width * RGBLED_COMP_MAX ) / 100u;
+      if( 0u != u16Mv )
+      {
+        u32Width = u32Longest;
+        if( u16Mv > gcau16ForwardMv[ u8Index ] )
+        {
+          u32Width = ( (U32)gcau16PulseBright[ u8Index ] * ( RGBLED_NOMINAL_MV - gcau16ForwardMv[ u8Index ] )
+                     + ( u16Mv - gcau16ForwardMv[ u8Index ] ) / 2u ) / ( u16Mv - gcau16ForwardMv[ u8Index ] );
+        }
+        if( u32Width > u32Longest )
+        {
+          u32Width = u32Longest;
+        }
+      }
+      gau16PulseFull[ u8Index ] = (U16)u32Width;
+    }
+    RGBLED_SetBrightness( gu8Level );
+  }
+}
+#endif
 
 /***************************************< End of file >**************************************/
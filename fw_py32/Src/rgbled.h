@@ -17,6 +17,34 @@
 
 /***************************************< Definitions >**************************************/
 #define NUM_RGBLED_COLORS   (3u)  //!< Number of colors the RGB LED array has
+#ifndef RGBLED_TRIM_RED
+#define RGBLED_TRIM_RED     (100u)  //!< Pulse width of red in percent of the nominal one; balance the colors on the board
+#endif
+#ifndef RGBLED_TRIM_GREEN
+#define RGBLED_TRIM_GREEN   (100u)  //!< Pulse width of green in percent of the nominal one
+#endif
+#ifndef RGBLED_TRIM_BLUE
+#define RGBLED_TRIM_BLUE    (100u)  //!< Pulse width of blue in percent of the nominal one
+#endif
+#ifndef RGBLED_SUPPLY_COMP
+#define RGBLED_SUPPLY_COMP  (0)     //!< 1: the pulse widths follow the battery voltage, so the charge of a pulse and the balance of the colors stay, see RGBLED_SetSupplyMv()
+#endif
+#ifndef RGBLED_NOMINAL_MV
+#define RGBLED_NOMINAL_MV   (2800u) //!< Supply the trimmed pulse widths are meant for: a CR2032 under load
+#endif
+#ifndef RGBLED_VF_RED_MV
+#define RGBLED_VF_RED_MV    (1900u) //!< Forward voltage of red at the pulse current; measure it on the board
+#endif
+#ifndef RGBLED_VF_GREEN_MV
+#define RGBLED_VF_GREEN_MV  (2500u) //!< Forward voltage of green at the pulse current
+#endif
+#ifndef RGBLED_VF_BLUE_MV
+#define RGBLED_VF_BLUE_MV   (2550u) //!< Forward voltage of blue at the pulse current
+#endif
+#define RGBLED_COMP_MAX     (300u)  //!< Longest compensated pulse in percent of the trimmed one: a color near its forward voltage can't be made up for
+#if RGBLED_SUPPLY_COMP && ( ( RGBLED_VF_RED_MV >= RGBLED_NOMINAL_MV ) || ( RGBLED_VF_GREEN_MV >= RGBLED_NOMINAL_MV ) || ( RGBLED_VF_BLUE_MV >= RGBLED_NOMINAL_MV ) )
+#error "RGBLED_NOMINAL_MV: the nominal supply must be above the forward voltage of every color!"
+#endif
 
 
 /***************************************< Types >**************************************/
@@ -31,7 +59,13 @@ extern volatile U8 gau8RGBLEDs[ NUM_RGBLED_COLORS ];
 
 /***************************************< Public functions >**************************************/
 void RGBLED_Init( void );
-void RGBLED_Interrupt( void );
+ISR_CODE void RGBLED_Interrupt( U8 u8Colors );
+void RGBLED_SetBrightness( U8 u8Level );
+#if RGBLED_SUPPLY_COMP
+void RGBLED_SetSupplyMv( U16 u16Mv );
+#else
+#define RGBLED_SetSupplyMv( u16Mv )  ( (void)( u16Mv ) )
+#endif
 
 
 #endif /* RGBLED_H */
@@ -0,0 +1,265 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file runtime.c
+*
+* \brief Runtime plan: the animations are played and dimmed for a target runtime on one cell
+*
+* \author Hekk_Elek
+*
+* \note  The plan is made from the charge meter of batterylevel.c, every RUNTIME_REPLAN_MS and at
+*        every change of the animation: the charge left on the cell over the time left of
+*        RUNTIME_TARGET_MIN is the average current it affords. The driver levels are scaled down
+*        by the ratio of that to the current measured since the last plan, see LED_SetPlanDim(),
+*        and up again by twice at most a plan. The current of each animation is
+*        learned from the intervals it has played alone, at full scale: the auto-cycle mode skips
+*        the ones well above the plan, and shortens the steps of the ones above it, see
+*        Runtime_StepMs(). Only the current of the LEDs is counted, as by the meter; a unit on the
+*        USB supply isn't planned. The runtime on the cell is kept in RAM: after a reset it is
+*        estimated from the charge used, as if the plan had been kept so far. A few divisions a
+*        plan, nothing per frame.
+*
+**********************************************************************************************************/
+
+/***************************************< Includes >**************************************/
+// Own includes
+#include "main.h"
+#include "types.h"
+#include "util.h"
+#include "led.h"
+#include "animation.h"
+#include "persist.h"
+#include "batterylevel.h"
+#include "runtime.h"
+
+#if RUNTIME_PLAN
+
+/***************************************< Definitions >**************************************/
+#define MS_PER_MIN            (60000uL)  //!< Unit of the runtime target
+#define SCALE_FULL            (256u)     //!< Scale of the driver levels without dimming
+#define UA_NONE               (0u)       //!< Current of an animation not learned yet
+#define UA_UNLIMITED          (0xFFFFu)  //!< Current afforded after the target, or on the USB supply
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+static U32 gu32MarkMs;        //!< Start of the interval since the last plan
+static U32 gu32MarkUah;       //!< Charge used at gu32MarkMs, see BatteryLevel_GetUsedUah()
+static U8  gu8MarkAnimation;  //!< Animation played from gu32MarkMs on
+static U32 gu32OnMs;          //!< Runtime on the cell so far
+static BIT gbitOnKnown;       //!< gu32OnMs has been estimated from the charge used, at the first plan
+static U16 gu16AllowedUa = UA_UNLIMITED;  //!< Average current of the LEDs the rest of the cell affords
+static U8  gu8Dim;            //!< Scale-down of the driver levels, in 1/256, see LED_SetPlanDim()
+static U16 gau16AnimationUa[ NUM_ANIMATIONS ];  //!< Current of each animation at full scale; UA_NONE: not learned
+
+
+/***************************************< Static function definitions >**************************************/
+static void Replan( void );
+static U16  PredictedUa( U8 u8Animation );
+
+
+/***************************************< Private functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Closes the interval since the last plan, and makes the plan for the next one
+//! \param  -
+//! \return -
+//! \global All globals of this module
+//! \note   An interval shorter than RUNTIME_SAMPLE_MS isn't measured, it only counts for the
+//!         runtime: the meter is updated every 30 s. A cleared meter is a new cell.
+//-----------------------------------------------------------------------------
+static void Replan( void )
+{
+  U32 u32Now = Util_GetTimerMs32();
+  U32 u32Ms = u32Now - gu32MarkMs;
+  U32 u32Used = BatteryLevel_GetUsedUah();
+  U32 u32Capacity = ( BATTERY_SOURCE_AA == BatteryLevel_GetSource() ) ? RUNTIME_AA_UAH : RUNTIME_COIN_UAH;
+  U32 u32Ua = 0u;
+  U32 u32Left;
+  U32 u32Scale;
+  
+  if( u32Used < gu32MarkUah )
+  {
+    gu32OnMs = 0u;
+    gu32MarkUah = u32Used;
+  }
+  if( u32Used > u32Capacity )
+  {
+    u32Used = u32Capacity;
+  }
+  if( !gbitOnKnown )
+  {
+    gbitOnKnown = 1;
+    gu32OnMs += ( ( u32Used * RUNTIME_TARGET_MIN ) / u32Capacity ) * MS_PER_MIN;
+  }
+  gu32OnMs += u32Ms;
+  
+  // The current of the interval, and of its animation at full scale
+  if( u32Ms >= RUNTIME_SAMPLE_MS )
+  {
+    u32Ua = ( ( BatteryLevel_GetUsedUah() - gu32MarkUah ) * 3600u ) / ( u32Ms / 1000u );
+    if( gu8MarkAnimation < NUM_ANIMATIONS-1u )
+    {
+      u32Scale = ( u32Ua * SCALE_FULL ) / ( SCALE_FULL - gu8Dim );
+      if( u32Scale >= UA_UNLIMITED )
+      {
+        u32Scale = UA_UNLIMITED - 1u;
+      }
+      if( UA_NONE != gau16AnimationUa[ gu8MarkAnimation ] )
+      {
+        u32Scale = ( 3u * gau16AnimationUa[ gu8MarkAnimation ] + u32Scale ) / 4u;
+      }
+      gau16AnimationUa[ gu8MarkAnimation ] = ( UA_NONE != u32Scale ) ? (U16)u32Scale : 1u;
+    }
+  }
+  
+  // The current of the rest of the cell over the rest of the runtime
+  gu16AllowedUa = UA_UNLIMITED;
+  if( ( BATTERY_SOURCE_USB != BatteryLevel_GetSource() ) && ( gu32OnMs < ( RUNTIME_TARGET_MIN * MS_PER_MIN ) ) )
+  {
+    u32Left = ( RUNTIME_TARGET_MIN * MS_PER_MIN - gu32OnMs ) / MS_PER_MIN + 1u;
+    u32Left = ( ( u32Capacity - u32Used ) * 60u ) / u32Left;
+    gu16AllowedUa = ( u32Left < UA_UNLIMITED ) ? (U16)u32Left : UA_UNLIMITED - 1u;
+  }
+  
+  // The scale follows the ratio of the two, at most doubled a plan
+  u32Scale = SCALE_FULL;
+  if( UA_UNLIMITED != gu16AllowedUa )
+  {
+    u32Scale = SCALE_FULL - gu8Dim;
+    if( u32Ms >= RUNTIME_SAMPLE_MS )
+    {
+      if( ( 0u == u32Ua ) || ( ( u32Scale * gu16AllowedUa ) / u32Ua > 2u * u32Scale ) )
+      {
+        u32Scale *= 2u;
+      }
+      else
+      {
+        u32Scale = ( u32Scale * gu16AllowedUa ) / u32Ua;
+      }
+    }
+    if( u32Scale > SCALE_FULL )
+    {
+      u32Scale = SCALE_FULL;
+    }
+    else if( u32Scale < ( SCALE_FULL - RUNTIME_DIM_MAX ) )
+    {
+      u32Scale = SCALE_FULL - RUNTIME_DIM_MAX;
+    }
+  }
+  gu8Dim = (U8)( SCALE_FULL - u32Scale );
+  LED_SetPlanDim( gu8Dim );
+  
+  Runtime_Resume();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells the current of an animation at the scale of the plan
+//! \param  u8Animation: index of the animation
+//! \return Learned current in uA, scaled; UA_NONE if not learned yet
+//! \global gau16AnimationUa[], gu8Dim
+//-----------------------------------------------------------------------------
+static U16 PredictedUa( U8 u8Animation )
+{
+  U16 u16Ua = UA_NONE;
+  
+  if( u8Animation < NUM_ANIMATIONS-1u )
+  {
+    u16Ua = (U16)( ( (U32)gau16AnimationUa[ u8Animation ] * ( SCALE_FULL - gu8Dim ) ) / SCALE_FULL );
+  }
+  
+  return u16Ua;
+}
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Starts the plan
+//! \param  -
+//! \return -
+//! \global gu32MarkMs, gu32MarkUah, gu8MarkAnimation
+//! \note   Should be called in the init block, after BatteryLevel_Init(). The first plan is made
+//!         at the first change of the animation.
+//-----------------------------------------------------------------------------
+void Runtime_Init( void )
+{
+  Runtime_Resume();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Starts a new interval, without measuring the last one
+//! \param  -
+//! \return -
+//! \global gu32MarkMs, gu32MarkUah, gu8MarkAnimation
+//! \note   Should be called after the power-down, its time isn't runtime.
+//-----------------------------------------------------------------------------
+void Runtime_Resume( void )
+{
+  gu32MarkMs = Util_GetTimerMs32();
+  gu32MarkUah = BatteryLevel_GetUsedUah();
+  gu8MarkAnimation = gsPersistentData.u8AnimationIndex;
+  Util_TimerStart( UTIL_TIMER_RUNTIME, RUNTIME_REPLAN_MS );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Makes the plan again when it is due
+//! \param  -
+//! \return Time until it is due again in ms
+//! \global -
+//! \note   Should be called from main cycle, e.g. with the battery indicator.
+//-----------------------------------------------------------------------------
+U32 Runtime_Cycle( void )
+{
+  if( Util_TimerExpired( UTIL_TIMER_RUNTIME ) )
+  {
+    Replan();
+  }
+  
+  return Util_TimerLeftMs( UTIL_TIMER_RUNTIME );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Makes the plan for the animation just set, and weights its step of the auto-cycle mode
+//! \param  u32StepMs: step of an animation the plan affords
+//! \return Step of the animation: shorter by the ratio of the plan to its current, a quarter at least
+//! \global gu16AllowedUa
+//! \note   Should be called after every change of the animation, the interval is taken for the
+//!         previous one. An animation not learned yet plays the whole step, so it is learned.
+//-----------------------------------------------------------------------------
+U32 Runtime_StepMs( U32 u32StepMs )
+{
+  U32 u32Weighted = u32StepMs;
+  U16 u16Ua;
+  
+  Replan();
+  u16Ua = PredictedUa( gsPersistentData.u8AnimationIndex );
+  if( u16Ua > gu16AllowedUa )
+  {
+    u32Weighted = ( u32StepMs / u16Ua ) * gu16AllowedUa;
+    if( u32Weighted < ( u32StepMs / 4u ) )
+    {
+      u32Weighted = u32StepMs / 4u;
+    }
+  }
+  
+  return u32Weighted;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells if the plan affords an animation in the auto-cycle mode
+//! \param  u8Animation: index of the animation
+//! \return TRUE unless its learned current is more than twice the plan
+//! \global gu16AllowedUa
+//-----------------------------------------------------------------------------
+BOOL Runtime_Affords( U8 u8Animation )
+{
+  return ( PredictedUa( u8Animation ) / 2u ) <= gu16AllowedUa;
+}
+
+#endif /* RUNTIME_PLAN */
+
+/***************************************< End of file >**************************************/
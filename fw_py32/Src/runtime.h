@@ -0,0 +1,60 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file runtime.h
+*
+* \brief Runtime plan: the animations are played and dimmed for a target runtime on one cell
+*
+* \author Hekk_Elek
+*
+**********************************************************************************************************/
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+/***************************************< Includes >**************************************/
+#include "types.h"
+
+
+/***************************************< Definitions >**************************************/
+#ifndef RUNTIME_PLAN
+#define RUNTIME_PLAN          (0u)        //!< 1: the LEDs are dimmed for RUNTIME_TARGET_MIN on a cell, and the auto-cycle mode weights the animations by their current, see runtime.c
+#endif
+#ifndef RUNTIME_TARGET_MIN
+#define RUNTIME_TARGET_MIN    (300u)      //!< Runtime to reach on one cell: 5 hours
+#endif
+#ifndef RUNTIME_COIN_UAH
+#define RUNTIME_COIN_UAH      (180000uL)  //!< Charge the LEDs can draw from a CR2032: less than its 225 mAh under their pulsed load
+#endif
+#ifndef RUNTIME_AA_UAH
+#define RUNTIME_AA_UAH        (1000000uL) //!< Charge the LEDs can draw from a 2xAA or 2xAAA pack, the smaller one
+#endif
+#define RUNTIME_REPLAN_MS     (300000uL)  //!< The plan is made again this often, and at every change of the animation
+#define RUNTIME_SAMPLE_MS     (120000uL)  //!< An animation played this long alone gives a sample of its current; the charge meter counts every 30 s
+#define RUNTIME_DIM_MAX       (224u)      //!< Largest scale-down of the driver levels, in 1/256: an eighth of the light is left
+#if RUNTIME_PLAN && ( ( RUNTIME_TARGET_MIN < 1u ) || ( RUNTIME_TARGET_MIN > 2000u ) )
+#error "RUNTIME_TARGET_MIN: the runtime is planned in minutes of 32 bits, from 1 to 2000!"
+#endif
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+
+
+/***************************************< Public functions >**************************************/
+#if RUNTIME_PLAN
+void Runtime_Init( void );
+void Runtime_Resume( void );
+U32  Runtime_Cycle( void );
+U32  Runtime_StepMs( U32 u32StepMs );
+BOOL Runtime_Affords( U8 u8Animation );
+#endif
+
+
+#endif /* RUNTIME_H */
+
+/***************************************< End of file >**************************************/
@@ -0,0 +1,101 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file schedule.c
+*
+* \brief Daily schedule: the unit wakes itself from the power-down at the start of the next run
+*
+* \author Hekk_Elek
+*
+* \note  The PY32F002A has no RTC, so the time of day is not known: a run starts when the unit is
+*        switched on by hand, and lasts the auto-off time of gsPersistentData.u16AutoOffMin. With
+*        PERSIST_OPTION_SCHEDULE the power-down after it doesn't wait for the button only, it
+*        wakes itself u16SchedulePeriodMin after the start of the run, for the same hours of the
+*        next day. The stop mode is timed by the LPTIM on the LSI, in windows of SCHEDULE_SLEEP_MS:
+*        the CPU runs for some microseconds a minute, the LSI and the LPTIM take about a microamp.
+*        The LSI is the only clock through the night, so the start time drifts by its error,
+*        up to a few minutes a day; every start by hand sets it right again, so does the
+*        period of the persistent data trimmed for the board. The start is kept in RAM only, a
+*        new cell starts from its insertion.
+*
+**********************************************************************************************************/
+
+/***************************************< Includes >**************************************/
+// Own includes
+#include "main.h"
+#include "types.h"
+#include "util.h"
+#include "persist.h"
+#include "schedule.h"
+
+#if SCHEDULE_ENABLE
+
+/***************************************< Definitions >**************************************/
+#define MS_PER_MIN            (60000u)  //!< Unit of the saved times
+#define SCHEDULE_SLEEP_MS     (60000u)  //!< Longest stop of the LPTIM, see Util_Sleep()
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+static U32 gu32StartMs;  //!< Global timer at the start of the running period
+
+
+/***************************************< Static function definitions >**************************************/
+
+
+/***************************************< Private functions >**************************************/
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Starts a run by hand: the next one starts a period later
+//! \param  -
+//! \return -
+//! \global gu32StartMs
+//! \note   Should be called after the boot, and after every wakeup by the button.
+//-----------------------------------------------------------------------------
+void Schedule_Start( void )
+{
+  gu32StartMs = Util_GetTimerMs32();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Sleeps in stop mode until the start of the next run, or until the button is pressed
+//! \param  -
+//! \return TRUE if woken by the schedule; FALSE if by the button, the caller calls Schedule_Start()
+//! \global gu32StartMs, gsPersistentData
+//! \note   Should be called by the power-down instead of its own stop, with TIM1 stopped; the
+//!         global timer goes on with the time slept. A run longer than the period skips the
+//!         starts it has covered. Releases and bounces of the button are slept through.
+//-----------------------------------------------------------------------------
+BOOL Schedule_Sleep( void )
+{
+  U32 u32PeriodMs = (U32)gsPersistentData.u16SchedulePeriodMin * MS_PER_MIN;
+  U32 u32Left;
+  
+  if( ( 0u == gsPersistentData.u16SchedulePeriodMin ) || ( gsPersistentData.u16SchedulePeriodMin > SCHEDULE_PERIOD_MAX_MIN ) )
+  {
+    u32PeriodMs = SCHEDULE_PERIOD_MIN * MS_PER_MIN;
+  }
+  do
+  {
+    gu32StartMs += u32PeriodMs;
+  } while( Util_IsDeadlineReached( gu32StartMs ) );
+  
+  while( !Util_IsDeadlineReached( gu32StartMs ) && ( 1 == BUTTON_PIN ) )
+  {
+    u32Left = gu32StartMs - Util_GetTimerMs32();
+    Util_Sleep( (U16)( ( u32Left > SCHEDULE_SLEEP_MS ) ? SCHEDULE_SLEEP_MS : u32Left ) );
+  }
+  
+  return ( 1 == BUTTON_PIN );
+}
+
+#endif /* SCHEDULE_ENABLE */
+
+/***************************************< End of file >**************************************/
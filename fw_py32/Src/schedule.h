@@ -1,21 +1,26 @@
 /*! *******************************************************************************************************
-* Copyright (c) 2021-2022 Hekk_Elek
+* Copyright (c) 2022 Hekk_Elek
 *
-* \file animation.h
+* \file schedule.h
 *
-* \brief Implementation of LED animations
+* \brief Daily schedule: the unit wakes itself from the power-down at the start of the next run
 *
 * \author Hekk_Elek
 *
 **********************************************************************************************************/
-#ifndef ANIMATION_H
-#define ANIMATION_H
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
 
 /***************************************< Includes >**************************************/
+#include "types.h"
 
 
 /***************************************< Definitions >**************************************/
-#define NUM_ANIMATIONS        (12u)  //!< Number of animations implemented
+#ifndef SCHEDULE_ENABLE
+#define SCHEDULE_ENABLE       (0u)      //!< 1: with PERSIST_OPTION_SCHEDULE the auto-off sleeps until the start of the next run, see schedule.c
+#endif
+#define SCHEDULE_PERIOD_MIN   (1440u)   //!< Default period of the runs in minutes: a day
+#define SCHEDULE_PERIOD_MAX_MIN (28800u) //!< Longest period, the deadlines of the global timer reach 24 days
 
 
 /***************************************< Types >**************************************/
@@ -28,11 +33,12 @@
 
 
 /***************************************< Public functions >**************************************/
-void Animation_Init( void );
-void Animation_Cycle( void );
-void Animation_Set( U8 u8AnimationIndex );
+#if SCHEDULE_ENABLE
+void Schedule_Start( void );
+BOOL Schedule_Sleep( void );
+#endif
 
 
-#endif /* ANIMATION_H */
+#endif /* SCHEDULE_H */
 
 /***************************************< End of file >**************************************/
@@ -0,0 +1,335 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file sensor.c
+*
+* \brief Sensor service: owns the ADC, and converts the internal channels in the background
+*
+* \author Hekk_Elek
+*
+* \note  The modules request their sensors by Sensor_Request(), and take the results from the table
+*        of Sensor_GetSum() once Sensor_IsReady() tells so; nothing waits for the ADC. The requests
+*        are converted one sensor after the other, SENSOR_OVERSAMPLES conversions each, driven by
+*        the ADC interrupt; the PY32F002A has no DMA.
+*        The LED current sags the supply, which is the reference of the ADC, and switching it
+*        couples noise into the conversions. With SENSOR_DARK_SLOTS the dark sensors of gcasSensors[]
+*        take a conversion only in a dark segment of the LED drivers: the TIM1 interrupt starts it at
+*        the update event, and its sampling is over before the LEDs light again.
+*        SENSOR_VDD isn't dark: the sag of the cell is measured under the load of the frame, and
+*        the charge model counts with it. With SENSOR_PROBE_SLOTS SENSOR_VDD_PROBE takes a
+*        conversion only in a probe slot of the LED fault check, with the LED probed lit alone.
+*        The ambient light is timed on an LED pin by the LED driver, it takes no ADC.
+*
+**********************************************************************************************************/
+
+/***************************************< Includes >**************************************/
+// Own includes
+#include "main.h"
+#include "types.h"
+#include "util.h"
+#include "led.h"
+#include "sensor.h"
+
+
+/***************************************< Definitions >**************************************/
+#define SENSOR_NONE   ( SENSORS )  //!< gu8Active while no sensor is converting
+
+
+/***************************************< Types >**************************************/
+//! \brief States of the ADC
+typedef enum
+{
+  SENSOR_IDLE = 0u,    //!< Disabled, nothing requested
+  SENSOR_WAIT_DARK,    //!< Configured for a dark sensor, waiting for a dark segment
+  SENSOR_WAIT_PROBE,   //!< Configured for a probe sensor, waiting for a probe slot
+  SENSOR_CONVERT       //!< Converting
+} E_SENSOR_STATE;
+
+//! \brief Slots the conversions of a sensor are started in
+typedef enum
+{
+  SENSOR_SLOT_ANY = 0u,  //!< At once, whatever the LEDs show
+  SENSOR_SLOT_DARK,      //!< In the dark segments of the LED drivers, see Sensor_DarkSlot()
+  SENSOR_SLOT_PROBE      //!< In the probe slots of the LED fault check, see Sensor_ProbeSlot()
+} E_SENSOR_SLOT;
+
+//! \brief How a sensor is converted
+typedef struct
+{
+  U32  u32Channel;     //!< Channel of the sequencer
+  U32  u32Path;        //!< Internal path enabled for it
+  U8   u8Slot;         //!< Slots its conversions are started in (E_SENSOR_SLOT)
+} S_SENSOR;
+
+
+/***************************************< Constants >**************************************/
+//! \brief Channel and slots of each sensor, see E_SENSOR
+static CODE const S_SENSOR gcasSensors[ SENSORS ] =
+{
+  { LL_ADC_CHANNEL_VREFINT,    LL_ADC_PATH_INTERNAL_VREFINT,    SENSOR_SLOT_ANY },    // SENSOR_VDD
+  { LL_ADC_CHANNEL_TEMPSENSOR, LL_ADC_PATH_INTERNAL_TEMPSENSOR, SENSOR_DARK_SLOTS ? SENSOR_SLOT_DARK : SENSOR_SLOT_ANY },  // SENSOR_TEMPERATURE
+  { LL_ADC_CHANNEL_VREFINT,    LL_ADC_PATH_INTERNAL_VREFINT,    SENSOR_DARK_SLOTS ? SENSOR_SLOT_DARK : SENSOR_SLOT_ANY },  // SENSOR_VDD_DARK
+#if SENSOR_PROBE_SLOTS
+  { LL_ADC_CHANNEL_VREFINT,    LL_ADC_PATH_INTERNAL_VREFINT,    SENSOR_SLOT_PROBE }   // SENSOR_VDD_PROBE
+#endif
+};
+
+
+/***************************************< Global variables >**************************************/
+static volatile U8  gu8State = SENSOR_IDLE;   //!< State of the ADC (E_SENSOR_STATE)
+static volatile U8  gu8Active = SENSOR_NONE;  //!< Sensor converting, or waiting for a dark segment
+static volatile U8  gu8Pending;    //!< SENSOR_BIT() of the sensors requested, not started yet
+static volatile U8  gu8Ready;      //!< SENSOR_BIT() of the sensors converted since their request
+static volatile U16 gu16Sum;       //!< Sum of the conversions of the active sensor
+static volatile U8  gu8Count;      //!< Number of conversions summed
+static volatile U16 gu16WaitMs;    //!< Time of Util_GetTimerMs() the wait for a dark segment has started at
+static U16 gau16Sums[ SENSORS ];   //!< Result table: sum of SENSOR_OVERSAMPLES conversions of each sensor; 0: none yet
+
+
+/***************************************< Static function definitions >**************************************/
+static void StartNext( void );
+static void Wait( void );
+
+
+/***************************************< Private functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Configures the ADC for the next sensor requested, and starts it; disables it if none is
+//! \param  -
+//! \return -
+//! \global gu8State, gu8Active, gu8Pending, gu16Sum, gu8Count
+//! \note   Called with the ADC stopped, from the ADC interrupt, or from main cycle with gu8State
+//!         claimed. The internal paths are set with the ADC disabled only; they are off between
+//!         the measurements. A dark sensor has its path settled by the time a dark segment comes,
+//!         a probe sensor by the time a probe slot comes.
+//-----------------------------------------------------------------------------
+static void StartNext( void )
+{
+  U8 u8Sensor = 0u;
+  
+  LL_ADC_Disable( ADC1 );
+  while( ( u8Sensor < SENSORS ) && ( 0u == ( gu8Pending & SENSOR_BIT( u8Sensor ) ) ) )
+  {
+    u8Sensor++;
+  }
+  gu8Active = u8Sensor;
+  if( SENSOR_NONE == u8Sensor )
+  {
+    LL_ADC_SetCommonPathInternalCh( ADC1_COMMON, LL_ADC_PATH_INTERNAL_NONE );
+    gu8State = SENSOR_IDLE;
+  }
+  else
+  {
+    gu8Pending &= ~SENSOR_BIT( u8Sensor );
+    gu16Sum = 0u;
+    gu8Count = 0u;
+    LL_ADC_REG_SetSequencerChannels( ADC1, gcasSensors[ u8Sensor ].u32Channel );
+    LL_ADC_SetCommonPathInternalCh( ADC1_COMMON, gcasSensors[ u8Sensor ].u32Path );
+    LL_ADC_SetSamplingTimeCommonChannels( ADC1, ( SENSOR_SLOT_ANY != gcasSensors[ u8Sensor ].u8Slot ) ? LL_ADC_SAMPLINGTIME_71CYCLES_5 : LL_ADC_SAMPLINGTIME_239CYCLES_5 );
+    LL_ADC_Enable( ADC1 );
+    if( SENSOR_SLOT_ANY != gcasSensors[ u8Sensor ].u8Slot )
+    {
+      Wait();
+    }
+    else
+    {
+      gu8State = SENSOR_CONVERT;
+      LL_ADC_REG_StartConversion( ADC1 );
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Leaves the next conversion of the active sensor to a dark segment, or to a probe slot
+//! \param  -
+//! \return -
+//! \global gu8Active, gu8State, gu16WaitMs
+//! \note   The state is set last: from then on the TIM1 interrupt may start the conversion.
+//-----------------------------------------------------------------------------
+static void Wait( void )
+{
+  gu16WaitMs = Util_GetTimerMs();
+  gu8State = ( SENSOR_SLOT_PROBE == gcasSensors[ gu8Active ].u8Slot ) ? SENSOR_WAIT_PROBE : SENSOR_WAIT_DARK;
+}
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Initializes the ADC, and calibrates it
+//! \param  -
+//! \return -
+//! \global gu8State, gu8Active, gu8Pending, gu8Ready
+//! \note   Should be called from init block. The ADC stays disabled until a request.
+//-----------------------------------------------------------------------------
+void Sensor_Init( void )
+{
+  LL_APB1_GRP2_EnableClock( LL_APB1_GRP2_PERIPH_ADC1 );
+  LL_ADC_SetClock( ADC1, LL_ADC_CLOCK_SYNC_PCLK_DIV4 );
+  LL_ADC_SetResolution( ADC1, LL_ADC_RESOLUTION_10B );
+  LL_ADC_SetDataAlignment( ADC1, LL_ADC_DATA_ALIGN_RIGHT );
+  LL_ADC_SetSamplingTimeCommonChannels( ADC1, LL_ADC_SAMPLINGTIME_239CYCLES_5 );  // slowest conversion
+  LL_ADC_REG_SetSequencerChannels( ADC1, LL_ADC_CHANNEL_VREFINT );  // internal 1.2V reference, measured against VCC
+  LL_ADC_SetCommonPathInternalCh( ADC1_COMMON, LL_ADC_PATH_INTERNAL_VREFINT );
+  LL_ADC_StartCalibration( ADC1 );
+  while( LL_ADC_IsCalibrationOnGoing( ADC1 ) );
+  LL_ADC_SetCommonPathInternalCh( ADC1_COMMON, LL_ADC_PATH_INTERNAL_NONE );
+  LL_ADC_EnableIT_EOC( ADC1 );
+  NVIC_SetPriority( ADC_COMP_IRQn, IRQ_PRIORITY_EVENT );
+  NVIC_EnableIRQ( ADC_COMP_IRQn );
+  gu8State = SENSOR_IDLE;
+  gu8Active = SENSOR_NONE;
+  gu8Pending = 0u;
+  gu8Ready = 0u;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Requests new results of the given sensors
+//! \param  u8Sensors: SENSOR_BIT() of each sensor
+//! \return -
+//! \global gu8State, gu8Pending, gu8Ready
+//! \note   Should be called from main cycle. Non-blocking, see Sensor_IsReady(). The stop mode
+//!         halts the ADC and TIM1: the caller keeps the main cycle out of it until the results
+//!         are ready. A sensor converting at the request takes its running result as the new one.
+//-----------------------------------------------------------------------------
+void Sensor_Request( U8 u8Sensors )
+{
+  BOOL bStart;
+  
+  DISABLE_IT
+  gu8Pending |= u8Sensors;
+  gu8Ready &= ~u8Sensors;
+  bStart = ( SENSOR_IDLE == gu8State );
+  if( bStart )
+  {
+    gu8State = SENSOR_CONVERT;  // claimed, no interrupt touches the ADC meanwhile
+  }
+  ENABLE_IT
+  if( bStart )
+  {
+    StartNext();
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells if the results of the given sensors are ready in the table
+//! \param  u8Sensors: SENSOR_BIT() of each sensor
+//! \return TRUE if all of them have been converted since their request
+//! \global gu8State, gu8Ready, gu16WaitMs
+//! \note   Should be called from main cycle while waiting. A dark conversion that no dark segment
+//!         has started in SENSOR_DARK_WAIT_MS is started from here: with the drivers stopped, or
+//!         with segments shorter than SENSOR_DARK_TICKS, e.g. the fast refresh. A probe conversion
+//!         waits for its slot, however long: without the LED lit it would tell nothing.
+//-----------------------------------------------------------------------------
+BOOL Sensor_IsReady( U8 u8Sensors )
+{
+  BOOL bStart = FALSE;
+  
+  DISABLE_IT
+  if( ( SENSOR_WAIT_DARK == gu8State ) && ( (U16)( Util_GetTimerMs() - gu16WaitMs ) >= SENSOR_DARK_WAIT_MS ) )
+  {
+    gu8State = SENSOR_CONVERT;
+    bStart = TRUE;
+  }
+  ENABLE_IT
+  if( bStart )
+  {
+    LL_ADC_REG_StartConversion( ADC1 );
+  }
+  
+  return ( u8Sensors == ( gu8Ready & u8Sensors ) );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Gives the last result of a sensor from the table
+//! \param  u8Sensor: the sensor (E_SENSOR)
+//! \return Sum of SENSOR_OVERSAMPLES conversions, each 0..SENSOR_ADC_MAX; 0 before the first one
+//! \global gau16Sums[]
+//-----------------------------------------------------------------------------
+U16 Sensor_GetSum( U8 u8Sensor )
+{
+  return gau16Sums[ u8Sensor ];
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Interrupt routine for the end of an ADC conversion
+//! \param  -
+//! \return TRUE if a result has been completed: the requester should be woken up
+//! \global gu8State, gu8Active, gu8Ready, gu16Sum, gu8Count, gau16Sums[]
+//! \note   Should be called from the ADC interrupt. Sums the conversions, and starts the next one
+//!         until SENSOR_OVERSAMPLES of them are taken, or leaves it to a dark segment; then the
+//!         next sensor requested follows.
+//-----------------------------------------------------------------------------
+BOOL Sensor_Interrupt( void )
+{
+  BOOL bDone = FALSE;
+  
+  if( LL_ADC_IsActiveFlag_EOC( ADC1 ) )
+  {
+    gu16Sum += LL_ADC_REG_ReadConversionData10( ADC1 );
+    LL_ADC_ClearFlag_EOC( ADC1 );
+    gu8Count++;
+    if( SENSOR_NONE == gu8Active )
+    {
+      // A conversion of no request: dropped
+    }
+    else if( gu8Count < SENSOR_OVERSAMPLES )
+    {
+      if( SENSOR_SLOT_ANY != gcasSensors[ gu8Active ].u8Slot )
+      {
+        Wait();
+      }
+      else
+      {
+        LL_ADC_REG_StartConversion( ADC1 );
+      }
+    }
+    else
+    {
+      gau16Sums[ gu8Active ] = gu16Sum;
+      gu8Ready |= SENSOR_BIT( gu8Active );
+      bDone = TRUE;
+      StartNext();
+    }
+  }
+  
+  return bDone;
+}
+
+#if SENSOR_DARK_SLOTS
+//----------------------------------------------------------------------------
+//! \brief  Starts the conversion waiting for a dark segment
+//! \param  u8Ticks: TIM1 periods of the dark segment starting at this update event
+//! \return -
+//! \global gu8State
+//! \note   Should be called from the TIM1 interrupt, after LED_Interrupt(), if gu8LEDDarkTicks is
+//!         set. A segment shorter than SENSOR_DARK_TICKS would light the LEDs within the sampling.
+//-----------------------------------------------------------------------------
+ISR_CODE void Sensor_DarkSlot( U8 u8Ticks )
+{
+  if( ( SENSOR_WAIT_DARK == gu8State ) && ( u8Ticks >= SENSOR_DARK_TICKS ) )
+  {
+    gu8State = SENSOR_CONVERT;
+    LL_ADC_REG_StartConversion( ADC1 );
+  }
+}
+#endif
+
+#if SENSOR_PROBE_SLOTS
+//----------------------------------------------------------------------------
+//! \brief  Starts the conversion waiting for a probe slot
+//! \param  -
+//! \return -
+//! \global gu8State
+//! \note   Should be called from the TIM1 interrupt, after LED_Interrupt(), if gbitLEDProbeSlot is
+//!         set. The slot lasts SENSOR_DARK_TICKS, so the sampling is over before the LED goes dark.
+//-----------------------------------------------------------------------------
+ISR_CODE void Sensor_ProbeSlot( void )
+{
+  if( SENSOR_WAIT_PROBE == gu8State )
+  {
+    gu8State = SENSOR_CONVERT;
+    LL_ADC_REG_StartConversion( ADC1 );
+  }
+}
+#endif
+
+/***************************************< End of file >**************************************/
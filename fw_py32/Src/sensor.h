@@ -0,0 +1,72 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file sensor.h
+*
+* \brief Sensor service: owns the ADC, and converts the internal channels in the background
+*
+* \author Hekk_Elek
+*
+**********************************************************************************************************/
+#ifndef SENSOR_H
+#define SENSOR_H
+
+/***************************************< Includes >**************************************/
+#include "types.h"
+#include "main.h"
+#include "led.h"
+
+
+/***************************************< Definitions >**************************************/
+#define SENSOR_DARK_SLOTS     ( LED_DARK_SLOTS )  //!< 1: SENSOR_TEMPERATURE and SENSOR_VDD_DARK take one conversion per dark segment of the LED drivers, see Sensor_DarkSlot()
+#define SENSOR_PROBE_SLOTS    ( LED_FAULT_CHECK ) //!< 1: SENSOR_VDD_PROBE takes one conversion per probe slot of the LED fault check, see Sensor_ProbeSlot()
+#define SENSOR_OVERSAMPLES    (8u)    //!< Conversions summed per result, a power of 2
+#define SENSOR_ADC_MAX        (1023u) //!< Highest result of a conversion, 10 bits
+#define SENSOR_VREFINT_MV     (1200u) //!< Voltage of the internal reference
+#define SENSOR_DARK_WAIT_MS   (20u)   //!< A dark conversion not started by a dark segment this long is started anyway, e.g. with the drivers stopped
+#define SENSOR_DARK_SAMPLE_US ( ( 286u + SYSCLK_MHZ - 1u ) / SYSCLK_MHZ )  //!< Sampling of a dark conversion: 71.5 cycles of the ADC clock of PCLK/4
+#define SENSOR_DARK_LATENCY_US  (10u) //!< From the update event to the start of the conversion in the TIM1 interrupt
+//! \brief TIM1 periods of the shortest dark segment the sampling fits in; LED_TICK_DIVIDER of them are 100 us
+#define SENSOR_DARK_TICKS     ( ( ( SENSOR_DARK_SAMPLE_US + SENSOR_DARK_LATENCY_US ) * LED_TICK_DIVIDER + 99u ) / 100u )
+#define SENSOR_BIT( sensor )  ( 1u << (sensor) )  //!< Bit of a sensor in the masks of Sensor_Request() and Sensor_IsReady()
+//! \brief Supply voltage of a result of the internal reference: 1.2V/( result / ADC_MAX_VALUE ); a sum of 0 is left to the caller
+#define SENSOR_MV( sum )      ( (U16)( ( SENSOR_VREFINT_MV * ( SENSOR_ADC_MAX + 1uL ) * SENSOR_OVERSAMPLES ) / (sum) ) )
+
+
+/***************************************< Types >**************************************/
+//! \brief Sensors of the service and their entries in the result table
+typedef enum
+{
+  SENSOR_VDD = 0u,      //!< Internal reference against the supply, under the load of the LEDs: the sag of the cell is measured with it
+  SENSOR_TEMPERATURE,   //!< Internal temperature sensor; dark with SENSOR_DARK_SLOTS
+  SENSOR_VDD_DARK,      //!< Internal reference in the dark segments, the supply of the SENSOR_TEMPERATURE conversions
+#if SENSOR_PROBE_SLOTS
+  SENSOR_VDD_PROBE,     //!< Internal reference in the probe slots, with a single LED lit: its sag against SENSOR_VDD_DARK
+#endif
+  SENSORS               //!< Number of the sensors
+} E_SENSOR;
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+
+
+/***************************************< Public functions >**************************************/
+void Sensor_Init( void );
+void Sensor_Request( U8 u8Sensors );
+BOOL Sensor_IsReady( U8 u8Sensors );
+U16  Sensor_GetSum( U8 u8Sensor );
+BOOL Sensor_Interrupt( void );
+#if SENSOR_DARK_SLOTS
+void Sensor_DarkSlot( U8 u8Ticks );
+#endif
+#if SENSOR_PROBE_SLOTS
+void Sensor_ProbeSlot( void );
+#endif
+
+
+#endif /* SENSOR_H */
+
+/***************************************< End of file >**************************************/
@@ -0,0 +1,325 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file stats.c
+*
+* \brief Runtime statistics of the unit, kept in the persistent data
+*
+* \author Hekk_Elek
+*
+* \note  The counters of S_PERSIST tell how the units are used in the field: the on-time, the time
+*        spent with each animation, the button presses, the saves, the resets by cause and the
+*        faulty LEDs found by the fault check of the LED driver. They
+*        are summed in RAM, and folded into gsPersistentData by Persist_Save() only, so they never
+*        cause a flash write of their own; the only extra save is the one of Stats_Suspend(), once
+*        per session. Read them over SWD from gsPersistentData, or from the journal in the flash.
+*        The time in stop mode is not counted, the on-time is the time the LEDs are driven.
+*        With STATS_RESIDENCY the time of every power state is summed per animation in RAM, in
+*        gasStatsResidency[]: the sleeps and stops are timed where the main cycle enters them, the
+*        run time is what is left of the time accounted. It is never saved, read it over SWD.
+*
+**********************************************************************************************************/
+
+/***************************************< Includes >**************************************/
+// Own includes
+#include "main.h"
+#include "types.h"
+#include "util.h"
+#include "animation.h"
+#include "persist.h"
+#include "stats.h"
+
+#if STATS_ENABLE
+
+/***************************************< Definitions >**************************************/
+#define MS_PER_MIN            (60000u)  //!< Unit of the saved times
+#define CYCLES_PER_MS         ( SYSCLK_MHZ * 1000uL )  //!< SysTick cycles of a millisecond
+#if STATS_RESIDENCY && UTIL_SYSTICK_MS
+#error "STATS_RESIDENCY: SysTick is the cycle counter of the sleep time, build it with the TIM1 timebase"
+#endif
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+static U32 gu32MarkMs;     //!< Time the running period is accounted from
+static U8  gu8Animation;   //!< Animation index of the running period
+static U32 gu32OnMs;       //!< On-time not folded yet
+static U32 gau32AnimationMs[ NUM_ANIMATIONS ];  //!< Time per animation not folded yet
+static U16 gu16Presses;    //!< Button presses not folded yet
+static U16 gu16FaultMask;  //!< Bit of each LED found faulty, not folded yet
+static U8  gu8Faults;      //!< LED faults not folded yet
+static U8  gu8ResetCause;  //!< Cause of the last reset, E_STATS_RESET; STATS_RESET_CAUSES once it is folded
+#if STATS_RESIDENCY
+volatile S_STATS_RESIDENCY gasStatsResidency[ NUM_ANIMATIONS ];  //!< Time in the power states per animation, since the boot
+volatile U32 gu32StatsPowerDowns;  //!< Power-downs since the boot, the timed ones and the ones waiting for the button
+static U32 gu32SleepCycles;  //!< Sleep not accounted yet, the part below a ms
+static U32 gu32SleepMs;      //!< Sleep not accounted yet, whole ms
+static U32 gu32StopMs;       //!< Tickless stop not accounted yet
+#endif
+
+
+/***************************************< Static function definitions >**************************************/
+static U16 AddSaturated( U16 u16Counter, U32 u32Add );
+
+
+/***************************************< Private functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Adds to a 16-bit counter, which stops at its maximum
+//! \param  u16Counter: value of the counter
+//! \param  u32Add: amount to add
+//! \return New value of the counter
+//! \global -
+//-----------------------------------------------------------------------------
+static U16 AddSaturated( U16 u16Counter, U32 u32Add )
+{
+  U32 u32Sum = (U32)u16Counter + u32Add;
+  
+  if( u32Sum > 0xFFFFu )
+  {
+    u32Sum = 0xFFFFu;
+  }
+  
+  return (U16)u32Sum;
+}
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Starts the statistics of a boot, and takes the cause of the reset
+//! \param  -
+//! \return -
+//! \global All globals of this module
+//! \note   Should be called after Persist_Init(), before anything saves. The reset flags are
+//!         cleared, so the cause of the next reset is told alone.
+//-----------------------------------------------------------------------------
+void Stats_Init( void )
+{
+  U8 u8Index;
+  
+  if( LL_RCC_IsActiveFlag_PWRRST() )
+  {
+    gu8ResetCause = STATS_RESET_POWER;
+  }
+  else if( LL_RCC_IsActiveFlag_IWDGRST() )
+  {
+    gu8ResetCause = STATS_RESET_WATCHDOG;
+  }
+  else if( LL_RCC_IsActiveFlag_SFTRST() )
+  {
+    gu8ResetCause = STATS_RESET_SOFTWARE;
+  }
+  else
+  {
+    gu8ResetCause = STATS_RESET_PIN;  // its flag is set by every internal reset too
+  }
+  LL_RCC_ClearResetFlags();
+  
+  gu32MarkMs = Util_GetTimerMs32();
+  gu8Animation = gsPersistentData.u8AnimationIndex;
+  gu32OnMs = 0u;
+  for( u8Index = 0u; u8Index < NUM_ANIMATIONS; u8Index++ )
+  {
+    gau32AnimationMs[ u8Index ] = 0u;
+  }
+  gu16Presses = 0u;
+  gu16FaultMask = 0u;
+  gu8Faults = 0u;
+#if STATS_RESIDENCY
+  gu32SleepCycles = 0u;
+  gu32SleepMs = 0u;
+  gu32StopMs = 0u;
+#endif
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Accounts the time since the previous call to the animation played meanwhile
+//! \param  -
+//! \return -
+//! \global gu32MarkMs, gu8Animation, gu32OnMs, gau32AnimationMs[], gsPersistentData
+//! \note   Should be called before the animation is changed: the button task calls it first.
+//-----------------------------------------------------------------------------
+void Stats_Account( void )
+{
+  U32 u32Now = Util_GetTimerMs32();
+  U32 u32Elapsed = u32Now - gu32MarkMs;
+#if STATS_RESIDENCY
+  U32 u32Idle = gu32SleepMs + gu32StopMs;
+#endif
+  
+  gu32MarkMs = u32Now;
+  gu32OnMs += u32Elapsed;
+  if( gu8Animation < NUM_ANIMATIONS )
+  {
+    gau32AnimationMs[ gu8Animation ] += u32Elapsed;
+#if STATS_RESIDENCY
+    gasStatsResidency[ gu8Animation ].au32Ms[ STATS_POWER_RUN ] += ( u32Elapsed > u32Idle ) ? ( u32Elapsed - u32Idle ) : 0u;
+    gasStatsResidency[ gu8Animation ].au32Ms[ STATS_POWER_SLEEP ] += gu32SleepMs;
+    gasStatsResidency[ gu8Animation ].au32Ms[ STATS_POWER_STOP ] += gu32StopMs;
+#endif
+  }
+#if STATS_RESIDENCY
+  gu32SleepMs = 0u;
+  gu32StopMs = 0u;
+#endif
+  gu8Animation = gsPersistentData.u8AnimationIndex;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Counts a press of the button
+//! \param  -
+//! \return -
+//! \global gu16Presses
+//! \note   Called by Button_Cycle() on every debounced press.
+//-----------------------------------------------------------------------------
+void Stats_CountPress( void )
+{
+  if( gu16Presses < 0xFFFFu )
+  {
+    gu16Presses++;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Counts an LED found open or shorted
+//! \param  u8LED: index of the LED in gau8LEDBrightness[]
+//! \return -
+//! \global gu16FaultMask, gu8Faults
+//! \note   Called by the fault check of the LED driver, once per LED dropped from the frames.
+//-----------------------------------------------------------------------------
+void Stats_CountLEDFault( U8 u8LED )
+{
+  gu16FaultMask |= (U16)( 1u << u8LED );
+  if( gu8Faults < 0xFFu )
+  {
+    gu8Faults++;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Ends a session before the stop mode
+//! \param  -
+//! \return -
+//! \global -
+//! \note   Should be called before Persist_Flush() of the power-down: it makes that save due, so the
+//!         counters of the session are written with it.
+//-----------------------------------------------------------------------------
+void Stats_Suspend( void )
+{
+  Stats_Account();
+  Persist_SaveLater();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Starts a session after the stop mode
+//! \param  -
+//! \return -
+//! \global gu32MarkMs
+//-----------------------------------------------------------------------------
+void Stats_Resume( void )
+{
+  gu32MarkMs = Util_GetTimerMs32();
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Folds the counters summed in RAM into the persistent data
+//! \param  -
+//! \return -
+//! \global All globals of this module, gsPersistentData
+//! \note   Called by Persist_Save(), before it takes the copy to write; counts that save too.
+//!         The times are folded in whole minutes, the rest stays for the next save.
+//-----------------------------------------------------------------------------
+void Stats_Fold( void )
+{
+  U8 u8Index;
+  
+  Stats_Account();
+  gsPersistentData.u32OnMin += gu32OnMs / MS_PER_MIN;
+  gu32OnMs %= MS_PER_MIN;
+  for( u8Index = 0u; u8Index < NUM_ANIMATIONS; u8Index++ )
+  {
+    gsPersistentData.au16AnimationMin[ u8Index ] = AddSaturated( gsPersistentData.au16AnimationMin[ u8Index ], gau32AnimationMs[ u8Index ] / MS_PER_MIN );
+    gau32AnimationMs[ u8Index ] %= MS_PER_MIN;
+  }
+  gsPersistentData.u32Presses += gu16Presses;
+  gu16Presses = 0u;
+  gsPersistentData.u16LEDFaultMask |= gu16FaultMask;
+  gsPersistentData.u16LEDFaults = AddSaturated( gsPersistentData.u16LEDFaults, gu8Faults );
+  gu16FaultMask = 0u;
+  gu8Faults = 0u;
+  if( gu8ResetCause < STATS_RESET_CAUSES )
+  {
+    gsPersistentData.au16Resets[ gu8ResetCause ] = AddSaturated( gsPersistentData.au16Resets[ gu8ResetCause ], 1u );
+    gu8ResetCause = STATS_RESET_CAUSES;
+  }
+  gsPersistentData.u32Saves++;
+}
+
+#if STATS_RESIDENCY
+//----------------------------------------------------------------------------
+//! \brief  Waits for an interrupt or an event in sleep mode, and counts the time as sleep
+//! \param  bEvent: TRUE: __WFE(); FALSE: __WFI()
+//! \return -
+//! \global gu32SleepCycles, gu32SleepMs
+//! \note   Called through STATS_WFI() and STATS_WFE() only, from the main cycle. The interrupts are
+//!         masked meanwhile: a pending one still wakes the CPU up, but its handler runs after the
+//!         time is taken, so it is counted as run time. The SysTick cycle counter wraps after 2^24
+//!         cycles, the TIM1 interrupts end the sleep much earlier.
+//-----------------------------------------------------------------------------
+void Stats_Sleep( BOOL bEvent )
+{
+  U32 u32Start;
+  
+  __disable_irq();
+  u32Start = SysTick->VAL;
+  if( bEvent )
+  {
+    __WFE();
+  }
+  else
+  {
+    __WFI();
+  }
+  gu32SleepCycles += ( u32Start - SysTick->VAL ) & SysTick_LOAD_RELOAD_Msk;
+  __enable_irq();
+  while( gu32SleepCycles >= CYCLES_PER_MS )
+  {
+    gu32SleepCycles -= CYCLES_PER_MS;
+    gu32SleepMs++;
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Counts a stay in stop mode
+//! \param  eState: STATS_POWER_STOP for the tickless idle, STATS_POWER_OFF for the power-down
+//! \param  u32Ms: time spent, by the global timer
+//! \return -
+//! \global gu32StopMs, gasStatsResidency[], gu32StatsPowerDowns
+//! \note   The power-down is counted after Stats_Suspend(), to the animation it has ended. Only the
+//!         wakeups of the schedule are timed by the LPTIM: a wait for the button runs no clock, it
+//!         is counted with 0 ms, in gu32StatsPowerDowns only.
+//-----------------------------------------------------------------------------
+void Stats_Stopped( E_STATS_POWER eState, U32 u32Ms )
+{
+  if( STATS_POWER_OFF == eState )
+  {
+    if( gu8Animation < NUM_ANIMATIONS )
+    {
+      gasStatsResidency[ gu8Animation ].au32Ms[ STATS_POWER_OFF ] += u32Ms;
+    }
+    gu32StatsPowerDowns++;
+  }
+  else
+  {
+    gu32StopMs += u32Ms;
+  }
+}
+#endif
+
+#endif /* STATS_ENABLE */
+
+/***************************************< End of file >**************************************/
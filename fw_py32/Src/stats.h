@@ -0,0 +1,98 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file stats.h
+*
+* \brief Runtime statistics of the unit, kept in the persistent data
+*
+* \author Hekk_Elek
+*
+**********************************************************************************************************/
+#ifndef STATS_H
+#define STATS_H
+
+/***************************************< Includes >**************************************/
+#include "types.h"
+
+
+/***************************************< Definitions >**************************************/
+#ifndef STATS_ENABLE
+#define STATS_ENABLE          (1u)    //!< 1: the usage counters of S_PERSIST are updated; 0: they stay 0
+#endif
+#ifndef STATS_RESIDENCY
+#define STATS_RESIDENCY       (0u)    //!< 1: the time in every power state is summed per animation in gasStatsResidency[], for reading over SWD
+#endif
+#if STATS_RESIDENCY && !STATS_ENABLE
+#error "STATS_RESIDENCY: the residency is accounted with the usage counters, build it with STATS_ENABLE"
+#endif
+
+
+/***************************************< Macros >**************************************/
+#if STATS_RESIDENCY
+#define STATS_WFI()   Stats_Sleep( FALSE )  //!< __WFI() of the main cycle, the time is counted as sleep
+#define STATS_WFE()   Stats_Sleep( TRUE )   //!< __WFE() of the main cycle, the time is counted as sleep
+#else
+#define STATS_WFI()   __WFI()
+#define STATS_WFE()   __WFE()
+#endif
+
+
+/***************************************< Types >**************************************/
+//! \brief Causes of the resets counted, from the flags of RCC_CSR
+typedef enum
+{
+  STATS_RESET_POWER = 0u,  //!< Power-on or brown-out: a cell inserted, or one that has sagged
+  STATS_RESET_PIN,         //!< NRST pin, e.g. by the debugger
+  STATS_RESET_WATCHDOG,    //!< Independent watchdog, the PY32F002A has no window watchdog
+  STATS_RESET_SOFTWARE,    //!< NVIC_SystemReset()
+  STATS_RESET_CAUSES       //!< Number of the causes
+} E_STATS_RESET;
+
+#if STATS_RESIDENCY
+//! \brief Power states of the residency
+typedef enum
+{
+  STATS_POWER_RUN = 0u,    //!< The CPU runs: the tasks and the interrupts, and everything not counted otherwise
+  STATS_POWER_SLEEP,       //!< Sleep mode between the interrupts, TIM1 running: STATS_WFI() and STATS_WFE()
+  STATS_POWER_STOP,        //!< Stop mode of the tickless idle, the LEDs dark
+  STATS_POWER_OFF,         //!< Stop mode of the power-down; timed with the schedule only, see Stats_Stopped()
+  STATS_POWER_STATES       //!< Number of the power states
+} E_STATS_POWER;
+
+//! \brief Residency of an animation, for reading over SWD
+typedef struct
+{
+  U32 au32Ms[ STATS_POWER_STATES ];  //!< Time in each power state, E_STATS_POWER; writing 0 restarts it
+} S_STATS_RESIDENCY;
+#endif
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+#if STATS_RESIDENCY
+extern volatile S_STATS_RESIDENCY gasStatsResidency[];
+extern volatile U32 gu32StatsPowerDowns;
+#endif
+
+
+/***************************************< Public functions >**************************************/
+#if STATS_ENABLE
+void Stats_Init( void );
+void Stats_Account( void );
+void Stats_CountPress( void );
+void Stats_CountLEDFault( U8 u8LED );
+void Stats_Suspend( void );
+void Stats_Resume( void );
+void Stats_Fold( void );
+#endif
+#if STATS_RESIDENCY
+void Stats_Sleep( BOOL bEvent );
+void Stats_Stopped( E_STATS_POWER eState, U32 u32Ms );
+#endif
+
+
+#endif /* STATS_H */
+
+/***************************************< End of file >**************************************/
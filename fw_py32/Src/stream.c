@@ -0,0 +1,177 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file stream.c
+*
+* \brief Frame streaming: a host drives the LEDs over the UART, the unit is a passive display
+*
+* \author Hekk_Elek
+*
+* \note  For installations with a central controller. The host sends frames on STREAM_RX_GPIO_PIN,
+*        STREAM_BAUD 8N1, receive only:
+*        - a frame is STREAM_SYNC, then STREAM_FRAME_BYTES levels [0; LED_BRIGHTNESS_MAX]: the 12
+*          LEDs in the order of gau8LEDBrightness[], then red, green and blue
+*        - a byte out of range, or an error of the UART, drops the frame; the next STREAM_SYNC
+*          starts a new one, so the host needs no handshake
+*        - the first frame takes the LEDs from the animation, the VM stands still; STREAM_TIMEOUT_MS
+*          without a frame hands them back, the animation starts over
+*        The interrupt of USART1 writes the levels into one of two frame buffers, and swaps them
+*        at the end of a frame; the main cycle hands the complete one to the LED driver, which
+*        shows it from the next period boundary, as any frame of the VM. The PY32F002A has no DMA,
+*        and the driver buffers hold planes computed from the levels, so the levels themselves are
+*        what the host sends. The trims, the global brightness and the load budget apply.
+*        The USART doesn't receive in the stop mode: frames sent while the unit sleeps through a
+*        dark part of its animation are lost, the first one after it is taken.
+*
+**********************************************************************************************************/
+
+/***************************************< Includes >**************************************/
+// Standard C libraries
+#include <string.h>
+
+// Own includes
+#include "main.h"
+#include "types.h"
+#include "util.h"
+#include "led.h"
+#include "rgbled.h"
+#include "stream.h"
+#include "memmap.h"
+
+#if STREAM_ENABLE
+
+/***************************************< Definitions >**************************************/
+#define STREAM_GPIO_PORT      GPIOA    //!< Port of the RX pin
+#define STREAM_HUNT           (0xFFu)  //!< gu8Index while waiting for STREAM_SYNC
+#define STREAM_ERRORS         ( USART_SR_ORE | USART_SR_NE | USART_SR_FE | USART_SR_PE )  //!< Errors of the UART that drop the frame
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+#define gaau8Frames  ( guMemMap.sRun.aau8StreamFrames )  //!< Levels of the frames, in the run part of the arena; written by Stream_Interrupt() only
+static U8  gu8Write;             //!< Buffer written by the interrupt; the other one holds the last complete frame
+static U8  gu8Index = STREAM_HUNT;  //!< Next byte of the frame received; STREAM_HUNT: waiting for a frame
+static volatile BIT gbitFrame;   //!< The last complete frame hasn't been shown yet
+static BIT gbitActive;           //!< The LEDs show the stream, not the animation
+
+
+/***************************************< Static function definitions >**************************************/
+
+
+/***************************************< Private functions >**************************************/
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Starts USART1 on the RX pin, its receive interrupt, and waits for a frame
+//! \param  -
+//! \return -
+//! \global All globals of this module
+//! \note   Should be called after Upload_Run(), which takes USART1 on the ISP pins at power on, and
+//!         again after the wakeup from the power-down, which parks the pin. The animation has the
+//!         LEDs until the first frame.
+//-----------------------------------------------------------------------------
+void Stream_Init( void )
+{
+  LL_IOP_GRP1_EnableClock( LL_IOP_GRP1_PERIPH_GPIOA );
+#if UTIL_REGISTER_INIT
+  Util_GPIO_Init( STREAM_GPIO_PORT, STREAM_RX_GPIO_PIN, LL_GPIO_MODE_ALTERNATE, LL_GPIO_SPEED_FREQ_LOW, LL_GPIO_PULL_UP, STREAM_GPIO_AF );
+#else
+  LL_GPIO_SetPinPull( STREAM_GPIO_PORT, STREAM_RX_GPIO_PIN, LL_GPIO_PULL_UP );  // an idle line without a host
+#if STREAM_RX_GPIO_PIN > LL_GPIO_PIN_7
+  LL_GPIO_SetAFPin_8_15( STREAM_GPIO_PORT, STREAM_RX_GPIO_PIN, STREAM_GPIO_AF );
+#else
+  LL_GPIO_SetAFPin_0_7( STREAM_GPIO_PORT, STREAM_RX_GPIO_PIN, STREAM_GPIO_AF );
+#endif
+  LL_GPIO_SetPinMode( STREAM_GPIO_PORT, STREAM_RX_GPIO_PIN, LL_GPIO_MODE_ALTERNATE );
+#endif
+  
+  gu8Write = 0u;
+  gu8Index = STREAM_HUNT;
+  gbitFrame = 0;
+  gbitActive = 0;
+  Util_TimerStop( UTIL_TIMER_STREAM );
+  
+  LL_APB1_GRP2_EnableClock( LL_APB1_GRP2_PERIPH_USART1 );
+  USART1->BRR = ( SYSCLK_MHZ * 1000000uL + STREAM_BAUD / 2u ) / STREAM_BAUD;  // APB1 is not divided
+  USART1->CR1 = USART_CR1_UE | USART_CR1_RE | USART_CR1_RXNEIE;
+  NVIC_SetPriority( USART1_IRQn, IRQ_PRIORITY_EVENT );
+  NVIC_EnableIRQ( USART1_IRQn );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Takes a received byte into the frame
+//! \param  -
+//! \return TRUE if a frame has been completed
+//! \global gaau8Frames[][], gu8Write, gu8Index, gbitFrame
+//! \note   Should be called from the USART1 interrupt. Reading the data register clears the flags
+//!         of the byte, and its errors with the status read before. A complete frame swaps the
+//!         buffers, so the next one can't overwrite it while the main cycle takes it.
+//-----------------------------------------------------------------------------
+BOOL Stream_Interrupt( void )
+{
+  U32  u32Status = USART1->SR;
+  U8   u8Byte = (U8)USART1->DR;
+  BOOL bComplete = FALSE;
+  
+  if( STREAM_SYNC == u8Byte )
+  {
+    gu8Index = 0u;
+  }
+  else if( ( 0u != ( u32Status & STREAM_ERRORS ) ) || ( u8Byte > LED_BRIGHTNESS_MAX ) )
+  {
+    gu8Index = STREAM_HUNT;
+  }
+  else if( gu8Index < STREAM_FRAME_BYTES )
+  {
+    gaau8Frames[ gu8Write ][ gu8Index ] = u8Byte;
+    gu8Index++;
+    if( STREAM_FRAME_BYTES == gu8Index )
+    {
+      gu8Write ^= 1u;
+      gbitFrame = 1;
+      gu8Index = STREAM_HUNT;
+      bComplete = TRUE;
+    }
+  }
+  
+  return bComplete;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Shows the last frame received, and tells if the stream has the LEDs
+//! \param  -
+//! \return TRUE while the stream drives the LEDs: the animation shouldn't run
+//! \global gaau8Frames[][], gu8Write, gbitFrame, gbitActive
+//! \note   Should be called from main cycle, in place of Animation_Cycle(); the interrupt wakes it
+//!         up at the end of each frame. UTIL_TIMER_STREAM times the end of the stream.
+//-----------------------------------------------------------------------------
+BOOL Stream_Cycle( void )
+{
+  if( gbitFrame )
+  {
+    NVIC_DisableIRQ( USART1_IRQn );  // the buffers aren't swapped meanwhile; a byte waits in the data register
+    memcpy( gau8LEDBrightness, gaau8Frames[ gu8Write ^ 1u ], LEDS_NUM );
+    memcpy( (U8*)gau8RGBLEDs, &gaau8Frames[ gu8Write ^ 1u ][ LEDS_NUM ], NUM_RGBLED_COLORS );
+    gbitFrame = 0;
+    NVIC_EnableIRQ( USART1_IRQn );
+    LED_Commit();
+    gbitActive = 1;
+    Util_TimerStart( UTIL_TIMER_STREAM, STREAM_TIMEOUT_MS );
+  }
+  else if( gbitActive && Util_TimerExpired( UTIL_TIMER_STREAM ) )
+  {
+    gbitActive = 0;
+  }
+  
+  return gbitActive;
+}
+
+#endif /* STREAM_ENABLE */
+
+/***************************************< End of file >**************************************/
@@ -0,0 +1,65 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file stream.h
+*
+* \brief Frame streaming: a host drives the LEDs over the UART, the unit is a passive display
+*
+* \author Hekk_Elek
+*
+**********************************************************************************************************/
+#ifndef STREAM_H
+#define STREAM_H
+
+/***************************************< Includes >**************************************/
+#include "types.h"
+#include "util.h"
+#include "led.h"
+#include "rgbled.h"
+#include "bus.h"
+
+
+/***************************************< Definitions >**************************************/
+#ifndef STREAM_ENABLE
+#define STREAM_ENABLE         (0u)     //!< 1: frames received on STREAM_RX_GPIO_PIN are shown instead of the animation, see stream.c
+#endif
+#ifndef STREAM_RX_GPIO_PIN
+#define STREAM_RX_GPIO_PIN    LL_GPIO_PIN_10         //!< USART1 RX of the stream on GPIOA; spare on the board, the ISP pins are the LEDs'
+#define STREAM_GPIO_AF        LL_GPIO_AF_1           //!< Alternate function of USART1 RX on STREAM_RX_GPIO_PIN
+#if STREAM_ENABLE && UTIL_PROBES
+#error "STREAM_ENABLE: PA10 is the probe of Animation_Cycle(), choose another STREAM_RX_GPIO_PIN!"
+#endif
+#endif
+#ifndef STREAM_BAUD
+#define STREAM_BAUD           (115200uL)  //!< Baud rate of the stream, 8N1: 700 frames a second at most
+#endif
+#define STREAM_SYNC           (0x80u)  //!< First byte of a frame; above LED_BRIGHTNESS_MAX, so it is never a level
+#define STREAM_FRAME_BYTES    ( LEDS_NUM + NUM_RGBLED_COLORS )  //!< Levels of a frame after STREAM_SYNC: the LEDs, then red, green and blue
+#define STREAM_BUFFERS        (2u)     //!< Frame buffers: one written by the interrupt, one complete
+#define STREAM_TIMEOUT_MS     (2000u)  //!< Without a frame this long the animation takes the LEDs back
+
+#if STREAM_ENABLE && BUS_ENABLE
+#error "STREAM_ENABLE: a unit driven by a host has no animation of its own to lock to the bus!"
+#endif
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+
+
+/***************************************< Public functions >**************************************/
+#if STREAM_ENABLE
+void Stream_Init( void );
+BOOL Stream_Interrupt( void );
+BOOL Stream_Cycle( void );
+#endif
+
+
+#endif /* STREAM_H */
+
+/***************************************< End of file >**************************************/
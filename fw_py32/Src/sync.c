@@ -0,0 +1,188 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file sync.c
+*
+* \brief Optical phase lock of neighbouring units, with an LED as receiver
+*
+* \author Hekk_Elek
+*
+* \note  The units drift apart, as each HSI clock differs a bit. They pull each other in step like
+*        fireflies, without a master:
+*        - at the start of every SYNC_ROUNDS-th round of its program a unit sends a flash burst of
+*          SYNC_FLASH_MS, the rounds of the units are staggered by their UIDs
+*        - meanwhile every unit listens: each SYNC_SAMPLE_MS the LED driver takes a light sample in a
+*          short dark slot, see LED_SenseRequest(); a neighbour's flash charges the sensor up within
+*          SYNC_SENSE_TICKS, the room alone doesn't
+*        - a run of bright samples as long as a burst is a flash; a light switched on is longer
+*        - the flash has been sent at the start of the neighbour's round, so the listener slews its
+*          program halfway towards that, by at most SYNC_SLEW_MAX_MS
+*        Everything runs in the main cycle, the interrupt only takes the short dark slots.
+*
+**********************************************************************************************************/
+
+/***************************************< Includes >**************************************/
+// Own includes
+#include "main.h"
+#include "types.h"
+#include "util.h"
+#include "led.h"
+#include "animation.h"
+#include "sync.h"
+
+#if SYNC_ENABLE
+
+/***************************************< Definitions >**************************************/
+#define RUN_MIN               ( SYNC_FLASH_MS / SYNC_SAMPLE_MS - 1u )  //!< Fewest bright samples of a flash
+#define RUN_MAX               ( SYNC_FLASH_MS / SYNC_SAMPLE_MS + 1u )  //!< Most bright samples of a flash
+#define DETECT_PHASE_MS       ( SYNC_FLASH_MS + SYNC_SAMPLE_MS / 2u )  //!< Phase of the sender when its flash is recognized
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+static BIT gbitSamplePending;  //!< A light sample has been requested, its result is awaited
+static U8  gu8BrightRun;       //!< Bright samples in a row
+static U8  gu8Round;           //!< Rounds of the program since the last flash sent
+static U16 gu16LastPhase;      //!< Phase of the program in the previous cycle
+static U16 gu16PeriodMs;       //!< Length of the last round of the program; 0: not known yet
+
+
+/***************************************< Static function definitions >**************************************/
+static void Lock( U16 u16Phase );
+
+
+/***************************************< Private functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Slews the program towards the phase of the sender of the flash recognized
+//! \param  u16Phase: phase of the own program now
+//! \return -
+//! \global gu16PeriodMs
+//! \note   The error is taken the shorter way round, then half of it is corrected, so the units
+//!         meet in the middle instead of chasing each other.
+//-----------------------------------------------------------------------------
+static void Lock( U16 u16Phase )
+{
+  I32 i32Error;
+  
+  if( 0u != gu16PeriodMs )
+  {
+    i32Error = (I32)u16Phase - (I32)DETECT_PHASE_MS;
+    if( i32Error > (I32)( gu16PeriodMs / 2u ) )
+    {
+      i32Error -= (I32)gu16PeriodMs;
+    }
+    else if( i32Error < -(I32)( gu16PeriodMs / 2u ) )
+    {
+      i32Error += (I32)gu16PeriodMs;
+    }
+    i32Error = -i32Error / 2;
+    if( i32Error > (I32)SYNC_SLEW_MAX_MS )
+    {
+      i32Error = (I32)SYNC_SLEW_MAX_MS;
+    }
+    else if( i32Error < -(I32)SYNC_SLEW_MAX_MS )
+    {
+      i32Error = -(I32)SYNC_SLEW_MAX_MS;
+    }
+    Animation_Slew( (I16)i32Error );
+  }
+}
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Initializes the phase lock
+//! \param  -
+//! \return -
+//! \global All globals of this module
+//! \note   Should be called after LED_Init(), as that drops the pending light sample.
+//-----------------------------------------------------------------------------
+void Sync_Init( void )
+{
+  gbitSamplePending = 0;
+  gu8BrightRun = 0u;
+  gu8Round = (U8)Util_Get_UID_ptr()[ 0u ] % SYNC_ROUNDS;  // the units take turns
+  gu16LastPhase = 0u;
+  gu16PeriodMs = 0u;
+  Util_TimerStart( UTIL_TIMER_SYNC, SYNC_SAMPLE_MS );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Sends the flashes, and listens to the ones of the neighbours
+//! \param  -
+//! \return Time until it has to be called again in ms; 0 while a light sample is awaited
+//! \global All globals of this module
+//! \note   Should be called from main cycle, after Animation_Cycle(). A new round is seen when the
+//!         animation has run at its start, so the flash is sent on time.
+//-----------------------------------------------------------------------------
+U32 Sync_Cycle( void )
+{
+  U16 u16Phase = Animation_GetPhaseMs();
+  U8  u8Ticks;
+  U32 u32Next = 0u;
+  
+  // A new round of the program: its length is known, and it may be the turn of this unit
+  if( u16Phase < gu16LastPhase )
+  {
+    gu16PeriodMs = gu16LastPhase;
+    gu8Round++;
+    if( gu8Round >= SYNC_ROUNDS )
+    {
+      gu8Round = 0u;
+      Animation_Flash( SYNC_FLASH_MS );
+      Main_Wake( MAIN_TASK_ANIMATION );  // shown at once, not at the next instruction
+    }
+  }
+  gu16LastPhase = u16Phase;
+  
+  // Listen
+  if( gbitSamplePending )
+  {
+    u8Ticks = LED_SenseResult();
+    if( 0u != u8Ticks )
+    {
+      gbitSamplePending = 0;
+      if( u8Ticks < SYNC_SENSE_TICKS )
+      {
+        if( gu8BrightRun < 0xFFu )
+        {
+          gu8BrightRun++;
+        }
+      }
+      else
+      {
+        // The end of a bright run: a flash, if it was as long as a burst
+        if( ( gu8BrightRun >= RUN_MIN ) && ( gu8BrightRun <= RUN_MAX ) )
+        {
+          Lock( u16Phase );
+          gu16LastPhase = Animation_GetPhaseMs();  // a slew back is not a new round
+        }
+        gu8BrightRun = 0u;
+      }
+    }
+  }
+  else if( Util_TimerExpired( UTIL_TIMER_SYNC ) )
+  {
+    // A busy sensor just skips a sample, the run goes on
+    if( LED_SenseRequest( SYNC_SENSE_TICKS ) )
+    {
+      gbitSamplePending = 1;
+    }
+    Util_TimerStart( UTIL_TIMER_SYNC, SYNC_SAMPLE_MS );
+  }
+  if( !gbitSamplePending )
+  {
+    u32Next = Util_TimerLeftMs( UTIL_TIMER_SYNC );
+  }
+  
+  return u32Next;
+}
+
+#endif /* SYNC_ENABLE */
+
+/***************************************< End of file >**************************************/
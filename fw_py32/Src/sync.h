@@ -0,0 +1,52 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file sync.h
+*
+* \brief Optical phase lock of neighbouring units, with an LED as receiver
+*
+* \author Hekk_Elek
+*
+**********************************************************************************************************/
+#ifndef SYNC_H
+#define SYNC_H
+
+/***************************************< Includes >**************************************/
+#include "types.h"
+#include "led.h"
+
+
+/***************************************< Definitions >**************************************/
+#ifndef SYNC_ENABLE
+#define SYNC_ENABLE           (0u)    //!< 1: the units next to each other lock the phase of their animations by flashes
+#endif
+#define SYNC_SAMPLE_MS        (20u)   //!< Period of the light samples while listening
+#define SYNC_FLASH_MS         (60u)   //!< Length of the flash burst, all LEDs at full brightness
+#define SYNC_SENSE_TICKS      ( 3u * LED_TICK_DIVIDER )  //!< Longest dark slot of a sample in TIM1 periods: 0.3 ms; only a flash charges it up sooner
+#define SYNC_ROUNDS           (4u)    //!< A flash is sent at the start of every SYNC_ROUNDS-th round of the program
+#define SYNC_SLEW_MAX_MS      (200u)  //!< Largest phase correction for a flash received
+
+#if SYNC_ENABLE && !LED_LIGHT_SENSE
+#error "SYNC_ENABLE: needs LED_LIGHT_SENSE!"
+#endif
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+
+
+/***************************************< Public functions >**************************************/
+#if SYNC_ENABLE
+void Sync_Init( void );
+U32  Sync_Cycle( void );
+#endif
+
+
+#endif /* SYNC_H */
+
+/***************************************< End of file >**************************************/
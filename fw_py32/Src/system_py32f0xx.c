@@ -44,7 +44,7 @@
 /************************* Miscellaneous Configuration ************************/
 /*!< Uncomment the following line if you need to relocate your vector Table in
      Internal SRAM. */
-/* #define FORBID_VECT_TAB_MIGRATION */
+#define FORBID_VECT_TAB_MIGRATION  /* The vectors stay in the flash: no copy at startup, and 192 bytes of RAM are free */
 /* #define VECT_TAB_SRAM */
 #define VECT_TAB_OFFSET  0x00 /*!< Vector Table base offset field.
                                    This value must be a multiple of 0x100. */
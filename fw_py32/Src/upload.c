@@ -0,0 +1,409 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file upload.c
+*
+* \brief Upload of an animation over the UART of the ISP pins
+*
+* \author Hekk_Elek
+*
+* \note  The pins are shared with the LEDs, so the upload is only listened for at power on, before
+*        the LED driver takes them: a connected USB-UART adapter is recognized by its idle-high TX
+*        line on PA3, against the internal pulldown. Without an adapter the boot is not delayed.
+*        Protocol, UPLOAD_BAUD 8N1, every answer is a single byte:
+*        - the device sends UPLOAD_HELLO, then waits UPLOAD_WAIT_MS for the host
+*        - the host sends the S_UPLOAD_HEADER, with the magic numbers; the device erases the upload
+*          area and answers UPLOAD_ACK, or UPLOAD_NAK if the header doesn't fit
+*        - the host sends the body in chunks up to each flash page boundary: the first chunk is
+*          UPLOAD_PAGE_SIZE - sizeof( S_UPLOAD_HEADER ) bytes, the others UPLOAD_PAGE_SIZE, the last
+*          one the rest; the device answers UPLOAD_ACK after programming each, or UPLOAD_NAK if
+*          the flash doesn't hold the chunk after it
+*        - the device checks the CRC of the image, computed over the chunks, programs the header
+*          last and answers UPLOAD_ACK; or UPLOAD_NAK, and the area stays without a valid image
+*        Then the device boots as usual. The image is played from the flash, see Animation_SetUploaded();
+*        the trims of the LEDs in it are saved, see Upload_GetTrims().
+*        Sim/animc -b writes the image of an animation description.
+*
+**********************************************************************************************************/
+
+/***************************************< Includes >**************************************/
+// Standard C libraries
+#include <stddef.h>
+#include <string.h>
+
+// Own includes
+#include "main.h"
+#include "types.h"
+#include "util.h"
+#include "persist.h"
+#include "upload.h"
+#include "memmap.h"
+
+#if UPLOAD_ENABLE
+
+/***************************************< Definitions >**************************************/
+#define UPLOAD_HELLO          ('U')     //!< Sent by the device when it is listening
+#define UPLOAD_ACK            (0x06u)   //!< Accepted, the host may send the next part
+#define UPLOAD_NAK            (0x15u)   //!< Rejected, the upload is over
+#define UPLOAD_WAIT_MS        (1000u)   //!< The host has this long to start sending the header
+#define UPLOAD_BYTE_MS        (200u)    //!< Longest gap between two bytes of a header or a chunk
+#define UPLOAD_DETECT_MS      (2u)      //!< Settling time of the pulldown before reading the RX line
+#define UPLOAD_PAGE_SIZE      (FLASH_PAGE_SIZE)  //!< Size of an erasable and programmable flash page
+#define UPLOAD_MAX_BODY       ( PERSIST_UPLOAD_SIZE - sizeof( S_UPLOAD_HEADER ) )  //!< Largest body fitting in the upload area
+#define UPLOAD_CRC_START      ( offsetof( S_UPLOAD_HEADER, u16BodySize ) )  //!< First header byte covered by the CRC
+
+
+/***************************************< Types >**************************************/
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+#define gau32Chunk  ( guMemMap.sBoot.au32UploadChunk )  //!< Chunk of the body received, in the boot part of the arena
+
+
+/***************************************< Static function definitions >**************************************/
+static void Delay( U16 u16Ms );
+static BOOL IsHostConnected( void );
+static void UartInit( void );
+static void UartDeInit( void );
+static void UartSend( U8 u8Byte );
+static BOOL UartReceive( U8* pu8Data, U8 u8Length, U16 u16TimeoutMs );
+static U16  ImageCRC( const S_UPLOAD_HEADER* psHeader );
+static BOOL Receive( void );
+
+
+/***************************************< Private functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Busy wait on SysTick, before the LED driver starts the ms timer
+//! \param  u16Ms: time to wait
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+static void Delay( U16 u16Ms )
+{
+  SysTick->VAL = 0u;
+  (void)SysTick->CTRL;  // clears COUNTFLAG
+  while( 0u != u16Ms )
+  {
+    if( SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk )
+    {
+      u16Ms--;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Checks for a UART adapter on the RX pin
+//! \param  -
+//! \return TRUE if the RX line is pulled high against the internal pulldown
+//! \global -
+//! \note   The other LED pins are still in analog mode, so the LEDs don't load the line.
+//-----------------------------------------------------------------------------
+static BOOL IsHostConnected( void )
+{
+#if !UTIL_REGISTER_INIT
+  LL_GPIO_InitTypeDef sInit = { 0 };
+#endif
+
+  LL_IOP_GRP1_EnableClock( LL_IOP_GRP1_PERIPH_GPIOA );
+#if UTIL_REGISTER_INIT
+  Util_GPIO_Init( UPLOAD_GPIO_PORT, UPLOAD_RX_GPIO_PIN, LL_GPIO_MODE_INPUT, LL_GPIO_SPEED_FREQ_LOW, LL_GPIO_PULL_DOWN, 0u );
+#else
+  sInit.Pin  = UPLOAD_RX_GPIO_PIN;
+  sInit.Mode = LL_GPIO_MODE_INPUT;
+  sInit.Pull = LL_GPIO_PULL_DOWN;
+  LL_GPIO_Init( UPLOAD_GPIO_PORT, &sInit );
+#endif
+  Delay( UPLOAD_DETECT_MS );
+
+  return LL_GPIO_IsInputPinSet( UPLOAD_GPIO_PORT, UPLOAD_RX_GPIO_PIN ) ? TRUE : FALSE;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Starts USART1 on the ISP pins
+//! \param  -
+//! \return -
+//! \global -
+//! \note   Polled, no interrupts: nothing else runs during the upload.
+//-----------------------------------------------------------------------------
+static void UartInit( void )
+{
+#if UTIL_REGISTER_INIT
+  Util_GPIO_Init( UPLOAD_GPIO_PORT, UPLOAD_TX_GPIO_PIN | UPLOAD_RX_GPIO_PIN, LL_GPIO_MODE_ALTERNATE, LL_GPIO_SPEED_FREQ_LOW, LL_GPIO_PULL_UP, UPLOAD_GPIO_AF );
+#else
+  LL_GPIO_InitTypeDef sInit = { 0 };
+
+  sInit.Pin        = UPLOAD_TX_GPIO_PIN | UPLOAD_RX_GPIO_PIN;
+  sInit.Mode       = LL_GPIO_MODE_ALTERNATE;
+  sInit.Speed      = LL_GPIO_SPEED_FREQ_LOW;
+  sInit.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
+  sInit.Pull       = LL_GPIO_PULL_UP;
+  sInit.Alternate  = UPLOAD_GPIO_AF;
+  LL_GPIO_Init( UPLOAD_GPIO_PORT, &sInit );
+#endif
+
+  LL_APB1_GRP2_EnableClock( LL_APB1_GRP2_PERIPH_USART1 );
+  USART1->BRR = ( SYSCLK_MHZ * 1000000uL + UPLOAD_BAUD / 2u ) / UPLOAD_BAUD;  // APB1 is not divided
+  USART1->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Stops USART1 and gives the pins back in their reset state
+//! \param  -
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+static void UartDeInit( void )
+{
+  while( 0u == ( USART1->SR & USART_SR_TC ) );  // the last answer must get out
+  USART1->CR1 = 0u;
+  LL_APB1_GRP2_DisableClock( LL_APB1_GRP2_PERIPH_USART1 );
+  LL_GPIO_DeInit( UPLOAD_GPIO_PORT );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Sends a byte
+//! \param  u8Byte: the byte
+//! \return -
+//! \global -
+//-----------------------------------------------------------------------------
+static void UartSend( U8 u8Byte )
+{
+  while( 0u == ( USART1->SR & USART_SR_TXE ) );
+  USART1->DR = u8Byte;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Receives a block of bytes
+//! \param  pu8Data: the bytes are written here
+//! \param  u8Length: number of bytes
+//! \param  u16TimeoutMs: longest wait for each byte
+//! \return TRUE if the whole block arrived; FALSE on timeout
+//! \global -
+//! \note   An overrun loses a byte, the CRC catches that. Sleeps between the bytes, most of the
+//!         upload time at UPLOAD_BAUD: WFI is woken by the USART1 interrupt of a byte received, or
+//!         by the SysTick of a ms. Interrupts are disabled meanwhile, so both only pend and are
+//!         cleared here, as FlashSleep() of persist.c does with the FLASH one; their handlers
+//!         belong to the run mode.
+//-----------------------------------------------------------------------------
+static BOOL UartReceive( U8* pu8Data, U8 u8Length, U16 u16TimeoutMs )
+{
+  BOOL bReturn = TRUE;
+  U16  u16Left;
+
+  DISABLE_IT;
+  NVIC->ICPR[ 0u ] = 1uL << USART1_IRQn;
+  NVIC->ISER[ 0u ] = 1uL << USART1_IRQn;
+  USART1->CR1 |= USART_CR1_RXNEIE;
+  SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+  while( ( TRUE == bReturn ) && ( 0u != u8Length ) )
+  {
+    u16Left = u16TimeoutMs;
+    SysTick->VAL = 0u;
+    (void)SysTick->CTRL;  // clears COUNTFLAG
+    SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+    while( ( 0u == ( USART1->SR & USART_SR_RXNE ) ) && ( 0u != u16Left ) )
+    {
+      __WFI();  // a byte arriving after the check has pended already, so it wakes at once
+      SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+      if( SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk )
+      {
+        u16Left--;
+      }
+    }
+    if( USART1->SR & USART_SR_RXNE )
+    {
+      *pu8Data = (U8)USART1->DR;
+      NVIC->ICPR[ 0u ] = 1uL << USART1_IRQn;  // pended until the data register is read
+      pu8Data++;
+      u8Length--;
+    }
+    else
+    {
+      bReturn = FALSE;
+    }
+  }
+  SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+  SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+  USART1->CR1 &= ~USART_CR1_RXNEIE;
+  NVIC->ICER[ 0u ] = 1uL << USART1_IRQn;
+  NVIC->ICPR[ 0u ] = 1uL << USART1_IRQn;
+  ENABLE_IT;
+
+  return bReturn;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Calculates the CRC of an image
+//! \param  psHeader: header of the image; the body is always read from the upload area
+//! \return CRC16 of the header from UPLOAD_CRC_START, and the body
+//! \global -
+//! \note   Chained over flash pages, as Util_CRC16() takes at most 255 bytes.
+//-----------------------------------------------------------------------------
+static U16 ImageCRC( const S_UPLOAD_HEADER* psHeader )
+{
+  U8* pu8Body = (U8*)( PERSIST_UPLOAD_BASE + sizeof( S_UPLOAD_HEADER ) );
+  U16 u16Left = psHeader->u16BodySize;
+  U16 u16Crc;
+  U8  u8Part;
+
+  u16Crc = Util_CRC16( (U8*)psHeader + UPLOAD_CRC_START, sizeof( S_UPLOAD_HEADER ) - UPLOAD_CRC_START );
+  while( 0u != u16Left )
+  {
+    u8Part = ( u16Left > UPLOAD_PAGE_SIZE ) ? UPLOAD_PAGE_SIZE : (U8)u16Left;
+    u16Crc = Util_CRC16Continue( u16Crc, pu8Body, u8Part );
+    pu8Body += u8Part;
+    u16Left -= u8Part;
+  }
+
+  return u16Crc;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Receives an image into the upload area
+//! \param  -
+//! \return TRUE if a complete, correct image got programmed
+//! \global -
+//! \note   A chunk is received into the boot part of the arena, see memmap.h, then programmed
+//!         while the host waits for the answer, so the UART needs no buffering. The CRC is
+//!         continued over each chunk as it arrives, and each programmed part is compared with its
+//!         chunk, so the flash isn't read again for the CRC at the end, and a failed programming
+//!         ends the upload at its chunk. The PY32F002A has no DMA; the CPU sleeps through the
+//!         bytes and the flash operations instead.
+//-----------------------------------------------------------------------------
+static BOOL Receive( void )
+{
+  S_UPLOAD_HEADER sHeader;
+  BOOL bReturn;
+  U16  u16Offset;
+  U16  u16End;
+  U16  u16Crc;
+  U8   u8Length;
+
+  bReturn = UartReceive( (U8*)&sHeader, sizeof( S_UPLOAD_HEADER ), UPLOAD_WAIT_MS );
+  if( ( TRUE == bReturn ) && ( UPLOAD_MAGIC == sHeader.u16Magic ) && ( (U16)~UPLOAD_MAGIC == sHeader.u16MagicInv )
+   && ( sHeader.u16BodySize <= UPLOAD_MAX_BODY ) )
+  {
+    // The old image is gone from here on
+    for( u16Offset = 0u; u16Offset < PERSIST_UPLOAD_SIZE; u16Offset += UPLOAD_PAGE_SIZE )
+    {
+      Persist_EraseFlash( PERSIST_UPLOAD_BASE + u16Offset );
+    }
+    UartSend( UPLOAD_ACK );
+
+    // Body, up to each page boundary; the header words are left erased
+    u16Crc = Util_CRC16( (U8*)&sHeader + UPLOAD_CRC_START, sizeof( S_UPLOAD_HEADER ) - UPLOAD_CRC_START );
+    u16End = sizeof( S_UPLOAD_HEADER ) + sHeader.u16BodySize;
+    for( u16Offset = sizeof( S_UPLOAD_HEADER ); ( TRUE == bReturn ) && ( u16Offset < u16End ); u16Offset += u8Length )
+    {
+      u8Length = (U8)( UPLOAD_PAGE_SIZE - ( u16Offset & ( UPLOAD_PAGE_SIZE - 1u ) ) );
+      if( u8Length > u16End - u16Offset )
+      {
+        u8Length = (U8)( u16End - u16Offset );
+      }
+      bReturn = UartReceive( (U8*)gau32Chunk, u8Length, UPLOAD_BYTE_MS );
+      if( TRUE == bReturn )
+      {
+        u16Crc = Util_CRC16Continue( u16Crc, (U8*)gau32Chunk, u8Length );
+        Persist_WriteFlash( PERSIST_UPLOAD_BASE + u16Offset, (U8*)gau32Chunk, u8Length );
+        bReturn = ( 0 == memcmp( (const U8*)( PERSIST_UPLOAD_BASE + u16Offset ), gau32Chunk, u8Length ) ) ? TRUE : FALSE;
+      }
+      if( TRUE == bReturn )
+      {
+        UartSend( UPLOAD_ACK );
+      }
+    }
+
+    // The magic makes the image valid, so the header goes last
+    if( ( TRUE == bReturn ) && ( sHeader.u16CRC == u16Crc ) )
+    {
+      Persist_WriteFlash( PERSIST_UPLOAD_BASE, (U8*)&sHeader, sizeof( S_UPLOAD_HEADER ) );
+    }
+    else
+    {
+      bReturn = FALSE;
+    }
+  }
+  else
+  {
+    bReturn = FALSE;
+  }
+
+  return bReturn;
+}
+
+
+/***************************************< Public functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Receives an animation, if a UART adapter is connected
+//! \param  -
+//! \return -
+//! \global -
+//! \note   Should be called first in the init block, before the LED driver takes the pins and
+//!         before Util_Init(), as SysTick is borrowed for the timeouts.
+//-----------------------------------------------------------------------------
+void Upload_Run( void )
+{
+  // 1 ms SysTick periods, no interrupt
+  SysTick->LOAD = SYSCLK_MHZ * 1000uL - 1u;
+  SysTick->VAL = 0u;
+  SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+
+  if( TRUE == IsHostConnected() )
+  {
+    UartInit();
+    UartSend( UPLOAD_HELLO );
+    UartSend( Receive() ? UPLOAD_ACK : UPLOAD_NAK );
+    UartDeInit();
+  }
+  else
+  {
+    LL_GPIO_DeInit( UPLOAD_GPIO_PORT );
+  }
+  SysTick->CTRL = 0u;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells the uploaded image
+//! \param  -
+//! \return The header of the image in the upload area; NULL if there is no complete and correct one
+//! \global -
+//-----------------------------------------------------------------------------
+const S_UPLOAD_HEADER* Upload_GetImage( void )
+{
+  const S_UPLOAD_HEADER* psImage = (const S_UPLOAD_HEADER*)PERSIST_UPLOAD_BASE;
+
+  if( ( UPLOAD_MAGIC != psImage->u16Magic ) || ( (U16)~UPLOAD_MAGIC != psImage->u16MagicInv )
+   || ( psImage->u16BodySize > UPLOAD_MAX_BODY )
+   || ( psImage->u16CRC != ImageCRC( psImage ) ) )
+  {
+    psImage = NULL;
+  }
+
+  return psImage;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells the trims of the LEDs in the uploaded image
+//! \param  psImage: the uploaded image, from Upload_GetImage(); NULL if there is none
+//! \return The trims, LEDS_NUM of them; NULL if the image has none
+//! \global -
+//! \note   They are at the start of the body, so the instructions after them stay word aligned.
+//-----------------------------------------------------------------------------
+const U8* Upload_GetTrims( const S_UPLOAD_HEADER* psImage )
+{
+  const U8* pu8Trims = NULL;
+
+  if( ( NULL != psImage ) && ( LEDS_NUM == psImage->u8Trims ) && ( psImage->u16BodySize >= LEDS_NUM ) )
+  {
+    pu8Trims = (const U8*)&psImage[ 1u ];
+  }
+
+  return pu8Trims;
+}
+
+#endif /* UPLOAD_ENABLE */
+
+/***************************************< End of file >**************************************/
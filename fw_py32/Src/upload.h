@@ -0,0 +1,60 @@
+/*! *******************************************************************************************************
+* Copyright (c) 2022 Hekk_Elek
+*
+* \file upload.h
+*
+* \brief Upload of an animation over the UART of the ISP pins
+*
+* \author Hekk_Elek
+*
+**********************************************************************************************************/
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+/***************************************< Includes >**************************************/
+#include "types.h"
+
+
+/***************************************< Definitions >**************************************/
+#ifndef UPLOAD_ENABLE
+#define UPLOAD_ENABLE         (1u)           //!< 1: an uploaded animation replaces the first one; 0: no upload support
+#endif
+#define UPLOAD_MAGIC          (0x414Bu)      //!< Magic number of a complete image: "KA" in the flash
+#define UPLOAD_BAUD           (57600uL)      //!< Baud rate of the upload, 8N1
+
+
+/***************************************< Types >**************************************/
+//! \brief Header of the image in the upload area, followed by the instructions
+//! \note  The CRC covers everything after itself: the rest of the header and the body. The body
+//!        is the trims of the LEDs if there are any, then the normal LED instructions and the RGB
+//!        ones, in the layout of animation.c.
+typedef PACKED struct
+{
+  U16 u16Magic;                     //!< UPLOAD_MAGIC; programmed after everything else, so a torn upload is never played
+  U16 u16MagicInv;                  //!< Bitwise inverse of the magic number, to tell it from erased or corrupt flash
+  U16 u16CRC;                       //!< Util_CRC16() of the header from u16BodySize, and the body
+  U16 u16BodySize;                  //!< Number of bytes after the header
+  U8  u8LengthNormal;               //!< Instructions for the normal LEDs
+  U8  u8LengthRGB;                  //!< Instructions for the RGB LED
+  U8  u8Options;                    //!< Option bits of the animation (LOOP_RGB)
+  U8  u8Trims;                      //!< LEDS_NUM if the body starts with the trims of LED_SetTrims(); 0: none
+} S_UPLOAD_HEADER;
+
+
+/***************************************< Constants >**************************************/
+
+
+/***************************************< Global variables >**************************************/
+
+
+/***************************************< Public functions >**************************************/
+#if UPLOAD_ENABLE
+void Upload_Run( void );
+const S_UPLOAD_HEADER* Upload_GetImage( void );
+const U8*              Upload_GetTrims( const S_UPLOAD_HEADER* psImage );
+#endif
+
+
+#endif /* UPLOAD_H */
+
+/***************************************< End of file >**************************************/
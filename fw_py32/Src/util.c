@@ -11,6 +11,8 @@
 /*
 TODOs in this module:
 -- CRC calculation may need optimization in assembly, as it is a computation-extensive function.
+NOTE: the CRC unit of the PY32F002A has a fixed CRC-32 polynomial, so it can't produce CRC-16F/3;
+      the small nibble table is used instead, see UTIL_CRC16_NIBBLES.
 */
 
 
@@ -19,16 +21,36 @@ TODOs in this module:
 #include "main.h"
 #include "types.h"
 #include "util.h"
+#include "led.h"
+#include "stats.h"
 
 
 /***************************************< Definitions >**************************************/
 #define CRC16_PRECONDITION      (0xBD26u)  //!< Precondition (i.e. initial value) of CRC calculation
+#define TICKS_PER_MS            ( 10u * LED_TICK_DIVIDER )  //!< TIM1 periods per millisecond
+#define LPTIM_HZ                ( LSI_VALUE / 32u )  //!< LPTIM clock: LSI divided by 32, ~1 ms resolution
+#define SLEEP_MAX_MS            (60000u)  //!< Longest sleep, limited by the 16-bit LPTIM counter
+#define CAL_PERIOD_MS           (60000u)  //!< Period of the clock calibration windows
+#define CAL_WINDOW_TICKS        ( 8u * LPTIM_HZ )  //!< Length of a calibration window in LPTIM ticks: 8 s
+#define CAL_WINDOW_MS           ( ( CAL_WINDOW_TICKS * 1000uL ) / LPTIM_HZ )  //!< Length of a calibration window at the nominal HSI
+#define CAL_TOLERANCE_MS        ( CAL_WINDOW_MS / 1000u )  //!< Error left alone: 0.1%, about a trim step
+#define CAL_TRIM_RANGE          (64u)     //!< Farthest trim from the factory one, so a wrong LSI can't take it far
+#define TEMP_REFERENCE_C        (25)      //!< Temperature of the factory trim of the HSI
+#define TEMP_C_PER_TRIM         (10)      //!< degC below TEMP_REFERENCE_C per trim step up, the HSI runs slow in the cold; negative if it runs fast; measure on the board
 
 
 /***************************************< Types >**************************************/
 
 
 /***************************************< Constants >**************************************/
+#if UTIL_CRC16_NIBBLES
+//! \brief Table for calculating CRC-16F/3, four bits at a time
+static CODE const U16 gcau16CRC16F3Table[ 16u ] =
+{
+  0x0000u, 0x1B2Bu, 0x3656u, 0x2D7Du, 0x6CACu, 0x7787u, 0x5AFAu, 0x41D1u,
+  0xD958u, 0xC273u, 0xEF0Eu, 0xF425u, 0xB5F4u, 0xAEDFu, 0x83A2u, 0x9889u
+};
+#else
 //! \brief Table for calculating CRC-16F/3
 CODE const U16 gcau16CRC16F3Table[] =
 {
@@ -65,27 +87,71 @@ CODE const U16 gcau16CRC16F3Table[] =
   0x4AE3u, 0x51C8u, 0x7CB5u, 0x679Eu, 0x264Fu, 0x3D64u, 0x1019u, 0x0B32u,
   0x93BBu, 0x8890u, 0xA5EDu, 0xBEC6u, 0xFF17u, 0xE43Cu, 0xC941u, 0xD26Au
 };
+#endif
 
 
 /***************************************< Global variables >**************************************/
-//! \brief Globally accessible timer with millisecond resolution. IDATA for fast access.
-DATA U16 gu16TimerMS;
+//! \brief Globally accessible timer with millisecond resolution. 32-bit, so it's read and written atomically.
+DATA volatile U32 gu32TimerMS;
 DATA U8  gu8Prescaler;  //!< Prescaler for the global timer. IDATA for fast access.
+static volatile BIT gbitWakeup;  //!< Set by the LPTIM interrupt when the sleep time has elapsed
+static U32 gau32TimerDeadline[ UTIL_NUM_TIMERS ];  //!< Deadlines of the software timers
+static U8  gu8TimerRunning;                        //!< Bit mask of the running software timers
+#if UTIL_PROFILING
+//! \brief Cycle count statistics, a fixed symbol to be read by the debugger
+volatile S_UTIL_PROFILE gasUtilProfile[ UTIL_NUM_PROFILES ];
+#endif
+#if UTIL_TRACE
+//! \brief Ring of the trace entries, fixed symbols to be read by the debugger while running
+//! \note  An entry: event in bits 31..24, data in 23..16, time stamp in 15..0, see Util_Trace().
+//!        The oldest entry is at gu32UtilTraceHead % UTIL_TRACE_LENGTH, once the ring has filled up.
+volatile U32 gau32UtilTrace[ UTIL_TRACE_LENGTH ];
+volatile U32 gu32UtilTraceHead;                  //!< Entries written since the start, free running
+volatile U32 gu32UtilTraceMask = 0xFFFFFFFFu;    //!< Bits of the events logged, E_UTIL_TRACE; without the LED interrupt the ring holds a longer history
+#endif
+static U16 gu16CalFactoryTrim;   //!< HSI trim of the factory
+#if UTIL_CLOCK_CAL
+static BIT gbitCalRunning;       //!< A calibration window is open, the LPTIM is counting it
+static U32 gu32CalStartMs;       //!< Global timer at the start of the window
+#endif
+#if SLEEP_ON_EXIT
+static volatile U32 gu32WakeTime;  //!< The main cycle is pended when the global timer reaches this
+static volatile BIT gbitWakeArmed; //!< gu32WakeTime is valid
+#endif
 
 
 /***************************************< Static function definitions >**************************************/
+static ISR_CODE void CountMs( void );
 
 
 /***************************************< Private functions >**************************************/
+//----------------------------------------------------------------------------
+//! \brief  Counts a millisecond on the global timer
+//! \param  -
+//! \return -
+//! \global Global timer (ms), wakeup time
+//! \note   Runs in interrupt routine. Pends the main cycle at the wakeup time, with SLEEP_ON_EXIT.
+//-----------------------------------------------------------------------------
+static ISR_CODE void CountMs( void )
+{
+  gu32TimerMS++;
+#if SLEEP_ON_EXIT
+  if( gbitWakeArmed && ( (I32)( gu32TimerMS - gu32WakeTime ) >= 0 ) )
+  {
+    gbitWakeArmed = 0;
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;  // run Main_Cycle()
+  }
+#endif
+}
 
 
 /***************************************< Public functions >**************************************/
 //----------------------------------------------------------------------------
 //! \brief  Puts the unique ID of the MCU to a specific array
-//! \param  *pu8Dest: UID will be written here (7 bytes!)
+//! \param  *pu8Dest: UID will be written here (UID_LENGTH bytes!)
 //! \return -
 //! \global -
-//! \note   Make sure pu8Dest points to an array of at least 7 bytes!
+//! \note   Make sure pu8Dest points to an array of at least UID_LENGTH bytes!
 //-----------------------------------------------------------------------------
 void Util_Get_UID( U8* pu8Dest )
 {
@@ -107,25 +173,45 @@ void Util_Get_UID( U8* pu8Dest )
 //-----------------------------------------------------------------------------
 char CODE* Util_Get_UID_ptr( void )
 {
-  return (char CODE *)0x1FF9;  // STC8G1K08
+  return (char CODE *)UID_BASE;  // PY32F002A: 128 bits in the system memory
 }
 
 //----------------------------------------------------------------------------
 //! \brief  Increase timer value
-//! \param  -
+//! \param  u8Ticks: number of TIM1 periods elapsed since the last call
 //! \return -
-//! \global Global timer (ms)
-//! \note   Runs in interrupt routine
+//! \global Global timer (ms), wakeup time
+//! \note   Runs in interrupt routine. With UTIL_SYSTICK_MS the ms are counted by Util_TickInterrupt()
+//!         instead, the TIM1 periods may be of any length.
 //-----------------------------------------------------------------------------
-void Util_Interrupt( void )
+ISR_CODE void Util_Interrupt( U8 u8Ticks )
 {
-  gu8Prescaler++;
-  if( gu8Prescaler >= 10u )
+#if UTIL_SYSTICK_MS
+  (void)u8Ticks;
+#else
+  gu8Prescaler += u8Ticks;
+  while( gu8Prescaler >= TICKS_PER_MS )
   {
-    gu16TimerMS++;
-    gu8Prescaler = 0u;
+    gu8Prescaler -= TICKS_PER_MS;
+    CountMs();
   }
+#endif
+}
+
+#if UTIL_SYSTICK_MS
+//----------------------------------------------------------------------------
+//! \brief  Increase timer value by a millisecond
+//! \param  -
+//! \return -
+//! \global Global timer (ms), wakeup time
+//! \note   Should be called from the SysTick interrupt. SysTick stops in stop mode, Util_Sleep()
+//!         adds the time slept, as without it.
+//-----------------------------------------------------------------------------
+void Util_TickInterrupt( void )
+{
+  CountMs();
 }
+#endif
 
 //----------------------------------------------------------------------------
 //! \brief  Initialize global variables
@@ -137,7 +223,180 @@ void Util_Interrupt( void )
 void Util_Init( void )
 {
   gu8Prescaler = 0u;
-  gu16TimerMS = 0u;
+  gu32TimerMS = 0u;
+  gu8TimerRunning = 0u;
+  
+  // LPTIM for tickless sleep, clocked by the LSI which keeps running in stop mode
+  LL_RCC_LSI_Enable();
+  while( LL_RCC_LSI_IsReady() != 1 );
+  LL_RCC_SetLPTIMClockSource( LL_RCC_LPTIM1_CLKSOURCE_LSI );
+  LL_APB1_GRP1_EnableClock( LL_APB1_GRP1_PERIPH_LPTIM1 );
+  LL_APB1_GRP1_EnableClock( LL_APB1_GRP1_PERIPH_PWR );
+  LL_LPTIM_SetPrescaler( LPTIM1, LL_LPTIM_PRESCALER_DIV32 );
+  LL_EXTI_EnableIT( LL_EXTI_LINE_29 );  // LPTIM wakeup line
+  NVIC_SetPriority( LPTIM1_IRQn, IRQ_PRIORITY_EVENT );
+  NVIC_EnableIRQ( LPTIM1_IRQn );
+  gu16CalFactoryTrim = (U16)LL_RCC_HSI_GetCalibTrimming();
+#if UTIL_CLOCK_CAL
+  gbitCalRunning = 0;
+  Util_TimerStart( UTIL_TIMER_CLOCK_CAL, CAL_PERIOD_MS );
+#endif
+  
+#if UTIL_SYSTICK_MS
+  // SysTick as the ms timebase, apart from the period of the LED driver
+  SysTick->LOAD = SYSCLK_MHZ * 1000uL - 1u;
+  SysTick->VAL = 0u;
+  NVIC_SetPriority( SysTick_IRQn, IRQ_PRIORITY_TIME );
+  SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;  // HCLK
+#elif UTIL_PROFILING || UTIL_TRACE || STATS_RESIDENCY
+  // SysTick as a free-running cycle counter: the M0+ has no DWT, and SysTick isn't used otherwise
+  SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+  SysTick->VAL = 0u;
+  SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;  // HCLK, no interrupt
+#endif
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Sleeps in stop mode, and advances the global timer with the time spent
+//! \param  u16Ms: time to sleep in ms
+//! \return -
+//! \global Global timer (ms)
+//! \note   Should be called from main program only, with TIM1 stopped!
+//!         Any other enabled interrupt ends the sleep earlier.
+//-----------------------------------------------------------------------------
+void Util_Sleep( U16 u16Ms )
+{
+  U32 u32Ticks;
+  
+  if( u16Ms > SLEEP_MAX_MS )
+  {
+    u16Ms = SLEEP_MAX_MS;
+  }
+  u32Ticks = ( (U32)u16Ms * LPTIM_HZ ) / 1000u;
+#if UTIL_CLOCK_CAL
+  if( gbitCalRunning )
+  {
+    // The sleep takes the LPTIM, the window is opened again later
+    gbitCalRunning = 0;
+    Util_TimerStart( UTIL_TIMER_CLOCK_CAL, CAL_PERIOD_MS );
+  }
+#endif
+  
+  // Start one-shot LPTIM
+  gbitWakeup = FALSE;
+  LL_LPTIM_Enable( LPTIM1 );
+  LL_LPTIM_ClearFLAG_ARRM( LPTIM1 );
+  LL_LPTIM_EnableIT_ARRM( LPTIM1 );
+  LL_LPTIM_SetAutoReload( LPTIM1, u32Ticks );
+  LL_LPTIM_StartCounter( LPTIM1, LL_LPTIM_OPERATING_MODE_ONESHOT );
+  
+  // Enter stop mode
+  LL_LPM_EnableDeepSleep();
+  __WFI();
+  LL_LPM_EnableSleep();
+  
+  // Find out how much time has elapsed
+  if( !gbitWakeup )  // woken up by something else
+  {
+    u32Ticks = LL_LPTIM_GetCounter( LPTIM1 );
+  }
+  LL_LPTIM_Disable( LPTIM1 );
+  gu32TimerMS += ( u32Ticks * 1000u ) / LPTIM_HZ;  // TIM1 is stopped, nobody else writes it now
+}
+
+#if UTIL_CLOCK_CAL
+//----------------------------------------------------------------------------
+//! \brief  Trims the HSI against the LSI, in windows of CAL_WINDOW_TICKS
+//! \param  -
+//! \return -
+//! \global gbitCalRunning, gu32CalStartMs, gu16CalFactoryTrim, gbitWakeup
+//! \note   Should be called from main cycle only! Every CAL_PERIOD_MS the one-shot LPTIM times a
+//!         window of the LSI, while the TIM1 ms count the HSI; the trim then takes one step towards
+//!         the LSI, so the temperature drift is followed slowly and without a jump in the timing.
+//!         Nothing blocks: a sleep in the window cancels it. The LSI is the only reference on the
+//!         chip, so this is as good as the LSI; what it surely gives is that the ms of the animations
+//!         and of the sleeps in between are the same, which keeps the auto-off time right.
+//-----------------------------------------------------------------------------
+void Util_ClockCalCycle( void )
+{
+  U32 u32Ms;
+  U32 u32Trim;
+  
+  if( !gbitCalRunning )
+  {
+    if( Util_TimerExpired( UTIL_TIMER_CLOCK_CAL ) )
+    {
+      // Open the window: the LPTIM interrupt marks its end
+      gbitWakeup = FALSE;
+      LL_LPTIM_Enable( LPTIM1 );
+      LL_LPTIM_ClearFLAG_ARRM( LPTIM1 );
+      LL_LPTIM_EnableIT_ARRM( LPTIM1 );
+      LL_LPTIM_SetAutoReload( LPTIM1, CAL_WINDOW_TICKS );
+      LL_LPTIM_StartCounter( LPTIM1, LL_LPTIM_OPERATING_MODE_ONESHOT );
+      gu32CalStartMs = gu32TimerMS;
+      gbitCalRunning = 1;
+    }
+  }
+  else if( gbitWakeup )
+  {
+    u32Ms = gu32TimerMS - gu32CalStartMs;
+    LL_LPTIM_Disable( LPTIM1 );
+    gbitCalRunning = 0;
+    // More ms than nominal in the window: the HSI is fast
+    u32Trim = LL_RCC_HSI_GetCalibTrimming();
+    if( ( u32Ms > ( CAL_WINDOW_MS + CAL_TOLERANCE_MS ) ) && ( u32Trim + CAL_TRIM_RANGE > gu16CalFactoryTrim ) && ( 0u != u32Trim ) )
+    {
+      u32Trim--;
+    }
+    else if( ( ( u32Ms + CAL_TOLERANCE_MS ) < CAL_WINDOW_MS ) && ( u32Trim < gu16CalFactoryTrim + CAL_TRIM_RANGE ) && ( u32Trim < RCC_ICSCR_HSI_TRIM_Msk ) )
+    {
+      u32Trim++;
+    }
+    LL_RCC_HSI_SetCalibTrimming( u32Trim );
+    Util_TimerStart( UTIL_TIMER_CLOCK_CAL, CAL_PERIOD_MS );
+  }
+}
+#endif
+
+//----------------------------------------------------------------------------
+//! \brief  Corrects the HSI trim for the temperature of the chip
+//! \param  i8Celsius: temperature of the chip in degC
+//! \return -
+//! \global gu16CalFactoryTrim
+//! \note   Without a reference running, the drift of the HSI is taken as linear around the factory
+//!         trim, TEMP_C_PER_TRIM per step; the steps are 0.1%, the time is kept within that. With
+//!         UTIL_CLOCK_CAL the LSI windows own the trim, the temperature is left to them.
+//-----------------------------------------------------------------------------
+void Util_SetTemperature( I8 i8Celsius )
+{
+#if UTIL_CLOCK_CAL
+  (void)i8Celsius;
+#else
+  I32 i32Trim = (I32)gu16CalFactoryTrim + ( TEMP_REFERENCE_C - (I32)i8Celsius ) / TEMP_C_PER_TRIM;
+  
+  if( i32Trim < 0 )
+  {
+    i32Trim = 0;
+  }
+  else if( i32Trim > (I32)RCC_ICSCR_HSI_TRIM_Msk )
+  {
+    i32Trim = (I32)RCC_ICSCR_HSI_TRIM_Msk;
+  }
+  LL_RCC_HSI_SetCalibTrimming( (U32)i32Trim );
+#endif
+}
+
+//----------------------------------------------------------------------------
+//! \brief  LPTIM interrupt: the sleep time, or the calibration window, has elapsed
+//! \param  -
+//! \return -
+//! \global -
+//! \note   Runs in interrupt routine
+//-----------------------------------------------------------------------------
+void Util_WakeupInterrupt( void )
+{
+  LL_LPTIM_ClearFLAG_ARRM( LPTIM1 );
+  gbitWakeup = TRUE;
 }
 
 //----------------------------------------------------------------------------
@@ -145,17 +404,119 @@ void Util_Init( void )
 //! \param  -
 //! \return Timer value
 //! \global Global timer (ms)
-//! \note   Should be called from main program only!
+//! \note   Lock-free: a 32-bit aligned load is atomic on the Cortex-M0+, so no interrupt is delayed.
 //-----------------------------------------------------------------------------
 U16 Util_GetTimerMs( void )
 {
-  U16 u16Ret;
+  return (U16)gu32TimerMS;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Get global timer (ms), full 32 bits
+//! \param  -
+//! \return Milliseconds since Util_Init(), including the time spent in Util_Sleep()
+//! \global Global timer (ms)
+//! \note   Monotonic, wraps around after 49 days only. Lock-free, like Util_GetTimerMs().
+//-----------------------------------------------------------------------------
+U32 Util_GetTimerMs32( void )
+{
+  return gu32TimerMS;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells if a deadline has been reached
+//! \param  u32Deadline: deadline, e.g. Util_GetTimerMs32() + delay
+//! \return TRUE if the deadline is now or in the past
+//! \global Global timer (ms)
+//! \note   Compares with signed difference, so it works across the wrap-around, and a late
+//!         check doesn't miss the deadline like an equality check would.
+//-----------------------------------------------------------------------------
+BOOL Util_IsDeadlineReached( U32 u32Deadline )
+{
+  return ( (I32)( gu32TimerMS - u32Deadline ) >= 0 );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Sleeps until a deadline has been reached
+//! \param  u32Deadline: deadline, e.g. Util_GetTimerMs32() + delay
+//! \return -
+//! \global Global timer (ms)
+//! \note   Should be called from main program only, with TIM1 running. The CPU sleeps between
+//!         the timer interrupts instead of polling.
+//-----------------------------------------------------------------------------
+void Util_WaitUntil( U32 u32Deadline )
+{
+  while( !Util_IsDeadlineReached( u32Deadline ) )
+  {
+    __WFI();
+  }
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Starts (or restarts) a software timer
+//! \param  eTimer: the timer
+//! \param  u32DelayMs: time until the timer expires
+//! \return -
+//! \global Software timers
+//! \note   Should be called from main program only!
+//-----------------------------------------------------------------------------
+void Util_TimerStart( E_UTIL_TIMER eTimer, U32 u32DelayMs )
+{
+  gau32TimerDeadline[ eTimer ] = gu32TimerMS + u32DelayMs;
+  gu8TimerRunning |= ( 1u << eTimer );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Stops a software timer
+//! \param  eTimer: the timer
+//! \return -
+//! \global Software timers
+//! \note   Should be called from main program only!
+//-----------------------------------------------------------------------------
+void Util_TimerStop( E_UTIL_TIMER eTimer )
+{
+  gu8TimerRunning &= ~( 1u << eTimer );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Checks if a software timer has expired
+//! \param  eTimer: the timer
+//! \return TRUE once, when the timer has expired; the timer is stopped then
+//! \global Software timers
+//! \note   Should be called from main program only!
+//-----------------------------------------------------------------------------
+BOOL Util_TimerExpired( E_UTIL_TIMER eTimer )
+{
+  BOOL bExpired = FALSE;
   
-  DISABLE_IT;
-  u16Ret = gu16TimerMS;
-  ENABLE_IT;
+  if( ( gu8TimerRunning & ( 1u << eTimer ) ) && Util_IsDeadlineReached( gau32TimerDeadline[ eTimer ] ) )
+  {
+    gu8TimerRunning &= ~( 1u << eTimer );
+    bExpired = TRUE;
+  }
   
-  return u16Ret;
+  return bExpired;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Tells how long a software timer still runs
+//! \param  eTimer: the timer
+//! \return Time until the timer expires; 0 if it has already expired, UTIL_TIMER_NONE if it is stopped
+//! \global Software timers
+//! \note   Should be called from main program only! For the deadlines of the tasks in Main_Cycle().
+//-----------------------------------------------------------------------------
+U32 Util_TimerLeftMs( E_UTIL_TIMER eTimer )
+{
+  I32 i32Left;
+  U32 u32Left = UTIL_TIMER_NONE;
+  
+  if( gu8TimerRunning & ( 1u << eTimer ) )
+  {
+    i32Left = (I32)( gau32TimerDeadline[ eTimer ] - gu32TimerMS );
+    u32Left = ( i32Left < 0 ) ? 0u : (U32)i32Left;
+  }
+  
+  return u32Left;
 }
 
 //----------------------------------------------------------------------------
@@ -164,20 +525,203 @@ U16 Util_GetTimerMs( void )
 //! \param  u8Length: length of the buffer
 //! \return CRC16 value
 //! \global -
+//! \note   CRC-16F/3, compatible with the STC8 firmware, whichever table is selected.
 //-----------------------------------------------------------------------------
 U16 Util_CRC16( U8* pu8Buffer, U8 u8Length ) REENTRANT
 {
-  U16 u16Crc;
+  return Util_CRC16Continue( CRC16_PRECONDITION, pu8Buffer, u8Length );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Continues a CRC16 calculation with the next part of the data
+//! \param  u16Crc: CRC16 of the data before this part, as returned by Util_CRC16() or by this
+//! \param  *pu8Buffer: the next part of the data
+//! \param  u8Length: length of this part
+//! \return CRC16 of all the data so far
+//! \global -
+//! \note   For blocks longer than 255 bytes: chaining the parts gives the same value as Util_CRC16()
+//!         on the whole block.
+//-----------------------------------------------------------------------------
+U16 Util_CRC16Continue( U16 u16Crc, U8* pu8Buffer, U8 u8Length ) REENTRANT
+{
   U8  u8Idx;
 
-  u16Crc = CRC16_PRECONDITION;
   for( u8Idx = 0; u8Idx != u8Length; u8Idx++ )
   {
+#if UTIL_CRC16_NIBBLES
+    // Same result as the byte table: the first 16 entries of it are the CRCs of the nibbles
+    u16Crc = (U16)( u16Crc << 4u ) ^ gcau16CRC16F3Table[ (U8)( u16Crc >> 12u ) ^ ( pu8Buffer[ u8Idx ] >> 4u ) ];
+    u16Crc = (U16)( u16Crc << 4u ) ^ gcau16CRC16F3Table[ (U8)( u16Crc >> 12u ) ^ ( pu8Buffer[ u8Idx ] & 0x0Fu ) ];
+#else
     u16Crc = (U16)( u16Crc << 8u ) ^ gcau16CRC16F3Table[ (U8)( u16Crc >> 8u ) ^ pu8Buffer[ u8Idx ] ];
+#endif
   }
 
   return u16Crc;
 }
 
+#if SLEEP_ON_EXIT
+//----------------------------------------------------------------------------
+//! \brief  Arms the wakeup of the main cycle
+//! \param  u16Ms: time until the main cycle has something to do; 0 for the next ms
+//! \return -
+//! \global wakeup time
+//! \note   The main cycle is pended at the first ms tick when the time is up. Interrupts of
+//!         other events, such as the button, pend it themselves.
+//-----------------------------------------------------------------------------
+void Util_WakeAfter( U16 u16Ms )
+{
+  gu32WakeTime = gu32TimerMS + u16Ms;
+  gbitWakeArmed = 1;
+}
+#endif
+
+
+#if UTIL_PROFILING
+//----------------------------------------------------------------------------
+//! \brief  Takes the start time of a measured code section
+//! \param  -
+//! \return Snapshot of the cycle counter, for Util_ProfileEnd()
+//! \global -
+//-----------------------------------------------------------------------------
+U32 Util_ProfileStart( void )
+{
+  return SysTick->VAL;
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Adds the length of a measured code section to its statistics
+//! \param  eSection: the code section
+//! \param  u32Start: return value of Util_ProfileStart() at the start of the section
+//! \return -
+//! \global gasUtilProfile[]
+//-----------------------------------------------------------------------------
+void Util_ProfileEnd( E_UTIL_PROFILE eSection, U32 u32Start )
+{
+  Util_ProfileAdd( &gasUtilProfile[ eSection ], u32Start );
+}
+
+//----------------------------------------------------------------------------
+//! \brief  Adds the length of a measured code section to the given statistics
+//! \param  psProfile: the statistics, e.g. of a module's own table read over SWD
+//! \param  u32Start: return value of Util_ProfileStart() at the start of the section
+//! \return -
+//! \global -
+//! \note   SysTick counts down and wraps after 2^24 cycles, longer sections can't be measured.
+//!         Stops in stop mode, so sections must not contain tickless sleep.
+//-----------------------------------------------------------------------------
+void Util_ProfileAdd( volatile S_UTIL_PROFILE* psProfile, U32 u32Start )
+{
+  U32 u32Cycles = ( u32Start - SysTick->VAL ) & SysTick_LOAD_RELOAD_Msk;
+  
+  if( 0u == psProfile->u32Count )
+  {
+    psProfile->u32Min = u32Cycles;
+    psProfile->u32Max = u32Cycles;
+    psProfile->u32Avg16 = u32Cycles << 4u;
+  }
+  if( u32Cycles < psProfile->u32Min )
+  {
+    psProfile->u32Min = u32Cycles;
+  }
+  if( u32Cycles > psProfile->u32Max )
+  {
+    psProfile->u32Max = u32Cycles;
+  }
+  psProfile->u32Avg16 += u32Cycles - ( psProfile->u32Avg16 >> 4u );  // 1/16 weight, no division
+  psProfile->u32Count++;
+}
+#endif
+
+
+#if UTIL_REGISTER_INIT
+//----------------------------------------------------------------------------
+//! \brief  Sets up pins of a port, in place of LL_GPIO_Init()
+//! \param  psPort: the port, e.g. GPIOA
+//! \param  u32Pins: the pins, LL_GPIO_PIN_x combined
+//! \param  u32Mode: LL_GPIO_MODE_x
+//! \param  u32Speed: LL_GPIO_SPEED_FREQ_x
+//! \param  u32Pull: LL_GPIO_PULL_x
+//! \param  u32Alternate: LL_GPIO_AF_x; only used in alternate mode
+//! \return -
+//! \global -
+//! \note   One read-modify-write per register for all the pins, instead of one per pin and field.
+//!         A field mask divided by its all-ones value has a 1 at the bottom of every field, so
+//!         multiplied by the value it sets that in every field. The output type is always
+//!         push-pull. The mode comes last, so a pin only starts driving when it is set up.
+//-----------------------------------------------------------------------------
+void Util_GPIO_Init( GPIO_TypeDef* psPort, U32 u32Pins, U32 u32Mode, U32 u32Speed, U32 u32Pull, U32 u32Alternate )
+{
+  U32 u32Mask2 = 0u;                // 2-bit fields of the pins: MODER, OSPEEDR, PUPDR
+  U32 au32Mask4[ 2 ] = { 0u, 0u };  // 4-bit fields of the pins: AFR[0], AFR[1]
+  U8  u8Pin;
+  
+  for( u8Pin = 0u; u8Pin < 16u; u8Pin++ )
+  {
+    if( 0u != ( u32Pins & ( 1uL << u8Pin ) ) )
+    {
+      u32Mask2 |= 0x3uL << ( 2u * u8Pin );
+      au32Mask4[ u8Pin >> 3u ] |= 0xFuL << ( 4u * ( u8Pin & 7u ) );
+    }
+  }
+  MODIFY_REG( psPort->OSPEEDR, u32Mask2, ( u32Mask2 / 0x3u ) * u32Speed );
+  CLEAR_BIT( psPort->OTYPER, u32Pins );
+  MODIFY_REG( psPort->PUPDR, u32Mask2, ( u32Mask2 / 0x3u ) * u32Pull );
+  if( LL_GPIO_MODE_ALTERNATE == u32Mode )
+  {
+    MODIFY_REG( psPort->AFR[ 0 ], au32Mask4[ 0 ], ( au32Mask4[ 0 ] / 0xFu ) * u32Alternate );
+    MODIFY_REG( psPort->AFR[ 1 ], au32Mask4[ 1 ], ( au32Mask4[ 1 ] / 0xFu ) * u32Alternate );
+  }
+  MODIFY_REG( psPort->MODER, u32Mask2, ( u32Mask2 / 0x3u ) * u32Mode );
+}
+#endif
+
+#if UTIL_PROBES
+//----------------------------------------------------------------------------
+//! \brief  Sets the pins of the debug probes up as low outputs
+//! \param  -
+//! \return -
+//! \global -
+//! \note   Should be called after Util_Init(), and again after the stop mode, as PowerDown() parks
+//!         every pin. A probe pin of an LED, the button or the ISP UART collides with them!
+//-----------------------------------------------------------------------------
+void Util_ProbeInit( void )
+{
+  LL_IOP_GRP1_EnableClock( LL_IOP_GRP1_PERIPH_GPIOA | LL_IOP_GRP1_PERIPH_GPIOB | LL_IOP_GRP1_PERIPH_GPIOF );
+  UTIL_PROBE_INIT( PROBE_LED_IRQ_PIN );
+  UTIL_PROBE_INIT( PROBE_LED_PIN );
+  UTIL_PROBE_INIT( PROBE_RGBLED_PIN );
+  UTIL_PROBE_INIT( PROBE_ANIMATION_PIN );
+}
+#endif
+
+#if UTIL_TRACE
+//----------------------------------------------------------------------------
+//! \brief  Logs an event into the trace ring
+//! \param  eEvent: the event
+//! \param  u8Data: its data
+//! \return -
+//! \global gau32UtilTrace[], gu32UtilTraceHead, gu32UtilTraceMask
+//! \note   Called through UTIL_TRACE_EVENT() only, from the interrupts too, so an entry is written
+//!         with them masked. The time stamp is the SysTick cycle counter, counting up, in units of
+//!         2^UTIL_TRACE_STAMP_SHIFT cycles: it wraps in 131 ms at 8 MHz, the ms of the commits and
+//!         the regular LED interrupts tell the wraps apart. Stops in stop mode, like the profiling.
+//-----------------------------------------------------------------------------
+ISR_CODE void Util_Trace( E_UTIL_TRACE eEvent, U8 u8Data )
+{
+  U32 u32Primask;
+  U32 u32Stamp;
+  
+  if( gu32UtilTraceMask & ( 1uL << eEvent ) )
+  {
+    u32Stamp = ( ( SysTick_LOAD_RELOAD_Msk - SysTick->VAL ) >> UTIL_TRACE_STAMP_SHIFT ) & 0xFFFFu;
+    u32Primask = __get_PRIMASK();
+    __disable_irq();
+    gau32UtilTrace[ gu32UtilTraceHead % UTIL_TRACE_LENGTH ] = ( (U32)eEvent << 24u ) | ( (U32)u8Data << 16u ) | u32Stamp;
+    gu32UtilTraceHead++;
+    __set_PRIMASK( u32Primask );  // the callers with masked interrupts stay so
+  }
+}
+#endif
 
 /***************************************< End of file >**************************************/
@@ -17,32 +17,170 @@
 
 
 /***************************************< Definitions >**************************************/
-#define UID_LENGTH        (7u)  //!< Length of the unique ID of the MCU
-#define SYSTEM_CLOCK_MHZ (24u)  //!< System clock in MHz, rounded to integers
+#define UID_LENGTH        (16u)  //!< Length of the unique ID of the MCU: 128 bits
+#define UTIL_TIMER_NONE    (0xFFFFFFFFu)  //!< Returned by Util_TimerLeftMs() for a stopped timer
+#ifndef UTIL_PROFILING
+#define UTIL_PROFILING     (0)  //!< 1: cycle counts of the LED interrupt and the animation are collected in gasUtilProfile[], per animation and opcode in gasAnimationCost[] and gasAnimationOpCost[]
+#endif
+#ifndef UTIL_TRACE
+#define UTIL_TRACE         (0)  //!< 1: events of the interrupts and the tasks are logged in gau32UtilTrace[], see UTIL_TRACE_EVENT()
+#endif
+#define UTIL_TRACE_LENGTH  (64u)  //!< Entries of the trace ring, a power of 2
+#define UTIL_TRACE_STAMP_SHIFT (4u)  //!< The time stamp of a trace entry counts 2^UTIL_TRACE_STAMP_SHIFT cycles
+#ifndef UTIL_PROBES
+#define UTIL_PROBES        (0)  //!< 1: the PROBE_..._PIN pins of main.h are high during their code sections, for a logic analyzer
+#endif
+#ifndef UTIL_CLOCK_CAL
+#define UTIL_CLOCK_CAL     (0)  //!< 1: the HSI trim follows the LSI at run time, so the active and the sleeping ms agree
+#endif
+#ifndef UTIL_REGISTER_INIT
+#define UTIL_REGISTER_INIT (0)  //!< 1: GPIO and TIM1 are set up by register writes, the LL init functions are not linked
+#endif
+#ifndef UTIL_SYSTICK_MS
+#define UTIL_SYSTICK_MS    (0)  //!< 1: the global timer is counted by the SysTick interrupt; 0: by the TIM1 periods of the LED driver
+#endif
+#if UTIL_SYSTICK_MS && ( UTIL_PROFILING || UTIL_TRACE )
+#error "UTIL_SYSTICK_MS: SysTick is the cycle counter of UTIL_PROFILING and UTIL_TRACE, build those with the TIM1 timebase"
+#endif
+#ifndef UTIL_CRC16_NIBBLES
+#define UTIL_CRC16_NIBBLES (1)  //!< 1: CRC with a 32-byte nibble table; 0: with a 512-byte byte table, twice as fast
+#endif
 
 
 /***************************************< Macros >**************************************/
-#define DISABLE_IT     __enable_irq();   //!< Global interrupt disable
-#define ENABLE_IT      __disable_irq();  //!< Global interrupt enable
+#define DISABLE_IT     __disable_irq();  //!< Global interrupt disable
+#define ENABLE_IT      __enable_irq();   //!< Global interrupt enable
+#if UTIL_TRACE
+#define UTIL_TRACE_EVENT( event, data )  Util_Trace( (event), (U8)(data) )  //!< Logs an event, E_UTIL_TRACE, with a byte of data
+#else
+#define UTIL_TRACE_EVENT( event, data )  //!< Compiled out
+#endif
+#if UTIL_PROBES
+#define UTIL_PROBE_HIGH( pin )         UTIL_PROBE_HIGH_( pin )  //!< Sets a probe pin, port and pin number; argument is expanded first
+#define UTIL_PROBE_HIGH_( port, num )  WRITE_REG( GPIO##port->BSRR, (U32)1u << (num) )
+#define UTIL_PROBE_LOW( pin )          UTIL_PROBE_LOW_( pin )   //!< Clears a probe pin
+#define UTIL_PROBE_LOW_( port, num )   WRITE_REG( GPIO##port->BRR, (U32)1u << (num) )
+#define UTIL_PROBE_INIT( pin )         UTIL_PROBE_INIT_( pin )  //!< Makes a probe pin a low output
+#define UTIL_PROBE_INIT_( port, num )  do { WRITE_REG( GPIO##port->BRR, (U32)1u << (num) ); \
+                                            LL_GPIO_SetPinMode( GPIO##port, (U32)1u << (num), LL_GPIO_MODE_OUTPUT ); } while( 0 )
+#else
+#define UTIL_PROBE_HIGH( pin )   //!< Compiled out
+#define UTIL_PROBE_LOW( pin )    //!< Compiled out
+#endif
 
 
 /***************************************< Types >**************************************/
+//! \brief Software timers of the main loop
+typedef enum
+{
+  UTIL_TIMER_BUTTON = 0u,  //!< Button debounce and hold levels
+  UTIL_TIMER_AUTO_OFF,     //!< Automatic power-down
+  UTIL_TIMER_BATTERY,      //!< Battery indicator steps
+  UTIL_TIMER_PERSIST,      //!< Deferred save of the persistent data
+  UTIL_TIMER_AUTO_CYCLE,   //!< Next step of the auto-cycle mode
+  UTIL_TIMER_LIGHT_SENSE,  //!< Next ambient light measurement of the LED driver
+  UTIL_TIMER_LED_FAULT,    //!< Next probe of the LED fault check
+  UTIL_TIMER_SYNC,         //!< Next light sample of the phase lock
+  UTIL_TIMER_CLOCK_CAL,    //!< Next window of the clock calibration
+  UTIL_TIMER_RUNTIME,      //!< Next plan of the runtime plan
+  UTIL_TIMER_STREAM,       //!< End of the frame stream, when no frame comes
+  UTIL_NUM_TIMERS          //!< Number of software timers
+} E_UTIL_TIMER;
+
+#if UTIL_PROFILING
+//! \brief Measured code sections
+typedef enum
+{
+  UTIL_PROFILE_LED_IRQ = 0u,  //!< TIM1 interrupt handler; built with ISR_IN_RAM 0 and 1, it shows what the flash access costs
+  UTIL_PROFILE_ANIMATION,     //!< Animation_Cycle(), including the interrupts preempting it
+  UTIL_PROFILE_BOOT,          //!< From Util_Init() to the first frame handed over, lit at the next LED period; recorded once
+  UTIL_NUM_PROFILES           //!< Number of measured code sections
+} E_UTIL_PROFILE;
+
+//! \brief Cycle count statistics of a code section, for reading over SWD
+typedef struct
+{
+  U32 u32Min;    //!< Fewest cycles
+  U32 u32Max;    //!< Most cycles
+  U32 u32Avg16;  //!< Moving average of the cycles, multiplied by 16
+  U32 u32Count;  //!< Number of measurements; writing 0 restarts the statistics
+} S_UTIL_PROFILE;
+#endif
+
+
+#if UTIL_TRACE
+//! \brief Events of the trace, bits of gu32UtilTraceMask
+typedef enum
+{
+  UTIL_TRACE_LED_IRQ = 0u,    //!< TIM1 interrupt handler entered; data: 0
+  UTIL_TRACE_LED_IRQ_END,     //!< TIM1 interrupt handler left; data: TIM1 periods taken by the LED driver
+  UTIL_TRACE_COMMIT,          //!< A frame handed over to the LED driver, see LED_CommitAt(); data: low byte of its due time in ms
+  UTIL_TRACE_TASK,            //!< A task of the main cycle run; data: E_MAIN_TASK
+  UTIL_TRACE_SLEEP,           //!< Tickless sleep entered; data: sleep time in ms, 255 for longer
+  UTIL_TRACE_WAKEUP,          //!< Tickless sleep left; data: 0
+  UTIL_TRACE_GESTURE,         //!< A gesture of the button recognized; data: E_BUTTON_GESTURE
+  UTIL_TRACE_SAVE,            //!< The persistent data saved; data: bytes changed
+  UTIL_NUM_TRACES             //!< Number of the events, at most 32
+} E_UTIL_TRACE;
+#endif
 
 
 /***************************************< Constants >**************************************/
 
 
 /***************************************< Global variables >**************************************/
-extern DATA U16 gu16TimerMS;
+extern DATA volatile U32 gu32TimerMS;
+#if UTIL_PROFILING
+extern volatile S_UTIL_PROFILE gasUtilProfile[ UTIL_NUM_PROFILES ];
+#endif
+#if UTIL_TRACE
+extern volatile U32 gau32UtilTrace[ UTIL_TRACE_LENGTH ];
+extern volatile U32 gu32UtilTraceHead;
+extern volatile U32 gu32UtilTraceMask;
+#endif
 
 
 /***************************************< Public functions >**************************************/
 char CODE* Util_Get_UID_ptr( void );
 void Util_Get_UID( U8* pu8Dest );
-void Util_Interrupt( void );
+ISR_CODE void Util_Interrupt( U8 u8Ticks );
+#if UTIL_SYSTICK_MS
+void Util_TickInterrupt( void );
+#endif
 void Util_Init( void );
+void Util_Sleep( U16 u16Ms );
+void Util_WakeupInterrupt( void );
 U16 Util_GetTimerMs( void );
+U32 Util_GetTimerMs32( void );
+BOOL Util_IsDeadlineReached( U32 u32Deadline );
+void Util_WaitUntil( U32 u32Deadline );
+void Util_TimerStart( E_UTIL_TIMER eTimer, U32 u32DelayMs );
+void Util_TimerStop( E_UTIL_TIMER eTimer );
+BOOL Util_TimerExpired( E_UTIL_TIMER eTimer );
+U32 Util_TimerLeftMs( E_UTIL_TIMER eTimer );
+#if SLEEP_ON_EXIT
+void Util_WakeAfter( U16 u16Ms );
+#endif
+#if UTIL_CLOCK_CAL
+void Util_ClockCalCycle( void );
+#endif
+void Util_SetTemperature( I8 i8Celsius );
 U16 Util_CRC16( U8* pu8Buffer, U8 u8Length ) REENTRANT;
+U16 Util_CRC16Continue( U16 u16Crc, U8* pu8Buffer, U8 u8Length ) REENTRANT;
+#if UTIL_REGISTER_INIT
+void Util_GPIO_Init( GPIO_TypeDef* psPort, U32 u32Pins, U32 u32Mode, U32 u32Speed, U32 u32Pull, U32 u32Alternate );
+#endif
+#if UTIL_PROFILING
+U32 Util_ProfileStart( void );
+void Util_ProfileEnd( E_UTIL_PROFILE eSection, U32 u32Start );
+void Util_ProfileAdd( volatile S_UTIL_PROFILE* psProfile, U32 u32Start );
+#endif
+#if UTIL_TRACE
+ISR_CODE void Util_Trace( E_UTIL_TRACE eEvent, U8 u8Data );
+#endif
+#if UTIL_PROBES
+void Util_ProbeInit( void );
+#endif
 
 
 #endif /* UTIL_H */
@@ -0,0 +1,339 @@
+#!/usr/bin/env python3
+"""Compiles the normal LED programs of fw_py32/Src/animation.c to C, for a build with ANIMATION_COMPILED=1
+
+The VM interprets the operations of an instruction (ADD, SATADD, RSHIFT, LSHIFT, USOURCE, DSOURCE, DIV) by
+testing every opcode bit of the dispatch table and reading the array of the instruction for every LED. This
+script writes one function a program instead: a case for each instruction with operations, in straight-line
+code, with the array and the shift distances folded in as constants and the opcodes not used left out. The
+zeros of an ADD are left out as well, as the VM leaves those LEDs alone. Everything else of the instruction,
+the timing, REPEAT, LOAD, LERP, GENERATE and the flow control, stays with the VM; so do the uploaded
+animations, whose programs aren't in the table of the compiled ones.
+
+The output is included by animation.c, it is only valid for the tables it was generated from: the GCC
+Makefile regenerates it from animation.c when ANIMATION_COMPILED=1 is given in DEFINES, the IAR project
+needs this script as a pre-build command. The size of each table is checked when compiling.
+
+Usage: animgen.py --source <animation.c> [--out <animation_gen.inc>] [--tables gasStarLaunch,gasKITT,...]
+  --tables: the programs to compile, the hottest ones where flash is short (default: every one with operations)
+"""
+
+import argparse
+import os
+import re
+import sys
+
+OPERATIONS = ( "ADD", "RSHIFT", "LSHIFT", "USOURCE", "DSOURCE", "DIV" )  # the order of gcasNormalOperations[]
+DIV_RECIPROCALS = 16  # as in animation.c
+
+
+def strip_comments( sSource ):
+  """The source without its comments"""
+  sSource = re.sub( r"/\*.*?\*/", "", sSource, flags = re.S )
+  return re.sub( r"//[^\n]*", "", sSource )
+
+
+def body( sSource, u32Start ):
+  """The text between the brace opened right before u32Start and its closing one"""
+  u32Depth, u32Index = 1, u32Start
+  while u32Depth and ( u32Index < len( sSource ) ):
+    u32Depth += { "{": 1, "}": -1 }.get( sSource[ u32Index ], 0 )
+    u32Index += 1
+  return sSource[ u32Start:u32Index - 1 ]
+
+
+def evaluate( sExpression, dNames ):
+  """Value of a constant C expression of integers and the names given; None if it is anything else"""
+  for _ in range( 4 ):  # names defined by other names
+    sExpression = re.sub( r"\b[A-Za-z_]\w*\b", lambda oMatch: "(%s)" % dNames.get( oMatch.group( 0 ), oMatch.group( 0 ) ), sExpression )
+  sExpression = re.sub( r"\b(0x[0-9A-Fa-f]+|\d+)[uUlL]+\b", r"\1", sExpression )
+  if not sExpression.strip() or not re.fullmatch( r"[\s()0-9A-Fa-fx|&~<>+\-*/%]*", sExpression ):
+    return None
+  try:
+    return int( eval( sExpression.replace( "/", "//" ) ) )
+  except ( SyntaxError, ZeroDivisionError ):
+    return None
+
+
+def define( sSource, sName ):
+  """Value of a #define of the source, None if there isn't one"""
+  oMatch = re.search( r"#define\s+%s\s+\(?\s*(\w+)\s*\)?" % sName, sSource )
+  return evaluate( oMatch.group( 1 ), {} ) if oMatch else None
+
+
+def enumerators( sSource ):
+  """The names of the enums of the source, with their values"""
+  dNames = {}
+  for oMatch in re.finditer( r"typedef\s+enum\s*\{", sSource ):
+    for sItem in body( sSource, oMatch.end() ).split( "," ):
+      oItem = re.match( r"\s*(\w+)\s*=\s*(.+?)\s*$", sItem, re.S )
+      if oItem:
+        dNames[ oItem.group( 1 ) ] = oItem.group( 2 )
+  return dNames
+
+
+def rows( sSource, sName, dNames, u32Length ):
+  """The rows of the 2D constant array sName of the source, [ values ] or None if a row isn't u32Length integers"""
+  aRows = []
+  oMatch = re.search( r"\b%s\s*\[[^\]]*\]\s*\[[^\]]*\]\s*=\s*\{" % sName, sSource )
+  if oMatch:
+    for oRow in re.finditer( r"\{([^{}]*)\}", body( sSource, oMatch.end() ) ):
+      aValues = [ evaluate( sValue, dNames ) for sValue in oRow.group( 1 ).split( "," ) if sValue.strip() ]
+      aRows.append( aValues if ( None not in aValues ) and ( len( aValues ) == u32Length ) else None )
+  return aRows
+
+
+def programs( sSource, dNames, u32Leds, u32Right ):
+  """Returns [ ( table, layout, [ ( opcode, operand or None, [ levels ] or None ) ] ) ] of the normal LED
+  programs, the layout is NORMAL, HALF or FRAME as in the type of the table; the levels are expanded to both
+  sides for a mirrored one, taken from gcau8Frames[] for a frame one, modulo 256 as in the U8 array. A row of
+  gcau8PaletteFrames[] is expanded by gcau8DefaultPalette[], unless the program sets its own by PALETTE"""
+  aFrames = rows( sSource, "gcau8Frames", dNames, u32Leds )
+  aPaletteFrames = rows( sSource, "gcau8PaletteFrames", dNames, ( u32Leds + 3 ) // 4 )
+  oMatch = re.search( r"\bgcau8DefaultPalette\s*\[[^\]]*\]\s*=\s*\{", sSource )
+  aDefaultPalette = [ evaluate( sValue.strip(), dNames ) for sValue in body( sSource, oMatch.end() ).split( "," ) if sValue.strip() ] if oMatch else []
+  u32PaletteFrame = evaluate( "PALETTE_FRAME", dNames ) or 0x100
+  u32Palette = evaluate( "PALETTE", dNames )
+  aPrograms = []
+  for oMatch in re.finditer( r"S_ANIMATION_INSTRUCTION_(NORMAL|HALF|FRAME)\s+(gas\w+)\s*\[[^\]]*\]\s*=\s*\{", sSource ):
+    sLayout = oMatch.group( 1 )
+    aInstructions = []
+    sRow = r"\{([^{},]*),([^{},]*),([^{}]*)\}" if "FRAME" == sLayout else r"\{([^{}]*)\{([^{}]*)\}([^{}]*)\}"
+    asRows = list( re.finditer( sRow, body( sSource, oMatch.end() ) ) )
+    bPalette = any( ( len( asTail ) > 0 ) and ( u32Palette is not None ) and ( evaluate( asTail[ 0 ], dNames ) == u32Palette )
+                    for asTail in ( oRow.group( 3 ).split( "," ) for oRow in asRows ) )
+    for oRow in asRows:
+      asTail = [ sField.strip() for sField in oRow.group( 3 ).split( "," ) if sField.strip() ]
+      u32Opcode = evaluate( asTail[ 0 ], dNames ) if asTail else None
+      u32Operand = evaluate( asTail[ 1 ], dNames ) if len( asTail ) > 1 else None
+      if "FRAME" == sLayout:
+        u32Frame = evaluate( oRow.group( 2 ), dNames )
+        aLevels = None
+        if ( u32Frame is not None ) and ( u32Frame & u32PaletteFrame ):
+          u32Frame &= ~u32PaletteFrame
+          if ( not bPalette ) and ( u32Frame < len( aPaletteFrames ) ) and aPaletteFrames[ u32Frame ] \
+             and ( len( aDefaultPalette ) == 4 ) and ( None not in aDefaultPalette ):
+            aLevels = [ aDefaultPalette[ ( aPaletteFrames[ u32Frame ][ u32Led // 4 ] >> ( 2 * ( u32Led % 4 ) ) ) & 3 ] for u32Led in range( u32Leds ) ]
+        elif ( u32Frame is not None ) and ( u32Frame < len( aFrames ) ):
+          aLevels = aFrames[ u32Frame ]
+      else:
+        aLevels = [ evaluate( sLevel, dNames ) for sLevel in oRow.group( 2 ).split( "," ) if sLevel.strip() ]
+        if None in aLevels or len( aLevels ) != ( u32Right if "HALF" == sLayout else u32Leds ):
+          aLevels = None
+        elif "HALF" == sLayout:
+          aLevels = aLevels + [ 0 ] * ( u32Leds - u32Right )
+          for u32Index in range( u32Right ):
+            aLevels[ u32Leds - 1 - u32Index ] = aLevels[ u32Index ]
+      aInstructions.append( ( u32Opcode, u32Operand, [ u32Level & 0xFF for u32Level in aLevels ] if aLevels else None ) )
+    aPrograms.append( ( oMatch.group( 2 ), sLayout, aInstructions ) )
+  return aPrograms
+
+
+def guards( sSource ):
+  """The ANIMATION_IN_SET() names of the rows of gasAnimations[] that name each table; [] if a row without one does"""
+  dGuards = {}
+  oMatch = re.search( r"\bgasAnimations\s*\[[^\]]*\]\s*=\s*\{", sSource )
+  if oMatch:
+    sGuard = None
+    for sLine in body( sSource, oMatch.end() ).splitlines():
+      oIf = re.match( r"\s*#if\s+ANIMATION_IN_SET\(\s*(\w+)\s*\)", sLine )
+      if oIf:
+        sGuard = oIf.group( 1 )
+      elif re.match( r"\s*#endif", sLine ):
+        sGuard = None
+      for sName in re.findall( r"\b(gas\w+)\b", sLine ):
+        if sGuard is None:
+          dGuards[ sName ] = []
+        elif ( [] != dGuards.get( sName ) ) and ( sGuard not in dGuards.get( sName, [] ) ):
+          dGuards.setdefault( sName, [] ).append( sGuard )
+  return dGuards
+
+
+def signed( u32Level ):
+  """The level of the array as the I8 of the VM"""
+  return u32Level - 256 if u32Level > 127 else u32Level
+
+
+def compile_source( aLevels, bUpward, u32Leds, u32Right ):
+  """Lines of a USOURCE or DSOURCE, the carry is passed on along each side"""
+  aSides = ( list( range( u32Right ) ), list( range( u32Leds - 1, u32Right - 1, -1 ) ) )
+  if not bUpward:
+    aSides = ( list( range( u32Right - 1, -1, -1 ) ), list( range( u32Right, u32Leds ) ) )
+  asLines = []
+  for sSide, aOrder in zip( ( "Left", "Right" ), aSides ):
+    asLines.append( "// %s side" % sSide )
+    for u32Step, u32Index in enumerate( aOrder ):
+      i32Level = signed( aLevels[ u32Index ] )
+      if 0 == u32Step:
+        if 0 != i32Level:
+          asLines.append( "pu8Levels[ %du ] %s= %du;" % ( u32Index, "-" if i32Level < 0 else "+", abs( i32Level ) ) )
+      elif 0 == i32Level:
+        asLines.append( "pu8Levels[ %du ] += (U8)i8Carry;" % u32Index )
+      else:
+        asLines.append( "pu8Levels[ %du ] += (U8)( i8Carry %s %d );" % ( u32Index, "-" if i32Level < 0 else "+", abs( i32Level ) ) )
+      sCarry = "(void)" if u32Step == len( aOrder ) - 1 else "i8Carry = "
+      asLines.append( "%sSaturateBrightness( &pu8Levels[ %du ] );" % ( sCarry, u32Index ) )
+  return asLines
+
+
+def compile_instruction( u32Opcode, u32Operand, aLevels, dOpcodes, u32Leds, u32Right ):
+  """Lines of the operations of an instruction, None if the VM runs it: no operation, or no constant array"""
+  u32Control = dOpcodes[ "CONTROL" ]
+  if ( u32Opcode is None ) or ( u32Control == ( u32Control & u32Opcode ) ) \
+     or ( u32Opcode in ( dOpcodes[ "LOAD" ], dOpcodes[ "LERP" ], dOpcodes[ "GENERATE" ] ) ) \
+     or not any( dOpcodes[ sName ] & u32Opcode for sName in OPERATIONS ) or ( aLevels is None ):
+    return None
+  asLines = []
+  for sName in OPERATIONS:
+    if not ( dOpcodes[ sName ] & u32Opcode ):
+      continue
+    if "ADD" == sName:
+      bSaturate = 0 != ( dOpcodes[ "LERP" ] & u32Opcode )  # SATADD
+      for u32Index, u32Level in enumerate( aLevels ):
+        if 0 == u32Level:
+          continue  # the LED is left alone
+        i32Level = signed( u32Level )
+        asLines.append( "pu8Levels[ %du ] %s= %du;" % ( u32Index, "-" if i32Level < 0 else "+", abs( i32Level ) ) )
+        if bSaturate:
+          asLines.append( "(void)SaturateBrightness( &pu8Levels[ %du ] );" % u32Index )
+        else:
+          asLines.append( "if( pu8Levels[ %du ] > LED_BRIGHTNESS_MAX )  // overflow/underflow happened" % u32Index )
+          asLines.append( "{" )
+          asLines.append( "  pu8Levels[ %du ] = 0u;" % u32Index )
+          asLines.append( "}" )
+    elif sName in ( "RSHIFT", "LSHIFT" ):
+      u32Distance = 1  # as ShiftDistance()
+      if ( 0 == ( ( dOpcodes[ "REPEAT" ] | dOpcodes[ "DIV" ] ) & u32Opcode ) ) and u32Operand:
+        u32Distance = u32Operand % u32Leds
+      elif u32Operand is None:
+        return None
+      asLines.append( "Rotate( pu8Levels, %du );" % ( u32Distance if "RSHIFT" == sName else u32Leds - u32Distance ) )
+    elif sName in ( "USOURCE", "DSOURCE" ):
+      asLines += compile_source( aLevels, "USOURCE" == sName, u32Leds, u32Right )
+    else:  # DIV, as Divide()
+      for u32Index, u32Level in enumerate( aLevels ):
+        if u32Level >= DIV_RECIPROCALS:
+          asLines.append( "pu8Levels[ %du ] /= %du;" % ( u32Index, u32Level ) )
+        elif u32Level > 1:
+          asLines.append( "pu8Levels[ %du ] = (U8)( ( (U32)pu8Levels[ %du ] * %du ) >> 16u );" % ( u32Index, u32Index, ( 65536 + u32Level - 1 ) // u32Level ) )
+  return asLines
+
+
+def opcode_names( u32Opcode, dOpcodes ):
+  """The opcode as in the table, for the comment of its case"""
+  asNames = [ sName for sName in ( "ADD", "RSHIFT", "LSHIFT", "LERP", "DIV", "USOURCE", "DSOURCE", "REPEAT" ) if dOpcodes[ sName ] & u32Opcode ]
+  if ( "ADD" in asNames ) and ( "LERP" in asNames ):
+    asNames[ asNames.index( "ADD" ) ] = "SATADD"
+    asNames.remove( "LERP" )
+  return " | ".join( asNames )
+
+
+def generate( sSource, sLedHeader, asTables ):
+  """Text of the output file"""
+  sCode = strip_comments( sSource )
+  dNames = enumerators( sCode )
+  if define( sCode, "PALETTE_FRAME" ) is not None:
+    dNames[ "PALETTE_FRAME" ] = str( define( sCode, "PALETTE_FRAME" ) )
+  dOpcodes = { sName: evaluate( sName, dNames ) for sName in OPERATIONS + ( "LOAD", "LERP", "GENERATE", "CONTROL", "REPEAT" ) }
+  if None in dOpcodes.values():
+    raise ValueError( "no E_ANIMATION_OPCODE in the source" )
+  u32Right = define( sCode, "RIGHT_LEDS_START" )
+  u32Leds = define( strip_comments( sLedHeader ), "LEDS_NUM" )
+  if not u32Right or not u32Leds:
+    raise ValueError( "RIGHT_LEDS_START or LEDS_NUM not found" )
+  dGuards = guards( sCode )
+
+  asOut = [ "// Generated by tools/animgen.py from animation.c, do not edit: included by animation.c with ANIMATION_COMPILED",
+            "#if ( LEDS_NUM != %du ) || ( RIGHT_LEDS_START != %du )" % ( u32Leds, u32Right ),
+            "#error \"animation_gen.inc: generated for another board, run tools/animgen.py\"",
+            "#endif",
+            "" ]
+  asEntries = []
+  aPrograms = programs( sCode, dNames, u32Leds, u32Right )
+  setKnown = { sName for sName, _, _ in aPrograms }
+  for sTable in asTables or []:
+    if sTable not in setKnown:
+      raise ValueError( "no normal LED program named %s" % sTable )
+  for sTable, sLayout, aInstructions in aPrograms:
+    if asTables and ( sTable not in asTables ):
+      continue
+    asCases = []
+    bCarry = False
+    for u32Index, ( u32Opcode, u32Operand, aLevels ) in enumerate( aInstructions ):
+      asLines = compile_instruction( u32Opcode, u32Operand, aLevels, dOpcodes, u32Leds, u32Right )
+      if asLines is None:
+        continue
+      bCarry |= any( "i8Carry =" in sLine for sLine in asLines )
+      asCases.append( "    case %du:  // %s" % ( u32Index, opcode_names( u32Opcode, dOpcodes ) ) )
+      asCases += [ "      " + sLine for sLine in asLines ]
+      asCases.append( "      break;" )
+    if not asCases:
+      continue
+    sType = "S_ANIMATION_INSTRUCTION_" + sLayout
+    sFunction = "Compiled" + sTable[ 3: ]
+    asGuards = dGuards.get( sTable, [] )
+    sGuard = " || ".join( "ANIMATION_IN_SET( %s )" % sName for sName in asGuards )
+    if sGuard:
+      asOut.append( "#if %s" % sGuard )
+    asOut += [ "//! \\brief Operations of %s[]: FALSE if the instruction (u8Index) has none" % sTable,
+               "static BOOL %s( U8 u8Index, U8* pu8Levels )" % sFunction,
+               "{",
+               "  BOOL bCompiled = TRUE;" ]
+    if bCarry:
+      asOut.append( "  I8   i8Carry;" )
+    asOut += [ "  ",
+               "  // The table must be the one this was generated from",
+               "  (void)sizeof( char[ ( sizeof( %s ) == ( %du * sizeof( %s ) ) ) ? 1 : -1 ] );" % ( sTable, len( aInstructions ), sType ),
+               "  switch( u8Index )",
+               "  {" ]
+    asOut += asCases
+    asOut += [ "    default:",
+               "      bCompiled = FALSE;",
+               "      break;",
+               "  }",
+               "  ",
+               "  return bCompiled;",
+               "}" ]
+    if sGuard:
+      asOut.append( "#endif" )
+    asOut.append( "" )
+    sPointer = sTable if "NORMAL" == sLayout else "(const S_ANIMATION_INSTRUCTION_NORMAL CODE*)" + sTable
+    asEntries.append( ( sGuard, "  { %s, %s }," % ( sPointer, sFunction ) ) )
+
+  asOut += [ "//! \\brief The compiled programs, see CompiledExecute()",
+             "static CODE const S_ANIMATION_COMPILED gcasCompiled[] =",
+             "{" ]
+  for sGuard, sEntry in asEntries:
+    asOut += ( [ "#if %s" % sGuard, sEntry, "#endif" ] if sGuard else [ sEntry ] )
+  asOut += [ "  { NULL, NULL }",
+             "};",
+             "" ]
+  return "\n".join( asOut ), len( asEntries )
+
+
+def main():
+  oParser = argparse.ArgumentParser( description = "Compiles the normal LED programs of animation.c to C" )
+  oParser.add_argument( "--source", required = True, help = "animation.c of fw_py32" )
+  oParser.add_argument( "--led", help = "led.h, for LEDS_NUM (default: next to the source)" )
+  oParser.add_argument( "--out", help = "output file (default: animation_gen.inc next to the source)" )
+  oParser.add_argument( "--tables", help = "comma separated programs to compile (default: all)" )
+  oArgs = oParser.parse_args()
+
+  sDir = os.path.dirname( os.path.abspath( oArgs.source ) )
+  try:
+    with open( oArgs.source, errors = "replace" ) as oFile:
+      sSource = oFile.read()
+    with open( oArgs.led or os.path.join( sDir, "led.h" ), errors = "replace" ) as oFile:
+      sLedHeader = oFile.read()
+    sOut, u32Programs = generate( sSource, sLedHeader, [ sName.strip() for sName in oArgs.tables.split( "," ) ] if oArgs.tables else None )
+  except ( OSError, ValueError ) as oError:
+    sys.stderr.write( "Error: %s\n" % oError )
+    return 2
+  sPath = oArgs.out or os.path.join( sDir, "animation_gen.inc" )
+  with open( sPath, "w" ) as oFile:
+    oFile.write( sOut )
+  print( "%s: %d programs compiled" % ( sPath, u32Programs ) )
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit( main() )
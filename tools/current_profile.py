@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""Supply current of a firmware build per animation, from the log of a power analyzer, checked against a baseline
+
+The board runs a test build of fw_py32, compiled with TEST_CYCLE_S=<dwell> (see main.c): it shows the gauge,
+then plays every animation of the auto-cycle in turn from the first, <dwell> s each, and saves nothing. Power
+it from the analyzer, record the whole cycle, and export the log as CSV: a time column in s, a current column.
+The start of the cycle is the first sample above --threshold; animation k runs from t0 + k * dwell on. The
+first --settle s of each window are dropped, for the gauge and the crossfade.
+
+Baseline file, one animation a line, '#' starts a comment; --out writes one from the current log:
+  <animation> <average mA> <peak mA>
+An average above the baseline by more than --tolerance percent makes the exit code 1. The peaks are listed,
+but not checked: a single sample of the analyzer is noisy.
+
+Usage: current_profile.py --log <csv> --dwell <s> [--animations <n> | --source <animation.h> [--set <ANIMATION_SET>]] [--build <name>]
+                          [--baseline <file>] [--out <file>]
+"""
+
+import argparse
+import csv
+import re
+import sys
+
+UNITS = { "A": 1000.0, "mA": 1.0, "uA": 0.001 }  # to mA
+
+
+def column( asHeader, sColumn ):
+  """Index of a column, by its number or by the start of its name"""
+  if sColumn.isdigit():
+    return int( sColumn )
+  for u32Index, sName in enumerate( asHeader ):
+    if sName.strip().lower().startswith( sColumn.lower() ):
+      return u32Index
+  raise ValueError( "no column named '%s' in %s" % ( sColumn, ", ".join( asHeader ) ) )
+
+
+def read_log( sLog, sTime, sCurrent, fScale ):
+  """Returns the samples of the log as [ ( s, mA ) ], sorted by time; lines that aren't numbers are skipped"""
+  aSamples = []
+  with open( sLog, newline = "", errors = "replace" ) as oFile:
+    aaRows = list( csv.reader( oFile ) )
+  asHeader = aaRows[ 0 ] if aaRows else []
+  u32Time, u32Current = column( asHeader, sTime ), column( asHeader, sCurrent )
+  for asRow in aaRows:
+    try:
+      aSamples.append( ( float( asRow[ u32Time ] ), float( asRow[ u32Current ] ) * fScale ) )
+    except ( ValueError, IndexError ):
+      continue
+  return sorted( aSamples )
+
+
+def animation_count( sSource, sSet ):
+  """Animations of the auto-cycle: the ones of ANIMATION_SET in animation.h, or of sSet as in the project;
+  the last animation of the table, which is left out, isn't in the set"""
+  with open( sSource, errors = "replace" ) as oFile:
+    sText = oFile.read()
+  dDefines = { oMatch.group( 1 ): oMatch.group( 2 ) for oMatch in re.finditer( r"#define\s+(ANIMATION_\w+)\s+(\(.*?\))\s*//", sText ) }
+
+  def evaluate( sExpression ):
+    for _ in range( 4 ):  # the names in the set, and the ones in theirs
+      sExpression = re.sub( r"\bANIMATION_\w+\b", lambda oMatch: dDefines.get( oMatch.group( 0 ), oMatch.group( 0 ) ), sExpression )
+    sExpression = re.sub( r"\b(0x[0-9A-Fa-f]+|\d+)[uUlL]+\b", r"\1", sExpression )
+    if not sExpression.strip() or not re.fullmatch( r"[\s()0-9A-Fa-fx|&~<>+\-]*", sExpression ):
+      raise ValueError( "cannot evaluate the ANIMATION_SET of %s: %s" % ( sSource, sExpression ) )
+    return eval( sExpression )
+
+  return bin( evaluate( sSet if sSet else "ANIMATION_SET" ) & evaluate( "ANIMATION_ALL" ) ).count( "1" )
+
+
+def read_baseline( sBaseline ):
+  """Returns { animation: ( average mA, peak mA ) }"""
+  dBaseline = {}
+  with open( sBaseline ) as oFile:
+    for u32Line, sLine in enumerate( oFile, 1 ):
+      asFields = sLine.split( "#" )[ 0 ].split()
+      if not asFields:
+        continue
+      try:
+        dBaseline[ int( asFields[ 0 ] ) ] = ( float( asFields[ 1 ] ), float( asFields[ 2 ] ) )
+      except ( ValueError, IndexError ):
+        raise ValueError( "%s(%d): expected '<animation> <average mA> <peak mA>'" % ( sBaseline, u32Line ) )
+  return dBaseline
+
+
+def main():
+  oParser = argparse.ArgumentParser( description = "Supply current per animation, checked against a baseline" )
+  oParser.add_argument( "--log", required = True, help = "CSV exported by the power analyzer" )
+  oParser.add_argument( "--dwell", required = True, type = float, help = "TEST_CYCLE_S of the build, in s" )
+  oParser.add_argument( "--animations", type = int, help = "animations of the cycle" )
+  oParser.add_argument( "--source", help = "animation.h, for the animations of the cycle" )
+  oParser.add_argument( "--set", help = "ANIMATION_SET of the build, if the project gives one" )
+  oParser.add_argument( "--time-col", default = "0", help = "time column in s, number or name (default: 0)" )
+  oParser.add_argument( "--current-col", default = "1", help = "current column, number or name (default: 1)" )
+  oParser.add_argument( "--unit", default = "A", choices = sorted( UNITS ), help = "unit of the current column (default: A)" )
+  oParser.add_argument( "--threshold", type = float, default = 0.5, help = "power-up level in mA (default: 0.5)" )
+  oParser.add_argument( "--settle", type = float, default = 3.0, help = "s dropped at the start of each window (default: 3)" )
+  oParser.add_argument( "--build", default = "", help = "name of the build, for the table" )
+  oParser.add_argument( "--baseline", help = "baseline file, see the header of this script" )
+  oParser.add_argument( "--tolerance", type = float, default = 10.0, help = "allowed rise of the averages in percent (default: 10)" )
+  oParser.add_argument( "--out", help = "writes the results as a baseline file" )
+  oArgs = oParser.parse_args()
+
+  try:
+    u32Animations = oArgs.animations if oArgs.animations else animation_count( oArgs.source, oArgs.set ) if oArgs.source else 0
+    aSamples = read_log( oArgs.log, oArgs.time_col, oArgs.current_col, UNITS[ oArgs.unit ] )
+    dBaseline = read_baseline( oArgs.baseline ) if oArgs.baseline else {}
+  except ( OSError, ValueError ) as oError:
+    sys.stderr.write( "Error: %s\n" % oError )
+    return 2
+  if not u32Animations:
+    sys.stderr.write( "Error: give --animations or --source\n" )
+    return 2
+  fStart = next( ( fTime for fTime, fCurrent in aSamples if fCurrent > oArgs.threshold ), None )
+  if fStart is None:
+    sys.stderr.write( "Error: the current of %s never exceeds %g mA\n" % ( oArgs.log, oArgs.threshold ) )
+    return 2
+
+  # Average and peak of each window
+  dResults = {}
+  for u32Index in range( u32Animations ):
+    fFrom = fStart + u32Index * oArgs.dwell + oArgs.settle
+    fTo = fStart + ( u32Index + 1 ) * oArgs.dwell
+    afCurrents = [ fCurrent for fTime, fCurrent in aSamples if fFrom <= fTime < fTo ]
+    if afCurrents:
+      dResults[ u32Index ] = ( sum( afCurrents ) / len( afCurrents ), max( afCurrents ), len( afCurrents ) )
+
+  bFailed = False
+  print( "Supply current of %s%s, cycle from %.3f s, mA" % ( oArgs.log, " (%s)" % oArgs.build if oArgs.build else "", fStart ) )
+  print( "%-5s %8s %8s %8s  %s" % ( "Anim", "Average", "Peak", "Samples", "Baseline" ) )
+  for u32Index in range( u32Animations ):
+    if u32Index not in dResults:
+      print( "%-5d %8s %8s %8d  (log too short)" % ( u32Index, "-", "-", 0 ) )
+      bFailed = True
+      continue
+    fAverage, fPeak, u32Count = dResults[ u32Index ]
+    sBaseline = ""
+    if u32Index in dBaseline:
+      fLimit = dBaseline[ u32Index ][ 0 ] * ( 1.0 + oArgs.tolerance / 100.0 )
+      bOver = fAverage > fLimit
+      sBaseline = "%-4s %8.3f" % ( "OVER" if bOver else "ok", dBaseline[ u32Index ][ 0 ] )
+      if bOver:
+        sys.stderr.write( "%s: Error: animation %d draws %.3f mA, the baseline is %.3f mA\n" % ( oArgs.log, u32Index, fAverage, dBaseline[ u32Index ][ 0 ] ) )
+        bFailed = True
+    print( "%-5d %8.3f %8.3f %8d  %s" % ( u32Index, fAverage, fPeak, u32Count, sBaseline ) )
+  if dResults:
+    print( "%-5s %8.3f %8.3f" % ( "All", sum( aResult[ 0 ] for aResult in dResults.values() ) / len( dResults ),
+                                  max( aResult[ 1 ] for aResult in dResults.values() ) ) )
+
+  if oArgs.out:
+    with open( oArgs.out, "w" ) as oFile:
+      oFile.write( "# Supply current per animation, mA%s\n" % ( ": " + oArgs.build if oArgs.build else "" ) )
+      for u32Index in sorted( dResults ):
+        oFile.write( "%d %.3f %.3f\n" % ( u32Index, dResults[ u32Index ][ 0 ], dResults[ u32Index ][ 1 ] ) )
+  return 1 if bFailed else 0
+
+
+if __name__ == "__main__":
+  sys.exit( main() )
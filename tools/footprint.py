@@ -0,0 +1,453 @@
+#!/usr/bin/env python3
+"""Flash and RAM footprint of a firmware build, per module and per animation, checked against a budget
+
+Reads the map file of the linker:
+  - Keil BL51 (firmware/project/Listings/*.m51): the segments of the link map, named ?PR?FUNC?MODULE,
+    ?CO?MODULE, ?DT?MODULE etc., and the symbol table for the animation tables
+  - IAR ILINK (fw_py32/EWARM/.../List/*.map): the module summary, and the entry list for the animation tables
+  - GNU ld (fw_py32/GCC/build/*.map): the input sections of the memory map, by object file; with LTO the
+    modules are merged into "(LTO)", the animation tables are still told by their -fdata-sections names
+The animation tables are taken from the gasAnimations[] of animation.c: each row is sized by the tables it
+names, recursively, e.g. the layers and their programs. Of several gasAnimations[] (board variants), the one
+linked is reported. A table shared by several animations is marked with '*'.
+
+Budget file, one limit a line, '#' starts a comment:
+  <module> <region> <bytes>
+  module: name without extension, case-insensitive; 'total': the whole image; 'animations': all animation tables
+  region: Keil: code, const, data, idata, xdata, bit (in bits); IAR and GNU: code, const, ram
+          both: flash = code + const; Keil: iram = data + idata, the 256 bytes of the internal RAM;
+          eeprom: code segments linked into the EEPROM mapping, e.g. the animation tables
+A limit exceeded makes the exit code 1, so the IDE fails the build.
+
+With --compare, the flash and the RAM of each module are listed next to the ones of another map, e.g. of the
+GCC and the IAR build of fw_py32; the budget is checked with the first map only.
+
+With --isr (Keil only) the variables touched by the interrupts are listed with their memory space: the
+functions marked with ITVECTORn in the sources of the directory, and everything they call, are searched
+for the variables of the symbol table. One in IDATA or XDATA is an error, as the 8051 reaches those only
+through a pointer register; they belong in DATA (ISR_DATA) or in bit space (BIT).
+
+Usage: footprint.py --map <map file> [--source <animation.c>] [--budget <budget file>] [--isr <source dir>]
+                    [--compare <map file>]
+"""
+
+import argparse
+import glob
+import os
+import re
+import sys
+
+KEIL_REGIONS = ( "code", "const", "flash", "eeprom", "data", "idata", "iram", "xdata", "bit" )
+KEIL_EEPROM_BASE = 0x2000  # code address of the EEPROM of the STC8G1K08, for PERSIST_ANIMATIONS_IN_EEPROM
+IAR_REGIONS = ( "code", "const", "flash", "ram" )
+IAR_COLUMNS = ( "code", "const", "ram" )  # columns of the module summary
+
+
+def keil_number( sText ):
+  """Keil address or length: 0123H, or 0020H.3 for bits; returns ( bytes, bits )"""
+  sText = sText.rstrip()
+  if "." in sText:
+    sBytes, sBits = sText.split( "." )
+    return int( sBytes.rstrip( "H" ), 16 ), int( sBits )
+  return int( sText.rstrip( "H" ), 16 ), 0
+
+
+def keil_module( sSegment ):
+  """Module of a Keil segment name"""
+  sModule = sSegment
+  oMatch = re.match( r"\?(PR|CO|DT|ID|XD|BI|BA|PD)\?(?:.*\?)?(\w+)$", sSegment )
+  if oMatch:
+    sModule = oMatch.group( 2 )
+  elif sSegment.startswith( "(" ):
+    sModule = sSegment
+  elif sSegment.startswith( "REG BANK" ):
+    sModule = "(register banks)"
+  elif sSegment in ( "_DATA_GROUP_", "_BIT_GROUP_", "_IDATA_GROUP_", "_XDATA_GROUP_" ):
+    sModule = "(overlaid locals)"
+  elif sSegment == "?STACK":
+    sModule = "(stack)"
+  elif sSegment.startswith( "?C" ):
+    sModule = "(C51 runtime)"
+  return sModule
+
+
+def parse_keil( asLines ):
+  """Returns ( regions, { module: { region: bytes } }, { symbol: bytes }, [ variables ] )
+  A variable is ( module, function or "" for the file scope, public, space, address, name )"""
+  dModules = {}
+  aVariables = []
+  sModule = sProc = ""
+  asCodeSegments = []  # ( base, end ) of the const segments, bound the symbol sizes
+  oSegment = re.compile( r"^\s+(REG|DATA|IDATA|XDATA|CODE|BIT)\s+([0-9A-F]+H(?:\.\d)?)\s+([0-9A-F]+H(?:\.\d)?)\s+"
+                         r"(?:ABSOLUTE|UNIT|INPAGE|INBLOCK|PAGE|BITADDRESSABLE|OVERLAYABLE)?\s*(.*)$" )
+  oSymbol = re.compile( r"^\s+([CDIXB]):([0-9A-F]+)H(?:\.\d)?\s+(PUBLIC|SYMBOL)\s+(\w+)\s*$" )
+  oScope = re.compile( r"^\s+-------\s+(MODULE|ENDMOD|PROC|ENDPROC)\s+(\S+)" )
+  aSymbols = []
+  for sLine in asLines:
+    oMatch = oSegment.match( sLine )
+    if oMatch:
+      sType, sBase, sLength, sName = oMatch.groups()
+      sName = sName.strip().strip( '"' ) or "(vectors)"  # the unnamed absolute code is the interrupt vectors
+      u32Base, _ = keil_number( sBase )
+      u32Length, u8Bits = keil_number( sLength )
+      sModule = keil_module( sName )
+      if "BIT" == sType:
+        sRegion, u32Size = "bit", u32Length * 8 + u8Bits
+      elif "CODE" == sType:
+        sRegion, u32Size = ( "const" if sName.startswith( "?CO?" ) else "code" ), u32Length
+        if u32Base >= KEIL_EEPROM_BASE:
+          sRegion = "eeprom"  # read by MOVC, but not in the program flash
+        if sName.startswith( "?CO?" ):
+          asCodeSegments.append( ( u32Base, u32Base + u32Length ) )
+      elif "IDATA" == sType:
+        sRegion, u32Size = "idata", u32Length
+      elif "XDATA" == sType:
+        sRegion, u32Size = "xdata", u32Length
+      else:
+        sRegion, u32Size = "data", u32Length
+      dRegions = dModules.setdefault( sModule, {} )
+      dRegions[ sRegion ] = dRegions.get( sRegion, 0 ) + u32Size
+      continue
+    oMatch = oScope.match( sLine )
+    if oMatch:
+      sKind, sName = oMatch.groups()
+      if "MODULE" == sKind:
+        sModule, sProc = sName, ""
+      elif "PROC" == sKind:
+        sProc = sName.lstrip( "_" )  # functions with register parameters are _NAME
+      else:
+        sProc = ""
+      continue
+    oMatch = oSymbol.match( sLine )
+    if oMatch and ( "C" == oMatch.group( 1 ) ):
+      aSymbols.append( ( int( oMatch.group( 2 ), 16 ), oMatch.group( 4 ) ) )
+    elif oMatch:
+      bPublic = "PUBLIC" == oMatch.group( 3 )
+      aVariables.append( ( sModule, "" if bPublic else sProc, bPublic, oMatch.group( 1 ), int( oMatch.group( 2 ), 16 ), oMatch.group( 4 ) ) )
+  # A table ends where the next symbol, or its segment, does
+  dSymbols = {}
+  au32Addresses = sorted( set( u32Address for u32Address, _ in aSymbols ) )
+  for u32Address, sName in aSymbols:
+    for u32Base, u32End in asCodeSegments:
+      if u32Base <= u32Address < u32End:
+        u32Next = next( ( u32Other for u32Other in au32Addresses if u32Other > u32Address ), u32End )
+        dSymbols[ sName ] = min( u32Next, u32End ) - u32Address
+  return KEIL_REGIONS, dModules, dSymbols, aVariables
+
+
+def parse_iar( asLines ):
+  """Returns ( regions, { module: { region: bytes } }, { symbol: bytes } )"""
+  dModules = {}
+  dSymbols = {}
+  sSection = ""
+  aColumns = []  # end of each value column in the module summary
+  sGroup = ""
+  oEntry = re.compile( r"^\s*(\S+)\s+(0x[0-9a-fA-F']+)\s+(0x[0-9a-fA-F']+|\d[\d']*)?\s*(Code|Data)\s+(Gb|Lc|Wk)\s" )
+  sPending = ""
+  for sLine in asLines:
+    if sLine.startswith( "***" ):
+      sSection = sLine.strip( "* " ).upper() or sSection  # a title is framed by lines of stars
+      continue
+    if "MODULE SUMMARY" == sSection:
+      if ( "ro code" in sLine ) and ( "rw data" in sLine ):
+        aColumns = [ sLine.index( sLabel ) + len( sLabel ) for sLabel in ( "ro code", "ro data", "rw data" ) ]
+        continue
+      oMatch = re.match( r"^(\S.*): \[\d+\]\s*$", sLine )
+      if oMatch:
+        sGroup = oMatch.group( 1 )
+        continue
+      sName = sLine.strip().split( " " )[ 0 ] if sLine.strip() else ""
+      if ( not aColumns ) or ( not sName ) or sName.startswith( "-" ) or sLine.strip().endswith( ":" ) or ( "Total" in sLine ):
+        continue
+      if not sName.endswith( ".o" ):
+        sModule = "(" + sLine[ :aColumns[ 0 ] - 8 ].strip() + ")"  # Gaps, Linker created...
+      elif sGroup.lower().endswith( ".a" ):
+        sModule = "(library " + re.split( r"[\\/]", sGroup )[ -1 ] + ")"
+      else:
+        sModule = sName[ :-2 ]
+      dRegions = dModules.setdefault( sModule, {} )
+      u32Start = aColumns[ 0 ] - 8
+      for sRegion, u32End in zip( IAR_COLUMNS, aColumns ):
+        sValue = sLine[ u32Start:u32End ].replace( "'", "" ).replace( " ", "" )
+        u32Start = u32End
+        if sValue.isdigit():
+          dRegions[ sRegion ] = dRegions.get( sRegion, 0 ) + int( sValue )
+    elif "ENTRY LIST" == sSection:
+      # Long names are on a line of their own
+      if sPending:
+        sLine = sPending + " " + sLine
+        sPending = ""
+      elif re.match( r"^\s*\S+\s*$", sLine ):
+        sPending = sLine.strip()
+        continue
+      oMatch = oEntry.match( sLine )
+      if oMatch and oMatch.group( 3 ):
+        sSize = oMatch.group( 3 ).replace( "'", "" )
+        dSymbols[ oMatch.group( 1 ) ] = int( sSize, 16 ) if sSize.startswith( "0x" ) else int( sSize )
+  return IAR_REGIONS, dModules, dSymbols, []
+
+
+def parse_gnu( asLines ):
+  """Returns ( regions, { module: { region: bytes } }, { symbol: bytes } )
+  The initial values of .data and the .ramfunc code count as ram, and their copy in the flash as const"""
+  dModules = {}
+  dSymbols = {}
+  bMemoryMap = False
+  sPending = ""
+  oInput = re.compile( r"^ (\.\S+|COMMON)\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S.*)$" )
+  oOutput = re.compile( r"^(\.\S+)\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)" )
+  for sLine in asLines:
+    if sLine.startswith( "Linker script and memory map" ):
+      bMemoryMap = True
+      continue
+    if not bMemoryMap:
+      continue
+    # Long names are on a line of their own
+    if sPending:
+      sLine = sPending + " " + sLine.strip()
+      sPending = ""
+    elif re.match( r"^ ?(\.\S+|COMMON)\s*$", sLine ):
+      sPending = sLine.rstrip()
+      continue
+    oMatch = oOutput.match( sLine )
+    if oMatch and ( ".stack" == oMatch.group( 1 ) ):
+      dModules.setdefault( "(stack)", {} )[ "ram" ] = int( oMatch.group( 3 ), 16 )
+      continue
+    oMatch = oInput.match( sLine )
+    if not oMatch:
+      continue
+    sSection, u32Address, u32Size, sFile = oMatch.group( 1 ), int( oMatch.group( 2 ), 16 ), int( oMatch.group( 3 ), 16 ), oMatch.group( 4 ).strip()
+    if ( 0 == u32Size ) or ( 0 == u32Address ):  # debug information
+      continue
+    if sSection.startswith( ( ".text", ".isr_vector", ".glue", ".ARM.exidx", ".vfp11", ".v4_bx", ".iplt" ) ):
+      asRegions = [ "code" ]
+    elif sSection.startswith( ".rodata" ):
+      asRegions = [ "const" ]
+    elif sSection.startswith( ( ".data", ".ramfunc" ) ):
+      asRegions = [ "ram", "const" ]
+    elif sSection.startswith( ( ".bss", ".noinit", "COMMON" ) ):
+      asRegions = [ "ram" ]
+    else:
+      continue
+    oLibrary = re.match( r"^(.*\.a)\((.*)\)$", sFile )
+    if oLibrary:
+      sModule = "(library " + re.split( r"[\\/]", oLibrary.group( 1 ) )[ -1 ] + ")"
+    elif ".ltrans" in sFile:
+      sModule = "(LTO)"
+    elif sFile.endswith( ".o" ):
+      sModule = re.split( r"[\\/]", sFile )[ -1 ][ :-2 ]
+    else:
+      sModule = "(" + sFile + ")"  # linker stubs...
+    dRegions = dModules.setdefault( sModule, {} )
+    for sRegion in asRegions:
+      dRegions[ sRegion ] = dRegions.get( sRegion, 0 ) + u32Size
+    oSymbol = re.match( r"^\.(?:rodata|data|bss|text|ramfunc)\.(\w+)", sSection )
+    if oSymbol:
+      dSymbols[ oSymbol.group( 1 ) ] = dSymbols.get( oSymbol.group( 1 ), 0 ) + u32Size
+  return IAR_REGIONS, dModules, dSymbols, []
+
+
+def read_map( sMap ):
+  """Returns ( kind, regions, { module: { region: bytes } }, { symbol: bytes }, [ variables ] ) of a map file"""
+  with open( sMap, errors = "replace" ) as oFile:
+    asLines = oFile.read().splitlines()
+  if any( "MODULE SUMMARY" in sLine for sLine in asLines ):
+    sKind, fParse = "IAR ILINK", parse_iar
+  elif any( sLine.startswith( "Linker script and memory map" ) for sLine in asLines ):
+    sKind, fParse = "GNU ld", parse_gnu
+  else:
+    sKind, fParse = "Keil BL51", parse_keil
+  asRegions, dModules, dSymbols, aVariables = fParse( asLines )
+  for dRegions in dModules.values():
+    dRegions[ "flash" ] = dRegions.get( "code", 0 ) + dRegions.get( "const", 0 )
+    if "Keil BL51" == sKind:
+      dRegions[ "iram" ] = dRegions.get( "data", 0 ) + dRegions.get( "idata", 0 )
+  return sKind, asRegions, dModules, dSymbols, aVariables
+
+
+def strip_comments( sSource ):
+  """The source without its comments"""
+  sSource = re.sub( r"/\*.*?\*/", "", sSource, flags = re.S )
+  return re.sub( r"//[^\n]*", "", sSource )
+
+
+def animation_tables( sSource ):
+  """Returns the rows of each gasAnimations[] of the source, a row is the list of the tables it names"""
+  sSource = strip_comments( sSource )
+  dBodies = {}
+  for oMatch in re.finditer( r"\b(gas\w+)\s*\[[^\]]*\]\s*=\s*\{", sSource ):
+    u32Depth, u32Index = 1, oMatch.end()
+    while u32Depth and ( u32Index < len( sSource ) ):
+      u32Depth += { "{": 1, "}": -1 }.get( sSource[ u32Index ], 0 )
+      u32Index += 1
+    dBodies.setdefault( oMatch.group( 1 ), [] ).append( sSource[ oMatch.end():u32Index - 1 ] )
+
+  def referenced( sName, setSeen ):
+    asTables = []
+    if sName not in setSeen:
+      setSeen.add( sName )
+      asTables.append( sName )
+      for sBody in dBodies.get( sName, [] ):
+        for sOther in re.findall( r"\b(gas\w+)\b", sBody ):
+          asTables += referenced( sOther, setSeen )
+    return asTables
+
+  aaRows = []
+  for sBody in dBodies.get( "gasAnimations", [] ):
+    aRows = []
+    for sRow in re.findall( r"\{([^{}]*)\}", sBody ):
+      setSeen = { "gasAnimations" }
+      asTables = []
+      for sName in re.findall( r"\b(gas\w+)\b", sRow ):
+        asTables += referenced( sName, setSeen )
+      aRows.append( asTables )
+    aaRows.append( aRows )
+  return aaRows
+
+
+def isr_variables( sDir, aVariables ):
+  """Returns [ ( space, address, name, module, function ) ] of the variables touched by the interrupts,
+  and the names of the interrupt handlers"""
+  dFunctions = {}  # name: [ ( module, body ) ]
+  asHandlers = []
+  for sPath in sorted( glob.glob( os.path.join( sDir, "*.c" ) ) ):
+    sModule = os.path.splitext( os.path.basename( sPath ) )[ 0 ].upper()
+    with open( sPath, errors = "replace" ) as oFile:
+      sSource = strip_comments( oFile.read() )
+    sSource = re.sub( r"^\s*#.*$", "", sSource, flags = re.M )
+    # Function definitions: a block at file scope, after a header with a parameter list
+    u32Depth, u32Start, u32Header = 0, 0, 0
+    for oMatch in re.finditer( r"[{};]", sSource ):
+      sChar = oMatch.group( 0 )
+      if "{" == sChar:
+        if 0 == u32Depth:
+          u32Start = oMatch.end()
+          sHeader = sSource[ u32Header:oMatch.start() ]
+        u32Depth += 1
+      elif "}" == sChar:
+        u32Depth -= 1
+        if 0 == u32Depth:
+          oHeader = re.search( r"\b(\w+)\s*\([^()]*\)\s*(ITVECTOR\d+|interrupt\s+\d+)?\s*(?:REENTRANT)?\s*$", sHeader )
+          if oHeader and ( "=" not in sHeader ):
+            dFunctions.setdefault( oHeader.group( 1 ), [] ).append( ( sModule, sSource[ u32Start:oMatch.start() ] ) )
+            if oHeader.group( 2 ):
+              asHandlers.append( oHeader.group( 1 ) )
+          u32Header = oMatch.end()
+      elif 0 == u32Depth:
+        u32Header = oMatch.end()
+  # Everything the handlers call
+  asReached, asQueue = [], list( asHandlers )
+  while asQueue:
+    sFunction = asQueue.pop( 0 )
+    if sFunction in asReached:
+      continue
+    asReached.append( sFunction )
+    for _, sBody in dFunctions.get( sFunction, [] ):
+      asQueue += [ sCallee for sCallee in re.findall( r"\b(\w+)\s*\(", sBody ) if sCallee in dFunctions ]
+  # Their variables: own locals, the file scope of the module, the publics of any module
+  aFound = []
+  for sFunction in asReached:
+    for sModule, sBody in dFunctions[ sFunction ]:
+      setNames = set( re.findall( r"\b([a-z]\w*)\b", sBody ) )  # variables are Hungarian, SFRs are upper case
+      for sVarModule, sProc, bPublic, sSpace, u32Address, sName in aVariables:
+        bOwn = ( sVarModule == sModule ) and ( sProc in ( "", sFunction.upper() ) )
+        if ( sName in setNames ) and ( bOwn or bPublic ):
+          aFound.append( ( sSpace, u32Address, sName, sVarModule, sProc ) )
+  return sorted( set( aFound ), key = lambda a: ( a[ 3 ], a[ 4 ], a[ 2 ] ) ), asHandlers
+
+
+def main():
+  oParser = argparse.ArgumentParser( description = "Flash and RAM footprint of a build, checked against a budget" )
+  oParser.add_argument( "--map", required = True, help = "map file of the linker, Keil .m51 or IAR .map" )
+  oParser.add_argument( "--source", help = "animation.c, for the footprint of each animation" )
+  oParser.add_argument( "--budget", help = "budget file, see the header of this script" )
+  oParser.add_argument( "--isr", metavar = "DIR", help = "Keil: sources whose interrupts must only touch direct variables" )
+  oParser.add_argument( "--compare", metavar = "MAP", help = "another map file, listed next to this one" )
+  oArgs = oParser.parse_args()
+
+  sKind, asRegions, dModules, dSymbols, aVariables = read_map( oArgs.map )
+  bKeil = "Keil BL51" == sKind
+  if not dModules:
+    sys.stderr.write( "Error: no modules found in %s\n" % oArgs.map )
+    return 2
+
+  dTotal = {}
+  print( "Footprint of %s (%s), bytes%s" % ( oArgs.map, sKind, "; bit: bits" if bKeil else "" ) )
+  print( "%-24s" % "Module" + "".join( "%8s" % sRegion for sRegion in asRegions ) )
+  for sModule in sorted( dModules, key = lambda s: ( s.startswith( "(" ), s.lower() ) ):
+    print( "%-24s" % sModule + "".join( "%8d" % dModules[ sModule ].get( sRegion, 0 ) for sRegion in asRegions ) )
+    for sRegion, u32Size in dModules[ sModule ].items():
+      dTotal[ sRegion ] = dTotal.get( sRegion, 0 ) + u32Size
+  print( "%-24s" % "Total" + "".join( "%8d" % dTotal.get( sRegion, 0 ) for sRegion in asRegions ) )
+  dModules[ "total" ] = dTotal
+
+  # Per animation, from the table that is linked
+  if oArgs.source:
+    with open( oArgs.source, errors = "replace" ) as oFile:
+      aaRows = animation_tables( oFile.read() )
+    aRows = max( aaRows, key = lambda aRows: sum( sName in dSymbols for asTables in aRows for sName in asTables ), default = [] )
+    aRows = [ asTables for asTables in aRows if any( sName in dSymbols for sName in asTables ) ]  # the rows left out by ANIMATION_SET
+    dUses = {}
+    for asTables in aRows:
+      for sName in asTables:
+        dUses[ sName ] = dUses.get( sName, 0 ) + 1
+    print( "\n%-5s %6s  %s" % ( "Anim", "Bytes", "Tables ('*': shared)" ) )
+    for u8Index, asTables in enumerate( aRows ):
+      u32Size = sum( dSymbols.get( sName, 0 ) for sName in asTables )
+      print( "%-5d %6d  %s" % ( u8Index, u32Size, " ".join( sName + ( "*" if dUses[ sName ] > 1 else "" ) for sName in asTables ) ) )
+    u32Animations = sum( dSymbols.get( sName, 0 ) for sName in dUses )
+    print( "%-5s %6d  (shared tables counted once)" % ( "All", u32Animations ) )
+    dModules[ "animations" ] = { "const": u32Animations, "flash": u32Animations }
+
+  # Memory space of the variables of the interrupts
+  bFailed = False
+  if oArgs.isr and bKeil:
+    aFound, asHandlers = isr_variables( oArgs.isr, aVariables )
+    print( "\nVariables of the interrupts (%s)" % ", ".join( asHandlers ) )
+    for sSpace, u32Address, sName, sModule, sProc in aFound:
+      bIndirect = sSpace in ( "I", "X" )
+      print( "%-4s %s:%04XH  %-24s %s" % ( "SLOW" if bIndirect else "ok", sSpace, u32Address, sName, sModule + ( "." + sProc if sProc else "" ) ) )
+      if bIndirect:
+        sys.stderr.write( "%s: Error: %s is touched by an interrupt, but it is in %s\n" % ( oArgs.map, sName, "IDATA" if "I" == sSpace else "XDATA" ) )
+        bFailed = True
+
+  # Next to another build
+  if oArgs.compare:
+    sOtherKind, _, dOthers, _, _ = read_map( oArgs.compare )
+    dOthers[ "total" ] = { sRegion: sum( dRegions.get( sRegion, 0 ) for dRegions in dOthers.values() ) for sRegion in ( "flash", "ram" ) }
+    dNames = { sModule.lower(): sModule for sModule in dOthers }
+    setOwn = { sModule.lower() for sModule in dModules }
+    asModules = [ sModule for sModule in dModules if "animations" != sModule ] + [ sModule for sModule in dOthers if sModule.lower() not in setOwn ]
+    print( "\nCompared with %s (%s), bytes" % ( oArgs.compare, sOtherKind ) )
+    print( "%-24s %8s %8s %8s   %8s %8s %8s" % ( "Module", "flash", "other", "diff", "ram", "other", "diff" ) )
+    for sModule in sorted( asModules, key = lambda s: ( "total" == s, s.startswith( "(" ), s.lower() ) ):
+      dThis = dModules.get( sModule, {} )
+      dOther = dOthers.get( dNames.get( sModule.lower(), "" ), {} )
+      print( "%-24s" % sModule + "  ".join( " %8d %8d %+8d" % ( dThis.get( sRegion, 0 ), dOther.get( sRegion, 0 ), dThis.get( sRegion, 0 ) - dOther.get( sRegion, 0 ) )
+                                            for sRegion in ( "flash", "ram" ) ) )
+
+  # Budget
+  if oArgs.budget:
+    dNames = { sModule.lower(): sModule for sModule in dModules }
+    print( "\nBudget %s" % oArgs.budget )
+    with open( oArgs.budget ) as oFile:
+      for u32Line, sLine in enumerate( oFile, 1 ):
+        asFields = sLine.split( "#" )[ 0 ].split()
+        if not asFields:
+          continue
+        if ( 3 != len( asFields ) ) or ( asFields[ 1 ] not in asRegions ) or not asFields[ 2 ].isdigit():
+          sys.stderr.write( "%s(%d): Error: expected '<module> <%s> <bytes>'\n" % ( oArgs.budget, u32Line, "|".join( asRegions ) ) )
+          bFailed = True
+          continue
+        sModule, sRegion, u32Limit = asFields[ 0 ], asFields[ 1 ], int( asFields[ 2 ] )
+        u32Used = dModules.get( dNames.get( sModule.lower(), "" ), {} ).get( sRegion, 0 )
+        bOver = u32Used > u32Limit
+        print( "%-4s %-24s %-6s %6d / %6d" % ( "OVER" if bOver else "ok", sModule, sRegion, u32Used, u32Limit ) )
+        if bOver:
+          sys.stderr.write( "%s(%d): Error: %s %s is %d, the budget is %d\n" % ( oArgs.budget, u32Line, sModule, sRegion, u32Used, u32Limit ) )
+          bFailed = True
+  return 1 if bFailed else 0
+
+
+if __name__ == "__main__":
+  sys.exit( main() )
@@ -0,0 +1,537 @@
+#!/usr/bin/env python3
+"""Worst-case cycles of the interrupt handlers, from the compiled code, checked against a budget
+
+Reads the code of the build:
+  - GNU (fw_py32/GCC/build/karifa.elf): the disassembly of arm-none-eabi-objdump -d, or of llvm-objdump;
+    Cortex-M0+ cycles with zero wait states, a single-cycle multiplier, and the exception entry and return
+  - Keil C51 (firmware/project/Listings/*.lst): the assembly listings of the modules, compiled with the CODE
+    control; STC8G cycles, the slowest form of each mnemonic, and the vector call of the interrupt
+Each function is split at its branches; the longest path from its entry to a return is taken, a call
+adds the worst case of the callee, a taken branch its extra cycles. A loop needs a bound from the
+budget file, it is counted as that many complete passes plus the path out of it. The switch tables of
+GCC (__gnu_thumb1_case_*) and of C51 (?C?CCASE etc., JMP @A+DPTR) are followed to all their cases, the
+bounds of a GCC table are taken from the CMP before it.
+
+Budget file, one line each, '#' starts a comment:
+  <handler> <cycles>           the worst case of an interrupt handler, with its entry and return
+  loop <function> <n>[,<n>..]  most passes of the loops of a function, in order of their address; the
+                               last bound is taken for the further loops. With LTO or the inlining of
+                               C51, a loop is in the function it has been inlined into
+  cost <function> <cycles>     worst case of a function as given, it isn't analysed: a library routine
+                               without code in the input, e.g. ?C?CCASE, or one calling through a pointer
+A handler over its budget, or a path that can't be bounded (a loop without a bound, an indirect call,
+recursion, a callee without code) makes the exit code 1, so the build fails.
+
+Usage: isr_cycles.py (--elf <elf file> [--objdump <tool>] | --disasm <objdump -d output> | --keil <listing dir>)
+                     --budget <budget file> [--verbose]
+"""
+
+import argparse
+import glob
+import os
+import re
+import subprocess
+import sys
+
+sys.setrecursionlimit( 10000 )
+
+ARM_EXCEPTION_CYCLES = 15 + 13  # entry with the stacking, and the return with the unstacking
+ARM_CONDITIONS = ( "eq", "ne", "cs", "hs", "cc", "lo", "mi", "pl", "vs", "vc", "hi", "ls", "ge", "lt", "gt", "le" )
+ARM_CASE_HELPERS = { "__gnu_thumb1_case_uqi": ( 1, False ), "__gnu_thumb1_case_sqi": ( 1, True ),
+                     "__gnu_thumb1_case_uhi": ( 2, False ), "__gnu_thumb1_case_shi": ( 2, True ) }  # entry bytes, signed
+
+C51_INTERRUPT_CYCLES = 3 + 3  # the call to the vector by the hardware, and the LJMP there
+C51_CYCLES = { "MUL": 2, "DIV": 6, "DA": 3, "MOVC": 4, "MOVX": 3, "ACALL": 3, "LCALL": 3, "RET": 3, "RETI": 3,
+               "AJMP": 3, "LJMP": 3, "SJMP": 3, "JMP": 4, "CJNE": 2, "DJNZ": 2 }  # the others take 1
+C51_TAKEN = 3  # a conditional branch taken
+C51_CONDITIONAL = ( "JZ", "JNZ", "JC", "JNC", "JB", "JNB", "JBC", "CJNE", "DJNZ" )
+C51_CASES = ( "?C?CCASE", "?C?ICASE", "?C?LCASE", "?C?ILCASE" )
+
+
+class Instruction:
+  """An instruction of a function
+  kind: op, call, jump, branch (conditional), return, tail (jump to another function), icall, ijump, cases
+  targets: indices of the instructions jumped to; callee: name of the function called"""
+
+  def __init__( self, u32Address, sText, u32Cycles, sKind = "op", aTargets = None, sCallee = None, u32Taken = 0 ):
+    self.u32Address = u32Address
+    self.sText = sText
+    self.u32Cycles = u32Cycles
+    self.sKind = sKind
+    self.aTargets = aTargets or []
+    self.sCallee = sCallee
+    self.u32Taken = u32Taken  # extra cycles of a taken conditional branch
+
+
+class Function:
+  def __init__( self, sName ):
+    self.sName = sName
+    self.aInstructions = []
+
+
+def arm_bytes( sRaw ):
+  """Bytes of a raw column of objdump: GNU shows halfwords and words as numbers, llvm the bytes in order"""
+  au8Bytes = []
+  for sGroup in sRaw.split():
+    u32Value = int( sGroup, 16 )
+    if 2 == len( sGroup ):
+      au8Bytes.append( u32Value )
+    else:
+      au8Bytes += [ ( u32Value >> ( 8 * u8Index ) ) & 0xFF for u8Index in range( len( sGroup ) // 2 ) ]
+  return au8Bytes
+
+
+def arm_registers( sOperands ):
+  """Registers of a register list, e.g. {r4, r5, lr}"""
+  oMatch = re.search( r"\{([^}]*)\}", sOperands )
+  u32Count = 0
+  if oMatch:
+    for sRegister in oMatch.group( 1 ).split( "," ):
+      asRange = sRegister.strip().split( "-" )
+      u32Count += ( int( asRange[ 1 ].strip( "r" ) ) - int( asRange[ 0 ].strip( "r" ) ) + 1 ) if 2 == len( asRange ) else 1
+  return u32Count
+
+
+def arm_cycles( sMnemonic, sOperands ):
+  """Cortex-M0+ cycles of an instruction, a conditional branch not taken"""
+  u32Cycles = 1
+  if sMnemonic.startswith( ( "ldr", "str" ) ):
+    u32Cycles = 2
+  elif sMnemonic.startswith( ( "ldm", "stm", "push" ) ):
+    u32Cycles = 1 + arm_registers( sOperands )
+  elif sMnemonic.startswith( "pop" ):
+    u32Cycles = 1 + arm_registers( sOperands ) + ( 2 if "pc" in sOperands else 0 )
+  elif sMnemonic in ( "bl", ):
+    u32Cycles = 3
+  elif sMnemonic in ( "b", "bx", "blx", "wfi", "wfe" ):
+    u32Cycles = 2
+  elif sMnemonic in ( "dmb", "dsb", "isb", "mrs", "msr" ):
+    u32Cycles = 3
+  return u32Cycles
+
+
+def parse_objdump( asLines ):
+  """Returns { name: Function } of a disassembly by objdump -d"""
+  dFunctions = {}
+  dMemory = {}  # address: byte, for the switch tables
+  aRaw = []  # ( function, address, mnemonic, operands )
+  oFunction = None
+  for sLine in asLines:
+    oMatch = re.match( r"^([0-9a-fA-F]+) <([^>]+)>:\s*$", sLine )
+    if oMatch and not oMatch.group( 2 ).startswith( "$" ):  # the mapping symbols of llvm-objdump go on with the function
+      oFunction = dFunctions.setdefault( oMatch.group( 2 ), Function( oMatch.group( 2 ) ) )
+      continue
+    oMatch = re.match( r"^\s*([0-9a-fA-F]+):\s*(.*)$", sLine )
+    if ( not oMatch ) or ( oFunction is None ):
+      continue
+    u32Address = int( oMatch.group( 1 ), 16 )
+    asFields = [ sField.strip() for sField in oMatch.group( 2 ).split( "\t" ) if sField.strip() ]
+    sRaw = ""
+    # The raw column is made of even groups of hex digits, a mnemonic never is
+    while asFields and re.match( r"^(?:[0-9a-fA-F]{2})+(?: (?:[0-9a-fA-F]{2})+)*$", asFields[ 0 ] ):
+      sRaw += " " + asFields.pop( 0 )
+    # llvm-objdump separates the raw column by spaces only
+    oRaw = re.match( r"^((?:[0-9a-fA-F]{2} )+)\s*(\S.*)$", asFields[ 0 ] + " " ) if asFields else None
+    if oRaw and ( not sRaw ):
+      sRaw = oRaw.group( 1 )
+      asFields = oRaw.group( 2 ).strip().split( None, 1 ) + asFields[ 1: ]
+    for u8Index, u8Byte in enumerate( arm_bytes( sRaw ) ):
+      dMemory[ u32Address + u8Index ] = u8Byte
+    if asFields:
+      asWords = asFields[ 0 ].split( None, 1 )
+      sMnemonic = asWords[ 0 ].lower()
+      sOperands = " ".join( asWords[ 1: ] + asFields[ 1: ] )
+      aRaw.append( ( oFunction, u32Address, sMnemonic, sOperands ) )
+
+  for oFunction, u32Address, sMnemonic, sOperands in aRaw:
+    sOperands = re.split( r"[;@]", sOperands )[ 0 ].strip()
+    sBase = sMnemonic.split( "." )[ 0 ]
+    oInstruction = Instruction( u32Address, sMnemonic + " " + sOperands, arm_cycles( sBase, sOperands ) )
+    oTarget = re.match( r"^(?:0x)?([0-9a-fA-F]+)\s*<([^>+]+)(\+0x[0-9a-fA-F]+)?>", sOperands )
+    oRelative = re.match( r"^#(-?\d+)", sOperands )
+    u32Target = int( oTarget.group( 1 ), 16 ) if oTarget else ( u32Address + 4 + int( oRelative.group( 1 ) ) if oRelative else None )
+    sSymbol = oTarget.group( 2 ) if ( oTarget and not oTarget.group( 3 ) ) else None
+    if "bl" == sBase:
+      oInstruction.sKind, oInstruction.sCallee = "call", sSymbol or "0x%X" % ( u32Target or 0 )
+      if oInstruction.sCallee in ARM_CASE_HELPERS:
+        oInstruction.sKind = "cases"
+        oInstruction.aTargets = arm_case_targets( oFunction, u32Address, ARM_CASE_HELPERS[ oInstruction.sCallee ], dMemory )
+    elif "blx" == sBase:
+      oInstruction.sKind = "icall"
+    elif "bx" == sBase:
+      oInstruction.sKind = "return" if "lr" == sOperands else "ijump"
+    elif sBase.startswith( "pop" ) and ( "pc" in sOperands ):
+      oInstruction.sKind = "return"
+    elif ( "b" == sBase ) or ( ( "b" == sBase[ :1 ] ) and ( sBase[ 1: ] in ARM_CONDITIONS ) ):
+      oInstruction.sKind = "jump" if "b" == sBase else "branch"
+      oInstruction.u32Taken = 1 if "branch" == oInstruction.sKind else 0
+      oInstruction.aTargets = [ u32Target ]
+      if sSymbol and ( sSymbol != oFunction.sName ) and ( "jump" == oInstruction.sKind ):
+        oInstruction.sKind, oInstruction.sCallee = "tail", sSymbol
+    elif re.match( r"^(mov|add)s?$", sBase ) and re.match( r"^pc\b", sOperands ):
+      oInstruction.sKind = "ijump"
+    oFunction.aInstructions.append( oInstruction )
+  # Branch targets from addresses to indices
+  for oFunction in dFunctions.values():
+    dIndices = { oInstruction.u32Address: u32Index for u32Index, oInstruction in enumerate( oFunction.aInstructions ) }
+    for oInstruction in oFunction.aInstructions:
+      oInstruction.aTargets = [ dIndices.get( u32Target, -1 ) for u32Target in oInstruction.aTargets ]
+  return dFunctions
+
+
+def arm_case_targets( oFunction, u32Address, tHelper, dMemory ):
+  """Addresses of the cases of a GCC switch table after the call of its helper; the entries are counted
+  by the comparison with the highest case before it. Returns [ None ] if they can't be told"""
+  u8Size, bSigned = tHelper
+  u32Entries = 0
+  for oInstruction in reversed( oFunction.aInstructions[ -4: ] ):
+    oMatch = re.match( r"^cmp\S*\s+r\d+,\s*#(\d+)", oInstruction.sText )
+    if oMatch:
+      u32Entries = int( oMatch.group( 1 ) ) + 1
+      break
+  u32Base = u32Address + 4  # the return address of the call
+  aTargets = []
+  for u32Index in range( u32Entries ):
+    au8Entry = [ dMemory.get( u32Base + u32Index * u8Size + u8Byte ) for u8Byte in range( u8Size ) ]
+    if None in au8Entry:
+      return [ None ]
+    u32Entry = au8Entry[ 0 ] | ( ( au8Entry[ 1 ] << 8 ) if 2 == u8Size else 0 )
+    if bSigned and ( u32Entry & ( 0x80 << ( 8 * ( u8Size - 1 ) ) ) ):
+      u32Entry -= 1 << ( 8 * u8Size )
+    aTargets.append( u32Base + 2 * u32Entry )
+  return aTargets if aTargets else [ None ]
+
+
+def c51_name( sName ):
+  """Function name of C51 without the '_' of the register parameters"""
+  return sName[ 1: ] if sName.startswith( "_" ) and not sName.startswith( "?" ) else sName
+
+
+def parse_keil( asPaths ):
+  """Returns { name: Function } of the assembly listings of C51"""
+  dFunctions = {}
+  oBegin = re.compile( r"^\s+;\s+FUNCTION\s+(\S+)\s+\((BEGIN|END)\)" )
+  oLabel = re.compile( r"^[0-9A-F]{4}\s+(\??\w+):\s*$" )
+  oCode = re.compile( r"^([0-9A-F]{4})\s+[0-9A-F]+\s+(?:[RE]\s+)?([A-Z]{2,5})\b\s*(.*?)\s*$" )
+  for sPath in asPaths:
+    with open( sPath, errors = "replace" ) as oFile:
+      asLines = oFile.read().splitlines()
+    oFunction = None
+    dLabels = {}
+    aPending = []  # ( instruction, label names of its targets )
+    sDptr = None  # label of the last MOV DPTR, for JMP @A+DPTR
+    for sLine in asLines:
+      oMatch = oBegin.match( sLine )
+      if oMatch:
+        if "BEGIN" == oMatch.group( 2 ):
+          oFunction = dFunctions.setdefault( c51_name( oMatch.group( 1 ) ), Function( c51_name( oMatch.group( 1 ) ) ) )
+          dLabels, aPending, sDptr = {}, [], None
+        elif oFunction is not None:
+          c51_resolve( oFunction, dLabels, aPending )
+          oFunction = None
+        continue
+      if oFunction is None:
+        continue
+      oMatch = oLabel.match( sLine )
+      if oMatch:
+        dLabels[ oMatch.group( 1 ) ] = len( oFunction.aInstructions )
+        continue
+      oMatch = oCode.match( sLine )
+      if not oMatch:
+        continue
+      sMnemonic, sOperands = oMatch.group( 2 ), oMatch.group( 3 ).split( ";" )[ 0 ].strip()
+      asOperands = [ sOperand.strip() for sOperand in sOperands.split( "," ) ]
+      if sMnemonic in ( "DB", "DW" ):
+        # The table of a ?C?CCASE: its labels are cases of the last jump
+        if ( "DW" == sMnemonic ) and aPending and ( "cases" == aPending[ -1 ][ 0 ].sKind ) and asOperands[ 0 ].startswith( "?C0" ):
+          aPending[ -1 ][ 1 ].append( asOperands[ 0 ] )
+        continue
+      oInstruction = Instruction( int( oMatch.group( 1 ), 16 ), sMnemonic + " " + sOperands, C51_CYCLES.get( sMnemonic, 1 ) )
+      asTargets = []
+      if sMnemonic in ( "ACALL", "LCALL" ):
+        oInstruction.sKind, oInstruction.sCallee = "call", c51_name( asOperands[ 0 ] )
+      elif sMnemonic in ( "RET", "RETI" ):
+        oInstruction.sKind = "return"
+      elif sMnemonic in ( "AJMP", "LJMP", "SJMP" ):
+        if asOperands[ 0 ] in C51_CASES:
+          oInstruction.sKind, oInstruction.sCallee = "cases", asOperands[ 0 ]
+        else:
+          oInstruction.sKind = "jump"
+          asTargets = [ asOperands[ 0 ] ]
+      elif sMnemonic in C51_CONDITIONAL:
+        oInstruction.sKind, oInstruction.u32Taken = "branch", C51_TAKEN - oInstruction.u32Cycles
+        asTargets = [ asOperands[ -1 ] ]
+      elif "JMP" == sMnemonic:
+        oInstruction.sKind = "cases"
+        asTargets = [ "@" + ( sDptr or "" ) ]  # the jumps of the table at the label
+      elif ( "MOV" == sMnemonic ) and ( "DPTR" == asOperands[ 0 ] ) and asOperands[ -1 ].startswith( "#?C0" ):
+        sDptr = asOperands[ -1 ][ 1: ]
+      oFunction.aInstructions.append( oInstruction )
+      aPending.append( ( oInstruction, asTargets ) )
+  return dFunctions
+
+
+def c51_resolve( oFunction, dLabels, aPending ):
+  """Branch targets of a C51 function from labels to indices; a jump out of it is a tail call"""
+  for oInstruction, asTargets in aPending:
+    aTargets = []
+    for sTarget in asTargets:
+      if sTarget.startswith( "@" ):
+        # JMP @A+DPTR: each jump of the table is a case
+        u32Index = dLabels.get( sTarget[ 1: ], len( oFunction.aInstructions ) )
+        while ( u32Index < len( oFunction.aInstructions ) ) and ( oFunction.aInstructions[ u32Index ].sKind in ( "jump", "tail" ) ):
+          aTargets.append( u32Index )
+          u32Index += 1
+        aTargets = aTargets or [ -1 ]
+      elif sTarget in dLabels:
+        aTargets.append( dLabels[ sTarget ] )
+      elif "jump" == oInstruction.sKind:
+        oInstruction.sKind, oInstruction.sCallee = "tail", c51_name( sTarget )
+      else:
+        aTargets.append( -1 )
+    oInstruction.aTargets = aTargets
+
+
+class Analysis:
+  """Worst case of the functions, with the loop bounds and the given costs of the budget"""
+
+  def __init__( self, dFunctions, dBounds, dCosts ):
+    self.dFunctions = dFunctions
+    self.dBounds = dBounds
+    self.dCosts = dCosts
+    self.dWorst = {}
+    self.setActive = set()
+    self.asErrors = []
+
+  def error( self, sText ):
+    if sText not in self.asErrors:
+      self.asErrors.append( sText )
+
+  def given( self, dGiven, sName, xDefault ):
+    """Entry of the budget for a function; GCC and LTO append .constprop.0, .lto_priv.0 etc. to the names"""
+    return dGiven.get( sName, dGiven.get( sName.split( "." )[ 0 ], xDefault ) )
+
+  def worst( self, sName ):
+    """Worst case of a function in cycles"""
+    if self.given( self.dCosts, sName, None ) is not None:
+      return self.given( self.dCosts, sName, None )
+    if sName in self.dWorst:
+      return self.dWorst[ sName ]
+    if sName in self.setActive:
+      self.error( "%s is recursive" % sName )
+      return 0
+    oFunction = self.dFunctions.get( sName )
+    if ( oFunction is None ) or not oFunction.aInstructions:
+      self.error( "no code of %s, give its cost" % sName )
+      return 0
+    self.setActive.add( sName )
+    aHeaders = []
+    self.paths( oFunction, lambda u32Header: aHeaders.append( u32Header ) or 1 )
+    # The bounds are given in order of the loops by address
+    au32Bounds = self.given( self.dBounds, sName, [] )
+    dBound = {}
+    for u32Order, u32Header in enumerate( sorted( set( aHeaders ), key = lambda u32Index: oFunction.aInstructions[ u32Index ].u32Address ) ):
+      if au32Bounds:
+        dBound[ u32Header ] = au32Bounds[ min( u32Order, len( au32Bounds ) - 1 ) ]
+      else:
+        self.error( "loop of %s at 0x%X has no bound" % ( sName, oFunction.aInstructions[ u32Header ].u32Address ) )
+        dBound[ u32Header ] = 1
+    u32Worst = self.paths( oFunction, lambda u32Header: dBound.get( u32Header, 1 ) )
+    self.setActive.discard( sName )
+    self.dWorst[ sName ] = u32Worst
+    return u32Worst
+
+  def cost( self, oFunction, u32Index ):
+    """Cycles of an instruction, with its callee"""
+    oInstruction = oFunction.aInstructions[ u32Index ]
+    u32Cycles = oInstruction.u32Cycles
+    if oInstruction.sCallee:
+      u32Cycles += self.worst( oInstruction.sCallee )
+    if oInstruction.sKind in ( "icall", "ijump" ):
+      self.error( "%s: indirect %s at 0x%X, give the cost of %s" % ( oFunction.sName, "call" if "icall" == oInstruction.sKind else "jump",
+                                                                   oInstruction.u32Address, oFunction.sName ) )
+    return u32Cycles
+
+  def edges( self, oFunction, u32Index ):
+    """[ ( successor or None for the end of the function, extra cycles ) ] of an instruction"""
+    oInstruction = oFunction.aInstructions[ u32Index ]
+    u32Next = u32Index + 1 if u32Index + 1 < len( oFunction.aInstructions ) else -1
+    if oInstruction.sKind in ( "return", "tail", "ijump" ):
+      return [ ( None, 0 ) ]
+    aEdges = []
+    if oInstruction.sKind in ( "jump", "branch", "cases" ):
+      aEdges = [ ( u32Target, oInstruction.u32Taken ) for u32Target in oInstruction.aTargets ]
+    if oInstruction.sKind not in ( "jump", "cases" ):
+      aEdges.append( ( u32Next, 0 ) )
+    for u32Target, _ in aEdges:
+      if ( u32Target is None ) or ( u32Target < 0 ):
+        self.error( "%s: branch at 0x%X leaves the code seen" % ( oFunction.sName, oInstruction.u32Address ) )
+    return [ ( u32Target if ( u32Target is None ) or ( u32Target >= 0 ) else None, u32Extra ) for u32Target, u32Extra in aEdges ]
+
+  def paths( self, oFunction, fBound ):
+    """Longest path through a function from its entry, with fBound( header ) passes of each loop"""
+    dEdges = {}
+    aQueue, setSeen = [ 0 ], { 0 }
+    while aQueue:
+      u32Index = aQueue.pop()
+      dEdges[ u32Index ] = self.edges( oFunction, u32Index )
+      for u32Target, _ in dEdges[ u32Index ]:
+        if ( u32Target is not None ) and ( u32Target not in setSeen ):
+          setSeen.add( u32Target )
+          aQueue.append( u32Target )
+    dCost = { u32Index: self.cost( oFunction, u32Index ) for u32Index in setSeen }
+    dEnd = self.longest( setSeen, 0, dEdges, dCost, fBound, None )
+    return max( [ u32Cycles for u32Cycles in dEnd.values() ] or [ 0 ] )
+
+  def longest( self, setNodes, u32Entry, dEdges, dCost, fBound, u32Header ):
+    """Longest paths in a region of the graph, from its entry. Returns { exit: cycles }: the ends of the
+    function (None), of the region (its successors outside), or of a pass of the loop (the header)"""
+    aComponents = components( setNodes, dEdges, u32Header )
+    dComponent = { u32Node: u32Component for u32Component, aNodes in enumerate( aComponents ) for u32Node in aNodes }
+    dIn = { u32Entry: 0 }  # longest path reaching a node
+    dExits = {}
+
+    def reach( u32Target, u32Cycles ):
+      if ( u32Target is None ) or ( u32Target not in setNodes ) or ( u32Target == u32Header ):
+        dExits[ u32Target ] = max( dExits.get( u32Target, 0 ), u32Cycles )
+      else:
+        dIn[ u32Target ] = max( dIn.get( u32Target, 0 ), u32Cycles )
+
+    for aNodes in aComponents:  # in topological order
+      setComponent = set( aNodes )
+      aEntries = [ u32Node for u32Node in aNodes if u32Node in dIn ]
+      if not aEntries:
+        continue
+      bLoop = ( len( aNodes ) > 1 ) or ( ( aNodes[ 0 ] != u32Header ) and any( u32Target == aNodes[ 0 ] for u32Target, _ in dEdges[ aNodes[ 0 ] ] ) )
+      if not bLoop:
+        u32Node = aNodes[ 0 ]
+        for u32Target, u32Extra in dEdges[ u32Node ]:
+          reach( u32Target, dIn[ u32Node ] + dCost[ u32Node ] + u32Extra )
+        continue
+      for u32Loop in aEntries:  # a loop entered at several places is taken from each of them
+        dPass = self.longest( setComponent, u32Loop, dEdges, dCost, fBound, u32Loop )
+        u32Pass = dPass.pop( u32Loop, 0 )
+        u32Base = dIn[ u32Loop ] + fBound( u32Loop ) * u32Pass
+        for u32Target, u32Cycles in dPass.items():
+          reach( u32Target, u32Base + u32Cycles )
+    return dExits
+
+
+def components( setNodes, dEdges, u32Header ):
+  """Strongly connected components of a region, in topological order; the edges into the header are cut"""
+  dIndex, dLow, aStack, setOnStack, aComponents = {}, {}, [], set(), []
+  u32Counter = [ 0 ]
+
+  def successors( u32Node ):
+    return [ u32Target for u32Target, _ in dEdges[ u32Node ] if ( u32Target in setNodes ) and ( u32Target != u32Header ) ]
+
+  def visit( u32Node ):
+    dIndex[ u32Node ] = dLow[ u32Node ] = u32Counter[ 0 ]
+    u32Counter[ 0 ] += 1
+    aStack.append( u32Node )
+    setOnStack.add( u32Node )
+    for u32Target in successors( u32Node ):
+      if u32Target not in dIndex:
+        visit( u32Target )
+        dLow[ u32Node ] = min( dLow[ u32Node ], dLow[ u32Target ] )
+      elif u32Target in setOnStack:
+        dLow[ u32Node ] = min( dLow[ u32Node ], dIndex[ u32Target ] )
+    if dLow[ u32Node ] == dIndex[ u32Node ]:
+      aNodes = []
+      while True:
+        u32Other = aStack.pop()
+        setOnStack.discard( u32Other )
+        aNodes.append( u32Other )
+        if u32Other == u32Node:
+          break
+      aComponents.append( sorted( aNodes ) )
+
+  for u32Node in sorted( setNodes ):
+    if u32Node not in dIndex:
+      visit( u32Node )
+  aComponents.reverse()  # Tarjan finds the components in reverse topological order
+  if u32Header is not None:
+    # The header starts the pass, even with its in-edges cut
+    aComponents = [ [ u32Header ] ] + [ aNodes for aNodes in aComponents if aNodes != [ u32Header ] ]
+  return aComponents
+
+
+def read_budget( sBudget ):
+  """Returns ( { handler: ( cycles, line ) }, { function: [ bounds ] }, { function: cycles }, [ errors ] )"""
+  dHandlers, dBounds, dCosts, asErrors = {}, {}, {}, []
+  with open( sBudget ) as oFile:
+    for u32Line, sLine in enumerate( oFile, 1 ):
+      asFields = sLine.split( "#" )[ 0 ].split()
+      if not asFields:
+        continue
+      if ( 3 == len( asFields ) ) and ( "loop" == asFields[ 0 ] ) and re.match( r"^\d+(,\d+)*$", asFields[ 2 ] ):
+        dBounds[ asFields[ 1 ] ] = [ int( sBound ) for sBound in asFields[ 2 ].split( "," ) ]
+      elif ( 3 == len( asFields ) ) and ( "cost" == asFields[ 0 ] ) and asFields[ 2 ].isdigit():
+        dCosts[ asFields[ 1 ] ] = int( asFields[ 2 ] )
+      elif ( 2 == len( asFields ) ) and asFields[ 1 ].isdigit():
+        dHandlers[ asFields[ 0 ] ] = ( int( asFields[ 1 ] ), u32Line )
+      else:
+        asErrors.append( "%s(%d): Error: expected '<handler> <cycles>', 'loop <function> <n>[,<n>..]' or 'cost <function> <cycles>'" % ( sBudget, u32Line ) )
+  return dHandlers, dBounds, dCosts, asErrors
+
+
+def main():
+  oParser = argparse.ArgumentParser( description = "Worst-case cycles of the interrupt handlers, checked against a budget" )
+  oGroup = oParser.add_mutually_exclusive_group( required = True )
+  oGroup.add_argument( "--elf", help = "ELF file of the GNU build, disassembled by --objdump" )
+  oGroup.add_argument( "--disasm", help = "output of objdump -d, instead of --elf" )
+  oGroup.add_argument( "--keil", metavar = "DIR", help = "listing directory of a C51 build, compiled with CODE" )
+  oParser.add_argument( "--objdump", default = "arm-none-eabi-objdump", help = "disassembler of --elf" )
+  oParser.add_argument( "--budget", required = True, help = "budget file, see the header of this script" )
+  oParser.add_argument( "--verbose", action = "store_true", help = "list the worst case of every function reached" )
+  oArgs = oParser.parse_args()
+
+  dHandlers, dBounds, dCosts, asErrors = read_budget( oArgs.budget )
+  if oArgs.keil:
+    sKind, u32Exception = "Keil C51, STC8G", C51_INTERRUPT_CYCLES
+    asPaths = sorted( glob.glob( os.path.join( oArgs.keil, "*.lst" ) ) + glob.glob( os.path.join( oArgs.keil, "*.LST" ) ) )
+    dFunctions = parse_keil( sorted( set( asPaths ) ) )
+    dBounds = { c51_name( sName ): au32Bounds for sName, au32Bounds in dBounds.items() }
+    dCosts = { c51_name( sName ): u32Cycles for sName, u32Cycles in dCosts.items() }
+    dHandlers = { c51_name( sName ): tBudget for sName, tBudget in dHandlers.items() }
+    if not dFunctions:
+      sys.stderr.write( "Error: no assembly in the listings of %s, compile with the CODE control\n" % oArgs.keil )
+      return 2
+  else:
+    sKind, u32Exception = "GNU, Cortex-M0+", ARM_EXCEPTION_CYCLES
+    if oArgs.elf:
+      sDisasm = subprocess.run( [ oArgs.objdump, "-d", oArgs.elf ], stdout = subprocess.PIPE, check = True, universal_newlines = True ).stdout
+    else:
+      with open( oArgs.disasm, errors = "replace" ) as oFile:
+        sDisasm = oFile.read()
+    dFunctions = parse_objdump( sDisasm.splitlines() )
+    if not dFunctions:
+      sys.stderr.write( "Error: no functions in the disassembly\n" )
+      return 2
+
+  oAnalysis = Analysis( dFunctions, dBounds, dCosts )
+  bFailed = bool( asErrors )
+  for sError in asErrors:
+    sys.stderr.write( sError + "\n" )
+  print( "Worst case of the interrupts (%s), cycles with the entry and the return" % sKind )
+  for sHandler, ( u32Limit, u32Line ) in dHandlers.items():
+    u32Errors = len( oAnalysis.asErrors )
+    u32Worst = oAnalysis.worst( sHandler ) + u32Exception
+    bOver = u32Worst > u32Limit
+    bUnbound = len( oAnalysis.asErrors ) > u32Errors
+    print( "%-7s %-36s %6d / %6d" % ( "UNBOUND" if bUnbound else ( "OVER" if bOver else "ok" ), sHandler, u32Worst, u32Limit ) )
+    if bOver:
+      sys.stderr.write( "%s(%d): Error: %s takes %d cycles at most, the budget is %d\n" % ( oArgs.budget, u32Line, sHandler, u32Worst, u32Limit ) )
+      bFailed = True
+  for sError in oAnalysis.asErrors:
+    sys.stderr.write( "%s: Error: %s\n" % ( oArgs.budget, sError ) )
+    bFailed = True
+  if oArgs.verbose:
+    print( "\nFunctions reached, worst case without the callers" )
+    for sName in sorted( oAnalysis.dWorst, key = lambda s: -oAnalysis.dWorst[ s ] ):
+      print( "%-44s %6d" % ( sName, oAnalysis.dWorst[ sName ] ) )
+  return 1 if bFailed else 0
+
+
+if __name__ == "__main__":
+  sys.exit( main() )